@@ -11,21 +11,48 @@
 //Dependencies
 #include "os_port.h"
 #include "lfs.h"
+#include "littlefs_startup.h"
 
 // if use mutex to protect critical sections
 #define USE_MUTEX
 
-//Number of files that can be opened simultaneously
+//Number of files that can be opened simultaneously, handles come from a free list: raising
+//it costs a lfs_file_t per file but no search time
 #ifndef FS_MAX_FILES
     #define FS_MAX_FILES 3
-#elif (FS_MAX_FILES < 1)
+#elif (FS_MAX_FILES < 1) || (FS_MAX_FILES > 254)
     #error FS_MAX_FILES parameter is not valid
 #endif
 
+//Number of files opened with FS_FILE_MODE_CREATE | FS_FILE_MODE_TRUNC for writing that are
+//streamed at once: the writes are staged in a buffer of FS_STREAM_CHUNK_SIZE bytes and littlefs
+//programs the file a block at a time. Further such files are written as usual.
+#ifndef FS_STREAM_MAX_FILES
+    #define FS_STREAM_MAX_FILES 1
+#elif (FS_STREAM_MAX_FILES < 1) || (FS_STREAM_MAX_FILES > FS_MAX_FILES)
+    #error FS_STREAM_MAX_FILES parameter is not valid
+#endif
+
+#ifndef FS_STREAM_CHUNK_SIZE
+    #define FS_STREAM_CHUNK_SIZE LITTLEFS_BLOCK_SIZE
+#endif
+
+//Longest path of a streamed file, it is kept so that the size of the file can be reported while
+//it is written; a file with a longer path is written as usual
+#ifndef FS_STREAM_PATH_LEN
+    #define FS_STREAM_PATH_LEN 255
+#endif
+
+//A streamed file is committed every this many bytes, so a broken transfer keeps what came
+//before; 0 commits it at close only
+#ifndef FS_STREAM_SYNC_SIZE
+    #define FS_STREAM_SYNC_SIZE 0
+#endif
+
 //Number of directories that can be opened simultaneously
 #ifndef FS_MAX_DIRS
     #define FS_MAX_DIRS 3
-#elif (FS_MAX_DIRS < 1)
+#elif (FS_MAX_DIRS < 1) || (FS_MAX_DIRS > 254)
     #error FS_MAX_DIRS parameter is not valid
 #endif
 
@@ -44,6 +71,20 @@ typedef void FsFile;
  **/
 typedef void FsDir;
 
+/**
+ * @brief Use of the file and directory pools
+ **/
+typedef struct
+{
+    uint32_t arenaSize;     // bytes of file and stage buffers reserved for FS_MAX_FILES files
+    uint8_t filesOpen;
+    uint8_t filesPeak;      // most files open at once since fsInit(), the high-water mark of the arena
+    uint8_t streamsOpen;    // files written through a stage buffer
+    uint8_t streamsPeak;
+    uint8_t dirsOpen;
+    uint8_t dirsPeak;
+} FsPoolStats_s;
+
 
 //File system abstraction layer
 error_t fsInit(void);
@@ -68,6 +109,8 @@ FsDir *fsOpenDir(const char_t *path);
 error_t fsReadDir(FsDir *dir, FsDirEntry *dirEntry);
 void fsCloseDir(FsDir *dir);
 
+void fsGetPoolStats(FsPoolStats_s *stats);
+
 
 #ifdef __cplusplus
 } /* extern "C" */
@@ -9,6 +9,7 @@
 #include "fs_port_custom.h"
 
 #include "error.h"
+#include "littlefs_startup.h"
 
 // module print level
 //#define TRACE_LEVEL     TRACE_LEVEL_VERBOSE
@@ -17,18 +18,203 @@
 #include "debug.h"
 
 
-//File system objects
-static lfs_t        fs;
-static lfs_file_t   fileTable[FS_MAX_FILES];
-static lfs_dir_t    dirTable[FS_MAX_DIRS];
+// Handles given to the FTP server are not pointers but slot index + 1 in the low bits and the
+// slot generation above them. The generation is bumped on every close, so a handle that was
+// closed already, or belongs to a slot reused since, is caught instead of hitting another file.
+// Only a handle from exactly a generation wrap ago, 2^24 closes of the slot on the target, would pass.
+#define FS_HANDLE_INDEX_BITS    8
+#define FS_HANDLE_INDEX_MASK    ((1u << FS_HANDLE_INDEX_BITS) - 1)
+#ifndef FS_HANDLE_GEN_MASK
+    #define FS_HANDLE_GEN_MASK  (UINTPTR_MAX >> FS_HANDLE_INDEX_BITS)     // narrower in tests of the wrap
+#endif
+#define FS_HANDLE_NONE          0xFF            // ends the free list
 
-// flash chip configuration
-extern const struct lfs_config cfg;
+typedef struct
+{
+    uintptr_t generation;
+    uint8_t nextFree;                           // next slot of the free list while unused
+    uint8_t inUse;
+} FsHandleSlot_s;
 
-//Mutex that protects critical sections
+// Free list of slots, allocation and release take no scan
+typedef struct
+{
+    FsHandleSlot_s *slot;
+    uint8_t count;
+    uint8_t freeHead;
+    uint8_t used;
+    uint8_t peak;                               // most slots used at once
+} FsHandlePool_s;
+
+//File system objects, the mount itself belongs to the littlefs service (littlefs_startup.c)
+static lfs_file_t       fileTable[FS_MAX_FILES];
+static FsHandleSlot_s   fileSlot[FS_MAX_FILES];
+static FsHandlePool_s   filePool = { fileSlot, FS_MAX_FILES, FS_HANDLE_NONE, 0, 0 };
+// File buffers, one per slot, so opening a file never allocates
+static uint8_t          fileArena[FS_MAX_FILES][LITTLEFS_CACHE_SIZE];
+static struct lfs_file_config fileCfg[FS_MAX_FILES];
+//Stage buffers of files streamed in, see FS_STREAM_MAX_FILES
+typedef struct
+{
+    size_t length;                              // bytes staged in the buffer
+    uint32_t unsynced;                          // bytes written since the last sync
+    uint8_t file;                               // file slot streamed
+    char_t path[FS_STREAM_PATH_LEN + 1];        // path it was opened with
+} FsStream_s;
+
+static uint8_t          fileStream[FS_MAX_FILES];   // stream slot of each file, FS_HANDLE_NONE if none
+static FsStream_s       streamTable[FS_STREAM_MAX_FILES];
+static FsHandleSlot_s   streamSlot[FS_STREAM_MAX_FILES];
+static FsHandlePool_s   streamPool = { streamSlot, FS_STREAM_MAX_FILES, FS_HANDLE_NONE, 0, 0 };
+static uint8_t          streamArena[FS_STREAM_MAX_FILES][FS_STREAM_CHUNK_SIZE];
+static lfs_dir_t        dirTable[FS_MAX_DIRS];
+static FsHandleSlot_s   dirSlot[FS_MAX_DIRS];
+static FsHandlePool_s   dirPool = { dirSlot, FS_MAX_DIRS, FS_HANDLE_NONE, 0, 0 };
+
+//Mutex that protects the handle pools and the staged length of a stream while it is flushed,
+//littlefs calls are serialized by the service
 static OsMutex fsMutex;
 
 
+static void a_fsPoolInit(FsHandlePool_s *pool)
+{
+    uint8_t i;
+
+    for (i = 0; i < pool->count; i++)
+    {
+        pool->slot[i].generation = 1;
+        pool->slot[i].inUse = 0;
+        pool->slot[i].nextFree = ((i + 1) < pool->count) ? (i + 1) : FS_HANDLE_NONE;
+    }
+    pool->freeHead = 0;
+    pool->used = 0;
+    pool->peak = 0;
+}
+
+// Take a free slot, FS_HANDLE_NONE if all are in use
+static uint8_t a_fsPoolAlloc(FsHandlePool_s *pool)
+{
+    uint8_t i;
+
+#ifdef USE_MUTEX
+    osAcquireMutex(&fsMutex);
+#endif
+    i = pool->freeHead;
+    if (FS_HANDLE_NONE != i)
+    {
+        pool->freeHead = pool->slot[i].nextFree;
+        pool->slot[i].inUse = 1;
+        if (++pool->used > pool->peak)
+        {
+            pool->peak = pool->used;
+        }
+    }
+#ifdef USE_MUTEX
+    osReleaseMutex(&fsMutex);
+#endif
+    return i;
+}
+
+// Give a slot back, every handle to it becomes stale
+static void a_fsPoolFree(FsHandlePool_s *pool, uint8_t i)
+{
+#ifdef USE_MUTEX
+    osAcquireMutex(&fsMutex);
+#endif
+    pool->slot[i].generation = (pool->slot[i].generation + 1) & FS_HANDLE_GEN_MASK;
+    if (0 == pool->slot[i].generation)
+    {
+        pool->slot[i].generation = 1;
+    }
+    pool->slot[i].inUse = 0;
+    pool->slot[i].nextFree = pool->freeHead;
+    pool->freeHead = i;
+    pool->used--;
+#ifdef USE_MUTEX
+    osReleaseMutex(&fsMutex);
+#endif
+}
+
+static void *a_fsPoolHandle(const FsHandlePool_s *pool, uint8_t i)
+{
+    return (void *)((pool->slot[i].generation << FS_HANDLE_INDEX_BITS) | (uintptr_t)(i + 1));
+}
+
+// Slot of a handle, FS_HANDLE_NONE if the handle is invalid or stale. A handle is used by
+// one task at a time, so its slot cannot be released while it is looked up.
+static uint8_t a_fsPoolLookup(const FsHandlePool_s *pool, const void *handle)
+{
+    uintptr_t h = (uintptr_t)handle;
+    uintptr_t i = (h & FS_HANDLE_INDEX_MASK) - 1;
+
+    if ((i >= pool->count) || !pool->slot[i].inUse || (pool->slot[i].generation != (h >> FS_HANDLE_INDEX_BITS)))
+    {
+        return FS_HANDLE_NONE;
+    }
+    return (uint8_t)i;
+}
+
+// Hand the staged bytes of a streamed file to littlefs, sync every FS_STREAM_SYNC_SIZE bytes
+static error_t a_fsStreamFlush(uint8_t i)
+{
+    FsStream_s *stream = &streamTable[fileStream[i]];
+    uint8_t res;
+
+    if (0 == stream->length)
+        return NO_ERROR;
+
+    //The bytes move from the stage to littlefs at once for a size taken meanwhile
+#ifdef USE_MUTEX
+    osAcquireMutex(&fsMutex);
+#endif
+    res = Littlefs_FileWriteStream(&fileTable[i], streamArena[fileStream[i]], stream->length);
+    if (0 == res)
+    {
+        stream->unsynced += stream->length;
+        stream->length = 0;
+    }
+#ifdef USE_MUTEX
+    osReleaseMutex(&fsMutex);
+#endif
+    if (0 != res)
+        return ERROR_FAILURE;
+
+    if ((0 != FS_STREAM_SYNC_SIZE) && (stream->unsynced >= FS_STREAM_SYNC_SIZE))
+    {
+        if (0 != Littlefs_FileSync(&fileTable[i]))
+            return ERROR_FAILURE;
+        stream->unsynced = 0;
+    }
+    return NO_ERROR;
+}
+
+// Size of a file being streamed in: what littlefs holds, committed or not, and what is staged.
+// Returns FALSE if no stream has the path open.
+static bool_t a_fsStreamSize(const char_t *path, uint32_t *size)
+{
+    bool_t found = FALSE;
+    uint8_t s;
+
+#ifdef USE_MUTEX
+    osAcquireMutex(&fsMutex);
+#endif
+    for (s = 0; (s < FS_STREAM_MAX_FILES) && !found; s++)
+    {
+        if (streamSlot[s].inUse && !osStrcmp(streamTable[s].path, path))
+        {
+            //The stream slot is released before its file is closed, it cannot go away here
+            found = (0 == Littlefs_FileSize(&fileTable[streamTable[s].file], size)) ? TRUE : FALSE;
+            if (found)
+                *size += (uint32_t)streamTable[s].length;
+        }
+    }
+#ifdef USE_MUTEX
+    osReleaseMutex(&fsMutex);
+#endif
+    return found;
+}
+
+
 /**
  * @brief File system initialization
  * @return Error code
@@ -36,11 +222,20 @@ static OsMutex fsMutex;
 error_t fsInit(void)
 {
     TRACE_DEBUG("..........fsInit(void)..........\r\n");
-    int res = 0;
+    uint_t i = 0;
 
     //Clear file system objects
     osMemset(fileTable, 0, sizeof(fileTable));
     osMemset(dirTable, 0, sizeof(dirTable));
+    a_fsPoolInit(&filePool);
+    a_fsPoolInit(&dirPool);
+    a_fsPoolInit(&streamPool);
+    for(i = 0; i < FS_MAX_FILES; i++)
+    {
+        osMemset(&fileCfg[i], 0, sizeof(fileCfg[i]));
+        fileCfg[i].buffer = fileArena[i];
+        fileStream[i] = FS_HANDLE_NONE;
+    }
 
     //Create a mutex to protect critical sections
     if(!osCreateMutex(&fsMutex))
@@ -49,74 +244,15 @@ error_t fsInit(void)
         return ERROR_OUT_OF_RESOURCES;
     }
 
-    //Mount file system
-    res = lfs_mount(&fs, &cfg);
-
-    // reformat if we can't mount the filesystem, this should only happen on the first boot
-    if (LFS_ERR_OK != res)
-    {
-        res = lfs_format(&fs, &cfg);           
-        res = lfs_mount(&fs, &cfg);
-    }
-
-    //Failed to mount file system?
-    if(LFS_ERR_OK != res)
+    //The filesystem is mounted once at boot, this only mounts it if nobody did yet
+    if(0 != Littlefs_Startup())
     {
         //Clean up side effects
         osDeleteMutex(&fsMutex);
         //Report an error
         return ERROR_FAILURE;
     }
-    
-#if 0     
-    //Create test directory:
-    res = lfs_mkdir(&fs, "/test"); // Returns a negative error code on failure.
-    if (res < 0)
-    {
-        TRACE_ERROR("ftp_server_startup: lfs_mkdir(/test) ERROR!!: %d\r\n", res);
-    } 
-    res = lfs_mkdir(&fs, "foobar"); // Returns a negative error code on failure.
-    if (res < 0)
-    {
-        TRACE_ERROR("ftp_server_startup: lfs_mkdir(foobar) ERROR!!: %d\r\n", res);
-    }
-#endif   
-    
-    //osDelayTask(1000);
-    
-    // read current count
-    uint32_t boot_count = 0;
-    lfs_file_t file = { 0 };
-     
-    lfs_file_open(&fs, &file, "boots.txt", LFS_O_RDWR | LFS_O_CREAT);
-    lfs_file_read(&fs, &file, &boot_count, sizeof(boot_count));
-
-    // update boot count
-    boot_count += 1;
-    lfs_file_rewind(&fs, &file);
-    lfs_file_write(&fs, &file, &boot_count, sizeof(boot_count));
-
-    // remember the storage is not updated until the file is closed successfully
-    lfs_file_close(&fs, &file);
-
-    // print the boot count
-    TRACE_DEBUG("littlefs: boot_count: %d\r\n", boot_count);
-    
-    struct lfs_fsinfo fsInfo = { 0 };
-    // Fills out the fsinfo structure based on the filesystem found on-disk. Returns a negative error code on failure.
-    res = lfs_fs_stat(&fs, &fsInfo);
-    if (0 == res)
-    {
-        TRACE_DEBUG("FILESYSTEM: Total logical blocks=%d; block size=%d(Bytes); total size=%d(Bytes)\r\n", fsInfo.block_count, fsInfo.block_size, fsInfo.block_count * fsInfo.block_size);
-    }
-    // Returns the number of allocated blocks, or a negative error code on failure.
-    res =  lfs_fs_size(&fs);
-    if (res >= 0)
-    {
-        TRACE_DEBUG("FILESYSTEM: Allocated logical blocks=%d; block size=%d(Bytes); total allocated size=%d(Bytes)\r\n", res, fsInfo.block_size, res * fsInfo.block_size);
-    }
-    
-    
+
     //Successful processing
     return NO_ERROR;
 }
@@ -131,35 +267,13 @@ error_t fsInit(void)
 bool_t fsFileExists(const char_t *path)
 {
     TRACE_VERBOSE("..........fsFileExists(%s)..........\r\n", path);
-    int32_t res = 0;
-    struct lfs_info info = { 0 };
 
     //Make sure the pathname is valid
     if(NULL == path)
         return FALSE;
     
-#ifdef USE_MUTEX
-    //Enter critical section
-    osAcquireMutex(&fsMutex);
-#endif
-    
-    //Check whether the file exists
-    res = lfs_stat(&fs, (const char *)path, &info); // Returns a negative error code on failure.
-
-#ifdef USE_MUTEX    
-    //Leave critical section
-    osReleaseMutex(&fsMutex);
-#endif
-
-    //Any error to report?
-    if(LFS_ERR_OK != res)
-        return FALSE;
-
-    //Valid file?
-    if(LFS_TYPE_REG == info.type)
-      return TRUE;
-    
-    return FALSE;
+    //Check whether a regular file exists
+    return Littlefs_FileExists((const char *)path) ? TRUE : FALSE;
 }
 
 
@@ -173,63 +287,54 @@ bool_t fsFileExists(const char_t *path)
 FsFile *fsOpenFile(const char_t *path, uint_t mode)
 {
     TRACE_VERBOSE("..........fsOpenFile(%s, mode=%x)..........\r\n", path, mode);
-    uint_t i = 0;
+    uint8_t i = 0;
     uint_t flags = 0;
-    int32_t res = 0;
-
-   //File pointer
-   lfs_file_t *file = NULL;
 
    //Make sure the pathname is valid
    if(NULL == path)
       return NULL;
 
-#ifdef USE_MUTEX
-    //Enter critical section
-    osAcquireMutex(&fsMutex);
-#endif
-
-   //Loop through the file objects
-   for(i = 0; i < FS_MAX_FILES; i++)
-   {
-      //Unused file object found?
-      if(0 == fileTable[i].id) // TODO: is this a proper way to find empty slot for file handle??? .ctz.size
-      {
-         //Default access mode
-         flags = 0;
-
-         //Check access mode
-         if(mode & FS_FILE_MODE_READ)
-            flags |= LFS_O_RDONLY;
+   //Take a free file object
+   i = a_fsPoolAlloc(&filePool);
+   if(FS_HANDLE_NONE == i)
+      return NULL;
 
-         if(mode & FS_FILE_MODE_WRITE)
-            flags |= LFS_O_WRONLY;
+   //Check access mode
+   if(mode & FS_FILE_MODE_READ)
+      flags |= LFS_O_RDONLY;
 
-         if(mode & FS_FILE_MODE_CREATE)
-            flags |= LFS_O_CREAT;
+   if(mode & FS_FILE_MODE_WRITE)
+      flags |= LFS_O_WRONLY;
 
-         if(mode & FS_FILE_MODE_TRUNC)
-            flags |= LFS_O_TRUNC;
+   if(mode & FS_FILE_MODE_CREATE)
+      flags |= LFS_O_CREAT;
 
-         //Open the specified file
-         res = lfs_file_open(&fs, (lfs_file_t*)&fileTable[i], (const char *)path, flags);
+   if(mode & FS_FILE_MODE_TRUNC)
+      flags |= LFS_O_TRUNC;
 
-         //Check status code
-         if(LFS_ERR_OK == res)
-            file = &fileTable[i];
+   //Open the specified file
+   if(0 != Littlefs_FileOpenCfg(&fileTable[i], (const char *)path, (int)flags, &fileCfg[i]))
+   {
+      a_fsPoolFree(&filePool, i);
+      return NULL;
+   }
 
-         //Stop immediately
-         break;
+   //A new file written from the start is streamed in whole blocks, if a stage buffer is free
+   if(((mode & (FS_FILE_MODE_READ | FS_FILE_MODE_WRITE | FS_FILE_MODE_CREATE | FS_FILE_MODE_TRUNC)) ==
+      (FS_FILE_MODE_WRITE | FS_FILE_MODE_CREATE | FS_FILE_MODE_TRUNC)) && (osStrlen(path) <= FS_STREAM_PATH_LEN))
+   {
+      fileStream[i] = a_fsPoolAlloc(&streamPool);
+      if(FS_HANDLE_NONE != fileStream[i])
+      {
+         streamTable[fileStream[i]].length = 0;
+         streamTable[fileStream[i]].unsynced = 0;
+         streamTable[fileStream[i]].file = i;
+         osStrcpy(streamTable[fileStream[i]].path, path);
       }
    }
 
-#ifdef USE_MUTEX    
-    //Leave critical section
-    osReleaseMutex(&fsMutex);
-#endif
-   
    //Return a handle to the file
-   return file;
+   return a_fsPoolHandle(&filePool, i);
 }
 
 
@@ -240,25 +345,26 @@ FsFile *fsOpenFile(const char_t *path, uint_t mode)
 void fsCloseFile(FsFile *file)
 {
     TRACE_VERBOSE("..........fsCloseFile(file=%p)..........\r\n", file);
-    //Make sure the file pointer is valid
-    if(NULL == file)
+    uint8_t i = a_fsPoolLookup(&filePool, file);
+
+    //Make sure the file handle is valid
+    if(FS_HANDLE_NONE == i)
        return;
-   
-#ifdef USE_MUTEX
-    //Enter critical section
-    osAcquireMutex(&fsMutex);
-#endif
+
+    //Write what is staged, the close commits it
+    if(FS_HANDLE_NONE != fileStream[i])
+    {
+        if(NO_ERROR != a_fsStreamFlush(i))
+            TRACE_ERROR("fsCloseFile: streamed data lost\r\n");
+        a_fsPoolFree(&streamPool, fileStream[i]);
+        fileStream[i] = FS_HANDLE_NONE;
+    }
 
     //Close the specified file
-    (void)lfs_file_close(&fs, (lfs_file_t*)file);
-    
-    //TODO: ?? Mark the corresponding entry as free file->... = NULL???
-    osMemset(file, 0, sizeof(lfs_file_t));
+    Littlefs_FileClose(&fileTable[i]);
 
-#ifdef USE_MUTEX    
-    //Leave critical section
-    osReleaseMutex(&fsMutex);
-#endif
+    //Mark the corresponding entry as free
+    a_fsPoolFree(&filePool, i);
 }
 
 
@@ -271,35 +377,18 @@ void fsCloseFile(FsFile *file)
 error_t fsGetFileSize(const char_t *path, uint32_t *size)
 {
     TRACE_VERBOSE("..........fsGetFileSize(%s, )..........\r\n", path);
-    int32_t res = 0;
-    struct lfs_info fileInfo = { 0 };
-    //void *file = NULL;
     
     //Check parameters
     if((NULL == path) || (NULL == size))
         return ERROR_INVALID_PARAMETER;
 
-#ifdef USE_MUTEX
-    //Enter critical section
-    osAcquireMutex(&fsMutex);
-#endif
-    
-    // Fills out the info structure, based on the specified file or directory. Returns a negative error code on failure.
-    res = lfs_stat(&fs, path, &fileInfo);
-    //res = lfs_file_size(&fs, file);   // Returns the size of the file, or a negative error code on failure.
-    
-#ifdef USE_MUTEX    
-    //Leave critical section
-    osReleaseMutex(&fsMutex);
-#endif
-    
-    if (res < 0)
-        return ERROR_FAILURE;              // error
-    
-    if (LFS_TYPE_DIR == fileInfo.type)
-        return ERROR_FAILURE;              // this is not a file but a directory
-    
-    *size = fileInfo.size;
+    //A file being streamed in has more than its last commit
+    if (a_fsStreamSize(path, size))
+        return NO_ERROR;
+
+    // fails for directories, they have no size
+    if (0 != Littlefs_FileSizeGet(path, size))
+        return ERROR_FAILURE;
     
     TRACE_VERBOSE("..........fsGetFileSize(%s,...) = %d..........\r\n", path, *size);
     
@@ -316,28 +405,15 @@ error_t fsGetFileSize(const char_t *path, uint32_t *size)
 error_t fsGetFileStat(const char_t *path, FsFileStat *fileStat)
 {
     TRACE_VERBOSE("..........fsGetFileStat(%s,...)..........\r\n", path);
-    int32_t res = 0;
     struct lfs_info info = { 0 };
+    uint32_t size = 0;
 
     //Check parameters
     if((NULL == path) || (NULL == fileStat))
         return ERROR_INVALID_PARAMETER;
 
-#ifdef USE_MUTEX
-    //Enter critical section
-    osAcquireMutex(&fsMutex);
-#endif
-
     //Retrieve information about the specified file
-    res = lfs_stat(&fs, path, &info);
-    
-#ifdef USE_MUTEX    
-    //Leave critical section
-    osReleaseMutex(&fsMutex);
-#endif
-
-   //Any error to report?
-   if(LFS_ERR_OK != res)
+   if(0 != Littlefs_FileStatGet(path, &info))
       return ERROR_FAILURE;
 
    //Clear file attributes
@@ -352,8 +428,10 @@ error_t fsGetFileStat(const char_t *path, FsFileStat *fileStat)
    {
        fileStat->attributes = 0x10; // FOR DIRECTORIES!!??
    }    
-   //File size
+   //File size, a file being streamed in has more than its last commit
    fileStat->size = info.size;
+   if((LFS_TYPE_REG == info.type) && a_fsStreamSize(path, &size))
+      fileStat->size = size;
 
    //TODO: Set time of last modification here
    //TODO: Make sure the date is valid
@@ -377,27 +455,13 @@ error_t fsRenameFile(const char_t *oldPath, const char_t *newPath)
     //Read-only configuration
     return ERROR_READ_ONLY_ACCESS;
 #else
-    int32_t res = 0;
 
     //Check parameters
     if((NULL == oldPath) || (NULL == newPath))
         return ERROR_INVALID_PARAMETER;
 
-#ifdef USE_MUTEX
-    //Enter critical section
-    osAcquireMutex(&fsMutex);
-#endif
-
     //Rename the specified file
-    res = lfs_rename(&fs, oldPath, newPath);
-
-#ifdef USE_MUTEX    
-    //Leave critical section
-    osReleaseMutex(&fsMutex);
-#endif
-
-    //Any error to report?
-    if(LFS_ERR_OK != res)
+    if(0 != Littlefs_FileRename(oldPath, newPath))
         return ERROR_FAILURE;
 
     //Successful processing
@@ -418,27 +482,13 @@ error_t fsDeleteFile(const char_t *path)
     //Read-only configuration
     return ERROR_READ_ONLY_ACCESS;
 #else
-    int32_t res = 0;
 
     //Check parameters
     if(NULL == path)
         return ERROR_INVALID_PARAMETER;
 
-#ifdef USE_MUTEX
-    //Enter critical section
-    osAcquireMutex(&fsMutex);
-#endif
-
     //Delete the specified file
-    res = lfs_remove(&fs, path);
-
-#ifdef USE_MUTEX    
-    //Leave critical section
-    osReleaseMutex(&fsMutex);
-#endif
-
-    //Any error to report?
-    if(LFS_ERR_OK != res)
+    if(0 != Littlefs_FileDelete(path))
         return ERROR_FAILURE;
 
     //Successful processing
@@ -458,18 +508,13 @@ error_t fsDeleteFile(const char_t *path)
 error_t fsSeekFile(FsFile *file, int_t offset, uint_t origin)
 {
     TRACE_VERBOSE("..........fsSeekFile(file=%p, offset=%d, origin=%d).........\r\n", file, offset, origin);
-    int32_t res = 0;
     int32_t whence = FS_SEEK_SET;
+    uint8_t i = a_fsPoolLookup(&filePool, file);
 
     //Check parameters
-    if(NULL == file)
+    if(FS_HANDLE_NONE == i)
         return ERROR_INVALID_PARAMETER;
 
-#ifdef USE_MUTEX
-    //Enter critical section
-    osAcquireMutex(&fsMutex);
-#endif
-
     //Find whence flag
     if(FS_SEEK_CUR == origin)
     {
@@ -484,19 +529,12 @@ error_t fsSeekFile(FsFile *file, int_t offset, uint_t origin)
         //The offset is absolute
     }
 
-    //Move read/write pointer
-    // Returns the new position of the file, or a negative error code on failure.
-    res = lfs_file_seek(&fs, (lfs_file_t*)file, (lfs_soff_t)offset, whence);
+    //Staged data goes before the pointer moves
+    if((FS_HANDLE_NONE != fileStream[i]) && (NO_ERROR != a_fsStreamFlush(i)))
+        return ERROR_FAILURE;
 
-#ifdef USE_MUTEX    
-    //Leave critical section
-    osReleaseMutex(&fsMutex);
-#endif
-    
-    TRACE_VERBOSE("..........lfs_file_seek(file=%p, offset=%d, whence=%d)=%d.........\r\n", file, offset, whence, res);
-    
-    //Any error to report?
-    if(res < 0)
+    //Move read/write pointer
+    if(0 != Littlefs_FileSeek(&fileTable[i], (int32_t)offset, whence))
         return ERROR_FAILURE;
 
     //Successful processing
@@ -518,33 +556,33 @@ error_t fsWriteFile(FsFile *file, void *data, size_t length)
     //Read-only configuration
     return ERROR_READ_ONLY_ACCESS;
 #else
-    
+    uint8_t i = a_fsPoolLookup(&filePool, file);
+    FsStream_s *stream;
+    size_t n;
+
     //Check parameters
-    if(NULL == file)
+    if(FS_HANDLE_NONE == i)
         return ERROR_INVALID_PARAMETER;
-   
-    int32_t res = 0;
-    
-#ifdef USE_MUTEX
-    //Enter critical section
-    osAcquireMutex(&fsMutex);
-#endif
-
-    //Write data
-    // Returns the number of bytes written, or a negative error code on failure.
-    res = lfs_file_write(&fs, (lfs_file_t *)file, (const void *)data, (lfs_size_t)length);
 
-#ifdef USE_MUTEX    
-    //Leave critical section
-    osReleaseMutex(&fsMutex);
-#endif
-
-    //Any error to report?
-    if(res < 0)
-        return ERROR_FAILURE;
+    //Streamed file: stage the data, littlefs gets it a block at a time
+    if(FS_HANDLE_NONE != fileStream[i])
+    {
+        stream = &streamTable[fileStream[i]];
+        while(length > 0)
+        {
+            n = MIN(length, FS_STREAM_CHUNK_SIZE - stream->length);
+            osMemcpy(streamArena[fileStream[i]] + stream->length, data, n);
+            stream->length += n;
+            data = (uint8_t *)data + n;
+            length -= n;
+            if((FS_STREAM_CHUNK_SIZE == stream->length) && (NO_ERROR != a_fsStreamFlush(i)))
+                return ERROR_FAILURE;
+        }
+        return NO_ERROR;
+    }
 
-    //Sanity check
-    if(res != length)
+    //Write data, a short write is reported as an error
+    if(0 != Littlefs_FileWrite(&fileTable[i], (const void *)data, length))
         return ERROR_FAILURE;
 
     //Successful processing
@@ -564,39 +602,23 @@ error_t fsWriteFile(FsFile *file, void *data, size_t length)
 error_t fsReadFile(FsFile *file, void *data, size_t size, size_t *length)
 {
     TRACE_VERBOSE("..........fsReadFile(file=%p, ..., size=%d, ...).........\r\n", file, size);
-    int32_t res = 0;
+    uint8_t i = a_fsPoolLookup(&filePool, file);
 
     //Check parameters
-    if((NULL == file) || (NULL == length))
+    if((FS_HANDLE_NONE == i) || (NULL == length))
         return ERROR_INVALID_PARAMETER;
 
     //No data has been read yet
     *length = 0;
 
-#ifdef USE_MUTEX
-    //Enter critical section
-    osAcquireMutex(&fsMutex);
-#endif
-
     //Read data
-    // Returns the number of bytes read, or a negative error code on failure.
-    res = lfs_file_read(&fs, (lfs_file_t *)file, (void *)data, (lfs_size_t)size);
-
-#ifdef USE_MUTEX    
-    //Leave critical section
-    osReleaseMutex(&fsMutex);
-#endif
-
-    //Any error to report?
-    if(res < 0)
+    if(0 != Littlefs_FileRead(&fileTable[i], data, size, length))
         return ERROR_FAILURE;
 
     //EOF?
-    if(0 == res)
+    if(0 == *length)
         return ERROR_END_OF_FILE;
 
-    //Total number of data that have been read
-    *length = res;
     TRACE_VERBOSE("..........fsReadFile(file=%p, ..., size=%d, length=%d).........\r\n", file, size, *length);
     
     //Successful processing
@@ -613,8 +635,6 @@ error_t fsReadFile(FsFile *file, void *data, size_t size, size_t *length)
 bool_t fsDirExists(const char_t *path)
 {
     TRACE_VERBOSE("..........fsDirExists(%s).........\r\n", path);
-    int32_t res = 0;
-    struct lfs_info info = { 0 };
 
     //Make sure the pathname is valid
     if(NULL == path)
@@ -624,28 +644,8 @@ bool_t fsDirExists(const char_t *path)
     if(!osStrcmp(path, "/"))
         return TRUE;
 
-#ifdef USE_MUTEX
-    //Enter critical section
-    osAcquireMutex(&fsMutex);
-#endif
-
-    //Check whether the file exists
-    res = lfs_stat(&fs, (const char *)path, &info); // Returns a negative error code on failure.
-
-#ifdef USE_MUTEX    
-    //Leave critical section
-    osReleaseMutex(&fsMutex);
-#endif
-
-    //Any error to report?
-    if(LFS_ERR_OK != res)
-        return FALSE;
-
-    //Valid directory?
-    if(LFS_TYPE_DIR == info.type)
-      return TRUE;
-    
-    return FALSE;
+    //Check whether a directory exists
+    return Littlefs_DirExists((const char *)path) ? TRUE : FALSE;
 }
 
 
@@ -665,24 +665,9 @@ error_t fsCreateDir(const char_t *path)
     //Check parameters
     if(NULL == path)
         return ERROR_INVALID_PARAMETER;
-   
-    int32_t res = 0;
-    
-#ifdef USE_MUTEX
-    //Enter critical section
-    osAcquireMutex(&fsMutex);
-#endif
 
     //Create a new directory
-    res = lfs_mkdir(&fs, path); // Returns a negative error code on failure
-
-#ifdef USE_MUTEX    
-    //Leave critical section
-    osReleaseMutex(&fsMutex);
-#endif
-
-    //Any error to report?
-    if(LFS_ERR_OK != res)
+    if(0 != Littlefs_DirCreate(path))
         return ERROR_FAILURE;
 
     //Successful processing
@@ -706,24 +691,9 @@ error_t fsRemoveDir(const char_t *path)
     //Check parameters
     if(NULL == path)
         return ERROR_INVALID_PARAMETER;
-   
-    int32_t res = 0;
-    
-#ifdef USE_MUTEX
-    //Enter critical section
-    osAcquireMutex(&fsMutex);
-#endif
-
-    //Remove the specified directory
-    res = lfs_remove(&fs, path); // If removing a directory, the directory must be empty. Returns a negative error code on failure.
-
-#ifdef USE_MUTEX    
-    //Leave critical section
-    osReleaseMutex(&fsMutex);
-#endif
 
-    //Any error to report?
-    if(LFS_ERR_OK != res)
+    //Remove the specified directory, it must be empty
+    if(0 != Littlefs_DirRemove(path))
         return ERROR_FAILURE;
 
     //Successful processing
@@ -740,46 +710,26 @@ error_t fsRemoveDir(const char_t *path)
 FsDir *fsOpenDir(const char_t *path)
 {
     TRACE_VERBOSE("..........fsOpenDir(%s).........\r\n", path);
-    //Directory pointer
-    FsDir *dir = NULL;
+    uint8_t i = 0;
 
     //Check parameters
     if(NULL == path)
-        return ERROR_INVALID_PARAMETER;
-   
-    int32_t res = 0;
-    uint32_t i = 0;
+        return NULL;
 
-#ifdef USE_MUTEX
-    //Enter critical section
-    osAcquireMutex(&fsMutex);
-#endif
+    //Take a free directory object
+    i = a_fsPoolAlloc(&dirPool);
+    if(FS_HANDLE_NONE == i)
+        return NULL;
 
-   //Loop through the directory objects
-    for(i = 0; i < FS_MAX_DIRS; i++)
+    //Open the specified directory
+    if(0 != Littlefs_DirOpen(path, &dirTable[i]))
     {
-        //Unused directory object found?
-        if(0 == dirTable[i].id) // TODO: is this a proper way to find out..?
-        {
-            //Open the specified directory
-            res = lfs_dir_open(&fs, (lfs_dir_t*)&dirTable[i], path); // Returns a negative error code on failure.
-
-            //Check status code
-            if(LFS_ERR_OK == res)
-                dir = &dirTable[i];
-
-            //Stop immediately
-            break;
-        }
+        a_fsPoolFree(&dirPool, i);
+        return NULL;
     }
 
-#ifdef USE_MUTEX    
-    //Leave critical section
-    osReleaseMutex(&fsMutex);
-#endif
-    
     //Return a handle to the directory
-    return dir;
+    return a_fsPoolHandle(&dirPool, i);
 }
 
 
@@ -792,32 +742,22 @@ FsDir *fsOpenDir(const char_t *path)
 error_t fsReadDir(FsDir *dir, FsDirEntry *dirEntry)
 {  
     TRACE_VERBOSE("..........fsReadDir(dir=%p, ...).........\r\n", dir);
-    int32_t res = 0;
+    uint8_t res = 0;
     struct lfs_info lfsDirEntry = { 0 };
     size_t n = 0;
+    uint8_t i = a_fsPoolLookup(&dirPool, dir);
 
-    //Make sure the directory pointer is valid
-    if(NULL == dir)
+    //Make sure the directory handle is valid
+    if(FS_HANDLE_NONE == i)
         return ERROR_INVALID_PARAMETER;
 
-#ifdef USE_MUTEX
-    //Enter critical section
-    osAcquireMutex(&fsMutex);
-#endif
-
     //Read the specified directory
-    // Fills out the info structure, based on the specified file or directory. Returns a positive value on success, 0 at the end of directory, or a negative error code on failure.
-    res = lfs_dir_read(&fs, (lfs_dir_t *)dir, &lfsDirEntry);
-
-#ifdef USE_MUTEX    
-    //Leave critical section
-    osReleaseMutex(&fsMutex);
-#endif
+    res = Littlefs_DirRead(&dirTable[i], &lfsDirEntry);
 
     //Any error to report?
-    if(res < 0)
+    if(1 == res)
         return ERROR_FAILURE;
-    else if(0 == res)   //End of the directory stream? if(fno.fname[0] == '\0')
+    else if(2 == res)   //End of the directory stream?
         return ERROR_END_OF_STREAM;
 
     //File attributes
@@ -862,24 +802,37 @@ error_t fsReadDir(FsDir *dir, FsDirEntry *dirEntry)
 void fsCloseDir(FsDir *dir)
 {
     TRACE_VERBOSE("..........fsCloseDir(dir=%p).........\r\n", dir);
-    //Make sure the directory pointer is valid
-    if(NULL == dir)
+    uint8_t i = a_fsPoolLookup(&dirPool, dir);
+
+    //Make sure the directory handle is valid
+    if(FS_HANDLE_NONE == i)
         return;
-    
-#ifdef USE_MUTEX
-    //Enter critical section
-    osAcquireMutex(&fsMutex);
-#endif
 
     //Close the specified directory
-    lfs_dir_close(&fs, (lfs_dir_t *)dir);   // Returns a negative error code on failure.
+    Littlefs_DirClose(&dirTable[i]);
 
     //Mark the corresponding entry as free
-    //((lfs_dir_t *)dir)->id = 0; 
-    osMemset(dir, 0, sizeof(lfs_dir_t));    // TODO: is this a proper way to ..?
+    a_fsPoolFree(&dirPool, i);
+}
+
 
-#ifdef USE_MUTEX    
-    //Leave critical section
+/**
+ * @brief Retrieve the use of the file and directory pools
+ * @param[out] stats Open and peak counts, arena size
+ **/
+void fsGetPoolStats(FsPoolStats_s *stats)
+{
+#ifdef USE_MUTEX
+    osAcquireMutex(&fsMutex);
+#endif
+    stats->arenaSize = sizeof(fileArena) + sizeof(streamArena);
+    stats->filesOpen = filePool.used;
+    stats->filesPeak = filePool.peak;
+    stats->streamsOpen = streamPool.used;
+    stats->streamsPeak = streamPool.peak;
+    stats->dirsOpen = dirPool.used;
+    stats->dirsPeak = dirPool.peak;
+#ifdef USE_MUTEX
     osReleaseMutex(&fsMutex);
-#endif    
+#endif
 }
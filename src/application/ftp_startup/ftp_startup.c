@@ -17,6 +17,8 @@
 #include "ftp/ftp_client.h"
 #include "ftp/ftp_server.h"
 
+#include "w25qxx_startup.h"
+
 #include "debug.h"
 #include "definitions.h"                // SYS function prototypes
 #include "configuration.h"
@@ -97,9 +99,80 @@ uint_t ftpGetFilePermCallback(FtpClientConnection *connection, const char_t *use
     return permission;
 }
 
+// "SITE FLASHSTAT" lists the traced W25Qxx operation counts, "SITE FLASHSTAT <op>" the
+// statistics of one operation (read, program, erase4k, ...). Needs W25QXX_TRACE == 1.
+static void a_FtpSiteFlashStat(FtpClientConnection *connection, const char_t *op)
+{
+    char_t *response = connection->response;
+    size_t size = FTP_SERVER_MAX_LINE_LEN + 1;
+    w25qxx_trace_stats_t stats;
+    size_t n;
+    uint8_t i;
+
+    if (w25qxx_trace_get_stats(&w25q128_handle, W25QXX_TRACE_OP_READ, &stats) != 0)
+    {
+        osStrcpy(response, "502 Flash tracing disabled\r\n");
+        return;
+    }
+    while (*op == ' ')
+    {
+        op++;
+    }
+    if (*op != '\0')
+    {
+        for (i = 0; i < W25QXX_TRACE_OP_MAX; i++)
+        {
+            if (!osStrcasecmp(op, w25qxx_trace_op_name((w25qxx_trace_op_t)i)))
+            {
+                break;
+            }
+        }
+        if (i == W25QXX_TRACE_OP_MAX)
+        {
+            osStrcpy(response, "501 Unknown flash operation\r\n");
+            return;
+        }
+        osStrcpy(response, "211 ");
+        (void)w25qxx_trace_format(&w25q128_handle, (w25qxx_trace_op_t)i, response + 4, size - 6);
+        osStrcat(response, "\r\n");
+        return;
+    }
+    
+    n = snprintf(response, size, "211");
+    for (i = 0; (i < W25QXX_TRACE_OP_MAX) && (n < size - 2); i++)
+    {
+        (void)w25qxx_trace_get_stats(&w25q128_handle, (w25qxx_trace_op_t)i, &stats);
+        n += snprintf(response + n, size - 2 - n, " %s=%lu", w25qxx_trace_op_name((w25qxx_trace_op_t)i), (unsigned long)stats.count);
+    }
+    osStrcat(response, "\r\n");
+}
+
+// "SITE NETSTAT" lists the GMAC reception counters: interrupts, wakeups of the TCP/IP task,
+// passes over the RX ring and frames. Frames per wakeup = rx / wakeups.
+static void a_FtpSiteNetStat(FtpClientConnection *connection)
+{
+    Same54EthStats stats;
+
+    same54EthGetStats(&stats);
+    (void)snprintf(connection->response, FTP_SERVER_MAX_LINE_LEN + 1,
+                   "211 irq=%lu wakeups=%lu polls=%lu rx=%lu budget=%lu maxburst=%lu ovr=%lu bna=%lu\r\n",
+                   (unsigned long)stats.irqCount, (unsigned long)stats.rxWakeups, (unsigned long)stats.rxPolls,
+                   (unsigned long)stats.rxFrames, (unsigned long)stats.rxBudgetExhausted,
+                   (unsigned long)stats.rxMaxFramesPerWakeup, (unsigned long)stats.rxOverruns,
+                   (unsigned long)stats.rxBufferNotAvailable);
+}
+
 error_t ftpUnknownCommandCallback(FtpClientConnection *connection, const char_t *command, const char_t *param)
 {
     //TRACE_DEBUG("***********FTP_CALLBACK: FTP unknown command callback. command = %s, param = %s\r\n", command, param);
+    if (!osStrcasecmp(command, "SITE") && !osStrncasecmp(param, "FLASHSTAT", 9) && ((param[9] == '\0') || (param[9] == ' ')))
+    {
+        a_FtpSiteFlashStat(connection, param + 9);
+    }
+    else if (!osStrcasecmp(command, "SITE") && !osStrcasecmp(param, "NETSTAT"))
+    {
+        a_FtpSiteNetStat(connection);
+    }
     return 0;
 }
 //=========================================================
@@ -0,0 +1,233 @@
+/*
+ * lfs_alloc_snapshot.c
+ *
+ * The snapshot is a fixed block of words in the SmartEEPROM, which needs the
+ * NVMCTRL_SEESBLK/SEEPSZ fuses to give it 1 KB at least, see README.md;
+ * without them every call does nothing and littlefs scans as before. The
+ * magic word is cleared
+ * before anything else is written and set last, so an interrupted save leaves
+ * no valid snapshot. The map is the lfs_fs_traverse() result, open files
+ * included, and it stays right until littlefs programs or erases again:
+ * Lfs_AllocSnapshot_Invalidate() runs before that from the lfs_config
+ * callbacks. Loading it is what lfs_alloc_scan() would do on the first
+ * allocation, starting where the allocator was at the time of the save.
+ *
+ * littlefs has no API for its allocator, so this file reads and writes lfs_t
+ * fields. All of that is in a_Lfs_AllocSnapshot_Lfs(), written against
+ * littlefs 2.9; another version does not build until it was checked again.
+ */
+
+#include "lfs_alloc_snapshot.h"
+#include "lfs_util.h"
+#include "os_port.h"
+#include "device.h"
+#include "peripheral/nvmctrl/plib_nvmctrl.h"
+#include <stddef.h>
+#include <string.h>
+
+
+#if (LFS_VERSION != 0x00020009)
+    #error "lfs_alloc_snapshot.c uses lfs_t internals of littlefs 2.9, check a_Lfs_AllocSnapshot_Lfs() against this version"
+#endif
+
+#define LFS_ALLOC_SNAPSHOT_MAGIC        0x4C465341UL
+#define LFS_ALLOC_SNAPSHOT_MAP_WORDS    ((LFS_ALLOC_SNAPSHOT_MAX_BLOCKS + 31) / 32)
+
+// The state of the mounted filesystem a snapshot belongs to
+typedef struct
+{
+    uint32_t blockSize;
+    uint32_t blockCount;
+    uint32_t root[2];               // root pair, the mount must have found the same
+    uint32_t allocStart;            // block the allocator looks at next
+} Lfs_AllocSnapshotFs_s;
+
+typedef struct
+{
+    uint32_t magic;                 // LFS_ALLOC_SNAPSHOT_MAGIC while valid
+    uint32_t crc;                   // of the words that follow
+    Lfs_AllocSnapshotFs_s fs;
+    uint32_t usedBlocks;
+    uint32_t map[LFS_ALLOC_SNAPSHOT_MAP_WORDS];    // blocks in use
+} Lfs_AllocSnapshot_s;
+
+#define LFS_ALLOC_SNAPSHOT_WORDS        (sizeof(Lfs_AllocSnapshot_s) / sizeof(uint32_t))
+#define LFS_ALLOC_SNAPSHOT_CRC_OFFSET   offsetof(Lfs_AllocSnapshot_s, fs)
+
+static Lfs_AllocSnapshot_s snapshot;
+static bool_t snapshotChecked = FALSE;      // the SmartEEPROM was looked at since reset
+static bool_t snapshotValid = FALSE;        // the magic word is set in the SmartEEPROM
+
+
+static volatile uint32_t *a_Lfs_AllocSnapshot_Eeprom(void)
+{
+    return (volatile uint32_t *)(SEEPROM_ADDR + LFS_ALLOC_SNAPSHOT_OFFSET);
+}
+
+// The SmartEEPROM is enabled by the fuses and holds a snapshot past LFS_ALLOC_SNAPSHOT_OFFSET
+static bool_t a_Lfs_AllocSnapshot_Available(void)
+{
+    uint32_t status = NVMCTRL_SmartEEPROMStatusGet();
+    uint32_t sblk = (status & NVMCTRL_SEESTAT_SBLK_Msk) >> NVMCTRL_SEESTAT_SBLK_Pos;
+    uint32_t psz = (status & NVMCTRL_SEESTAT_PSZ_Msk) >> NVMCTRL_SEESTAT_PSZ_Pos;
+    uint32_t size = 512UL << psz;
+
+    if (size > (sblk * 4096UL))
+    {
+        size = sblk * 4096UL;       // a virtual page size too large for the blocks is capped
+    }
+    return ((sblk != 0) && ((LFS_ALLOC_SNAPSHOT_OFFSET + sizeof(Lfs_AllocSnapshot_s)) <= size)) ? TRUE : FALSE;
+}
+
+static void a_Lfs_AllocSnapshot_Check(void)
+{
+    if (!snapshotChecked)
+    {
+        while (NVMCTRL_SmartEEPROM_IsBusy())
+        {
+        }
+        snapshotValid = (a_Lfs_AllocSnapshot_Available() && (LFS_ALLOC_SNAPSHOT_MAGIC == a_Lfs_AllocSnapshot_Eeprom()[0])) ? TRUE : FALSE;
+        snapshotChecked = TRUE;
+    }
+}
+
+// Unbuffered mode: each word is in flash when the SmartEEPROM is not busy any more
+static void a_Lfs_AllocSnapshot_Write(uint32_t index, uint32_t value)
+{
+    volatile uint32_t *eeprom = a_Lfs_AllocSnapshot_Eeprom();
+
+    while (NVMCTRL_SmartEEPROM_IsBusy())
+    {
+    }
+    if (eeprom[index] != value)
+    {
+        eeprom[index] = value;
+    }
+}
+
+static uint32_t a_Lfs_AllocSnapshot_Crc(const Lfs_AllocSnapshot_s *s)
+{
+    return lfs_crc(0xffffffff, (const uint8_t *)s + LFS_ALLOC_SNAPSHOT_CRC_OFFSET, sizeof(*s) - LFS_ALLOC_SNAPSHOT_CRC_OFFSET);
+}
+
+// ---- littlefs 2.9 internals --------------------------------------------------------------
+// The only code of this file that touches lfs_t beyond its public API. With map NULL, *fs is
+// set from the mounted lfs. Otherwise the allocator is loaded from map as lfs_alloc_scan()
+// after a checkpoint would, with the window starting at fs->allocStart; fs must agree with
+// lfs, see Lfs_AllocSnapshot_Load().
+static void a_Lfs_AllocSnapshot_Lfs(lfs_t *lfs, Lfs_AllocSnapshotFs_s *fs, const uint32_t *map)
+{
+    lfs_block_t i;
+    lfs_block_t block;
+
+    if (NULL == map)
+    {
+        fs->blockSize = lfs->cfg->block_size;
+        fs->blockCount = lfs->block_count;
+        fs->root[0] = lfs->root[0];
+        fs->root[1] = lfs->root[1];
+        fs->allocStart = (lfs->lookahead.start + lfs->lookahead.next) % lfs->block_count;
+        return;
+    }
+
+    lfs->lookahead.start = fs->allocStart;
+    lfs->lookahead.next = 0;
+    lfs->lookahead.ckpoint = lfs->block_count;
+    lfs->lookahead.size = lfs_min(8 * lfs->cfg->lookahead_size, lfs->lookahead.ckpoint);
+    memset(lfs->lookahead.buffer, 0, lfs->cfg->lookahead_size);
+    for (i = 0; i < lfs->lookahead.size; i++)
+    {
+        block = (fs->allocStart + i) % lfs->block_count;
+        if (map[block / 32] & (1UL << (block % 32)))
+        {
+            lfs->lookahead.buffer[i / 8] |= 1U << (i % 8);
+        }
+    }
+}
+// ------------------------------------------------------------------------------------------
+
+
+int Lfs_AllocSnapshot_Load(lfs_t *lfs, uint32_t *usedBlocks)
+{
+    volatile uint32_t *eeprom = a_Lfs_AllocSnapshot_Eeprom();
+    Lfs_AllocSnapshotFs_s fs;
+    uint32_t w;
+
+    a_Lfs_AllocSnapshot_Check();
+    if (!snapshotValid)
+    {
+        return LFS_ERR_NOENT;
+    }
+
+    for (w = 0; w < LFS_ALLOC_SNAPSHOT_WORDS; w++)
+    {
+        ((uint32_t *)&snapshot)[w] = eeprom[w];
+    }
+    a_Lfs_AllocSnapshot_Lfs(lfs, &fs, NULL);
+    if ((snapshot.crc != a_Lfs_AllocSnapshot_Crc(&snapshot)) ||
+        (snapshot.fs.blockSize != fs.blockSize) || (snapshot.fs.blockCount != fs.blockCount) ||
+        (snapshot.fs.blockCount > LFS_ALLOC_SNAPSHOT_MAX_BLOCKS) || (snapshot.fs.allocStart >= snapshot.fs.blockCount) ||
+        (snapshot.fs.root[0] != fs.root[0]) || (snapshot.fs.root[1] != fs.root[1]))
+    {
+        return LFS_ERR_CORRUPT;
+    }
+
+    a_Lfs_AllocSnapshot_Lfs(lfs, &snapshot.fs, snapshot.map);
+
+    *usedBlocks = snapshot.usedBlocks;
+    return 0;
+}
+
+void Lfs_AllocSnapshot_Save(lfs_t *lfs, const uint32_t *used, uint32_t blockCount)
+{
+    volatile uint32_t *eeprom = a_Lfs_AllocSnapshot_Eeprom();
+    uint32_t w;
+
+    a_Lfs_AllocSnapshot_Check();
+    memset(&snapshot, 0, sizeof(snapshot));
+    a_Lfs_AllocSnapshot_Lfs(lfs, &snapshot.fs, NULL);
+    if ((blockCount != snapshot.fs.blockCount) || (blockCount > LFS_ALLOC_SNAPSHOT_MAX_BLOCKS) || !a_Lfs_AllocSnapshot_Available())
+    {
+        return;
+    }
+
+    memcpy(snapshot.map, used, ((blockCount + 31) / 32) * sizeof(uint32_t));
+    if (blockCount % 32)
+    {
+        snapshot.map[blockCount / 32] &= (1UL << (blockCount % 32)) - 1;
+    }
+    for (w = 0; w < LFS_ALLOC_SNAPSHOT_MAP_WORDS; w++)
+    {
+        snapshot.usedBlocks += (uint32_t)__builtin_popcount(snapshot.map[w]);
+    }
+    snapshot.crc = a_Lfs_AllocSnapshot_Crc(&snapshot);
+    snapshot.magic = LFS_ALLOC_SNAPSHOT_MAGIC;
+
+    for (w = 0; (w < LFS_ALLOC_SNAPSHOT_WORDS) && (eeprom[w] == ((const uint32_t *)&snapshot)[w]); w++)
+    {
+    }
+    if (LFS_ALLOC_SNAPSHOT_WORDS == w)
+    {
+        snapshotValid = TRUE;       // saved already
+        return;
+    }
+
+    // magic first and last, the words in between mostly are the same as before
+    a_Lfs_AllocSnapshot_Write(0, 0);
+    for (w = 1; w < LFS_ALLOC_SNAPSHOT_WORDS; w++)
+    {
+        a_Lfs_AllocSnapshot_Write(w, ((const uint32_t *)&snapshot)[w]);
+    }
+    a_Lfs_AllocSnapshot_Write(0, snapshot.magic);
+    snapshotValid = TRUE;
+}
+
+void Lfs_AllocSnapshot_Invalidate(void)
+{
+    a_Lfs_AllocSnapshot_Check();
+    if (snapshotValid)
+    {
+        a_Lfs_AllocSnapshot_Write(0, 0);
+        snapshotValid = FALSE;
+    }
+}
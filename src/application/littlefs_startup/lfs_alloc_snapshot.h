@@ -0,0 +1,40 @@
+/*
+ * lfs_alloc_snapshot.h
+ *
+ * Allocator snapshot in the SAME54 SmartEEPROM. After littlefs went idle the
+ * map of blocks in use and the allocator position are saved; the next mount
+ * loads them into the lookahead buffer instead of traversing the filesystem
+ * on the first allocation. The snapshot is dropped before the first program
+ * or erase after it was saved, a stale one is never loaded.
+ */
+
+
+#ifndef LFS_ALLOC_SNAPSHOT_H_
+#define LFS_ALLOC_SNAPSHOT_H_
+
+#include "lfs.h"
+
+#ifndef LFS_ALLOC_SNAPSHOT_MAX_BLOCKS
+    #define LFS_ALLOC_SNAPSHOT_MAX_BLOCKS   4096            // larger filesystems are not snapshotted
+#endif
+#ifndef LFS_ALLOC_SNAPSHOT_OFFSET
+    #define LFS_ALLOC_SNAPSHOT_OFFSET       0               // byte offset in the SmartEEPROM, word aligned
+#endif
+
+// Read the snapshot once, before the filesystem is written. If it is valid for this
+// filesystem the lookahead buffer of the just mounted lfs is loaded from it and the
+// blocks in use at the time it was saved are put to *usedBlocks. Returns 0 when loaded.
+// Called with the filesystem locked.
+int Lfs_AllocSnapshot_Load(lfs_t *lfs, uint32_t *usedBlocks);
+
+// Save the blocks in use, bit N of used[N / 32] for block N, and the allocator position
+// of lfs. used must be the complete lfs_fs_traverse() result of the current state.
+// Only words that changed are written. Called with the filesystem locked.
+void Lfs_AllocSnapshot_Save(lfs_t *lfs, const uint32_t *used, uint32_t blockCount);
+
+// Mark the snapshot stale, before anything is programmed or erased. Returns at once
+// when it is stale already.
+void Lfs_AllocSnapshot_Invalidate(void);
+
+
+#endif /* LFS_ALLOC_SNAPSHOT_H_ */
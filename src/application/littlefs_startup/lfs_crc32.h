@@ -0,0 +1,32 @@
+/*
+ * lfs_crc32.h
+ *
+ * CRC-32 engine for littlefs, selected at build time. littlefs uses it
+ * through LFS_CRC=Lfs_Crc32 in the compiler options; without that define
+ * its own 4 bit table routine is used.
+ */
+
+
+#ifndef LFS_CRC32_H_
+#define LFS_CRC32_H_
+
+#include <stdint.h>
+#include <stddef.h>
+
+#define LFS_CRC32_ENGINE_SLICE4     1       // 4 KB of tables, 4 bytes per step
+#define LFS_CRC32_ENGINE_SLICE8     2       // 8 KB of tables, 8 bytes per step
+#define LFS_CRC32_ENGINE_DSU        3       // SAME54 DSU CRC32 unit, slice-by-4 for short buffers and unaligned ends
+
+#ifndef LFS_CRC32_ENGINE
+    #define LFS_CRC32_ENGINE        LFS_CRC32_ENGINE_SLICE8
+#endif
+#ifndef LFS_CRC32_DSU_MIN_SIZE
+    #define LFS_CRC32_DSU_MIN_SIZE  64      // bytes, shorter buffers are done in software, cheaper than starting the DSU
+#endif
+
+// Same result as the littlefs reference lfs_crc(): polynomial 0x04c11db7 reflected, no final xor.
+// Any task may call it at any time, the DSU engine suspends the scheduler while the unit runs.
+uint32_t Lfs_Crc32(uint32_t crc, const void *buffer, size_t size);
+
+
+#endif /* LFS_CRC32_H_ */
@@ -0,0 +1,389 @@
+/*
+ * lfs_w25qxx_cache.c
+ *
+ * littlefs reads metadata a few bytes at a time, each read costing a full
+ * SPI command. Every cached block has a 4 KB image of which a window is
+ * filled from the chip. A read outside the cached blocks evicts the least
+ * recently used one and starts a window of LFS_BLOCKCACHE_FILL_SIZE bytes;
+ * a read that carries on where a window ends is sequential, it extends the
+ * window by its own size up to LFS_BLOCKCACHE_READAHEAD_MAX, so read-ahead
+ * grows as long as the scan goes on and carries over into the next block. Whole images are not loaded on a
+ * miss: metadata blocks are mostly erased space and the SPI bus is slow.
+ * Long reads of uncached blocks (file data) go straight to the chip,
+ * caching them would only push the metadata out.
+ *
+ * Programs and erases update a cached window and go on to the chip, so the
+ * cache never holds data the chip does not, except for write-behind: a block
+ * erased while it is on gets an entry of its own, programs that carry on
+ * where the last one ended only fill the image, and the block goes to the
+ * chip in one program when it is full, on sync, or before any other program
+ * or erase. littlefs reads back each program to validate it, those reads of
+ * the held block are served from the image. Blocks erased in background by
+ * the pre-erase pool are free, littlefs does not read them before it erases
+ * them through Lfs_W25qxxCache_Erase().
+ *
+ * Reads may come from several tasks at once, the filesystem lets readers of
+ * different files share it. The cache lock is not held over a chip read: the
+ * entry being filled is marked busy, it is neither evicted nor filled by a
+ * second reader, which reads past the cache instead of waiting.
+ */
+
+#include "lfs_w25qxx_cache.h"
+#include <string.h>
+
+
+#define LFS_BLOCKCACHE_NO_BLOCK     ((lfs_block_t)-1)
+
+typedef struct
+{
+    lfs_block_t block;
+    uint32_t lastUse;                           // useClock at the last access, 0 if the entry is free
+    lfs_off_t lo;                               // image bytes [lo, hi) hold the chip content
+    lfs_off_t hi;
+    uint8_t busy;                               // a task is filling [hi, ...) or a new window with the lock released
+} Lfs_W25qxxCacheEntry_s;
+
+// The block held back by write-behind, its image is [0, block_size), programmed is [lo, hi)
+typedef struct
+{
+    Lfs_W25qxxCacheEntry_s *entry;              // NULL if none
+    const struct lfs_config *cfg;
+    lfs_off_t lo;
+    lfs_off_t hi;
+} Lfs_W25qxxCachePending_s;
+
+typedef struct
+{
+    Lfs_W25qxxCacheEntry_s entry[LFS_BLOCKCACHE_ENTRIES];
+    uint32_t useClock;
+    lfs_block_t nextBlock;                      // a window reached the end of the block before this one
+    lfs_size_t nextAhead;                       // and was this long
+    bool_t writeBehind;
+    Lfs_W25qxxCachePending_s pending;
+    Lfs_W25qxxCacheEntry_s *streamEntry[2];     // write-behind takes turns with these, the block before
+    uint8_t streamNext;                         // the one held back stays cached for littlefs to read back
+    Lfs_W25qxxCacheStats_s stats;
+    uint8_t data[LFS_BLOCKCACHE_ENTRIES][LFS_BLOCKCACHE_BLOCK_SIZE];
+} Lfs_W25qxxCache_s;
+
+static Lfs_W25qxxCache_s blockCache = { .nextBlock = LFS_BLOCKCACHE_NO_BLOCK };
+static OsMutex blockCacheMutex;
+
+
+static Lfs_W25qxxCacheEntry_s *a_Lfs_Cache_Find(lfs_block_t block)
+{
+    uint32_t i;
+
+    for (i = 0; i < LFS_BLOCKCACHE_ENTRIES; i++)
+    {
+        if (((blockCache.entry[i].lastUse != 0) || blockCache.entry[i].busy) && (blockCache.entry[i].block == block))
+        {
+            return &blockCache.entry[i];
+        }
+    }
+    return NULL;
+}
+
+static uint8_t *a_Lfs_Cache_Data(const Lfs_W25qxxCacheEntry_s *entry)
+{
+    return blockCache.data[entry - blockCache.entry];
+}
+
+static void a_Lfs_Cache_Touch(Lfs_W25qxxCacheEntry_s *entry)
+{
+    if (++blockCache.useClock == 0)
+    {
+        // after 2^32 accesses, start over rather than mix old and new stamps
+        Lfs_W25qxxCache_Invalidate();
+        blockCache.useClock = 1;
+    }
+    entry->lastUse = blockCache.useClock;
+}
+
+// NULL if every entry is being filled
+static Lfs_W25qxxCacheEntry_s *a_Lfs_Cache_Evict(void)
+{
+    Lfs_W25qxxCacheEntry_s *victim = NULL;
+    uint32_t i;
+
+    for (i = 0; (i < LFS_BLOCKCACHE_ENTRIES) && ((victim == NULL) || (victim->lastUse != 0)); i++)
+    {
+        if (!blockCache.entry[i].busy && (&blockCache.entry[i] != blockCache.pending.entry) &&
+            ((victim == NULL) || (blockCache.entry[i].lastUse < victim->lastUse)))
+        {
+            victim = &blockCache.entry[i];
+        }
+    }
+    if (victim != NULL)
+    {
+        victim->lastUse = 0;
+    }
+    return victim;
+}
+
+int Lfs_W25qxxCache_Init(void)
+{
+    return osCreateMutex(&blockCacheMutex) ? 0 : LFS_ERR_NOMEM;
+}
+
+void Lfs_W25qxxCache_Invalidate(void)
+{
+    uint32_t i;
+
+    for (i = 0; i < LFS_BLOCKCACHE_ENTRIES; i++)
+    {
+        if (&blockCache.entry[i] != blockCache.pending.entry)
+        {
+            blockCache.entry[i].lastUse = 0;     // a block held back is not on the chip yet
+        }
+    }
+    blockCache.nextBlock = LFS_BLOCKCACHE_NO_BLOCK;
+}
+
+void Lfs_W25qxxCache_GetStats(Lfs_W25qxxCacheStats_s *stats)
+{
+    osAcquireMutex(&blockCacheMutex);
+    *stats = blockCache.stats;
+    osReleaseMutex(&blockCacheMutex);
+}
+
+int Lfs_W25qxxCache_Read(const struct lfs_config *c, lfs_block_t block, lfs_off_t off, void *buffer, lfs_size_t size)
+{
+    Lfs_W25qxxCacheEntry_s *entry;
+    lfs_off_t end = off + size;
+    lfs_off_t from;
+    lfs_off_t to;
+    lfs_size_t ahead;
+    int res;
+
+    if (c->block_size > LFS_BLOCKCACHE_BLOCK_SIZE)
+    {
+        return Lfs_W25qxxStripe_Read(c, block, off, buffer, size);
+    }
+
+    osAcquireMutex(&blockCacheMutex);
+    entry = a_Lfs_Cache_Find(block);
+    if ((entry != NULL) && (off >= entry->lo) && (end <= entry->hi))
+    {
+        blockCache.stats.hits++;
+        a_Lfs_Cache_Touch(entry);
+        memcpy(buffer, a_Lfs_Cache_Data(entry) + off, size);
+        osReleaseMutex(&blockCacheMutex);
+        return 0;
+    }
+    if ((entry == NULL) ? (size >= LFS_BLOCKCACHE_BYPASS_SIZE) : entry->busy)
+    {
+        // long read, or another task is filling this block: do not wait for it
+        blockCache.stats.bypassed++;
+        osReleaseMutex(&blockCacheMutex);
+        return Lfs_W25qxxStripe_Read(c, block, off, buffer, size);
+    }
+
+    if ((entry != NULL) && (off >= entry->lo) && (off <= entry->hi))
+    {
+        // sequential, read ahead as much as the window holds already
+        from = entry->hi;
+        ahead = entry->hi - entry->lo;
+    }
+    else
+    {
+        if (entry == NULL)
+        {
+            entry = a_Lfs_Cache_Evict();
+            if (entry == NULL)
+            {
+                blockCache.stats.bypassed++;
+                osReleaseMutex(&blockCacheMutex);
+                return Lfs_W25qxxStripe_Read(c, block, off, buffer, size);
+            }
+            entry->block = block;
+        }
+        from = off - (off % LFS_BLOCKCACHE_FILL_SIZE);
+        entry->lo = from;
+        entry->hi = from;
+        ahead = (block == blockCache.nextBlock) ? blockCache.nextAhead : 0;
+    }
+    if (ahead > LFS_BLOCKCACHE_READAHEAD_MAX)
+    {
+        ahead = LFS_BLOCKCACHE_READAHEAD_MAX;
+    }
+    to = end + ahead + LFS_BLOCKCACHE_FILL_SIZE - 1;
+    to -= to % LFS_BLOCKCACHE_FILL_SIZE;
+    if (to > c->block_size)
+    {
+        to = c->block_size;
+    }
+
+    blockCache.stats.misses++;
+    blockCache.stats.bytesRead += to - from;
+    entry->busy = 1;
+    osReleaseMutex(&blockCacheMutex);
+
+    // hits on [lo, hi) of this entry go on meanwhile, the fill only writes past hi
+    res = Lfs_W25qxxStripe_Read(c, block, from, a_Lfs_Cache_Data(entry) + from, to - from);
+
+    osAcquireMutex(&blockCacheMutex);
+    entry->busy = 0;
+    if (res != 0)
+    {
+        entry->lastUse = 0;
+        osReleaseMutex(&blockCacheMutex);
+        return LFS_ERR_IO;
+    }
+    entry->hi = to;
+    a_Lfs_Cache_Touch(entry);
+    if (to == c->block_size)
+    {
+        blockCache.nextBlock = block + 1;
+        blockCache.nextAhead = to - entry->lo;
+    }
+    memcpy(buffer, a_Lfs_Cache_Data(entry) + off, size);
+    osReleaseMutex(&blockCacheMutex);
+    return 0;
+}
+
+// Program the held block, its entry stays a cached block
+static int a_Lfs_Cache_Flush(void)
+{
+    Lfs_W25qxxCacheEntry_s *entry = blockCache.pending.entry;
+    int res = 0;
+
+    if (entry == NULL)
+    {
+        return 0;
+    }
+    blockCache.pending.entry = NULL;
+    if (blockCache.pending.hi > blockCache.pending.lo)
+    {
+        // any multiple of prog_size, the driver pipelines the pages
+        res = Lfs_W25qxxPreErase_Prog(blockCache.pending.cfg, entry->block, blockCache.pending.lo,
+                                      a_Lfs_Cache_Data(entry) + blockCache.pending.lo, blockCache.pending.hi - blockCache.pending.lo);
+        blockCache.stats.flushed++;
+    }
+    if (res != 0)
+    {
+        entry->lastUse = 0;
+    }
+    return res;
+}
+
+void Lfs_W25qxxCache_SetWriteBehind(bool_t enable)
+{
+    blockCache.writeBehind = enable;
+}
+
+int Lfs_W25qxxCache_Prog(const struct lfs_config *c, lfs_block_t block, lfs_off_t off, const void *buffer, lfs_size_t size)
+{
+    Lfs_W25qxxCacheEntry_s *entry;
+    int res;
+    lfs_off_t from;
+    lfs_off_t to;
+
+    if ((blockCache.pending.entry != NULL) && (blockCache.pending.entry->block == block) && (c == blockCache.pending.cfg) &&
+        blockCache.writeBehind && ((off == blockCache.pending.hi) || (blockCache.pending.lo == blockCache.pending.hi)))
+    {
+        memcpy(a_Lfs_Cache_Data(blockCache.pending.entry) + off, buffer, size);
+        if (blockCache.pending.lo == blockCache.pending.hi)
+        {
+            blockCache.pending.lo = off;
+        }
+        blockCache.pending.hi = off + size;
+        blockCache.stats.deferred++;
+        return (blockCache.pending.hi == c->block_size) ? a_Lfs_Cache_Flush() : 0;
+    }
+
+    // programs reach the chip in the order littlefs made them
+    res = a_Lfs_Cache_Flush();
+    if (res != 0)
+    {
+        return res;
+    }
+
+    entry = a_Lfs_Cache_Find(block);
+    res = Lfs_W25qxxPreErase_Prog(c, block, off, buffer, size);
+    if (entry != NULL)
+    {
+        if (res == 0)
+        {
+            // littlefs programs erased regions only, the chip now holds exactly the new data
+            from = (off > entry->lo) ? off : entry->lo;
+            to = ((off + size) < entry->hi) ? (off + size) : entry->hi;
+            if (from < to)
+            {
+                memcpy(a_Lfs_Cache_Data(entry) + from, (const uint8_t *)buffer + (from - off), to - from);
+            }
+        }
+        else
+        {
+            entry->lastUse = 0;
+        }
+    }
+    return res;
+}
+
+int Lfs_W25qxxCache_Erase(const struct lfs_config *c, lfs_block_t block)
+{
+    Lfs_W25qxxCacheEntry_s *entry;
+    int res = a_Lfs_Cache_Flush();
+
+    if (res != 0)
+    {
+        return res;
+    }
+
+    entry = a_Lfs_Cache_Find(block);
+    res = Lfs_W25qxxPreErase_Erase(c, block);
+    if ((res == 0) && blockCache.writeBehind && (c->block_size <= LFS_BLOCKCACHE_BLOCK_SIZE))
+    {
+        // hold the block back, it is new to littlefs and only read through the cache. A stream
+        // of blocks uses two entries, metadata blocks in the others stay cached.
+        osAcquireMutex(&blockCacheMutex);
+        if (entry == NULL)
+        {
+            entry = blockCache.streamEntry[blockCache.streamNext];
+            if ((entry == NULL) || entry->busy)
+            {
+                entry = a_Lfs_Cache_Evict();
+            }
+            blockCache.streamEntry[blockCache.streamNext] = entry;
+            blockCache.streamNext ^= 1;
+        }
+        if (entry != NULL)
+        {
+            entry->block = block;
+            a_Lfs_Cache_Touch(entry);
+            blockCache.pending.entry = entry;
+            blockCache.pending.cfg = c;
+            blockCache.pending.lo = 0;
+            blockCache.pending.hi = 0;
+        }
+        osReleaseMutex(&blockCacheMutex);
+    }
+
+    if (entry != NULL)
+    {
+        if ((res == 0) && (c->block_size <= LFS_BLOCKCACHE_BLOCK_SIZE))
+        {
+            // the whole block is known now
+            memset(a_Lfs_Cache_Data(entry), 0xFF, c->block_size);
+            entry->lo = 0;
+            entry->hi = c->block_size;
+        }
+        else
+        {
+            entry->lastUse = 0;
+        }
+    }
+    return res;
+}
+
+int Lfs_W25qxxCache_Sync(const struct lfs_config *c)
+{
+    int res = a_Lfs_Cache_Flush();
+
+    if (res != 0)
+    {
+        return res;
+    }
+    return Lfs_W25qxxStripe_Sync(c);
+}
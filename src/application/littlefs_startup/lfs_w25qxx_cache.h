@@ -0,0 +1,74 @@
+/*
+ * lfs_w25qxx_cache.h
+ *
+ * Block cache between littlefs and the W25Qxx block device. A small LRU of
+ * 4 KB sector images, filled with read-ahead as littlefs scans a block, so
+ * the many short metadata reads are served from RAM.
+ */
+
+
+#ifndef LFS_W25QXX_CACHE_H_
+#define LFS_W25QXX_CACHE_H_
+
+#include "lfs_w25qxx_preerase.h"
+
+#ifndef LFS_BLOCKCACHE_RAM_BUDGET
+    #define LFS_BLOCKCACHE_RAM_BUDGET   (32 * 1024)         // bytes of block images, sets the number of entries
+#endif
+#ifndef LFS_BLOCKCACHE_BLOCK_SIZE
+    #define LFS_BLOCKCACHE_BLOCK_SIZE   4096                // lfs_config.block_size, larger blocks are not cached
+#endif
+#ifndef LFS_BLOCKCACHE_FILL_SIZE
+    #define LFS_BLOCKCACHE_FILL_SIZE    256                 // smallest chip read, a multiple of lfs_config.read_size
+#endif
+#ifndef LFS_BLOCKCACHE_READAHEAD_MAX
+    #define LFS_BLOCKCACHE_READAHEAD_MAX    512             // bytes read past a sequential read, more mostly reads erased space at 1 MHz SPI
+#endif
+#ifndef LFS_BLOCKCACHE_BYPASS_SIZE
+    #define LFS_BLOCKCACHE_BYPASS_SIZE  1024                // reads this long of an uncached block go straight to the chip
+#endif
+
+#define LFS_BLOCKCACHE_ENTRIES          (LFS_BLOCKCACHE_RAM_BUDGET / LFS_BLOCKCACHE_BLOCK_SIZE)
+
+#if (LFS_BLOCKCACHE_ENTRIES < 2)
+    #error "LFS_BLOCKCACHE_RAM_BUDGET must hold two blocks at least"
+#endif
+
+typedef struct
+{
+    uint32_t hits;          // reads served from RAM
+    uint32_t misses;        // reads that filled a window from the chip
+    uint32_t bypassed;      // long reads of uncached blocks, not cached
+    uint32_t bytesRead;     // bytes filled from the chip
+    uint32_t deferred;      // programs held back by write-behind
+    uint32_t flushed;       // held back blocks programmed at once
+} Lfs_W25qxxCacheStats_s;
+
+// Create the cache lock, before the filesystem is mounted
+int Lfs_W25qxxCache_Init(void);
+
+// Forget every cached block. Call after the chips were accessed other than through
+// the callbacks below, e.g. a chip erase; nothing is needed around mount or unmount.
+// No read may be in progress.
+void Lfs_W25qxxCache_Invalidate(void);
+
+void Lfs_W25qxxCache_GetStats(Lfs_W25qxxCacheStats_s *stats);
+
+// While on, a block littlefs erases is held in RAM as it is programmed from its start and
+// written with one chip program when full, on sync or before the next other program or erase.
+// Meant for streaming file data, littlefs syncs before any commit can refer to it. The
+// read-back littlefs does to validate these programs is served from RAM. Set with the
+// filesystem locked.
+void Lfs_W25qxxCache_SetWriteBehind(bool_t enable);
+
+// lfs_config block device operations, lfs_config.context must point to a Lfs_W25qxxStripe_s.
+// Reads go to the stripe, programs and erases to the pre-erase pool, the cache is written
+// through unless write-behind is on. Reads may run in several tasks at once, programs,
+// erases and sync need the filesystem locked against every other call.
+int Lfs_W25qxxCache_Read(const struct lfs_config *c, lfs_block_t block, lfs_off_t off, void *buffer, lfs_size_t size);
+int Lfs_W25qxxCache_Prog(const struct lfs_config *c, lfs_block_t block, lfs_off_t off, const void *buffer, lfs_size_t size);
+int Lfs_W25qxxCache_Erase(const struct lfs_config *c, lfs_block_t block);
+int Lfs_W25qxxCache_Sync(const struct lfs_config *c);
+
+
+#endif /* LFS_W25QXX_CACHE_H_ */
@@ -0,0 +1,500 @@
+/*
+ * lfs_w25qxx_preerase.c
+ *
+ * littlefs does not report the blocks it frees. After it programmed anything
+ * the task waits for the filesystem to go idle and diffs lfs_fs_traverse()
+ * against the previous scan: blocks that were in use and are not any more
+ * are erased in background, chip-local runs of 8 or 16 pending sectors with
+ * one 32K or 64K block erase. The first scan after mount queues every free
+ * block, since the allocator walks the whole device before it comes back to
+ * freed ones; blocks that read back blank are kept without an erase, and the
+ * driver blank map remembers them, so the sector map is rebuilt on every mount
+ * by that first scan. Every block littlefs allocates passes the erase callback,
+ * which takes it out of the pool, so the task never erases a block littlefs
+ * got hold of after the last scan. Every erase that reaches the chips, and
+ * every failed program or erase, is counted for the wear statistics.
+ */
+
+#include "lfs_w25qxx_preerase.h"
+#include "lfs_w25qxx_wear.h"
+#include <string.h>
+
+
+#define LFS_PREERASE_MAP_WORDS      ((LFS_PREERASE_MAX_BLOCKS + 31) / 32)
+#define LFS_PREERASE_32K_SECTORS    8
+#define LFS_PREERASE_64K_SECTORS    16
+
+typedef struct
+{
+    const struct lfs_config *cfg;
+    lfs_t *lfs;
+    void (*lock)(void);
+    void (*unlock)(void);
+    void (*scanned)(lfs_t *lfs, const uint32_t *used, uint32_t blockCount);
+    uint32_t blockCount;                        // tracked blocks
+    bool_t started;
+    bool_t mutexCreated;
+    bool_t firstScan;                           // next scan queues all free blocks
+    volatile bool_t dirty;                      // littlefs programmed since the last scan, it may have freed blocks
+    volatile systime_t lastActivity;            // last prog/erase callback
+    OsMutex mutex;                              // maps, erasing range and stats
+    OsMutex eraseMutex;                         // held by the task for the whole background erase
+    lfs_block_t erasingBlock;                   // background erase in flight: erasingCount blocks of one chip,
+    uint8_t erasingCount;                       // chipsNumber apart, starting at erasingBlock
+    uint32_t used[LFS_PREERASE_MAP_WORDS];      // in use at the last scan or allocated by littlefs since
+    uint32_t pending[LFS_PREERASE_MAP_WORDS];   // freed by littlefs, not erased yet
+    uint32_t blank[LFS_PREERASE_MAP_WORDS];     // erased in background, not handed to littlefs yet
+    uint32_t scan[LFS_PREERASE_MAP_WORDS];      // lfs_fs_traverse() result
+    Lfs_W25qxxPreEraseStats_s stats;
+} Lfs_W25qxxPreErase_s;
+
+static Lfs_W25qxxPreErase_s preErase;
+static OsTaskId preEraseTask = OS_INVALID_TASK_ID;
+
+
+static bool_t a_Lfs_PreErase_Test(const uint32_t *map, lfs_block_t block)
+{
+    return (map[block / 32] & (1UL << (block % 32))) ? TRUE : FALSE;
+}
+
+static void a_Lfs_PreErase_Set(uint32_t *map, lfs_block_t block)
+{
+    map[block / 32] |= 1UL << (block % 32);
+}
+
+static void a_Lfs_PreErase_Clear(uint32_t *map, lfs_block_t block)
+{
+    map[block / 32] &= ~(1UL << (block % 32));
+}
+
+static uint8_t a_Lfs_PreErase_ChipsNumber(void)
+{
+    return ((const Lfs_W25qxxStripe_s *)preErase.cfg->context)->chipsNumber;
+}
+
+// Stripe block of the partition's block 0, the wear counters are by stripe block
+static uint32_t a_Lfs_PreErase_FirstBlock(void)
+{
+    return ((const Lfs_W25qxxStripe_s *)preErase.cfg->context)->firstBlock;
+}
+
+// Is the block part of the background erase in flight. Called with the mutex held.
+static bool_t a_Lfs_PreErase_IsErasing(lfs_block_t block)
+{
+    uint8_t chips = a_Lfs_PreErase_ChipsNumber();
+
+    return ((preErase.erasingCount != 0) && (block >= preErase.erasingBlock) &&
+            (((block - preErase.erasingBlock) % chips) == 0) &&
+            (((block - preErase.erasingBlock) / chips) < preErase.erasingCount)) ? TRUE : FALSE;
+}
+
+static void a_Lfs_PreErase_Activity(void)
+{
+    preErase.lastActivity = osGetSystemTime();
+}
+
+// Wear counters of an inline program or erase, the task counts its own under the mutex.
+// The counters are by stripe block, the same for every partition.
+static void a_Lfs_PreErase_Wear(const struct lfs_config *c, lfs_block_t block, int res, bool_t erase)
+{
+    block += ((const Lfs_W25qxxStripe_s *)c->context)->firstBlock;
+    if (preErase.mutexCreated)
+    {
+        osAcquireMutex(&preErase.mutex);
+    }
+    if (res != 0)
+    {
+        Lfs_W25qxxWear_Failed(block);
+    }
+    else if (erase)
+    {
+        Lfs_W25qxxWear_Erased(block, 1, 1);
+    }
+    if (preErase.mutexCreated)
+    {
+        osReleaseMutex(&preErase.mutex);
+    }
+}
+
+static int a_Lfs_PreErase_ScanBlock(void *data, lfs_block_t block)
+{
+    (void)data;
+    if (block < preErase.blockCount)
+    {
+        a_Lfs_PreErase_Set(preErase.scan, block);
+    }
+    return 0;
+}
+
+// Move blocks freed since the previous scan to pending. Called with the filesystem locked.
+static void a_Lfs_PreErase_Scan(void)
+{
+    uint32_t i;
+
+    preErase.dirty = FALSE;
+    memset(preErase.scan, 0, sizeof(preErase.scan));
+    if (lfs_fs_traverse(preErase.lfs, a_Lfs_PreErase_ScanBlock, NULL) < 0)
+    {
+        preErase.dirty = TRUE;
+        return;
+    }
+
+    osAcquireMutex(&preErase.mutex);
+    for (i = 0; i < LFS_PREERASE_MAP_WORDS; i++)
+    {
+        uint32_t freed = preErase.firstScan ? ~preErase.blank[i] : preErase.used[i];
+
+        if ((i * 32 + 32) > preErase.blockCount)
+        {
+            freed &= (1UL << (preErase.blockCount % 32)) - 1;
+        }
+        preErase.pending[i] = (preErase.pending[i] | freed) & ~preErase.scan[i];
+        preErase.used[i] = preErase.scan[i];
+    }
+    preErase.firstScan = FALSE;
+    osReleaseMutex(&preErase.mutex);
+
+    if (preErase.scanned != NULL)
+    {
+        preErase.scanned(preErase.lfs, preErase.scan, preErase.blockCount);
+    }
+}
+
+// Take the next erase out of pending, coalesced to a 64K or 32K block when the whole
+// chip-local block is pending. Returns the number of blocks. Called with the mutex held.
+static uint8_t a_Lfs_PreErase_Pick(lfs_block_t *first)
+{
+    static const uint8_t sizes[] = { LFS_PREERASE_64K_SECTORS, LFS_PREERASE_32K_SECTORS };
+    uint8_t chips = a_Lfs_PreErase_ChipsNumber();
+    lfs_block_t block = preErase.blockCount;
+    lfs_block_t sector;
+    uint32_t i;
+    uint8_t s;
+    uint8_t k;
+    uint8_t count = 1;
+
+    for (i = 0; i < LFS_PREERASE_MAP_WORDS; i++)
+    {
+        if (preErase.pending[i] != 0)
+        {
+            block = i * 32 + (lfs_block_t)__builtin_ctz(preErase.pending[i]);
+            break;
+        }
+    }
+    if (block >= preErase.blockCount)
+    {
+        return 0;
+    }
+
+    *first = block;
+    sector = block / chips;
+    for (s = 0; (s < sizeof(sizes)) && (4096 == preErase.cfg->block_size); s++)
+    {
+        lfs_block_t start = (sector & ~(lfs_block_t)(sizes[s] - 1)) * chips + (block % chips);
+
+        for (k = 0; k < sizes[s]; k++)
+        {
+            lfs_block_t b = start + k * chips;
+            if ((b >= preErase.blockCount) || !a_Lfs_PreErase_Test(preErase.pending, b))
+            {
+                break;
+            }
+        }
+        if (k == sizes[s])
+        {
+            *first = start;
+            count = sizes[s];
+            break;
+        }
+    }
+
+    for (k = 0; k < count; k++)
+    {
+        a_Lfs_PreErase_Clear(preErase.pending, *first + k * chips);
+    }
+    preErase.erasingBlock = *first;
+    preErase.erasingCount = count;
+
+    return count;
+}
+
+// Sector by sector through the driver blank map: sectors erased since boot are
+// not read, the others are read until the first programmed word and remembered
+// when blank. Freed blocks almost always fail in the first 256 bytes.
+static bool_t a_Lfs_PreErase_IsBlank(w25qxx_sched_t *chip, uint32_t addr, uint32_t size)
+{
+    uint32_t done;
+    w25qxx_bool_t blank;
+
+    for (done = 0; done < size; done += 4096)
+    {
+        if ((w25qxx_sched_blank_check(chip, addr + done, &blank) != 0) || (W25QXX_BOOL_FALSE == blank))
+        {
+            return FALSE;
+        }
+    }
+    return TRUE;
+}
+
+static uint8_t a_Lfs_PreErase_EraseRange(lfs_block_t first, uint8_t count, bool_t *erased)
+{
+    const Lfs_W25qxxStripe_s *stripe = (const Lfs_W25qxxStripe_s *)preErase.cfg->context;
+    w25qxx_sched_t *chip = stripe->chips[(stripe->firstBlock + first) % stripe->chipsNumber];
+    uint32_t addr = ((stripe->firstBlock + first) / stripe->chipsNumber) * preErase.cfg->block_size;
+
+    *erased = FALSE;
+    if (a_Lfs_PreErase_IsBlank(chip, addr, count * preErase.cfg->block_size))
+    {
+        return 0;
+    }
+
+    *erased = TRUE;
+    if (LFS_PREERASE_64K_SECTORS == count)
+    {
+        return w25qxx_sched_block_erase_64k(chip, addr);
+    }
+    if (LFS_PREERASE_32K_SECTORS == count)
+    {
+        return w25qxx_sched_block_erase_32k(chip, addr);
+    }
+    return w25qxx_sched_sector_erase_4k(chip, addr);
+}
+
+static void a_Lfs_PreErase_Task(void *param)
+{
+    lfs_block_t first = 0;
+    uint8_t count;
+    uint8_t k;
+    uint8_t res;
+    bool_t erased;
+
+    (void)param;
+
+    for (;;)
+    {
+        osDelayTask(LFS_PREERASE_POLL_MS);
+
+        if ((osGetSystemTime() - preErase.lastActivity) < OS_MS_TO_SYSTICKS(LFS_PREERASE_IDLE_MS))
+        {
+            continue;   // leave the chip to littlefs while it is busy
+        }
+
+        if (preErase.dirty)
+        {
+            preErase.lock();
+            if (preErase.started)
+            {
+                a_Lfs_PreErase_Scan();
+            }
+            preErase.unlock();
+            continue;
+        }
+
+        osAcquireMutex(&preErase.eraseMutex);
+
+        osAcquireMutex(&preErase.mutex);
+        count = preErase.started ? a_Lfs_PreErase_Pick(&first) : 0;
+        osReleaseMutex(&preErase.mutex);
+
+        if (count != 0)
+        {
+            res = a_Lfs_PreErase_EraseRange(first, count, &erased);
+
+            osAcquireMutex(&preErase.mutex);
+            for (k = 0; k < count; k++)
+            {
+                if (0 == res)
+                {
+                    a_Lfs_PreErase_Set(preErase.blank, first + k * a_Lfs_PreErase_ChipsNumber());
+                }
+                else
+                {
+                    Lfs_W25qxxWear_Failed(a_Lfs_PreErase_FirstBlock() + first + k * a_Lfs_PreErase_ChipsNumber());
+                }
+            }
+            if ((0 == res) && erased)
+            {
+                Lfs_W25qxxWear_Erased(a_Lfs_PreErase_FirstBlock() + first, count, a_Lfs_PreErase_ChipsNumber());
+            }
+            if ((0 == res) && !erased)
+            {
+                preErase.stats.foundBlank += count;
+            }
+            else if (0 == res)
+            {
+                if (LFS_PREERASE_64K_SECTORS == count)
+                {
+                    preErase.stats.erased64k++;
+                }
+                else if (LFS_PREERASE_32K_SECTORS == count)
+                {
+                    preErase.stats.erased32k++;
+                }
+                else
+                {
+                    preErase.stats.erased4k++;
+                }
+            }
+            preErase.erasingCount = 0;
+            osReleaseMutex(&preErase.mutex);
+        }
+
+        osReleaseMutex(&preErase.eraseMutex);
+    }
+}
+
+
+int Lfs_W25qxxPreErase_Start(lfs_t *lfs, void (*lock)(void), void (*unlock)(void),
+                             void (*scanned)(lfs_t *lfs, const uint32_t *used, uint32_t blockCount))
+{
+    OsTaskParameters taskParams;
+
+    if ((NULL == lfs) || (NULL == lfs->cfg) || (NULL == lock) || (NULL == unlock))
+    {
+        return LFS_ERR_INVAL;
+    }
+
+    if (!preErase.mutexCreated)
+    {
+        if (!osCreateMutex(&preErase.mutex))
+        {
+            return LFS_ERR_NOMEM;
+        }
+        if (!osCreateMutex(&preErase.eraseMutex))
+        {
+            osDeleteMutex(&preErase.mutex);
+            return LFS_ERR_NOMEM;
+        }
+        preErase.mutexCreated = TRUE;
+    }
+
+    lock();
+    osAcquireMutex(&preErase.eraseMutex);
+    osAcquireMutex(&preErase.mutex);
+    preErase.lfs = lfs;
+    preErase.cfg = lfs->cfg;
+    preErase.lock = lock;
+    preErase.unlock = unlock;
+    preErase.scanned = scanned;
+    preErase.blockCount = (lfs->cfg->block_count < LFS_PREERASE_MAX_BLOCKS) ? lfs->cfg->block_count : LFS_PREERASE_MAX_BLOCKS;
+    memset(preErase.used, 0, sizeof(preErase.used));
+    memset(preErase.pending, 0, sizeof(preErase.pending));
+    memset(preErase.blank, 0, sizeof(preErase.blank));
+    preErase.erasingCount = 0;
+    preErase.firstScan = TRUE;
+    preErase.dirty = TRUE;
+    preErase.started = TRUE;
+    osReleaseMutex(&preErase.mutex);
+    osReleaseMutex(&preErase.eraseMutex);
+    unlock();
+
+    if (OS_INVALID_TASK_ID == preEraseTask)
+    {
+        taskParams = OS_TASK_DEFAULT_PARAMS;
+        taskParams.stackSize = LFS_PREERASE_TASK_STACK_SIZE;
+        taskParams.priority = LFS_PREERASE_TASK_PRIORITY;
+
+        preEraseTask = osCreateTask("LfsPreErase", a_Lfs_PreErase_Task, NULL, &taskParams);
+        if (OS_INVALID_TASK_ID == preEraseTask)
+        {
+            Lfs_W25qxxPreErase_Stop();
+            return LFS_ERR_NOMEM;
+        }
+    }
+
+    return LFS_ERR_OK;
+}
+
+void Lfs_W25qxxPreErase_Stop(void)
+{
+    if (!preErase.started)
+    {
+        return;
+    }
+
+    preErase.lock();
+    osAcquireMutex(&preErase.eraseMutex);   // let a background erase finish
+    osAcquireMutex(&preErase.mutex);
+    preErase.started = FALSE;
+    memset(preErase.pending, 0, sizeof(preErase.pending));
+    memset(preErase.blank, 0, sizeof(preErase.blank));
+    osReleaseMutex(&preErase.mutex);
+    osReleaseMutex(&preErase.eraseMutex);
+    preErase.unlock();
+}
+
+void Lfs_W25qxxPreErase_GetStats(Lfs_W25qxxPreEraseStats_s *stats)
+{
+    uint32_t i;
+
+    if (!preErase.mutexCreated)
+    {
+        memset(stats, 0, sizeof(*stats));
+        return;
+    }
+
+    osAcquireMutex(&preErase.mutex);
+    *stats = preErase.stats;
+    stats->blankBlocks = 0;
+    for (i = 0; i < LFS_PREERASE_MAP_WORDS; i++)
+    {
+        stats->blankBlocks += (uint32_t)__builtin_popcount(preErase.blank[i]);
+    }
+    osReleaseMutex(&preErase.mutex);
+}
+
+// Programs may free blocks (copy-on-write), have the task rescan once littlefs is idle
+int Lfs_W25qxxPreErase_Prog(const struct lfs_config *c, lfs_block_t block, lfs_off_t off, const void *buffer, lfs_size_t size)
+{
+    int res = Lfs_W25qxxStripe_Prog(c, block, off, buffer, size);
+
+    if (res != 0)
+    {
+        a_Lfs_PreErase_Wear(c, block, res, FALSE);
+    }
+    if (c == preErase.cfg)
+    {
+        preErase.dirty = TRUE;
+    }
+    a_Lfs_PreErase_Activity();
+    return res;
+}
+
+// Hand out a pre-erased block or erase inline. A block in the background erase waits for it.
+int Lfs_W25qxxPreErase_Erase(const struct lfs_config *c, lfs_block_t block)
+{
+    int res;
+
+    a_Lfs_PreErase_Activity();
+    if (!preErase.started || (c != preErase.cfg) || (block >= preErase.blockCount))
+    {
+        res = Lfs_W25qxxStripe_Erase(c, block);
+        a_Lfs_PreErase_Wear(c, block, res, TRUE);
+        return res;
+    }
+
+    osAcquireMutex(&preErase.mutex);
+    while (a_Lfs_PreErase_IsErasing(block))
+    {
+        osReleaseMutex(&preErase.mutex);
+        osAcquireMutex(&preErase.eraseMutex);
+        osReleaseMutex(&preErase.eraseMutex);
+        osAcquireMutex(&preErase.mutex);
+    }
+    a_Lfs_PreErase_Set(preErase.used, block);
+    a_Lfs_PreErase_Clear(preErase.pending, block);
+    if (a_Lfs_PreErase_Test(preErase.blank, block))
+    {
+        a_Lfs_PreErase_Clear(preErase.blank, block);
+        preErase.stats.hits++;
+        osReleaseMutex(&preErase.mutex);
+        return 0;
+    }
+    preErase.stats.misses++;
+    osReleaseMutex(&preErase.mutex);
+
+    res = Lfs_W25qxxStripe_Erase(c, block);
+    a_Lfs_PreErase_Wear(c, block, res, TRUE);
+    a_Lfs_PreErase_Activity();
+    return res;
+}
@@ -0,0 +1,63 @@
+/*
+ * lfs_w25qxx_preerase.h
+ *
+ * Background pre-erase pool for the striped W25Qxx littlefs block device.
+ * Blocks littlefs stopped using are erased by a low priority task while the
+ * filesystem is idle, so the erase callback usually returns at once.
+ */
+
+
+#ifndef LFS_W25QXX_PREERASE_H_
+#define LFS_W25QXX_PREERASE_H_
+
+#include "lfs_w25qxx_stripe.h"
+#include "os_port.h"
+
+#ifndef LFS_PREERASE_MAX_BLOCKS
+    #define LFS_PREERASE_MAX_BLOCKS     4096                // blocks tracked by the pool, higher blocks are erased on demand
+#endif
+#ifndef LFS_PREERASE_IDLE_MS
+    #define LFS_PREERASE_IDLE_MS        100                 // no prog/erase for this long means the filesystem is idle
+#endif
+#ifndef LFS_PREERASE_POLL_MS
+    #define LFS_PREERASE_POLL_MS        20
+#endif
+#ifndef LFS_PREERASE_TASK_STACK_SIZE
+    #define LFS_PREERASE_TASK_STACK_SIZE    1024            // words, scanned runs littlefs commits and renames on it
+#endif
+#ifndef LFS_PREERASE_TASK_PRIORITY
+    #define LFS_PREERASE_TASK_PRIORITY  tskIDLE_PRIORITY
+#endif
+
+typedef struct
+{
+    uint32_t hits;          // erase callbacks served by a pre-erased block
+    uint32_t misses;        // erase callbacks that erased inline
+    uint32_t erased4k;      // background erases by size
+    uint32_t erased32k;
+    uint32_t erased64k;
+    uint32_t foundBlank;    // queued blocks that were blank already, not erased
+    uint32_t blankBlocks;   // pre-erased blocks waiting for littlefs
+} Lfs_W25qxxPreEraseStats_s;
+
+// Start the pool for a mounted filesystem whose cfg callbacks are the ones below.
+// lock/unlock must serialize against every other call on lfs, the pool calls
+// lfs_fs_traverse() between them to learn which blocks were freed.
+// scanned, if not NULL, gets each complete scan with the lock still held: bit N of
+// used[N / 32] is set for block N in use, blockCount is the number of blocks tracked.
+// Start and Stop take the lock themselves, do not call them with it held.
+int Lfs_W25qxxPreErase_Start(lfs_t *lfs, void (*lock)(void), void (*unlock)(void),
+                             void (*scanned)(lfs_t *lfs, const uint32_t *used, uint32_t blockCount));
+// Detach the pool before lfs_unmount() or direct chip access, forgets the pre-erased blocks
+void Lfs_W25qxxPreErase_Stop(void);
+
+void Lfs_W25qxxPreErase_GetStats(Lfs_W25qxxPreEraseStats_s *stats);
+
+// lfs_config block device operations, lfs_config.context must point to a Lfs_W25qxxStripe_s
+// Other filesystems than the one the pool was started for, e.g. another partition of the
+// chips, may use them too, their blocks are programmed and erased directly.
+int Lfs_W25qxxPreErase_Prog(const struct lfs_config *c, lfs_block_t block, lfs_off_t off, const void *buffer, lfs_size_t size);
+int Lfs_W25qxxPreErase_Erase(const struct lfs_config *c, lfs_block_t block);
+
+
+#endif /* LFS_W25QXX_PREERASE_H_ */
@@ -0,0 +1,77 @@
+/*
+ * lfs_w25qxx_stripe.c
+ *
+ * Consecutive littlefs blocks alternate between the chips, so sequential
+ * file data and the erases that go with it are spread evenly. Each chip
+ * handle serializes on its own SPI bus only, chips on different SERCOMs
+ * can be accessed from different tasks at the same time. Every access goes
+ * through the chip scheduler, so reads are served while an erase is suspended.
+ */ 
+
+#include "lfs_w25qxx_stripe.h"
+
+
+// Map a littlefs block to its chip scheduler and the byte address inside that chip
+static w25qxx_sched_t *a_Lfs_W25qxxStripe_Map(const struct lfs_config *c, lfs_block_t block, lfs_off_t off, uint32_t *addr)
+{
+    const Lfs_W25qxxStripe_s *stripe = (const Lfs_W25qxxStripe_s *)c->context;
+    
+    if ((NULL == stripe) || (0 == stripe->chipsNumber) || (block >= c->block_count) ||
+        ((stripe->firstBlock + block) >= (stripe->chipBlockCount * stripe->chipsNumber)))
+    {
+        return NULL;
+    }
+    
+    block += stripe->firstBlock;
+    *addr = (block / stripe->chipsNumber) * c->block_size + off;
+    return stripe->chips[block % stripe->chipsNumber];
+}
+
+// Read a region in a block. Negative error codes are propagated to the user.
+int Lfs_W25qxxStripe_Read(const struct lfs_config *c, lfs_block_t block, lfs_off_t off, void *buffer, lfs_size_t size)
+{
+    uint32_t addr;
+    w25qxx_sched_t *chip = a_Lfs_W25qxxStripe_Map(c, block, off, &addr);
+    if (NULL == chip)
+    {
+        return LFS_ERR_INVAL;
+    }
+    
+    return (0 == w25qxx_sched_read(chip, addr, (uint8_t *)buffer, size)) ? 0 : LFS_ERR_IO;
+}
+
+// Program a region in a block. The block must have previously been erased.
+int Lfs_W25qxxStripe_Prog(const struct lfs_config *c, lfs_block_t block, lfs_off_t off, const void *buffer, lfs_size_t size)
+{
+    w25qxx_program_segment_t seg;
+    w25qxx_sched_t *chip = a_Lfs_W25qxxStripe_Map(c, block, off, &seg.addr);
+    if (NULL == chip)
+    {
+        return LFS_ERR_INVAL;
+    }
+    
+    // any multiple of prog_size, the driver splits it into pages and pipelines them
+    seg.data = (uint8_t *)buffer;
+    seg.len = size;
+    return (0 == w25qxx_sched_program_segments(chip, &seg, 1)) ? 0 : LFS_ERR_IO;
+}
+
+// Erase a block. A block must be erased before being programmed.
+int Lfs_W25qxxStripe_Erase(const struct lfs_config *c, lfs_block_t block)
+{
+    uint32_t addr;
+    w25qxx_sched_t *chip = a_Lfs_W25qxxStripe_Map(c, block, 0, &addr);
+    if (NULL == chip)
+    {
+        return LFS_ERR_INVAL;
+    }
+    
+    return (0 == w25qxx_sched_sector_erase_4k(chip, addr)) ? 0 : LFS_ERR_IO;
+}
+
+// Program and erase wait for completion inside the driver, nothing is buffered here.
+int Lfs_W25qxxStripe_Sync(const struct lfs_config *c)
+{
+    (void)c;
+    return 0;
+}
@@ -0,0 +1,33 @@
+/*
+ * lfs_w25qxx_stripe.h
+ *
+ * littlefs block device striped over several W25Qxx chips:
+ * block N lives on chip (N % chipsNumber) at chip block (N / chipsNumber).
+ * A partition starts at stripe block firstBlock, its block N is stripe block
+ * firstBlock + N.
+ */ 
+
+
+#ifndef LFS_W25QXX_STRIPE_H_
+#define LFS_W25QXX_STRIPE_H_
+
+#include "w25qxx_sched.h"
+#include "lfs.h"
+
+typedef struct
+{
+    w25qxx_sched_t *const *chips;   // schedulers of initialized chips, all of the same size
+    uint8_t chipsNumber;
+    uint32_t chipBlockCount;        // erase blocks per chip, lfs_config.block_count <= chipBlockCount * chipsNumber - firstBlock
+    uint32_t firstBlock;            // stripe block of the partition's block 0, a multiple of 16 * chipsNumber
+                                    // so 64K block erases stay aligned; 0 for the whole chips
+} Lfs_W25qxxStripe_s;
+
+// lfs_config block device operations, lfs_config.context must point to a Lfs_W25qxxStripe_s
+int Lfs_W25qxxStripe_Read(const struct lfs_config *c, lfs_block_t block, lfs_off_t off, void *buffer, lfs_size_t size);
+int Lfs_W25qxxStripe_Prog(const struct lfs_config *c, lfs_block_t block, lfs_off_t off, const void *buffer, lfs_size_t size);
+int Lfs_W25qxxStripe_Erase(const struct lfs_config *c, lfs_block_t block);
+int Lfs_W25qxxStripe_Sync(const struct lfs_config *c);
+
+
+#endif /* LFS_W25QXX_STRIPE_H_ */
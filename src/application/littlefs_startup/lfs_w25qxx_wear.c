@@ -0,0 +1,520 @@
+/*
+ * lfs_w25qxx_wear.c
+ *
+ * One 16 bit counter per block, saturating, and one bit per block for program
+ * or erase failures. The pre-erase pool counts every erase that reaches the
+ * chips, inline or background, blocks found blank are not erased and not
+ * counted. The counts are saved in LFS_WEAR_FILE_NAME in batches, erases made
+ * after the last save are lost on a reset. The file is written by the
+ * pre-erase task after a scan, the snapshot scan that follows picks up its
+ * own blocks.
+ *
+ * littlefs levels dynamically only: blocks holding files that never change
+ * are never erased again. Once the spread of the counts is over
+ * LFS_WEAR_LEVEL_SPREAD, a file with a block in the cold part of the range is
+ * copied and renamed over itself, which frees its blocks for the allocator.
+ * The copy is always LFS_WEAR_TEMP_PATH, a copy a reset cut short is removed
+ * by the load after the next mount. The blocks of a file are found as
+ * lfs_ctz_traverse() does.
+ */
+
+#include "lfs_w25qxx_wear.h"
+#include "lfs_util.h"
+#include <string.h>
+
+
+#define LFS_WEAR_MAGIC              0x4C465357UL
+#define LFS_WEAR_MAP_WORDS          ((LFS_WEAR_MAX_BLOCKS + 31) / 32)
+#define LFS_WEAR_CHUNK_SIZE         256                 // bytes copied per read or write
+#define LFS_WEAR_PATH_MAX           128
+#define LFS_WEAR_TEMP_PATH          "/.wl~"             // the copy of a file being moved, renamed across directories
+
+typedef struct
+{
+    uint32_t magic;
+    uint32_t blockCount;
+} Lfs_W25qxxWearHeader_s;       // followed by the counts, the failure map and the crc of all before it
+
+typedef struct
+{
+    uint16_t counts[LFS_WEAR_MAX_BLOCKS];       // erases, saved and since boot
+    uint32_t failed[LFS_WEAR_MAP_WORDS];        // a program or erase failed on the block
+    uint32_t erasesSinceSave;
+    uint32_t erasesSinceBoot;
+    uint32_t erasesSinceLevel;
+    uint32_t filesMoved;
+    uint32_t blockCount;                        // set by the load, nothing is reported before
+} Lfs_W25qxxWear_s;
+
+static Lfs_W25qxxWear_s wear;
+
+// buffers of the one file open at a time and of a copy source
+static uint8_t wearFileBuffer[LFS_WEAR_FILE_BUFFER_SIZE];
+static uint8_t wearCopyFileBuffer[LFS_WEAR_FILE_BUFFER_SIZE];
+static uint8_t wearChunk[LFS_WEAR_CHUNK_SIZE];
+static lfs_dir_t wearDirs[LFS_WEAR_LEVEL_DEPTH];
+static char wearPath[LFS_WEAR_PATH_MAX];
+
+
+static int a_Lfs_Wear_Open(lfs_t *lfs, lfs_file_t *file, uint8_t *buffer, const char *path, int flags)
+{
+    static struct lfs_file_config fileCfg[2];
+    struct lfs_file_config *fcfg = &fileCfg[(buffer == wearFileBuffer) ? 0 : 1];
+
+    if (lfs->cfg->cache_size > LFS_WEAR_FILE_BUFFER_SIZE)
+    {
+        return LFS_ERR_INVAL;
+    }
+    memset(fcfg, 0, sizeof(*fcfg));
+    fcfg->buffer = buffer;
+    return lfs_file_opencfg(lfs, file, path, flags, fcfg);
+}
+
+static const Lfs_W25qxxStripe_s *a_Lfs_Wear_Stripe(const lfs_t *lfs)
+{
+    return (const Lfs_W25qxxStripe_s *)lfs->cfg->context;
+}
+
+static uint32_t a_Lfs_Wear_BlockCount(const lfs_t *lfs)
+{
+    return lfs_min(a_Lfs_Wear_Stripe(lfs)->chipBlockCount * a_Lfs_Wear_Stripe(lfs)->chipsNumber, LFS_WEAR_MAX_BLOCKS);
+}
+
+// Write a part of the file through wearChunk, the counts may change while littlefs erases
+static int a_Lfs_Wear_WriteChunks(lfs_t *lfs, lfs_file_t *file, const void *data, uint32_t size, uint32_t *crc)
+{
+    uint32_t done;
+    uint32_t n;
+    lfs_ssize_t res;
+
+    for (done = 0; done < size; done += n)
+    {
+        n = lfs_min(size - done, sizeof(wearChunk));
+        memcpy(wearChunk, (const uint8_t *)data + done, n);
+        *crc = lfs_crc(*crc, wearChunk, n);
+        res = lfs_file_write(lfs, file, wearChunk, n);
+        if (res != (lfs_ssize_t)n)
+        {
+            return (res < 0) ? (int)res : LFS_ERR_NOSPC;
+        }
+    }
+    return 0;
+}
+
+// Read size bytes of the file, add them to the crc and, if counts is set, the counts to it
+static int a_Lfs_Wear_ReadChunks(lfs_t *lfs, lfs_file_t *file, uint32_t size, uint32_t *crc, uint16_t *counts)
+{
+    uint32_t done;
+    uint32_t n;
+    uint32_t i;
+    uint16_t saved;
+    lfs_ssize_t res;
+
+    for (done = 0; done < size; done += n)
+    {
+        n = lfs_min(size - done, sizeof(wearChunk));
+        res = lfs_file_read(lfs, file, wearChunk, n);
+        if (res != (lfs_ssize_t)n)
+        {
+            return (res < 0) ? (int)res : LFS_ERR_CORRUPT;
+        }
+        *crc = lfs_crc(*crc, wearChunk, n);
+        for (i = 0; (counts != NULL) && (i < n); i += sizeof(uint16_t))
+        {
+            memcpy(&saved, &wearChunk[i], sizeof(saved));
+            counts[(done + i) / sizeof(uint16_t)] = (uint16_t)lfs_min((uint32_t)counts[(done + i) / sizeof(uint16_t)] + saved, 0xFFFFU);
+        }
+    }
+    return 0;
+}
+
+// The least erases in the partition of lfs that are not cold, 0 while the spread is under the threshold
+static uint32_t a_Lfs_Wear_ColdBelow(lfs_t *lfs, uint32_t blockCount)
+{
+    uint32_t i = a_Lfs_Wear_Stripe(lfs)->firstBlock;
+    uint32_t end = lfs_min(i + lfs->cfg->block_count, blockCount);
+    uint16_t min = 0xFFFFU;
+    uint16_t max = 0;
+
+    for (; i < end; i++)
+    {
+        min = (wear.counts[i] < min) ? wear.counts[i] : min;
+        max = (wear.counts[i] > max) ? wear.counts[i] : max;
+    }
+    if ((0 == LFS_WEAR_LEVEL_SPREAD) || (min > max) || ((uint32_t)(max - min) <= LFS_WEAR_LEVEL_SPREAD))
+    {
+        return 0;
+    }
+    return min + (max - min) / 2;   // the lower half of the range
+}
+
+// As lfs_ctz_index() of lfs.c: index of the block holding byte size - 1
+static lfs_off_t a_Lfs_Wear_CtzIndex(lfs_t *lfs, lfs_size_t size)
+{
+    lfs_off_t b = lfs->cfg->block_size - 2 * 4;
+    lfs_off_t i = (size - 1) / b;
+
+    if (0 == i)
+    {
+        return 0;
+    }
+    return (size - 1 - 4 * (lfs_popc(i - 1) + 2)) / b;
+}
+
+// A block of the closed regular file at wearPath is under coldBelow
+static bool_t a_Lfs_Wear_IsCold(lfs_t *lfs, uint32_t coldBelow, uint32_t blockCount)
+{
+    lfs_file_t file;
+    lfs_block_t firstBlock = a_Lfs_Wear_Stripe(lfs)->firstBlock;
+    lfs_block_t head;
+    lfs_block_t heads[2];
+    lfs_off_t index;
+    bool_t cold = FALSE;
+    int count;
+    int k;
+
+    if (a_Lfs_Wear_Open(lfs, &file, wearFileBuffer, wearPath, LFS_O_RDONLY) != 0)
+    {
+        return FALSE;
+    }
+    if (!(file.flags & LFS_F_INLINE) && (file.ctz.size != 0))
+    {
+        head = file.ctz.head;
+        index = a_Lfs_Wear_CtzIndex(lfs, file.ctz.size);
+        for (;;)
+        {
+            if (((firstBlock + head) < blockCount) && (wear.counts[firstBlock + head] < coldBelow))
+            {
+                cold = TRUE;
+                break;
+            }
+            if (0 == index)
+            {
+                break;
+            }
+            // the first pointers of a block lead to the one before it and, on even indexes, the one before that
+            count = 2 - (int)(index & 1);
+            if (lfs->cfg->read(lfs->cfg, head, 0, heads, count * sizeof(head)) != 0)
+            {
+                break;
+            }
+            for (k = 0; k < count - 1; k++)
+            {
+                if (((firstBlock + lfs_fromle32(heads[k])) < blockCount) && (wear.counts[firstBlock + lfs_fromle32(heads[k])] < coldBelow))
+                {
+                    cold = TRUE;
+                }
+            }
+            if (cold)
+            {
+                break;
+            }
+            head = lfs_fromle32(heads[count - 1]);
+            index -= count;
+        }
+    }
+    (void)lfs_file_close(lfs, &file);
+    return cold;
+}
+
+// Walk the tree for a file to move and leave its path in wearPath
+static bool_t a_Lfs_Wear_FindCold(lfs_t *lfs, uint32_t coldBelow, uint32_t blockCount)
+{
+    struct lfs_info info;
+    size_t lens[LFS_WEAR_LEVEL_DEPTH];
+    size_t base;
+    size_t nameLen;
+    int depth = 0;
+    bool_t found = FALSE;
+
+    strcpy(wearPath, "/");
+    if (lfs_dir_open(lfs, &wearDirs[0], wearPath) != 0)
+    {
+        return FALSE;
+    }
+    lens[0] = 1;
+    depth = 1;
+
+    while ((depth > 0) && !found)
+    {
+        base = lens[depth - 1];
+        wearPath[base] = '\0';
+        if (lfs_dir_read(lfs, &wearDirs[depth - 1], &info) <= 0)
+        {
+            (void)lfs_dir_close(lfs, &wearDirs[depth - 1]);
+            depth--;
+            continue;
+        }
+        nameLen = strlen(info.name);
+        if ((0 == strcmp(info.name, ".")) || (0 == strcmp(info.name, "..")) ||
+            ((base + 1 + nameLen) >= sizeof(wearPath)))
+        {
+            continue;
+        }
+        if (base > 1)
+        {
+            wearPath[base++] = '/';
+        }
+        memcpy(&wearPath[base], info.name, nameLen + 1);
+
+        if (LFS_TYPE_DIR == info.type)
+        {
+            if ((depth < LFS_WEAR_LEVEL_DEPTH) && (0 == lfs_dir_open(lfs, &wearDirs[depth], wearPath)))
+            {
+                lens[depth] = base + nameLen;
+                depth++;
+            }
+        }
+        else if ((info.size != 0) && (info.size <= LFS_WEAR_LEVEL_MAX_SIZE) &&
+                 (strcmp(wearPath, "/" LFS_WEAR_FILE_NAME) != 0) && (strcmp(wearPath, LFS_WEAR_TEMP_PATH) != 0) &&
+                 a_Lfs_Wear_IsCold(lfs, coldBelow, blockCount))
+        {
+            found = TRUE;
+        }
+    }
+
+    while (depth > 0)
+    {
+        (void)lfs_dir_close(lfs, &wearDirs[--depth]);
+    }
+    return found;
+}
+
+// Copy wearPath to LFS_WEAR_TEMP_PATH and rename that over it, the rename is atomic
+static int a_Lfs_Wear_Move(lfs_t *lfs)
+{
+    lfs_file_t src;
+    lfs_file_t dst;
+    lfs_ssize_t n;
+    int err;
+
+    err = a_Lfs_Wear_Open(lfs, &src, wearCopyFileBuffer, wearPath, LFS_O_RDONLY);
+    if (err)
+    {
+        return err;
+    }
+    err = a_Lfs_Wear_Open(lfs, &dst, wearFileBuffer, LFS_WEAR_TEMP_PATH, LFS_O_WRONLY | LFS_O_CREAT | LFS_O_TRUNC);
+    if (err)
+    {
+        (void)lfs_file_close(lfs, &src);
+        return err;
+    }
+    for (;;)
+    {
+        n = lfs_file_read(lfs, &src, wearChunk, sizeof(wearChunk));
+        if (n <= 0)
+        {
+            err = (int)n;
+            break;
+        }
+        if (lfs_file_write(lfs, &dst, wearChunk, (lfs_size_t)n) != n)
+        {
+            err = LFS_ERR_NOSPC;
+            break;
+        }
+    }
+    (void)lfs_file_close(lfs, &src);
+    if (0 == err)
+    {
+        err = lfs_file_close(lfs, &dst);
+    }
+    else
+    {
+        (void)lfs_file_close(lfs, &dst);
+    }
+    if (0 == err)
+    {
+        err = lfs_rename(lfs, LFS_WEAR_TEMP_PATH, wearPath);
+    }
+    if (err)
+    {
+        (void)lfs_remove(lfs, LFS_WEAR_TEMP_PATH);
+    }
+    return err;
+}
+
+
+void Lfs_W25qxxWear_Erased(lfs_block_t first, uint8_t count, uint8_t step)
+{
+    uint8_t k;
+    lfs_block_t block;
+
+    for (k = 0; k < count; k++)
+    {
+        block = first + (lfs_block_t)k * step;
+        if ((block < LFS_WEAR_MAX_BLOCKS) && (wear.counts[block] != 0xFFFFU))
+        {
+            wear.counts[block]++;
+        }
+    }
+    wear.erasesSinceSave += count;
+    wear.erasesSinceBoot += count;
+    wear.erasesSinceLevel += count;
+}
+
+void Lfs_W25qxxWear_Failed(lfs_block_t block)
+{
+    if (block < LFS_WEAR_MAX_BLOCKS)
+    {
+        wear.failed[block / 32] |= 1UL << (block % 32);
+    }
+}
+
+void Lfs_W25qxxWear_GetStats(Lfs_W25qxxWearStats_s *stats)
+{
+    uint32_t blockCount = wear.blockCount;
+    uint32_t width;
+    uint32_t i;
+    uint64_t uptime = osGetSystemTime();
+    uint64_t hours;
+
+    memset(stats, 0, sizeof(*stats));
+    stats->lifetimeHours = UINT32_MAX;
+    stats->filesMoved = wear.filesMoved;
+    if (0 == blockCount)
+    {
+        return;
+    }
+
+    stats->blockCount = blockCount;
+    stats->minErases = 0xFFFFU;
+    for (i = 0; i < blockCount; i++)
+    {
+        stats->totalErases += wear.counts[i];
+        stats->minErases = (wear.counts[i] < stats->minErases) ? wear.counts[i] : stats->minErases;
+        stats->maxErases = (wear.counts[i] > stats->maxErases) ? wear.counts[i] : stats->maxErases;
+        stats->failedBlocks += (wear.failed[i / 32] >> (i % 32)) & 1U;
+    }
+    stats->meanErases = (uint16_t)(stats->totalErases / blockCount);
+    width = (uint32_t)(stats->maxErases - stats->minErases) / LFS_WEAR_HISTOGRAM_BINS + 1;
+    for (i = 0; i < blockCount; i++)
+    {
+        stats->histogram[(wear.counts[i] - stats->minErases) / width]++;
+    }
+
+    // systime_t counts milliseconds
+    if (uptime >= 1000)
+    {
+        stats->erasesPerHour = (uint32_t)(((uint64_t)wear.erasesSinceBoot * 3600000ULL) / uptime);
+    }
+    if (stats->erasesPerHour != 0)
+    {
+        hours = (stats->maxErases >= LFS_WEAR_ENDURANCE) ? 0 :
+                ((uint64_t)(LFS_WEAR_ENDURANCE - stats->maxErases) * blockCount) / stats->erasesPerHour;
+        stats->lifetimeHours = (hours >= UINT32_MAX) ? (UINT32_MAX - 1) : (uint32_t)hours;
+    }
+}
+
+int Lfs_W25qxxWear_Load(lfs_t *lfs)
+{
+    Lfs_W25qxxWearHeader_s header;
+    lfs_file_t file;
+    uint32_t blockCount = a_Lfs_Wear_BlockCount(lfs);
+    uint32_t countsSize = blockCount * sizeof(uint16_t);
+    uint32_t mapSize = ((blockCount + 31) / 32) * sizeof(uint32_t);
+    uint32_t crc = 0xffffffff;
+    uint32_t savedCrc;
+    uint32_t saved;
+    uint32_t w;
+    int err;
+
+    wear.blockCount = blockCount;
+    (void)lfs_remove(lfs, LFS_WEAR_TEMP_PATH);     // a move a reset cut short, the file itself is whole
+    err = a_Lfs_Wear_Open(lfs, &file, wearFileBuffer, LFS_WEAR_FILE_NAME, LFS_O_RDONLY);
+    if (err)
+    {
+        return err;
+    }
+
+    // the crc is checked in a first pass, the counts are added in the second
+    err = LFS_ERR_CORRUPT;
+    if ((lfs_file_read(lfs, &file, &header, sizeof(header)) == (lfs_ssize_t)sizeof(header)) &&
+        (LFS_WEAR_MAGIC == header.magic) && (header.blockCount == blockCount))
+    {
+        crc = lfs_crc(crc, &header, sizeof(header));
+        if ((0 == a_Lfs_Wear_ReadChunks(lfs, &file, countsSize + mapSize, &crc, NULL)) &&
+            (lfs_file_read(lfs, &file, &savedCrc, sizeof(savedCrc)) == (lfs_ssize_t)sizeof(savedCrc)) &&
+            (savedCrc == crc) &&
+            (lfs_file_seek(lfs, &file, sizeof(header), LFS_SEEK_SET) >= 0) &&
+            (0 == a_Lfs_Wear_ReadChunks(lfs, &file, countsSize, &crc, wear.counts)))
+        {
+            for (w = 0; w < mapSize / sizeof(uint32_t); w++)
+            {
+                if (lfs_file_read(lfs, &file, &saved, sizeof(saved)) == (lfs_ssize_t)sizeof(saved))
+                {
+                    wear.failed[w] |= saved;
+                }
+            }
+            err = 0;
+        }
+    }
+    (void)lfs_file_close(lfs, &file);
+    return err;
+}
+
+bool_t Lfs_W25qxxWear_Save(lfs_t *lfs, bool_t force)
+{
+    Lfs_W25qxxWearHeader_s header;
+    lfs_file_t file;
+    uint32_t blockCount = wear.blockCount;
+    uint32_t crc = 0xffffffff;
+    int err;
+
+    if ((0 == blockCount) || (!force && (wear.erasesSinceSave < LFS_WEAR_SAVE_ERASES)))
+    {
+        return FALSE;
+    }
+
+    // erases of the save count towards the next one
+    wear.erasesSinceSave = 0;
+    header.magic = LFS_WEAR_MAGIC;
+    header.blockCount = blockCount;
+    err = a_Lfs_Wear_Open(lfs, &file, wearFileBuffer, LFS_WEAR_FILE_NAME, LFS_O_WRONLY | LFS_O_CREAT | LFS_O_TRUNC);
+    if (err)
+    {
+        return FALSE;
+    }
+    err = a_Lfs_Wear_WriteChunks(lfs, &file, &header, sizeof(header), &crc);
+    if (0 == err)
+    {
+        err = a_Lfs_Wear_WriteChunks(lfs, &file, wear.counts, blockCount * sizeof(uint16_t), &crc);
+    }
+    if (0 == err)
+    {
+        err = a_Lfs_Wear_WriteChunks(lfs, &file, wear.failed, ((blockCount + 31) / 32) * sizeof(uint32_t), &crc);
+    }
+    if (0 == err)
+    {
+        (void)lfs_file_write(lfs, &file, &crc, sizeof(crc));
+    }
+    // littlefs does not commit a file a write failed on, the old one stays
+    (void)lfs_file_close(lfs, &file);
+    return TRUE;
+}
+
+bool_t Lfs_W25qxxWear_Level(lfs_t *lfs)
+{
+    uint32_t blockCount = wear.blockCount;
+    uint32_t coldBelow;
+
+    if ((0 == blockCount) || (wear.erasesSinceLevel < LFS_WEAR_LEVEL_INTERVAL) || (lfs->mlist != NULL))
+    {
+        return FALSE;
+    }
+    coldBelow = a_Lfs_Wear_ColdBelow(lfs, blockCount);
+    if (0 == coldBelow)
+    {
+        return FALSE;
+    }
+
+    wear.erasesSinceLevel = 0;
+    if (!a_Lfs_Wear_FindCold(lfs, coldBelow, blockCount))
+    {
+        return FALSE;
+    }
+    if (0 == a_Lfs_Wear_Move(lfs))
+    {
+        wear.filesMoved++;
+    }
+    return TRUE;
+}
@@ -0,0 +1,84 @@
+/*
+ * lfs_w25qxx_wear.h
+ *
+ * Erase counters of the blocks of the chips, kept in RAM, counted by the
+ * pre-erase pool for every erase it or littlefs makes in any partition and
+ * saved in a file of the filesystem now and then. Static wear leveling moves cold files, files that
+ * sit on blocks erased far less than the most worn one, to other blocks.
+ */
+
+
+#ifndef LFS_W25QXX_WEAR_H_
+#define LFS_W25QXX_WEAR_H_
+
+#include "lfs_w25qxx_stripe.h"
+#include "os_port.h"
+
+#ifndef LFS_WEAR_MAX_BLOCKS
+    #define LFS_WEAR_MAX_BLOCKS         4096                // stripe blocks counted, 2 bytes of RAM each
+#endif
+#ifndef LFS_WEAR_FILE_NAME
+    #define LFS_WEAR_FILE_NAME          "wear.bin"
+#endif
+#ifndef LFS_WEAR_SAVE_ERASES
+    #define LFS_WEAR_SAVE_ERASES        1024                // erases counted before the file is written again
+#endif
+#ifndef LFS_WEAR_ENDURANCE
+    #define LFS_WEAR_ENDURANCE          100000              // erase cycles of a W25Q sector
+#endif
+#ifndef LFS_WEAR_HISTOGRAM_BINS
+    #define LFS_WEAR_HISTOGRAM_BINS     8
+#endif
+#ifndef LFS_WEAR_LEVEL_SPREAD
+    #define LFS_WEAR_LEVEL_SPREAD       1000                // max - min erases that starts static leveling, 0 never
+#endif
+#ifndef LFS_WEAR_LEVEL_INTERVAL
+    #define LFS_WEAR_LEVEL_INTERVAL     4096                // erases between two files moved
+#endif
+#ifndef LFS_WEAR_LEVEL_MAX_SIZE
+    #define LFS_WEAR_LEVEL_MAX_SIZE     (256 * 1024)        // larger files are not moved, the copy holds the filesystem lock
+#endif
+#ifndef LFS_WEAR_FILE_BUFFER_SIZE
+    #define LFS_WEAR_FILE_BUFFER_SIZE   512                 // lfs_config.cache_size, files are not opened with a larger one
+#endif
+#ifndef LFS_WEAR_LEVEL_DEPTH
+    #define LFS_WEAR_LEVEL_DEPTH        4                   // directory levels searched for cold files
+#endif
+
+typedef struct
+{
+    uint32_t blockCount;        // blocks counted
+    uint32_t totalErases;
+    uint16_t minErases;
+    uint16_t maxErases;
+    uint16_t meanErases;
+    uint32_t histogram[LFS_WEAR_HISTOGRAM_BINS];    // blocks by erases, min to max in equal bins
+    uint32_t failedBlocks;      // blocks a program or erase failed on, ever
+    uint32_t erasesPerHour;     // since boot
+    uint32_t lifetimeHours;     // until the most worn block reaches LFS_WEAR_ENDURANCE if the rate holds
+                                // and wear is even from now on, UINT32_MAX while nothing was erased
+    uint32_t filesMoved;        // by static leveling since boot
+} Lfs_W25qxxWearStats_s;
+
+// Count erases: count stripe blocks, step apart, starting at first
+void Lfs_W25qxxWear_Erased(lfs_block_t first, uint8_t count, uint8_t step);
+// A program or erase of the stripe block failed
+void Lfs_W25qxxWear_Failed(lfs_block_t block);
+
+void Lfs_W25qxxWear_GetStats(Lfs_W25qxxWearStats_s *stats);
+
+// The functions below use lfs directly, call them with the filesystem mounted and locked.
+// lfs_config.context must point to a Lfs_W25qxxStripe_s, the file holds the counts of all
+// partitions of the chips.
+// Add the counts saved in the file to those since boot, once after mount. Removes the copy of
+// a file static leveling was moving when the chips lost power.
+int Lfs_W25qxxWear_Load(lfs_t *lfs);
+// Write the file when LFS_WEAR_SAVE_ERASES erases were counted since it was last written,
+// or at once if force is set. TRUE if the filesystem was written.
+bool_t Lfs_W25qxxWear_Save(lfs_t *lfs, bool_t force);
+// Move one cold file when the spread is over LFS_WEAR_LEVEL_SPREAD and nothing is open,
+// at most once every LFS_WEAR_LEVEL_INTERVAL erases. TRUE if the filesystem was written.
+bool_t Lfs_W25qxxWear_Level(lfs_t *lfs);
+
+
+#endif /* LFS_W25QXX_WEAR_H_ */
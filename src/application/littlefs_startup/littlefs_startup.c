@@ -9,261 +9,906 @@
 
 #include "littlefs_startup.h"
 #include "lfs.h"
+#include "lfs_w25qxx_stripe.h"
+#include "lfs_w25qxx_preerase.h"
+#include "lfs_w25qxx_cache.h"
+#include "lfs_alloc_snapshot.h"
+#include "lfs_w25qxx_wear.h"
 #include "uart_printf.h"
+#include "os_port.h"
 #include "debug.h"
+#include <string.h>
 
 //#include "driver_w25qxx.h"
 
 
 // TODO: use MSP to get w25qxx handle
-extern w25qxx_handle_t w25q128_handle;
+extern w25qxx_sched_t w25q128_sched;
 
-// variables used by the filesystem
-lfs_t       lfs_global;
-lfs_file_t  lfs_global_file;
-lfs_dir_t   lfs_global_dir;
+// chips the filesystem is striped over, add schedulers of handles brought up with W25qxx_StartupDevice()
+static w25qxx_sched_t *const lfsChips[] = { &w25q128_sched };
 
+#define LFS_CHIPS_NUMBER        (sizeof(lfsChips) / sizeof(lfsChips[0]))
+#define LFS_CHIP_BLOCK_COUNT    4096    // 128 Mbit chip has 4096 sectors of 4096 byte or 256 blocks of 64KB
 
-// create module with the following functions
-// TODO: glue w25q128_handle into the struct lfs_config *c????
+// The chips hold LITTLEFS_BANKS littlefs partitions of equal size, one after the other. The bank
+// with the highest generation in its root attribute is active at mount, Littlefs_BankSwap()
+// gives the other one the next generation.
+#define LFS_BANK_BLOCK_COUNT    ((LFS_CHIP_BLOCK_COUNT / LITTLEFS_BANKS) * LFS_CHIPS_NUMBER)
+#define LFS_BANK_ATTR           0x42    // uint32_t generation
 
-// Read a region in a block. Negative error codes are propagated to the user.
-static int user_provided_block_device_read(const struct lfs_config *c, lfs_block_t block, lfs_off_t off, void *buffer, lfs_size_t size)
+#if ((LITTLEFS_BANKS != 1) && (LITTLEFS_BANKS != 2))
+    #error "LITTLEFS_BANKS must be 1 or 2"
+#endif
+#if ((LFS_CHIP_BLOCK_COUNT / LITTLEFS_BANKS) % 16)
+    #error "banks must start on a 64KB block of every chip"
+#endif
+
+typedef struct
+{
+    lfs_t lfs;
+    struct lfs_config cfg;
+    Lfs_W25qxxStripe_s stripe;              // the chips from the first block of the bank on
+    uint32_t generation;                    // LFS_BANK_ATTR, 0 until the bank was made active once
+
+    // Reader/writer lock. littlefs is not reentrant, it keeps its read and program caches in
+    // lfs, so every call holds mutex throughout. Reading a file that is open read-only and not
+    // inlined uses only the file's own cache, those reads share the lock: a reader holds mutex
+    // just to get in, a writer holds it throughout and waits for the readers to leave.
+    OsMutex mutex;
+    OsMutex readersMutex;                   // protects readers
+    OsEvent readersDone;                    // set when the last reader leaves
+    uint32_t readers;
+
+    // the files and dirs opened in the bank by Littlefs_*Open(), with two banks. Changed by open
+    // and close with mutex held, read by any task without it: an entry is one word and only
+    // the task that owns an object looks for it, its entry does not change meanwhile.
+    const void *volatile open[LITTLEFS_MAX_OPEN];
+
+    // buffers of lfs, littlefs does not malloc them at mount
+    uint8_t readBuffer[LITTLEFS_CACHE_SIZE];
+    uint8_t progBuffer[LITTLEFS_CACHE_SIZE];
+    uint32_t lookaheadBuffer[512 / sizeof(uint32_t)];
+} Littlefs_Bank_s;
+
+// the mounts of the banks, every access goes through the Littlefs_* functions below
+static Littlefs_Bank_s lfsBanks[LITTLEFS_BANKS];
+static Littlefs_Bank_s *volatile lfsActive = NULL;     // changes with every bank locked only
+static Littlefs_Bank_s *lfsLockedActive = NULL;         // the bank a_Littlefs_LockActive() locked
+static bool_t lfsMounted = FALSE;
+static bool_t lfsLockCreated = FALSE;
+
+
+static bool_t a_Littlefs_IsActive(const struct lfs_config *c)
 {
-    /* extract block-size from lfs_config *c */
-    uint32_t blockSize = c->block_size;
-    uint32_t addr = blockSize * block + off;
-    /* extract w25q128_handle from const struct lfs_config *c */
-    w25qxx_handle_t *flashChipDriverHandle = (w25qxx_handle_t*)c->context;
-    uint8_t res = w25qxx_read(flashChipDriverHandle, addr, (uint8_t *)buffer, size);
-    return res;
+    return ((NULL != lfsActive) && (c == &lfsActive->cfg)) ? TRUE : FALSE;
 }
 
- // Program a region in a block. The block must have previously been erased. Negative error codes are propagated to the user.
- // May return LFS_ERR_CORRUPT if the block should be considered bad.
-static int user_provided_block_device_prog(const struct lfs_config *c, lfs_block_t block, lfs_off_t off, const void *buffer, lfs_size_t size)
+// The active bank goes through the block cache and the pre-erase pool, every change of it
+// makes the allocator snapshot stale. The inactive bank is read and written directly, the
+// pre-erase pool only counts its erases. Until a bank is active all are written directly.
+static int a_Littlefs_Read(const struct lfs_config *c, lfs_block_t block, lfs_off_t off, void *buffer, lfs_size_t size)
 {
-    /* extract block-size from lfs_config *c */
-    uint32_t blockSize = c->block_size;
-    uint32_t addr = blockSize * block + off;
-    /* extract w25q128_handle from const struct lfs_config *c */
-    w25qxx_handle_t *flashChipDriverHandle = (w25qxx_handle_t*)c->context;
-    uint8_t res = w25qxx_page_program(flashChipDriverHandle, addr, (uint8_t *)buffer, size);
-    return res;
+    if (a_Littlefs_IsActive(c))
+    {
+        return Lfs_W25qxxCache_Read(c, block, off, buffer, size);
+    }
+    return Lfs_W25qxxStripe_Read(c, block, off, buffer, size);
 }
 
- // Erase a block. A block must be erased before being programmed. The state of an erased block is undefined. Negative error codes
- // are propagated to the user. May return LFS_ERR_CORRUPT if the block should be considered bad.
-static int user_provided_block_device_erase(const struct lfs_config *c, lfs_block_t block)
+static int a_Littlefs_Prog(const struct lfs_config *c, lfs_block_t block, lfs_off_t off, const void *buffer, lfs_size_t size)
 {
-    /* extract block-size from lfs_config *c */
-    uint32_t blockSize = c->block_size;
-    uint32_t addr = blockSize * block;
-    /* extract w25q128_handle from const struct lfs_config *c */
-    w25qxx_handle_t *flashChipDriverHandle = (w25qxx_handle_t*)c->context;
-    uint8_t res = w25qxx_sector_erase_4k(flashChipDriverHandle, addr);
-    return (-1 * res);
+    if (a_Littlefs_IsActive(c))
+    {
+        Lfs_AllocSnapshot_Invalidate();
+        return Lfs_W25qxxCache_Prog(c, block, off, buffer, size);
+    }
+    if (NULL == lfsActive)
+    {
+        Lfs_AllocSnapshot_Invalidate();     // a bank formatted at mount, it may become the active one
+    }
+    return Lfs_W25qxxPreErase_Prog(c, block, off, buffer, size);
 }
 
-// Sync the state of the underlying block device. Negative error codes are propagated to the user.
-static int user_provided_block_device_sync(const struct lfs_config *c)
+static int a_Littlefs_Erase(const struct lfs_config *c, lfs_block_t block)
 {
-    return 0;
+    if (a_Littlefs_IsActive(c))
+    {
+        Lfs_AllocSnapshot_Invalidate();
+        return Lfs_W25qxxCache_Erase(c, block);
+    }
+    if (NULL == lfsActive)
+    {
+        Lfs_AllocSnapshot_Invalidate();
+    }
+    return Lfs_W25qxxPreErase_Erase(c, block);
+}
+
+static int a_Littlefs_Sync(const struct lfs_config *c)
+{
+    if (a_Littlefs_IsActive(c))
+    {
+        return Lfs_W25qxxCache_Sync(c);
+    }
+    return Lfs_W25qxxStripe_Sync(c);
+}
+
+// After the pre-erase scan, with the lock held. The wear file and static leveling write the
+// filesystem, the snapshot is left to the scan that follows them.
+static void a_Littlefs_Scanned(lfs_t *lfs, const uint32_t *used, uint32_t blockCount)
+{
+    if (Lfs_W25qxxWear_Level(lfs) || Lfs_W25qxxWear_Save(lfs, FALSE))
+    {
+        return;
+    }
+    Lfs_AllocSnapshot_Save(lfs, used, blockCount);
+}
+
+// configuration of the filesystem of a bank
+static void a_Littlefs_InitBank(Littlefs_Bank_s *bank, uint8_t index)
+{
+    // flash memory chips, from the first block of the bank on
+    bank->stripe.chips = lfsChips;
+    bank->stripe.chipsNumber = LFS_CHIPS_NUMBER;
+    bank->stripe.chipBlockCount = LFS_CHIP_BLOCK_COUNT;
+    bank->stripe.firstBlock = index * LFS_BANK_BLOCK_COUNT;
+    bank->cfg.context = &bank->stripe;
+
+    // block device operations, the block cache forwards to the pre-erase pool and the stripe
+    bank->cfg.read  = a_Littlefs_Read;        // short metadata reads are served from RAM
+    bank->cfg.prog  = a_Littlefs_Prog;        // the pre-erase pool forwards to the stripe
+    bank->cfg.erase = a_Littlefs_Erase;       // returns at once for blocks erased in background
+    bank->cfg.sync  = a_Littlefs_Sync;
+
+    // block device configuration
+    bank->cfg.read_size = 16;           // the block cache makes short reads cheap, 16 keeps littlefs reads aligned
+    bank->cfg.prog_size = 256;          // can program 256 byte
+    bank->cfg.block_size = LITTLEFS_BLOCK_SIZE;     // erasable block size is 4096 byte
+    bank->cfg.block_count = LFS_BANK_BLOCK_COUNT;
+    bank->cfg.cache_size = LITTLEFS_CACHE_SIZE;     // should be multiple of read_size/prog_size, one per open file plus two
+    bank->cfg.lookahead_size = sizeof(bank->lookaheadBuffer);  // bitmap of 4096 blocks, the allocator scans a whole bank at once
+    bank->cfg.block_cycles = 500;
+
+    bank->cfg.read_buffer = bank->readBuffer;
+    bank->cfg.prog_buffer = bank->progBuffer;
+    bank->cfg.lookahead_buffer = bank->lookaheadBuffer;
+}
+
+
+static bool_t a_Littlefs_CreateLock(Littlefs_Bank_s *bank)
+{
+    if (!osCreateMutex(&bank->mutex))
+    {
+        return FALSE;
+    }
+    if (!osCreateMutex(&bank->readersMutex))
+    {
+        osDeleteMutex(&bank->mutex);
+        return FALSE;
+    }
+    if (!osCreateEvent(&bank->readersDone))
+    {
+        osDeleteMutex(&bank->readersMutex);
+        osDeleteMutex(&bank->mutex);
+        return FALSE;
+    }
+    return TRUE;
+}
+
+// Exclusive, for every call but the shared reads
+static void a_Littlefs_Lock(Littlefs_Bank_s *bank)
+{
+    uint32_t readers;
+
+    osAcquireMutex(&bank->mutex);
+    // no reader gets in any more, wait for those inside
+    for (;;)
+    {
+        osAcquireMutex(&bank->readersMutex);
+        readers = bank->readers;
+        osReleaseMutex(&bank->readersMutex);
+        if (0 == readers)
+        {
+            break;
+        }
+        (void)osWaitForEvent(&bank->readersDone, INFINITE_DELAY);
+    }
+}
+
+static void a_Littlefs_Unlock(Littlefs_Bank_s *bank)
+{
+    osReleaseMutex(&bank->mutex);
+}
+
+static void a_Littlefs_LockShared(Littlefs_Bank_s *bank)
+{
+    osAcquireMutex(&bank->mutex);
+    osAcquireMutex(&bank->readersMutex);
+    bank->readers++;
+    osReleaseMutex(&bank->readersMutex);
+    osReleaseMutex(&bank->mutex);
+}
+
+static void a_Littlefs_UnlockShared(Littlefs_Bank_s *bank)
+{
+    osAcquireMutex(&bank->readersMutex);
+    if (0 == --bank->readers)
+    {
+        osSetEvent(&bank->readersDone);
+    }
+    osReleaseMutex(&bank->readersMutex);
+}
+
+// Every bank, in index order; other callers hold one bank lock at a time
+static void a_Littlefs_LockAll(void)
+{
+    uint8_t i;
+
+    for (i = 0; i < LITTLEFS_BANKS; i++)
+    {
+        a_Littlefs_Lock(&lfsBanks[i]);
+    }
+}
+
+static void a_Littlefs_UnlockAll(void)
+{
+    uint8_t i;
+
+    for (i = LITTLEFS_BANKS; i > 0; i--)
+    {
+        a_Littlefs_Unlock(&lfsBanks[i - 1]);
+    }
+}
+
+// The pre-erase pool works on the active bank, a swap restarts it. A task that waits for
+// the lock while the banks are swapped gets the new active bank.
+static void a_Littlefs_LockActive(void)
+{
+    Littlefs_Bank_s *bank;
+
+    for (;;)
+    {
+        bank = lfsActive;
+        a_Littlefs_Lock(bank);
+        if (bank == lfsActive)
+        {
+            break;
+        }
+        a_Littlefs_Unlock(bank);
+    }
+    lfsLockedActive = bank;
+}
+
+static void a_Littlefs_UnlockActive(void)
+{
+    a_Littlefs_Unlock(lfsLockedActive);
+}
+
+static Littlefs_Bank_s *a_Littlefs_Inactive(void)
+{
+    return &lfsBanks[(LITTLEFS_BANKS - 1) - (lfsActive - lfsBanks)];
+}
+
+// The bank of a path: LITTLEFS_STAGING_DIR and everything below it are in the inactive bank,
+// the rest in the active one. *bankPath is the path inside the bank.
+static Littlefs_Bank_s *a_Littlefs_Route(const char *path, const char **bankPath)
+{
+    const size_t len = sizeof(LITTLEFS_STAGING_DIR) - 2;   // without the leading '/' and the '\0'
+    const char *name = path;
+
+    *bankPath = path;
+    if (LITTLEFS_BANKS > 1)
+    {
+        while ('/' == *name)
+        {
+            name++;
+        }
+        if ((0 == strncmp(name, &LITTLEFS_STAGING_DIR[1], len)) && (('\0' == name[len]) || ('/' == name[len])))
+        {
+            *bankPath = ('\0' == name[len]) ? "/" : &name[len];
+            return a_Littlefs_Inactive();
+        }
+    }
+    return lfsActive;
+}
+
+// Take the lock of the bank of path if the filesystem is mounted. NULL means the caller must
+// fail without unlocking.
+static Littlefs_Bank_s *a_Littlefs_Enter(const char *path, const char **bankPath)
+{
+    Littlefs_Bank_s *bank;
+
+    if (!lfsMounted)
+    {
+        return NULL;
+    }
+    for (;;)
+    {
+        bank = a_Littlefs_Route(path, bankPath);
+        a_Littlefs_Lock(bank);
+        if (bank == a_Littlefs_Route(path, bankPath))
+        {
+            return bank;    // not swapped meanwhile
+        }
+        a_Littlefs_Unlock(bank);
+    }
+}
+
+// Record an object just opened in bank, with its lock held. Fails when LITTLEFS_MAX_OPEN
+// objects are open in the bank.
+static int a_Littlefs_Opened(Littlefs_Bank_s *bank, const void *object)
+{
+    uint8_t i;
+
+    if (1 == LITTLEFS_BANKS)
+    {
+        return 0;
+    }
+    for (i = 0; i < LITTLEFS_MAX_OPEN; i++)
+    {
+        if (NULL == bank->open[i])
+        {
+            bank->open[i] = object;
+            return 0;
+        }
+    }
+    return LFS_ERR_NOMEM;
 }
 
+// Forget an object closed in bank, with its lock held
+static void a_Littlefs_Closed(Littlefs_Bank_s *bank, const void *object)
+{
+    uint8_t i;
+
+    for (i = 0; (LITTLEFS_BANKS > 1) && (i < LITTLEFS_MAX_OPEN); i++)
+    {
+        if (object == bank->open[i])
+        {
+            bank->open[i] = NULL;
+            return;
+        }
+    }
+}
 
-// configuration of the filesystem is provided by this struct
-const struct lfs_config cfg = {
+// The bank a file or dir was opened in, recorded at open. No bank is locked, the other bank
+// may go on meanwhile. A swap does not move objects, the bank stays right while the caller
+// uses the object.
+static Littlefs_Bank_s *a_Littlefs_BankOf(const void *object)
+{
+    uint8_t i;
+    uint8_t j;
+
+    if (1 == LITTLEFS_BANKS)
+    {
+        return &lfsBanks[0];
+    }
+    for (i = 0; i < LITTLEFS_BANKS; i++)
+    {
+        for (j = 0; j < LITTLEFS_MAX_OPEN; j++)
+        {
+            if (object == lfsBanks[i].open[j])
+            {
+                return &lfsBanks[i];
+            }
+        }
+    }
+    return NULL;
+}
+
+// Take the lock of the bank of an open file or dir, NULL as for a_Littlefs_Enter()
+static Littlefs_Bank_s *a_Littlefs_EnterObject(const void *object)
+{
+    Littlefs_Bank_s *bank;
 
-     // flash memory chip driver handle
-     .context = (void*)&w25q128_handle,
+    if (!lfsMounted)
+    {
+        return NULL;
+    }
+    bank = a_Littlefs_BankOf(object);
+    if (NULL != bank)
+    {
+        a_Littlefs_Lock(bank);
+    }
+    return bank;
+}
 
-     // block device operations
-     .read  = user_provided_block_device_read,
-     .prog  = user_provided_block_device_prog,
-     .erase = user_provided_block_device_erase,
-     .sync  = user_provided_block_device_sync,
+// The lock a read or seek of this file needs: shared when only the file's own state and
+// cache are touched, exclusive if it may flush writes or read an inlined file from metadata.
+static Littlefs_Bank_s *a_Littlefs_EnterFile(const lfs_file_t *file, bool_t *shared)
+{
+    Littlefs_Bank_s *bank;
 
-     // block device configuration
-     .read_size = 1,            // can read 1?? or 256 byte
-     .prog_size = 256,          // can program 256 byte
-     .block_size = 4096,        // erasable block size is 4096 byte
-     .block_count = 4096,        // 128 Mbit chip has 4096 sectors of 4096 byte or 256 blocks of 64KB 
-     .cache_size = 256,         // should be multiple of read_size/prog_size
-     .lookahead_size = 256,     // should be multiple of read_size/prog_size
-     .block_cycles = 500,
- };
+    if (!lfsMounted)
+    {
+        return NULL;
+    }
+    bank = a_Littlefs_BankOf(file);
+    if (NULL == bank)
+    {
+        return NULL;
+    }
+    *shared = ((file->flags & LFS_O_RDWR) == LFS_O_RDONLY) && !(file->flags & LFS_F_INLINE);
+    if (*shared)
+    {
+        a_Littlefs_LockShared(bank);
+    }
+    else
+    {
+        a_Littlefs_Lock(bank);
+    }
+    return bank;
+}
 
+static void a_Littlefs_LeaveFile(Littlefs_Bank_s *bank, bool_t shared)
+{
+    if (shared)
+    {
+        a_Littlefs_UnlockShared(bank);
+    }
+    else
+    {
+        a_Littlefs_Unlock(bank);
+    }
+}
 
-int8_t Littlefs_Init()
+// Mount a bank, format it on the first boot, read its generation
+static int a_Littlefs_MountBank(Littlefs_Bank_s *bank)
 {
-    // mount the filesystem
-    int8_t err = lfs_mount(&lfs_global, &cfg);
+    int err = lfs_mount(&bank->lfs, &bank->cfg);
 
-    // reformat if we can't mount the filesystem, this should only happen on the first boot
+    // format only when no superblock is found, which should only happen on the first boot. A
+    // volume of another geometry or version (LFS_ERR_INVAL), e.g. written with another
+    // LITTLEFS_BANKS, is left alone: the mount fails and the user decides.
+    if (LFS_ERR_INVAL == err)
+    {
+        TRACE_ERROR("littlefs: bank %u does not match the configuration, not formatted\r\n",
+                    (unsigned int)(bank - lfsBanks));
+    }
+    else if (LFS_ERR_CORRUPT == err)
+    {
+        TRACE_INFO("littlefs: no filesystem in bank %u, formatting\r\n", (unsigned int)(bank - lfsBanks));
+        err = lfs_format(&bank->lfs, &bank->cfg);
+        if (0 == err)
+        {
+            err = lfs_mount(&bank->lfs, &bank->cfg);
+        }
+    }
     if (err)
     {
-        err = lfs_format(&lfs_global, &cfg);           
-        err = lfs_mount(&lfs_global, &cfg);
+        return err;
     }
 
-    return err;
+    if (lfs_getattr(&bank->lfs, "/", LFS_BANK_ATTR, &bank->generation, sizeof(bank->generation)) != (lfs_ssize_t)sizeof(bank->generation))
+    {
+        bank->generation = 0;
+    }
+    return 0;
 }
 
+// Mount the banks, pick the active one, count the boot. *usedBlocks is set when the allocator
+// snapshot was loaded, the first allocation does not traverse the filesystem then.
+static int a_Littlefs_Mount(int32_t *usedBlocks)
+{
+    Littlefs_Bank_s *active = &lfsBanks[0];
+    lfs_t *lfs;
+    uint32_t snapshotUsed;
+    uint32_t boot_count = 0;
+    lfs_file_t file;
+    uint8_t i;
+    int err;
+
+    for (i = 0; i < LITTLEFS_BANKS; i++)
+    {
+        err = a_Littlefs_MountBank(&lfsBanks[i]);
+        if (err)
+        {
+            return err;
+        }
+        if (lfsBanks[i].generation > active->generation)
+        {
+            active = &lfsBanks[i];
+        }
+    }
+    lfsActive = active;
+    lfs = &active->lfs;
 
-int8_t Littlefs_Startup()
-{    
-     int err = Littlefs_Init();
-     if (err)
-     {
-         TRACE_PRINTF("\r\n-------------------LittleFS mount FAIL! Error = %d\r\n", err);
-     }
-     else
-     {
-         TRACE_PRINTF("\r\n+++++++++++++++++++LittleFS mount OK!\r\n");
-     }
-     
- #if 0    
-     // read current count
-     uint32_t boot_count = 0;
-     
-     lfs_file_open(&lfs_global, &lfs_global_file, "boots.txt", LFS_O_RDWR | LFS_O_CREAT);
-     lfs_file_read(&lfs_global, &lfs_global_file, &boot_count, sizeof(boot_count));
-
-     // update boot count
-     boot_count += 1;
-     lfs_file_rewind(&lfs_global, &lfs_global_file);
-     lfs_file_write(&lfs_global, &lfs_global_file, &boot_count, sizeof(boot_count));
-
-     // remember the storage is not updated until the file is closed successfully
-     lfs_file_close(&lfs_global, &lfs_global_file);
-
-    // print the boot count
-    uart_print("littlefs: boot_count: %d\r\n", boot_count);
-    //printf("littlefs: boot_count: %d\n", boot_count);
-    
-    //Create test directory:   
-    err = lfs_mkdir(&lfs_global, "/test"); // Returns a negative error code on failure.
-    if (err < 0)
-    {
-        printf("littlefs: lfs_mkdir(/test) ERROR!!: %d\n", err);
-    }
-    err = lfs_mkdir(&lfs_global, "foobar"); // Returns a negative error code on failure.
-    if (err < 0)
-    {
-        printf("littlefs: lfs_mkdir(foobar) ERROR!!: %d\n", err);
-    }
-#endif    
-    
-    // release any resources we were using
-    lfs_unmount(&lfs_global);
-    
+    // before anything is written, the boot count makes the snapshot stale
+    *usedBlocks = -1;
+    if (0 == Lfs_AllocSnapshot_Load(lfs, &snapshotUsed))
+    {
+        *usedBlocks = (int32_t)snapshotUsed;
+    }
+    // erases since reset, format included, are added to the saved counts
+    if (0 != Lfs_W25qxxWear_Load(lfs))
+    {
+        TRACE_INFO("littlefs: no wear counts saved\r\n");
+    }
+
+    // read current count, update it; the storage is not updated until the file is closed successfully
+    if (0 == lfs_file_open(lfs, &file, "boots.txt", LFS_O_RDWR | LFS_O_CREAT))
+    {
+        (void)lfs_file_read(lfs, &file, &boot_count, sizeof(boot_count));
+        boot_count += 1;
+        (void)lfs_file_rewind(lfs, &file);
+        (void)lfs_file_write(lfs, &file, &boot_count, sizeof(boot_count));
+        (void)lfs_file_close(lfs, &file);
+    }
+    TRACE_INFO("littlefs: boot_count: %u\r\n", (unsigned int)boot_count);
+    TRACE_INFO("littlefs: bank %u of %u active, generation %u\r\n", (unsigned int)(active - lfsBanks),
+               (unsigned int)LITTLEFS_BANKS, (unsigned int)active->generation);
     return 0;
 }
 
 
-// Those below are not implemented properly. See fs_port_custom_littlefs.c for reference
-void Littlefs_FileOpen(void *file, const char *path, const unsigned int mode)
+// Mounts the filesystem once, later calls return at once. Call it before any other task uses the filesystem.
+int8_t Littlefs_Startup()
+{
+    struct lfs_fsinfo fsInfo;
+    Lfs_W25qxxWearStats_s wearStats;
+    lfs_ssize_t used;
+    int32_t snapshotUsed;
+    uint8_t i;
+    int err;
+
+    if (lfsMounted)
+    {
+        return 0;
+    }
+    if (!lfsLockCreated)
+    {
+        for (i = 0; i < LITTLEFS_BANKS; i++)
+        {
+            a_Littlefs_InitBank(&lfsBanks[i], i);
+            if (!a_Littlefs_CreateLock(&lfsBanks[i]))
+            {
+                break;
+            }
+        }
+        if ((i < LITTLEFS_BANKS) || (0 != Lfs_W25qxxCache_Init()))
+        {
+            TRACE_ERROR("\r\n-------------------LittleFS mutex FAIL!\r\n");
+            return -1;
+        }
+        lfsLockCreated = TRUE;
+    }
+
+    a_Littlefs_LockAll();
+    err = a_Littlefs_Mount(&snapshotUsed);
+    a_Littlefs_UnlockAll();
+    if (err)
+    {
+        TRACE_PRINTF("\r\n-------------------LittleFS mount FAIL! Error = %d\r\n", err);
+        return (int8_t)err;
+    }
+    TRACE_PRINTF("\r\n+++++++++++++++++++LittleFS mount OK!\r\n");
+    lfsMounted = TRUE;
+
+    // erase blocks freed by littlefs while the filesystem is idle, the pool takes the lock itself;
+    // its scans save the wear counts and leave the allocator snapshot for the next mount
+    err = Lfs_W25qxxPreErase_Start(&lfsActive->lfs, a_Littlefs_LockActive, a_Littlefs_UnlockActive, a_Littlefs_Scanned);
+    if (err)
+    {
+        TRACE_ERROR("littlefs: pre-erase pool not started: %d\r\n", err);
+    }
+
+    Lfs_W25qxxWear_GetStats(&wearStats);
+    TRACE_INFO("littlefs: erases min %u max %u mean %u, %u blocks failed\r\n", (unsigned int)wearStats.minErases,
+               (unsigned int)wearStats.maxErases, (unsigned int)wearStats.meanErases, (unsigned int)wearStats.failedBlocks);
+
+    a_Littlefs_LockActive();
+    if (0 == lfs_fs_stat(&lfsLockedActive->lfs, &fsInfo))
+    {
+        TRACE_DEBUG("FILESYSTEM: Total logical blocks=%d; block size=%d(Bytes); total size=%d(Bytes)\r\n", fsInfo.block_count, fsInfo.block_size, fsInfo.block_count * fsInfo.block_size);
+        // Returns the number of allocated blocks, or a negative error code on failure.
+        // The snapshot has the count as of its save, it saves traversing the filesystem here.
+        used = (snapshotUsed >= 0) ? snapshotUsed : lfs_fs_size(&lfsLockedActive->lfs);
+        if (used >= 0)
+        {
+            TRACE_DEBUG("FILESYSTEM: Allocated logical blocks=%d; block size=%d(Bytes); total allocated size=%d(Bytes)\r\n", used, fsInfo.block_size, used * fsInfo.block_size);
+        }
+    }
+    a_Littlefs_UnlockActive();
+
+    return 0;
+}
+
+// The inactive bank gets the next generation in one littlefs commit: a reset before it keeps
+// the old active bank, one after it mounts the new. The block cache, the pre-erase pool and
+// the allocator snapshot move to the new active bank.
+uint8_t Littlefs_BankSwap(void)
 {
+    Littlefs_Bank_s *from;
+    Littlefs_Bank_s *to;
+    uint32_t generation;
     int err = 0;
-    lfs_file_t *lfsFile = (lfs_file_t *)file;
-    err = lfs_file_open(&lfs_global, lfsFile, path, (enum lfs_open_flags)mode); // TODO: maybe it is necessary to convert uint_t mode to enum lfs_open_flags in specific manner??
-    if(err)
+
+    if (!lfsMounted || (LITTLEFS_BANKS < 2))
+    {
+        return 1;
+    }
+
+    Lfs_W25qxxPreErase_Stop();      // it takes the lock itself
+    a_Littlefs_LockAll();
+    from = lfsActive;
+    to = a_Littlefs_Inactive();
+    if (NULL != to->lfs.mlist)
+    {
+        err = LFS_ERR_INVAL;        // something is still open in the bank, e.g. an upload
+    }
+    if (0 == err)
+    {
+        // the snapshot is of the active bank, it must never be loaded for the other one
+        Lfs_AllocSnapshot_Invalidate();
+        err = Lfs_W25qxxCache_Sync(&from->cfg);
+    }
+    if (0 == err)
+    {
+        generation = from->generation + 1;
+        err = lfs_setattr(&to->lfs, "/", LFS_BANK_ATTR, &generation, sizeof(generation));
+    }
+    if (0 == err)
+    {
+        to->generation = generation;
+        Lfs_W25qxxCache_Invalidate();
+        lfsActive = to;
+        (void)Lfs_W25qxxWear_Save(&to->lfs, TRUE);     // the counts go on in the file of the active bank
+        TRACE_INFO("littlefs: bank %u active, generation %u\r\n", (unsigned int)(to - lfsBanks), (unsigned int)generation);
+    }
+    a_Littlefs_UnlockAll();
+
+    if (0 != Lfs_W25qxxPreErase_Start(&lfsActive->lfs, a_Littlefs_LockActive, a_Littlefs_UnlockActive, a_Littlefs_Scanned))
     {
-        file = NULL;
+        TRACE_ERROR("littlefs: pre-erase pool not started\r\n");
     }
+    return (0 == err) ? 0 : 1;
 }
 
-void Littlefs_FileClose(void *file)
+
+// All functions below may be called from any task once Littlefs_Startup() succeeded.
+// Each holds the lock of its bank for the one littlefs call it makes. Reads and seeks of files
+// opened read-only run in parallel, e.g. several FTP downloads; everything else runs alone in
+// its bank. A file or dir object must not be used by two tasks at once.
+uint8_t Littlefs_FileOpen(lfs_file_t *file, const char *path, int flags)
 {
-    lfs_file_t *lfsFile = (lfs_file_t *)file;
-    (void)lfs_file_close(&lfs_global, lfsFile);
+    Littlefs_Bank_s *bank;
+    const char *bankPath;
+    int res;
+
+    bank = a_Littlefs_Enter(path, &bankPath);
+    if (NULL == bank)
+    {
+        return 1;
+    }
+    res = lfs_file_open(&bank->lfs, file, bankPath, flags);
+    if ((0 == res) && (0 != a_Littlefs_Opened(bank, file)))
+    {
+        (void)lfs_file_close(&bank->lfs, file);
+        res = LFS_ERR_NOMEM;
+    }
+    a_Littlefs_Unlock(bank);
+    return (0 == res) ? 0 : 1;
 }
 
-uint8_t Littlefs_FileExists(const char *path)
+uint8_t Littlefs_FileOpenCfg(lfs_file_t *file, const char *path, int flags, const struct lfs_file_config *fileCfg)
 {
-    int res = 0;
-    res = lfs_file_open(&lfs_global, &lfs_global_file, path, LFS_O_EXCL); // open file with LFS_O_EXCL flag: if file exists lfs_file_open() fails
+    Littlefs_Bank_s *bank;
+    const char *bankPath;
+    int res;
+
+    bank = a_Littlefs_Enter(path, &bankPath);
+    if (NULL == bank)
+    {
+        return 1;
+    }
+    res = lfs_file_opencfg(&bank->lfs, file, bankPath, flags, fileCfg);
+    if ((0 == res) && (0 != a_Littlefs_Opened(bank, file)))
+    {
+        (void)lfs_file_close(&bank->lfs, file);
+        res = LFS_ERR_NOMEM;
+    }
+    a_Littlefs_Unlock(bank);
     return (0 == res) ? 0 : 1;
 }
 
+void Littlefs_FileClose(lfs_file_t *file)
+{
+    Littlefs_Bank_s *bank = a_Littlefs_EnterObject(file);
+
+    if (NULL == bank)
+    {
+        return;
+    }
+    (void)lfs_file_close(&bank->lfs, file);
+    a_Littlefs_Closed(bank, file);
+    a_Littlefs_Unlock(bank);
+}
+
+uint8_t Littlefs_FileExists(const char *path)
+{
+    struct lfs_info info;
+
+    return ((0 == Littlefs_FileStatGet(path, &info)) && (LFS_TYPE_REG == info.type)) ? 1 : 0;
+}
+
 uint8_t Littlefs_FileDelete(const char *path)
 {
-    int res = 0;
-    res = lfs_remove(&lfs_global, path); // Returns a negative error code on failure.
+    Littlefs_Bank_s *bank;
+    const char *bankPath;
+    int res;
+
+    bank = a_Littlefs_Enter(path, &bankPath);
+    if (NULL == bank)
+    {
+        return 1;
+    }
+    res = lfs_remove(&bank->lfs, bankPath); // Returns a negative error code on failure.
+    a_Littlefs_Unlock(bank);
     return (res >= 0) ? 0 : 1;
 }
 
 uint8_t Littlefs_FileRename(const char *oldPath, const char *newPath)
 {
-    int res = 0;
-    res = lfs_rename(&lfs_global, oldPath, newPath); // Returns a negative error code on failure.
+    Littlefs_Bank_s *bank;
+    const char *bankOldPath;
+    const char *bankNewPath;
+    int res = LFS_ERR_INVAL;
+
+    bank = a_Littlefs_Enter(oldPath, &bankOldPath);
+    if (NULL == bank)
+    {
+        return 1;
+    }
+    // nothing is moved from one bank to the other
+    if (bank == a_Littlefs_Route(newPath, &bankNewPath))
+    {
+        res = lfs_rename(&bank->lfs, bankOldPath, bankNewPath); // Returns a negative error code on failure.
+    }
+    a_Littlefs_Unlock(bank);
     return (res >= 0) ? 0 : 1;
 }
 
-uint8_t Littlefs_FileWrite(void *file, void *data, size_t length)
+uint8_t Littlefs_FileWrite(lfs_file_t *file, const void *data, size_t length)
 {
-    lfs_ssize_t res = -1;
-    res = lfs_file_write(&lfs_global, (lfs_file_t *)file, (const void *)data, (lfs_size_t)length); // Returns the number of bytes written, or a negative error code on failure.
-    return (res >= 0) ? 0 : 1;
+    Littlefs_Bank_s *bank = a_Littlefs_EnterObject(file);
+    lfs_ssize_t res;
+
+    if (NULL == bank)
+    {
+        return 1;
+    }
+    res = lfs_file_write(&bank->lfs, file, data, (lfs_size_t)length); // Returns the number of bytes written, or a negative error code on failure.
+    a_Littlefs_Unlock(bank);
+    return ((res >= 0) && ((size_t)res == length)) ? 0 : 1;
 }
 
-uint8_t Littlefs_FileRead(void *file, void *data, size_t size, size_t *length)
+// The block being written may stay in the block cache after the call, the next other program,
+// erase or sync writes it first, so data always reaches the chip before the commit naming it.
+// The inactive bank has no block cache, its blocks are programmed as littlefs flushes them.
+uint8_t Littlefs_FileWriteStream(lfs_file_t *file, const void *data, size_t length)
 {
-    lfs_ssize_t res = -1;
-    res = lfs_file_read(&lfs_global, (lfs_file_t *)file, (void *)data, (lfs_size_t)size);// Returns the number of bytes read, or a negative error code on failure.
-    if (res >= 0)
+    Littlefs_Bank_s *bank = a_Littlefs_EnterObject(file);
+    bool_t active;
+    lfs_ssize_t res;
+
+    if (NULL == bank)
     {
-        *length = res;
-        return 0;
+        return 1;
     }
-    else
+    active = (bank == lfsActive) ? TRUE : FALSE;
+    if (active)
     {
-        *length = 0;
+        Lfs_W25qxxCache_SetWriteBehind(TRUE);
     }
-    
-    return 1;
+    res = lfs_file_write(&bank->lfs, file, data, (lfs_size_t)length);
+    if (active)
+    {
+        Lfs_W25qxxCache_SetWriteBehind(FALSE);
+    }
+    a_Littlefs_Unlock(bank);
+    return ((res >= 0) && ((size_t)res == length)) ? 0 : 1;
 }
 
-uint8_t Littlefs_FileSizeGet(const char *path, uint32_t *size)
+uint8_t Littlefs_FileSync(lfs_file_t *file)
 {
-    lfs_soff_t res = -1;
-    void *file = NULL;
+    Littlefs_Bank_s *bank = a_Littlefs_EnterObject(file);
+    int res;
 
-    Littlefs_FileOpen(file, path, LFS_O_RDONLY);            // Open file
-    if(NULL == file)
+    if (NULL == bank)
     {
         return 1;
     }
+    res = lfs_file_sync(&bank->lfs, file);
+    a_Littlefs_Unlock(bank);
+    return (0 == res) ? 0 : 1;
+}
 
-    res = lfs_file_size(&lfs_global, (lfs_file_t *)file);   // Returns the size of the file, or a negative error code on failure.(&lfs_global, (lfs_file_t *)file, (lfs_soff_t)offset, (int32_t)origin);
-    
-    Littlefs_FileClose(file);                               // Close file
+uint8_t Littlefs_FileRead(lfs_file_t *file, void *data, size_t size, size_t *length)
+{
+    Littlefs_Bank_s *bank;
+    lfs_ssize_t res;
+    bool_t shared;
 
-    if (res >= 0)
+    *length = 0;
+    bank = a_Littlefs_EnterFile(file, &shared);
+    if (NULL == bank)
     {
-        *size = res;
+        return 1;
     }
-    else
+    res = lfs_file_read(&bank->lfs, file, data, (lfs_size_t)size); // Returns the number of bytes read, or a negative error code on failure.
+    a_Littlefs_LeaveFile(bank, shared);
+    if (res < 0)
+    {
+        return 1;
+    }
+    *length = (size_t)res;
+    return 0;
+}
+
+uint8_t Littlefs_FileSizeGet(const char *path, uint32_t *size)
+{
+    struct lfs_info info;
+
+    *size = 0;
+    if ((0 != Littlefs_FileStatGet(path, &info)) || (LFS_TYPE_REG != info.type))
     {
-        *size = 0;
+        return 1;
     }
+    *size = info.size;
+    return 0;
+}
 
-    return (res >= 0) ? 0 : 1;
+uint8_t Littlefs_FileSize(lfs_file_t *file, uint32_t *size)
+{
+    Littlefs_Bank_s *bank;
+    lfs_soff_t res;
+    bool_t shared;
+
+    *size = 0;
+    bank = a_Littlefs_EnterFile(file, &shared);
+    if (NULL == bank)
+    {
+        return 1;
+    }
+    res = lfs_file_size(&bank->lfs, file); // Returns the size of the file, or a negative error code on failure.
+    a_Littlefs_LeaveFile(bank, shared);
+    if (res < 0)
+    {
+        return 1;
+    }
+    *size = (uint32_t)res;
+    return 0;
 }
 
-uint8_t Littlefs_FileSeek(void *file, int32_t offset, int32_t origin)
+uint8_t Littlefs_FileSeek(lfs_file_t *file, int32_t offset, int whence)
 {
-    lfs_soff_t res = -1;
-    res = lfs_file_seek(&lfs_global, (lfs_file_t *)file, (lfs_soff_t)offset, (int32_t)origin);
+    Littlefs_Bank_s *bank;
+    lfs_soff_t res;
+    bool_t shared;
+
+    bank = a_Littlefs_EnterFile(file, &shared);
+    if (NULL == bank)
+    {
+        return 1;
+    }
+    res = lfs_file_seek(&bank->lfs, file, (lfs_soff_t)offset, whence); // Returns the new position, or a negative error code on failure.
+    a_Littlefs_LeaveFile(bank, shared);
     return (res >= 0) ? 0 : 1;
 }
 
-uint8_t Littlefs_FileStatGet(const char *path, void *fileStat)
+uint8_t Littlefs_FileStatGet(const char *path, struct lfs_info *info)
 {
-    int res = -1; 
-    // Fills out the info structure, based on the specified file or directory. Find info about a file or directory.
-    res = lfs_stat(&lfs_global, path, (struct lfs_info *)fileStat); // Returns a negative error code on failure.
+    Littlefs_Bank_s *bank;
+    const char *bankPath;
+    int res;
+
+    bank = a_Littlefs_Enter(path, &bankPath);
+    if (NULL == bank)
+    {
+        return 1;
+    }
+    // Fills out the info structure, based on the specified file or directory.
+    res = lfs_stat(&bank->lfs, bankPath, info); // Returns a negative error code on failure.
+    a_Littlefs_Unlock(bank);
     return (res >= 0) ? 0 : 1;
 }
 
@@ -271,46 +916,92 @@ uint8_t Littlefs_FileStatGet(const char *path, void *fileStat)
 
 uint8_t Littlefs_DirExists(const char *path)
 {
-    int res = -1;
-    lfs_dir_t *dir = NULL;
-    res = lfs_dir_open(&lfs_global, dir, path); // Open a directory. Returns a negative error code on failure.
-    return (res == 0) ? 1 : 0;
+    struct lfs_info info;
+
+    return ((0 == Littlefs_FileStatGet(path, &info)) && (LFS_TYPE_DIR == info.type)) ? 1 : 0;
 }
 
 uint8_t Littlefs_DirCreate(const char *path)
 {
-    lfs_ssize_t res = -1;
-    res = lfs_mkdir(&lfs_global, path); // Returns a negative error code on failure
+    Littlefs_Bank_s *bank;
+    const char *bankPath;
+    int res;
+
+    bank = a_Littlefs_Enter(path, &bankPath);
+    if (NULL == bank)
+    {
+        return 1;
+    }
+    res = lfs_mkdir(&bank->lfs, bankPath); // Returns a negative error code on failure
+    a_Littlefs_Unlock(bank);
     return (res >= 0) ? 0 : 1;
 }
 
 uint8_t Littlefs_DirRemove(const char *path)
 {
-    lfs_ssize_t res = -1;
-    res = lfs_remove(&lfs_global, path); // If removing a directory, the directory must be empty. Returns a negative error code on failure.
+    Littlefs_Bank_s *bank;
+    const char *bankPath;
+    int res;
+
+    bank = a_Littlefs_Enter(path, &bankPath);
+    if (NULL == bank)
+    {
+        return 1;
+    }
+    res = lfs_remove(&bank->lfs, bankPath); // If removing a directory, the directory must be empty. Returns a negative error code on failure.
+    a_Littlefs_Unlock(bank);
     return (res >= 0) ? 0 : 1;
 }
 
-uint8_t Littlefs_DirRead(void *dir, void *dirEntry)    ///??? params
+uint8_t Littlefs_DirRead(lfs_dir_t *dir, struct lfs_info *dirEntry)
 {
-    lfs_ssize_t res = -1;
-    // Fills out the info structure, based on the specified file or directory.
+    Littlefs_Bank_s *bank = a_Littlefs_EnterObject(dir);
+    int res;
+
+    if (NULL == bank)
+    {
+        return 1;
+    }
     // Returns a positive value on success, 0 at the end of directory, or a negative error code on failure.
-    res = lfs_dir_read(&lfs_global, (lfs_dir_t *)dir, (struct lfs_info *)dirEntry);
-    return (res >= 0) ? 0 : 1;
+    res = lfs_dir_read(&bank->lfs, dir, dirEntry);
+    a_Littlefs_Unlock(bank);
+    if (res < 0)
+    {
+        return 1;
+    }
+    return (0 == res) ? 2 : 0;
 }
 
-uint8_t Littlefs_DirOpen(const char *path, void *dir)    ///??? params
+uint8_t Littlefs_DirOpen(const char *path, lfs_dir_t *dir)
 {
-    lfs_ssize_t res = -1;
-    res = lfs_dir_open(&lfs_global, &lfs_global_dir, path); // Returns a negative error code on failure.
-    return res;
+    Littlefs_Bank_s *bank;
+    const char *bankPath;
+    int res;
+
+    bank = a_Littlefs_Enter(path, &bankPath);
+    if (NULL == bank)
+    {
+        return 1;
+    }
+    res = lfs_dir_open(&bank->lfs, dir, bankPath); // Returns a negative error code on failure.
+    if ((0 == res) && (0 != a_Littlefs_Opened(bank, dir)))
+    {
+        (void)lfs_dir_close(&bank->lfs, dir);
+        res = LFS_ERR_NOMEM;
+    }
+    a_Littlefs_Unlock(bank);
+    return (0 == res) ? 0 : 1;
 }
 
-void Littlefs_DirClose(void *dir)
+void Littlefs_DirClose(lfs_dir_t *dir)
 {
-    lfs_ssize_t res = -1;
-    res = lfs_dir_close(&lfs_global, (lfs_dir_t *)dir); // Returns a negative error code on failure.
-    (void)res;
-    return;
+    Littlefs_Bank_s *bank = a_Littlefs_EnterObject(dir);
+
+    if (NULL == bank)
+    {
+        return;
+    }
+    (void)lfs_dir_close(&bank->lfs, dir);
+    a_Littlefs_Closed(bank, dir);
+    a_Littlefs_Unlock(bank);
 }
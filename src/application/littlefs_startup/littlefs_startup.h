@@ -12,31 +12,58 @@
 #include "driver_w25qxx.h"
 #include "lfs.h"
 
-int8_t Littlefs_Init();
+#define LITTLEFS_CACHE_SIZE     512     // lfs_config.cache_size, the size of a file buffer given to Littlefs_FileOpenCfg()
+#define LITTLEFS_BLOCK_SIZE     4096    // lfs_config.block_size, the erase block of the chips
+#ifndef LITTLEFS_BANKS
+    #define LITTLEFS_BANKS      1       // littlefs partitions of the chips: 1 the whole chips, 2 two halves;
+                                        // the flash is not converted, a volume of the other layout does not mount
+#endif
+#define LITTLEFS_MAX_OPEN       16      // files and dirs open at once in a bank through Littlefs_*Open(), with two banks
+#define LITTLEFS_STAGING_DIR    "/staging"  // paths below it are in the inactive bank, it is not listed in "/"
+
+// Mounts the filesystem once and owns the mount, later calls return 0 at once
 int8_t Littlefs_Startup();
 
-void Littlefs_FileOpen(void *file, const char *path, const unsigned int mode);
-void Littlefs_FileClose(void *file);
-uint8_t Littlefs_FileExists(const char *path);
+// With two banks every path is in the active one, those under LITTLEFS_STAGING_DIR in the
+// inactive one, each bank a filesystem with its own lock: a new set of files is written there
+// while the active bank serves readers. The swap makes the inactive bank the active one and the
+// other way round, atomically and for good. Files open in the old active bank read the old
+// contents until they are closed. Fails while anything is open in the inactive bank.
+uint8_t Littlefs_BankSwap(void);
+
+// Thread-safe access for every task, all fail until Littlefs_Startup() succeeded. Reads and
+// seeks of files opened read-only run in parallel, every other call runs alone in its bank.
+// uint8_t results are 0 on success and 1 on failure unless noted.
+uint8_t Littlefs_FileOpen(lfs_file_t *file, const char *path, int flags);   // flags are enum lfs_open_flags
+// As Littlefs_FileOpen() but littlefs does not malloc the file buffer, fileCfg->buffer must be
+// LITTLEFS_CACHE_SIZE bytes; fileCfg and the buffer belong to the file until it is closed
+uint8_t Littlefs_FileOpenCfg(lfs_file_t *file, const char *path, int flags, const struct lfs_file_config *fileCfg);
+void Littlefs_FileClose(lfs_file_t *file);
+uint8_t Littlefs_FileExists(const char *path);                              // 1 if a regular file is there
 uint8_t Littlefs_FileDelete(const char *path);
-uint8_t Littlefs_FileRename(const char *oldPath, const char *newPath);
+uint8_t Littlefs_FileRename(const char *oldPath, const char *newPath);      // both in the same bank
 
-uint8_t Littlefs_FileRead(void *file, void *data, size_t size, size_t *length);
-uint8_t Littlefs_FileWrite(void *file, void *data, size_t length);
+uint8_t Littlefs_FileRead(lfs_file_t *file, void *data, size_t size, size_t *length);   // *length 0 at end of file
+uint8_t Littlefs_FileWrite(lfs_file_t *file, const void *data, size_t length);         // fails on a short write
+// As Littlefs_FileWrite() for long sequential writes of a new file, best in whole blocks: each
+// block is programmed at once when it is full, not per cache flush, and not read back
+uint8_t Littlefs_FileWriteStream(lfs_file_t *file, const void *data, size_t length);
+uint8_t Littlefs_FileSync(lfs_file_t *file);                                // commits what was written so far
 
 uint8_t Littlefs_FileSizeGet(const char *path, uint32_t *size);
-uint8_t Littlefs_FileSeek(void *file, int32_t offset, int32_t origin);
-uint8_t Littlefs_FileStatGet(const char *path, void *fileStat);
+uint8_t Littlefs_FileSize(lfs_file_t *file, uint32_t *size);               // an open file, with what is not committed yet
+uint8_t Littlefs_FileSeek(lfs_file_t *file, int32_t offset, int whence);    // whence is enum lfs_whence_flags
+uint8_t Littlefs_FileStatGet(const char *path, struct lfs_info *info);      // files and directories
 
 
-uint8_t Littlefs_DirExists(const char *path);
+uint8_t Littlefs_DirExists(const char *path);                               // 1 if a directory is there
 
 uint8_t Littlefs_DirCreate(const char *path);
-uint8_t Littlefs_DirRemove(const char *path);
+uint8_t Littlefs_DirRemove(const char *path);                               // the directory must be empty
 
-uint8_t Littlefs_DirRead(void *dir, void *dirEntry);    ///??? params
+uint8_t Littlefs_DirRead(lfs_dir_t *dir, struct lfs_info *dirEntry);        // 2 at the end of the directory
 
-uint8_t Littlefs_DirOpen(const char *path, void *dir);  ///??? params
-void Littlefs_DirClose(void *dir);
+uint8_t Littlefs_DirOpen(const char *path, lfs_dir_t *dir);
+void Littlefs_DirClose(lfs_dir_t *dir);
 
 #endif /* LITTLEFS_STARTUP_H_ */
\ No newline at end of file
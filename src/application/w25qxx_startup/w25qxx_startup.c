@@ -17,100 +17,152 @@
 
 // static
 w25qxx_handle_t w25q128_handle = {0};
+w25qxx_sched_t w25q128_sched = {0};
+static uint32_t w25q128_blankMap[(W25QXX_STARTUP_CFG_SECTORS + 31) / 32];
+#if (W25QXX_TRACE == 1)
+static w25qxx_trace_t w25q128_trace;
+#endif
 
 W25qxx_ASF_CustomDescriptor_s w25q128_extraDescriptor =
 {
     .spiInstance    = W25QXX_STARTUP_CFG_PHY_SPI_INSTANCE_PTR,
+    .spiIndex       = W25QXX_STARTUP_CFG_PHY_SPI_INDEX,
     .chipSelectPin  = W25QXX_STARTUP_CFG_PHY_CS_PIN,
-    .usartInstance  = W25QXX_STARTUP_CFG_PHY_USART_INSTANCE_PTR
+    .usartInstance  = W25QXX_STARTUP_CFG_PHY_USART_INSTANCE_PTR,
+    .phy            = W25QXX_STARTUP_CFG_PHY,
+    .spiTransferMode = W25QXX_STARTUP_CFG_PHY_SPI_TRANSFER_MODE
 };
 
 
 
-uint8_t W25qxx_Startup()
+uint8_t W25qxx_StartupDevice(w25qxx_handle_t *handle, W25qxx_ASF_CustomDescriptor_s *descr, w25qxx_type_t type)
 {
     uint8_t res;
     w25qxx_info_t info;
     
     /* link interface function */
-    DRIVER_W25QXX_LINK_INIT(&w25q128_handle, w25qxx_handle_t);
-    DRIVER_W25QXX_LINK_SPI_QSPI_INIT(&w25q128_handle, w25qxx_interface_spi_qspi_init);
-    DRIVER_W25QXX_LINK_SPI_QSPI_DEINIT(&w25q128_handle, w25qxx_interface_spi_qspi_deinit);
-    DRIVER_W25QXX_LINK_SPI_QSPI_WRITE_READ(&w25q128_handle, w25qxx_interface_spi_qspi_write_read);
-    DRIVER_W25QXX_LINK_DELAY_MS(&w25q128_handle, w25qxx_interface_delay_ms);
-    DRIVER_W25QXX_LINK_DELAY_US(&w25q128_handle, w25qxx_interface_delay_us);
-    DRIVER_W25QXX_LINK_DEBUG_PRINT(&w25q128_handle, w25qxx_interface_debug_print);
-    DRIVER_W25QXX_LINK_EXTRA_VOID_PTR(&w25q128_handle, (void*)&w25q128_extraDescriptor);
+    DRIVER_W25QXX_LINK_INIT(handle, w25qxx_handle_t);
+    DRIVER_W25QXX_LINK_SPI_QSPI_INIT(handle, w25qxx_interface_spi_qspi_init);
+    DRIVER_W25QXX_LINK_SPI_QSPI_DEINIT(handle, w25qxx_interface_spi_qspi_deinit);
+    DRIVER_W25QXX_LINK_SPI_QSPI_WRITE_READ(handle, w25qxx_interface_spi_qspi_write_read);
+    DRIVER_W25QXX_LINK_DELAY_MS(handle, w25qxx_interface_delay_ms);
+    DRIVER_W25QXX_LINK_DELAY_US(handle, w25qxx_interface_delay_us);
+    DRIVER_W25QXX_LINK_WAIT_READY(handle, w25qxx_interface_wait_ready);
+    DRIVER_W25QXX_LINK_DEBUG_PRINT(handle, w25qxx_interface_debug_print);
+    DRIVER_W25QXX_LINK_EXTRA_VOID_PTR(handle, (void*)descr);
     
     /* get information */
     res = w25qxx_info(&info);
     if (res != 0)
     {
-        w25qxx_interface_debug_print(w25q128_handle.extra, "w25qxx: get info failed.\n");
-        (void)w25qxx_deinit(&w25q128_handle);
+        w25qxx_interface_debug_print(handle->extra, "w25qxx: get info failed.\n");
+        (void)w25qxx_deinit(handle);
         return 1;
     }
     else
     {
         /* print chip information */
-        w25qxx_interface_debug_print(w25q128_handle.extra, "w25qxx: chip is %s.\n", info.chip_name);
-        w25qxx_interface_debug_print(w25q128_handle.extra, "w25qxx: manufacturer is %s.\n", info.manufacturer_name);
-        w25qxx_interface_debug_print(w25q128_handle.extra, "w25qxx: interface is %s.\n", info.interface);
-        w25qxx_interface_debug_print(w25q128_handle.extra, "w25qxx: driver version is %d.%d.\n\n", info.driver_version / 1000, (info.driver_version % 1000) / 100);
+        w25qxx_interface_debug_print(handle->extra, "w25qxx: chip is %s.\n", info.chip_name);
+        w25qxx_interface_debug_print(handle->extra, "w25qxx: manufacturer is %s.\n", info.manufacturer_name);
+        w25qxx_interface_debug_print(handle->extra, "w25qxx: interface is %s.\n", info.interface);
+        w25qxx_interface_debug_print(handle->extra, "w25qxx: driver version is %d.%d.\n\n", info.driver_version / 1000, (info.driver_version % 1000) / 100);
     }
     
     /* set chip type */
-    //w25qxx_interface_debug_print(w25q128_handle.extra, "w25qxx: about to set type.\n");
-    res = w25qxx_set_type(&w25q128_handle, W25QXX_STARTUP_CFG_TYPE);
+    //w25qxx_interface_debug_print(handle->extra, "w25qxx: about to set type.\n");
+    res = w25qxx_set_type(handle, type);
     if (res != 0)
     {
-        w25qxx_interface_debug_print(w25q128_handle.extra, "w25qxx: set type failed.\n");
-        (void)w25qxx_deinit(&w25q128_handle);
+        w25qxx_interface_debug_print(handle->extra, "w25qxx: set type failed.\n");
+        (void)w25qxx_deinit(handle);
         return 1;
     }
     
     /* set chip interface */
-    //w25qxx_interface_debug_print(w25q128_handle.extra, "w25qxx: about to set interface.\n");
-    res = w25qxx_set_interface(&w25q128_handle, W25QXX_STARTUP_CFG_INTERFACE);
+    //w25qxx_interface_debug_print(handle->extra, "w25qxx: about to set interface.\n");
+    res = w25qxx_set_interface(handle, W25QXX_STARTUP_CFG_INTERFACE);
     if (res != 0)
     {
-        w25qxx_interface_debug_print(w25q128_handle.extra, "w25qxx: set interface failed.\n");
-       (void)w25qxx_deinit(&w25q128_handle);
+        w25qxx_interface_debug_print(handle->extra, "w25qxx: set interface failed.\n");
+       (void)w25qxx_deinit(handle);
         return 1;
     }
     
     /* set dual quad spi */
-    //w25qxx_interface_debug_print(w25q128_handle.extra, "w25qxx: about to set dual_quad_spi.\n");
-    res = w25qxx_set_dual_quad_spi(&w25q128_handle, W25QXX_STARTUP_CFG_DUAL_QUAD_SPI);
+    //w25qxx_interface_debug_print(handle->extra, "w25qxx: about to set dual_quad_spi.\n");
+    res = w25qxx_set_dual_quad_spi(handle, W25QXX_STARTUP_CFG_DUAL_QUAD_SPI);
     if (res != 0)
     {
-        w25qxx_interface_debug_print(w25q128_handle.extra, "w25qxx: set dual quad spi failed.\n");
-        (void)w25qxx_deinit(&w25q128_handle);
+        w25qxx_interface_debug_print(handle->extra, "w25qxx: set dual quad spi failed.\n");
+        (void)w25qxx_deinit(handle);
         return 1;
     }
     
     /* chip init */
-    //w25qxx_interface_debug_print(w25q128_handle.extra, "w25qxx: about to init chip.\n");
-    res = w25qxx_init(&w25q128_handle);
+    //w25qxx_interface_debug_print(handle->extra, "w25qxx: about to init chip.\n");
+    res = w25qxx_init(handle);
     if (res != 0)
     {
-        w25qxx_interface_debug_print(w25q128_handle.extra, "w25qxx: init failed.\n");
-        (void)w25qxx_deinit(&w25q128_handle);
+        w25qxx_interface_debug_print(handle->extra, "w25qxx: init failed.\n");
+        (void)w25qxx_deinit(handle);
         return 1;
     }
     else
     {
-        if (W25QXX_STARTUP_CFG_TYPE >= W25Q256)
+        if (type >= W25Q256)
         {
-            res = w25qxx_set_address_mode(&w25q128_handle, W25QXX_ADDRESS_MODE_4_BYTE);
+            res = w25qxx_set_address_mode(handle, W25QXX_ADDRESS_MODE_4_BYTE);
             if (res != 0)
             {
-                w25qxx_interface_debug_print(&(w25q128_handle.extra), "w25qxx: set address mode failed.\n");
-                (void)w25qxx_deinit(&w25q128_handle);
+                w25qxx_interface_debug_print(handle->extra, "w25qxx: set address mode failed.\n");
+                (void)w25qxx_deinit(handle);
                 return 1;
             }
         }
     }
+    
+    /* quad io reads need the qe bit, set it in the volatile status register */
+    if (W25QXX_STARTUP_CFG_DUAL_QUAD_SPI == W25QXX_BOOL_TRUE)
+    {
+        uint8_t status2;
+        
+        res = w25qxx_get_status2(handle, &status2);
+        if ((res == 0) && ((status2 & 0x02) == 0))
+        {
+            res = w25qxx_set_status2(handle, status2 | 0x02);
+        }
+        if (res != 0)
+        {
+            w25qxx_interface_debug_print(handle->extra, "w25qxx: set quad enable failed.\n");
+            (void)w25qxx_deinit(handle);
+            return 1;
+        }
+    }
+
+    return 0;
+ }
+
+
+uint8_t W25qxx_Startup()
+{
+    if (W25qxx_StartupDevice(&w25q128_handle, &w25q128_extraDescriptor, W25QXX_STARTUP_CFG_TYPE) != 0)
+    {
+        return 1;
+    }
+    // LINK_INIT cleared the handle, the map is attached anew and starts empty
+    (void)w25qxx_set_blank_map(&w25q128_handle, w25q128_blankMap, W25QXX_STARTUP_CFG_SECTORS);
+#if (W25QXX_TRACE == 1)
+    // counters for "SITE FLASHSTAT", restart with every startup
+    (void)w25qxx_set_trace(&w25q128_handle, &w25q128_trace, w25qxx_interface_timestamp_us);
+#endif
+    
+    // reads suspend an in-flight program/erase instead of waiting for it
+    if (w25qxx_sched_init(&w25q128_sched, &w25q128_handle, w25qxx_interface_timestamp_us) != 0)
+    {
+        w25qxx_interface_debug_print(w25q128_handle.extra, "w25qxx: scheduler init failed.\n");
+        (void)w25qxx_deinit(&w25q128_handle);
+        return 1;
+    }
 
     return 0;
- }
\ No newline at end of file
+}
\ No newline at end of file
@@ -11,8 +11,19 @@
 
 #include "w25qxx_startup_cfg.h"
 #include "uart_printf.h"
+#include "driver_w25qxx.h"
+#include "w25qxx_custom_descriptor.h"
+#include "w25qxx_sched.h"
+
+extern w25qxx_handle_t w25q128_handle;
+// all reads, programs and erases of w25q128_handle go through this scheduler once W25qxx_Startup() succeeded
+extern w25qxx_sched_t w25q128_sched;
 
 uint8_t W25qxx_Startup(void);
 
+// Links the interface to handle/descr and brings one chip up; each chip needs its own
+// handle and descriptor (spiIndex + chipSelectPin). Chips may share a SERCOM.
+uint8_t W25qxx_StartupDevice(w25qxx_handle_t *handle, W25qxx_ASF_CustomDescriptor_s *descr, w25qxx_type_t type);
+
 
 #endif /* W25QXX_STARTUP_H_ */
\ No newline at end of file
@@ -36,11 +36,15 @@
 
 #include "driver_w25qxx_basic.h"
 #include "w25qxx_custom_descriptor.h"
+#include "w25qxx_startup_cfg.h"
 
 static w25qxx_handle_t gs_handle;        /**< w25qxx handle */
 
-// TODO: add config defines for the following
-W25qxx_ASF_CustomDescriptor_s extraDescriptor = { 0 };
+W25qxx_ASF_CustomDescriptor_s extraDescriptor =
+{
+    .spiIndex       = W25QXX_STARTUP_CFG_PHY_SPI_INDEX,
+    .chipSelectPin  = W25QXX_STARTUP_CFG_PHY_CS_PIN,
+};
 
 /**
  * @brief     basic example init
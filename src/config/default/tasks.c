@@ -138,6 +138,9 @@ static void lAPP_Tasks(  void *pvParameters  )
     
     osDelayTask(500);
     
+    // The startup handle holds SERCOM4 open exclusively, the tests below open it on their own
+    (void)w25qxx_deinit(&w25q128_handle);
+    
     //ATTENTION: !!!LFS does not Start if tests are run just before the LFS_Startup()! You need call W25qxx_Startup() once again
     TRACE_INFO("\r\nAbout to start w25qxx register test!\r\n");
     w25qxx_register_test((w25qxx_type_t)W25Q128, (w25qxx_interface_t)W25QXX_INTERFACE_SPI, (w25qxx_bool_t)W25QXX_BOOL_FALSE);
@@ -162,9 +165,7 @@ static void lAPP_Tasks(  void *pvParameters  )
         TRACE_INFO("\r\n++++++++++++++++W25qxx_Startup() OK!\r\n");
     }   
   
-    // No need since the FS is initiated during FTP server startup (see fsInit())
-    // but is needed once again after chip erase test
-    // TODO: try fsInit() from Ftp_Startup module
+    // The only mount of the filesystem, fsInit() and every other task use this one
     TRACE_INFO("About to start LittleFS.......\n");
     err = Littlefs_Startup();
     if (err)
@@ -11,15 +11,22 @@
 
 
 #include "driver_w25qxx_interface.h"
+#include "definitions.h"
 
 
 
 #define W25QXX_STARTUP_CFG_TYPE                         W25Q128
+#define W25QXX_STARTUP_CFG_SECTORS                      4096            // 4K sectors of the chip, tracked by the blank map
 #define W25QXX_STARTUP_CFG_INTERFACE                    W25QXX_INTERFACE_SPI
+// W25QXX_PHY_QSPI needs the flash on the QSPI pins and W25QXX_BOOL_TRUE below,
+// then w25qxx_read uses quad I/O reads (0xEB)
+#define W25QXX_STARTUP_CFG_PHY                          W25QXX_PHY_SERCOM_SPI
 #define W25QXX_STARTUP_CFG_DUAL_QUAD_SPI                W25QXX_BOOL_FALSE
 #define W25QXX_STARTUP_CFG_PHY_SPI_INSTANCE_PTR         NULL
-#define W25QXX_STARTUP_CFG_PHY_CS_PIN                   0
+#define W25QXX_STARTUP_CFG_PHY_SPI_INDEX                DRV_SPI_INDEX_0
+#define W25QXX_STARTUP_CFG_PHY_CS_PIN                   SYS_PORT_PIN_PB14
 #define W25QXX_STARTUP_CFG_PHY_USART_INSTANCE_PTR       NULL
+#define W25QXX_STARTUP_CFG_PHY_SPI_TRANSFER_MODE        W25QXX_SPI_TRANSFER_MODE_PERSISTENT
 
 
 #endif /* W25QXX_STARTUP_CFG_H_ */
\ No newline at end of file
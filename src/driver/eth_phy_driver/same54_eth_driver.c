@@ -48,9 +48,15 @@ static NetInterface *nicDriverInterface;
 //IAR EWARM compiler?
 #if defined(__ICCARM__)
 
+#if (SAME54_ETH_TX_SCATTER_GATHER_SUPPORT == ENABLED)
+//TX ring
+#pragma data_alignment = 8
+static uint8_t txRing[SAME54_ETH_TX_RING_SIZE];
+#else
 //TX buffer
 #pragma data_alignment = 8
 static uint8_t txBuffer[SAME54_ETH_TX_BUFFER_COUNT][SAME54_ETH_TX_BUFFER_SIZE];
+#endif
 //RX buffer
 #pragma data_alignment = 8
 static uint8_t rxBuffer[SAME54_ETH_RX_BUFFER_COUNT][SAME54_ETH_RX_BUFFER_SIZE];
@@ -64,9 +70,15 @@ static Same54RxBufferDesc rxBufferDesc[SAME54_ETH_RX_BUFFER_COUNT];
 //Keil MDK-ARM or GCC compiler?
 #else
 
+#if (SAME54_ETH_TX_SCATTER_GATHER_SUPPORT == ENABLED)
+//TX ring
+static uint8_t txRing[SAME54_ETH_TX_RING_SIZE]
+   __attribute__((aligned(8)));
+#else
 //TX buffer
 static uint8_t txBuffer[SAME54_ETH_TX_BUFFER_COUNT][SAME54_ETH_TX_BUFFER_SIZE]
    __attribute__((aligned(8)));
+#endif
 //RX buffer
 static uint8_t rxBuffer[SAME54_ETH_RX_BUFFER_COUNT][SAME54_ETH_RX_BUFFER_SIZE]
    __attribute__((aligned(8)));
@@ -81,8 +93,29 @@ static Same54RxBufferDesc rxBufferDesc[SAME54_ETH_RX_BUFFER_COUNT]
 
 //TX buffer index
 static uint_t txBufferIndex;
+
+#if (SAME54_ETH_TX_SCATTER_GATHER_SUPPORT == ENABLED)
+//Index of the oldest TX buffer descriptor not yet reclaimed
+static uint_t txReclaimIndex;
+//Number of TX buffer descriptors not yet reclaimed
+static uint_t txBufferDescCount;
+//Offset of the next frame in the TX ring
+static size_t txRingOffset;
+//Number of TX ring bytes not yet reclaimed
+static size_t txRingLength;
+//Number of descriptors and of ring bytes used by the frame starting at
+//each descriptor
+static uint8_t txFrameDescCount[SAME54_ETH_TX_BUFFER_COUNT];
+static uint16_t txFrameLength[SAME54_ETH_TX_BUFFER_COUNT];
+#endif
 //RX buffer index
 static uint_t rxBufferIndex;
+//A polling round is in progress (RX interrupts masked)
+static bool_t rxPolling;
+//Frames received since the last wakeup
+static uint32_t rxWakeupFrames;
+//Reception statistics
+static Same54EthStats same54EthStats;
 
 
 /**
@@ -106,7 +139,8 @@ const NicDriver same54EthDriver =
    TRUE,
    TRUE,
    TRUE,
-   FALSE
+   FALSE,
+   (SAME54_ETH_CHECKSUM_OFFLOAD_SUPPORT == ENABLED)
 };
 
 
@@ -127,6 +161,12 @@ error_t same54EthInit(NetInterface *interface)
    //Save underlying network interface
    nicDriverInterface = interface;
 
+   //No polling round is in progress
+   rxPolling = FALSE;
+   rxWakeupFrames = 0;
+   //Clear reception statistics
+   osMemset(&same54EthStats, 0, sizeof(Same54EthStats));
+
    //Enable GMAC bus clocks (CLK_GMAC_APB and CLK_GMAC_AHB)
    MCLK_REGS->MCLK_APBCMASK |= MCLK_APBCMASK_GMAC_Msk;
    MCLK_REGS->MCLK_AHBMASK |= MCLK_AHBMASK_GMAC_Msk;
@@ -181,6 +221,11 @@ error_t same54EthInit(NetInterface *interface)
    //Configure the receive filter
    GMAC_REGS->GMAC_NCFGR |= GMAC_NCFGR_MAXFS_Msk | GMAC_NCFGR_MTIHEN_Msk;
 
+#if (SAME54_ETH_CHECKSUM_OFFLOAD_SUPPORT == ENABLED)
+   //Verify the IP, TCP and UDP checksums of incoming frames
+   GMAC_REGS->GMAC_NCFGR |= GMAC_NCFGR_RXCOEN_Msk;
+#endif
+
    //Initialize buffer descriptors
    same54EthInitBufferDesc(interface);
 
@@ -390,8 +435,13 @@ void same54EthInitBufferDesc(NetInterface *interface)
    //Initialize TX buffer descriptors
    for(i = 0; i < SAME54_ETH_TX_BUFFER_COUNT; i++)
    {
+#if (SAME54_ETH_TX_SCATTER_GATHER_SUPPORT == ENABLED)
+      //The address is set when a frame is queued
+      address = (uint32_t) txRing;
+#else
       //Calculate the address of the current TX buffer
       address = (uint32_t) txBuffer[i];
+#endif
       //Write the address to the descriptor entry
       txBufferDesc[i].address = address;
       //Initialize status field
@@ -403,6 +453,14 @@ void same54EthInitBufferDesc(NetInterface *interface)
    //Initialize TX buffer index
    txBufferIndex = 0;
 
+#if (SAME54_ETH_TX_SCATTER_GATHER_SUPPORT == ENABLED)
+   //The TX ring is empty
+   txReclaimIndex = 0;
+   txBufferDescCount = 0;
+   txRingOffset = 0;
+   txRingLength = 0;
+#endif
+
    //Initialize RX buffer descriptors
    for(i = 0; i < SAME54_ETH_RX_BUFFER_COUNT; i++)
    {
@@ -423,6 +481,15 @@ void same54EthInitBufferDesc(NetInterface *interface)
    GMAC_REGS->GMAC_TBQB = (uint32_t) txBufferDesc;
    //Start location of the RX descriptor list
    GMAC_REGS->GMAC_RBQB = (uint32_t) rxBufferDesc;
+
+   //Size of the RX buffers, in units of 64 bytes
+   GMAC_REGS->GMAC_DCFGR = (GMAC_REGS->GMAC_DCFGR & ~GMAC_DCFGR_DRBS_Msk) |
+      GMAC_DCFGR_DRBS(SAME54_ETH_RX_BUFFER_SIZE / 64);
+
+#if (SAME54_ETH_CHECKSUM_OFFLOAD_SUPPORT == ENABLED)
+   //Calculate the IP, TCP and UDP checksums of outgoing frames
+   GMAC_REGS->GMAC_DCFGR |= GMAC_DCFGR_TXCOEN_Msk;
+#endif
 }
 
 
@@ -535,6 +602,9 @@ void GMAC_Handler(void)
    rsr = GMAC_REGS->GMAC_RSR;
    (void) isr;
 
+   //Count interrupts
+   same54EthStats.irqCount++;
+
    //Packet transmitted?
    if((tsr & (GMAC_TSR_HRESP_Msk | GMAC_TSR_UND_Msk |
       GMAC_TSR_TXCOMP_Msk | GMAC_TSR_TFC_Msk | GMAC_TSR_TXGO_Msk |
@@ -543,8 +613,13 @@ void GMAC_Handler(void)
       //Only clear TSR flags that are currently set
       GMAC_REGS->GMAC_TSR = tsr;
 
+#if (SAME54_ETH_TX_SCATTER_GATHER_SUPPORT == ENABLED)
+      //Check whether the TX ring has room for another frame
+      if(same54EthCheckTxRing())
+#else
       //Check whether the TX buffer is available for writing
       if((txBufferDesc[txBufferIndex].status & GMAC_TX_USED) != 0)
+#endif
       {
          //Notify the TCP/IP stack that the transmitter is ready to send
          flag |= osSetEventFromIsr(&nicDriverInterface->nicTxEvent);
@@ -555,10 +630,32 @@ void GMAC_Handler(void)
    if((rsr & (GMAC_RSR_HNO_Msk | GMAC_RSR_RXOVR_Msk | GMAC_RSR_REC_Msk |
       GMAC_RSR_BNA_Msk)) != 0)
    {
+#if (SAME54_ETH_RX_POLL_SUPPORT == ENABLED)
+      //The TCP/IP task is not polling the RX ring yet?
+      if(!rxPolling)
+      {
+         //Mask RX interrupts until the ring is empty again
+         GMAC_REGS->GMAC_IDR = GMAC_IDR_RCOMP_Msk | GMAC_IDR_RXUBR_Msk |
+            GMAC_IDR_ROVR_Msk;
+
+         //Start a polling round
+         rxPolling = TRUE;
+         same54EthStats.rxWakeups++;
+
+         //Set event flag
+         nicDriverInterface->nicEvent = TRUE;
+         //Notify the TCP/IP stack of the event
+         flag |= osSetEventFromIsr(&netEvent);
+      }
+#else
+      //Count wakeups
+      same54EthStats.rxWakeups++;
+
       //Set event flag
       nicDriverInterface->nicEvent = TRUE;
       //Notify the TCP/IP stack of the event
       flag |= osSetEventFromIsr(&netEvent);
+#endif
    }
 
    //Interrupt service routine epilogue
@@ -575,10 +672,109 @@ void same54EthEventHandler(NetInterface *interface)
 {
    error_t error;
    uint32_t rsr;
+#if (SAME54_ETH_RX_POLL_SUPPORT == ENABLED)
+   uint_t n;
+#endif
+
+#if (SAME54_ETH_TX_SCATTER_GATHER_SUPPORT == ENABLED)
+   //Release the TX buffer descriptors of the frames already sent
+   same54EthReclaimTxBufferDesc(interface);
+#endif
 
    //Read receive status
    rsr = GMAC_REGS->GMAC_RSR;
 
+   //Count the overruns and the frames dropped for lack of RX buffers
+   if((rsr & GMAC_RSR_RXOVR_Msk) != 0)
+   {
+      same54EthStats.rxOverruns++;
+   }
+
+   if((rsr & GMAC_RSR_BNA_Msk) != 0)
+   {
+      same54EthStats.rxBufferNotAvailable++;
+   }
+
+#if (SAME54_ETH_RX_POLL_SUPPORT == ENABLED)
+   //Only clear RSR flags that are currently set
+   GMAC_REGS->GMAC_RSR = rsr;
+
+   //Count passes over the RX ring
+   same54EthStats.rxPolls++;
+
+   //Process pending packets, up to the budget
+   for(n = 0; n < SAME54_ETH_RX_BUDGET; n++)
+   {
+      //Read incoming packet
+      error = same54EthReceivePacket(interface);
+
+      //No more data in the receive buffer?
+      if(error == ERROR_BUFFER_EMPTY)
+         break;
+
+      //Count the frames passed to the stack
+      if(!error)
+      {
+         same54EthStats.rxFrames++;
+         rxWakeupFrames++;
+      }
+   }
+
+   //Budget exhausted?
+   if(n >= SAME54_ETH_RX_BUDGET)
+   {
+      same54EthStats.rxBudgetExhausted++;
+
+      //The remaining frames are received on the next pass of the TCP/IP
+      //task, once timers and other interfaces had their turn
+      if(!rxPolling)
+      {
+         //Mask RX interrupts until the ring is empty
+         GMAC_REGS->GMAC_IDR = GMAC_IDR_RCOMP_Msk | GMAC_IDR_RXUBR_Msk |
+            GMAC_IDR_ROVR_Msk;
+         rxPolling = TRUE;
+      }
+
+      //Set event flag
+      interface->nicEvent = TRUE;
+      //Notify the TCP/IP stack of the event
+      osSetEvent(&netEvent);
+   }
+   else if(rxPolling)
+   {
+      //End of the polling round
+      same54EthStats.rxMaxFramesPerWakeup = MAX(
+         same54EthStats.rxMaxFramesPerWakeup, rxWakeupFrames);
+      rxWakeupFrames = 0;
+      rxPolling = FALSE;
+
+      //Unmask RX interrupts
+      GMAC_REGS->GMAC_IER = GMAC_IER_RCOMP_Msk | GMAC_IER_RXUBR_Msk |
+         GMAC_IER_ROVR_Msk;
+
+      //A frame completed while the interrupts were masked must not wait
+      //for the next one
+      if((rxBufferDesc[rxBufferIndex].address & GMAC_RX_OWNERSHIP) != 0)
+      {
+         //Mask RX interrupts again
+         GMAC_REGS->GMAC_IDR = GMAC_IDR_RCOMP_Msk | GMAC_IDR_RXUBR_Msk |
+            GMAC_IDR_ROVR_Msk;
+
+         //Start a new polling round
+         rxPolling = TRUE;
+         same54EthStats.rxWakeups++;
+
+         //Set event flag
+         interface->nicEvent = TRUE;
+         //Notify the TCP/IP stack of the event
+         osSetEvent(&netEvent);
+      }
+   }
+   else
+   {
+      //No polling round was in progress
+   }
+#else
    //Packet received?
    if((rsr & (GMAC_RSR_HNO_Msk | GMAC_RSR_RXOVR_Msk | GMAC_RSR_REC_Msk |
       GMAC_RSR_BNA_Msk)) != 0)
@@ -586,15 +782,48 @@ void same54EthEventHandler(NetInterface *interface)
       //Only clear RSR flags that are currently set
       GMAC_REGS->GMAC_RSR = rsr;
 
+      //Count passes over the RX ring
+      same54EthStats.rxPolls++;
+      //Frames received after this wakeup
+      rxWakeupFrames = 0;
+
       //Process all pending packets
       do
       {
          //Read incoming packet
          error = same54EthReceivePacket(interface);
 
+         //Count the frames passed to the stack
+         if(!error)
+         {
+            same54EthStats.rxFrames++;
+            rxWakeupFrames++;
+         }
+
          //No more data in the receive buffer?
       } while(error != ERROR_BUFFER_EMPTY);
+
+      //Keep the largest number of frames received after one wakeup
+      same54EthStats.rxMaxFramesPerWakeup = MAX(
+         same54EthStats.rxMaxFramesPerWakeup, rxWakeupFrames);
    }
+#endif
+}
+
+
+/**
+ * @brief Get reception statistics
+ *
+ * The counters are read while the GMAC interrupt may update them, two of
+ * them can be one event apart
+ *
+ * @param[out] stats Reception statistics since the MAC was initialized
+ **/
+
+void same54EthGetStats(Same54EthStats *stats)
+{
+   //Copy the counters
+   *stats = same54EthStats;
 }
 
 
@@ -608,6 +837,183 @@ void same54EthEventHandler(NetInterface *interface)
  * @return Error code
  **/
 
+#if (SAME54_ETH_TX_SCATTER_GATHER_SUPPORT == ENABLED)
+
+error_t same54EthSendPacket(NetInterface *interface,
+   const NetBuffer *buffer, size_t offset, NetTxAncillary *ancillary)
+{
+   uint_t i;
+   uint_t n;
+   size_t length;
+   size_t size;
+   size_t m;
+
+   //Retrieve the length of the packet
+   length = netBufferGetLength(buffer) - offset;
+
+   //Check the frame length
+   if(length > SAME54_ETH_TX_BUFFER_SIZE)
+   {
+      //The transmitter can accept another packet
+      osSetEvent(&interface->nicTxEvent);
+      //Report an error
+      return ERROR_INVALID_LENGTH;
+   }
+
+   //Release the TX buffer descriptors of the frames already sent
+   same54EthReclaimTxBufferDesc(interface);
+
+   //Number of bytes that fit before the end of the TX ring
+   m = SAME54_ETH_TX_RING_SIZE - txRingOffset;
+   //A frame that does not fit is split across two descriptors
+   n = (length > m) ? 2 : 1;
+   //Ring bytes used by the frame, each frame starts on a 32-bit boundary
+   size = (length + 3) & ~3U;
+
+   //Make sure there is room for the frame
+   if((SAME54_ETH_TX_BUFFER_COUNT - txBufferDescCount) < n ||
+      (SAME54_ETH_TX_RING_SIZE - txRingLength) < size)
+   {
+      return ERROR_FAILURE;
+   }
+
+   //Index of the first descriptor of the frame
+   i = txBufferIndex;
+
+   //Save the resources used by the frame, released once it is sent
+   txFrameDescCount[i] = (uint8_t) n;
+   txFrameLength[i] = (uint16_t) size;
+   txBufferDescCount += n;
+   txRingLength += size;
+
+   //The frame wraps around the end of the TX ring?
+   if(n > 1)
+   {
+      //Copy the end of the frame to the beginning of the TX ring
+      netBufferRead(txRing, buffer, offset + m, length - m);
+
+      //Point to the following entry
+      txBufferIndex = (i < (SAME54_ETH_TX_BUFFER_COUNT - 1)) ? (i + 1) : 0;
+
+      //The second descriptor holds the last buffer of the frame. Its used
+      //flag is cleared before the one of the first descriptor
+      txBufferDesc[txBufferIndex].address = (uint32_t) txRing;
+      txBufferDesc[txBufferIndex].status = (txBufferDesc[txBufferIndex].status &
+         GMAC_TX_WRAP) | GMAC_TX_LAST | ((length - m) & GMAC_TX_LENGTH);
+
+      //The first descriptor holds the beginning of the frame
+      length = m;
+   }
+
+   //Copy user data to the transmit buffer
+   netBufferRead(txRing + txRingOffset, buffer, offset, length);
+
+   //Write the address and the status word of the first descriptor
+   txBufferDesc[i].address = (uint32_t) (txRing + txRingOffset);
+   txBufferDesc[i].status = (txBufferDesc[i].status & GMAC_TX_WRAP) |
+      ((n > 1) ? 0 : GMAC_TX_LAST) | (length & GMAC_TX_LENGTH);
+
+   //Advance the write offset
+   if(n > 1)
+   {
+      //The next frame follows the end of this one
+      txRingOffset = size - m;
+   }
+   else
+   {
+      //Wrap around to the beginning of the TX ring if necessary
+      txRingOffset = (txRingOffset + size) % SAME54_ETH_TX_RING_SIZE;
+   }
+
+   //Point to the following entry
+   txBufferIndex = (txBufferIndex < (SAME54_ETH_TX_BUFFER_COUNT - 1)) ?
+      (txBufferIndex + 1) : 0;
+
+   //Data synchronization barrier
+   __DSB();
+
+   //Set the TSTART bit to initiate transmission
+   GMAC_REGS->GMAC_NCR |= GMAC_NCR_TSTART_Msk;
+
+   //Check whether the TX ring has room for another frame
+   if(same54EthCheckTxRing())
+   {
+      //The transmitter can accept another packet
+      osSetEvent(&interface->nicTxEvent);
+   }
+
+   //Successful processing
+   return NO_ERROR;
+}
+
+
+/**
+ * @brief Release the TX buffer descriptors of the frames already sent
+ * @param[in] interface Underlying network interface
+ **/
+
+void same54EthReclaimTxBufferDesc(NetInterface *interface)
+{
+   uint_t n;
+
+   //The GMAC sets the used flag of the first descriptor of a frame once the
+   //frame has been sent. Frames are sent in order
+   while(txBufferDescCount > 0 &&
+      (txBufferDesc[txReclaimIndex].status & GMAC_TX_USED) != 0)
+   {
+      //Release the ring bytes of the frame
+      txRingLength -= txFrameLength[txReclaimIndex];
+
+      //Release its descriptors
+      for(n = txFrameDescCount[txReclaimIndex]; n > 0; n--)
+      {
+         //The GMAC stops at a descriptor with the used flag set
+         txBufferDesc[txReclaimIndex].status |= GMAC_TX_USED;
+         txBufferDescCount--;
+
+         //Point to the following entry
+         txReclaimIndex = (txReclaimIndex < (SAME54_ETH_TX_BUFFER_COUNT - 1)) ?
+            (txReclaimIndex + 1) : 0;
+      }
+   }
+}
+
+
+/**
+ * @brief Check whether the TX ring can take a frame of any size
+ *
+ * The frames already sent count as free space. Nothing is modified, so this
+ * function may be called from the interrupt service routine
+ *
+ * @return TRUE if a frame of SAME54_ETH_TX_BUFFER_SIZE bytes can be queued
+ **/
+
+bool_t same54EthCheckTxRing(void)
+{
+   uint_t i;
+   uint_t count;
+   size_t length;
+
+   //Resources not yet reclaimed
+   i = txReclaimIndex;
+   count = txBufferDescCount;
+   length = txRingLength;
+
+   //Skip the frames already sent
+   while(count > 0 && (txBufferDesc[i].status & GMAC_TX_USED) != 0)
+   {
+      length -= txFrameLength[i];
+      count -= txFrameDescCount[i];
+      i = (i + txFrameDescCount[i]) % SAME54_ETH_TX_BUFFER_COUNT;
+   }
+
+   //A frame may need two descriptors
+   return ((SAME54_ETH_TX_BUFFER_COUNT - count) >= 2 &&
+      (SAME54_ETH_TX_RING_SIZE - length) >= SAME54_ETH_TX_BUFFER_SIZE);
+}
+
+#else
+
 error_t same54EthSendPacket(NetInterface *interface,
    const NetBuffer *buffer, size_t offset, NetTxAncillary *ancillary)
 {
@@ -671,6 +1077,8 @@ error_t same54EthSendPacket(NetInterface *interface,
    return NO_ERROR;
 }
 
+#endif
+
 
 /**
  * @brief Receive a packet
@@ -678,6 +1086,75 @@ error_t same54EthSendPacket(NetInterface *interface,
  * @return Error code
  **/
 
+#if (SAME54_ETH_RX_ZERO_COPY_SUPPORT == ENABLED)
+
+error_t same54EthReceivePacket(NetInterface *interface)
+{
+   error_t error;
+   size_t n;
+   uint32_t status;
+   NetRxAncillary ancillary;
+
+   //Current buffer available for reading?
+   if((rxBufferDesc[rxBufferIndex].address & GMAC_RX_OWNERSHIP) != 0)
+   {
+      //Read the status word
+      status = rxBufferDesc[rxBufferIndex].status;
+
+      //The buffer holds a whole frame as long as no frame is larger than
+      //the buffer size
+      if((status & GMAC_RX_SOF) != 0 && (status & GMAC_RX_EOF) != 0)
+      {
+         //Retrieve the length of the frame
+         n = status & GMAC_RX_LENGTH;
+         //Limit the number of data to read
+         n = MIN(n, ETH_MAX_FRAME_SIZE);
+
+         //Additional options can be passed to the stack along with the packet
+         ancillary = NET_DEFAULT_RX_ANCILLARY;
+
+#if (SAME54_ETH_CHECKSUM_OFFLOAD_SUPPORT == ENABLED)
+         //Checksums the GMAC found correct
+         ancillary.ipChecksumValid = (status & GMAC_RX_CHECKSUM_VALID) != 0;
+         ancillary.upperLayerChecksumValid = (status & GMAC_RX_CHECKSUM_L4) != 0;
+#endif
+
+         //Pass the packet to the upper layer, straight from the RX buffer.
+         //The stack is done with it when the call returns
+         nicProcessPacket(interface, rxBuffer[rxBufferIndex], n, &ancillary);
+         //Valid packet received
+         error = NO_ERROR;
+      }
+      else
+      {
+         //The frame is spread over several buffers and is dropped
+         error = ERROR_INVALID_PACKET;
+      }
+
+      //Give the buffer back to the GMAC
+      rxBufferDesc[rxBufferIndex].address &= ~GMAC_RX_OWNERSHIP;
+
+      //Point to the following entry
+      rxBufferIndex++;
+
+      //Wrap around to the beginning of the buffer if necessary
+      if(rxBufferIndex >= SAME54_ETH_RX_BUFFER_COUNT)
+      {
+         rxBufferIndex = 0;
+      }
+   }
+   else
+   {
+      //No more data in the receive buffer
+      error = ERROR_BUFFER_EMPTY;
+   }
+
+   //Return status code
+   return error;
+}
+
+#else
+
 error_t same54EthReceivePacket(NetInterface *interface)
 {
    static uint32_t temp[ETH_MAX_FRAME_SIZE / 4];
@@ -689,9 +1166,11 @@ error_t same54EthReceivePacket(NetInterface *interface)
    size_t n;
    size_t size;
    size_t length;
+   uint32_t status;
 
    //Initialize variables
    size = 0;
+   status = 0;
    sofIndex = UINT_MAX;
    eofIndex = UINT_MAX;
 
@@ -726,8 +1205,10 @@ error_t same54EthReceivePacket(NetInterface *interface)
       {
          //Save the position of the EOF
          eofIndex = i;
+         //The status of the last buffer applies to the whole frame
+         status = rxBufferDesc[j].status;
          //Retrieve the length of the frame
-         size = rxBufferDesc[j].status & GMAC_RX_LENGTH;
+         size = status & GMAC_RX_LENGTH;
          //Limit the number of data to read
          size = MIN(size, ETH_MAX_FRAME_SIZE);
          //Stop processing since we have reached the end of the frame
@@ -788,6 +1269,12 @@ error_t same54EthReceivePacket(NetInterface *interface)
       //Additional options can be passed to the stack along with the packet
       ancillary = NET_DEFAULT_RX_ANCILLARY;
 
+#if (SAME54_ETH_CHECKSUM_OFFLOAD_SUPPORT == ENABLED)
+      //Checksums the GMAC found correct
+      ancillary.ipChecksumValid = (status & GMAC_RX_CHECKSUM_VALID) != 0;
+      ancillary.upperLayerChecksumValid = (status & GMAC_RX_CHECKSUM_L4) != 0;
+#endif
+
       //Pass the packet to the upper layer
       nicProcessPacket(interface, (uint8_t *) temp, length, &ancillary);
       //Valid packet received
@@ -803,6 +1290,8 @@ error_t same54EthReceivePacket(NetInterface *interface)
    return error;
 }
 
+#endif
+
 
 /**
  * @brief Configure MAC address filtering
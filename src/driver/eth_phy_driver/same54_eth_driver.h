@@ -34,9 +34,24 @@
 // TODO: 
 //#define USE_SAME54_XPLAINED_PRO
 
+//Scatter-gather transmission (frames are copied back to back into a single
+//ring of SAME54_ETH_TX_RING_SIZE bytes, a frame that wraps around the end of
+//the ring is sent from two descriptors)
+#ifndef SAME54_ETH_TX_SCATTER_GATHER_SUPPORT
+   #define SAME54_ETH_TX_SCATTER_GATHER_SUPPORT ENABLED
+#elif (SAME54_ETH_TX_SCATTER_GATHER_SUPPORT != ENABLED && SAME54_ETH_TX_SCATTER_GATHER_SUPPORT != DISABLED)
+   #error SAME54_ETH_TX_SCATTER_GATHER_SUPPORT parameter is not valid
+#endif
+
 //Number of TX buffers
 #ifndef SAME54_ETH_TX_BUFFER_COUNT
-   #define SAME54_ETH_TX_BUFFER_COUNT 3
+   #if (SAME54_ETH_TX_SCATTER_GATHER_SUPPORT == ENABLED)
+      #define SAME54_ETH_TX_BUFFER_COUNT 16
+   #else
+      #define SAME54_ETH_TX_BUFFER_COUNT 3
+   #endif
+#elif (SAME54_ETH_TX_SCATTER_GATHER_SUPPORT == ENABLED && (SAME54_ETH_TX_BUFFER_COUNT < 2 || SAME54_ETH_TX_BUFFER_COUNT > 255))
+   #error SAME54_ETH_TX_BUFFER_COUNT parameter is not valid
 #elif (SAME54_ETH_TX_BUFFER_COUNT < 1)
    #error SAME54_ETH_TX_BUFFER_COUNT parameter is not valid
 #endif
@@ -48,20 +63,70 @@
    #error SAME54_ETH_TX_BUFFER_SIZE parameter is not valid
 #endif
 
+//TX ring size
+#ifndef SAME54_ETH_TX_RING_SIZE
+   #define SAME54_ETH_TX_RING_SIZE 8192
+#elif (SAME54_ETH_TX_RING_SIZE < SAME54_ETH_TX_BUFFER_SIZE || SAME54_ETH_TX_RING_SIZE > 65536 || (SAME54_ETH_TX_RING_SIZE % 8) != 0)
+   #error SAME54_ETH_TX_RING_SIZE parameter is not valid
+#endif
+
+//Zero-copy reception (each frame is received in a single buffer and passed
+//to the stack from there)
+#ifndef SAME54_ETH_RX_ZERO_COPY_SUPPORT
+   #define SAME54_ETH_RX_ZERO_COPY_SUPPORT ENABLED
+#elif (SAME54_ETH_RX_ZERO_COPY_SUPPORT != ENABLED && SAME54_ETH_RX_ZERO_COPY_SUPPORT != DISABLED)
+   #error SAME54_ETH_RX_ZERO_COPY_SUPPORT parameter is not valid
+#endif
+
 //Number of RX buffers
 #ifndef SAME54_ETH_RX_BUFFER_COUNT
-   #define SAME54_ETH_RX_BUFFER_COUNT 72
-#elif (SAME54_ETH_RX_BUFFER_COUNT < 12)
+   #if (SAME54_ETH_RX_ZERO_COPY_SUPPORT == ENABLED)
+      #define SAME54_ETH_RX_BUFFER_COUNT 10
+   #else
+      #define SAME54_ETH_RX_BUFFER_COUNT 72
+   #endif
+#elif (SAME54_ETH_RX_ZERO_COPY_SUPPORT == ENABLED && SAME54_ETH_RX_BUFFER_COUNT < 2)
+   #error SAME54_ETH_RX_BUFFER_COUNT parameter is not valid
+#elif (SAME54_ETH_RX_ZERO_COPY_SUPPORT == DISABLED && SAME54_ETH_RX_BUFFER_COUNT < 12)
    #error SAME54_ETH_RX_BUFFER_COUNT parameter is not valid
 #endif
 
 //RX buffer size
 #ifndef SAME54_ETH_RX_BUFFER_SIZE
-   #define SAME54_ETH_RX_BUFFER_SIZE 128
-#elif (SAME54_ETH_RX_BUFFER_SIZE != 128)
+   #if (SAME54_ETH_RX_ZERO_COPY_SUPPORT == ENABLED)
+      #define SAME54_ETH_RX_BUFFER_SIZE 1536
+   #else
+      #define SAME54_ETH_RX_BUFFER_SIZE 128
+   #endif
+#elif (SAME54_ETH_RX_ZERO_COPY_SUPPORT == ENABLED && SAME54_ETH_RX_BUFFER_SIZE != 1536)
+   #error SAME54_ETH_RX_BUFFER_SIZE parameter is not valid
+#elif (SAME54_ETH_RX_ZERO_COPY_SUPPORT == DISABLED && SAME54_ETH_RX_BUFFER_SIZE != 128)
    #error SAME54_ETH_RX_BUFFER_SIZE parameter is not valid
 #endif
 
+//Polled reception (an RX interrupt starts a polling round, the RX interrupts
+//stay masked until the event handler finds the ring empty)
+#ifndef SAME54_ETH_RX_POLL_SUPPORT
+   #define SAME54_ETH_RX_POLL_SUPPORT ENABLED
+#elif (SAME54_ETH_RX_POLL_SUPPORT != ENABLED && SAME54_ETH_RX_POLL_SUPPORT != DISABLED)
+   #error SAME54_ETH_RX_POLL_SUPPORT parameter is not valid
+#endif
+
+//Maximum number of frames received per pass of the TCP/IP task
+#ifndef SAME54_ETH_RX_BUDGET
+   #define SAME54_ETH_RX_BUDGET 8
+#elif (SAME54_ETH_RX_BUDGET < 1)
+   #error SAME54_ETH_RX_BUDGET parameter is not valid
+#endif
+
+//Checksum offload (the GMAC calculates the IPv4 header checksum and the
+//TCP/UDP checksum of outgoing frames and verifies those of incoming frames)
+#ifndef SAME54_ETH_CHECKSUM_OFFLOAD_SUPPORT
+   #define SAME54_ETH_CHECKSUM_OFFLOAD_SUPPORT ENABLED
+#elif (SAME54_ETH_CHECKSUM_OFFLOAD_SUPPORT != ENABLED && SAME54_ETH_CHECKSUM_OFFLOAD_SUPPORT != DISABLED)
+   #error SAME54_ETH_CHECKSUM_OFFLOAD_SUPPORT parameter is not valid
+#endif
+
 //Interrupt priority grouping
 #ifndef SAME54_ETH_IRQ_PRIORITY_GROUPING
    #define SAME54_ETH_IRQ_PRIORITY_GROUPING 4
@@ -108,6 +173,7 @@
 #define GMAC_RX_SNAP           0x01000000
 #define GMAC_RX_TYPE_ID_MASK   0x00C00000
 #define GMAC_RX_CHECKSUM_VALID 0x00C00000
+#define GMAC_RX_CHECKSUM_L4    0x00800000
 #define GMAC_RX_VLAN_TAG       0x00200000
 #define GMAC_RX_PRIORITY_TAG   0x00100000
 #define GMAC_RX_VLAN_PRIORITY  0x000E0000
@@ -146,6 +212,23 @@ typedef struct
 } Same54RxBufferDesc;
 
 
+/**
+ * @brief Reception statistics
+ **/
+
+typedef struct
+{
+   uint32_t irqCount;             ///<GMAC interrupts
+   uint32_t rxWakeups;            ///<RX interrupts that woke the TCP/IP task
+   uint32_t rxPolls;              ///<Passes of the event handler over the RX ring
+   uint32_t rxFrames;             ///<Frames passed to the stack
+   uint32_t rxBudgetExhausted;    ///<Passes that stopped at the budget
+   uint32_t rxMaxFramesPerWakeup; ///<Most frames received after one wakeup
+   uint32_t rxOverruns;           ///<Passes that found a receive overrun
+   uint32_t rxBufferNotAvailable; ///<Passes that found the RX ring full
+} Same54EthStats;
+
+
 //SAME54 Ethernet MAC driver
 extern const NicDriver same54EthDriver;
 
@@ -165,6 +248,11 @@ error_t same54EthSendPacket(NetInterface *interface,
 
 error_t same54EthReceivePacket(NetInterface *interface);
 
+void same54EthReclaimTxBufferDesc(NetInterface *interface);
+bool_t same54EthCheckTxRing(void);
+
+void same54EthGetStats(Same54EthStats *stats);
+
 error_t same54EthUpdateMacAddrFilter(NetInterface *interface);
 error_t same54EthUpdateMacConfig(NetInterface *interface);
 
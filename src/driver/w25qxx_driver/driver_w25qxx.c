@@ -35,9 +35,38 @@
  */
 
 #include "driver_w25qxx.h"
+#include <stdio.h>
+#include <string.h>
 
 #define ERASE_4K_TRIES              400
 
+/**
+ * @brief busy timings definition (typical sizes the poll interval, max is the timeout)
+ */
+#define W25QXX_PAGE_PROGRAM_TYP_US           400                         /**< tPP typ 0.4 ms */
+#define W25QXX_PAGE_PROGRAM_MAX_US           (3 * 1000)                  /**< tPP max 3 ms */
+#define W25QXX_SECTOR_ERASE_4K_TYP_US        (45 * 1000)                 /**< tSE typ 45 ms */
+#define W25QXX_SECTOR_ERASE_4K_MAX_US        (ERASE_4K_TRIES * 1000)     /**< tSE max 400 ms */
+#define W25QXX_BLOCK_ERASE_32K_TYP_US        (120 * 1000)                /**< tBE1 typ 120 ms */
+#define W25QXX_BLOCK_ERASE_32K_MAX_US        (1600 * 1000)               /**< tBE1 max 1600 ms */
+#define W25QXX_BLOCK_ERASE_64K_TYP_US        (150 * 1000)                /**< tBE2 typ 150 ms */
+#define W25QXX_BLOCK_ERASE_64K_MAX_US        (2000 * 1000)               /**< tBE2 max 2000 ms */
+#define W25QXX_CHIP_ERASE_TYP_US             (40 * 1000 * 1000)          /**< tCE typ 40 s */
+#define W25QXX_CHIP_ERASE_MAX_US             (400 * 1000 * 1000)         /**< tCE max 400 s */
+#define W25QXX_WRITE_STATUS_TYP_US           (10 * 1000)                 /**< tW typ 10 ms */
+#define W25QXX_WRITE_STATUS_MAX_US           (1000 * 1000)               /**< tW max 1000 ms */
+#define W25QXX_SECURITY_ERASE_TYP_US         (45 * 1000)                 /**< tSE typ 45 ms */
+#define W25QXX_SECURITY_ERASE_MAX_US         (100 * 1000)                /**< tSE max 100 ms */
+#define W25QXX_BUSY_POLL_DIVIDER             8                           /**< poll interval is typ / 8 */
+#define W25QXX_BUSY_POLL_MIN_US              10                          /**< min poll interval */
+#define W25QXX_BUSY_POLL_MAX_US              (100 * 1000)                /**< max poll interval */
+
+/**
+ * @brief batched program definition
+ */
+#define W25QXX_PROGRAM_BATCH_SEGMENTS        8                           /**< segments collected by w25qxx_write per batch */
+#define W25QXX_EXT_ADDR_UNKNOWN              0xFFFF                      /**< extended address register content is unknown */
+
 /**
  * @brief chip information definition
  */
@@ -99,6 +128,255 @@
 #define W25QXX_COMMAND_OCTAL_WORD_READ_QUAD_IO           0xE3        /**< octal word read quad I/O */
 #define W25QXX_COMMAND_DEVICE_ID_QUAD_IO                 0x94        /**< device id quad I/O */
 
+#if (W25QXX_TRACE == 1)
+/**
+ * @brief     get the traced operation of an opcode
+ * @param[in] opcode is the command opcode
+ * @return    traced operation, W25QXX_TRACE_OP_MAX if the opcode is only counted
+ * @note      none
+ */
+static w25qxx_trace_op_t a_w25qxx_trace_op(uint8_t opcode)
+{
+    switch (opcode)
+    {
+        case 0x03 :                                                                    /* read data */
+        case 0x0B :                                                                    /* fast read */
+        case 0x3B :                                                                    /* fast read dual output */
+        case 0x6B :                                                                    /* fast read quad output */
+        case 0xBB :                                                                    /* fast read dual I/O */
+        case 0xEB :                                                                    /* fast read quad I/O */
+        case 0xE7 :                                                                    /* word read quad I/O */
+        case 0xE3 :                                                                    /* octal word read quad I/O */
+        case 0x13 :                                                                    /* 4 byte address variants */
+        case 0x0C :
+        case 0x3C :
+        case 0x6C :
+        case 0xBC :
+        case 0xEC :
+        {
+            return W25QXX_TRACE_OP_READ;                                               /* read */
+        }
+        case 0x02 :                                                                    /* page program */
+        case 0x32 :                                                                    /* quad page program */
+        case 0x12 :                                                                    /* 4 byte address variants */
+        case 0x34 :
+        {
+            return W25QXX_TRACE_OP_PROGRAM;                                            /* program */
+        }
+        case 0x20 :                                                                    /* sector erase */
+        case 0x21 :
+        {
+            return W25QXX_TRACE_OP_ERASE_4K;                                           /* 4k erase */
+        }
+        case 0x52 :                                                                    /* block erase 32k */
+        {
+            return W25QXX_TRACE_OP_ERASE_32K;                                          /* 32k erase */
+        }
+        case 0xD8 :                                                                    /* block erase 64k */
+        case 0xDC :
+        {
+            return W25QXX_TRACE_OP_ERASE_64K;                                          /* 64k erase */
+        }
+        case 0xC7 :                                                                    /* chip erase */
+        case 0x60 :
+        {
+            return W25QXX_TRACE_OP_CHIP_ERASE;                                         /* chip erase */
+        }
+        case 0x05 :                                                                    /* read status register-1 */
+        case 0x35 :                                                                    /* read status register-2 */
+        case 0x15 :                                                                    /* read status register-3 */
+        {
+            return W25QXX_TRACE_OP_STATUS;                                             /* status */
+        }
+        default :
+        {
+            return W25QXX_TRACE_OP_MAX;                                                /* only counted */
+        }
+    }
+}
+
+/**
+ * @brief     record a finished operation
+ * @param[in] *trace points to a trace structure
+ * @param[in] *event points to the finished operation
+ * @param[in] ring is 1 to queue the event as well
+ * @note      readers of op[] retry while seq is odd or has changed
+ */
+static void a_w25qxx_trace_record(w25qxx_trace_t *trace, const w25qxx_trace_event_t *event, uint8_t ring)
+{
+    w25qxx_trace_op_data_t *data;
+    uint32_t bucket;
+
+    data = &trace->op[event->op];                                                      /* operation data */
+    bucket = 0;                                                                        /* init 0 */
+    while ((bucket < (W25QXX_TRACE_LATENCY_BUCKETS - 1)) &&
+           (((uint32_t)1 << bucket) < event->latency_us))                              /* log2 bucket */
+    {
+        bucket++;                                                                      /* next bucket */
+    }
+
+    trace->seq++;                                                                      /* odd, update started */
+    __sync_synchronize();                                                              /* seq before data */
+    if ((data->count == 0) || (event->latency_us < data->min_us))                      /* check min */
+    {
+        data->min_us = event->latency_us;                                              /* set min */
+    }
+    if (event->latency_us > data->max_us)                                              /* check max */
+    {
+        data->max_us = event->latency_us;                                              /* set max */
+    }
+    data->count++;                                                                     /* count */
+    data->bytes += event->len;                                                         /* bytes */
+    data->polls += event->polls;                                                       /* polls */
+    data->sum_us += event->latency_us;                                                 /* latency sum */
+    data->hist[bucket]++;                                                              /* histogram */
+    __sync_synchronize();                                                              /* data before seq */
+    trace->seq++;                                                                      /* even, update done */
+
+    if (ring != 0)                                                                     /* queue the event */
+    {
+        if ((trace->head - trace->tail) >= W25QXX_TRACE_EVENTS)                        /* check full */
+        {
+            trace->dropped++;                                                          /* drop */
+        }
+        else
+        {
+            trace->ring[trace->head & (W25QXX_TRACE_EVENTS - 1)] = *event;             /* copy event */
+            __sync_synchronize();                                                      /* event before head */
+            trace->head++;                                                             /* publish */
+        }
+    }
+}
+
+/**
+ * @brief     trace a finished transfer
+ * @param[in] *handle points to a w25qxx handle structure
+ * @param[in] instruction is the sent instruction
+ * @param[in] instruction_line is the instruction phy lines, 0 if the opcode leads in_buf
+ * @param[in] address is the register address
+ * @param[in] *in_buf points to an input buffer
+ * @param[in] in_len is the input length
+ * @param[in] out_len is the output length
+ * @param[in] start_us is the transfer start time
+ * @note      reads and status reads are done when the transfer is,
+ *            programs and erases are done when a_w25qxx_trace_ready sees the chip ready
+ */
+static void a_w25qxx_trace_command(w25qxx_handle_t *handle, uint8_t instruction, uint8_t instruction_line,
+                                   uint32_t address, uint8_t *in_buf, uint32_t in_len,
+                                   uint32_t out_len, uint32_t start_us)
+{
+    w25qxx_trace_t *trace = handle->trace;
+    w25qxx_trace_event_t event;
+    uint32_t addr_len;
+    uint32_t i;
+
+    if (instruction_line != 0)                                                         /* opcode sent by the interface */
+    {
+        event.opcode = instruction;                                                    /* set opcode */
+        event.addr = address;                                                          /* set address */
+        event.len = in_len;                                                            /* data only */
+    }
+    else
+    {
+        if (in_len == 0)                                                               /* nothing sent */
+        {
+            return;                                                                    /* return */
+        }
+        addr_len = ((handle->address_mode == W25QXX_ADDRESS_MODE_4_BYTE) &&
+                    (handle->type >= W25Q256)) ? 4 : 3;                                /* address bytes */
+        event.opcode = in_buf[0];                                                      /* set opcode */
+        event.addr = 0;                                                                /* init 0 */
+        event.len = 0;                                                                 /* init 0 */
+        if (in_len > addr_len)                                                         /* address follows */
+        {
+            for (i = 1; i <= addr_len; i++)                                            /* msb first */
+            {
+                event.addr = (event.addr << 8) | in_buf[i];                            /* set address */
+            }
+            event.len = in_len - 1 - addr_len;                                         /* data only */
+        }
+    }
+    trace->opcode_count[event.opcode]++;                                               /* count opcode */
+    event.op = (uint8_t)a_w25qxx_trace_op(event.opcode);                               /* get operation */
+    event.time_us = start_us;                                                          /* set time */
+    event.polls = 0;                                                                   /* init 0 */
+    switch (event.op)
+    {
+        case W25QXX_TRACE_OP_READ :
+        {
+            event.len = out_len;                                                       /* data read */
+            event.latency_us = trace->timestamp_us() - start_us;                       /* transfer time */
+            a_w25qxx_trace_record(trace, &event, 1);                                   /* record */
+            
+            break;
+        }
+        case W25QXX_TRACE_OP_STATUS :
+        {
+            if ((trace->pending.op != W25QXX_TRACE_OP_MAX) && (trace->pending.polls < 0xFFFF)) /* busy poll */
+            {
+                trace->pending.polls++;                                                /* count poll */
+                event.polls = 1;                                                       /* one poll */
+            }
+            event.len = out_len;                                                       /* data read */
+            event.latency_us = trace->timestamp_us() - start_us;                       /* transfer time */
+            a_w25qxx_trace_record(trace, &event, 0);                                   /* statistics only */
+            
+            break;
+        }
+        case W25QXX_TRACE_OP_ERASE_4K :
+        {
+            event.len = 4096;                                                          /* bytes erased */
+            trace->pending = event;                                                    /* wait for ready */
+            
+            break;
+        }
+        case W25QXX_TRACE_OP_ERASE_32K :
+        {
+            event.len = 32768;                                                         /* bytes erased */
+            trace->pending = event;                                                    /* wait for ready */
+            
+            break;
+        }
+        case W25QXX_TRACE_OP_ERASE_64K :
+        {
+            event.len = 65536;                                                         /* bytes erased */
+            trace->pending = event;                                                    /* wait for ready */
+            
+            break;
+        }
+        case W25QXX_TRACE_OP_PROGRAM :
+        case W25QXX_TRACE_OP_CHIP_ERASE :
+        {
+            trace->pending = event;                                                    /* wait for ready */
+            
+            break;
+        }
+        default :
+        {
+            break;
+        }
+    }
+}
+
+/**
+ * @brief     trace the chip ready after a program or an erase
+ * @param[in] *handle points to a w25qxx handle structure
+ * @note      none
+ */
+static void a_w25qxx_trace_ready(w25qxx_handle_t *handle)
+{
+    w25qxx_trace_t *trace = handle->trace;
+
+    if ((trace == NULL) || (trace->pending.op == W25QXX_TRACE_OP_MAX))                 /* nothing in flight */
+    {
+        return;                                                                        /* return */
+    }
+    trace->pending.latency_us = trace->timestamp_us() - trace->pending.time_us;        /* command to ready */
+    a_w25qxx_trace_record(trace, &trace->pending, 1);                                  /* record */
+    trace->pending.op = W25QXX_TRACE_OP_MAX;                                           /* done */
+}
+#endif
+
 /**
  * @brief      spi interface write read bytes
  * @param[in]  *handle points to a w25qxx handle structure
@@ -113,6 +391,14 @@
  */
 static uint8_t a_w25qxx_spi_write_read(w25qxx_handle_t *handle, uint8_t *in_buf, uint32_t in_len, uint8_t *out_buf, uint32_t out_len)
 {
+#if (W25QXX_TRACE == 1)
+    uint32_t start_us = 0;
+
+    if (handle->trace != NULL)                                                         /* check trace */
+    {
+        start_us = handle->trace->timestamp_us();                                      /* transfer start */
+    }
+#endif
     if (handle->spi_qspi_write_read(handle->extra, 0x00, 0x00, 0x00000000, 0x00, 0x00,                /* write read data */
                                     0x00000000, 0x00, 0x00,
                                     0x00, in_buf, in_len, out_buf, out_len, 1) != 0)
@@ -121,6 +407,12 @@ static uint8_t a_w25qxx_spi_write_read(w25qxx_handle_t *handle, uint8_t *in_buf,
     }
     else
     {
+#if (W25QXX_TRACE == 1)
+        if (handle->trace != NULL)                                                     /* check trace */
+        {
+            a_w25qxx_trace_command(handle, 0x00, 0x00, 0x00000000, in_buf, in_len, out_len, start_us); /* trace */
+        }
+#endif
         return 0;                                                                      /* success return 0 */
     }
 }
@@ -153,6 +445,14 @@ static uint8_t a_w25qxx_qspi_write_read(w25qxx_handle_t *handle, uint8_t instruc
                                         uint8_t dummy, uint8_t *in_buf, uint32_t in_len,
                                         uint8_t *out_buf, uint32_t out_len, uint8_t data_line)
 {
+#if (W25QXX_TRACE == 1)
+    uint32_t start_us = 0;
+
+    if (handle->trace != NULL)                                                                                /* check trace */
+    {
+        start_us = handle->trace->timestamp_us();                                                             /* transfer start */
+    }
+#endif
     if (handle->spi_qspi_write_read(handle->extra, instruction, instruction_line, address, address_line, address_len,        /* write read data */
                                     alternate, alternate_line, alternate_len,
                                     dummy, in_buf, in_len, out_buf, out_len, data_line) != 0)
@@ -161,10 +461,268 @@ static uint8_t a_w25qxx_qspi_write_read(w25qxx_handle_t *handle, uint8_t instruc
     }
     else
     {
+#if (W25QXX_TRACE == 1)
+        if (handle->trace != NULL)                                                                            /* check trace */
+        {
+            a_w25qxx_trace_command(handle, instruction, instruction_line, address,
+                                   in_buf, in_len, out_len, start_us);                                        /* trace */
+        }
+#endif
         return 0;                                                                                             /* success return 0 */
     }
 }
 
+/**
+ * @brief     wait for the given time between two busy polls
+ * @param[in] *handle points to a w25qxx handle structure
+ * @param[in] us is the time in us
+ * @note      goes through wait_ready when linked so that the calling task may sleep
+ */
+static void a_w25qxx_wait(w25qxx_handle_t *handle, uint32_t us)
+{
+    if (handle->wait_ready != NULL)                                                    /* rtos aware wait */
+    {
+        handle->wait_ready(handle->extra, us);                                         /* wait ready */
+        handle->ext_addr = W25QXX_EXT_ADDR_UNKNOWN;                                    /* others may have used the chip */
+    }
+    else if (us >= 1000)                                                               /* ms range */
+    {
+        handle->delay_ms(handle->extra, us / 1000);                                    /* delay ms */
+    }
+    else
+    {
+        handle->delay_us(handle->extra, us);                                           /* delay us */
+    }
+}
+
+/**
+ * @brief      wait until the chip clears the busy bit, first poll at a given time
+ * @param[in]  *handle points to a w25qxx handle structure
+ * @param[in]  first_us is the wait before the first poll after the busy one
+ * @param[in]  typ_us is the typical operation time in us
+ * @param[in]  max_us is the maximum operation time in us
+ * @param[out] *elapsed_us points to a buffer of the time waited until the chip was ready
+ * @return     status code
+ *             - 0 success
+ *             - 1 get status1 failed
+ *             - 2 timeout
+ * @note       the polls after the first one are taken every typ_us / W25QXX_BUSY_POLL_DIVIDER
+ */
+static uint8_t a_w25qxx_wait_busy_from(w25qxx_handle_t *handle, uint32_t first_us, uint32_t typ_us,
+                                       uint32_t max_us, uint32_t *elapsed_us)
+{
+    uint8_t res;
+    uint8_t status;
+    uint8_t buf[1];
+    uint32_t wait_us;
+
+    *elapsed_us = 0;                                                                   /* init 0 */
+    wait_us = first_us;                                                                /* first wait */
+    while (1)                                                                          /* loop */
+    {
+        if (handle->spi_qspi == W25QXX_INTERFACE_SPI)                                  /* spi interface */
+        {
+            if (handle->dual_quad_spi_enable != 0)                                     /* enable dual quad spi */
+            {
+                res = a_w25qxx_qspi_write_read(handle, W25QXX_COMMAND_READ_STATUS_REG1, 1,
+                                               0x00000000, 0x00, 0x00,
+                                               0x00000000, 0x00, 0x00,
+                                               0x00, NULL, 0x00,
+                                              (uint8_t *)&status, 1, 1);               /* qspi write read */
+            }
+            else                                                                       /* single spi */
+            {
+                buf[0] = W25QXX_COMMAND_READ_STATUS_REG1;                              /* read status1 command */
+                res = a_w25qxx_spi_write_read(handle, (uint8_t *)buf, 1,
+                                             (uint8_t *)&status, 1);                   /* spi write read */
+            }
+        }
+        else                                                                           /* qspi interface */
+        {
+            res = a_w25qxx_qspi_write_read(handle, W25QXX_COMMAND_READ_STATUS_REG1, 4,
+                                           0x00000000, 0x00, 0x00,
+                                           0x00000000, 0x00, 0x00,
+                                           0x00, NULL, 0x00,
+                                          (uint8_t *)&status, 1, 4);                   /* qspi write read */
+        }
+        if (res != 0)                                                                  /* check result */
+        {
+            return 1;                                                                  /* return error */
+        }
+        if ((status & 0x01) == 0x00)                                                   /* check status */
+        {
+#if (W25QXX_TRACE == 1)
+            a_w25qxx_trace_ready(handle);                                              /* program or erase done */
+#endif
+            return 0;                                                                  /* success return 0 */
+        }
+        if (*elapsed_us >= max_us)                                                     /* check timeout */
+        {
+            return 2;                                                                  /* return error */
+        }
+        if (wait_us < W25QXX_BUSY_POLL_MIN_US)                                         /* check min interval */
+        {
+            wait_us = W25QXX_BUSY_POLL_MIN_US;                                         /* set min interval */
+        }
+        if (wait_us > W25QXX_BUSY_POLL_MAX_US)                                         /* check max interval */
+        {
+            wait_us = W25QXX_BUSY_POLL_MAX_US;                                         /* set max interval */
+        }
+        if (wait_us > (max_us - *elapsed_us))                                          /* do not overshoot timeout */
+        {
+            wait_us = max_us - *elapsed_us;                                            /* set remain */
+        }
+        a_w25qxx_wait(handle, wait_us);                                                /* wait */
+        *elapsed_us += wait_us;                                                        /* elapsed + wait */
+        wait_us = typ_us / W25QXX_BUSY_POLL_DIVIDER;                                   /* next poll interval */
+    }
+}
+
+/**
+ * @brief     wait until the chip clears the busy bit
+ * @param[in] *handle points to a w25qxx handle structure
+ * @param[in] typ_us is the typical operation time in us
+ * @param[in] max_us is the maximum operation time in us
+ * @return    status code
+ *            - 0 success
+ *            - 1 get status1 failed
+ *            - 2 timeout
+ * @note      the first poll after the busy one is taken at typ_us / 2,
+ *            the next ones every typ_us / W25QXX_BUSY_POLL_DIVIDER
+ */
+static uint8_t a_w25qxx_wait_busy(w25qxx_handle_t *handle, uint32_t typ_us, uint32_t max_us)
+{
+    uint32_t elapsed_us;
+
+    return a_w25qxx_wait_busy_from(handle, typ_us / 2, typ_us, max_us, &elapsed_us);  /* first poll at typ / 2 */
+}
+
+/**
+ * @brief     record or forget the erased state of the sectors of a range
+ * @param[in] *handle points to a w25qxx handle structure
+ * @param[in] addr is the range address
+ * @param[in] len is the range length
+ * @param[in] blank is the new state of the sectors
+ * @note      none
+ */
+static void a_w25qxx_blank_update(w25qxx_handle_t *handle, uint32_t addr, uint32_t len, uint8_t blank)
+{
+    uint32_t sector;
+    uint32_t last;
+
+    if ((handle->blank_map == NULL) || (len == 0))                                     /* check map */
+    {
+        return;                                                                        /* not tracked */
+    }
+
+    last = (addr + (len - 1)) / 4096;                                                  /* last sector */
+    for (sector = addr / 4096; (sector <= last) && (sector < handle->blank_sectors); sector++)
+    {
+        if (blank != 0)                                                                /* erased */
+        {
+            handle->blank_map[sector / 32] |= (1UL << (sector % 32));                  /* set bit */
+        }
+        else
+        {
+            handle->blank_map[sector / 32] &= ~(1UL << (sector % 32));                 /* clear bit */
+        }
+    }
+}
+
+/**
+ * @brief     check if all sectors of a range are known blank
+ * @param[in] *handle points to a w25qxx handle structure
+ * @param[in] addr is the range address
+ * @param[in] len is the range length
+ * @return    1 if known blank, else 0
+ * @note      none
+ */
+static uint8_t a_w25qxx_blank_known(w25qxx_handle_t *handle, uint32_t addr, uint32_t len)
+{
+    uint32_t sector;
+    uint32_t last;
+
+    if ((handle->blank_map == NULL) || (len == 0))                                     /* check map */
+    {
+        return 0;                                                                      /* unknown */
+    }
+
+    last = (addr + (len - 1)) / 4096;                                                  /* last sector */
+    if (last >= handle->blank_sectors)                                                 /* check range */
+    {
+        return 0;                                                                      /* unknown */
+    }
+    for (sector = addr / 4096; sector <= last; sector++)
+    {
+        if ((handle->blank_map[sector / 32] & (1UL << (sector % 32))) == 0)            /* check bit */
+        {
+            return 0;                                                                  /* not blank */
+        }
+    }
+
+    return 1;                                                                          /* blank */
+}
+
+/**
+ * @brief     start an erase of a range
+ * @param[in] *handle points to a w25qxx handle structure
+ * @param[in] addr is the erase address
+ * @param[in] len is the erase length
+ * @return    1 if the range is known blank and the erase can be skipped, else 0
+ * @note      an erase that goes ahead forgets the blank state until it succeeded
+ */
+static uint8_t a_w25qxx_blank_erase_begin(w25qxx_handle_t *handle, uint32_t addr, uint32_t len)
+{
+    if (handle->blank_map == NULL)                                                     /* check map */
+    {
+        return 0;                                                                      /* erase */
+    }
+    if (a_w25qxx_blank_known(handle, addr, len) != 0)                                  /* already erased */
+    {
+        handle->blank_hits++;                                                          /* erase saved */
+
+        return 1;                                                                      /* skip */
+    }
+    handle->blank_misses++;                                                            /* erase needed */
+    a_w25qxx_blank_update(handle, addr, len, 0);                                       /* unknown while erasing */
+
+    return 0;                                                                          /* erase */
+}
+
+/**
+ * @brief     check if writing data over old needs an erase
+ * @param[in] *old points to the current content
+ * @param[in] *data points to the new content
+ * @param[in] len is the data length
+ * @return    1 if a bit goes from 0 to 1, else 0
+ * @note      compares word by word, the buffers may be unaligned
+ */
+static uint8_t a_w25qxx_need_erase(const uint8_t *old, const uint8_t *data, uint32_t len)
+{
+    uint32_t i;
+    uint32_t o;
+    uint32_t d;
+
+    for (i = 0; (i + 4) <= len; i += 4)                                                /* words */
+    {
+        memcpy(&o, &old[i], 4);                                                        /* unaligned load */
+        memcpy(&d, &data[i], 4);                                                       /* unaligned load */
+        if ((o & d) != d)                                                              /* check 0 -> 1 */
+        {
+            return 1;                                                                  /* erase */
+        }
+    }
+    for (; i < len; i++)                                                               /* tail bytes */
+    {
+        if ((old[i] & data[i]) != data[i])                                             /* check 0 -> 1 */
+        {
+            return 1;                                                                  /* erase */
+        }
+    }
+
+    return 0;                                                                          /* no erase */
+}
+
 /**
  * @brief     enable or disable the dual quad spi
  * @param[in] *handle points to a w25qxx handle structure
@@ -182,6 +740,7 @@ uint8_t w25qxx_set_dual_quad_spi(w25qxx_handle_t *handle, w25qxx_bool_t enable)
     }
 
     handle->dual_quad_spi_enable = (uint8_t)enable;        /* set enable */
+    handle->read_command = 0;                              /* reselect read command */
 
     return 0;                                              /* success return 0 */
 }
@@ -266,6 +825,7 @@ uint8_t w25qxx_set_interface(w25qxx_handle_t *handle, w25qxx_interface_t interfa
     }
 
     handle->spi_qspi = (uint8_t)interface;        /* set interface */
+    handle->read_command = 0;                     /* reselect read command */
 
     return 0;                                     /* success return 0 */
 }
@@ -866,8 +1426,6 @@ uint8_t w25qxx_set_status1(w25qxx_handle_t *handle, uint8_t status)
 {
     uint8_t res;
     uint8_t buf[2];
-    uint32_t timeout;
-    uint8_t status_check;
 
     if (handle == NULL)                                                                                  /* check handle */
     {
@@ -906,28 +1464,14 @@ uint8_t w25qxx_set_status1(w25qxx_handle_t *handle, uint8_t status)
                 return 1;                                                                                /* return error */
             }
 
-            timeout = 1000;                                                                              /* max 1000 ms */
-            while (timeout != 0)                                                                         /* check timeout */
+            res = a_w25qxx_wait_busy(handle, W25QXX_WRITE_STATUS_TYP_US, W25QXX_WRITE_STATUS_MAX_US);    /* wait busy */
+            if (res == 1)                                                                                /* check result */
             {
-                res = a_w25qxx_qspi_write_read(handle, W25QXX_COMMAND_READ_STATUS_REG1, 1,
-                                               0x00000000, 0x00, 0x00,
-                                               0x00000000, 0x00, 0x00,
-                                               0x00, NULL, 0x00,
-                                              (uint8_t *)&status_check, 1, 1);                           /* qspi write read */
-                if (res != 0)                                                                            /* check result */
-                {
-                    handle->debug_print(handle->extra, "w25qxx: get status1 failed.\n");                                /* get status1 failed */
+                handle->debug_print(handle->extra, "w25qxx: get status1 failed.\n");                                /* get status1 failed */
 
-                    return 1;                                                                            /* return error */
-                }
-                if ((status_check & 0x01) == 0x00)                                                       /* check status */
-                {
-                    break;                                                                               /* break */
-                }
-                timeout--;                                                                               /* timeout-- */
-                handle->delay_ms(handle->extra, 1);                                                                     /* delay 1 ms */
+                return 1;                                                                            /* return error */
             }
-            if (timeout == 0)                                                                            /* check timeout */
+            if (res != 0)                                                                                /* check timeout */
             {
                 handle->debug_print(handle->extra, "w25qxx: write status 1 timeout.\n");                                /* write status 1 timeout */
 
@@ -958,26 +1502,14 @@ uint8_t w25qxx_set_status1(w25qxx_handle_t *handle, uint8_t status)
                 return 1;                                                                                /* return error */
             }
 
-            timeout = 1000;                                                                              /* max 1000 ms */
-            while (timeout != 0)                                                                         /* check timeout */
+            res = a_w25qxx_wait_busy(handle, W25QXX_WRITE_STATUS_TYP_US, W25QXX_WRITE_STATUS_MAX_US);    /* wait busy */
+            if (res == 1)                                                                                /* check result */
             {
-                buf[0] = W25QXX_COMMAND_READ_STATUS_REG1;                                                /* read status1 command */
-                res = a_w25qxx_spi_write_read(handle, (uint8_t *)buf, 1,
-                                             (uint8_t *)&status_check, 1);                               /* spi write read */
-                if (res != 0)                                                                            /* check result */
-                {
-                    handle->debug_print(handle->extra, "w25qxx: get status1 failed.\n");                                /* get status1 failed */
+                handle->debug_print(handle->extra, "w25qxx: get status1 failed.\n");                                /* get status1 failed */
 
-                    return 1;                                                                            /* return error */
-                }
-                if ((status_check & 0x01) == 0x00)                                                       /* check status */
-                {
-                    break;                                                                               /* break */
-                }
-                timeout--;                                                                               /* timeout-- */
-                handle->delay_ms(handle->extra, 1);                                                                     /* delay 1 ms */
+                return 1;                                                                            /* return error */
             }
-            if (timeout == 0)                                                                            /* check timeout */
+            if (res != 0)                                                                                /* check timeout */
             {
                 handle->debug_print(handle->extra, "w25qxx: write status 1 timeout.\n");                                /* write status 1 timeout */
 
@@ -1015,28 +1547,14 @@ uint8_t w25qxx_set_status1(w25qxx_handle_t *handle, uint8_t status)
             return 1;                                                                                    /* return error */
         }
 
-        timeout = 1000;                                                                                  /* max 1000 ms */
-        while (timeout != 0)                                                                             /* check timeout */
+        res = a_w25qxx_wait_busy(handle, W25QXX_WRITE_STATUS_TYP_US, W25QXX_WRITE_STATUS_MAX_US);    /* wait busy */
+        if (res == 1)                                                                                /* check result */
         {
-            res = a_w25qxx_qspi_write_read(handle, W25QXX_COMMAND_READ_STATUS_REG1, 4,
-                                           0x00000000, 0x00, 0x00,
-                                           0x00000000, 0x00, 0x00,
-                                           0x00, NULL, 0x00,
-                                          (uint8_t *)&status_check, 1, 4);                               /* qspi write read */
-            if (res != 0)                                                                                /* check result */
-            {
-                handle->debug_print(handle->extra, "w25qxx: get status1 failed.\n");                                    /* get status1 failed */
+            handle->debug_print(handle->extra, "w25qxx: get status1 failed.\n");                                    /* get status1 failed */
 
-                return 1;                                                                                /* return error */
-            }
-            if ((status_check & 0x01) == 0x00)                                                           /* check status */
-            {
-                break;                                                                                   /* break */
-            }
-            timeout--;                                                                                   /* timeout-- */
-            handle->delay_ms(handle->extra, 1);                                                                         /* delay 1 ms */
+            return 1;                                                                                /* return error */
         }
-        if (timeout == 0)                                                                                /* check timeout */
+        if (res != 0)                                                                                /* check timeout */
         {
             handle->debug_print(handle->extra, "w25qxx: write status 1 timeout.\n");                                    /* write status 1 timeout */
 
@@ -1065,8 +1583,6 @@ uint8_t w25qxx_set_status2(w25qxx_handle_t *handle, uint8_t status)
 {
     uint8_t res;
     uint8_t buf[2];
-    uint32_t timeout;
-    uint8_t status_check;
 
     if (handle == NULL)                                                                                  /* check handle */
     {
@@ -1076,6 +1592,7 @@ uint8_t w25qxx_set_status2(w25qxx_handle_t *handle, uint8_t status)
     {
         return 3;                                                                                        /* return error */
     }
+    handle->read_command = 0;                                                                            /* qe bit may change */
 
     if (handle->spi_qspi == W25QXX_INTERFACE_SPI)                                                        /* spi interface */
     {
@@ -1105,28 +1622,14 @@ uint8_t w25qxx_set_status2(w25qxx_handle_t *handle, uint8_t status)
                 return 1;                                                                                /* return error */
             }
 
-            timeout = 1000;                                                                              /* max 1000 ms */
-            while (timeout != 0)                                                                         /* check timeout */
+            res = a_w25qxx_wait_busy(handle, W25QXX_WRITE_STATUS_TYP_US, W25QXX_WRITE_STATUS_MAX_US);    /* wait busy */
+            if (res == 1)                                                                                /* check result */
             {
-                res = a_w25qxx_qspi_write_read(handle, W25QXX_COMMAND_READ_STATUS_REG1, 1,
-                                               0x00000000, 0x00, 0x00,
-                                               0x00000000, 0x00, 0x00,
-                                               0x00, NULL, 0x00,
-                                              (uint8_t *)&status_check, 1, 1);                           /* qspi write read */
-                if (res != 0)                                                                            /* check result */
-                {
-                    handle->debug_print(handle->extra, "w25qxx: get status1 failed.\n");                                /* get status1 failed */
+                handle->debug_print(handle->extra, "w25qxx: get status1 failed.\n");                                /* get status1 failed */
 
-                    return 1;                                                                            /* return error */
-                }
-                if ((status_check & 0x01) == 0x00)                                                       /* check status */
-                {
-                    break;                                                                               /* break */
-                }
-                timeout--;                                                                               /* timeout-- */
-                handle->delay_ms(handle->extra, 1);                                                                     /* delay 1 ms */
+                return 1;                                                                            /* return error */
             }
-            if (timeout == 0)                                                                            /* check timeout */
+            if (res != 0)                                                                                /* check timeout */
             {
                 handle->debug_print(handle->extra, "w25qxx: write status 2 timeout.\n");                                /* write status 2 timeout */
 
@@ -1157,26 +1660,14 @@ uint8_t w25qxx_set_status2(w25qxx_handle_t *handle, uint8_t status)
                 return 1;                                                                                /* return error */
             }
 
-            timeout = 1000;                                                                              /* max 1000 ms */
-            while (timeout != 0)                                                                         /* check timeout */
+            res = a_w25qxx_wait_busy(handle, W25QXX_WRITE_STATUS_TYP_US, W25QXX_WRITE_STATUS_MAX_US);    /* wait busy */
+            if (res == 1)                                                                                /* check result */
             {
-                buf[0] = W25QXX_COMMAND_READ_STATUS_REG1;                                                /* read status1 command */
-                res = a_w25qxx_spi_write_read(handle, (uint8_t *)buf, 1,
-                                             (uint8_t *)&status_check, 1);                               /* spi write read */
-                if (res != 0)                                                                            /* check result */
-                {
-                    handle->debug_print(handle->extra, "w25qxx: get status1 failed.\n");                                /* get status1 failed */
+                handle->debug_print(handle->extra, "w25qxx: get status1 failed.\n");                                /* get status1 failed */
 
-                    return 1;                                                                            /* return error */
-                }
-                if ((status_check & 0x01) == 0x00)                                                       /* check status */
-                {
-                    break;                                                                               /* break */
-                }
-                timeout--;                                                                               /* timeout-- */
-                handle->delay_ms(handle->extra, 1);                                                                     /* delay 1 ms */
+                return 1;                                                                            /* return error */
             }
-            if (timeout == 0)                                                                            /* check timeout */
+            if (res != 0)                                                                                /* check timeout */
             {
                 handle->debug_print(handle->extra, "w25qxx: write status 2 timeout.\n");                                /* write status 2 timeout */
 
@@ -1214,28 +1705,14 @@ uint8_t w25qxx_set_status2(w25qxx_handle_t *handle, uint8_t status)
             return 1;                                                                                    /* return error */
         }
 
-        timeout = 1000;                                                                                  /* max 1000 ms */
-        while (timeout != 0)                                                                             /* check timeout */
+        res = a_w25qxx_wait_busy(handle, W25QXX_WRITE_STATUS_TYP_US, W25QXX_WRITE_STATUS_MAX_US);    /* wait busy */
+        if (res == 1)                                                                                /* check result */
         {
-            res = a_w25qxx_qspi_write_read(handle, W25QXX_COMMAND_READ_STATUS_REG1, 4,
-                                           0x00000000, 0x00, 0x00,
-                                           0x00000000, 0x00, 0x00,
-                                           0x00, NULL, 0x00,
-                                          (uint8_t *)&status_check, 1, 4);                               /* qspi write read */
-            if (res != 0)                                                                                /* check result */
-            {
-                handle->debug_print(handle->extra, "w25qxx: get status1 failed.\n");                                    /* get status1 failed */
+            handle->debug_print(handle->extra, "w25qxx: get status1 failed.\n");                                    /* get status1 failed */
 
-                return 1;                                                                                /* return error */
-            }
-            if ((status_check & 0x01) == 0x00)                                                           /* check status */
-            {
-                break;                                                                                   /* break */
-            }
-            timeout--;                                                                                   /* timeout-- */
-            handle->delay_ms(handle->extra, 1);                                                                         /* delay 1 ms */
+            return 1;                                                                                /* return error */
         }
-        if (timeout == 0)                                                                                /* check timeout */
+        if (res != 0)                                                                                /* check timeout */
         {
             handle->debug_print(handle->extra, "w25qxx: write status 2 timeout.\n");                                    /* write status 2 timeout */
 
@@ -1264,8 +1741,6 @@ uint8_t w25qxx_set_status3(w25qxx_handle_t *handle, uint8_t status)
 {
     uint8_t res;
     uint8_t buf[2];
-    uint32_t timeout;
-    uint8_t status_check;
 
     if (handle == NULL)                                                                                  /* check handle */
     {
@@ -1304,28 +1779,14 @@ uint8_t w25qxx_set_status3(w25qxx_handle_t *handle, uint8_t status)
                 return 1;                                                                                /* return error */
             }
 
-            timeout = 1000;                                                                              /* max 1000 ms */
-            while (timeout != 0)                                                                         /* check timeout */
+            res = a_w25qxx_wait_busy(handle, W25QXX_WRITE_STATUS_TYP_US, W25QXX_WRITE_STATUS_MAX_US);    /* wait busy */
+            if (res == 1)                                                                                /* check result */
             {
-                res = a_w25qxx_qspi_write_read(handle, W25QXX_COMMAND_READ_STATUS_REG1, 1,
-                                               0x00000000, 0x00, 0x00,
-                                               0x00000000, 0x00, 0x00,
-                                               0x00, NULL, 0x00,
-                                              (uint8_t *)&status_check, 1, 1);                           /* qspi write read */
-                if (res != 0)                                                                            /* check result */
-                {
-                    handle->debug_print(handle->extra, "w25qxx: get status1 failed.\n");                                /* get status1 failed */
+                handle->debug_print(handle->extra, "w25qxx: get status1 failed.\n");                                /* get status1 failed */
 
-                    return 1;                                                                            /* return error */
-                }
-                if ((status_check & 0x01) == 0x00)                                                       /* check status */
-                {
-                    break;                                                                               /* break */
-                }
-                timeout--;                                                                               /* timeout-- */
-                handle->delay_ms(handle->extra, 1);                                                                     /* delay 1 ms */
+                return 1;                                                                            /* return error */
             }
-            if (timeout == 0)                                                                            /* check timeout */
+            if (res != 0)                                                                                /* check timeout */
             {
                 handle->debug_print(handle->extra, "w25qxx: write status 3 timeout.\n");                                /* write status 3 timeout */
 
@@ -1356,26 +1817,14 @@ uint8_t w25qxx_set_status3(w25qxx_handle_t *handle, uint8_t status)
                 return 1;                                                                                /* return error */
             }
 
-            timeout = 1000;                                                                              /* max 1000 ms */
-            while (timeout != 0)                                                                         /* check timeout */
+            res = a_w25qxx_wait_busy(handle, W25QXX_WRITE_STATUS_TYP_US, W25QXX_WRITE_STATUS_MAX_US);    /* wait busy */
+            if (res == 1)                                                                                /* check result */
             {
-                buf[0] = W25QXX_COMMAND_READ_STATUS_REG1;                                                /* read status1 command */
-                res = a_w25qxx_spi_write_read(handle, (uint8_t *)buf, 1,
-                                             (uint8_t *)&status_check, 1);                               /* spi write read */
-                if (res != 0)                                                                            /* check result */
-                {
-                    handle->debug_print(handle->extra, "w25qxx: get status1 failed.\n");                                /* get status1 failed */
+                handle->debug_print(handle->extra, "w25qxx: get status1 failed.\n");                                /* get status1 failed */
 
-                    return 1;                                                                            /* return error */
-                }
-                if ((status_check & 0x01) == 0x00)                                                       /* check status */
-                {
-                    break;                                                                               /* break */
-                }
-                timeout--;                                                                               /* timeout-- */
-                handle->delay_ms(handle->extra, 1);                                                                     /* delay 1 ms */
+                return 1;                                                                            /* return error */
             }
-            if (timeout == 0)                                                                            /* check timeout */
+            if (res != 0)                                                                                /* check timeout */
             {
                 handle->debug_print(handle->extra, "w25qxx: write status 3 timeout.\n");                                /* write status 3 timeout */
 
@@ -1413,28 +1862,14 @@ uint8_t w25qxx_set_status3(w25qxx_handle_t *handle, uint8_t status)
             return 1;                                                                                    /* return error */
         }
 
-        timeout = 1000;                                                                                  /* max 1000 ms */
-        while (timeout != 0)                                                                             /* check timeout */
+        res = a_w25qxx_wait_busy(handle, W25QXX_WRITE_STATUS_TYP_US, W25QXX_WRITE_STATUS_MAX_US);    /* wait busy */
+        if (res == 1)                                                                                /* check result */
         {
-            res = a_w25qxx_qspi_write_read(handle, W25QXX_COMMAND_READ_STATUS_REG1, 4,
-                                           0x00000000, 0x00, 0x00,
-                                           0x00000000, 0x00, 0x00,
-                                           0x00, NULL, 0x00,
-                                          (uint8_t *)&status_check, 1, 4);                               /* qspi write read */
-            if (res != 0)                                                                                /* check result */
-            {
-                handle->debug_print(handle->extra, "w25qxx: get status1 failed.\n");                                    /* get status1 failed */
+            handle->debug_print(handle->extra, "w25qxx: get status1 failed.\n");                                    /* get status1 failed */
 
-                return 1;                                                                                /* return error */
-            }
-            if ((status_check & 0x01) == 0x00)                                                           /* check status */
-            {
-                break;                                                                                   /* break */
-            }
-            timeout--;                                                                                   /* timeout-- */
-            handle->delay_ms(handle->extra, 1);                                                                         /* delay 1 ms */
+            return 1;                                                                                /* return error */
         }
-        if (timeout == 0)                                                                                /* check timeout */
+        if (res != 0)                                                                                /* check timeout */
         {
             handle->debug_print(handle->extra, "w25qxx: write status 3 timeout.\n");                                    /* write status 3 timeout */
 
@@ -1461,9 +1896,7 @@ uint8_t w25qxx_set_status3(w25qxx_handle_t *handle, uint8_t status)
 uint8_t w25qxx_chip_erase(w25qxx_handle_t *handle)
 {
     uint8_t res;
-    uint8_t status;
     uint8_t buf[1];
-    uint32_t timeout;
 
     if (handle == NULL)                                                                            /* check handle */
     {
@@ -1474,6 +1907,8 @@ uint8_t w25qxx_chip_erase(w25qxx_handle_t *handle)
         return 3;                                                                                  /* return error */
     }
 
+    a_w25qxx_blank_update(handle, 0, handle->blank_sectors * 4096, 0);                         /* unknown while erasing */
+
     if (handle->spi_qspi == W25QXX_INTERFACE_SPI)                                                  /* spi interface */
     {
         if (handle->dual_quad_spi_enable != 0)                                                     /* enable dual quad spi */
@@ -1500,28 +1935,14 @@ uint8_t w25qxx_chip_erase(w25qxx_handle_t *handle)
 
                 return 1;                                                                          /* return error */
             }
-            timeout = 400 * 1000;                                                                  /* max 400s */
-            while (timeout != 0)                                                                   /* check timeout */
+            res = a_w25qxx_wait_busy(handle, W25QXX_CHIP_ERASE_TYP_US, W25QXX_CHIP_ERASE_MAX_US);        /* wait busy */
+            if (res == 1)                                                                                /* check result */
             {
-                res = a_w25qxx_qspi_write_read(handle, W25QXX_COMMAND_READ_STATUS_REG1, 1,
-                                               0x00000000, 0x00, 0x00,
-                                               0x00000000, 0x00, 0x00,
-                                               0x00, NULL, 0x00,
-                                              (uint8_t *)&status, 1, 1);                           /* qspi write read */
-                if (res != 0)                                                                      /* check result */
-                {
-                    handle->debug_print(handle->extra, "w25qxx: get status1 failed.\n");                          /* get status1 failed */
+                handle->debug_print(handle->extra, "w25qxx: get status1 failed.\n");                          /* get status1 failed */
 
-                    return 1;                                                                      /* return error */
-                }
-                if ((status & 0x01) == 0x00)                                                       /* check status */
-                {
-                    break;                                                                         /* break */
-                }
-                timeout--;                                                                         /* timeout-- */
-                handle->delay_ms(handle->extra, 1);                                                               /* delay 1 ms */
+                return 1;                                                                      /* return error */
             }
-            if (timeout == 0)                                                                      /* check timeout */
+            if (res != 0)                                                                                /* check timeout */
             {
                 handle->debug_print(handle->extra, "w25qxx: erase timeout.\n");                                   /* erase timeout */
 
@@ -1529,6 +1950,8 @@ uint8_t w25qxx_chip_erase(w25qxx_handle_t *handle)
             }
             else
             {
+                a_w25qxx_blank_update(handle, 0, handle->blank_sectors * 4096, 1);             /* chip is blank */
+
                 return 0;                                                                          /* success return 0 */
             }
         }
@@ -1550,26 +1973,14 @@ uint8_t w25qxx_chip_erase(w25qxx_handle_t *handle)
 
                 return 1;                                                                          /* return error */
             }
-            timeout = 400 * 1000;                                                                  /* max 400s */
-            while (timeout != 0)                                                                   /* check timeout */
+            res = a_w25qxx_wait_busy(handle, W25QXX_CHIP_ERASE_TYP_US, W25QXX_CHIP_ERASE_MAX_US);        /* wait busy */
+            if (res == 1)                                                                                /* check result */
             {
-                buf[0] = W25QXX_COMMAND_READ_STATUS_REG1;                                          /* read status1 command */
-                res = a_w25qxx_spi_write_read(handle, (uint8_t *)buf, 1,
-                                             (uint8_t *)&status, 1);                               /* spi write read */
-                if (res != 0)                                                                      /* check result */
-                {
-                    handle->debug_print(handle->extra, "w25qxx: get status1 failed.\n");                          /* get status1 failed */
+                handle->debug_print(handle->extra, "w25qxx: get status1 failed.\n");                          /* get status1 failed */
 
-                    return 1;                                                                      /* return error */
-                }
-                if ((status & 0x01) == 0x00)                                                       /* check status */
-                {
-                    break;                                                                         /* break */
-                }
-                timeout--;                                                                         /* timeout-- */
-                handle->delay_ms(handle->extra, 1);                                                               /* delay 1 ms */
+                return 1;                                                                      /* return error */
             }
-            if (timeout == 0)                                                                      /* check timeout */
+            if (res != 0)                                                                                /* check timeout */
             {
                 handle->debug_print(handle->extra, "w25qxx: erase timeout.\n");                                   /* erase timeout */
 
@@ -1577,6 +1988,8 @@ uint8_t w25qxx_chip_erase(w25qxx_handle_t *handle)
             }
             else
             {
+                a_w25qxx_blank_update(handle, 0, handle->blank_sectors * 4096, 1);             /* chip is blank */
+
                 return 0;                                                                          /* success return 0 */
             }
         }
@@ -1605,28 +2018,14 @@ uint8_t w25qxx_chip_erase(w25qxx_handle_t *handle)
 
             return 1;                                                                              /* return error */
         }
-        timeout = 400 * 1000;                                                                      /* max 400s */
-        while (timeout != 0)                                                                       /* check timeout */
+        res = a_w25qxx_wait_busy(handle, W25QXX_CHIP_ERASE_TYP_US, W25QXX_CHIP_ERASE_MAX_US);        /* wait busy */
+        if (res == 1)                                                                                /* check result */
         {
-            res = a_w25qxx_qspi_write_read(handle, W25QXX_COMMAND_READ_STATUS_REG1, 4,
-                                           0x00000000, 0x00, 0x00,
-                                           0x00000000, 0x00, 0x00,
-                                           0x00, NULL, 0x00,
-                                          (uint8_t *)&status, 1, 4);                               /* qspi write read */
-            if (res != 0)                                                                          /* check result */
-            {
-                handle->debug_print(handle->extra, "w25qxx: get status1 failed.\n");                              /* get status1 failed */
+            handle->debug_print(handle->extra, "w25qxx: get status1 failed.\n");                              /* get status1 failed */
 
-                return 1;                                                                          /* return error */
-            }
-            if ((status & 0x01) == 0x00)                                                           /* check status */
-            {
-                break;                                                                             /* break */
-            }
-            timeout--;                                                                             /* timeout-- */
-            handle->delay_ms(handle->extra, 1);                                                                   /* delay 1 ms */
+            return 1;                                                                          /* return error */
         }
-        if (timeout == 0)                                                                          /* check timeout */
+        if (res != 0)                                                                                /* check timeout */
         {
             handle->debug_print(handle->extra, "w25qxx: erase timeout.\n");                                       /* erase timeout */
 
@@ -1634,6 +2033,8 @@ uint8_t w25qxx_chip_erase(w25qxx_handle_t *handle)
         }
         else
         {
+            a_w25qxx_blank_update(handle, 0, handle->blank_sectors * 4096, 1);                 /* chip is blank */
+
             return 0;                                                                              /* success return 0 */
         }
     }
@@ -2954,8 +3355,6 @@ uint8_t w25qxx_get_sfdp(w25qxx_handle_t *handle, uint8_t sfdp[256])
 uint8_t w25qxx_erase_security_register(w25qxx_handle_t *handle, w25qxx_security_register_t num)
 {
     uint8_t res;
-    uint8_t status;
-    uint32_t timeout;
     uint8_t buf[5];
 
     if (handle == NULL)                                                                                       /* check handle */
@@ -3020,29 +3419,14 @@ uint8_t w25qxx_erase_security_register(w25qxx_handle_t *handle, w25qxx_security_
                 return 4;                                                                                     /* return error */
             }
 
-            timeout = 100 * 100;                                                                              /* max 1000 ms */
-            while (timeout != 0)                                                                              /* check timeout */
+            res = a_w25qxx_wait_busy(handle, W25QXX_SECURITY_ERASE_TYP_US, W25QXX_SECURITY_ERASE_MAX_US);/* wait busy */
+            if (res == 1)                                                                                /* check result */
             {
-                res = a_w25qxx_qspi_write_read(handle,
-                                               W25QXX_COMMAND_READ_STATUS_REG1, 1,
-                                               0x00000000, 0x00, 0x00,
-                                               0x00000000, 0x00, 0x00,
-                                               0x00, NULL, 0x00,
-                                              (uint8_t *)&status, 1, 1);                                      /* qspi write read */
-                if (res != 0)                                                                                 /* check result */
-                {
-                    handle->debug_print(handle->extra, "w25qxx: get status1 failed.\n");                                     /* get status1 failed */
+                handle->debug_print(handle->extra, "w25qxx: get status1 failed.\n");                                     /* get status1 failed */
 
-                    return 1;                                                                                 /* return error */
-                }
-                if ((status & 0x01) == 0x00)                                                                  /* check status */
-                {
-                    break;                                                                                    /* break */
-                }
-                timeout--;                                                                                    /* timeout-- */
-                handle->delay_us(handle->extra, 10);                                                                         /* delay 10 us */
+                return 1;                                                                                 /* return error */
             }
-            if (timeout == 0)
+            if (res != 0)                                                                                /* check timeout */
             {
                 handle->debug_print(handle->extra, "w25qxx: erase security register timeout.\n");                            /* erase security register timeout */
 
@@ -3095,25 +3479,14 @@ uint8_t w25qxx_erase_security_register(w25qxx_handle_t *handle, w25qxx_security_
                 return 4;                                                                                     /* return error */
             }
 
-            timeout = 100 * 100;                                                                              /* max 1000 ms */
-            while (timeout != 0)                                                                              /* check timeout */
+            res = a_w25qxx_wait_busy(handle, W25QXX_SECURITY_ERASE_TYP_US, W25QXX_SECURITY_ERASE_MAX_US);/* wait busy */
+            if (res == 1)                                                                                /* check result */
             {
-                buf[0] = W25QXX_COMMAND_READ_STATUS_REG1;                                                     /* read status1 command */
-                res = a_w25qxx_spi_write_read(handle, (uint8_t *)buf, 1, (uint8_t *)&status, 1);              /* spi write read */
-                if (res != 0)                                                                                 /* check result */
-                {
-                    handle->debug_print(handle->extra, "w25qxx: get status1 failed.\n");                                     /* get status1 failed */
+                handle->debug_print(handle->extra, "w25qxx: get status1 failed.\n");                                     /* get status1 failed */
 
-                    return 1;                                                                                 /* return error */
-                }
-                if ((status & 0x01) == 0x00)                                                                  /* check status */
-                {
-                    break;                                                                                    /* break */
-                }
-                timeout--;                                                                                    /* timeout-- */
-                handle->delay_us(handle->extra, 10);                                                                         /* delay 10 us */
+                return 1;                                                                                 /* return error */
             }
-            if (timeout == 0)
+            if (res != 0)                                                                                /* check timeout */
             {
                 handle->debug_print(handle->extra, "w25qxx: erase security register timeout.\n");                            /* erase security register timeout */
 
@@ -3149,8 +3522,6 @@ uint8_t w25qxx_erase_security_register(w25qxx_handle_t *handle, w25qxx_security_
 uint8_t w25qxx_program_security_register(w25qxx_handle_t *handle, w25qxx_security_register_t num, uint8_t data[256])
 {
     uint8_t res;
-    uint8_t status;
-    uint32_t timeout;
     uint8_t buf[5];
 
     if (handle == NULL)                                                                                       /* check handle */
@@ -3215,29 +3586,14 @@ uint8_t w25qxx_program_security_register(w25qxx_handle_t *handle, w25qxx_securit
                 return 4;                                                                                     /* return error */
             }
 
-            timeout = 3 * 100;                                                                                /* max 3 ms */
-            while (timeout != 0)                                                                              /* check timeout */
+            res = a_w25qxx_wait_busy(handle, W25QXX_PAGE_PROGRAM_TYP_US, W25QXX_PAGE_PROGRAM_MAX_US);    /* wait busy */
+            if (res == 1)                                                                                /* check result */
             {
-                res = a_w25qxx_qspi_write_read(handle,
-                                               W25QXX_COMMAND_READ_STATUS_REG1, 1,
-                                               0x00000000, 0x00, 0x00,
-                                               0x00000000, 0x00, 0x00,
-                                               0x00, NULL, 0x00,
-                                              (uint8_t *)&status, 1, 1);                                      /* qspi write read */
-                if (res != 0)                                                                                 /* check result */
-                {
-                    handle->debug_print(handle->extra, "w25qxx: get status1 failed.\n");                                     /* get status1 failed */
+                handle->debug_print(handle->extra, "w25qxx: get status1 failed.\n");                                     /* get status1 failed */
 
-                    return 1;                                                                                 /* return error */
-                }
-                if ((status & 0x01) == 0x00)                                                                  /* check status */
-                {
-                    break;                                                                                    /* break */
-                }
-                timeout--;                                                                                    /* timeout-- */
-                handle->delay_us(handle->extra, 10);                                                                         /* delay 10 us */
+                return 1;                                                                                 /* return error */
             }
-            if (timeout == 0)
+            if (res != 0)                                                                                /* check timeout */
             {
                 handle->debug_print(handle->extra, "w25qxx: program security register timeout.\n");                          /* program security register timeout */
 
@@ -3292,25 +3648,14 @@ uint8_t w25qxx_program_security_register(w25qxx_handle_t *handle, w25qxx_securit
                 return 4;                                                                                     /* return error */
             }
 
-            timeout = 3 * 100;                                                                                /* max 3 ms */
-            while (timeout != 0)                                                                              /* check timeout */
+            res = a_w25qxx_wait_busy(handle, W25QXX_PAGE_PROGRAM_TYP_US, W25QXX_PAGE_PROGRAM_MAX_US);    /* wait busy */
+            if (res == 1)                                                                                /* check result */
             {
-                buf[0] = W25QXX_COMMAND_READ_STATUS_REG1;                                                     /* read status1 command */
-                res = a_w25qxx_spi_write_read(handle, (uint8_t *)buf, 1, (uint8_t *)&status, 1);              /* spi write read */
-                if (res != 0)                                                                                 /* check result */
-                {
-                    handle->debug_print(handle->extra, "w25qxx: get status1 failed.\n");                                     /* get status1 failed */
+                handle->debug_print(handle->extra, "w25qxx: get status1 failed.\n");                                     /* get status1 failed */
 
-                    return 1;                                                                                 /* return error */
-                }
-                if ((status & 0x01) == 0x00)                                                                  /* check status */
-                {
-                    break;                                                                                    /* break */
-                }
-                timeout--;                                                                                    /* timeout-- */
-                handle->delay_us(handle->extra, 10);                                                                         /* delay 10 us */
+                return 1;                                                                                 /* return error */
             }
-            if (timeout == 0)
+            if (res != 0)                                                                                /* check timeout */
             {
                 handle->debug_print(handle->extra, "w25qxx: program security register timeout.\n");                          /* program security register timeout */
 
@@ -4571,8 +4916,6 @@ uint8_t w25qxx_octal_word_read_quad_io(w25qxx_handle_t *handle, uint32_t addr, u
 uint8_t w25qxx_page_program(w25qxx_handle_t *handle, uint32_t addr, uint8_t *data, uint16_t len)
 {
     uint8_t res;
-    uint8_t status;
-    uint32_t timeout;
     uint8_t buf[2];
 
     if (handle == NULL)                                                                                     /* check handle */
@@ -4596,6 +4939,8 @@ uint8_t w25qxx_page_program(w25qxx_handle_t *handle, uint32_t addr, uint8_t *dat
         return 7;                                                                                           /* return error */
     }
 
+    a_w25qxx_blank_update(handle, addr, len, 0);                                                            /* sectors are programmed */
+
     if (handle->spi_qspi == W25QXX_INTERFACE_SPI)                                                           /* spi interface */
     {
         if (handle->dual_quad_spi_enable != 0)                                                              /* enable dual quad spi */
@@ -4672,28 +5017,14 @@ uint8_t w25qxx_page_program(w25qxx_handle_t *handle, uint32_t addr, uint8_t *dat
                 return 5;                                                                                   /* return error */
             }
 
-            timeout = 3 * 100;                                                                              /* max 3 ms */
-            while (timeout != 0)                                                                            /* check timeout */
+            res = a_w25qxx_wait_busy(handle, W25QXX_PAGE_PROGRAM_TYP_US, W25QXX_PAGE_PROGRAM_MAX_US);    /* wait busy */
+            if (res == 1)                                                                                /* check result */
             {
-                res = a_w25qxx_qspi_write_read(handle, W25QXX_COMMAND_READ_STATUS_REG1, 1,
-                                               0x00000000, 0x00, 0x00,
-                                               0x00000000, 0x00, 0x00,
-                                               0, NULL, 0,
-                                              (uint8_t *)&status, 1, 1);                                    /* spi write read */
-                if (res != 0)                                                                               /* check result */
-                {
-                    handle->debug_print(handle->extra, "w25qxx: page program failed.\n");                                  /* page program failed */
+                handle->debug_print(handle->extra, "w25qxx: page program failed.\n");                                  /* page program failed */
 
-                    return 1;                                                                               /* return error */
-                }
-                if ((status & 0x01) == 0x00)                                                                /* check status */
-                {
-                    break;                                                                                  /* break */
-                }
-                timeout--;                                                                                  /* timeout-- */
-                handle->delay_us(handle->extra, 10);                                                                       /* delay 10 us */
+                return 1;                                                                               /* return error */
             }
-            if (timeout == 0)
+            if (res != 0)                                                                                /* check timeout */
             {
                 handle->debug_print(handle->extra, "w25qxx: page program timeout.\n");                                     /* page program timeout */
 
@@ -4769,25 +5100,14 @@ uint8_t w25qxx_page_program(w25qxx_handle_t *handle, uint32_t addr, uint8_t *dat
                 return 5;                                                                                   /* return error */
             }
 
-            timeout = 3 * 100;                                                                              /* max 3 ms */
-            while (timeout != 0)                                                                            /* check timeout */
+            res = a_w25qxx_wait_busy(handle, W25QXX_PAGE_PROGRAM_TYP_US, W25QXX_PAGE_PROGRAM_MAX_US);    /* wait busy */
+            if (res == 1)                                                                                /* check result */
             {
-                buf[0] = W25QXX_COMMAND_READ_STATUS_REG1;                                                   /* read status1 command */
-                res = a_w25qxx_spi_write_read(handle, (uint8_t *)buf, 1, (uint8_t *)&status, 1);            /* spi write read */
-                if (res != 0)                                                                               /* check result */
-                {
-                    handle->debug_print(handle->extra, "w25qxx: get status1 failed.\n");                                   /* get status1 failed */
+                handle->debug_print(handle->extra, "w25qxx: get status1 failed.\n");                                   /* get status1 failed */
 
-                    return 1;                                                                               /* return error */
-                }
-                if ((status & 0x01) == 0x00)                                                                /* check status */
-                {
-                    break;                                                                                  /* break */
-                }
-                timeout--;                                                                                  /* timeout-- */
-                handle->delay_us(handle->extra, 10);                                                                       /* delay 10 us */
+                return 1;                                                                               /* return error */
             }
-            if (timeout == 0)
+            if (res != 0)                                                                                /* check timeout */
             {
                 handle->debug_print(handle->extra, "w25qxx: page program timeout.\n");                                     /* page program timeout */
 
@@ -4869,28 +5189,14 @@ uint8_t w25qxx_page_program(w25qxx_handle_t *handle, uint32_t addr, uint8_t *dat
             return 5;                                                                                       /* return error */
         }
 
-        timeout = 3 * 100;                                                                                  /* max 3 ms */
-        while (timeout != 0)                                                                                /* check timeout */
+        res = a_w25qxx_wait_busy(handle, W25QXX_PAGE_PROGRAM_TYP_US, W25QXX_PAGE_PROGRAM_MAX_US);    /* wait busy */
+        if (res == 1)                                                                                /* check result */
         {
-            res = a_w25qxx_qspi_write_read(handle, W25QXX_COMMAND_READ_STATUS_REG1, 4,
-                                           0x00000000, 0x00, 0x00,
-                                           0x00000000, 0x00, 0x00,
-                                           0, NULL, 0,
-                                          (uint8_t *)&status, 1, 4);                                        /* spi write read */
-            if (res != 0)                                                                                   /* check result */
-            {
-                handle->debug_print(handle->extra, "w25qxx: page program failed.\n");                                      /* page program failed */
+            handle->debug_print(handle->extra, "w25qxx: page program failed.\n");                                      /* page program failed */
 
-                return 1;                                                                                   /* return error */
-            }
-            if ((status & 0x01) == 0x00)                                                                    /* check status */
-            {
-                break;                                                                                      /* break */
-            }
-            timeout--;                                                                                      /* timeout-- */
-            handle->delay_us(handle->extra, 10);                                                                           /* delay 10 us */
+            return 1;                                                                                   /* return error */
         }
-        if (timeout == 0)
+        if (res != 0)                                                                                /* check timeout */
         {
             handle->debug_print(handle->extra, "w25qxx: page program timeout.\n");                                         /* page program timeout */
 
@@ -4922,8 +5228,6 @@ uint8_t w25qxx_page_program(w25qxx_handle_t *handle, uint32_t addr, uint8_t *dat
 uint8_t w25qxx_page_program_quad_input(w25qxx_handle_t *handle, uint32_t addr, uint8_t *data, uint16_t len)
 {
     uint8_t res;
-    uint8_t status;
-    uint32_t timeout;
     uint8_t buf[2];
 
     if (handle == NULL)                                                                                     /* check handle */
@@ -4947,6 +5251,8 @@ uint8_t w25qxx_page_program_quad_input(w25qxx_handle_t *handle, uint32_t addr, u
         return 7;                                                                                           /* return error */
     }
 
+    a_w25qxx_blank_update(handle, addr, len, 0);                                                            /* sectors are programmed */
+
     if (handle->spi_qspi == W25QXX_INTERFACE_QSPI)                                                          /* qspi interface */
     {
         handle->debug_print(handle->extra, "w25qxx: qspi can't use this function.\n");                                     /* qspi can't use this function */
@@ -5033,28 +5339,14 @@ uint8_t w25qxx_page_program_quad_input(w25qxx_handle_t *handle, uint32_t addr, u
             return 5;                                                                                       /* return error */
         }
 
-        timeout = 3 * 100;                                                                                  /* max 3 ms */
-        while (timeout != 0)                                                                                /* check timeout */
+        res = a_w25qxx_wait_busy(handle, W25QXX_PAGE_PROGRAM_TYP_US, W25QXX_PAGE_PROGRAM_MAX_US);    /* wait busy */
+        if (res == 1)                                                                                /* check result */
         {
-            res = a_w25qxx_qspi_write_read(handle, W25QXX_COMMAND_READ_STATUS_REG1, 1,
-                                           0x00000000, 0x00, 0x00,
-                                           0x00000000, 0x00, 0x00,
-                                           0, NULL, 0,
-                                          (uint8_t *)&status, 1, 1);                                        /* spi write read */
-            if (res != 0)                                                                                   /* check result */
-            {
-                handle->debug_print(handle->extra, "w25qxx: get status1 failed.\n");                                       /* get status1 failed */
+            handle->debug_print(handle->extra, "w25qxx: get status1 failed.\n");                                       /* get status1 failed */
 
-                return 1;                                                                                   /* return error */
-            }
-            if ((status & 0x01) == 0x00)                                                                    /* check status */
-            {
-                break;                                                                                      /* break */
-            }
-            timeout--;                                                                                      /* timeout-- */
-            handle->delay_us(handle->extra, 10);                                                                           /* delay 10 us */
+            return 1;                                                                                   /* return error */
         }
-        if (timeout == 0)
+        if (res != 0)                                                                                /* check timeout */
         {
             handle->debug_print(handle->extra, "w25qxx: quad page program timeout.\n");                                    /* quad page program timeout */
 
@@ -5082,8 +5374,6 @@ uint8_t w25qxx_page_program_quad_input(w25qxx_handle_t *handle, uint32_t addr, u
 uint8_t w25qxx_sector_erase_4k(w25qxx_handle_t *handle, uint32_t addr)
 {
     uint8_t res;
-    uint8_t status;
-    uint32_t timeout;
     uint8_t buf[5];
 
     if (handle == NULL)                                                                                     /* check handle */
@@ -5101,6 +5391,11 @@ uint8_t w25qxx_sector_erase_4k(w25qxx_handle_t *handle, uint32_t addr)
         return 4;                                                                                           /* return error */
     }
 
+    if (a_w25qxx_blank_erase_begin(handle, addr, 4096) != 0)                                                /* known blank */
+    {
+        return 0;                                                                                           /* success return 0 */
+    }
+
     if (handle->spi_qspi == W25QXX_INTERFACE_SPI)                                                           /* spi interface */
     {
         if (handle->dual_quad_spi_enable != 0)                                                              /* enable dual quad spi */
@@ -5177,28 +5472,14 @@ uint8_t w25qxx_sector_erase_4k(w25qxx_handle_t *handle, uint32_t addr)
                 return 5;                                                                                   /* return error */
             }
 
-            timeout = ERASE_4K_TRIES;                                                                                  /* max 400 ms */
-            while (timeout != 0)                                                                            /* check timeout */
+            res = a_w25qxx_wait_busy(handle, W25QXX_SECTOR_ERASE_4K_TYP_US, W25QXX_SECTOR_ERASE_4K_MAX_US);/* wait busy */
+            if (res == 1)                                                                                /* check result */
             {
-                res = a_w25qxx_qspi_write_read(handle, W25QXX_COMMAND_READ_STATUS_REG1, 1,
-                                               0x00000000, 0x00, 0x00,
-                                               0x00000000, 0x00, 0x00,
-                                               0, NULL, 0,
-                                              (uint8_t *)&status, 1, 1);                                    /* spi write read */
-                if (res != 0)                                                                               /* check result */
-                {
-                    handle->debug_print(handle->extra, "w25qxx: get status1 failed.\n");                                   /* get status1 failed */
+                handle->debug_print(handle->extra, "w25qxx: get status1 failed.\n");                                   /* get status1 failed */
 
-                    return 1;                                                                               /* return error */
-                }
-                if ((status & 0x01) == 0x00)                                                                /* check status */
-                {
-                    break;                                                                                  /* break */
-                }
-                timeout--;                                                                                  /* timeout-- */
-                handle->delay_ms(handle->extra, 1);                                                                        /* delay 1 ms */
+                return 1;                                                                               /* return error */
             }
-            if (timeout == 0)
+            if (res != 0)                                                                                /* check timeout */
             {
                 handle->debug_print(handle->extra, "w25qxx: sector erase 4k timeout.\n");                                  /* sector erase 4k timeout */
 
@@ -5272,25 +5553,14 @@ uint8_t w25qxx_sector_erase_4k(w25qxx_handle_t *handle, uint32_t addr)
                 return 5;                                                                                   /* return error */
             }
 
-            timeout = ERASE_4K_TRIES;                                                                                  /* max 400 ms */
-            while (timeout != 0)                                                                            /* check timeout */
+            res = a_w25qxx_wait_busy(handle, W25QXX_SECTOR_ERASE_4K_TYP_US, W25QXX_SECTOR_ERASE_4K_MAX_US);/* wait busy */
+            if (res == 1)                                                                                /* check result */
             {
-                buf[0] = W25QXX_COMMAND_READ_STATUS_REG1;                                                   /* read status1 command */
-                res = a_w25qxx_spi_write_read(handle, (uint8_t *)buf, 1, (uint8_t *)&status, 1);            /* spi write read */
-                if (res != 0)                                                                               /* check result */
-                {
-                    handle->debug_print(handle->extra, "w25qxx: get status1 failed.\n");                                   /* get status1 failed */
+                handle->debug_print(handle->extra, "w25qxx: get status1 failed.\n");                                   /* get status1 failed */
 
-                    return 1;                                                                               /* return error */
-                }
-                if ((status & 0x01) == 0x00)                                                                /* check status */
-                {
-                    break;                                                                                  /* break */
-                }
-                timeout--;                                                                                  /* timeout-- */
-                handle->delay_ms(handle->extra, 1);                                                                        /* delay 1 ms */
+                return 1;                                                                               /* return error */
             }
-            if (timeout == 0)
+            if (res != 0)                                                                                /* check timeout */
             {
                 handle->debug_print(handle->extra, "w25qxx: sector erase 4k timeout.\n");                                  /* sector erase 4k timeout */
 
@@ -5372,28 +5642,14 @@ uint8_t w25qxx_sector_erase_4k(w25qxx_handle_t *handle, uint32_t addr)
             return 5;                                                                                       /* return error */
         }
 
-        timeout = ERASE_4K_TRIES;                                                                                      /* max 400 ms */
-        while (timeout != 0)                                                                                /* check timeout */
+        res = a_w25qxx_wait_busy(handle, W25QXX_SECTOR_ERASE_4K_TYP_US, W25QXX_SECTOR_ERASE_4K_MAX_US);/* wait busy */
+        if (res == 1)                                                                                /* check result */
         {
-            res = a_w25qxx_qspi_write_read(handle, W25QXX_COMMAND_READ_STATUS_REG1, 4,
-                                           0x00000000, 0x00, 0x00,
-                                           0x00000000, 0x00, 0x00,
-                                           0, NULL, 0,
-                                          (uint8_t *)&status, 1, 4);                                        /* spi write read */
-            if (res != 0)                                                                                   /* check result */
-            {
-                handle->debug_print(handle->extra, "w25qxx: get status1 failed.\n");                                       /* get status1 failed */
+            handle->debug_print(handle->extra, "w25qxx: get status1 failed.\n");                                       /* get status1 failed */
 
-                return 1;                                                                                   /* return error */
-            }
-            if ((status & 0x01) == 0x00)                                                                    /* check status */
-            {
-                break;                                                                                      /* break */
-            }
-            timeout--;                                                                                      /* timeout-- */
-            handle->delay_ms(handle->extra, 1);                                                                            /* delay 1 ms */
+            return 1;                                                                                   /* return error */
         }
-        if (timeout == 0)
+        if (res != 0)                                                                                /* check timeout */
         {
             handle->debug_print(handle->extra, "w25qxx: sector erase 4k timeout.\n");                                      /* sector erase 4k timeout */
 
@@ -5401,6 +5657,8 @@ uint8_t w25qxx_sector_erase_4k(w25qxx_handle_t *handle, uint32_t addr)
         }
     }
 
+    a_w25qxx_blank_update(handle, addr, 4096, 1);                                                           /* sectors are blank */
+
     return 0;                                                                                               /* success return 0 */
 }
 
@@ -5421,8 +5679,6 @@ uint8_t w25qxx_sector_erase_4k(w25qxx_handle_t *handle, uint32_t addr)
 uint8_t w25qxx_block_erase_32k(w25qxx_handle_t *handle, uint32_t addr)
 {
     uint8_t res;
-    uint8_t status;
-    uint32_t timeout;
     uint8_t buf[5];
 
     if (handle == NULL)                                                                                     /* check handle */
@@ -5440,6 +5696,11 @@ uint8_t w25qxx_block_erase_32k(w25qxx_handle_t *handle, uint32_t addr)
         return 4;                                                                                           /* return error */
     }
 
+    if (a_w25qxx_blank_erase_begin(handle, addr, 32768) != 0)                                               /* known blank */
+    {
+        return 0;                                                                                           /* success return 0 */
+    }
+
     if (handle->spi_qspi == W25QXX_INTERFACE_SPI)                                                           /* spi interface */
     {
         if (handle->dual_quad_spi_enable != 0)                                                              /* enable dual quad spi */
@@ -5516,28 +5777,14 @@ uint8_t w25qxx_block_erase_32k(w25qxx_handle_t *handle, uint32_t addr)
                 return 5;                                                                                   /* return error */
             }
 
-            timeout = 1600;                                                                                 /* max 1600 ms */
-            while (timeout != 0)                                                                            /* check timeout */
+            res = a_w25qxx_wait_busy(handle, W25QXX_BLOCK_ERASE_32K_TYP_US, W25QXX_BLOCK_ERASE_32K_MAX_US);/* wait busy */
+            if (res == 1)                                                                                /* check result */
             {
-                res = a_w25qxx_qspi_write_read(handle, W25QXX_COMMAND_READ_STATUS_REG1, 1,
-                                               0x00000000, 0x00, 0x00,
-                                               0x00000000, 0x00, 0x00,
-                                               0, NULL, 0,
-                                              (uint8_t *)&status, 1, 1);                                    /* spi write read */
-                if (res != 0)                                                                               /* check result */
-                {
-                    handle->debug_print(handle->extra, "w25qxx: get status1 failed.\n");                                   /* get status1 failed */
+                handle->debug_print(handle->extra, "w25qxx: get status1 failed.\n");                                   /* get status1 failed */
 
-                    return 1;                                                                               /* return error */
-                }
-                if ((status & 0x01) == 0x00)                                                                /* check status */
-                {
-                    break;                                                                                  /* break */
-                }
-                timeout--;                                                                                  /* timeout-- */
-                handle->delay_ms(handle->extra, 1);                                                                        /* delay 1 ms */
+                return 1;                                                                               /* return error */
             }
-            if (timeout == 0)
+            if (res != 0)                                                                                /* check timeout */
             {
                 handle->debug_print(handle->extra, "w25qxx: block erase 32k timeout.\n");                                  /* block erase 32k timeout */
 
@@ -5611,25 +5858,14 @@ uint8_t w25qxx_block_erase_32k(w25qxx_handle_t *handle, uint32_t addr)
                 return 5;                                                                                   /* return error */
             }
 
-            timeout = 1600;                                                                                 /* max 1600 ms */
-            while (timeout != 0)                                                                            /* check timeout */
+            res = a_w25qxx_wait_busy(handle, W25QXX_BLOCK_ERASE_32K_TYP_US, W25QXX_BLOCK_ERASE_32K_MAX_US);/* wait busy */
+            if (res == 1)                                                                                /* check result */
             {
-                buf[0] = W25QXX_COMMAND_READ_STATUS_REG1;                                                   /* read status1 command */
-                res = a_w25qxx_spi_write_read(handle, (uint8_t *)buf, 1, (uint8_t *)&status, 1);            /* spi write read */
-                if (res != 0)                                                                               /* check result */
-                {
-                    handle->debug_print(handle->extra, "w25qxx: get status1 failed.\n");                                   /* get status1 failed */
+                handle->debug_print(handle->extra, "w25qxx: get status1 failed.\n");                                   /* get status1 failed */
 
-                    return 1;                                                                               /* return error */
-                }
-                if ((status & 0x01) == 0x00)                                                                /* check status */
-                {
-                    break;                                                                                  /* break */
-                }
-                timeout--;                                                                                  /* timeout-- */
-                handle->delay_ms(handle->extra, 1);                                                                        /* delay 1 ms */
+                return 1;                                                                               /* return error */
             }
-            if (timeout == 0)
+            if (res != 0)                                                                                /* check timeout */
             {
                 handle->debug_print(handle->extra, "w25qxx: block erase 32k timeout.\n");                                  /* block erase 32k timeout */
 
@@ -5711,28 +5947,14 @@ uint8_t w25qxx_block_erase_32k(w25qxx_handle_t *handle, uint32_t addr)
             return 5;                                                                                       /* return error */
         }
 
-        timeout = 1600;                                                                                     /* max 1600 ms */
-        while (timeout != 0)                                                                                /* check timeout */
+        res = a_w25qxx_wait_busy(handle, W25QXX_BLOCK_ERASE_32K_TYP_US, W25QXX_BLOCK_ERASE_32K_MAX_US);/* wait busy */
+        if (res == 1)                                                                                /* check result */
         {
-            res = a_w25qxx_qspi_write_read(handle, W25QXX_COMMAND_READ_STATUS_REG1, 4,
-                                           0x00000000, 0x00, 0x00,
-                                           0x00000000, 0x00, 0x00,
-                                           0, NULL, 0,
-                                          (uint8_t *)&status, 1, 4);                                        /* spi write read */
-            if (res != 0)                                                                                   /* check result */
-            {
-                handle->debug_print(handle->extra, "w25qxx: get status1 failed.\n");                                       /* get status1 failed */
+            handle->debug_print(handle->extra, "w25qxx: get status1 failed.\n");                                       /* get status1 failed */
 
-                return 1;                                                                                   /* return error */
-            }
-            if ((status & 0x01) == 0x00)                                                                    /* check status */
-            {
-                break;                                                                                      /* break */
-            }
-            timeout--;                                                                                      /* timeout-- */
-            handle->delay_ms(handle->extra, 1);                                                                            /* delay 1 ms */
+            return 1;                                                                                   /* return error */
         }
-        if (timeout == 0)
+        if (res != 0)                                                                                /* check timeout */
         {
             handle->debug_print(handle->extra, "w25qxx: block erase 32k timeout.\n");                                      /* block erase 32k timeout */
 
@@ -5740,6 +5962,8 @@ uint8_t w25qxx_block_erase_32k(w25qxx_handle_t *handle, uint32_t addr)
         }
     }
 
+    a_w25qxx_blank_update(handle, addr, 32768, 1);                                                          /* sectors are blank */
+
     return 0;                                                                                               /* success return 0 */
 }
 
@@ -5760,8 +5984,6 @@ uint8_t w25qxx_block_erase_32k(w25qxx_handle_t *handle, uint32_t addr)
 uint8_t w25qxx_block_erase_64k(w25qxx_handle_t *handle, uint32_t addr)
 {
     uint8_t res;
-    uint8_t status;
-    uint32_t timeout;
     uint8_t buf[5];
 
     if (handle == NULL)                                                                                     /* check handle */
@@ -5779,6 +6001,11 @@ uint8_t w25qxx_block_erase_64k(w25qxx_handle_t *handle, uint32_t addr)
         return 4;                                                                                           /* return error */
     }
 
+    if (a_w25qxx_blank_erase_begin(handle, addr, 65536) != 0)                                               /* known blank */
+    {
+        return 0;                                                                                           /* success return 0 */
+    }
+
     if (handle->spi_qspi == W25QXX_INTERFACE_SPI)                                                           /* spi interface */
     {
         if (handle->dual_quad_spi_enable != 0)                                                              /* enable dual quad spi */
@@ -5855,28 +6082,14 @@ uint8_t w25qxx_block_erase_64k(w25qxx_handle_t *handle, uint32_t addr)
                 return 5;                                                                                   /* return error */
             }
 
-            timeout = 2000;                                                                                 /* max 2000 ms */
-            while (timeout != 0)                                                                            /* check timeout */
+            res = a_w25qxx_wait_busy(handle, W25QXX_BLOCK_ERASE_64K_TYP_US, W25QXX_BLOCK_ERASE_64K_MAX_US);/* wait busy */
+            if (res == 1)                                                                                /* check result */
             {
-                res = a_w25qxx_qspi_write_read(handle, W25QXX_COMMAND_READ_STATUS_REG1, 1,
-                                               0x00000000, 0x00, 0x00,
-                                               0x00000000, 0x00, 0x00,
-                                               0, NULL, 0,
-                                              (uint8_t *)&status, 1, 1);                                    /* spi write read */
-                if (res != 0)                                                                               /* check result */
-                {
-                    handle->debug_print(handle->extra, "w25qxx: get status1 failed.\n");                                   /* get status1 failed */
+                handle->debug_print(handle->extra, "w25qxx: get status1 failed.\n");                                   /* get status1 failed */
 
-                    return 1;                                                                               /* return error */
-                }
-                if ((status & 0x01) == 0x00)                                                                /* check status */
-                {
-                    break;                                                                                  /* break */
-                }
-                timeout--;                                                                                  /* timeout-- */
-                handle->delay_ms(handle->extra, 1);                                                                        /* delay 1 ms */
+                return 1;                                                                               /* return error */
             }
-            if (timeout == 0)
+            if (res != 0)                                                                                /* check timeout */
             {
                 handle->debug_print(handle->extra, "w25qxx: block erase 64k timeout.\n");                                  /* block erase 64k timeout */
 
@@ -5949,25 +6162,14 @@ uint8_t w25qxx_block_erase_64k(w25qxx_handle_t *handle, uint32_t addr)
                 return 5;                                                                                   /* return error */
             }
 
-            timeout = 2000;                                                                                 /* max 2000 ms */
-            while (timeout != 0)                                                                            /* check timeout */
+            res = a_w25qxx_wait_busy(handle, W25QXX_BLOCK_ERASE_64K_TYP_US, W25QXX_BLOCK_ERASE_64K_MAX_US);/* wait busy */
+            if (res == 1)                                                                                /* check result */
             {
-                buf[0] = W25QXX_COMMAND_READ_STATUS_REG1;                                                   /* read status1 command */
-                res = a_w25qxx_spi_write_read(handle, (uint8_t *)buf, 1, (uint8_t *)&status, 1);            /* spi write read */
-                if (res != 0)                                                                               /* check result */
-                {
-                    handle->debug_print(handle->extra, "w25qxx: get status1 failed.\n");                                   /* get status1 failed */
+                handle->debug_print(handle->extra, "w25qxx: get status1 failed.\n");                                   /* get status1 failed */
 
-                    return 1;                                                                               /* return error */
-                }
-                if ((status & 0x01) == 0x00)                                                                /* check status */
-                {
-                    break;                                                                                  /* break */
-                }
-                timeout--;                                                                                  /* timeout-- */
-                handle->delay_ms(handle->extra, 1);                                                                        /* delay 1 ms */
+                return 1;                                                                               /* return error */
             }
-            if (timeout == 0)
+            if (res != 0)                                                                                /* check timeout */
             {
                 handle->debug_print(handle->extra, "w25qxx: block erase 64k timeout.\n");                                  /* block erase 64k timeout */
 
@@ -6049,28 +6251,14 @@ uint8_t w25qxx_block_erase_64k(w25qxx_handle_t *handle, uint32_t addr)
             return 5;                                                                                       /* return error */
         }
 
-        timeout = 2000;                                                                                     /* max 2000 ms */
-        while (timeout != 0)                                                                                /* check timeout */
+        res = a_w25qxx_wait_busy(handle, W25QXX_BLOCK_ERASE_64K_TYP_US, W25QXX_BLOCK_ERASE_64K_MAX_US);/* wait busy */
+        if (res == 1)                                                                                /* check result */
         {
-            res = a_w25qxx_qspi_write_read(handle, W25QXX_COMMAND_READ_STATUS_REG1, 4,
-                                           0x00000000, 0x00, 0x00,
-                                           0x00000000, 0x00, 0x00,
-                                           0, NULL, 0,
-                                          (uint8_t *)&status, 1, 4);                                        /* spi write read */
-            if (res != 0)                                                                                   /* check result */
-            {
-                handle->debug_print(handle->extra, "w25qxx: get status1 failed.\n");                                       /* get status1 failed */
+            handle->debug_print(handle->extra, "w25qxx: get status1 failed.\n");                                       /* get status1 failed */
 
-                return 1;                                                                                   /* return error */
-            }
-            if ((status & 0x01) == 0x00)                                                                    /* check status */
-            {
-                break;                                                                                      /* break */
-            }
-            timeout--;                                                                                      /* timeout-- */
-            handle->delay_ms(handle->extra, 1);                                                                            /* delay 1 ms */
+            return 1;                                                                                   /* return error */
         }
-        if (timeout == 0)
+        if (res != 0)                                                                                /* check timeout */
         {
             handle->debug_print(handle->extra, "w25qxx: block erase 64k timeout.\n");                                      /* block erase 64k timeout */
 
@@ -6078,6 +6266,8 @@ uint8_t w25qxx_block_erase_64k(w25qxx_handle_t *handle, uint32_t addr)
         }
     }
 
+    a_w25qxx_blank_update(handle, addr, 65536, 1);                                                          /* sectors are blank */
+
     return 0;                                                                                               /* success return 0 */
 }
 
@@ -7178,6 +7368,7 @@ uint8_t w25qxx_init(w25qxx_handle_t *handle)
         }
     }
     handle->address_mode = W25QXX_ADDRESS_MODE_3_BYTE;                                     /* set address mode */
+    handle->read_command = 0;                                                              /* reselect read command */
     handle->inited = 1;                                                                    /* initialize inited */
 
     return 0;                                                                              /* success return 0 */
@@ -7275,19 +7466,138 @@ uint8_t w25qxx_deinit(w25qxx_handle_t *handle)
 }
 
 /**
- * @brief      read data
- * @param[in]  *handle points to a w25qxx handle structure
- * @param[in]  addr is the read address
- * @param[out] *data points to a data buffer
- * @param[in]  len is the data length
- * @return     status code
- *             - 0 success
- *             - 1 read failed
- *             - 2 handle is NULL
- *             - 3 handle is not initialized
- *             - 4 address mode is invalid
+ * @brief     select the fastest read command for the dual quad spi mode
+ * @param[in] *handle points to a w25qxx handle structure
+ * @return    status code
+ *            - 0 success
+ *            - 1 get status2 failed
+ * @note      quad io needs the qe bit in status register 2, dual io is used otherwise;
+ *            the choice is cached until the status register 2 is written again
+ */
+static uint8_t a_w25qxx_read_command_select(w25qxx_handle_t *handle)
+{
+    uint8_t res;
+    uint8_t status;
+
+    if (handle->read_command != 0)                                                                        /* check cache */
+    {
+        return 0;                                                                                         /* success return 0 */
+    }
+    if ((handle->spi_qspi != W25QXX_INTERFACE_SPI) || (handle->dual_quad_spi_enable == 0))                /* qpi or single spi */
+    {
+        handle->read_command = W25QXX_COMMAND_FAST_READ;                                                  /* fast read */
+
+        return 0;                                                                                         /* success return 0 */
+    }
+    res = w25qxx_get_status2(handle, &status);                                                            /* get status2 */
+    if (res != 0)                                                                                         /* check result */
+    {
+        return 1;                                                                                         /* return error */
+    }
+    if ((status & 0x02) != 0)                                                                             /* check qe bit */
+    {
+        handle->read_command = W25QXX_COMMAND_FAST_READ_QUAD_IO;                                          /* quad io */
+    }
+    else
+    {
+        handle->read_command = W25QXX_COMMAND_FAST_READ_DUAL_IO;                                          /* dual io */
+    }
+
+    return 0;                                                                                             /* success return 0 */
+}
+
+/**
+ * @brief      fast read with the selected command in the dual quad spi mode
+ * @param[in]  *handle points to a w25qxx handle structure
+ * @param[in]  addr is the read address
+ * @param[in]  addr_len is the address length
+ * @param[out] *data points to a data buffer
+ * @param[in]  len is the data length
+ * @return     status code
+ *             - 0 success
+ *             - 1 read failed
+ * @note       the mode bits are sent as 0xFF, so the continuous read mode is never entered
+ */
+static uint8_t a_w25qxx_fast_read_multi_line(w25qxx_handle_t *handle, uint32_t addr, uint8_t addr_len,
+                                             uint8_t *data, uint32_t len)
+{
+    if (handle->read_command == W25QXX_COMMAND_FAST_READ_QUAD_IO)                                         /* quad io */
+    {
+        return a_w25qxx_qspi_write_read(handle, W25QXX_COMMAND_FAST_READ_QUAD_IO, 1,
+                                        addr, 4, addr_len,
+                                        0x000000FF, 4, 1,
+                                        4, NULL, 0x00,
+                                        data, len, 4);                                                    /* qspi write read */
+    }
+    else if (handle->read_command == W25QXX_COMMAND_FAST_READ_DUAL_IO)                                    /* dual io */
+    {
+        return a_w25qxx_qspi_write_read(handle, W25QXX_COMMAND_FAST_READ_DUAL_IO, 1,
+                                        addr, 2, addr_len,
+                                        0x000000FF, 2, 1,
+                                        0, NULL, 0x00,
+                                        data, len, 2);                                                    /* qspi write read */
+    }
+    else
+    {
+        return a_w25qxx_qspi_write_read(handle, W25QXX_COMMAND_FAST_READ, 1,
+                                        addr, 1, addr_len,
+                                        0x00000000, 0x00, 0x00,
+                                        8, NULL, 0x00,
+                                        data, len, 1);                                                    /* qspi write read */
+    }
+}
+
+/**
+ * @brief      get the read command used by w25qxx_read
+ * @param[in]  *handle points to a w25qxx handle structure
+ * @param[out] *command points to a command buffer
+ * @return     status code
+ *             - 0 success
+ *             - 1 get read command failed
+ *             - 2 handle is NULL
+ *             - 3 handle is not initialized
  * @note       none
  */
+uint8_t w25qxx_get_read_command(w25qxx_handle_t *handle, uint8_t *command)
+{
+    uint8_t res;
+
+    if (handle == NULL)                                                                                   /* check handle */
+    {
+        return 2;                                                                                         /* return error */
+    }
+    if (handle->inited != 1)                                                                              /* check handle initialization */
+    {
+        return 3;                                                                                         /* return error */
+    }
+
+    res = a_w25qxx_read_command_select(handle);                                                           /* select read command */
+    if (res != 0)                                                                                         /* check result */
+    {
+        handle->debug_print(handle->extra, "w25qxx: select read command failed.\n");                                    /* select read command failed */
+
+        return 1;                                                                                         /* return error */
+    }
+    *command = handle->read_command;                                                                      /* set command */
+
+    return 0;                                                                                             /* success return 0 */
+}
+
+/**
+ * @brief      read data
+ * @param[in]  *handle points to a w25qxx handle structure
+ * @param[in]  addr is the read address
+ * @param[out] *data points to a data buffer
+ * @param[in]  len is the data length
+ * @return     status code
+ *             - 0 success
+ *             - 1 read failed
+ *             - 2 handle is NULL
+ *             - 3 handle is not initialized
+ *             - 4 address mode is invalid
+ * @note       in the dual quad spi mode the fastest read command the chip allows is used,
+ *             see w25qxx_get_read_command
+ */
 uint8_t w25qxx_read(w25qxx_handle_t *handle, uint32_t addr, uint8_t *data, uint32_t len)
 {
     uint8_t res;
@@ -7306,6 +7616,13 @@ uint8_t w25qxx_read(w25qxx_handle_t *handle, uint32_t addr, uint8_t *data, uint3
     {
         if (handle->dual_quad_spi_enable != 0)                                                            /* enable dual quad spi */
         {
+            res = a_w25qxx_read_command_select(handle);                                                   /* select read command */
+            if (res != 0)                                                                                 /* check result */
+            {
+                handle->debug_print(handle->extra, "w25qxx: select read command failed.\n");                       /* select read command failed */
+
+                return 1;                                                                                 /* return error */
+            }
             if (handle->address_mode == W25QXX_ADDRESS_MODE_3_BYTE)                                       /* 3 address mode */
             {
                 if (handle->type >= W25Q256)                                                              /* >128Mb */
@@ -7334,11 +7651,7 @@ uint8_t w25qxx_read(w25qxx_handle_t *handle, uint32_t addr, uint8_t *data, uint3
                         return 1;                                                                         /* return error */
                     }
                 }
-                res = a_w25qxx_qspi_write_read(handle, W25QXX_COMMAND_FAST_READ, 1,
-                                               addr, 1, 3,
-                                               0x00000000, 0x00, 0x00,
-                                               8, NULL, 0x00,                                             /* spi write */
-                                               data, len, 1);                                             /* spi write read */
+                res = a_w25qxx_fast_read_multi_line(handle, addr, 3, data, len);                          /* fast read */
                 if (res != 0)                                                                             /* check result */
                 {
                     handle->debug_print(handle->extra, "w25qxx: fast read failed.\n");                                   /* fast read failed */
@@ -7348,11 +7661,7 @@ uint8_t w25qxx_read(w25qxx_handle_t *handle, uint32_t addr, uint8_t *data, uint3
             }
             else if ((handle->address_mode == W25QXX_ADDRESS_MODE_4_BYTE) && (handle->type >= W25Q256))
             {
-                res = a_w25qxx_qspi_write_read(handle, W25QXX_COMMAND_FAST_READ, 1,
-                                               addr, 1, 4,
-                                               0x00000000, 0x00, 0x00,
-                                               8, NULL, 0x00,                                             /* spi write */
-                                               data, len, 1);                                             /* spi write read */
+                res = a_w25qxx_fast_read_multi_line(handle, addr, 4, data, len);                          /* fast read */
                 if (res != 0)                                                                             /* check result */
                 {
                     handle->debug_print(handle->extra, "w25qxx: fast read failed.\n");                                   /* fast read failed */
@@ -7516,6 +7825,13 @@ static uint8_t a_w25qxx_read(w25qxx_handle_t *handle, uint32_t addr, uint8_t *da
     {
         if (handle->dual_quad_spi_enable != 0)                                                            /* enable dual quad spi */
         {
+            res = a_w25qxx_read_command_select(handle);                                                   /* select read command */
+            if (res != 0)                                                                                 /* check result */
+            {
+                handle->debug_print(handle->extra, "w25qxx: select read command failed.\n");                       /* select read command failed */
+
+                return 1;                                                                                 /* return error */
+            }
             if (handle->address_mode == W25QXX_ADDRESS_MODE_3_BYTE)                                       /* 3 address mode */
             {
                 if (handle->type >= W25Q256)                                                              /* >128Mb */
@@ -7544,11 +7860,7 @@ static uint8_t a_w25qxx_read(w25qxx_handle_t *handle, uint32_t addr, uint8_t *da
                         return 1;                                                                         /* return error */
                     }
                 }
-                res = a_w25qxx_qspi_write_read(handle, W25QXX_COMMAND_FAST_READ, 1,
-                                               addr, 1, 3,
-                                               0x00000000, 0x00, 0x00,
-                                               8, NULL, 0x00,
-                                               data, len, 1);                                             /* spi write read */
+                res = a_w25qxx_fast_read_multi_line(handle, addr, 3, data, len);                          /* fast read */
                 if (res != 0)                                                                             /* check result */
                 {
                     handle->debug_print(handle->extra, "w25qxx: fast read failed.\n");                                   /* fast read failed */
@@ -7558,11 +7870,7 @@ static uint8_t a_w25qxx_read(w25qxx_handle_t *handle, uint32_t addr, uint8_t *da
             }
             else if ((handle->address_mode == W25QXX_ADDRESS_MODE_4_BYTE) && (handle->type >= W25Q256))
             {
-                res = a_w25qxx_qspi_write_read(handle, W25QXX_COMMAND_FAST_READ, 1,
-                                               addr, 1, 4,
-                                               0x00000000, 0x00, 0x00,
-                                               8, NULL, 0x00,
-                                               data, len, 1);                                             /* spi write read */
+                res = a_w25qxx_fast_read_multi_line(handle, addr, 4, data, len);                          /* fast read */
                 if (res != 0)                                                                             /* check result */
                 {
                     handle->debug_print(handle->extra, "w25qxx: fast read failed.\n");                                   /* fast read failed */
@@ -7717,10 +8025,10 @@ static uint8_t a_w25qxx_read(w25qxx_handle_t *handle, uint32_t addr, uint8_t *da
 static uint8_t a_w25qxx_erase_sector(w25qxx_handle_t *handle, uint32_t addr)
 {
     uint8_t res;
-    uint8_t status;
-    uint32_t timeout;
     uint8_t buf[5];
 
+    a_w25qxx_blank_update(handle, addr, 4096, 0);                                                           /* unknown while erasing */
+
     if (handle->spi_qspi == W25QXX_INTERFACE_SPI)                                                           /* spi interface */
     {
         if (handle->dual_quad_spi_enable != 0)                                                              /* enable dual quad spi */
@@ -7797,28 +8105,14 @@ static uint8_t a_w25qxx_erase_sector(w25qxx_handle_t *handle, uint32_t addr)
                 return 1;                                                                                   /* return error */
             }
 
-            timeout = 400;                                                                                  /* max 400 ms */
-            while (timeout != 0)                                                                            /* check timeout */
+            res = a_w25qxx_wait_busy(handle, W25QXX_SECTOR_ERASE_4K_TYP_US, W25QXX_SECTOR_ERASE_4K_MAX_US);/* wait busy */
+            if (res == 1)                                                                                /* check result */
             {
-                res = a_w25qxx_qspi_write_read(handle, W25QXX_COMMAND_READ_STATUS_REG1, 1,
-                                               0x00000000, 0x00, 0x00,
-                                               0x00000000, 0x00, 0x00,
-                                               0, NULL, 0,
-                                              (uint8_t *)&status, 1, 1);                                    /* spi write read */
-                if (res != 0)                                                                               /* check result */
-                {
-                    handle->debug_print(handle->extra, "w25qxx: get status1 failed.\n");                                   /* get status1 failed */
+                handle->debug_print(handle->extra, "w25qxx: get status1 failed.\n");                                   /* get status1 failed */
 
-                    return 1;                                                                               /* return error */
-                }
-                if ((status & 0x01) == 0x00)                                                                /* check status */
-                {
-                    break;                                                                                  /* break */
-                }
-                timeout--;                                                                                  /* timeout-- */
-                handle->delay_ms(handle->extra, 1);                                                                        /* delay 1 ms */
+                return 1;                                                                               /* return error */
             }
-            if (timeout == 0)
+            if (res != 0)                                                                                /* check timeout */
             {
                 handle->debug_print(handle->extra, "w25qxx: sector erase 4k timeout.\n");                                  /* sector erase 4k timeout */
 
@@ -7891,25 +8185,14 @@ static uint8_t a_w25qxx_erase_sector(w25qxx_handle_t *handle, uint32_t addr)
                 return 1;                                                                                   /* return error */
             }
 
-            timeout = 400;                                                                                  /* max 400 ms */
-            while (timeout != 0)                                                                            /* check timeout */
+            res = a_w25qxx_wait_busy(handle, W25QXX_SECTOR_ERASE_4K_TYP_US, W25QXX_SECTOR_ERASE_4K_MAX_US);/* wait busy */
+            if (res == 1)                                                                                /* check result */
             {
-                buf[0] = W25QXX_COMMAND_READ_STATUS_REG1;                                                   /* read status1 command */
-                res = a_w25qxx_spi_write_read(handle, (uint8_t *)buf, 1, (uint8_t *)&status, 1);            /* spi write read */
-                if (res != 0)                                                                               /* check result */
-                {
-                    handle->debug_print(handle->extra, "w25qxx: get status1 failed.\n");                                   /* get status1 failed */
+                handle->debug_print(handle->extra, "w25qxx: get status1 failed.\n");                                   /* get status1 failed */
 
-                    return 1;                                                                               /* return error */
-                }
-                if ((status & 0x01) == 0x00)                                                                /* check status */
-                {
-                    break;                                                                                  /* break */
-                }
-                timeout--;                                                                                  /* timeout-- */
-                handle->delay_ms(handle->extra, 1);                                                                        /* delay 1 ms */
+                return 1;                                                                               /* return error */
             }
-            if (timeout == 0)
+            if (res != 0)                                                                                /* check timeout */
             {
                 handle->debug_print(handle->extra, "w25qxx: sector erase 4k timeout.\n");                                  /* sector erase 4k timeout */
 
@@ -7991,28 +8274,14 @@ static uint8_t a_w25qxx_erase_sector(w25qxx_handle_t *handle, uint32_t addr)
             return 1;                                                                                       /* return error */
         }
 
-        timeout = 400;                                                                                      /* max 400 ms */
-        while (timeout != 0)                                                                                /* check timeout */
+        res = a_w25qxx_wait_busy(handle, W25QXX_SECTOR_ERASE_4K_TYP_US, W25QXX_SECTOR_ERASE_4K_MAX_US);/* wait busy */
+        if (res == 1)                                                                                /* check result */
         {
-            res = a_w25qxx_qspi_write_read(handle, W25QXX_COMMAND_READ_STATUS_REG1, 4,
-                                           0x00000000, 0x00, 0x00,
-                                           0x00000000, 0x00, 0x00,
-                                           0, NULL, 0,
-                                          (uint8_t *)&status, 1, 4);                                        /* spi write read */
-            if (res != 0)                                                                                   /* check result */
-            {
-                handle->debug_print(handle->extra, "w25qxx: get status1 failed.\n");                                       /* get status1 failed */
+            handle->debug_print(handle->extra, "w25qxx: get status1 failed.\n");                                       /* get status1 failed */
 
-                return 1;                                                                                   /* return error */
-            }
-            if ((status & 0x01) == 0x00)                                                                    /* check status */
-            {
-                break;                                                                                      /* break */
-            }
-            timeout--;                                                                                      /* timeout-- */
-            handle->delay_ms(handle->extra, 1);                                                                            /* delay 1 ms */
+            return 1;                                                                                   /* return error */
         }
-        if (timeout == 0)
+        if (res != 0)                                                                                /* check timeout */
         {
             handle->debug_print(handle->extra, "w25qxx: sector erase 4k timeout.\n");                                      /* sector erase 4k timeout */
 
@@ -8020,383 +8289,351 @@ static uint8_t a_w25qxx_erase_sector(w25qxx_handle_t *handle, uint32_t addr)
         }
     }
 
+    a_w25qxx_blank_update(handle, addr, 4096, 1);                                                           /* sector is blank */
+
     return 0;                                                                                               /* success return 0 */
 }
 
 /**
- * @brief     page program
+ * @brief     send a command without address, write enable or extended address register
+ * @param[in] *handle points to a w25qxx handle structure
+ * @param[in] instruction is the sent instruction
+ * @param[in] *param points to a parameter buffer, NULL for none
+ * @param[in] len is the parameter length, 0 or 1
+ * @return    status code
+ *            - 0 success
+ *            - 1 write read failed
+ * @note      none
+ */
+static uint8_t a_w25qxx_program_command(w25qxx_handle_t *handle, uint8_t instruction, uint8_t *param, uint8_t len)
+{
+    uint8_t buf[2];
+
+    if (handle->spi_qspi == W25QXX_INTERFACE_QSPI)                                    /* qspi interface */
+    {
+        return a_w25qxx_qspi_write_read(handle, instruction, 4,
+                                        0x00000000, 0x00, 0x00,
+                                        0x00000000, 0x00, 0x00,
+                                        0x00, param, len,
+                                        NULL, 0x00, (len != 0) ? 4 : 0);              /* qspi write read */
+    }
+    if (handle->dual_quad_spi_enable != 0)                                            /* enable dual quad spi */
+    {
+        return a_w25qxx_qspi_write_read(handle, instruction, 1,
+                                        0x00000000, 0x00, 0x00,
+                                        0x00000000, 0x00, 0x00,
+                                        0x00, param, len,
+                                        NULL, 0x00, (len != 0) ? 1 : 0);              /* qspi write read */
+    }
+    buf[0] = instruction;                                                             /* set instruction */
+    if (len != 0)                                                                     /* check parameter */
+    {
+        buf[1] = param[0];                                                            /* set parameter */
+    }
+
+    return a_w25qxx_spi_write_read(handle, (uint8_t *)buf, 1 + len, NULL, 0);         /* spi write read */
+}
+
+/**
+ * @brief     build the single spi page program frame of the batched program
+ * @param[in] *handle points to a w25qxx handle structure
+ * @param[in] addr is the programming address
+ * @param[in] *data points to a data buffer
+ * @param[in] len is the data length
+ * @return    frame length
+ * @note      buf_pipe is used by the batched program only, so the next frame can be built
+ *            while the chip programs the previous one and a read served meanwhile can't touch it
+ */
+static uint32_t a_w25qxx_program_stage(w25qxx_handle_t *handle, uint32_t addr, uint8_t *data, uint16_t len)
+{
+    uint32_t pos;
+
+    pos = 0;                                                                          /* init 0 */
+    handle->buf_pipe[pos++] = W25QXX_COMMAND_PAGE_PROGRAM;                            /* page program command */
+    if (handle->address_mode == W25QXX_ADDRESS_MODE_4_BYTE)                           /* 4 address mode */
+    {
+        handle->buf_pipe[pos++] = (addr >> 24) & 0xFF;                                /* 31 - 24 bits */
+    }
+    handle->buf_pipe[pos++] = (addr >> 16) & 0xFF;                                    /* 23 - 16 bits */
+    handle->buf_pipe[pos++] = (addr >> 8) & 0xFF;                                     /* 15 - 8  bits */
+    handle->buf_pipe[pos++] = (addr >> 0) & 0xFF;                                     /* 7 - 0 bits */
+    memcpy(&handle->buf_pipe[pos], data, len);                                        /* copy data */
+
+    return pos + len;                                                                 /* return frame length */
+}
+
+/**
+ * @brief     start programming one page without waiting for it
  * @param[in] *handle points to a w25qxx handle structure
  * @param[in] addr is the programming address
  * @param[in] *data points to a data buffer
  * @param[in] len is the data length
+ * @param[in] frame_len is the length of the frame staged in buf_pipe, single spi only
  * @return    status code
  *            - 0 success
  *            - 1 page program failed
- * @note      none
+ * @note      in 3 byte address mode of >128Mb chips the extended address register is
+ *            written only when the high address byte differs from handle->ext_addr
  */
-static uint8_t a_w25qxx_page_program(w25qxx_handle_t *handle, uint32_t addr, uint8_t *data, uint16_t len)
+static uint8_t a_w25qxx_program_issue(w25qxx_handle_t *handle, uint32_t addr, uint8_t *data, uint16_t len, uint32_t frame_len)
 {
     uint8_t res;
-    uint8_t status;
-    uint32_t timeout;
-    uint8_t buf[2];
+    uint8_t line;
+    uint8_t addr_len;
+    uint8_t ext;
 
-    if (handle->spi_qspi == W25QXX_INTERFACE_SPI)                                                           /* spi interface */
+    res = a_w25qxx_program_command(handle, W25QXX_COMMAND_WRITE_ENABLE, NULL, 0);     /* write enable */
+    if (res != 0)                                                                     /* check result */
     {
-        if (handle->dual_quad_spi_enable != 0)                                                              /* enable dual quad spi */
+        handle->debug_print(handle->extra, "w25qxx: write enable failed.\n");         /* write enable failed */
+
+        return 1;                                                                     /* return error */
+    }
+    addr_len = 4;                                                                     /* 4 address mode */
+    if (handle->address_mode == W25QXX_ADDRESS_MODE_3_BYTE)                           /* 3 address mode */
+    {
+        addr_len = 3;                                                                 /* 3 address bytes */
+        ext = (addr >> 24) & 0xFF;                                                    /* 31 - 24 bits */
+        if ((handle->type >= W25Q256) && (handle->ext_addr != ext))                   /* >128Mb, other 16MB bank */
         {
-            res = a_w25qxx_qspi_write_read(handle, W25QXX_COMMAND_WRITE_ENABLE, 1,
-                                           0x00000000, 0x00, 0x00,
-                                           0x00000000, 0x00, 0x00,
-                                           0x00, NULL, 0x00,
-                                           NULL, 0x00, 0x00);                                               /* qspi write read */
-            if (res != 0)                                                                                   /* check result */
+            res = a_w25qxx_program_command(handle, 0xC5, &ext, 1);                    /* write extended addr register */
+            if (res != 0)                                                             /* check result */
             {
-                handle->debug_print(handle->extra, "w25qxx: write enable failed.\n");                                      /* write enable failed */
+                handle->debug_print(handle->extra, "w25qxx: write extended addr register failed.\n"); /* write extended addr register failed */
 
-                return 1;                                                                                   /* return error */
+                return 1;                                                             /* return error */
             }
-            if (handle->address_mode == W25QXX_ADDRESS_MODE_3_BYTE)                                         /* 3 address mode */
+            handle->ext_addr = ext;                                                   /* remember bank */
+            res = a_w25qxx_program_command(handle, W25QXX_COMMAND_WRITE_ENABLE, NULL, 0); /* write enable */
+            if (res != 0)                                                             /* check result */
             {
-                if (handle->type >= W25Q256)                                                                /* >128Mb */
-                {
-                    buf[0] = (addr >> 24) & 0xFF;                                                           /* 31 - 24 bits */
-                    res = a_w25qxx_qspi_write_read(handle, 0xC5, 1,
-                                                   0x00000000, 0x00, 0x00,
-                                                   0x00000000, 0x00, 0x00,
-                                                   0, (uint8_t *)buf, 0x01,
-                                                   NULL, 0x00, 1);                                          /* spi write read */
-                    if (res != 0)                                                                           /* check result */
-                    {
-                        handle->debug_print(handle->extra, "w25qxx: write extended addr register failed.\n");              /* write extended addr register failed */
-
-                        return 1;                                                                           /* return error */
-                    }
-                    res = a_w25qxx_qspi_write_read(handle, W25QXX_COMMAND_WRITE_ENABLE, 1,
-                                                   0x00000000, 0x00, 0x00,
-                                                   0x00000000, 0x00, 0x00,
-                                                   0x00, NULL, 0x00,
-                                                   NULL, 0x00, 0x00);                                       /* qspi write read */
-                    if (res != 0)                                                                           /* check result */
-                    {
-                        handle->debug_print(handle->extra, "w25qxx: write enable failed.\n");                              /* write enable failed */
-
-                        return 1;                                                                           /* return error */
-                    }
-                }
-                res = a_w25qxx_qspi_write_read(handle, W25QXX_COMMAND_PAGE_PROGRAM, 1,
-                                               addr, 1, 3,
-                                               0x00000000, 0x00, 0x00,
-                                               0, data, len,
-                                               NULL, 0x00, 1);                                              /* spi write read */
-                if (res != 0)                                                                               /* check result */
-                {
-                    handle->debug_print(handle->extra, "w25qxx: page program failed.\n");                                  /* page program failed */
+                handle->debug_print(handle->extra, "w25qxx: write enable failed.\n"); /* write enable failed */
 
-                    return 1;                                                                               /* return error */
-                }
+                return 1;                                                             /* return error */
             }
-            else if ((handle->address_mode == W25QXX_ADDRESS_MODE_4_BYTE) && (handle->type >= W25Q256))
-            {
-                res = a_w25qxx_qspi_write_read(handle, W25QXX_COMMAND_PAGE_PROGRAM, 1,
-                                               addr, 1, 4,
-                                               0x00000000, 0x00, 0x00,
-                                               0, data, len,
-                                               NULL, 0x00, 1);                                              /* spi write read */
-                if (res != 0)                                                                               /* check result */
-                {
-                    handle->debug_print(handle->extra, "w25qxx: page program failed.\n");                                  /* page program failed */
+        }
+    }
+    if ((handle->spi_qspi == W25QXX_INTERFACE_SPI) && (handle->dual_quad_spi_enable == 0)) /* single spi */
+    {
+        res = a_w25qxx_spi_write_read(handle, (uint8_t *)handle->buf_pipe, frame_len, NULL, 0); /* send staged frame */
+    }
+    else
+    {
+        line = (handle->spi_qspi == W25QXX_INTERFACE_QSPI) ? 4 : 1;                   /* set phy lines */
+        res = a_w25qxx_qspi_write_read(handle, W25QXX_COMMAND_PAGE_PROGRAM, line,
+                                       addr, line, addr_len,
+                                       0x00000000, 0x00, 0x00,
+                                       0, data, len,
+                                       NULL, 0x00, line);                             /* qspi write read */
+    }
+    if (res != 0)                                                                     /* check result */
+    {
+        handle->debug_print(handle->extra, "w25qxx: page program failed.\n");         /* page program failed */
 
-                    return 1;                                                                               /* return error */
-                }
-            }
-            else
-            {
-                handle->debug_print(handle->extra, "w25qxx: address mode is invalid.\n");                                  /* address mode is invalid */
+        return 1;                                                                     /* return error */
+    }
 
-                return 1;                                                                                   /* return error */
-            }
+    return 0;                                                                         /* success return 0 */
+}
 
-            timeout = 3 * 100;                                                                              /* max 3 ms */
-            while (timeout != 0)                                                                            /* check timeout */
-            {
-                res = a_w25qxx_qspi_write_read(handle, W25QXX_COMMAND_READ_STATUS_REG1, 1,
-                                               0x00000000, 0x00, 0x00,
-                                               0x00000000, 0x00, 0x00,
-                                               0, NULL, 0,
-                                              (uint8_t *)&status, 1, 1);                                    /* spi write read */
-                if (res != 0)                                                                               /* check result */
-                {
-                    handle->debug_print(handle->extra, "w25qxx: page program failed.\n");                                  /* page program failed */
-
-                    return 1;                                                                               /* return error */
-                }
-                if ((status & 0x01) == 0x00)                                                                /* check status */
-                {
-                    break;                                                                                  /* break */
-                }
-                timeout--;                                                                                  /* timeout-- */
-                handle->delay_us(handle->extra, 10);                                                                       /* delay 10 us */
-            }
-            if (timeout == 0)
-            {
-                handle->debug_print(handle->extra, "w25qxx: page program timeout.\n");                                     /* page program timeout */
-
-                return 1;                                                                                   /* return error */
-            }
-        }
-        else                                                                                                /* single spi */
-        {
-            buf[0] = W25QXX_COMMAND_WRITE_ENABLE;                                                           /* write enable command */
-            res = a_w25qxx_spi_write_read(handle, (uint8_t *)buf, 1, NULL, 0);                              /* spi write read */
-            if (res != 0)                                                                                   /* check result */
-            {
-                handle->debug_print(handle->extra, "w25qxx: write enable failed.\n");                                      /* write enable failed */
-
-                return 1;                                                                                   /* return error */
-            }
-            if (handle->address_mode == W25QXX_ADDRESS_MODE_3_BYTE)                                         /* 3 address mode */
-            {
-                if (handle->type >= W25Q256)                                                                /* >128Mb */
-                {
-                    buf[0] = 0xC5;                                                                          /* write extended addr register command */
-                    buf[1] = (addr >> 24) & 0xFF;                                                           /* 31 - 24 bits */
-                    res = a_w25qxx_spi_write_read(handle, (uint8_t *)buf, 2, NULL, 0);                      /* spi write read */
-                    if (res != 0)                                                                           /* check result */
-                    {
-                        handle->debug_print(handle->extra, "w25qxx: write extended addr register failed.\n");              /* write extended addr register failed */
-
-                        return 1;                                                                           /* return error */
-                    }
-                    buf[0] = W25QXX_COMMAND_WRITE_ENABLE;                                                   /* write enable command */
-                    res = a_w25qxx_spi_write_read(handle, (uint8_t *)buf, 1, NULL, 0);                      /* spi write read */
-                    if (res != 0)                                                                           /* check result */
-                    {
-                        handle->debug_print(handle->extra, "w25qxx: write enable failed.\n");                              /* write enable failed */
-
-                        return 1;                                                                           /* return error */
-                    }
-                }
-                handle->buf[0] = W25QXX_COMMAND_PAGE_PROGRAM;                                               /* page program command */
-                handle->buf[1] = (addr >> 16) & 0xFF;                                                       /* 23 - 16 bits */
-                handle->buf[2] = (addr >> 8) & 0xFF;                                                        /* 15 - 8  bits */
-                handle->buf[3] = (addr >> 0) & 0xFF;                                                        /* 7 - 0 bits */
-                memcpy(&handle->buf[4], data, len);                                                         /* copy data */
-                res = a_w25qxx_spi_write_read(handle, (uint8_t *)handle->buf, 4 + len, NULL, 0);            /* spi write read */
-                if (res != 0)                                                                               /* check result */
-                {
-                    handle->debug_print(handle->extra, "w25qxx: page program failed.\n");                                  /* page program failed */
-
-                    return 1;                                                                               /* return error */
-                }
-            }
-            else if ((handle->address_mode == W25QXX_ADDRESS_MODE_4_BYTE)
-                     && (handle->type >= W25Q256))                                                          /* 4 address mode */
-            {
-                handle->buf[0] = W25QXX_COMMAND_PAGE_PROGRAM;                                               /* page program command */
-                handle->buf[1] = (addr >> 24) & 0xFF;                                                       /* 31 - 24 bits */
-                handle->buf[2] = (addr >> 16) & 0xFF;                                                       /* 23 - 16 bits */
-                handle->buf[3] = (addr >> 8) & 0xFF;                                                        /* 15 - 8  bits */
-                handle->buf[4] = (addr >> 0) & 0xFF;                                                        /* 7 - 0 bits */
-                memcpy(&handle->buf[5], data, len);                                                         /* copy data */
-                res = a_w25qxx_spi_write_read(handle, (uint8_t *)handle->buf, 5 + len, NULL, 0);            /* spi write read */
-                if (res != 0)                                                                               /* check result */
-                {
-                    handle->debug_print(handle->extra, "w25qxx: page program failed.\n");                                  /* page program failed */
-
-                    return 1;                                                                               /* return error */
-                }
-            }
-            else
-            {
-                handle->debug_print(handle->extra, "w25qxx: address mode is invalid.\n");                                  /* address mode is invalid */
-
-                return 1;                                                                                   /* return error */
-            }
-
-            timeout = 3 * 100;                                                                              /* max 3 ms */
-            while (timeout != 0)                                                                            /* check timeout */
-            {
-                buf[0] = W25QXX_COMMAND_READ_STATUS_REG1;                                                   /* read status1 command */
-                res = a_w25qxx_spi_write_read(handle, (uint8_t *)buf, 1, (uint8_t *)&status, 1);            /* spi write read */
-                if (res != 0)                                                                               /* check result */
-                {
-                    handle->debug_print(handle->extra, "w25qxx: get status1 failed.\n");                                   /* get status1 failed */
-
-                    return 1;                                                                               /* return error */
-                }
-                if ((status & 0x01) == 0x00)                                                                /* check status */
-                {
-                    break;                                                                                  /* break */
-                }
-                timeout--;                                                                                  /* timeout-- */
-                handle->delay_us(handle->extra, 10);                                                                       /* delay 10 us */
-            }
-            if (timeout == 0)
-            {
-                handle->debug_print(handle->extra, "w25qxx: page program timeout.\n");                                     /* page program timeout */
+/**
+ * @brief         get the next page chunk of a segment list
+ * @param[in]     *seg points to a segment list
+ * @param[in]     count is the segment number
+ * @param[in,out] *index points to the current segment index
+ * @param[in,out] *offset points to the offset in the current segment
+ * @param[out]    *addr points to a chunk address buffer
+ * @param[out]    **data points to a chunk data pointer buffer
+ * @param[out]    *len points to a chunk length buffer
+ * @return        1 if a chunk was returned, 0 at the end of the list
+ * @note          a chunk never crosses a page boundary, empty segments are skipped
+ */
+static uint8_t a_w25qxx_program_next(const w25qxx_program_segment_t *seg, uint32_t count, uint32_t *index,
+                                     uint32_t *offset, uint32_t *addr, uint8_t **data, uint16_t *len)
+{
+    uint32_t chunk;
 
-                return 1;                                                                                   /* return error */
-            }
-        }
+    while ((*index < count) && (*offset >= seg[*index].len))                          /* skip finished segments */
+    {
+        (*index)++;                                                                   /* next segment */
+        *offset = 0;                                                                  /* from its start */
     }
-    else
+    if (*index >= count)                                                              /* check end */
     {
-        res = a_w25qxx_qspi_write_read(handle, W25QXX_COMMAND_WRITE_ENABLE, 4,
-                                       0x00000000, 0x00, 0x00,
-                                       0x00000000, 0x00, 0x00,
-                                       0x00, NULL, 0x00,
-                                       NULL, 0x00, 0x00);                                                   /* qspi write read */
-        if (res != 0)                                                                                       /* check result */
-        {
-            handle->debug_print(handle->extra, "w25qxx: write enable failed.\n");                                          /* write enable failed */
+        return 0;                                                                     /* no more chunk */
+    }
+    *addr = seg[*index].addr + *offset;                                               /* chunk address */
+    *data = &seg[*index].data[*offset];                                               /* chunk data */
+    chunk = 256 - (*addr % 256);                                                      /* page remain */
+    if (chunk > (seg[*index].len - *offset))                                          /* check length */
+    {
+        chunk = seg[*index].len - *offset;                                            /* segment remain */
+    }
+    *len = (uint16_t)chunk;                                                           /* chunk length */
+    *offset += chunk;                                                                 /* advance */
 
-            return 1;                                                                                       /* return error */
+    return 1;                                                                         /* chunk returned */
+}
+
+/**
+ * @brief      program a segment list page by page
+ * @param[in]  *handle points to a w25qxx handle structure
+ * @param[in]  *seg points to a segment list
+ * @param[in]  count is the segment number
+ * @param[out] *pages points to a programmed page number buffer
+ * @return     status code
+ *             - 0 success
+ *             - 1 page program failed
+ *             - 6 page program timeout
+ * @note       while a page programs, the frame of the next one is staged; the first status poll
+ *             of a page follows the program time learned from the previous pages, so a page
+ *             usually costs write enable, page program and one status read
+ */
+static uint8_t a_w25qxx_program_batch(w25qxx_handle_t *handle, const w25qxx_program_segment_t *seg, uint32_t count, uint32_t *pages)
+{
+    uint8_t res;
+    uint8_t more;
+    uint8_t stage;
+    uint8_t *data;
+    uint16_t len;
+    uint32_t addr;
+    uint32_t index;
+    uint32_t offset;
+    uint32_t frame_len;
+    uint32_t first_us;
+    uint32_t elapsed_us;
+
+    *pages = 0;                                                                       /* init 0 */
+    first_us = handle->program_us;                                                    /* learned program time */
+    if (first_us == 0)                                                                /* not learned yet */
+    {
+        first_us = W25QXX_PAGE_PROGRAM_TYP_US / 2;                                    /* as a single page */
+    }
+    index = 0;                                                                        /* first segment */
+    offset = 0;                                                                       /* from its start */
+    frame_len = 0;                                                                    /* no frame */
+    stage = ((handle->spi_qspi == W25QXX_INTERFACE_SPI) &&
+             (handle->dual_quad_spi_enable == 0)) ? 1 : 0;                            /* single spi copies the data */
+    handle->ext_addr = W25QXX_EXT_ADDR_UNKNOWN;                                       /* set by other commands */
+    more = a_w25qxx_program_next(seg, count, &index, &offset, &addr, &data, &len);    /* first chunk */
+    if ((more != 0) && (stage != 0))                                                  /* check stage */
+    {
+        frame_len = a_w25qxx_program_stage(handle, addr, data, len);                  /* stage first frame */
+    }
+    while (more != 0)                                                                 /* loop chunks */
+    {
+        a_w25qxx_blank_update(handle, addr, len, 0);                                  /* sectors are programmed */
+        res = a_w25qxx_program_issue(handle, addr, data, len, frame_len);             /* start programming */
+        if (res != 0)                                                                 /* check result */
+        {
+            return 1;                                                                 /* return error */
         }
-        if (handle->address_mode == W25QXX_ADDRESS_MODE_3_BYTE)                                             /* 3 address mode */
+        (*pages)++;                                                                   /* pages++ */
+        more = a_w25qxx_program_next(seg, count, &index, &offset, &addr, &data, &len); /* next chunk */
+        if ((more != 0) && (stage != 0))                                              /* check stage */
         {
-            if (handle->type >= W25Q256)                                                                    /* >128Mb */
-            {
-                buf[0] = (addr >> 24) & 0xFF;                                                               /* 31 - 24 bits */
-                res = a_w25qxx_qspi_write_read(handle, 0xC5, 4,
-                                               0x00000000, 0x00, 0x00,
-                                               0x00000000, 0x00, 0x00,
-                                               0, (uint8_t *)buf, 0x01,
-                                               NULL, 0x00, 4);                                              /* spi write read */
-                if (res != 0)                                                                               /* check result */
-                {
-                    handle->debug_print(handle->extra, "w25qxx: write extended addr register failed.\n");                  /* write extended addr register failed */
-
-                    return 1;                                                                               /* return error */
-                }
-                res = a_w25qxx_qspi_write_read(handle, W25QXX_COMMAND_WRITE_ENABLE, 4,
-                                               0x00000000, 0x00, 0x00,
-                                               0x00000000, 0x00, 0x00,
-                                               0x00, NULL, 0x00,
-                                               NULL, 0x00, 0x00);                                           /* qspi write read */
-                if (res != 0)                                                                               /* check result */
-                {
-                    handle->debug_print(handle->extra, "w25qxx: write enable failed.\n");                                  /* write enable failed */
-
-                    return 1;                                                                               /* return error */
-                }
-            }
-            res = a_w25qxx_qspi_write_read(handle, W25QXX_COMMAND_PAGE_PROGRAM, 4,
-                                           addr, 4, 3,
-                                           0x00000000, 0x00, 0x00,
-                                           0, data, len,
-                                           NULL, 0x00, 4);                                                  /* spi write read */
-            if (res != 0)                                                                                   /* check result */
-            {
-                handle->debug_print(handle->extra, "w25qxx: page program failed.\n");                                      /* page program failed */
-
-                  return 1;                                                                                 /* return error */
-            }
+            frame_len = a_w25qxx_program_stage(handle, addr, data, len);              /* stage while programming */
         }
-        else if ((handle->address_mode == W25QXX_ADDRESS_MODE_4_BYTE) && (handle->type >= W25Q256))
+        a_w25qxx_wait(handle, first_us);                                              /* expected program time */
+        res = a_w25qxx_wait_busy_from(handle, W25QXX_BUSY_POLL_MIN_US,
+                                      W25QXX_PAGE_PROGRAM_TYP_US,
+                                      W25QXX_PAGE_PROGRAM_MAX_US - first_us, &elapsed_us); /* wait busy */
+        if (elapsed_us != 0)                                                          /* still busy at the first poll */
         {
-            res = a_w25qxx_qspi_write_read(handle, W25QXX_COMMAND_PAGE_PROGRAM, 4,
-                                           addr, 4, 4,
-                                           0x00000000, 0x00, 0x00,
-                                           0, data, len,
-                                           NULL, 0x00, 4);                                                  /* spi write read */
-            if (res != 0)                                                                                   /* check result */
+            first_us += elapsed_us;                                                   /* wait longer next time */
+            if (first_us > (W25QXX_PAGE_PROGRAM_MAX_US / 2))                          /* check max */
             {
-                handle->debug_print(handle->extra, "w25qxx: page program failed.\n");                                      /* page program failed */
-
-                return 1;                                                                                   /* return error */
+                first_us = W25QXX_PAGE_PROGRAM_MAX_US / 2;                            /* set max */
             }
         }
-        else
+        else if (first_us > W25QXX_BUSY_POLL_MIN_US)                                  /* ready at the first poll */
         {
-            handle->debug_print(handle->extra, "w25qxx: address mode is invalid.\n");                                      /* address mode is invalid */
-
-            return 1;                                                                                       /* return error */
+            first_us -= W25QXX_BUSY_POLL_MIN_US;                                      /* try a bit earlier next time */
         }
-
-        timeout = 3 * 100;                                                                                  /* max 3 ms */
-        while (timeout != 0)                                                                                /* check timeout */
+        handle->program_us = first_us;                                                /* keep for the next batch */
+        if (res == 1)                                                                 /* check result */
         {
-            res = a_w25qxx_qspi_write_read(handle, W25QXX_COMMAND_READ_STATUS_REG1, 4,
-                                           0x00000000, 0x00, 0x00,
-                                           0x00000000, 0x00, 0x00,
-                                           0, NULL, 0,
-                                          (uint8_t *)&status, 1, 4);                                        /* spi write read */
-            if (res != 0)                                                                                   /* check result */
-            {
-                handle->debug_print(handle->extra, "w25qxx: page program failed.\n");                                      /* page program failed */
+            handle->debug_print(handle->extra, "w25qxx: get status1 failed.\n");      /* get status1 failed */
 
-                return 1;                                                                                   /* return error */
-            }
-            if ((status & 0x01) == 0x00)                                                                    /* check status */
-            {
-                break;                                                                                      /* break */
-            }
-            timeout--;                                                                                      /* timeout-- */
-            handle->delay_us(handle->extra, 10);                                                                           /* delay 10 us */
+            return 1;                                                                 /* return error */
         }
-        if (timeout == 0)
+        if (res != 0)                                                                 /* check timeout */
         {
-            handle->debug_print(handle->extra, "w25qxx: page program timeout.\n");                                         /* page program timeout */
+            handle->debug_print(handle->extra, "w25qxx: page program timeout.\n");    /* page program timeout */
 
-            return 1;                                                                                       /* return error */
+            return 6;                                                                 /* return error */
         }
     }
 
-    return 0;                                                                                               /* success return 0 */
+    return 0;                                                                         /* success return 0 */
 }
 
 /**
- * @brief     write with no check
+ * @brief     program only the bytes that differ from the flash content
  * @param[in] *handle points to a w25qxx handle structure
  * @param[in] addr is the write address
  * @param[in] *data points to a data buffer
+ * @param[in] *old points to the current flash content of the same range, NULL for an erased range
  * @param[in] len is the data length
  * @return    status code
  *            - 0 success
  *            - 1 write failed
- * @note      none
+ * @note      data may only clear bits of old, every page is programmed once
+ *            over the span between its first and last changed bytes
  */
-static uint8_t a_w25qxx_write_no_check(w25qxx_handle_t *handle, uint32_t addr, uint8_t *data, uint32_t len)
+static uint8_t a_w25qxx_write_diff(w25qxx_handle_t *handle, uint32_t addr, uint8_t *data, uint8_t *old, uint32_t len)
 {
     uint8_t res;
-    uint16_t page_remain;
+    uint32_t pos;
+    uint32_t first;
+    uint32_t last;
+    uint32_t page_len;
+    uint32_t num;
+    uint32_t pages;
+    w25qxx_program_segment_t seg[W25QXX_PROGRAM_BATCH_SEGMENTS];
 
-    page_remain = 256 - addr % 256;                                         /* get remain */
-    if (len <= page_remain)                                                 /* check length */
-    {
-        page_remain = (uint16_t)len;                                        /* page remain */
-    }
-    while( 1)                                                               /* loop */
+    pos = 0;                                                                          /* init 0 */
+    num = 0;                                                                          /* no segment */
+    while (pos < len)                                                                 /* loop pages */
     {
-        res = a_w25qxx_page_program(handle, addr, data, page_remain);       /* page program */
-        if (res != 0)
+        page_len = 256 - (addr + pos) % 256;                                          /* get page remain */
+        if (page_len > (len - pos))                                                   /* check length */
         {
-            handle->debug_print(handle->extra, "w25qxx: page program failed.\n");          /* page program failed */
-
-            return 1;                                                       /* return error */
+            page_len = len - pos;                                                     /* set length */
         }
-        if (len == page_remain)                                             /* check length */
+        first = pos;                                                                  /* span start */
+        last = pos + page_len;                                                        /* span end */
+        while ((first < last) && (data[first] == ((old != NULL) ? old[first] : 0xFF)))
         {
-            break;                                                          /* break loop */
+            first++;                                                                  /* skip unchanged head */
         }
-        else
+        while ((last > first) && (data[last - 1] == ((old != NULL) ? old[last - 1] : 0xFF)))
         {
-            data += page_remain;                                            /* data + page_remain */
-            addr += page_remain;                                            /* address + page_remain */
-            len -= page_remain;                                             /* length - page_remain */
-            if (len > 256)                                                  /* check length */
-            {
-                page_remain = 256;                                          /* set page remain */
-            }
-            else
+            last--;                                                                   /* skip unchanged tail */
+        }
+        if (first < last)                                                             /* page changed */
+        {
+            seg[num].addr = addr + first;                                             /* span address */
+            seg[num].data = &data[first];                                             /* span data */
+            seg[num].len = last - first;                                              /* span length */
+            num++;                                                                    /* segments++ */
+        }
+        pos += page_len;                                                              /* next page */
+        if ((num == W25QXX_PROGRAM_BATCH_SEGMENTS) || ((pos >= len) && (num != 0)))   /* batch full or last page */
+        {
+            res = a_w25qxx_program_batch(handle, seg, num, &pages);                   /* program batch */
+            handle->write_page_cnt += pages;                                          /* page programs + pages */
+            if (res != 0)
             {
-                page_remain = (uint16_t)len;                                /* set length */
+                handle->debug_print(handle->extra, "w25qxx: page program failed.\n"); /* page program failed */
+
+                return 1;                                                             /* return error */
             }
+            num = 0;                                                                  /* empty batch */
         }
     }
 
-    return 0;                                                               /* success return 0 */
+    return 0;                                                                         /* success return 0 */
 }
 
 /**
@@ -8412,7 +8649,8 @@ static uint8_t a_w25qxx_write_no_check(w25qxx_handle_t *handle, uint32_t addr, u
  *            - 3 handle is not initialized
  *            - 4 read failed
  *            - 5 erase sector failed
- * @note      none
+ * @note      a sector is erased only when a bit has to go from 0 to 1,
+ *            otherwise only the changed pages are programmed
  */
 uint8_t w25qxx_write(w25qxx_handle_t *handle, uint32_t addr, uint8_t *data, uint32_t len)
 {
@@ -8431,6 +8669,8 @@ uint8_t w25qxx_write(w25qxx_handle_t *handle, uint32_t addr, uint8_t *data, uint
         return 3;                                                                              /* return error */
     }
 
+    handle->write_page_cnt = 0;                                                                /* reset page programs */
+    handle->write_erase_cnt = 0;                                                               /* reset sector erases */
     sec_pos = addr / 4096;                                                                     /* get sector position */
     sec_off = addr % 4096;                                                                     /* get sector offset */
     sec_remain = 4096 - sec_off;                                                               /* get sector remain */
@@ -8440,21 +8680,23 @@ uint8_t w25qxx_write(w25qxx_handle_t *handle, uint32_t addr, uint8_t *data, uint
     }
     while(1)                                                                                   /* loop */
     {
-        res = a_w25qxx_read(handle, sec_pos * 4096, handle->buf_4k, 4096);                     /* read 4k data */
-        if (res != 0)
+        if (a_w25qxx_blank_known(handle, sec_pos * 4096, 4096) != 0)                           /* known blank sector */
         {
-            handle->debug_print(handle->extra, "w25qxx: read failed.\n");                                     /* read failed */
+            res = a_w25qxx_write_diff(handle, addr, data, NULL, sec_remain);                   /* no read, no erase */
+            if (res != 0)                                                                      /* check result */
+            {
+                handle->debug_print(handle->extra, "w25qxx: write failed.\n");                                /* write failed */
 
-            return 4;                                                                          /* return error */
+                return 1;                                                                      /* return error */
+            }
         }
-        for (i = 0; i< sec_remain; i++)                                                        /* sec_remain length */
+        else if (a_w25qxx_read(handle, sec_pos * 4096, handle->buf_4k, 4096) != 0)             /* read 4k data */
         {
-            if (handle->buf_4k[sec_off + i] != 0xFF)                                           /* check 0xFF */
-            {
-                break;                                                                         /* break loop */
-            }
+            handle->debug_print(handle->extra, "w25qxx: read failed.\n");                                     /* read failed */
+
+            return 4;                                                                          /* return error */
         }
-        if (i < sec_remain)                                                                    /* not all is 0xFF */
+        else if (a_w25qxx_need_erase(&handle->buf_4k[sec_off], data, sec_remain) != 0)         /* erase is required */
         {
             res = a_w25qxx_erase_sector(handle, sec_pos * 4096);                               /* erase sector */
             if (res != 0)
@@ -8463,11 +8705,12 @@ uint8_t w25qxx_write(w25qxx_handle_t *handle, uint32_t addr, uint8_t *data, uint
 
                 return 5;                                                                      /* return error */
             }
+            handle->write_erase_cnt++;                                                         /* sector erases++ */
             for (i = 0; i<sec_remain; i++)                                                     /* sec_remain length */
             {
                 handle->buf_4k[i + sec_off] = data[i];                                         /* copy data */
             }
-            res = a_w25qxx_write_no_check(handle, sec_pos * 4096, handle->buf_4k, 4096);       /* write data no check */
+            res = a_w25qxx_write_diff(handle, sec_pos * 4096, handle->buf_4k, NULL, 4096);     /* write not blank pages */
             if (res != 0)                                                                      /* check result */
             {
                 handle->debug_print(handle->extra, "w25qxx: write failed.\n");                                /* write failed */
@@ -8477,7 +8720,7 @@ uint8_t w25qxx_write(w25qxx_handle_t *handle, uint32_t addr, uint8_t *data, uint
         }
         else
         {
-            res = a_w25qxx_write_no_check(handle, addr, data, sec_remain);                     /* write data */
+            res = a_w25qxx_write_diff(handle, addr, data, &handle->buf_4k[sec_off], sec_remain); /* write changed pages */
             if (res != 0)                                                                      /* check result */
             {
                 handle->debug_print(handle->extra, "w25qxx: write failed.\n");                                /* write failed */
@@ -8510,6 +8753,466 @@ uint8_t w25qxx_write(w25qxx_handle_t *handle, uint32_t addr, uint8_t *data, uint
     return 0;                                                                                  /* success return 0 */
 }
 
+/**
+ * @brief     program a list of segments
+ * @param[in] *handle points to a w25qxx handle structure
+ * @param[in] *seg points to a segment list
+ * @param[in] count is the segment number
+ * @return    status code
+ *            - 0 success
+ *            - 1 page program failed
+ *            - 2 handle is NULL
+ *            - 3 handle is not initialized
+ *            - 4 segment is invalid
+ *            - 5 address mode is invalid
+ *            - 6 page program timeout
+ * @note      the target ranges must be erased, segments are programmed in list order and split at
+ *            page boundaries, the next page is staged while the previous one programs
+ */
+uint8_t w25qxx_program_segments(w25qxx_handle_t *handle, const w25qxx_program_segment_t *seg, uint32_t count)
+{
+    uint8_t res;
+    uint32_t i;
+    uint32_t pages;
+
+    if (handle == NULL)                                                                        /* check handle */
+    {
+        return 2;                                                                              /* return error */
+    }
+    if (handle->inited != 1)                                                                   /* check handle initialization */
+    {
+        return 3;                                                                              /* return error */
+    }
+    if ((count != 0) && (seg == NULL))                                                         /* check list */
+    {
+        handle->debug_print(handle->extra, "w25qxx: segment is invalid.\n");                   /* segment is invalid */
+
+        return 4;                                                                              /* return error */
+    }
+    for (i = 0; i < count; i++)                                                                /* check segments */
+    {
+        if (((seg[i].len != 0) && (seg[i].data == NULL)) ||
+            ((seg[i].addr + seg[i].len) < seg[i].addr))                                        /* check data and wrap */
+        {
+            handle->debug_print(handle->extra, "w25qxx: segment is invalid.\n");               /* segment is invalid */
+
+            return 4;                                                                          /* return error */
+        }
+    }
+    if ((handle->address_mode != W25QXX_ADDRESS_MODE_3_BYTE) &&
+        ((handle->address_mode != W25QXX_ADDRESS_MODE_4_BYTE) || (handle->type < W25Q256)))    /* check address mode */
+    {
+        handle->debug_print(handle->extra, "w25qxx: address mode is invalid.\n");              /* address mode is invalid */
+
+        return 5;                                                                              /* return error */
+    }
+
+    res = a_w25qxx_program_batch(handle, seg, count, &pages);                                  /* program batch */
+    if (res != 0)                                                                              /* check result */
+    {
+        handle->debug_print(handle->extra, "w25qxx: program segments failed.\n");              /* program segments failed */
+
+        return res;                                                                            /* return error */
+    }
+
+    return 0;                                                                                  /* success return 0 */
+}
+
+/**
+ * @brief      get the flash operations issued by the last write
+ * @param[in]  *handle points to a w25qxx handle structure
+ * @param[out] *page_programs points to a page program number buffer
+ * @param[out] *sector_erases points to a sector erase number buffer
+ * @return     status code
+ *             - 0 success
+ *             - 2 handle is NULL
+ *             - 3 handle is not initialized
+ * @note       none
+ */
+uint8_t w25qxx_get_write_statistics(w25qxx_handle_t *handle, uint32_t *page_programs, uint32_t *sector_erases)
+{
+    if (handle == NULL)                                                          /* check handle */
+    {
+        return 2;                                                                /* return error */
+    }
+    if (handle->inited != 1)                                                     /* check handle initialization */
+    {
+        return 3;                                                                /* return error */
+    }
+
+    *page_programs = handle->write_page_cnt;                                     /* get page programs */
+    *sector_erases = handle->write_erase_cnt;                                    /* get sector erases */
+
+    return 0;                                                                    /* success return 0 */
+}
+
+/**
+ * @brief     attach the blank sector map
+ * @param[in] *handle points to a w25qxx handle structure
+ * @param[in] *map points to a map buffer of (sectors + 31) / 32 words, NULL disables the map
+ * @param[in] sectors is the number of 4k sectors tracked from address 0
+ * @return    status code
+ *            - 0 success
+ *            - 2 handle is NULL
+ * @note      the map starts empty, a sector is marked blank by an erase or by w25qxx_blank_check,
+ *            a marked sector is not erased again and w25qxx_write does not read it back
+ */
+uint8_t w25qxx_set_blank_map(w25qxx_handle_t *handle, uint32_t *map, uint32_t sectors)
+{
+    if (handle == NULL)                                                          /* check handle */
+    {
+        return 2;                                                                /* return error */
+    }
+
+    if (map != NULL)                                                             /* check map */
+    {
+        memset(map, 0, ((sectors + 31) / 32) * sizeof(uint32_t));                /* all sectors unknown */
+    }
+    handle->blank_map = map;                                                     /* set map */
+    handle->blank_sectors = (map != NULL) ? sectors : 0;                         /* set sectors */
+    handle->blank_hits = 0;                                                      /* reset hits */
+    handle->blank_misses = 0;                                                    /* reset misses */
+
+    return 0;                                                                    /* success return 0 */
+}
+
+/**
+ * @brief      check if a 4k sector is blank
+ * @param[in]  *handle points to a w25qxx handle structure
+ * @param[in]  addr is the sector address
+ * @param[out] *blank points to a bool value buffer
+ * @return     status code
+ *             - 0 success
+ *             - 1 read failed
+ *             - 2 handle is NULL
+ *             - 3 handle is not initialized
+ *             - 4 addr is invalid
+ * @note       a sector already known blank is not read, a blank result is stored in the map,
+ *             reading stops at the first programmed word
+ */
+uint8_t w25qxx_blank_check(w25qxx_handle_t *handle, uint32_t addr, w25qxx_bool_t *blank)
+{
+    uint32_t off;
+    uint32_t i;
+    uint32_t w;
+
+    if (handle == NULL)                                                          /* check handle */
+    {
+        return 2;                                                                /* return error */
+    }
+    if (handle->inited != 1)                                                     /* check handle initialization */
+    {
+        return 3;                                                                /* return error */
+    }
+    if ((addr % 4096) != 0)                                                      /* check address */
+    {
+        handle->debug_print(handle->extra, "w25qxx: addr is invalid.\n");                   /* addr is invalid */
+
+        return 4;                                                                /* return error */
+    }
+
+    if (a_w25qxx_blank_known(handle, addr, 4096) != 0)                           /* already known */
+    {
+        *blank = W25QXX_BOOL_TRUE;                                               /* blank */
+
+        return 0;                                                                /* success return 0 */
+    }
+    *blank = W25QXX_BOOL_FALSE;                                                  /* programmed until proven */
+    for (off = 0; off < 4096; off += 256)                                        /* 256 bytes per read */
+    {
+        if (a_w25qxx_read(handle, addr + off, handle->buf_4k, 256) != 0)         /* read data */
+        {
+            handle->debug_print(handle->extra, "w25qxx: read failed.\n");                   /* read failed */
+
+            return 1;                                                            /* return error */
+        }
+        for (i = 0; i < 256; i += 4)                                             /* words */
+        {
+            memcpy(&w, &handle->buf_4k[i], 4);                                   /* load word */
+            if (w != 0xFFFFFFFFUL)                                               /* check erased */
+            {
+                return 0;                                                        /* success return 0 */
+            }
+        }
+    }
+    *blank = W25QXX_BOOL_TRUE;                                                   /* blank */
+    a_w25qxx_blank_update(handle, addr, 4096, 1);                                /* remember */
+
+    return 0;                                                                    /* success return 0 */
+}
+
+/**
+ * @brief      get the blank map erase statistics
+ * @param[in]  *handle points to a w25qxx handle structure
+ * @param[out] *hits points to a buffer of erases skipped because the sectors were known blank
+ * @param[out] *misses points to a buffer of erases sent to the chip
+ * @return     status code
+ *             - 0 success
+ *             - 2 handle is NULL
+ *             - 3 handle is not initialized
+ * @note       counted since w25qxx_set_blank_map, only while a map is attached
+ */
+uint8_t w25qxx_get_blank_statistics(w25qxx_handle_t *handle, uint32_t *hits, uint32_t *misses)
+{
+    if (handle == NULL)                                                          /* check handle */
+    {
+        return 2;                                                                /* return error */
+    }
+    if (handle->inited != 1)                                                     /* check handle initialization */
+    {
+        return 3;                                                                /* return error */
+    }
+
+    *hits = handle->blank_hits;                                                  /* get hits */
+    *misses = handle->blank_misses;                                              /* get misses */
+
+    return 0;                                                                    /* success return 0 */
+}
+
+/**
+ * @brief     attach the trace data
+ * @param[in] *handle points to a w25qxx handle structure
+ * @param[in] *trace points to a trace structure, NULL stops tracing
+ * @param[in] *timestamp_us points to a free running us clock
+ * @return    status code
+ *            - 0 success
+ *            - 2 handle is NULL
+ *            - 4 trace is disabled
+ *            - 5 timestamp_us is NULL
+ * @note      the trace structure is cleared, tracing is compiled in with W25QXX_TRACE
+ */
+uint8_t w25qxx_set_trace(w25qxx_handle_t *handle, w25qxx_trace_t *trace, uint32_t (*timestamp_us)(void))
+{
+    if (handle == NULL)                                                          /* check handle */
+    {
+        return 2;                                                                /* return error */
+    }
+#if (W25QXX_TRACE == 1)
+    if (trace == NULL)                                                           /* stop tracing */
+    {
+        handle->trace = NULL;                                                    /* detach */
+
+        return 0;                                                                /* success return 0 */
+    }
+    if (timestamp_us == NULL)                                                    /* check clock */
+    {
+        handle->debug_print(handle->extra, "w25qxx: timestamp_us is null.\n");   /* timestamp_us is null */
+
+        return 5;                                                                /* return error */
+    }
+
+    memset(trace, 0, sizeof(w25qxx_trace_t));                                    /* clear trace */
+    trace->timestamp_us = timestamp_us;                                          /* set clock */
+    trace->pending.op = W25QXX_TRACE_OP_MAX;                                     /* nothing in flight */
+    handle->trace = trace;                                                       /* attach */
+
+    return 0;                                                                    /* success return 0 */
+#else
+    (void)trace;                                                                 /* not used */
+    (void)timestamp_us;                                                          /* not used */
+
+    return 4;                                                                    /* return error */
+#endif
+}
+
+/**
+ * @brief      get the statistics of an operation
+ * @param[in]  *handle points to a w25qxx handle structure
+ * @param[in]  op is the traced operation
+ * @param[out] *stats points to a statistics buffer
+ * @return     status code
+ *             - 0 success
+ *             - 2 handle is NULL
+ *             - 4 no trace is attached
+ *             - 5 op is invalid
+ * @note       may be called from any task
+ */
+uint8_t w25qxx_trace_get_stats(w25qxx_handle_t *handle, w25qxx_trace_op_t op, w25qxx_trace_stats_t *stats)
+{
+    w25qxx_trace_t *trace;
+    w25qxx_trace_op_data_t data;
+    uint32_t seq;
+    uint32_t rank;
+    uint32_t sum;
+    uint32_t i;
+
+    if (handle == NULL)                                                          /* check handle */
+    {
+        return 2;                                                                /* return error */
+    }
+    trace = handle->trace;                                                       /* get trace */
+    if (trace == NULL)                                                           /* check trace */
+    {
+        return 4;                                                                /* return error */
+    }
+    if (op >= W25QXX_TRACE_OP_MAX)                                               /* check op */
+    {
+        return 5;                                                                /* return error */
+    }
+
+    do
+    {
+        seq = trace->seq;                                                        /* get seq */
+        __sync_synchronize();                                                    /* seq before data */
+        data = trace->op[op];                                                    /* copy data */
+        __sync_synchronize();                                                    /* data before seq */
+    } while (((seq & 1) != 0) || (seq != trace->seq));                           /* retry if updated meanwhile */
+
+    memset(stats, 0, sizeof(w25qxx_trace_stats_t));                              /* clear stats */
+    stats->count = data.count;                                                   /* set count */
+    stats->bytes = data.bytes;                                                   /* set bytes */
+    stats->polls = data.polls;                                                   /* set polls */
+    if (data.count == 0)                                                         /* nothing recorded */
+    {
+        return 0;                                                                /* success return 0 */
+    }
+    stats->min_us = data.min_us;                                                 /* set min */
+    stats->max_us = data.max_us;                                                 /* set max */
+    stats->avg_us = (uint32_t)(data.sum_us / data.count);                        /* set average */
+    rank = data.count - data.count / 100;                                        /* 99th percentile rank */
+    sum = 0;                                                                     /* init 0 */
+    for (i = 0; i < W25QXX_TRACE_LATENCY_BUCKETS; i++)                           /* walk the histogram */
+    {
+        sum += data.hist[i];                                                     /* cumulative count */
+        if (sum >= rank)                                                         /* found */
+        {
+            break;                                                               /* break */
+        }
+    }
+    stats->p99_us = (i < (W25QXX_TRACE_LATENCY_BUCKETS - 1)) ? ((uint32_t)1 << i) : data.max_us; /* bucket bound */
+    if (stats->p99_us > data.max_us)                                             /* not above max */
+    {
+        stats->p99_us = data.max_us;                                             /* set max */
+    }
+
+    return 0;                                                                    /* success return 0 */
+}
+
+/**
+ * @brief      get the number of commands sent with an opcode
+ * @param[in]  *handle points to a w25qxx handle structure
+ * @param[in]  opcode is the command opcode
+ * @param[out] *count points to a count buffer
+ * @return     status code
+ *             - 0 success
+ *             - 2 handle is NULL
+ *             - 4 no trace is attached
+ * @note       may be called from any task
+ */
+uint8_t w25qxx_trace_get_opcode_count(w25qxx_handle_t *handle, uint8_t opcode, uint32_t *count)
+{
+    if (handle == NULL)                                                          /* check handle */
+    {
+        return 2;                                                                /* return error */
+    }
+    if (handle->trace == NULL)                                                   /* check trace */
+    {
+        return 4;                                                                /* return error */
+    }
+
+    *count = handle->trace->opcode_count[opcode];                                /* get count */
+
+    return 0;                                                                    /* success return 0 */
+}
+
+/**
+ * @brief         take the oldest events out of the ring
+ * @param[in]     *handle points to a w25qxx handle structure
+ * @param[out]    *events points to an event buffer
+ * @param[in,out] *num points to the buffer length, set to the events returned
+ * @return        status code
+ *                - 0 success
+ *                - 2 handle is NULL
+ *                - 4 no trace is attached
+ * @note          only one task may read events, reads, programs and erases are recorded
+ */
+uint8_t w25qxx_trace_read_events(w25qxx_handle_t *handle, w25qxx_trace_event_t *events, uint32_t *num)
+{
+    w25qxx_trace_t *trace;
+    uint32_t head;
+    uint32_t tail;
+    uint32_t i;
+
+    if (handle == NULL)                                                          /* check handle */
+    {
+        return 2;                                                                /* return error */
+    }
+    trace = handle->trace;                                                       /* get trace */
+    if (trace == NULL)                                                           /* check trace */
+    {
+        return 4;                                                                /* return error */
+    }
+
+    head = trace->head;                                                          /* get head */
+    tail = trace->tail;                                                          /* get tail */
+    __sync_synchronize();                                                        /* head before events */
+    for (i = 0; (i < *num) && (tail != head); i++)                               /* copy the queued events */
+    {
+        events[i] = trace->ring[tail & (W25QXX_TRACE_EVENTS - 1)];               /* copy event */
+        tail++;                                                                  /* next */
+    }
+    __sync_synchronize();                                                        /* events before tail */
+    trace->tail = tail;                                                          /* release the slots */
+    *num = i;                                                                    /* set num */
+
+    return 0;                                                                    /* success return 0 */
+}
+
+/**
+ * @brief  get the name of a traced operation
+ * @param  op is the traced operation
+ * @return name, "unknown" if op is invalid
+ * @note   none
+ */
+const char *w25qxx_trace_op_name(w25qxx_trace_op_t op)
+{
+    static const char *const names[W25QXX_TRACE_OP_MAX] =
+    {
+        "read", "program", "erase4k", "erase32k", "erase64k", "chiperase", "status",
+    };
+
+    if (op >= W25QXX_TRACE_OP_MAX)                                               /* check op */
+    {
+        return "unknown";                                                        /* unknown */
+    }
+
+    return names[op];                                                            /* return name */
+}
+
+/**
+ * @brief      format the statistics of an operation as one line of text
+ * @param[in]  *handle points to a w25qxx handle structure
+ * @param[in]  op is the traced operation
+ * @param[out] *buf points to a text buffer
+ * @param[in]  size is the buffer size
+ * @return     status code
+ *             - 0 success
+ *             - 2 handle is NULL
+ *             - 4 no trace is attached
+ *             - 5 op is invalid
+ * @note       "<name> n=<count> kib=<kib> polls=<polls> us min/avg/max/p99=<a>/<b>/<c>/<d>",
+ *             for a debug print or an ftp SITE reply
+ */
+uint8_t w25qxx_trace_format(w25qxx_handle_t *handle, w25qxx_trace_op_t op, char *buf, uint32_t size)
+{
+    uint8_t res;
+    w25qxx_trace_stats_t stats;
+
+    res = w25qxx_trace_get_stats(handle, op, &stats);                            /* get stats */
+    if (res != 0)                                                                /* check result */
+    {
+        return res;                                                              /* return error */
+    }
+
+    (void)snprintf(buf, size, "%s n=%lu kib=%lu polls=%lu us min/avg/max/p99=%lu/%lu/%lu/%lu",
+                   w25qxx_trace_op_name(op), (unsigned long)stats.count,
+                   (unsigned long)(stats.bytes / 1024), (unsigned long)stats.polls,
+                   (unsigned long)stats.min_us, (unsigned long)stats.avg_us,
+                   (unsigned long)stats.max_us, (unsigned long)stats.p99_us);    /* format */
+
+    return 0;                                                                    /* success return 0 */
+}
+
 /**
  * @brief      write and read register
  * @param[in]  *handle points to a w25qxx handle structure
@@ -8549,6 +9252,10 @@ uint8_t w25qxx_write_read_reg(w25qxx_handle_t *handle, uint8_t instruction, uint
     {
         return 3;                                                                /* return error */
     }
+    if (handle->blank_map != NULL)                                               /* raw commands may erase or program */
+    {
+        memset(handle->blank_map, 0, ((handle->blank_sectors + 31) / 32) * sizeof(uint32_t));    /* forget blank sectors */
+    }
 
     return a_w25qxx_qspi_write_read(handle, instruction, instruction_line,
                                     address, address_line, address_len,
@@ -196,6 +196,101 @@ typedef enum
     W25QXX_STATUS3_CURRENT_ADDRESS_MODE                  = (1 << 0),        /**< current address mode */
 } w25qxx_status3_t;
 
+/**
+ * @}
+ */
+
+/**
+ * @defgroup w25qxx_trace_driver w25qxx trace driver function
+ * @brief    w25qxx trace driver modules
+ * @ingroup  w25qxx_driver
+ * @{
+ */
+
+/**
+ * @brief w25qxx trace definition, define W25QXX_TRACE as 1 in the project to compile the tracing in
+ */
+#ifndef W25QXX_TRACE
+    #define W25QXX_TRACE                     0         /**< 0 leaves no trace code in the driver */
+#endif
+#define W25QXX_TRACE_EVENTS                  64        /**< event ring size, power of 2 */
+#define W25QXX_TRACE_LATENCY_BUCKETS         32        /**< log2 us buckets, the last one is open ended */
+
+/**
+ * @brief w25qxx trace operation enumeration definition
+ */
+typedef enum
+{
+    W25QXX_TRACE_OP_READ         = 0x00,        /**< read data */
+    W25QXX_TRACE_OP_PROGRAM      = 0x01,        /**< page program, command to ready */
+    W25QXX_TRACE_OP_ERASE_4K     = 0x02,        /**< sector erase, command to ready */
+    W25QXX_TRACE_OP_ERASE_32K    = 0x03,        /**< 32k block erase, command to ready */
+    W25QXX_TRACE_OP_ERASE_64K    = 0x04,        /**< 64k block erase, command to ready */
+    W25QXX_TRACE_OP_CHIP_ERASE   = 0x05,        /**< chip erase, command to ready */
+    W25QXX_TRACE_OP_STATUS       = 0x06,        /**< status register read */
+    W25QXX_TRACE_OP_MAX          = 0x07,        /**< number of operations */
+} w25qxx_trace_op_t;
+
+/**
+ * @brief w25qxx trace event structure definition
+ */
+typedef struct w25qxx_trace_event_s
+{
+    uint32_t time_us;           /**< command time */
+    uint32_t addr;              /**< flash address */
+    uint32_t len;               /**< data bytes */
+    uint32_t latency_us;        /**< command to data or ready */
+    uint16_t polls;             /**< busy polls */
+    uint8_t opcode;             /**< command opcode */
+    uint8_t op;                 /**< w25qxx_trace_op_t */
+} w25qxx_trace_event_t;
+
+/**
+ * @brief w25qxx trace statistics structure definition
+ */
+typedef struct w25qxx_trace_stats_s
+{
+    uint32_t count;             /**< operations */
+    uint64_t bytes;             /**< data bytes */
+    uint32_t polls;             /**< busy polls */
+    uint32_t min_us;            /**< min latency */
+    uint32_t avg_us;            /**< average latency */
+    uint32_t max_us;            /**< max latency */
+    uint32_t p99_us;            /**< 99th percentile latency, upper bound of its bucket */
+} w25qxx_trace_stats_t;
+
+/**
+ * @brief w25qxx trace operation data structure definition
+ */
+typedef struct w25qxx_trace_op_data_s
+{
+    uint32_t count;                                     /**< operations */
+    uint64_t bytes;                                     /**< data bytes */
+    uint32_t polls;                                     /**< busy polls */
+    uint64_t sum_us;                                    /**< latency sum */
+    uint32_t min_us;                                    /**< min latency */
+    uint32_t max_us;                                    /**< max latency */
+    uint32_t hist[W25QXX_TRACE_LATENCY_BUCKETS];        /**< bucket n counts latencies up to 2^n us */
+} w25qxx_trace_op_data_t;
+
+/**
+ * @brief w25qxx trace structure definition
+ * @note  written by the task driving the chip, read by any other task without a lock:
+ *        op[] is guarded by the seq counter, ring[] is a single reader ring
+ */
+typedef struct w25qxx_trace_s
+{
+    uint32_t (*timestamp_us)(void);                     /**< free running us clock */
+    volatile uint32_t seq;                              /**< odd while op[] is updated */
+    w25qxx_trace_op_data_t op[W25QXX_TRACE_OP_MAX];     /**< per operation statistics */
+    uint32_t opcode_count[256];                         /**< commands sent per opcode */
+    volatile uint32_t head;                             /**< events written */
+    volatile uint32_t tail;                             /**< events read */
+    uint32_t dropped;                                   /**< events lost to a full ring */
+    w25qxx_trace_event_t ring[W25QXX_TRACE_EVENTS];     /**< event ring */
+    w25qxx_trace_event_t pending;                       /**< program or erase waiting for ready */
+} w25qxx_trace_t;
+
 /**
  * @}
  */
@@ -219,6 +314,7 @@ typedef struct w25qxx_handle_s
                                    uint8_t *out_buf, uint32_t out_len, uint8_t data_line);             /**< point to a spi_qspi_write_read function address */
     void (*delay_ms)(void* descr, uint32_t ms);                                                        /**< point to a delay_ms function address */
     void (*delay_us)(void* descr, uint32_t us);                                                        /**< point to a delay_us function address */
+    void (*wait_ready)(void* descr, uint32_t us);                                                      /**< point to an optional wait_ready function address */
     void (*debug_print)(void* descr, const char *const fmt, ...);                                      /**< point to a debug_print function address */
     uint8_t inited;                                                                                    /**< inited flag */
     uint16_t type;                                                                                     /**< chip type */
@@ -227,11 +323,32 @@ typedef struct w25qxx_handle_s
     uint8_t dummy;                                                                                     /**< dummy */
     uint8_t dual_quad_spi_enable;                                                                      /**< dual spi and quad spi enable */
     uint8_t spi_qspi;                                                                                  /**< spi qspi interface type */
+    uint8_t read_command;                                                                              /**< read command of w25qxx_read, 0 if not selected */
     uint8_t buf[256 + 6];                                                                              /**< inner buffer */
     uint8_t buf_4k[4096 + 1];                                                                          /**< 4k inner buffer */
+    uint8_t buf_pipe[256 + 5];                                                                         /**< page program frame of the batched program */
+    uint16_t ext_addr;                                                                                 /**< extended address register written by the batched program */
+    uint32_t program_us;                                                                               /**< page program time learned by the batched program */
+    w25qxx_trace_t *trace;                                                                             /**< trace data, NULL if not traced */
+    uint32_t write_page_cnt;                                                                           /**< page programs of the last write */
+    uint32_t write_erase_cnt;                                                                          /**< sector erases of the last write */
+    uint32_t *blank_map;                                                                               /**< known blank 4k sectors, one bit each */
+    uint32_t blank_sectors;                                                                            /**< sectors covered by the blank map */
+    uint32_t blank_hits;                                                                               /**< erases skipped */
+    uint32_t blank_misses;                                                                             /**< erases sent to the chip */
     void* extra;                                                                                       /**< custom descriptor */
 } w25qxx_handle_t;
 
+/**
+ * @brief w25qxx program segment structure definition
+ */
+typedef struct w25qxx_program_segment_s
+{
+    uint32_t addr;        /**< programming address */
+    uint8_t *data;        /**< data buffer */
+    uint32_t len;         /**< data length */
+} w25qxx_program_segment_t;
+
 /**
  * @brief w25qxx information structure definition
  */
@@ -307,6 +424,14 @@ typedef struct w25qxx_info_s
  */
 #define DRIVER_W25QXX_LINK_DELAY_US(HANDLE, FUC)                  (HANDLE)->delay_us = FUC
 
+/**
+ * @brief     link wait_ready function
+ * @param[in] HANDLE points to a w25qxx handle structure
+ * @param[in] FUC points to a wait_ready function address
+ * @note      optional, used between busy polls instead of delay_ms/delay_us
+ */
+#define DRIVER_W25QXX_LINK_WAIT_READY(HANDLE, FUC)                (HANDLE)->wait_ready = FUC
+
 /**
  * @brief     link debug_print function
  * @param[in] HANDLE points to a w25qxx handle structure
@@ -486,10 +611,24 @@ uint8_t w25qxx_deinit(w25qxx_handle_t *handle);
  *             - 2 handle is NULL
  *             - 3 handle is not initialized
  *             - 4 address mode is invalid
- * @note       none
+ * @note       in the dual quad spi mode the fastest read command the chip allows is used,
+ *             see w25qxx_get_read_command
  */
 uint8_t w25qxx_read(w25qxx_handle_t *handle, uint32_t addr, uint8_t *data, uint32_t len);
 
+/**
+ * @brief      get the read command used by w25qxx_read
+ * @param[in]  *handle points to a w25qxx handle structure
+ * @param[out] *command points to a command buffer
+ * @return     status code
+ *             - 0 success
+ *             - 1 get read command failed
+ *             - 2 handle is NULL
+ *             - 3 handle is not initialized
+ * @note       0xEB when the qe bit is set, 0xBB otherwise in the dual quad spi mode, 0x0B in other modes
+ */
+uint8_t w25qxx_get_read_command(w25qxx_handle_t *handle, uint8_t *command);
+
 /**
  * @brief     write data
  * @param[in] *handle points to a w25qxx handle structure
@@ -503,10 +642,84 @@ uint8_t w25qxx_read(w25qxx_handle_t *handle, uint32_t addr, uint8_t *data, uint3
  *            - 3 handle is not initialized
  *            - 4 read failed
  *            - 5 erase sector failed
- * @note      none
+ * @note      a sector is erased only when a bit has to go from 0 to 1,
+ *            otherwise only the changed pages are programmed
  */
 uint8_t w25qxx_write(w25qxx_handle_t *handle, uint32_t addr, uint8_t *data, uint32_t len);
 
+/**
+ * @brief     program a list of segments
+ * @param[in] *handle points to a w25qxx handle structure
+ * @param[in] *seg points to a segment list
+ * @param[in] count is the segment number
+ * @return    status code
+ *            - 0 success
+ *            - 1 page program failed
+ *            - 2 handle is NULL
+ *            - 3 handle is not initialized
+ *            - 4 segment is invalid
+ *            - 5 address mode is invalid
+ *            - 6 page program timeout
+ * @note      the target ranges must be erased, segments are programmed in list order and split at
+ *            page boundaries, the next page is staged while the previous one programs
+ */
+uint8_t w25qxx_program_segments(w25qxx_handle_t *handle, const w25qxx_program_segment_t *seg, uint32_t count);
+
+/**
+ * @brief      get the flash operations issued by the last write
+ * @param[in]  *handle points to a w25qxx handle structure
+ * @param[out] *page_programs points to a page program number buffer
+ * @param[out] *sector_erases points to a sector erase number buffer
+ * @return     status code
+ *             - 0 success
+ *             - 2 handle is NULL
+ *             - 3 handle is not initialized
+ * @note       none
+ */
+uint8_t w25qxx_get_write_statistics(w25qxx_handle_t *handle, uint32_t *page_programs, uint32_t *sector_erases);
+
+/**
+ * @brief     attach the blank sector map
+ * @param[in] *handle points to a w25qxx handle structure
+ * @param[in] *map points to a map buffer of (sectors + 31) / 32 words, NULL disables the map
+ * @param[in] sectors is the number of 4k sectors tracked from address 0
+ * @return    status code
+ *            - 0 success
+ *            - 2 handle is NULL
+ * @note      the map starts empty, a sector is marked blank by an erase or by w25qxx_blank_check,
+ *            a marked sector is not erased again and w25qxx_write does not read it back
+ */
+uint8_t w25qxx_set_blank_map(w25qxx_handle_t *handle, uint32_t *map, uint32_t sectors);
+
+/**
+ * @brief      check if a 4k sector is blank
+ * @param[in]  *handle points to a w25qxx handle structure
+ * @param[in]  addr is the sector address
+ * @param[out] *blank points to a bool value buffer
+ * @return     status code
+ *             - 0 success
+ *             - 1 read failed
+ *             - 2 handle is NULL
+ *             - 3 handle is not initialized
+ *             - 4 addr is invalid
+ * @note       a sector already known blank is not read, a blank result is stored in the map,
+ *             reading stops at the first programmed word
+ */
+uint8_t w25qxx_blank_check(w25qxx_handle_t *handle, uint32_t addr, w25qxx_bool_t *blank);
+
+/**
+ * @brief      get the blank map erase statistics
+ * @param[in]  *handle points to a w25qxx handle structure
+ * @param[out] *hits points to a buffer of erases skipped because the sectors were known blank
+ * @param[out] *misses points to a buffer of erases sent to the chip
+ * @return     status code
+ *             - 0 success
+ *             - 2 handle is NULL
+ *             - 3 handle is not initialized
+ * @note       counted since w25qxx_set_blank_map, only while a map is attached
+ */
+uint8_t w25qxx_get_blank_statistics(w25qxx_handle_t *handle, uint32_t *hits, uint32_t *misses);
+
 /**
  * @brief      read only in the spi interface
  * @param[in]  *handle points to a w25qxx handle structure
@@ -1210,6 +1423,93 @@ uint8_t w25qxx_read_block_lock(w25qxx_handle_t *handle, uint32_t addr, uint8_t *
  */
 uint8_t w25qxx_set_burst_with_wrap(w25qxx_handle_t *handle, w25qxx_burst_wrap_t wrap);
 
+/**
+ * @}
+ */
+
+/**
+ * @addtogroup w25qxx_trace_driver
+ * @{
+ */
+
+/**
+ * @brief     attach the trace data
+ * @param[in] *handle points to a w25qxx handle structure
+ * @param[in] *trace points to a trace structure, NULL stops tracing
+ * @param[in] *timestamp_us points to a free running us clock
+ * @return    status code
+ *            - 0 success
+ *            - 2 handle is NULL
+ *            - 4 trace is disabled
+ *            - 5 timestamp_us is NULL
+ * @note      the trace structure is cleared, tracing is compiled in with W25QXX_TRACE
+ */
+uint8_t w25qxx_set_trace(w25qxx_handle_t *handle, w25qxx_trace_t *trace, uint32_t (*timestamp_us)(void));
+
+/**
+ * @brief      get the statistics of an operation
+ * @param[in]  *handle points to a w25qxx handle structure
+ * @param[in]  op is the traced operation
+ * @param[out] *stats points to a statistics buffer
+ * @return     status code
+ *             - 0 success
+ *             - 2 handle is NULL
+ *             - 4 no trace is attached
+ *             - 5 op is invalid
+ * @note       may be called from any task
+ */
+uint8_t w25qxx_trace_get_stats(w25qxx_handle_t *handle, w25qxx_trace_op_t op, w25qxx_trace_stats_t *stats);
+
+/**
+ * @brief      get the number of commands sent with an opcode
+ * @param[in]  *handle points to a w25qxx handle structure
+ * @param[in]  opcode is the command opcode
+ * @param[out] *count points to a count buffer
+ * @return     status code
+ *             - 0 success
+ *             - 2 handle is NULL
+ *             - 4 no trace is attached
+ * @note       may be called from any task
+ */
+uint8_t w25qxx_trace_get_opcode_count(w25qxx_handle_t *handle, uint8_t opcode, uint32_t *count);
+
+/**
+ * @brief         take the oldest events out of the ring
+ * @param[in]     *handle points to a w25qxx handle structure
+ * @param[out]    *events points to an event buffer
+ * @param[in,out] *num points to the buffer length, set to the events returned
+ * @return        status code
+ *                - 0 success
+ *                - 2 handle is NULL
+ *                - 4 no trace is attached
+ * @note          only one task may read events, reads, programs and erases are recorded
+ */
+uint8_t w25qxx_trace_read_events(w25qxx_handle_t *handle, w25qxx_trace_event_t *events, uint32_t *num);
+
+/**
+ * @brief  get the name of a traced operation
+ * @param  op is the traced operation
+ * @return name, "unknown" if op is invalid
+ * @note   none
+ */
+const char *w25qxx_trace_op_name(w25qxx_trace_op_t op);
+
+/**
+ * @brief      format the statistics of an operation as one line of text
+ * @param[in]  *handle points to a w25qxx handle structure
+ * @param[in]  op is the traced operation
+ * @param[out] *buf points to a text buffer
+ * @param[in]  size is the buffer size
+ * @return     status code
+ *             - 0 success
+ *             - 2 handle is NULL
+ *             - 4 no trace is attached
+ *             - 5 op is invalid
+ * @note       "<name> n=<count> kib=<kib> polls=<polls> us min/avg/max/p99=<a>/<b>/<c>/<d>",
+ *             for a debug print or an ftp SITE reply
+ */
+uint8_t w25qxx_trace_format(w25qxx_handle_t *handle, w25qxx_trace_op_t op, char *buf, uint32_t size);
+
 /**
  * @}
  */
@@ -116,6 +116,21 @@ void w25qxx_interface_delay_ms(void* descr, uint32_t ms);
  */
 void w25qxx_interface_delay_us(void* descr, uint32_t us);
 
+/**
+ * @brief     interface wait for a busy flash operation
+ * @param[in] descr - custom descriptor
+ * @param[in] us
+ * @note      blocks the calling task when the wait spans at least one rtos tick
+ */
+void w25qxx_interface_wait_ready(void* descr, uint32_t us);
+
+/**
+ * @brief  interface free running microsecond timestamp
+ * @return timestamp in us, wraps at 2^32
+ * @note   none
+ */
+uint32_t w25qxx_interface_timestamp_us(void);
+
 /**
  * @brief     interface print format data
  * @param[in] descr - custom descriptor
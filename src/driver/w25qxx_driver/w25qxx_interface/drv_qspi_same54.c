@@ -0,0 +1,231 @@
+#include "drv_qspi_same54.h"
+#include "definitions.h"
+#include <string.h>
+
+
+#define QSPI_INSTREND_TIMEOUT   1000000     // polls of INTFLAG before a frame is treated as hung
+
+/**
+ * @brief  qspi pins init
+ * @note   PA08..PA11 and PB10, PB11 to peripheral function H
+ */
+static void a_qspi_pins_init(void)
+{
+    PORT_REGS->GROUP[0].PORT_PINCFG[8] = PORT_PINCFG_PMUXEN_Msk;
+    PORT_REGS->GROUP[0].PORT_PINCFG[9] = PORT_PINCFG_PMUXEN_Msk;
+    PORT_REGS->GROUP[0].PORT_PINCFG[10] = PORT_PINCFG_PMUXEN_Msk;
+    PORT_REGS->GROUP[0].PORT_PINCFG[11] = PORT_PINCFG_PMUXEN_Msk;
+    PORT_REGS->GROUP[0].PORT_PMUX[4] = PORT_PMUX_PMUXE_H | PORT_PMUX_PMUXO_H;
+    PORT_REGS->GROUP[0].PORT_PMUX[5] = PORT_PMUX_PMUXE_H | PORT_PMUX_PMUXO_H;
+
+    PORT_REGS->GROUP[1].PORT_PINCFG[10] = PORT_PINCFG_PMUXEN_Msk;
+    PORT_REGS->GROUP[1].PORT_PINCFG[11] = PORT_PINCFG_PMUXEN_Msk;
+    PORT_REGS->GROUP[1].PORT_PMUX[5] = PORT_PMUX_PMUXE_H | PORT_PMUX_PMUXO_H;
+}
+
+/**
+ * @brief      map the phy lines of a frame to the INSTRFRAME width
+ * @param[out] *width points to a width buffer
+ * @return     status code
+ *             - 0 success
+ *             - 1 the line combination is not supported by the peripheral
+ * @note       a line count of 0 means the phase is absent
+ */
+static uint8_t a_qspi_width(uint8_t instruction_line, uint8_t address_line, uint8_t alternate_line,
+                            uint8_t data_line, uint32_t *width)
+{
+    uint8_t addr_line = (address_line != 0) ? address_line : alternate_line;
+
+    if ((address_line != 0) && (alternate_line != 0) && (address_line != alternate_line))
+    {
+        return 1;
+    }
+
+    if (instruction_line == 4)
+    {
+        if (((addr_line != 0) && (addr_line != 4)) || ((data_line != 0) && (data_line != 4)))
+        {
+            return 1;
+        }
+        *width = QSPI_INSTRFRAME_WIDTH_QUAD_CMD;
+    }
+    else if (instruction_line == 2)
+    {
+        if (((addr_line != 0) && (addr_line != 2)) || ((data_line != 0) && (data_line != 2)))
+        {
+            return 1;
+        }
+        *width = QSPI_INSTRFRAME_WIDTH_DUAL_CMD;
+    }
+    else if (instruction_line == 1)
+    {
+        if (addr_line <= 1)
+        {
+            if (data_line <= 1)
+            {
+                *width = QSPI_INSTRFRAME_WIDTH_SINGLE_BIT_SPI;
+            }
+            else if (data_line == 2)
+            {
+                *width = QSPI_INSTRFRAME_WIDTH_DUAL_OUTPUT;
+            }
+            else if (data_line == 4)
+            {
+                *width = QSPI_INSTRFRAME_WIDTH_QUAD_OUTPUT;
+            }
+            else
+            {
+                return 1;
+            }
+        }
+        else if ((addr_line == 2) && ((data_line == 0) || (data_line == 2)))
+        {
+            *width = QSPI_INSTRFRAME_WIDTH_DUAL_IO;
+        }
+        else if ((addr_line == 4) && ((data_line == 0) || (data_line == 4)))
+        {
+            *width = QSPI_INSTRFRAME_WIDTH_QUAD_IO;
+        }
+        else
+        {
+            return 1;
+        }
+    }
+    else
+    {
+        return 1;
+    }
+
+    return 0;
+}
+
+/**
+ * @brief  copy the data phase out of the qspi memory window
+ * @note   word accesses for the aligned bulk keep the bus busy with fewer AHB beats
+ */
+static void a_qspi_read_window(uint8_t *out_buf, uint32_t out_len)
+{
+    volatile uint8_t *window = (volatile uint8_t *)QSPI_ADDR;
+    uint32_t i = 0;
+
+    if (((uintptr_t)out_buf & 0x3) == 0)
+    {
+        volatile uint32_t *window32 = (volatile uint32_t *)QSPI_ADDR;
+
+        for (; (i + 4) <= out_len; i += 4)
+        {
+            uint32_t word = window32[i / 4];
+            memcpy(&out_buf[i], &word, 4);
+        }
+    }
+    for (; i < out_len; i++)
+    {
+        out_buf[i] = window[i];
+    }
+}
+
+uint8_t qspi_init(void *descr)
+{
+    (void)descr;
+
+    MCLK_REGS->MCLK_AHBMASK |= MCLK_AHBMASK_QSPI_Msk;
+    MCLK_REGS->MCLK_APBCMASK |= MCLK_APBCMASK_QSPI_Msk;
+
+    a_qspi_pins_init();
+
+    QSPI_REGS->QSPI_CTRLA = QSPI_CTRLA_SWRST_Msk;
+    QSPI_REGS->QSPI_CTRLB = QSPI_CTRLB_MODE_MEMORY | QSPI_CTRLB_CSMODE_LASTXFER | QSPI_CTRLB_DATALEN_8BITS;
+    // SCK = CPU_CLOCK_FREQUENCY / (BAUD + 1), rounded so it never exceeds QSPI_BAUD_RATE_HZ; mode 0: CPOL = CPHA = 0
+    QSPI_REGS->QSPI_BAUD = QSPI_BAUD_BAUD(((CPU_CLOCK_FREQUENCY + QSPI_BAUD_RATE_HZ - 1) / QSPI_BAUD_RATE_HZ) - 1);
+    QSPI_REGS->QSPI_CTRLA = QSPI_CTRLA_ENABLE_Msk;
+
+    return 0;
+}
+
+uint8_t qspi_deinit(void *descr)
+{
+    (void)descr;
+
+    QSPI_REGS->QSPI_CTRLA = 0;
+
+    return 0;
+}
+
+uint8_t qspi_write_read(void *descr, uint8_t instruction, uint8_t instruction_line,
+                        uint32_t address, uint8_t address_line, uint8_t address_len,
+                        uint32_t alternate, uint8_t alternate_line, uint8_t alternate_len,
+                        uint8_t dummy, uint8_t *in_buf, uint32_t in_len,
+                        uint8_t *out_buf, uint32_t out_len, uint8_t data_line)
+{
+    (void)descr;
+
+    uint32_t frame;
+    uint32_t timeout = QSPI_INSTREND_TIMEOUT;
+
+    if ((in_len != 0) && (out_len != 0))
+    {
+        return 1;   // serial memory mode has a single data phase
+    }
+    if ((alternate_len > 1) || (dummy > 31) || ((address_len != 0) && (address_len != 3) && (address_len != 4)))
+    {
+        return 1;
+    }
+    if (a_qspi_width(instruction_line, (address_len != 0) ? address_line : 0,
+                     (alternate_len != 0) ? alternate_line : 0,
+                     ((in_len != 0) || (out_len != 0)) ? data_line : 0, &frame) != 0)
+    {
+        return 1;
+    }
+
+    frame |= QSPI_INSTRFRAME_INSTREN_Msk | QSPI_INSTRFRAME_DUMMYLEN(dummy);
+    if (address_len != 0)
+    {
+        frame |= QSPI_INSTRFRAME_ADDREN_Msk;
+        frame |= (address_len == 4) ? QSPI_INSTRFRAME_ADDRLEN_32BITS : QSPI_INSTRFRAME_ADDRLEN_24BITS;
+    }
+    if (alternate_len != 0)
+    {
+        frame |= QSPI_INSTRFRAME_OPTCODEEN_Msk | QSPI_INSTRFRAME_OPTCODELEN_8BITS;
+    }
+    if (out_len != 0)
+    {
+        frame |= QSPI_INSTRFRAME_DATAEN_Msk | QSPI_INSTRFRAME_TFRTYPE_READ;
+    }
+    else if (in_len != 0)
+    {
+        frame |= QSPI_INSTRFRAME_DATAEN_Msk | QSPI_INSTRFRAME_TFRTYPE_WRITE;
+    }
+
+    QSPI_REGS->QSPI_INSTRADDR = address;
+    QSPI_REGS->QSPI_INSTRCTRL = QSPI_INSTRCTRL_INSTR(instruction) | QSPI_INSTRCTRL_OPTCODE(alternate);
+    QSPI_REGS->QSPI_INSTRFRAME = frame;
+    (void)QSPI_REGS->QSPI_INSTRFRAME;   // synchronize the frame before touching the memory window
+
+    if (out_len != 0)
+    {
+        a_qspi_read_window(out_buf, out_len);
+    }
+    else if (in_len != 0)
+    {
+        volatile uint8_t *window = (volatile uint8_t *)QSPI_ADDR;
+        for (uint32_t i = 0; i < in_len; i++)
+        {
+            window[i] = in_buf[i];
+        }
+    }
+
+    __DSB();
+    __ISB();
+    QSPI_REGS->QSPI_CTRLA = QSPI_CTRLA_ENABLE_Msk | QSPI_CTRLA_LASTXFER_Msk;
+
+    while ((QSPI_REGS->QSPI_INTFLAG & QSPI_INTFLAG_INSTREND_Msk) == 0)
+    {
+        if (--timeout == 0)
+        {
+            return 1;
+        }
+    }
+    QSPI_REGS->QSPI_INTFLAG = QSPI_INTFLAG_INSTREND_Msk;
+
+    return 0;
+}
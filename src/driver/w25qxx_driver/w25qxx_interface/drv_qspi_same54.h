@@ -0,0 +1,68 @@
+#ifndef DRV_QSPI_SAME54_H
+#define DRV_QSPI_SAME54_H
+
+#include "stddef.h"
+#include "stdint.h"
+#include "w25qxx_custom_descriptor.h"
+
+#define QSPI_BAUD_RATE_HZ    30000000
+
+#ifdef __cplusplus
+ extern "C" {
+#endif
+
+/**
+ * @brief     qspi bus init
+ * @param[in] *descr custom descriptor
+ * @return    status code
+ *            - 0 success
+ *            - 1 init failed
+ * @note      SCK is PB10, CS is PB11, DATA0..DATA3 are PA08..PA11
+ */
+uint8_t qspi_init(void *descr);
+
+/**
+ * @brief  qspi bus deinit
+ * @param[in] *descr custom descriptor
+ * @return status code
+ *         - 0 success
+ *         - 1 deinit failed
+ * @note   none
+ */
+uint8_t qspi_deinit(void *descr);
+
+/**
+ * @brief      qspi bus write read
+ * @param[in]  *descr custom descriptor
+ * @param[in]  instruction is the sent instruction
+ * @param[in]  instruction_line is the instruction phy lines
+ * @param[in]  address is the register address
+ * @param[in]  address_line is the address phy lines
+ * @param[in]  address_len is the address length
+ * @param[in]  alternate is the register address
+ * @param[in]  alternate_line is the alternate phy lines
+ * @param[in]  alternate_len is the alternate length
+ * @param[in]  dummy is the dummy cycle
+ * @param[in]  *in_buf points to a input buffer
+ * @param[in]  in_len is the input length
+ * @param[out] *out_buf points to a output buffer
+ * @param[in]  out_len is the output length
+ * @param[in]  data_line is the data phy lines
+ * @return     status code
+ *             - 0 success
+ *             - 1 write read failed
+ * @note       runs the qspi peripheral in the serial memory mode, so a frame either
+ *             writes in_buf or reads out_buf, never both
+ */
+uint8_t qspi_write_read(void *descr, uint8_t instruction, uint8_t instruction_line,
+                        uint32_t address, uint8_t address_line, uint8_t address_len,
+                        uint32_t alternate, uint8_t alternate_line, uint8_t alternate_len,
+                        uint8_t dummy, uint8_t *in_buf, uint32_t in_len,
+                        uint8_t *out_buf, uint32_t out_len, uint8_t data_line);
+
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif //DRV_QSPI_SAME54_H
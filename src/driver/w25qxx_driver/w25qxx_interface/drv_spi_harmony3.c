@@ -3,9 +3,22 @@
 #include "definitions.h"
 #include "plib_sercom4_spi_master.h" 
 #include <stdio.h>
+#include <string.h>
+#include "os_port.h"
 
 
-static DRV_HANDLE SPIhandle = { 0 };
+/**
+ * @brief spi bus shared by all flash chips wired to one DRV_SPI instance
+ */
+typedef struct
+{
+    DRV_HANDLE handle;          // valid while openCount > 0
+    uint8_t openCount;          // persistent descriptors sharing the handle
+    bool mutexCreated;
+    OsMutex mutex;              // one CS-framed transaction on the bus at a time
+} SpiBus_s;
+
+static SpiBus_s spiBus[DRV_SPI_INSTANCES_NUMBER];
 
 static DRV_SPI_TRANSFER_SETUP SPIsetup = 
     {
@@ -13,77 +26,141 @@ static DRV_SPI_TRANSFER_SETUP SPIsetup =
         .clockPhase = DRV_SPI_CLOCK_PHASE_VALID_LEADING_EDGE,
         .clockPolarity = DRV_SPI_CLOCK_POLARITY_IDLE_LOW,
         .dataBits = DRV_SPI_DATA_BITS_8,
-        .chipSelect = SYS_PORT_PIN_PB14,
+        .chipSelect = SYS_PORT_PIN_NONE,     // CS is driven by hand from the descriptor, see a_spi_cs_low()
         .csPolarity = DRV_SPI_CS_POLARITY_ACTIVE_LOW,
     };
 
 /**
  * @brief  spi cs init
- * @param[in] *descr custom descriptor
+ * @param[in] *extra custom descriptor
  * @return status code
  *         - 0 success
  * @note   none
  */
-static uint8_t a_spi_cs_init(void *descr)
+static uint8_t a_spi_cs_init(W25qxx_ASF_CustomDescriptor_s *extra)
 {
-    //TODO: check descr for NULL and extract SPI instance here
-    //CS/SS pin is initialized in SYS_Initialyze()
-    //Configure NVM_SPI_SS pin (as output)
-    //PORT_REGS->GROUP[NVM_SPI_GROUP].PORT_DIRSET = NVM_SPI_SS_MASK;
-    //PORT_REGS->GROUP[NVM_SPI_GROUP].PORT_OUTCLR = NVM_SPI_SS_MASK;
+    SYS_PORT_PinSet((SYS_PORT_PIN)extra->chipSelectPin);
+    SYS_PORT_PinOutputEnable((SYS_PORT_PIN)extra->chipSelectPin);
     return 0;
 }
 
-static uint8_t a_spi_cs_low(void *descr)
+static uint8_t a_spi_cs_low(W25qxx_ASF_CustomDescriptor_s *extra)
 {
-    //TODO: check descr for NULL and extract SPI SS pin instance here
-    //PORT_REGS->GROUP[NVM_SPI_GROUP].PORT_OUTCLR = NVM_SPI_SS_MASK;
-    NVM_SPI_SS_Clear();
+    SYS_PORT_PinClear((SYS_PORT_PIN)extra->chipSelectPin);
     return 0;
 }
 
-static uint8_t a_spi_cs_high(void *descr)
+static uint8_t a_spi_cs_high(W25qxx_ASF_CustomDescriptor_s *extra)
 {
-    //TODO: check descr for NULL and extract SPI SS pin instance here
-    //PORT_REGS->GROUP[NVM_SPI_GROUP].PORT_OUTSET = NVM_SPI_SS_MASK;
-    NVM_SPI_SS_Set();
+    SYS_PORT_PinSet((SYS_PORT_PIN)extra->chipSelectPin);
     return 0;
 }
 
+/**
+ * @brief  open a DRV_SPI instance and apply the flash transfer setup
+ * @return opened handle or DRV_HANDLE_INVALID
+ */
+static DRV_HANDLE a_spi_bus_open(uint8_t spiIndex)
+{
+    DRV_HANDLE handle = DRV_SPI_Open((SYS_MODULE_INDEX)spiIndex, DRV_IO_INTENT_EXCLUSIVE);
+    if (DRV_HANDLE_INVALID == handle)
+    {
+        printf("\n\r =========================================== DRV_SPI_Open() Error!\n\r"); // Handle error
+        return DRV_HANDLE_INVALID;      // could not open driver / driver is not initialized 
+    }
+
+    DRV_SPI_TRANSFER_SETUP setup = SPIsetup;
+    if (!DRV_SPI_TransferSetup(handle, &setup))
+    {
+        printf("\n\r =========================================== DRV_SPI_TransferSetup() Error!\n\r"); // Handle error
+        DRV_SPI_Close(handle);
+        return DRV_HANDLE_INVALID;
+    }
+
+    return handle;
+}
+
+static void a_spi_bus_lock(SpiBus_s *bus)
+{
+    if (bus->mutexCreated)
+    {
+        osAcquireMutex(&bus->mutex);
+    }
+}
+
+static void a_spi_bus_unlock(SpiBus_s *bus)
+{
+    if (bus->mutexCreated)
+    {
+        osReleaseMutex(&bus->mutex);
+    }
+}
+
 
 uint8_t spi_init(void *descr)
 {
     // DRV_SPI_Initialize() is called in SYS_Initialize() (main.c)
+    W25qxx_ASF_CustomDescriptor_s *extra = (W25qxx_ASF_CustomDescriptor_s *)descr;
+
+    if ((NULL == extra) || (extra->spiIndex >= DRV_SPI_INSTANCES_NUMBER))
+    {
+        return 1;
+    }
+    SpiBus_s *bus = &spiBus[extra->spiIndex];
 
     // Get the current status of the SPI driver module. Function DRV_SPI_Initialize should have been called before calling this function.
-    SYS_STATUS sys_status = DRV_SPI_Status(sysObj.drvSPI0);
-    if (SYS_STATUS_UNINITIALIZED == sys_status)
+    if (NULL != extra->spiInstance)
     {
-        printf("\n\r =========================================== SPI driver is not ready!\r\n");
+        SYS_STATUS sys_status = DRV_SPI_Status(*(SYS_MODULE_OBJ *)extra->spiInstance);
+        if (SYS_STATUS_UNINITIALIZED == sys_status)
+        {
+            printf("\n\r =========================================== SPI driver is not ready!\r\n");
+        }
     }
 
-    // TODO: extract data from descr here
-    const SYS_MODULE_INDEX SPIindex     = DRV_SPI_INDEX_0;
-    const DRV_IO_INTENT ioIntent        = DRV_IO_INTENT_EXCLUSIVE;
-    
-    // Function DRV_SPI_Initialize must have been called before calling this function.
-    SPIhandle = DRV_SPI_Open(SPIindex, ioIntent); // 
-    if (DRV_HANDLE_INVALID == SPIhandle)
-    {      
-        printf("\n\r =========================================== DRV_SPI_Open() Error!\n\r"); // Handle error
-        return 1;           // could not open driver / driver is not initialized 
+    if (!bus->mutexCreated)
+    {
+        if (!osCreateMutex(&bus->mutex))
+        {
+            return 1;
+        }
+        bus->mutexCreated = true;
     }
-    
-    // DRV_SPI_Open must have been called to obtain a valid opened device handle.
-    if (!DRV_SPI_TransferSetup(SPIhandle, &SPIsetup))
+
+    // Persistent handle is already opened (e.g. repeated w25qxx_init() without deinit)
+    if (0 != extra->spiOpened)
     {
-        printf("\n\r =========================================== DRV_SPI_TransferSetup() Error!\n\r"); // Handle error
-        return 1;           
-    }  
-    
-    DRV_SPI_Close(SPIhandle);   // Close the driver
-    
-    return a_spi_cs_init(descr);
+        return a_spi_cs_init(extra);
+    }
+
+    a_spi_bus_lock(bus);
+    if (0 == bus->openCount)
+    {
+        DRV_HANDLE handle = a_spi_bus_open(extra->spiIndex);
+        if (DRV_HANDLE_INVALID == handle)
+        {
+            a_spi_bus_unlock(bus);
+            return 1;
+        }
+        if (W25QXX_SPI_TRANSFER_MODE_PERSISTENT == extra->spiTransferMode)
+        {
+            bus->handle = handle;
+        }
+        else
+        {
+            DRV_SPI_Close(handle);  // only probe the driver, every transfer opens it again
+        }
+    }
+    if (W25QXX_SPI_TRANSFER_MODE_PERSISTENT == extra->spiTransferMode)
+    {
+        // Keep the driver opened for the whole life of the w25qxx handle, shared with the other chips of the bus
+        bus->openCount++;
+        extra->spiHandle = (uintptr_t)bus->handle;
+        extra->spiOpened = 1;
+    }
+    a_spi_bus_unlock(bus);
+
+    return a_spi_cs_init(extra);
 }
 
 /**
@@ -92,16 +169,85 @@ uint8_t spi_init(void *descr)
  * @return status code
  *         - 0 success
  *         - 1 deinit failed
- * @note   none
+ * @note   the driver is closed when the last chip of the bus releases it
  */
 uint8_t spi_deinit(void *descr)
 {
-// TODO: ...
-    DRV_SPI_Close(SPIhandle);   // Close the driver
-    descr = NULL;
+    W25qxx_ASF_CustomDescriptor_s *extra = (W25qxx_ASF_CustomDescriptor_s *)descr;
+
+    if ((NULL == extra) || (extra->spiIndex >= DRV_SPI_INSTANCES_NUMBER))
+    {
+        return 1;
+    }
+    SpiBus_s *bus = &spiBus[extra->spiIndex];
+
+    if (0 != extra->spiOpened)
+    {
+        a_spi_bus_lock(bus);
+        if ((bus->openCount > 0) && (0 == --bus->openCount))
+        {
+            DRV_SPI_Close(bus->handle);   // Release the persistent handle
+        }
+        a_spi_bus_unlock(bus);
+        extra->spiHandle = (uintptr_t)DRV_HANDLE_INVALID;
+        extra->spiOpened = 0;
+    }
+
     return 0;
 }
 
+/**
+ * @brief      one CS-framed flash command over an opened driver handle
+ * @param[in]  *extra points to a custom descriptor
+ * @param[in]  handle is an opened DRV_SPI handle
+ * @param[in]  *in_buf points to an input buffer
+ * @param[in]  in_len is the input length
+ * @param[out] *out_buf points to an output buffer
+ * @param[in]  out_len is the output length
+ * @return     status code
+ *             - 0 success
+ *             - 1 write read failed
+ * @note       Command+address+data that fit into spiXferBuf are clocked as one
+ *             full-duplex transfer; the first in_len received bytes are discarded.
+ *             Longer reads keep CS asserted across a write and a read transfer.
+ */
+static uint8_t a_spi_transfer(W25qxx_ASF_CustomDescriptor_s *extra, DRV_HANDLE handle, uint8_t *in_buf, uint32_t in_len, uint8_t *out_buf, uint32_t out_len)
+{
+    bool ok = true;
+
+    a_spi_cs_low(extra);        // set SS low
+
+    if (0 == out_len)
+    {
+        ok = DRV_SPI_WriteTransfer(handle, (void *)in_buf, (size_t)in_len);
+    }
+    else if ((in_len + out_len) <= sizeof(extra->spiXferBuf))
+    {
+        memcpy(extra->spiXferBuf, in_buf, in_len);
+        ok = DRV_SPI_WriteReadTransfer(handle, (void *)extra->spiXferBuf, (size_t)in_len,
+                                       (void *)extra->spiXferBuf, (size_t)(in_len + out_len));
+        if (ok)
+        {
+            memcpy(out_buf, &extra->spiXferBuf[in_len], out_len);
+        }
+    }
+    else
+    {
+        if (in_len > 0)
+        {
+            ok = DRV_SPI_WriteTransfer(handle, (void *)in_buf, (size_t)in_len);
+        }
+        if (ok)
+        {
+            ok = DRV_SPI_ReadTransfer(handle, (void *)out_buf, (size_t)out_len);
+        }
+    }
+
+    a_spi_cs_high(extra);       // set SS high
+
+    return ok ? 0 : 1;
+}
+
 /**
  * @brief      spi bus write read
  * @param[in]  *descr custom descriptor
@@ -112,36 +258,39 @@ uint8_t spi_deinit(void *descr)
  * @return     status code
  *             - 0 success
  *             - 1 write read failed
- * @note       none
+ * @note       holds the bus mutex for the whole command, so chips sharing a SERCOM interleave per command
  */
 uint8_t spi_write_read(void *descr, uint8_t *in_buf, uint32_t in_len, uint8_t *out_buf, uint32_t out_len)
 {   
-    // TODO: extract SYS_MODULE_INDEX, etc for SPI here
-    static const SYS_MODULE_INDEX SPIindex = DRV_SPI_INDEX_0;
-    static const DRV_IO_INTENT ioIntent = DRV_IO_INTENT_EXCLUSIVE;
-    
-    
-    SPIhandle = DRV_SPI_Open(SPIindex, ioIntent); // 
-    if (DRV_HANDLE_INVALID == SPIhandle)
+    W25qxx_ASF_CustomDescriptor_s *extra = (W25qxx_ASF_CustomDescriptor_s *)descr;
+
+    if ((NULL == extra) || (extra->spiIndex >= DRV_SPI_INSTANCES_NUMBER))
     {
-        printf("\n\r =========================================== DRV_SPI_Open() Error!\n\r"); // Handle error
-        return 1;           // could not open driver / driver is not initialized 
+        return 1;
     }
-    
-    a_spi_cs_low(descr);        // set SS low
-       
-    if (in_len > 0)
+    SpiBus_s *bus = &spiBus[extra->spiIndex];
+    uint8_t res;
+
+    a_spi_bus_lock(bus);
+
+    if (bus->openCount > 0)
     {
-        DRV_SPI_WriteTransfer(SPIhandle, (void *)in_buf, (size_t)in_len);
+        // some chip keeps the (exclusive) driver opened: borrow its handle
+        res = a_spi_transfer(extra, bus->handle, in_buf, in_len, out_buf, out_len);
     }
-    if (out_len > 0)
+    else
     {
-        DRV_SPI_ReadTransfer(SPIhandle, (void *)out_buf, (size_t)out_len);
+        DRV_HANDLE handle = a_spi_bus_open(extra->spiIndex);
+        if (DRV_HANDLE_INVALID == handle)
+        {
+            a_spi_bus_unlock(bus);
+            return 1;
+        }
+        res = a_spi_transfer(extra, handle, in_buf, in_len, out_buf, out_len);
+        DRV_SPI_Close(handle);  // Close the driver
     }
-    
-    a_spi_cs_high(descr);       // set SS high
-    
-    DRV_SPI_Close(SPIhandle);  // Close the driver
 
-    return 0;
+    a_spi_bus_unlock(bus);
+
+    return res;
 }
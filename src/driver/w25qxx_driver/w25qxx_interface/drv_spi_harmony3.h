@@ -3,7 +3,7 @@
 
 #include "stddef.h"
 #include "stdint.h"
-#include "w25qxx_custom_descriptor.h"   // not used
+#include "w25qxx_custom_descriptor.h"
 #include "drv_spi.h"                    // Harmony3 driver
 
 #define SPI_BAUD_RATE_HZ     1000000
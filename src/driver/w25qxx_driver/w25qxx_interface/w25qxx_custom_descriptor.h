@@ -1,17 +1,48 @@
 #ifndef W25QXX_CUSTOM_DESCRIPTOR_H
 #define W25QXX_CUSTOM_DESCRIPTOR_H
 
-
+#include <stdint.h>
+
+// Size of the full-duplex bounce buffer used by the persistent SPI transport.
+// Command+address+data chains up to this length go out as one WriteRead transfer.
+#ifndef W25QXX_SPI_XFER_BUF_SIZE
+    #define W25QXX_SPI_XFER_BUF_SIZE    (256 + 6)
+#endif
+
+/**
+ * @brief SPI transport modes of the harmony3 interface layer
+ */
+typedef enum
+{
+    W25QXX_SPI_TRANSFER_MODE_OPEN_CLOSE = 0,    // open/close the driver and split write/read on every command
+    W25QXX_SPI_TRANSFER_MODE_PERSISTENT = 1,    // keep the driver open and chain write+read into one transfer
+} W25qxx_SpiTransferMode_e;
+
+/**
+ * @brief physical buses the flash can be wired to
+ */
+typedef enum
+{
+    W25QXX_PHY_SERCOM_SPI = 0,      // single line spi through the harmony3 DRV_SPI
+    W25QXX_PHY_QSPI = 1,            // QSPI peripheral, dual/quad frames and QPI
+} W25qxx_Phy_e;
 
 typedef struct customDescriptor_s
 {
-    void *spiInstance;          //  DRV_HANDLE sysObj.drvSPI0; timer sysObj.sysTime
-    uint8_t chipSelectPin;      // = SPI_0_CS
+    void *spiInstance;          // &sysObj.drvSPI0 for the driver status check, may be NULL
+    uint8_t spiIndex;           // DRV_SPI_INDEX_x of the SERCOM the chip is wired to
+    uint8_t chipSelectPin;      // SYS_PORT_PIN of the chip CS, driven by hand
     void *usartInstance;        // DRV_HANDLE &USART_0
+    uint8_t phy;                // W25qxx_Phy_e
+    
+    uint8_t spiTransferMode;    // W25qxx_SpiTransferMode_e
+    uint8_t spiOpened;          // spiHandle is valid
+    uintptr_t spiHandle;        // DRV_HANDLE kept open in W25QXX_SPI_TRANSFER_MODE_PERSISTENT
+    uint8_t spiXferBuf[W25QXX_SPI_XFER_BUF_SIZE];   // bounce buffer for single-transfer command chains
 
 } W25qxx_ASF_CustomDescriptor_s;
 
 
 
 
-#endif
\ No newline at end of file
+#endif
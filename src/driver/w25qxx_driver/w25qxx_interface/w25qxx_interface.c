@@ -9,7 +9,9 @@
 #include <stdio.h>
 
 #include "drv_spi_harmony3.h"
+#include "drv_qspi_same54.h"
 #include "sys_time.h"
+#include "os_port.h"
 #include "debug.h"
 
 /**
@@ -22,9 +24,14 @@
  */
 uint8_t w25qxx_interface_spi_qspi_init(void* descr)
 {
-    spi_init(descr);
-    
-    return 0;
+    W25qxx_ASF_CustomDescriptor_s *extra = (W25qxx_ASF_CustomDescriptor_s *)descr;
+
+    if ((extra != NULL) && (extra->phy == W25QXX_PHY_QSPI))
+    {
+        return qspi_init(descr);
+    }
+
+    return spi_init(descr);
 }
 
 /**
@@ -37,6 +44,13 @@ uint8_t w25qxx_interface_spi_qspi_init(void* descr)
  */
 uint8_t w25qxx_interface_spi_qspi_deinit(void* descr)
 {
+    W25qxx_ASF_CustomDescriptor_s *extra = (W25qxx_ASF_CustomDescriptor_s *)descr;
+
+    if ((extra != NULL) && (extra->phy == W25QXX_PHY_QSPI))
+    {
+        return qspi_deinit(descr);
+    }
+
     spi_deinit(descr);
     
     return 0;
@@ -62,7 +76,8 @@ uint8_t w25qxx_interface_spi_qspi_deinit(void* descr)
  * @return     status code
  *             - 0 success
  *             - 1 write read failed
- * @note       none
+ * @note       the sercom spi phy only takes raw single line buffers (instruction_line == 0),
+ *             framed dual/quad commands need the qspi phy
  */
 uint8_t w25qxx_interface_spi_qspi_write_read(void *descr, uint8_t instruction, uint8_t instruction_line,
                                              uint32_t address, uint8_t address_line, uint8_t address_len,
@@ -70,6 +85,17 @@ uint8_t w25qxx_interface_spi_qspi_write_read(void *descr, uint8_t instruction, u
                                              uint8_t dummy, uint8_t *in_buf, uint32_t in_len,
                                              uint8_t *out_buf, uint32_t out_len, uint8_t data_line)
 {
+    W25qxx_ASF_CustomDescriptor_s *extra = (W25qxx_ASF_CustomDescriptor_s *)descr;
+
+    if ((extra != NULL) && (extra->phy == W25QXX_PHY_QSPI))
+    {
+        return qspi_write_read(descr, instruction, instruction_line,
+                               address, address_line, address_len,
+                               alternate, alternate_line, alternate_len,
+                               dummy, in_buf, in_len,
+                               out_buf, out_len, data_line);
+    }
+
     if ((instruction_line != 0) || (address_line != 0) || (alternate_line != 0) || (dummy != 0) || (data_line != 1))
     {
         return 1;
@@ -130,6 +156,43 @@ void w25qxx_interface_delay_us(void *descr, uint32_t us)
 #endif
 }
 
+/**
+ * @brief     interface wait for a busy flash operation
+ * @param[in] descr - custom descriptor
+ * @param[in] us
+ * @note      blocks the calling task when the wait spans at least one rtos tick
+ */
+void w25qxx_interface_wait_ready(void *descr, uint32_t us)
+{
+    const uint32_t tick_us = 1000000 / configTICK_RATE_HZ;
+
+    if ((xTaskGetSchedulerState() == taskSCHEDULER_RUNNING) && (us >= tick_us))
+    {
+        osDelayTask(us / 1000);     // let the network stack run while the chip is busy
+    }
+    else if (us >= 1000)
+    {
+        w25qxx_interface_delay_ms(descr, us / 1000);
+    }
+    else
+    {
+        w25qxx_interface_delay_us(descr, us);
+    }
+}
+
+
+/**
+ * @brief  interface free running microsecond timestamp
+ * @return timestamp in us, wraps at 2^32
+ * @note   none
+ */
+uint32_t w25qxx_interface_timestamp_us(void)
+{
+    const uint64_t count = SYS_TIME_Counter64Get();
+    const uint32_t freq = SYS_TIME_FrequencyGet();
+
+    return (uint32_t)(((count / freq) * 1000000ULL) + (((count % freq) * 1000000ULL) / freq));
+}
 
 /**
  * @brief     interface print format data
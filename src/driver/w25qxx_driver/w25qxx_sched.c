@@ -0,0 +1,404 @@
+/**
+ * @file      w25qxx_sched.c
+ * @brief     w25qxx flash i/o scheduler source file
+ * @note      A writer holds write_mutex for its whole operation and bus_mutex while it talks to
+ *            the chip. While the driver waits for the busy flag the scheduler hook hands bus_mutex
+ *            to readers. A reader finding the chip busy suspends the program or erase, reads and
+ *            resumes before it gives bus_mutex back, so the writer never sees the suspended chip.
+ */
+
+#include "w25qxx_sched.h"
+#include <string.h>
+
+#define W25QXX_SCHED_STATUS1_BUSY           0x01        /**< status register 1 busy bit */
+#define W25QXX_SCHED_STATUS2_SUS            0x80        /**< status register 2 suspend bit */
+#define W25QXX_SCHED_NO_SUSPEND_TIMEOUT_US  100000      /**< wait for an operation the chip refused to suspend */
+
+static w25qxx_sched_t *gs_sched[W25QXX_SCHED_MAX_INSTANCES];        /**< hooked chips */
+
+/**
+ * @brief     find the scheduler of a custom descriptor
+ * @param[in] *descr custom descriptor
+ * @return    scheduler or NULL
+ * @note      none
+ */
+static w25qxx_sched_t *a_w25qxx_sched_find(void *descr)
+{
+    uint8_t i;
+
+    for (i = 0; i < W25QXX_SCHED_MAX_INSTANCES; i++)
+    {
+        if ((gs_sched[i] != NULL) && (gs_sched[i]->handle->extra == descr))
+        {
+            return gs_sched[i];
+        }
+    }
+
+    return NULL;
+}
+
+/**
+ * @brief     sleep with the wait_ready of the handle, or its delays
+ * @param[in] *sched points to a w25qxx scheduler structure
+ * @param[in] us is the time to wait
+ * @note      called with bus_mutex released
+ */
+static void a_w25qxx_sched_sleep(w25qxx_sched_t *sched, uint32_t us)
+{
+    void *descr = sched->handle->extra;
+
+    if (sched->wait_ready != NULL)
+    {
+        sched->wait_ready(descr, us);
+    }
+    else if (us >= 1000)
+    {
+        sched->handle->delay_ms(descr, us / 1000);
+    }
+    else
+    {
+        sched->handle->delay_us(descr, us);
+    }
+}
+
+/**
+ * @brief     wait_ready hook of a scheduled handle
+ * @param[in] *descr custom descriptor
+ * @param[in] us is the time to wait
+ * @note      bus_mutex is released for the wait of a program or erase
+ */
+static void a_w25qxx_sched_wait_ready(void *descr, uint32_t us)
+{
+    w25qxx_sched_t *sched = a_w25qxx_sched_find(descr);
+    uint8_t release;
+
+    if (sched == NULL)
+    {
+        return;
+    }
+
+    release = sched->busy;
+    if (release != 0)
+    {
+        osReleaseMutex(&sched->bus_mutex);                                      /* let readers in */
+    }
+    a_w25qxx_sched_sleep(sched, us);
+    if (release != 0)
+    {
+        osAcquireMutex(&sched->bus_mutex);
+    }
+}
+
+/**
+ * @brief      suspend an in-flight program or erase
+ * @param[in]  *sched points to a w25qxx scheduler structure
+ * @param[out] *suspended is set when the chip has to be resumed
+ * @param[out] *too_soon_us is set to the erase run time still owed since the last resume
+ * @return     status code
+ *             - 0 success, the chip accepts reads
+ *             - 1 failed
+ *             - 2 resumed too recently, wait too_soon_us without bus_mutex and retry
+ * @note       called with bus_mutex held
+ */
+static uint8_t a_w25qxx_sched_suspend(w25qxx_sched_t *sched, uint8_t *suspended, uint32_t *too_soon_us)
+{
+    w25qxx_handle_t *handle = sched->handle;
+    uint8_t status;
+    uint32_t elapsed;
+    uint32_t waited;
+
+    *suspended = 0;
+    if (sched->busy == 0)
+    {
+        return 0;
+    }
+    if (w25qxx_get_status1(handle, &status) != 0)
+    {
+        return 1;
+    }
+    if ((status & W25QXX_SCHED_STATUS1_BUSY) == 0)
+    {
+        return 0;                                                               /* already done */
+    }
+
+    if (sched->resumed != 0)                                                    /* let the erase progress */
+    {
+        elapsed = sched->timestamp_us() - sched->resume_us;
+        if (elapsed < W25QXX_SCHED_RESUME_TO_SUSPEND_US)
+        {
+            *too_soon_us = W25QXX_SCHED_RESUME_TO_SUSPEND_US - elapsed;
+
+            return 2;
+        }
+    }
+    if (w25qxx_erase_program_suspend(handle) != 0)
+    {
+        return 1;
+    }
+    handle->delay_us(handle->extra, W25QXX_SCHED_SUSPEND_US);                   /* tSUS */
+    if (w25qxx_get_status2(handle, &status) != 0)
+    {
+        return 1;
+    }
+    if ((status & W25QXX_SCHED_STATUS2_SUS) != 0)
+    {
+        *suspended = 1;
+        sched->stats.suspends++;
+
+        return 0;
+    }
+
+    /* finished meanwhile, or not suspendable (status register write): wait it out */
+    for (waited = 0; waited < W25QXX_SCHED_NO_SUSPEND_TIMEOUT_US; waited += W25QXX_SCHED_SUSPEND_US)
+    {
+        if (w25qxx_get_status1(handle, &status) != 0)
+        {
+            return 1;
+        }
+        if ((status & W25QXX_SCHED_STATUS1_BUSY) == 0)
+        {
+            return 0;
+        }
+        handle->delay_us(handle->extra, W25QXX_SCHED_SUSPEND_US);
+    }
+
+    return 1;
+}
+
+/**
+ * @brief     add a read latency to the statistics
+ * @param[in] *sched points to a w25qxx scheduler structure
+ * @param[in] us is the latency
+ * @note      called with bus_mutex held
+ */
+static void a_w25qxx_sched_record(w25qxx_sched_t *sched, uint32_t us)
+{
+    uint8_t bucket = 0;
+
+    while ((bucket < (W25QXX_SCHED_LATENCY_BUCKETS - 1)) && ((1UL << bucket) < us))
+    {
+        bucket++;
+    }
+    sched->stats.read_hist[bucket]++;
+    sched->stats.reads++;
+    if (us > sched->stats.read_max_us)
+    {
+        sched->stats.read_max_us = us;
+    }
+}
+
+static void a_w25qxx_sched_writer_enter(w25qxx_sched_t *sched)
+{
+    osAcquireMutex(&sched->write_mutex);
+    osAcquireMutex(&sched->bus_mutex);
+    sched->busy = 1;
+}
+
+static void a_w25qxx_sched_writer_leave(w25qxx_sched_t *sched)
+{
+    sched->busy = 0;
+    sched->resumed = 0;
+    osReleaseMutex(&sched->bus_mutex);
+    osReleaseMutex(&sched->write_mutex);
+}
+
+uint8_t w25qxx_sched_init(w25qxx_sched_t *sched, w25qxx_handle_t *handle, uint32_t (*timestamp_us)(void))
+{
+    uint8_t i;
+    uint8_t slot = W25QXX_SCHED_MAX_INSTANCES;
+
+    if ((sched == NULL) || (handle == NULL) || (timestamp_us == NULL))
+    {
+        return 2;
+    }
+    for (i = 0; i < W25QXX_SCHED_MAX_INSTANCES; i++)
+    {
+        if (gs_sched[i] == sched)
+        {
+            slot = i;
+            break;
+        }
+        if ((gs_sched[i] == NULL) && (slot == W25QXX_SCHED_MAX_INSTANCES))
+        {
+            slot = i;
+        }
+    }
+    if (slot == W25QXX_SCHED_MAX_INSTANCES)
+    {
+        return 1;
+    }
+    if (sched->mutex_created == 0)
+    {
+        if (!osCreateMutex(&sched->bus_mutex))
+        {
+            return 3;
+        }
+        if (!osCreateMutex(&sched->write_mutex))
+        {
+            osDeleteMutex(&sched->bus_mutex);
+
+            return 3;
+        }
+        sched->mutex_created = 1;
+    }
+
+    sched->handle = handle;
+    sched->timestamp_us = timestamp_us;
+    if (handle->wait_ready != a_w25qxx_sched_wait_ready)                        /* not hooked yet */
+    {
+        sched->wait_ready = handle->wait_ready;
+        handle->wait_ready = a_w25qxx_sched_wait_ready;
+    }
+    sched->busy = 0;
+    sched->resumed = 0;
+    gs_sched[slot] = sched;
+
+    return 0;
+}
+
+uint8_t w25qxx_sched_read(w25qxx_sched_t *sched, uint32_t addr, uint8_t *data, uint32_t len)
+{
+    uint8_t res;
+    uint8_t suspended;
+    uint32_t too_soon_us;
+    uint32_t start = sched->timestamp_us();
+
+    osAcquireMutex(&sched->bus_mutex);
+
+    while ((res = a_w25qxx_sched_suspend(sched, &suspended, &too_soon_us)) == 2)
+    {
+        osReleaseMutex(&sched->bus_mutex);                                      /* the writer may finish meanwhile */
+        a_w25qxx_sched_sleep(sched, too_soon_us);
+        osAcquireMutex(&sched->bus_mutex);
+    }
+    res = (res == 0) ? 0 : 4;
+    if (res == 0)
+    {
+        res = (w25qxx_read(sched->handle, addr, data, len) == 0) ? 0 : 1;
+    }
+    if (suspended != 0)
+    {
+        if (w25qxx_erase_program_resume(sched->handle) != 0)
+        {
+            res = 4;
+        }
+        sched->resume_us = sched->timestamp_us();
+        sched->resumed = 1;
+    }
+    a_w25qxx_sched_record(sched, sched->timestamp_us() - start);
+
+    osReleaseMutex(&sched->bus_mutex);
+
+    return res;
+}
+
+uint8_t w25qxx_sched_write(w25qxx_sched_t *sched, uint32_t addr, uint8_t *data, uint32_t len)
+{
+    uint8_t res;
+
+    a_w25qxx_sched_writer_enter(sched);
+    res = w25qxx_write(sched->handle, addr, data, len);
+    a_w25qxx_sched_writer_leave(sched);
+
+    return res;
+}
+
+uint8_t w25qxx_sched_page_program(w25qxx_sched_t *sched, uint32_t addr, uint8_t *data, uint16_t len)
+{
+    uint8_t res;
+
+    a_w25qxx_sched_writer_enter(sched);
+    res = w25qxx_page_program(sched->handle, addr, data, len);
+    a_w25qxx_sched_writer_leave(sched);
+
+    return res;
+}
+
+uint8_t w25qxx_sched_program_segments(w25qxx_sched_t *sched, const w25qxx_program_segment_t *seg, uint32_t count)
+{
+    uint8_t res;
+
+    a_w25qxx_sched_writer_enter(sched);
+    res = w25qxx_program_segments(sched->handle, seg, count);
+    a_w25qxx_sched_writer_leave(sched);
+
+    return res;
+}
+
+uint8_t w25qxx_sched_sector_erase_4k(w25qxx_sched_t *sched, uint32_t addr)
+{
+    uint8_t res;
+
+    a_w25qxx_sched_writer_enter(sched);
+    res = w25qxx_sector_erase_4k(sched->handle, addr);
+    a_w25qxx_sched_writer_leave(sched);
+
+    return res;
+}
+
+uint8_t w25qxx_sched_block_erase_32k(w25qxx_sched_t *sched, uint32_t addr)
+{
+    uint8_t res;
+
+    a_w25qxx_sched_writer_enter(sched);
+    res = w25qxx_block_erase_32k(sched->handle, addr);
+    a_w25qxx_sched_writer_leave(sched);
+
+    return res;
+}
+
+uint8_t w25qxx_sched_block_erase_64k(w25qxx_sched_t *sched, uint32_t addr)
+{
+    uint8_t res;
+
+    a_w25qxx_sched_writer_enter(sched);
+    res = w25qxx_block_erase_64k(sched->handle, addr);
+    a_w25qxx_sched_writer_leave(sched);
+
+    return res;
+}
+
+uint8_t w25qxx_sched_blank_check(w25qxx_sched_t *sched, uint32_t addr, w25qxx_bool_t *blank)
+{
+    uint8_t res;
+
+    a_w25qxx_sched_writer_enter(sched);
+    res = w25qxx_blank_check(sched->handle, addr, blank);
+    a_w25qxx_sched_writer_leave(sched);
+
+    return res;
+}
+
+void w25qxx_sched_get_stats(w25qxx_sched_t *sched, w25qxx_sched_stats_t *stats, uint32_t *p99_us)
+{
+    uint8_t bucket;
+    uint32_t target;
+    uint32_t count = 0;
+
+    osAcquireMutex(&sched->bus_mutex);
+    *stats = sched->stats;
+    osReleaseMutex(&sched->bus_mutex);
+
+    *p99_us = 0;
+    target = (uint32_t)(((uint64_t)stats->reads * 99 + 99) / 100);
+    for (bucket = 0; (bucket < W25QXX_SCHED_LATENCY_BUCKETS) && (stats->reads != 0); bucket++)
+    {
+        count += stats->read_hist[bucket];
+        if (count >= target)
+        {
+            *p99_us = stats->read_max_us;
+            if ((bucket < (W25QXX_SCHED_LATENCY_BUCKETS - 1)) && ((1UL << bucket) < *p99_us))
+            {
+                *p99_us = 1UL << bucket;
+            }
+            break;
+        }
+    }
+}
+
+void w25qxx_sched_clear_stats(w25qxx_sched_t *sched)
+{
+    osAcquireMutex(&sched->bus_mutex);
+    memset(&sched->stats, 0, sizeof(sched->stats));
+    osReleaseMutex(&sched->bus_mutex);
+}
@@ -0,0 +1,185 @@
+/**
+ * @file      w25qxx_sched.h
+ * @brief     w25qxx flash i/o scheduler header file
+ * @note      reads that arrive while a program or erase is in flight suspend it, are served
+ *            and resume it, so they do not wait for the whole erase; once a handle is given
+ *            to the scheduler all accesses to it must go through the w25qxx_sched_* functions
+ */
+
+#ifndef W25QXX_SCHED_H
+#define W25QXX_SCHED_H
+
+#include "driver_w25qxx.h"
+#include "os_port.h"
+
+#ifdef __cplusplus
+extern "C"{
+#endif
+
+/**
+ * @defgroup w25qxx_sched w25qxx scheduler
+ * @brief    w25qxx flash i/o scheduler
+ * @{
+ */
+
+#ifndef W25QXX_SCHED_MAX_INSTANCES
+    #define W25QXX_SCHED_MAX_INSTANCES          4           /**< scheduled chips */
+#endif
+#ifndef W25QXX_SCHED_SUSPEND_US
+    #define W25QXX_SCHED_SUSPEND_US             20          /**< tSUS, suspend to ready for read */
+#endif
+#ifndef W25QXX_SCHED_RESUME_TO_SUSPEND_US
+    #define W25QXX_SCHED_RESUME_TO_SUSPEND_US   200         /**< erase run time kept between a resume and the next suspend */
+#endif
+#define W25QXX_SCHED_LATENCY_BUCKETS            24          /**< log2 us buckets, the last one is open ended */
+
+/**
+ * @brief w25qxx scheduler statistics structure definition
+ */
+typedef struct w25qxx_sched_stats_s
+{
+    uint32_t reads;                                         /**< served reads */
+    uint32_t suspends;                                      /**< reads that suspended a program or erase */
+    uint32_t read_max_us;                                   /**< worst read latency */
+    uint32_t read_hist[W25QXX_SCHED_LATENCY_BUCKETS];       /**< read latency, bucket n counts latencies up to 2^n us */
+} w25qxx_sched_stats_t;
+
+/**
+ * @brief w25qxx scheduler structure definition
+ */
+typedef struct w25qxx_sched_s
+{
+    w25qxx_handle_t *handle;                                /**< scheduled chip */
+    uint32_t (*timestamp_us)(void);                         /**< free running us clock */
+    void (*wait_ready)(void *descr, uint32_t us);           /**< wait_ready of the handle before it was hooked */
+    OsMutex bus_mutex;                                      /**< owner may issue commands to the chip */
+    OsMutex write_mutex;                                    /**< one program or erase at a time */
+    uint8_t mutex_created;                                  /**< mutexes are valid */
+    volatile uint8_t busy;                                  /**< a program or erase command may be in flight */
+    uint8_t resumed;                                        /**< resume_us is valid */
+    uint32_t resume_us;                                     /**< time of the last resume */
+    w25qxx_sched_stats_t stats;                             /**< read statistics */
+} w25qxx_sched_t;
+
+/**
+ * @brief     hook an initialized chip into the scheduler
+ * @param[in] *sched points to a w25qxx scheduler structure
+ * @param[in] *handle points to an initialized w25qxx handle structure
+ * @param[in] *timestamp_us points to a free running us clock
+ * @return    status code
+ *            - 0 success
+ *            - 1 too many instances
+ *            - 2 handle is NULL
+ *            - 3 create mutex failed
+ * @note      call again after the handle was linked and initialized anew
+ */
+uint8_t w25qxx_sched_init(w25qxx_sched_t *sched, w25qxx_handle_t *handle, uint32_t (*timestamp_us)(void));
+
+/**
+ * @brief      read data, suspending an in-flight program or erase
+ * @param[in]  *sched points to a w25qxx scheduler structure
+ * @param[in]  addr is the read address
+ * @param[out] *data points to a data buffer
+ * @param[in]  len is the data length
+ * @return     status code
+ *             - 0 success
+ *             - 1 read failed
+ *             - 4 suspend or resume failed
+ * @note       none
+ */
+uint8_t w25qxx_sched_read(w25qxx_sched_t *sched, uint32_t addr, uint8_t *data, uint32_t len);
+
+/**
+ * @brief     write data, see w25qxx_write
+ * @param[in] *sched points to a w25qxx scheduler structure
+ * @param[in] addr is the write address
+ * @param[in] *data points to a data buffer
+ * @param[in] len is the data length
+ * @return    status code of w25qxx_write
+ * @note      none
+ */
+uint8_t w25qxx_sched_write(w25qxx_sched_t *sched, uint32_t addr, uint8_t *data, uint32_t len);
+
+/**
+ * @brief     page program, see w25qxx_page_program
+ * @param[in] *sched points to a w25qxx scheduler structure
+ * @param[in] addr is the programming address
+ * @param[in] *data points to a data buffer
+ * @param[in] len is the data length
+ * @return    status code of w25qxx_page_program
+ * @note      none
+ */
+uint8_t w25qxx_sched_page_program(w25qxx_sched_t *sched, uint32_t addr, uint8_t *data, uint16_t len);
+
+/**
+ * @brief     program a list of segments, see w25qxx_program_segments
+ * @param[in] *sched points to a w25qxx scheduler structure
+ * @param[in] *seg points to a segment list
+ * @param[in] count is the segment number
+ * @return    status code of w25qxx_program_segments
+ * @note      reads are served between the pages
+ */
+uint8_t w25qxx_sched_program_segments(w25qxx_sched_t *sched, const w25qxx_program_segment_t *seg, uint32_t count);
+
+/**
+ * @brief     erase a 4k sector, see w25qxx_sector_erase_4k
+ * @param[in] *sched points to a w25qxx scheduler structure
+ * @param[in] addr is the erase address
+ * @return    status code of w25qxx_sector_erase_4k
+ * @note      none
+ */
+uint8_t w25qxx_sched_sector_erase_4k(w25qxx_sched_t *sched, uint32_t addr);
+
+/**
+ * @brief     erase a 32k block, see w25qxx_block_erase_32k
+ * @param[in] *sched points to a w25qxx scheduler structure
+ * @param[in] addr is the erase address
+ * @return    status code of w25qxx_block_erase_32k
+ * @note      none
+ */
+uint8_t w25qxx_sched_block_erase_32k(w25qxx_sched_t *sched, uint32_t addr);
+
+/**
+ * @brief     erase a 64k block, see w25qxx_block_erase_64k
+ * @param[in] *sched points to a w25qxx scheduler structure
+ * @param[in] addr is the erase address
+ * @return    status code of w25qxx_block_erase_64k
+ * @note      none
+ */
+uint8_t w25qxx_sched_block_erase_64k(w25qxx_sched_t *sched, uint32_t addr);
+
+/**
+ * @brief      check if a 4k sector is blank, see w25qxx_blank_check
+ * @param[in]  *sched points to a w25qxx scheduler structure
+ * @param[in]  addr is the sector address
+ * @param[out] *blank points to a bool value buffer
+ * @return     status code of w25qxx_blank_check
+ * @note       runs as a writer, a sector is never checked while its erase is suspended
+ */
+uint8_t w25qxx_sched_blank_check(w25qxx_sched_t *sched, uint32_t addr, w25qxx_bool_t *blank);
+
+/**
+ * @brief      get the read statistics
+ * @param[in]  *sched points to a w25qxx scheduler structure
+ * @param[out] *stats points to a statistics buffer
+ * @param[out] *p99_us points to the 99th percentile read latency, upper bound of its bucket
+ * @note       none
+ */
+void w25qxx_sched_get_stats(w25qxx_sched_t *sched, w25qxx_sched_stats_t *stats, uint32_t *p99_us);
+
+/**
+ * @brief     clear the read statistics
+ * @param[in] *sched points to a w25qxx scheduler structure
+ * @note      none
+ */
+void w25qxx_sched_clear_stats(w25qxx_sched_t *sched);
+
+/**
+ * @}
+ */
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
@@ -39,6 +39,8 @@
 #include "ipv4/ipv4_misc.h"
 #include "ipv6/ipv6.h"
 #include "ipv6/ipv6_misc.h"
+#include "core/tcp.h"
+#include "core/udp.h"
 #include "debug.h"
 
 //IPsec supported?
@@ -489,6 +491,143 @@ error_t ipLeaveMulticastGroup(NetInterface *interface, const IpAddr *groupAddr)
 }
 
 
+//Cortex-M3/M4: add four words to a 1's complement sum through the carry
+//flag. The host tests can supply a model of these instructions instead
+#if defined(__GNUC__) && (defined(__ARM_ARCH_7M__) || defined(__ARM_ARCH_7EM__)) && \
+   !defined(IP_CHECKSUM_ADC4)
+   #define IP_CHECKSUM_ADC4(sum, w0, w1, w2, w3) \
+      __asm__("adds %0, %0, %1\n\t" \
+         "adcs %0, %0, %2\n\t" \
+         "adcs %0, %0, %3\n\t" \
+         "adcs %0, %0, %4\n\t" \
+         "adc %0, %0, #0" \
+         : "+r" (sum) \
+         : "r" (w0), "r" (w1), "r" (w2), "r" (w3) \
+         : "cc")
+#endif
+
+
+/**
+ * @brief Add 32-bit words to a 1's complement sum
+ * @param[in] checksum Current sum
+ * @param[in] src Pointer to the words to add
+ * @param[out] dest Where to copy the words to (optional parameter)
+ * @param[in] n Number of words to process
+ * @return Updated sum, with the carries added back
+ **/
+
+static uint32_t ipCalcChecksumWords(uint32_t checksum, const uint32_t *src,
+   uint32_t *dest, size_t n)
+{
+#if defined(IP_CHECKSUM_ADC4)
+   uint32_t temp;
+   uint32_t w0;
+   uint32_t w1;
+   uint32_t w2;
+   uint32_t w3;
+
+   //Process the data 16 bytes at a time. The carry flag chains the four
+   //additions and the last carry is added back, one cycle per word
+   while(n >= 4)
+   {
+      w0 = src[0];
+      w1 = src[1];
+      w2 = src[2];
+      w3 = src[3];
+
+      IP_CHECKSUM_ADC4(checksum, w0, w1, w2, w3);
+
+      //Copy the words as well?
+      if(dest != NULL)
+      {
+         dest[0] = w0;
+         dest[1] = w1;
+         dest[2] = w2;
+         dest[3] = w3;
+         dest += 4;
+      }
+
+      //Point to the next words
+      src += 4;
+      n -= 4;
+   }
+
+   //Process the remaining words
+   while(n > 0)
+   {
+      //Update checksum value
+      temp = checksum + *src;
+      //Add carry bit, if any
+      checksum = temp + (temp < checksum);
+
+      //Copy the word as well?
+      if(dest != NULL)
+      {
+         *(dest++) = *src;
+      }
+
+      //Point to the next word
+      src++;
+      n--;
+   }
+#else
+   uint64_t sum;
+
+   //The carries pile up in the upper half of the 64-bit sum, there is no
+   //need to test them word by word
+   sum = checksum;
+
+   //Process the data 16 bytes at a time
+   while(n >= 4)
+   {
+      sum += src[0];
+      sum += src[1];
+      sum += src[2];
+      sum += src[3];
+
+      //Copy the words as well?
+      if(dest != NULL)
+      {
+         dest[0] = src[0];
+         dest[1] = src[1];
+         dest[2] = src[2];
+         dest[3] = src[3];
+         dest += 4;
+      }
+
+      //Point to the next words
+      src += 4;
+      n -= 4;
+   }
+
+   //Process the remaining words
+   while(n > 0)
+   {
+      //Update checksum value
+      sum += *src;
+
+      //Copy the word as well?
+      if(dest != NULL)
+      {
+         *(dest++) = *src;
+      }
+
+      //Point to the next word
+      src++;
+      n--;
+   }
+
+   //Fold 64-bit sum to 32 bits (first pass)
+   sum = (sum & 0xFFFFFFFF) + (sum >> 32);
+   //Fold 64-bit sum to 32 bits (second pass)
+   checksum = (uint32_t) ((sum & 0xFFFFFFFF) + (sum >> 32));
+#endif
+
+   //Return the updated sum
+   return checksum;
+}
+
+
 /**
  * @brief IP checksum calculation
  * @param[in] data Pointer to the data over which to calculate the IP checksum
@@ -498,7 +637,6 @@ error_t ipLeaveMulticastGroup(NetInterface *interface, const IpAddr *groupAddr)
 
 uint16_t ipCalcChecksum(const void *data, size_t length)
 {
-   uint32_t temp;
    uint32_t checksum;
    const uint8_t *p;
 
@@ -543,43 +681,149 @@ uint16_t ipCalcChecksum(const void *data, size_t length)
    }
 
    //Process the data 4 bytes at a time
-   while(length >= 4)
+   checksum = ipCalcChecksumWords(checksum, (const uint32_t *) p, NULL,
+      length / 4);
+
+   //Point to the left-over bytes
+   p += length & ~3U;
+   //Number of bytes left to process
+   length &= 3;
+
+   //Fold 32-bit sum to 16 bits
+   checksum = (checksum & 0xFFFF) + (checksum >> 16);
+
+   //Add left-over 16-bit word, if any
+   if(length >= 2)
    {
       //Update checksum value
-      temp = checksum + *((uint32_t *) p);
+      checksum += (uint32_t) *((uint16_t *) p);
 
-      //Add carry bit, if any
-      if(temp < checksum)
-      {
-         checksum = temp + 1;
-      }
-      else
-      {
-         checksum = temp;
-      }
+      //Point to the next byte
+      p += 2;
+      //Number of bytes left to process
+      length -= 2;
+   }
+
+   //Add left-over byte, if any
+   if(length >= 1)
+   {
+#ifdef _CPU_BIG_ENDIAN
+      //Update checksum value
+      checksum += (uint32_t) *p << 8;
+#else
+      //Update checksum value
+      checksum += (uint32_t) *p;
+#endif
+   }
 
-      //Point to the next 32-bit word
-      p += 4;
+   //Fold 32-bit sum to 16 bits (first pass)
+   checksum = (checksum & 0xFFFF) + (checksum >> 16);
+   //Fold 32-bit sum to 16 bits (second pass)
+   checksum = (checksum & 0xFFFF) + (checksum >> 16);
+
+   //Restore checksum endianness
+   if(((uintptr_t) data & 1) != 0)
+   {
+      //Swap checksum value
+      checksum = ((checksum >> 8) | (checksum << 8)) & 0xFFFF;
+   }
+
+   //Return 1's complement value
+   return checksum ^ 0xFFFF;
+}
+
+
+/**
+ * @brief Copy data and calculate its IP checksum in the same pass
+ * @param[out] dest Pointer to the destination buffer
+ * @param[in] src Pointer to the data to copy
+ * @param[in] length Number of bytes to copy
+ * @return Checksum value, the same as ipCalcChecksum(src, length)
+ **/
+
+uint16_t ipCalcChecksumCopy(void *dest, const void *src, size_t length)
+{
+   uint32_t checksum;
+   uint8_t *q;
+   const uint8_t *p;
+
+   //Point to the source and destination buffers
+   p = (const uint8_t *) src;
+   q = (uint8_t *) dest;
+
+   //Words can only be moved as a whole if both buffers share the same
+   //alignment
+   if((((uintptr_t) p ^ (uintptr_t) q) & 3) != 0)
+   {
+      //Copy the data
+      osMemcpy(q, p, length);
+      //Calculate the checksum over the copy, which is still in the cache
+      return ipCalcChecksum(q, length);
+   }
+
+   //Checksum preset value
+   checksum = 0x0000;
+
+   //Pointer not aligned on a 16-bit boundary?
+   if(((uintptr_t) p & 1) != 0 && length >= 1)
+   {
+#ifdef _CPU_BIG_ENDIAN
+      //Update checksum value
+      checksum += (uint32_t) *p;
+#else
+      //Update checksum value
+      checksum += (uint32_t) *p << 8;
+#endif
+      //Copy the byte
+      *(q++) = *(p++);
+      //Number of bytes left to process
+      length--;
+   }
+
+   //Pointer not aligned on a 32-bit boundary?
+   if(((uintptr_t) p & 2) != 0 && length >= 2)
+   {
+      //Update checksum value
+      checksum += (uint32_t) *((uint16_t *) p);
+      //Copy the 16-bit word
+      *((uint16_t *) q) = *((uint16_t *) p);
+
+      //Restore the alignment on 32-bit boundaries
+      p += 2;
+      q += 2;
       //Number of bytes left to process
-      length -= 4;
+      length -= 2;
    }
 
+   //Copy the data 4 bytes at a time
+   checksum = ipCalcChecksumWords(checksum, (const uint32_t *) p,
+      (uint32_t *) q, length / 4);
+
+   //Point to the left-over bytes
+   p += length & ~3U;
+   q += length & ~3U;
+   //Number of bytes left to process
+   length &= 3;
+
    //Fold 32-bit sum to 16 bits
    checksum = (checksum & 0xFFFF) + (checksum >> 16);
 
-   //Add left-over 16-bit word, if any
+   //Copy left-over 16-bit word, if any
    if(length >= 2)
    {
       //Update checksum value
       checksum += (uint32_t) *((uint16_t *) p);
+      //Copy the 16-bit word
+      *((uint16_t *) q) = *((uint16_t *) p);
 
       //Point to the next byte
       p += 2;
+      q += 2;
       //Number of bytes left to process
       length -= 2;
    }
 
-   //Add left-over byte, if any
+   //Copy left-over byte, if any
    if(length >= 1)
    {
 #ifdef _CPU_BIG_ENDIAN
@@ -589,6 +833,8 @@ uint16_t ipCalcChecksum(const void *data, size_t length)
       //Update checksum value
       checksum += (uint32_t) *p;
 #endif
+      //Copy the byte
+      *q = *p;
    }
 
    //Fold 32-bit sum to 16 bits (first pass)
@@ -597,7 +843,7 @@ uint16_t ipCalcChecksum(const void *data, size_t length)
    checksum = (checksum & 0xFFFF) + (checksum >> 16);
 
    //Restore checksum endianness
-   if(((uintptr_t) data & 1) != 0)
+   if(((uintptr_t) src & 1) != 0)
    {
       //Swap checksum value
       checksum = ((checksum >> 8) | (checksum << 8)) & 0xFFFF;
@@ -733,6 +979,63 @@ uint16_t ipCalcUpperLayerChecksumEx(const void *pseudoHeader,
 }
 
 
+/**
+ * @brief Calculate a TCP or UDP checksum left to the IP layer
+ *
+ * The checksum field of the message must be zero. It is filled in place
+ *
+ * @param[in] pseudoHeader Pointer to the pseudo header
+ * @param[in] pseudoHeaderLen Pseudo header length
+ * @param[in] protocol Upper-layer protocol (TCP or UDP)
+ * @param[in] buffer Multi-part buffer containing the upper-layer message
+ * @param[in] offset Offset to the first byte of the message
+ * @param[in] length Length of the message
+ **/
+
+void ipCalcDeferredChecksum(const void *pseudoHeader, size_t pseudoHeaderLen,
+   uint8_t protocol, NetBuffer *buffer, size_t offset, size_t length)
+{
+   uint16_t checksum;
+   TcpHeader *segment;
+   UdpHeader *header;
+
+   //Calculate the checksum over the pseudo header and the message
+   checksum = ipCalcUpperLayerChecksumEx(pseudoHeader, pseudoHeaderLen,
+      buffer, offset, length);
+
+   //If the computed checksum is zero, it is transmitted as all ones. Both
+   //values stand for zero in 1's complement arithmetic
+   if(checksum == 0x0000)
+   {
+      checksum = 0xFFFF;
+   }
+
+   //TCP segment? (IPv4 protocol numbers and IPv6 next header values match)
+   if(protocol == IPV4_PROTOCOL_TCP)
+   {
+      //Point to the TCP header
+      segment = netBufferAt(buffer, offset);
+
+      //Sanity check
+      if(segment != NULL)
+      {
+         segment->checksum = checksum;
+      }
+   }
+   else
+   {
+      //Point to the UDP header
+      header = netBufferAt(buffer, offset);
+
+      //Sanity check
+      if(header != NULL)
+      {
+         header->checksum = checksum;
+      }
+   }
+}
+
+
 /**
  * @brief Allocate a buffer to hold an IP packet
  * @param[in] length Desired payload length
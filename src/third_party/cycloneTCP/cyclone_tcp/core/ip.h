@@ -138,6 +138,7 @@ error_t ipLeaveMulticastGroup(NetInterface *interface, const IpAddr *groupAddr);
 
 uint16_t ipCalcChecksum(const void *data, size_t length);
 uint16_t ipCalcChecksumEx(const NetBuffer *buffer, size_t offset, size_t length);
+uint16_t ipCalcChecksumCopy(void *dest, const void *src, size_t length);
 
 uint16_t ipCalcUpperLayerChecksum(const void *pseudoHeader,
    size_t pseudoHeaderLen, const void *data, size_t dataLen);
@@ -145,6 +146,9 @@ uint16_t ipCalcUpperLayerChecksum(const void *pseudoHeader,
 uint16_t ipCalcUpperLayerChecksumEx(const void *pseudoHeader,
    size_t pseudoHeaderLen, const NetBuffer *buffer, size_t offset, size_t length);
 
+void ipCalcDeferredChecksum(const void *pseudoHeader, size_t pseudoHeaderLen,
+   uint8_t protocol, NetBuffer *buffer, size_t offset, size_t length);
+
 NetBuffer *ipAllocBuffer(size_t length, size_t *offset);
 
 error_t ipStringToAddr(const char_t *str, IpAddr *ipAddr);
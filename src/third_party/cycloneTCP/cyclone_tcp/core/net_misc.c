@@ -75,6 +75,7 @@ const NetTxAncillary NET_DEFAULT_TX_ANCILLARY =
    IP_DEFAULT_DF, //Do not fragment the IP packet
    FALSE,         //Do not send the packet via a router
    FALSE,         //Do not add an IP Router Alert option
+   FALSE,         //TCP or UDP checksum left to the IP layer
 #if (ETH_SUPPORT == ENABLED)
    {{{0}}},       //Source MAC address
    {{{0}}},       //Destination MAC address
@@ -102,6 +103,8 @@ const NetRxAncillary NET_DEFAULT_RX_ANCILLARY =
 {
    0,       //Time-to-live value
    0,       //Type-of-service value
+   FALSE,   //IPv4 header checksum verified by the NIC
+   FALSE,   //TCP or UDP checksum verified by the NIC
 #if (ETH_SUPPORT == ENABLED)
    {{{0}}}, //Source MAC address
    {{{0}}}, //Destination MAC address
@@ -119,6 +119,7 @@ struct _NetTxAncillary
    bool_t dontFrag;     ///<Do not fragment the IP packet
    bool_t dontRoute;    ///<Do not send the packet via a router
    bool_t routerAlert;  ///<Add an IP Router Alert option
+   bool_t deferChecksum; ///<TCP or UDP checksum left to the IP layer
 #if (ETH_SUPPORT == ENABLED)
    MacAddr srcMacAddr;  ///<Source MAC address
    MacAddr destMacAddr; ///<Destination MAC address
@@ -150,6 +151,8 @@ struct _NetRxAncillary
 {
    uint8_t ttl;            ///<Time-to-live value
    uint8_t tos;            ///<Type-of-service value
+   bool_t ipChecksumValid; ///<IPv4 header checksum verified by the NIC
+   bool_t upperLayerChecksumValid; ///<TCP or UDP checksum verified by the NIC
 #if (ETH_SUPPORT == ENABLED)
    MacAddr srcMacAddr;     ///<Source MAC address
    MacAddr destMacAddr;    ///<Destination MAC address
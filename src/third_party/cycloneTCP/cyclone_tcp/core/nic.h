@@ -297,6 +297,7 @@ typedef struct
    bool_t autoCrcCalc;
    bool_t autoCrcVerif;
    bool_t autoCrcStrip;
+   bool_t autoChecksumCalc;
 } NicDriver;
 
 
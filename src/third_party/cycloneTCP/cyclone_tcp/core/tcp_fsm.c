@@ -152,8 +152,9 @@ void tcpProcessSegment(NetInterface *interface,
       return;
    }
 
-   //Verify TCP checksum
-   if(ipCalcUpperLayerChecksumEx(pseudoHeader->data,
+   //Verify TCP checksum, unless the NIC has verified it already
+   if(!ancillary->upperLayerChecksumValid &&
+      ipCalcUpperLayerChecksumEx(pseudoHeader->data,
       pseudoHeader->length, buffer, offset, length) != 0x0000)
    {
       //Debug message
@@ -183,10 +183,6 @@ error_t tcpSendSegment(Socket *socket, uint8_t flags, uint32_t seqNum,
       pseudoHeader.ipv4Data.reserved = 0;
       pseudoHeader.ipv4Data.protocol = IPV4_PROTOCOL_TCP;
       pseudoHeader.ipv4Data.length = htons(totalLength);
-
-      //Calculate TCP header checksum
-      segment->checksum = ipCalcUpperLayerChecksumEx(&pseudoHeader.ipv4Data,
-         sizeof(Ipv4PseudoHeader), buffer, offset, totalLength);
    }
    else
 #endif
@@ -203,10 +199,6 @@ error_t tcpSendSegment(Socket *socket, uint8_t flags, uint32_t seqNum,
       pseudoHeader.ipv6Data.reserved[1] = 0;
       pseudoHeader.ipv6Data.reserved[2] = 0;
       pseudoHeader.ipv6Data.nextHeader = IPV6_TCP_HEADER;
-
-      //Calculate TCP header checksum
-      segment->checksum = ipCalcUpperLayerChecksumEx(&pseudoHeader.ipv6Data,
-         sizeof(Ipv6PseudoHeader), buffer, offset, totalLength);
    }
    else
 #endif
@@ -336,6 +328,8 @@ error_t tcpSendSegment(Socket *socket, uint8_t flags, uint32_t seqNum,
    ancillary.ttl = socket->ttl;
    //Set ToS field
    ancillary.tos = socket->tos;
+   //The checksum is calculated by the IP layer or by the NIC
+   ancillary.deferChecksum = TRUE;
 
 #if (ETH_VLAN_SUPPORT == ENABLED)
    //Set VLAN PCP and DEI fields
@@ -476,10 +470,6 @@ error_t tcpRejectSegment(NetInterface *interface,
       pseudoHeader2.ipv4Data.reserved = 0;
       pseudoHeader2.ipv4Data.protocol = IPV4_PROTOCOL_TCP;
       pseudoHeader2.ipv4Data.length = HTONS(sizeof(TcpHeader));
-
-      //Calculate TCP header checksum
-      segment2->checksum = ipCalcUpperLayerChecksumEx(&pseudoHeader2.ipv4Data,
-         sizeof(Ipv4PseudoHeader), buffer, offset, sizeof(TcpHeader));
    }
    else
 #endif
@@ -496,10 +486,6 @@ error_t tcpRejectSegment(NetInterface *interface,
       pseudoHeader2.ipv6Data.reserved[1] = 0;
       pseudoHeader2.ipv6Data.reserved[2] = 0;
       pseudoHeader2.ipv6Data.nextHeader = IPV6_TCP_HEADER;
-
-      //Calculate TCP header checksum
-      segment2->checksum = ipCalcUpperLayerChecksumEx(&pseudoHeader2.ipv6Data,
-         sizeof(Ipv6PseudoHeader), buffer, offset, sizeof(TcpHeader));
    }
    else
 #endif
@@ -529,6 +515,8 @@ error_t tcpRejectSegment(NetInterface *interface,
 
    //Additional options can be passed to the stack along with the packet
    ancillary = NET_DEFAULT_TX_ANCILLARY;
+   //The checksum is calculated by the IP layer or by the NIC
+   ancillary.deferChecksum = TRUE;
 
    //Send TCP segment
    error = ipSendDatagram(interface, &pseudoHeader2, buffer, offset,
@@ -1811,29 +1799,9 @@ error_t tcpRetransmitSegment(Socket *socket)
          if(error)
             break;
 
-#if (IPV4_SUPPORT == ENABLED)
-         //Destination address is an IPv4 address?
-         if(queueItem->pseudoHeader.length == sizeof(Ipv4PseudoHeader))
-         {
-            //Calculate TCP header checksum
-            segment->checksum = ipCalcUpperLayerChecksumEx(
-               &queueItem->pseudoHeader.ipv4Data, sizeof(Ipv4PseudoHeader),
-               buffer, offset, segment->dataOffset * 4 + queueItem->length);
-         }
-         else
-#endif
-#if (IPV6_SUPPORT == ENABLED)
-         //Destination address is an IPv6 address?
-         if(queueItem->pseudoHeader.length == sizeof(Ipv6PseudoHeader))
-         {
-            //Calculate TCP header checksum
-            segment->checksum = ipCalcUpperLayerChecksumEx(
-               &queueItem->pseudoHeader.ipv6Data, sizeof(Ipv6PseudoHeader),
-               buffer, offset, segment->dataOffset * 4 + queueItem->length);
-         }
-         else
-#endif
-         //Destination address is not valid?
+         //Check the length of the pseudo header saved with the segment
+         if(queueItem->pseudoHeader.length != sizeof(Ipv4PseudoHeader) &&
+            queueItem->pseudoHeader.length != sizeof(Ipv6PseudoHeader))
          {
             //This should never occur...
             error = ERROR_INVALID_ADDRESS;
@@ -1851,6 +1819,8 @@ error_t tcpRetransmitSegment(Socket *socket)
          ancillary = NET_DEFAULT_TX_ANCILLARY;
          //Set the TTL value to be used
          ancillary.ttl = socket->ttl;
+         //The checksum is calculated by the IP layer or by the NIC
+         ancillary.deferChecksum = TRUE;
 
 #if (ETH_VLAN_SUPPORT == ENABLED)
          //Set VLAN PCP and DEI fields
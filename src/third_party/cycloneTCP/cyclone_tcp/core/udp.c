@@ -174,9 +174,10 @@ error_t udpProcessDatagram(NetInterface *interface,
    //Convert the length field from network byte order
    length = ntohs(header->length);
 
-   //When UDP runs over IPv6, the checksum is mandatory
-   if(header->checksum != 0x0000 ||
-      pseudoHeader->length == sizeof(Ipv6PseudoHeader))
+   //When UDP runs over IPv6, the checksum is mandatory. The NIC may have
+   //verified it already
+   if(!ancillary->upperLayerChecksumValid && (header->checksum != 0x0000 ||
+      pseudoHeader->length == sizeof(Ipv6PseudoHeader)))
    {
       //Verify UDP checksum
       if(ipCalcUpperLayerChecksumEx(pseudoHeader->data,
@@ -708,10 +709,6 @@ error_t udpSendBuffer(NetInterface *interface, const IpAddr *srcIpAddr,
       pseudoHeader.ipv4Data.reserved = 0;
       pseudoHeader.ipv4Data.protocol = IPV4_PROTOCOL_UDP;
       pseudoHeader.ipv4Data.length = htons(length);
-
-      //Calculate UDP header checksum
-      header->checksum = ipCalcUpperLayerChecksumEx(&pseudoHeader.ipv4Data,
-         sizeof(Ipv4PseudoHeader), buffer, offset, length);
    }
    else
 #endif
@@ -750,10 +747,6 @@ error_t udpSendBuffer(NetInterface *interface, const IpAddr *srcIpAddr,
       pseudoHeader.ipv6Data.reserved[1] = 0;
       pseudoHeader.ipv6Data.reserved[2] = 0;
       pseudoHeader.ipv6Data.nextHeader = IPV6_UDP_HEADER;
-
-      //Calculate UDP header checksum
-      header->checksum = ipCalcUpperLayerChecksumEx(&pseudoHeader.ipv6Data,
-         sizeof(Ipv6PseudoHeader), buffer, offset, length);
    }
    else
 #endif
@@ -763,13 +756,10 @@ error_t udpSendBuffer(NetInterface *interface, const IpAddr *srcIpAddr,
       return ERROR_FAILURE;
    }
 
-   //If the computed checksum is zero, it is transmitted as all ones. An all
-   //zero transmitted checksum value means that the transmitter generated no
-   //checksum
-   if(header->checksum == 0x0000)
-   {
-      header->checksum = 0xFFFF;
-   }
+   //The checksum is calculated by the IP layer or by the NIC. A computed
+   //checksum of zero is transmitted as all ones, since an all zero value
+   //means that the transmitter generated no checksum
+   ancillary->deferChecksum = TRUE;
 
    //Total number of UDP datagrams sent from this entity
    MIB2_UDP_INC_COUNTER32(udpOutDatagrams, 1);
@@ -756,8 +756,9 @@ void ipv4ProcessPacket(NetInterface *interface, Ipv4Header *packet,
 
       //The host must verify the IP header checksum on every received datagram
       //and silently discard every datagram that has a bad checksum (refer to
-      //RFC 1122, section 3.2.1.2)
-      if(ipCalcChecksum(packet, packet->headerLength * 4) != 0x0000)
+      //RFC 1122, section 3.2.1.2). The NIC may have verified it already
+      if(!ancillary->ipChecksumValid &&
+         ipCalcChecksum(packet, packet->headerLength * 4) != 0x0000)
       {
          //Debug message
          TRACE_WARNING("Wrong IP header checksum!\r\n");
@@ -776,6 +777,9 @@ void ipv4ProcessPacket(NetInterface *interface, Ipv4Header *packet,
       //A fragmented packet was received?
       if((ntohs(packet->fragmentOffset) & (IPV4_FLAG_MF | IPV4_OFFSET_MASK)) != 0)
       {
+         //The NIC cannot verify the checksum of a fragmented datagram
+         ancillary->upperLayerChecksumValid = FALSE;
+
 #if (IPV4_FRAG_SUPPORT == ENABLED)
          //Reassemble the original datagram
          ipv4ReassembleDatagram(interface, packet, length, ancillary);
@@ -1007,9 +1011,7 @@ error_t ipv4SendDatagram(NetInterface *interface,
 {
    error_t error;
    uint16_t id;
-#if (IPV4_IPSEC_SUPPORT == DISABLED)
    size_t length;
-#endif
 
    //Total number of IP datagrams which local IP user-protocols supplied to IP
    //in requests for transmission
@@ -1023,6 +1025,28 @@ error_t ipv4SendDatagram(NetInterface *interface,
    //original IP datagram
    id = interface->ipv4Context.identification++;
 
+   //Retrieve the length of payload
+   length = netBufferGetLength(buffer) - offset;
+
+   //TCP or UDP checksum left to the IP layer?
+   if(ancillary->deferChecksum)
+   {
+#if (IPV4_IPSEC_SUPPORT == DISABLED)
+      //The NIC can only calculate the checksum of a datagram that is not
+      //fragmented
+      if(!ipv4CheckChecksumOffload(interface, pseudoHeader->destAddr) ||
+         (length + sizeof(Ipv4Header)) > interface->ipv4Context.linkMtu)
+#endif
+      {
+         //Calculate the checksum in software
+         ipCalcDeferredChecksum(pseudoHeader, sizeof(Ipv4PseudoHeader),
+            pseudoHeader->protocol, buffer, offset, length);
+
+         //The checksum is now valid
+         ancillary->deferChecksum = FALSE;
+      }
+   }
+
 #if (IPV4_IPSEC_SUPPORT == ENABLED)
    //Process outbound IP traffic (protected-to-unprotected)
    error = ipsecProcessOutboundIpv4Packet(interface, pseudoHeader, id, buffer,
@@ -1035,9 +1059,6 @@ error_t ipv4SendDatagram(NetInterface *interface,
       error = NO_ERROR;
    }
 #else
-   //Retrieve the length of payload
-   length = netBufferGetLength(buffer) - offset;
-
    //Check the length of the payload
    if((length + sizeof(Ipv4Header)) <= interface->ipv4Context.linkMtu)
    {
@@ -1156,9 +1177,13 @@ error_t ipv4SendPacket(NetInterface *interface,
       packet->timeToLive = interface->ipv4Context.defaultTtl;
    }
 
-   //Calculate IP header checksum
-   packet->headerChecksum = ipCalcChecksumEx(buffer, offset,
-      packet->headerLength * 4);
+   //The NIC may calculate the IP header checksum
+   if(!ipv4CheckChecksumOffload(interface, pseudoHeader->destAddr))
+   {
+      //Calculate IP header checksum
+      packet->headerChecksum = ipCalcChecksumEx(buffer, offset,
+         packet->headerLength * 4);
+   }
 
    //Ensure the source address is valid
    error = ipv4CheckSourceAddr(interface, pseudoHeader->srcAddr);
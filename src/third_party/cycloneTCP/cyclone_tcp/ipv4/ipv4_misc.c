@@ -610,6 +610,39 @@ bool_t ipv4IsLocalHostAddr(Ipv4Addr ipAddr)
 }
 
 
+/**
+ * @brief Check whether the NIC calculates the checksums of an IPv4 packet
+ * @param[in] interface Underlying network interface
+ * @param[in] destAddr Destination IPv4 address of the packet
+ * @return TRUE if the IPv4 header checksum and the TCP or UDP checksum are
+ *   left to the NIC, else FALSE
+ **/
+
+bool_t ipv4CheckChecksumOffload(NetInterface *interface, Ipv4Addr destAddr)
+{
+   bool_t flag;
+   NetInterface *physicalInterface;
+
+   //Point to the physical interface
+   physicalInterface = nicGetPhysicalInterface(interface);
+
+   //Packets that loop back inside the host never reach the NIC
+   if(physicalInterface->nicDriver != NULL &&
+      physicalInterface->nicDriver->autoChecksumCalc &&
+      !ipv4IsLocalHostAddr(destAddr))
+   {
+      flag = TRUE;
+   }
+   else
+   {
+      flag = FALSE;
+   }
+
+   //Return TRUE if the checksums are calculated by the NIC
+   return flag;
+}
+
+
 /**
  * @brief Compare IPv4 address prefixes
  * @param[in] ipAddr1 First IPv4 address
@@ -56,6 +56,7 @@ bool_t ipv4IsOnLink(NetInterface *interface, Ipv4Addr ipAddr);
 bool_t ipv4IsBroadcastAddr(NetInterface *interface, Ipv4Addr ipAddr);
 bool_t ipv4IsTentativeAddr(NetInterface *interface, Ipv4Addr ipAddr);
 bool_t ipv4IsLocalHostAddr(Ipv4Addr ipAddr);
+bool_t ipv4CheckChecksumOffload(NetInterface *interface, Ipv4Addr destAddr);
 
 bool_t ipv4CompPrefix(Ipv4Addr ipAddr1, Ipv4Addr ipAddr2, size_t length);
 
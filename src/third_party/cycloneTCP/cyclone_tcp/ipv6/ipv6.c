@@ -1141,6 +1141,9 @@ void ipv6ProcessPacket(NetInterface *interface, NetBuffer *ipPacket,
 
       //Fragment header?
       case IPV6_FRAGMENT_HEADER:
+         //The NIC cannot verify the checksum of a fragmented datagram
+         ancillary->upperLayerChecksumValid = FALSE;
+
 #if (IPV6_FRAG_SUPPORT == ENABLED)
          //Parse current extension header
          ipv6ParseFragmentHeader(interface, ipPacket, ipPacketOffset,
@@ -1696,6 +1699,23 @@ error_t ipv6SendDatagram(NetInterface *interface,
    pathMtu = interface->ipv6Context.linkMtu;
 #endif
 
+   //TCP or UDP checksum left to the IP layer?
+   if(ancillary->deferChecksum)
+   {
+      //The NIC can only calculate the checksum of a datagram that is not
+      //fragmented
+      if(!ipv6CheckChecksumOffload(interface, &pseudoHeader->destAddr) ||
+         (length + sizeof(Ipv6Header)) > pathMtu)
+      {
+         //Calculate the checksum in software
+         ipCalcDeferredChecksum(pseudoHeader, sizeof(Ipv6PseudoHeader),
+            pseudoHeader->nextHeader, buffer, offset, length);
+
+         //The checksum is now valid
+         ancillary->deferChecksum = FALSE;
+      }
+   }
+
    //Check the length of the payload
    if((length + sizeof(Ipv6Header)) <= pathMtu)
    {
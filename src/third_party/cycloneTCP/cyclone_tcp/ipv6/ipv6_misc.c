@@ -1210,6 +1210,39 @@ bool_t ipv6IsLocalHostAddr(const Ipv6Addr *ipAddr)
 }
 
 
+/**
+ * @brief Check whether the NIC calculates the checksum of an IPv6 packet
+ * @param[in] interface Underlying network interface
+ * @param[in] destAddr Destination IPv6 address of the packet
+ * @return TRUE if the TCP or UDP checksum is left to the NIC, else FALSE
+ **/
+
+bool_t ipv6CheckChecksumOffload(NetInterface *interface,
+   const Ipv6Addr *destAddr)
+{
+   bool_t flag;
+   NetInterface *physicalInterface;
+
+   //Point to the physical interface
+   physicalInterface = nicGetPhysicalInterface(interface);
+
+   //Packets that loop back inside the host never reach the NIC
+   if(physicalInterface->nicDriver != NULL &&
+      physicalInterface->nicDriver->autoChecksumCalc &&
+      !ipv6IsLocalHostAddr(destAddr))
+   {
+      flag = TRUE;
+   }
+   else
+   {
+      flag = FALSE;
+   }
+
+   //Return TRUE if the checksum is calculated by the NIC
+   return flag;
+}
+
+
 /**
  * @brief Compare IPv6 address prefixes
  * @param[in] ipAddr1 Pointer to the first IPv6 address
@@ -80,6 +80,9 @@ bool_t ipv6IsAnycastAddr(NetInterface *interface, const Ipv6Addr *ipAddr);
 bool_t ipv6IsTentativeAddr(NetInterface *interface, const Ipv6Addr *ipAddr);
 bool_t ipv6IsLocalHostAddr(const Ipv6Addr *ipAddr);
 
+bool_t ipv6CheckChecksumOffload(NetInterface *interface,
+   const Ipv6Addr *destAddr);
+
 bool_t ipv6CompPrefix(const Ipv6Addr *ipAddr1, const Ipv6Addr *ipAddr2,
    size_t length);
 
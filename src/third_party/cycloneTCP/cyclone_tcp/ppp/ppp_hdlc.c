@@ -63,6 +63,7 @@ const NicDriver pppHdlcDriver =
    FALSE,
    FALSE,
    FALSE,
+   FALSE,
    FALSE
 };
 
@@ -0,0 +1,21 @@
+/*
+ * FreeRTOS.h
+ *
+ * Host stand-in for the heap hooks lfs_util.h takes from FreeRTOS. A test
+ * counting the heap allocations of littlefs builds with -DpvPortMalloc=<its
+ * own function> and defines that function.
+ */
+
+#ifndef FREERTOS_H_STUB_
+#define FREERTOS_H_STUB_
+
+#include <stdlib.h>
+
+#ifndef pvPortMalloc
+    #define pvPortMalloc    malloc
+#else
+    void *pvPortMalloc(size_t size);
+#endif
+#define vPortFree       free
+
+#endif /* FREERTOS_H_STUB_ */
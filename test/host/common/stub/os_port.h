@@ -0,0 +1,158 @@
+/*
+ * os_port.h
+ *
+ * Host stand-in for the CycloneTCP OS abstraction on POSIX threads: mutexes,
+ * auto-reset events and detached tasks. The system time counts milliseconds.
+ * The types and string helpers of compiler_port.h come with it, as in the
+ * real header, for fs_port code.
+ */
+
+#ifndef OS_PORT_H_STUB_
+#define OS_PORT_H_STUB_
+
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <pthread.h>
+#include <time.h>
+#include <unistd.h>
+
+typedef int bool_t;
+typedef uint32_t systime_t;
+typedef char char_t;
+typedef int int_t;
+typedef unsigned int uint_t;
+
+#ifndef TRUE
+   #define TRUE 1
+#endif
+#ifndef FALSE
+   #define FALSE 0
+#endif
+
+#ifndef MIN
+   #define MIN(a, b) ((a) < (b) ? (a) : (b))
+#endif
+
+#define osMemset(p, value, length) (void) memset(p, value, length)
+#define osMemcpy(dest, src, length) (void) memcpy(dest, src, length)
+#define osStrlen(s) strlen(s)
+#define osStrcmp(s1, s2) strcmp(s1, s2)
+#define osStrcpy(s1, s2) (void) strcpy(s1, s2)
+#define osStrncpy(s1, s2, length) (void) memcpy(s1, s2, length)    // callers copy at most the string length
+
+#define INFINITE_DELAY          ((systime_t) -1)
+#define OS_MS_TO_SYSTICKS(n)    (n)
+#define tskIDLE_PRIORITY        0
+
+typedef pthread_mutex_t OsMutex;
+
+typedef struct
+{
+   pthread_mutex_t mutex;
+   pthread_cond_t cond;
+   bool_t state;
+} OsEvent;
+
+typedef pthread_t *OsTaskId;
+typedef void (*OsTaskCode)(void *arg);
+
+typedef struct
+{
+   uint32_t stackSize;
+   uint32_t priority;
+} OsTaskParameters;
+
+#define OS_INVALID_TASK_ID      NULL
+
+static const OsTaskParameters OS_TASK_DEFAULT_PARAMS = {0, 0};
+
+static inline bool_t osCreateMutex(OsMutex *mutex)
+{
+   return pthread_mutex_init(mutex, NULL) == 0;
+}
+
+static inline void osDeleteMutex(OsMutex *mutex)
+{
+   pthread_mutex_destroy(mutex);
+}
+
+static inline void osAcquireMutex(OsMutex *mutex)
+{
+   pthread_mutex_lock(mutex);
+}
+
+static inline void osReleaseMutex(OsMutex *mutex)
+{
+   pthread_mutex_unlock(mutex);
+}
+
+static inline bool_t osCreateEvent(OsEvent *event)
+{
+   pthread_mutex_init(&event->mutex, NULL);
+   pthread_cond_init(&event->cond, NULL);
+   event->state = FALSE;
+   return TRUE;
+}
+
+static inline void osSetEvent(OsEvent *event)
+{
+   pthread_mutex_lock(&event->mutex);
+   event->state = TRUE;
+   pthread_cond_signal(&event->cond);
+   pthread_mutex_unlock(&event->mutex);
+}
+
+static inline void osResetEvent(OsEvent *event)
+{
+   pthread_mutex_lock(&event->mutex);
+   event->state = FALSE;
+   pthread_mutex_unlock(&event->mutex);
+}
+
+// Only INFINITE_DELAY is used by the code under test
+static inline bool_t osWaitForEvent(OsEvent *event, systime_t timeout)
+{
+   (void)timeout;
+
+   pthread_mutex_lock(&event->mutex);
+   while(!event->state)
+   {
+      pthread_cond_wait(&event->cond, &event->mutex);
+   }
+   event->state = FALSE;
+   pthread_mutex_unlock(&event->mutex);
+   return TRUE;
+}
+
+static inline void osDelayTask(systime_t delay)
+{
+   usleep(delay * 1000u);
+}
+
+static inline systime_t osGetSystemTime(void)
+{
+   struct timespec t;
+
+   clock_gettime(CLOCK_MONOTONIC, &t);
+   return (systime_t) (t.tv_sec * 1000 + t.tv_nsec / 1000000);
+}
+
+static inline OsTaskId osCreateTask(const char *name, OsTaskCode taskCode, void *arg,
+   const OsTaskParameters *params)
+{
+   pthread_t *thread = malloc(sizeof(pthread_t));
+
+   (void)name;
+   (void)params;
+
+   if(thread == NULL || pthread_create(thread, NULL, (void *(*)(void *)) taskCode, arg) != 0)
+   {
+      free(thread);
+      return OS_INVALID_TASK_ID;
+   }
+   pthread_detach(*thread);
+   return thread;
+}
+
+#endif /* OS_PORT_H_STUB_ */
@@ -0,0 +1,609 @@
+/*
+ * w25q_model.c
+ *
+ * Host model of a W25Q128 or W25Q256, see w25q_model.h.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdarg.h>
+#include <time.h>
+#include "w25q_model.h"
+
+#define W25Q_MODEL_COMMAND_US       5           // chip select and command overhead of a read or program
+#define W25Q_MODEL_STATUS_US        2           // a status register read
+
+uint64_t w25qModelTimeUs;
+uint32_t w25qModelBusMhz = 50;
+int w25qModelRealTime;
+
+uint32_t w25qModelProgramUs = 400;
+uint32_t w25qModelErase4kUs = 45000;
+uint32_t w25qModelErase32kUs = 120000;
+uint32_t w25qModelErase64kUs = 150000;
+uint32_t w25qModelEraseChipUs = 40000000;
+uint32_t w25qModelWriteStatusUs = 10000;
+uint32_t w25qModelVolatileStatusUs;
+uint32_t w25qModelSuspendUs = 20;
+
+uint32_t w25qModelCommands[256];
+uint32_t w25qModelReads;
+uint32_t w25qModelPrograms;
+uint32_t w25qModelErases;
+uint32_t w25qModelStatusPolls;
+uint64_t w25qModelDelayUs;
+uint32_t w25qModelSuspends;
+uint32_t w25qModelResumeToSuspendMinUs;
+uint32_t w25qModelReadWhileSuspendedMaxUs;
+
+uint8_t w25qModelLastRead;
+uint8_t w25qModelLastReadLines;
+
+static uint8_t w25qModelMemory[W25Q_MODEL_MAX_SIZE];
+static w25qxx_type_t w25qModelType = W25Q128;
+static uint32_t w25qModelBytes = 16u * 1024u * 1024u;
+
+static uint8_t w25qModelStatusNv[3];            // non-volatile status registers
+static uint8_t w25qModelStatus[3];              // volatile status registers, what the chip runs with
+static int w25qModelWriteEnabled;
+static int w25qModelVolatileEnabled;            // 0x50 was the last write enable
+static int w25qModelFourByte;
+static uint8_t w25qModelExtAddr;
+static uint64_t w25qModelBusyUntil;
+static int w25qModelSuspended;
+static uint64_t w25qModelSuspendedAt;
+static int w25qModelResumed;
+static uint64_t w25qModelResumedAt;
+static int w25qModelResetEnabled;
+static int w25qModelPoweredDown;
+
+
+static void a_W25qModel_Fail(const char *what, uint8_t command)
+{
+    printf("w25q model: %s, command 0x%02X\n", what, command);
+    exit(1);
+}
+
+int w25qModelBusy(void)
+{
+    return (w25qModelBusyUntil > w25qModelTimeUs) && !w25qModelSuspended;
+}
+
+static void a_W25qModel_PowerUp(void)
+{
+    memcpy(w25qModelStatus, w25qModelStatusNv, sizeof(w25qModelStatus));
+    w25qModelWriteEnabled = 0;
+    w25qModelVolatileEnabled = 0;
+    w25qModelFourByte = ((w25qModelType >= W25Q256) && ((w25qModelStatusNv[2] & 0x02) != 0)) ? 1 : 0;
+    w25qModelExtAddr = 0;
+    w25qModelBusyUntil = 0;
+    w25qModelSuspended = 0;
+    w25qModelResumed = 0;
+    w25qModelResetEnabled = 0;
+    w25qModelPoweredDown = 0;
+}
+
+// Time of a frame on the bus, in us
+static uint64_t a_W25qModel_BusUs(uint32_t bits)
+{
+    return bits / w25qModelBusMhz;
+}
+
+static void a_W25qModel_Elapse(uint64_t us)
+{
+    w25qModelTimeUs += us;
+    if (w25qModelRealTime)
+    {
+        struct timespec t = {(time_t)(us / 1000000u), (long)(us % 1000000u) * 1000};
+
+        nanosleep(&t, NULL);
+    }
+}
+
+static void a_W25qModel_Busy(uint32_t us)
+{
+    w25qModelBusyUntil = w25qModelTimeUs + us;
+}
+
+static uint32_t a_W25qModel_Address(uint8_t command, uint32_t address, uint8_t length)
+{
+    if ((length == 3) && (w25qModelType >= W25Q256))
+    {
+        address |= (uint32_t)w25qModelExtAddr << 24;
+    }
+    if (address >= w25qModelBytes)
+    {
+        a_W25qModel_Fail("address past the end of the chip", command);
+    }
+    return address;
+}
+
+static void a_W25qModel_WriteAccess(uint8_t command)
+{
+    if (w25qModelSuspended)
+    {
+        a_W25qModel_Fail("program or erase while suspended", command);
+    }
+    if (!w25qModelWriteEnabled)
+    {
+        a_W25qModel_Fail("program or erase without write enable", command);
+    }
+    w25qModelWriteEnabled = 0;
+}
+
+static void a_W25qModel_Erase(uint8_t command, uint32_t address, uint32_t size, uint32_t us)
+{
+    a_W25qModel_WriteAccess(command);
+    address &= ~(size - 1);
+    memset(&w25qModelMemory[address], 0xFF, size);
+    a_W25qModel_Busy(us);
+    w25qModelErases++;
+}
+
+static void a_W25qModel_Program(uint8_t command, uint32_t address, const uint8_t *data, uint32_t len)
+{
+    uint32_t page = address & ~255u;
+    uint32_t i;
+
+    a_W25qModel_WriteAccess(command);
+    if (len > 256)
+    {
+        a_W25qModel_Fail("program of more than a page", command);
+    }
+    for (i = 0; i < len; i++)
+    {
+        w25qModelMemory[page + ((address + i) & 255u)] &= data[i];          // wraps within the page
+    }
+    a_W25qModel_Busy(w25qModelProgramUs);
+    w25qModelPrograms++;
+}
+
+static void a_W25qModel_Read(uint8_t command, uint32_t address, uint8_t *out, uint32_t len, uint8_t lines)
+{
+    uint32_t i;
+
+    if (w25qModelSuspended && ((w25qModelTimeUs - w25qModelSuspendedAt) < w25qModelSuspendUs))
+    {
+        a_W25qModel_Fail("read sooner than tSUS after a suspend", command);
+    }
+    for (i = 0; i < len; i++)
+    {
+        out[i] = w25qModelMemory[(address + i) % w25qModelBytes];
+    }
+    w25qModelReads++;
+    w25qModelLastRead = command;
+    w25qModelLastReadLines = lines;
+}
+
+static void a_W25qModel_WriteStatus(uint8_t command, uint8_t reg, const uint8_t *data, uint32_t len)
+{
+    uint32_t i;
+
+    if (!w25qModelWriteEnabled && !w25qModelVolatileEnabled)
+    {
+        a_W25qModel_Fail("status register write without write enable", command);
+    }
+    for (i = 0; (i < len) && ((reg + i) < 3); i++)
+    {
+        uint8_t value = data[i];
+
+        if ((reg + i) == 1)
+        {
+            value = (value & 0x7F) | (w25qModelStatus[1] & W25Q_MODEL_SR2_SUS);    // SUS is read only
+        }
+        w25qModelStatus[reg + i] = value;
+        if (w25qModelWriteEnabled)
+        {
+            w25qModelStatusNv[reg + i] = value & ~W25Q_MODEL_SR2_SUS;
+        }
+    }
+    a_W25qModel_Busy(w25qModelWriteEnabled ? w25qModelWriteStatusUs : w25qModelVolatileStatusUs);
+    w25qModelWriteEnabled = 0;
+    w25qModelVolatileEnabled = 0;
+}
+
+static uint8_t a_W25qModel_Status(uint8_t reg)
+{
+    uint8_t value = w25qModelStatus[reg];
+
+    if (reg == 0)
+    {
+        value = (value & 0xFC) | (w25qModelBusy() ? 0x01 : 0x00) | (w25qModelWriteEnabled ? 0x02 : 0x00);
+    }
+    else if (reg == 1)
+    {
+        value = (value & 0x7F) | (w25qModelSuspended ? W25Q_MODEL_SR2_SUS : 0x00);
+    }
+    else if (w25qModelType >= W25Q256)
+    {
+        value = (value & 0xFE) | (w25qModelFourByte ? 0x01 : 0x00);                 // ADS
+    }
+    return value;
+}
+
+// Has the opcode an address phase, 3 or 4 bytes as the chip is set up, 4 for the 4-byte opcodes
+static uint8_t a_W25qModel_AddressLength(uint8_t command)
+{
+    switch (command)
+    {
+        case 0x12: case 0x13: case 0x0C: case 0x21: case 0xDC: case 0x34: case 0xEC: case 0xBC:
+            return 4;
+        case 0x03: case 0x0B: case 0x3B: case 0x6B: case 0xBB: case 0xEB:
+        case 0x02: case 0x32: case 0x20: case 0x52: case 0xD8: case 0x44: case 0x42: case 0x48:
+            return w25qModelFourByte ? 4 : 3;
+        case 0x90:
+            return 3;
+        default:
+            return 0;
+    }
+}
+
+// Run one command once the frame is decoded: the address, the bytes the host clocked out after
+// it and the bytes it clocks in. data_lines is the width of the data phase.
+static void a_W25qModel_Execute(uint8_t command, uint32_t address, uint8_t address_len,
+                                const uint8_t *in, uint32_t in_len, uint8_t *out, uint32_t out_len,
+                                uint8_t data_lines, uint64_t bus_us)
+{
+    w25qModelCommands[command]++;
+
+    if (w25qModelBusy() && (command != 0x05) && (command != 0x35) && (command != 0x15) && (command != 0x75))
+    {
+        a_W25qModel_Fail("command while busy", command);
+    }
+    if (w25qModelPoweredDown && (command != 0xAB) && (command != 0xB9))
+    {
+        a_W25qModel_Fail("command in power down", command);
+    }
+    if ((command != 0x99) && (command != 0x66))
+    {
+        w25qModelResetEnabled = 0;
+    }
+
+    switch (command)
+    {
+        case 0x06:                                                  // write enable
+            w25qModelWriteEnabled = 1;
+            w25qModelVolatileEnabled = 0;
+            break;
+        case 0x50:                                                  // volatile status register write enable
+            w25qModelVolatileEnabled = 1;
+            break;
+        case 0x04:                                                  // write disable
+            w25qModelWriteEnabled = 0;
+            break;
+        case 0x05:
+            w25qModelStatusPolls++;
+            w25qModelTimeUs += W25Q_MODEL_STATUS_US;
+            memset(out, a_W25qModel_Status(0), out_len);
+            break;
+        case 0x35:
+            w25qModelTimeUs += W25Q_MODEL_STATUS_US;
+            memset(out, a_W25qModel_Status(1), out_len);
+            break;
+        case 0x15:
+            w25qModelTimeUs += W25Q_MODEL_STATUS_US;
+            memset(out, a_W25qModel_Status(2), out_len);
+            break;
+        case 0x01:
+            a_W25qModel_WriteStatus(command, 0, in, in_len);
+            break;
+        case 0x31:
+            a_W25qModel_WriteStatus(command, 1, in, in_len);
+            break;
+        case 0x11:
+            a_W25qModel_WriteStatus(command, 2, in, in_len);
+            break;
+        case 0x90:                                                  // manufacturer / device id
+            if (out_len >= 2)
+            {
+                out[0] = 0xEF;
+                out[1] = (uint8_t)(w25qModelType & 0xFF);
+            }
+            break;
+        case 0x9F:                                                  // JEDEC id
+            if (out_len >= 3)
+            {
+                out[0] = 0xEF;
+                out[1] = 0x40;
+                out[2] = (w25qModelType >= W25Q256) ? 0x19 : 0x18;
+            }
+            break;
+        case 0xB9:                                                  // power down
+            w25qModelPoweredDown = 1;
+            break;
+        case 0xAB:                                                  // release power down
+            w25qModelPoweredDown = 0;
+            break;
+        case 0x66:
+            w25qModelResetEnabled = 1;
+            break;
+        case 0x99:
+            if (w25qModelResetEnabled)
+            {
+                a_W25qModel_PowerUp();
+            }
+            break;
+        case 0xB7:
+            w25qModelFourByte = (w25qModelType >= W25Q256) ? 1 : 0;
+            break;
+        case 0xE9:
+            w25qModelFourByte = 0;
+            break;
+        case 0xC5:                                                  // write extended address register
+            if (!w25qModelWriteEnabled)
+            {
+                a_W25qModel_Fail("extended address write without write enable", command);
+            }
+            w25qModelWriteEnabled = 0;
+            if (in_len >= 1)
+            {
+                w25qModelExtAddr = in[0];
+            }
+            break;
+        case 0xC8:
+            memset(out, w25qModelExtAddr, out_len);
+            break;
+        case 0xEB:
+        case 0xEC:
+        case 0x6B:
+        case 0x32:
+        case 0x34:
+            if ((w25qModelStatus[1] & W25Q_MODEL_SR2_QE) == 0)
+            {
+                a_W25qModel_Fail("quad command with QE clear", command);
+            }
+            if ((command == 0x32) || (command == 0x34))
+            {
+                a_W25qModel_Elapse(bus_us + W25Q_MODEL_COMMAND_US);
+                a_W25qModel_Program(command, a_W25qModel_Address(command, address, address_len), in, in_len);
+                break;
+            }
+            /* fall through */
+        case 0x03:
+        case 0x13:
+        case 0x0B:
+        case 0x0C:
+        case 0x3B:
+        case 0xBB:
+        case 0xBC:
+            a_W25qModel_Read(command, a_W25qModel_Address(command, address, address_len), out, out_len, data_lines);
+            a_W25qModel_Elapse(bus_us + W25Q_MODEL_COMMAND_US);
+            break;
+        case 0x02:
+        case 0x12:
+            a_W25qModel_Elapse(bus_us + W25Q_MODEL_COMMAND_US);
+            a_W25qModel_Program(command, a_W25qModel_Address(command, address, address_len), in, in_len);
+            break;
+        case 0x20:
+        case 0x21:
+            a_W25qModel_Erase(command, a_W25qModel_Address(command, address, address_len), 4096, w25qModelErase4kUs);
+            break;
+        case 0x52:
+            a_W25qModel_Erase(command, a_W25qModel_Address(command, address, address_len), 32768, w25qModelErase32kUs);
+            break;
+        case 0xD8:
+        case 0xDC:
+            a_W25qModel_Erase(command, a_W25qModel_Address(command, address, address_len), 65536, w25qModelErase64kUs);
+            break;
+        case 0x44:                                                  // erase security register
+            a_W25qModel_WriteAccess(command);
+            a_W25qModel_Busy(w25qModelErase4kUs);
+            break;
+        case 0xC7:
+        case 0x60:
+            a_W25qModel_Erase(command, 0, w25qModelBytes, w25qModelEraseChipUs);
+            break;
+        case 0x75:                                                  // erase / program suspend
+            if (w25qModelBusy())
+            {
+                if (w25qModelResumed && ((w25qModelTimeUs - w25qModelResumedAt) < w25qModelResumeToSuspendMinUs))
+                {
+                    w25qModelResumeToSuspendMinUs = (uint32_t)(w25qModelTimeUs - w25qModelResumedAt);
+                }
+                w25qModelSuspended = 1;
+                w25qModelSuspendedAt = w25qModelTimeUs;
+                w25qModelSuspends++;
+            }
+            break;
+        case 0x7A:                                                  // erase / program resume
+            if (w25qModelSuspended)
+            {
+                if ((w25qModelTimeUs - w25qModelSuspendedAt) > w25qModelReadWhileSuspendedMaxUs)
+                {
+                    w25qModelReadWhileSuspendedMaxUs = (uint32_t)(w25qModelTimeUs - w25qModelSuspendedAt);
+                }
+                w25qModelSuspended = 0;
+                w25qModelBusyUntil += w25qModelTimeUs - w25qModelSuspendedAt;
+                w25qModelResumed = 1;
+                w25qModelResumedAt = w25qModelTimeUs;
+            }
+            break;
+        default:
+            break;
+    }
+}
+
+void w25qModelSpiTransfer(const uint8_t *in_buf, uint32_t in_len, uint8_t *out_buf, uint32_t out_len)
+{
+    uint8_t command;
+    uint8_t address_len;
+    uint32_t address = 0;
+    uint32_t skip;
+    uint32_t i;
+
+    if (in_len == 0)
+    {
+        a_W25qModel_Fail("frame without a command", 0);
+    }
+    command = in_buf[0];
+    address_len = a_W25qModel_AddressLength(command);
+    skip = 1 + address_len;
+    if ((command == 0x0B) || (command == 0x0C) || (command == 0x48))
+    {
+        skip++;                                                     // dummy byte
+    }
+    if (in_len < skip)
+    {
+        a_W25qModel_Fail("frame shorter than its address", command);
+    }
+    for (i = 0; i < address_len; i++)
+    {
+        address = (address << 8) | in_buf[1 + i];
+    }
+    a_W25qModel_Execute(command, address, address_len, &in_buf[skip], in_len - skip, out_buf, out_len, 1,
+                        a_W25qModel_BusUs((in_len + out_len) * 8));
+}
+
+void w25qModelFrame(uint8_t instruction, uint8_t instruction_line,
+                    uint32_t address, uint8_t address_line, uint8_t address_len,
+                    uint32_t alternate, uint8_t alternate_line, uint8_t alternate_len,
+                    uint8_t dummy, const uint8_t *in_buf, uint32_t in_len,
+                    uint8_t *out_buf, uint32_t out_len, uint8_t data_line)
+{
+    uint8_t quad = ((instruction == 0xEB) || (instruction == 0xEC)) ? 1 : 0;
+    uint8_t dual = ((instruction == 0xBB) || (instruction == 0xBC)) ? 1 : 0;
+    uint32_t cycles;
+
+    (void)alternate;
+
+    if (instruction_line != 1)
+    {
+        a_W25qModel_Fail("only the SPI instruction phase is modelled, not QPI", instruction);
+    }
+    if (quad && ((address_line != 4) || (data_line != 4) || (alternate_len != 1) || (alternate_line != 4) || (dummy != 4)))
+    {
+        a_W25qModel_Fail("fast read quad I/O needs 4 line address, mode and data and 4 dummy clocks", instruction);
+    }
+    if (dual && ((address_line != 2) || (data_line != 2) || (alternate_len != 1) || (alternate_line != 2) || (dummy != 0)))
+    {
+        a_W25qModel_Fail("fast read dual I/O needs 2 line address, mode and data", instruction);
+    }
+    if ((address_len != 0) && (address_len != a_W25qModel_AddressLength(instruction)))
+    {
+        a_W25qModel_Fail("address length does not match the address mode", instruction);
+    }
+    if ((in_len != 0) && (out_len != 0))
+    {
+        a_W25qModel_Fail("frame with two data phases", instruction);
+    }
+
+    cycles = 8 + dummy;
+    cycles += (address_len != 0) ? (address_len * 8) / ((address_line != 0) ? address_line : 1) : 0;
+    cycles += (alternate_len != 0) ? (alternate_len * 8) / ((alternate_line != 0) ? alternate_line : 1) : 0;
+    cycles += ((in_len + out_len) * 8) / ((data_line != 0) ? data_line : 1);
+    a_W25qModel_Execute(instruction, address, address_len, in_buf, in_len, out_buf, out_len,
+                        (data_line != 0) ? data_line : 1, a_W25qModel_BusUs(cycles));
+}
+
+static uint8_t a_W25qModel_SpiInit(void *descr)
+{
+    (void)descr;
+
+    return 0;
+}
+
+static uint8_t a_W25qModel_Transfer(void *descr, uint8_t instruction, uint8_t instruction_line,
+                                    uint32_t address, uint8_t address_line, uint8_t address_len,
+                                    uint32_t alternate, uint8_t alternate_line, uint8_t alternate_len,
+                                    uint8_t dummy, uint8_t *in_buf, uint32_t in_len,
+                                    uint8_t *out_buf, uint32_t out_len, uint8_t data_line)
+{
+    (void)descr;
+
+    if (instruction_line == 0)
+    {
+        w25qModelSpiTransfer(in_buf, in_len, out_buf, out_len);
+    }
+    else
+    {
+        w25qModelFrame(instruction, instruction_line, address, address_line, address_len,
+                       alternate, alternate_line, alternate_len, dummy, in_buf, in_len,
+                       out_buf, out_len, data_line);
+    }
+
+    return 0;
+}
+
+static void a_W25qModel_DelayMs(void *descr, uint32_t ms)
+{
+    (void)descr;
+
+    a_W25qModel_Elapse((uint64_t)ms * 1000u);
+    w25qModelDelayUs += (uint64_t)ms * 1000u;
+}
+
+static void a_W25qModel_DelayUs(void *descr, uint32_t us)
+{
+    (void)descr;
+
+    a_W25qModel_Elapse(us);
+    w25qModelDelayUs += us;
+}
+
+static void a_W25qModel_DebugPrint(void *descr, const char *const fmt, ...)
+{
+    va_list args;
+
+    (void)descr;
+
+    va_start(args, fmt);
+    vprintf(fmt, args);
+    va_end(args);
+}
+
+void w25qModelLink(w25qxx_handle_t *handle)
+{
+    DRIVER_W25QXX_LINK_INIT(handle, w25qxx_handle_t);
+    DRIVER_W25QXX_LINK_SPI_QSPI_INIT(handle, a_W25qModel_SpiInit);
+    DRIVER_W25QXX_LINK_SPI_QSPI_DEINIT(handle, a_W25qModel_SpiInit);
+    DRIVER_W25QXX_LINK_SPI_QSPI_WRITE_READ(handle, a_W25qModel_Transfer);
+    DRIVER_W25QXX_LINK_DELAY_MS(handle, a_W25qModel_DelayMs);
+    DRIVER_W25QXX_LINK_DELAY_US(handle, a_W25qModel_DelayUs);
+    DRIVER_W25QXX_LINK_DEBUG_PRINT(handle, a_W25qModel_DebugPrint);
+}
+
+uint8_t w25qModelRestart(w25qxx_handle_t *handle)
+{
+    a_W25qModel_PowerUp();
+    w25qModelLink(handle);
+    w25qxx_set_type(handle, w25qModelType);
+    w25qxx_set_interface(handle, W25QXX_INTERFACE_SPI);
+    w25qxx_set_dual_quad_spi(handle, W25QXX_BOOL_FALSE);
+
+    return w25qxx_init(handle);
+}
+
+uint8_t w25qModelInit(w25qxx_handle_t *handle, w25qxx_type_t type)
+{
+    w25qModelType = type;
+    w25qModelBytes = (type >= W25Q256) ? (32u * 1024u * 1024u) : (16u * 1024u * 1024u);
+    memset(w25qModelMemory, 0xFF, sizeof(w25qModelMemory));
+    memset(w25qModelStatusNv, 0, sizeof(w25qModelStatusNv));
+    w25qModelResetCounters();
+
+    return w25qModelRestart(handle);
+}
+
+uint8_t *w25qModelArray(void)
+{
+    return w25qModelMemory;
+}
+
+uint32_t w25qModelSize(void)
+{
+    return w25qModelBytes;
+}
+
+void w25qModelResetCounters(void)
+{
+    memset(w25qModelCommands, 0, sizeof(w25qModelCommands));
+    w25qModelReads = 0;
+    w25qModelPrograms = 0;
+    w25qModelErases = 0;
+    w25qModelStatusPolls = 0;
+    w25qModelDelayUs = 0;
+    w25qModelSuspends = 0;
+    w25qModelResumeToSuspendMinUs = UINT32_MAX;
+    w25qModelReadWhileSuspendedMaxUs = 0;
+}
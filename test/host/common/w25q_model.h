@@ -0,0 +1,85 @@
+/*
+ * w25q_model.h
+ *
+ * Host model of a W25Q128 or W25Q256 behind driver_w25qxx.c. The array is a
+ * RAM image. The model takes the raw single line buffers of the standard SPI
+ * interface as well as the framed commands of the dual/quad SPI mode, so it
+ * can sit under the driver directly or under a model of the bus peripheral.
+ *
+ * Programs and erases keep the chip busy for their typical datasheet time,
+ * reads take the bus time of the transfer. Time is kept in w25qModelTimeUs;
+ * the delays of the driver advance it, a test may advance it on its own.
+ * Anything the chip would refuse or garble, e.g. a command while busy, a
+ * program without write enable or a quad read without the QE bit, ends the
+ * test with an error. The security registers only take the erase time, their
+ * contents are not modelled.
+ */
+
+#ifndef W25Q_MODEL_H_
+#define W25Q_MODEL_H_
+
+#include <stdint.h>
+#include "driver_w25qxx.h"
+
+#define W25Q_MODEL_MAX_SIZE     (32u * 1024u * 1024u)
+
+#define W25Q_MODEL_SR2_QE       0x02        // status register 2 quad enable
+#define W25Q_MODEL_SR2_SUS      0x80        // status register 2 suspend
+
+extern uint64_t w25qModelTimeUs;            // model time, bus transfers, status polls and driver delays
+extern uint32_t w25qModelBusMhz;            // SCK
+extern int w25qModelRealTime;               // reads, programs and driver delays also sleep, for threaded benchmarks
+
+// Busy times, changed by a test to model a slow or hung chip
+extern uint32_t w25qModelProgramUs;
+extern uint32_t w25qModelErase4kUs;
+extern uint32_t w25qModelErase32kUs;
+extern uint32_t w25qModelErase64kUs;
+extern uint32_t w25qModelEraseChipUs;
+extern uint32_t w25qModelWriteStatusUs;
+extern uint32_t w25qModelVolatileStatusUs;  // 0, a volatile status register write does not set BUSY
+extern uint32_t w25qModelSuspendUs;         // tSUS, a read sooner after a suspend fails
+
+// Counters since w25qModelResetCounters()
+extern uint32_t w25qModelCommands[256];     // by opcode
+extern uint32_t w25qModelReads;             // read commands of any width
+extern uint32_t w25qModelPrograms;          // page programs
+extern uint32_t w25qModelErases;            // sector, block and chip erases
+extern uint32_t w25qModelStatusPolls;       // status register 1 reads
+extern uint64_t w25qModelDelayUs;           // time spent in the delay_ms/delay_us callbacks
+extern uint32_t w25qModelSuspends;
+extern uint32_t w25qModelResumeToSuspendMinUs;  // shortest erase progress between a resume and the next suspend
+extern uint32_t w25qModelReadWhileSuspendedMaxUs;  // longest time the chip stayed suspended
+
+extern uint8_t w25qModelLastRead;           // opcode of the last read
+extern uint8_t w25qModelLastReadLines;      // data lines of the last read
+
+// Erase the array, link the handle to the model and initialize the driver as a chip of the
+// given type, W25Q128 or W25Q256, on the standard SPI interface. Returns the w25qxx_init() result.
+uint8_t w25qModelInit(w25qxx_handle_t *handle, w25qxx_type_t type);
+
+// Power cycle: the array is kept, the volatile state is lost. Links and initializes the driver
+// like w25qModelInit().
+uint8_t w25qModelRestart(w25qxx_handle_t *handle);
+
+// Link the callbacks of a handle to the model, without initializing the driver
+void w25qModelLink(w25qxx_handle_t *handle);
+
+// One CS-framed command of the standard SPI interface: in_buf is clocked out, then out_len bytes in
+void w25qModelSpiTransfer(const uint8_t *in_buf, uint32_t in_len, uint8_t *out_buf, uint32_t out_len);
+
+// One framed command, the arguments of spi_qspi_write_read()
+void w25qModelFrame(uint8_t instruction, uint8_t instruction_line,
+                    uint32_t address, uint8_t address_line, uint8_t address_len,
+                    uint32_t alternate, uint8_t alternate_line, uint8_t alternate_len,
+                    uint8_t dummy, const uint8_t *in_buf, uint32_t in_len,
+                    uint8_t *out_buf, uint32_t out_len, uint8_t data_line);
+
+// The array, W25Q_MODEL_MAX_SIZE bytes of which the chip size is used
+uint8_t *w25qModelArray(void);
+uint32_t w25qModelSize(void);
+
+int w25qModelBusy(void);
+void w25qModelResetCounters(void);
+
+#endif /* W25Q_MODEL_H_ */
@@ -0,0 +1,227 @@
+/*
+ * offload_test.c
+ *
+ * Sends TCP and UDP datagrams through ipv4SendDatagram() on an interface whose
+ * NIC driver does or does not calculate checksums (autoChecksumCalc) and checks
+ * what reaches ethSendFrame(): with offload the checksum fields are left zero
+ * for the GMAC, without it (PPP, NICs without offload) and for fragmented or
+ * looped-back datagrams the IP layer fills them in. Exits with 1 on failure.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include "core/net.h"
+#include "core/ip.h"
+#include "core/tcp.h"
+#include "core/udp.h"
+#include "ipv4/ipv4.h"
+#include "ipv4/ipv4_misc.h"
+#include "ipv6/ipv6_misc.h"
+
+#define OFFLOAD_TEST_RUNS   2000
+#define OFFLOAD_TEST_MTU    1500
+
+// what ethSendFrame() got, the fragments of one datagram in order
+typedef struct
+{
+   uint_t count;
+   bool_t deferChecksum[8];
+   uint8_t packet[8][OFFLOAD_TEST_MTU];
+   size_t length[8];
+} OffloadTestCapture;
+
+static OffloadTestCapture capture;
+static NicDriver nicDriver;
+static uint_t failures;
+
+
+// the stack pieces the IPv4 send path needs below the IP layer, from files not linked
+
+const MacAddr MAC_UNSPECIFIED_ADDR = {{{0x00, 0x00, 0x00, 0x00, 0x00, 0x00}}};
+const MacAddr MAC_BROADCAST_ADDR = {{{0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF}}};
+const Ipv6Addr IPV6_UNSPECIFIED_ADDR = IPV6_ADDR(0, 0, 0, 0, 0, 0, 0, 0);
+const Ipv6Addr IPV6_LOOPBACK_ADDR = IPV6_ADDR(0, 0, 0, 0, 0, 0, 0, 1);
+NetContext netContext;
+
+void *osAllocMem(size_t size)
+{
+   return malloc(size);
+}
+
+void osFreeMem(void *p)
+{
+   free(p);
+}
+
+NetInterface *nicGetPhysicalInterface(NetInterface *interface)
+{
+   return interface;
+}
+
+NetBuffer *ethAllocBuffer(size_t length, size_t *offset)
+{
+   NetBuffer *buffer;
+
+   buffer = netBufferAlloc(length + sizeof(EthHeader));
+   *offset = sizeof(EthHeader);
+   return buffer;
+}
+
+error_t ethSendFrame(NetInterface *interface, const MacAddr *destAddr,
+   uint16_t type, NetBuffer *buffer, size_t offset, NetTxAncillary *ancillary)
+{
+   size_t length = netBufferGetLength(buffer) - offset;
+
+   (void) interface;
+   (void) destAddr;
+   (void) type;
+
+   if(capture.count < 8 && length <= OFFLOAD_TEST_MTU)
+   {
+      capture.deferChecksum[capture.count] = ancillary->deferChecksum;
+      capture.length[capture.count] = netBufferRead(capture.packet[capture.count],
+         buffer, offset, length);
+      capture.count++;
+   }
+   return NO_ERROR;
+}
+
+
+static void a_OffloadTest_Fail(const char *what, bool_t offload, uint8_t protocol, size_t length)
+{
+   if(failures++ < 10)
+   {
+      printf("FAIL %s: offload %d %s %u bytes\n", what, offload,
+         (protocol == IPV4_PROTOCOL_TCP) ? "TCP" : "UDP", (unsigned int) length);
+   }
+}
+
+// Send one datagram and check the checksums on the wire. length is the TCP or UDP message
+static void a_OffloadTest_Send(bool_t offload, uint8_t protocol, size_t length)
+{
+   static uint8_t message[4 * OFFLOAD_TEST_MTU];
+   static uint8_t received[4 * OFFLOAD_TEST_MTU];
+   Ipv4PseudoHeader pseudoHeader;
+   NetTxAncillary ancillary;
+   NetBuffer *buffer;
+   Ipv4Header *packet;
+   size_t checksumOffset = (protocol == IPV4_PROTOCOL_TCP) ? 16 : 6;
+   size_t offset;
+   size_t fragmentOffset;
+   size_t fragmentLength;
+   bool_t fragmented;
+   uint_t i;
+
+   for(i = 0; i < length; i++)
+   {
+      message[i] = (uint8_t) rand();
+   }
+   message[checksumOffset] = 0;
+   message[checksumOffset + 1] = 0;
+
+   buffer = ipAllocBuffer(length, &offset);
+   netBufferWrite(buffer, offset, message, length);
+
+   pseudoHeader.srcAddr = IPV4_ADDR(192, 168, 0, 10);
+   pseudoHeader.destAddr = IPV4_ADDR(192, 168, 0, 20);
+   pseudoHeader.reserved = 0;
+   pseudoHeader.protocol = protocol;
+   pseudoHeader.length = htons(length);
+
+   ancillary = NET_DEFAULT_TX_ANCILLARY;
+   ancillary.destMacAddr.b[0] = 0x02;
+   ancillary.deferChecksum = TRUE;
+
+   nicDriver.autoChecksumCalc = offload;
+   memset(&capture, 0, sizeof(capture));
+   if(ipv4SendDatagram(&netInterface[0], &pseudoHeader, buffer, offset, &ancillary) != NO_ERROR ||
+      capture.count == 0)
+   {
+      a_OffloadTest_Fail("not sent", offload, protocol, length);
+      netBufferFree(buffer);
+      return;
+   }
+   netBufferFree(buffer);
+
+   // put the message back together from the fragments
+   fragmented = (capture.count > 1);
+   for(i = 0; i < capture.count; i++)
+   {
+      packet = (Ipv4Header *) capture.packet[i];
+      fragmentOffset = (ntohs(packet->fragmentOffset) & IPV4_OFFSET_MASK) * 8;
+      fragmentLength = ntohs(packet->totalLength) - packet->headerLength * 4;
+      memcpy(&received[fragmentOffset], capture.packet[i] + packet->headerLength * 4, fragmentLength);
+
+      // the GMAC inserts the IPv4 header checksum into every frame
+      if(offload ? (packet->headerChecksum != 0) :
+         (ipCalcChecksum(packet, packet->headerLength * 4) != 0))
+      {
+         a_OffloadTest_Fail("IPv4 header checksum", offload, protocol, length);
+      }
+   }
+
+   if(offload && !fragmented)
+   {
+      // left to the GMAC, which needs the field zero
+      if(!capture.deferChecksum[0] || received[checksumOffset] != 0 ||
+         received[checksumOffset + 1] != 0)
+      {
+         a_OffloadTest_Fail("checksum not left to the NIC", offload, protocol, length);
+      }
+   }
+   else
+   {
+      // calculated by the IP layer, zero is sent as all ones
+      if(capture.deferChecksum[0] ||
+         (received[checksumOffset] == 0 && received[checksumOffset + 1] == 0) ||
+         ipCalcUpperLayerChecksum(&pseudoHeader, sizeof(pseudoHeader), received, length) != 0)
+      {
+         a_OffloadTest_Fail("software checksum", offload, protocol, length);
+      }
+   }
+}
+
+int main(void)
+{
+   static const Ipv6Addr loopback6 = IPV6_ADDR(0, 0, 0, 0, 0, 0, 0, 1);
+   static const Ipv6Addr remote6 = IPV6_ADDR(0x2001, 0xDB8, 0, 0, 0, 0, 0, 1);
+   bool_t offload;
+   uint8_t protocol;
+   uint_t n;
+
+   nicDriver.type = NIC_TYPE_ETHERNET;
+   nicDriver.mtu = OFFLOAD_TEST_MTU;
+   netInterface[0].nicDriver = &nicDriver;
+   netInterface[0].ipv4Context.linkMtu = OFFLOAD_TEST_MTU;
+   netInterface[0].ipv4Context.addrList[0].addr = IPV4_ADDR(192, 168, 0, 10);
+   netInterface[0].ipv4Context.addrList[0].state = IPV4_ADDR_STATE_VALID;
+   srand(1);
+
+   for(n = 0; n < 2; n++)
+   {
+      offload = (n == 1);
+      nicDriver.autoChecksumCalc = offload;
+
+      // packets looped back inside the host never see the NIC
+      if(ipv4CheckChecksumOffload(&netInterface[0], IPV4_ADDR(127, 0, 0, 1)) ||
+         ipv4CheckChecksumOffload(&netInterface[0], IPV4_ADDR(192, 168, 0, 10)) ||
+         ipv4CheckChecksumOffload(&netInterface[0], IPV4_ADDR(192, 168, 0, 20)) != offload ||
+         ipv6CheckChecksumOffload(&netInterface[0], &loopback6) ||
+         ipv6CheckChecksumOffload(&netInterface[0], &remote6) != offload)
+      {
+         a_OffloadTest_Fail("offload decision", offload, IPV4_PROTOCOL_UDP, 0);
+      }
+   }
+
+   // single frames and fragmented datagrams, both ways
+   for(n = 0; n < OFFLOAD_TEST_RUNS; n++)
+   {
+      offload = (n & 1) ? TRUE : FALSE;
+      protocol = (n & 2) ? IPV4_PROTOCOL_TCP : IPV4_PROTOCOL_UDP;
+      a_OffloadTest_Send(offload, protocol, sizeof(TcpHeader) + (size_t) rand() % (3 * OFFLOAD_TEST_MTU));
+   }
+
+   printf("%u datagrams with and without checksum offload: %s\n", OFFLOAD_TEST_RUNS,
+      (failures == 0) ? "ok" : "FAIL");
+   return (failures == 0) ? 0 : 1;
+}
@@ -0,0 +1,239 @@
+/*
+ * random_test.c
+ *
+ * Compares the word kernel of ip.c, ipCalcChecksumWords(), ipCalcChecksum()
+ * and ipCalcChecksumCopy() with a byte-wise RFC 1071 sum on random data:
+ * every source and destination offset 0 to 7, odd and even lengths, data of
+ * all 0xFF bytes, which carries on every addition, and all 0x00. ip.c is
+ * included to reach the static kernel. The Makefile builds it with the
+ * portable 64-bit kernel and with the ADCS kernel of the Cortex-M, whose
+ * instructions are replaced by the model below on the host. Exits with 1 on
+ * failure.
+ *
+ *   random_test [runs]
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "core/net.h"
+
+#ifdef RANDOM_TEST_ADCS
+
+// adds, adcs, adcs, adcs, adc #0: each addition takes the carry out of the
+// previous one, the last carry is added back
+static uint32_t a_RandomTest_Adc4(uint32_t sum, uint32_t w0, uint32_t w1, uint32_t w2, uint32_t w3)
+{
+   const uint32_t w[4] = {w0, w1, w2, w3};
+   uint32_t carry = 0;
+   uint64_t t;
+   uint_t i;
+
+   for(i = 0; i < 4; i++)
+   {
+      t = (uint64_t) sum + w[i] + carry;
+      sum = (uint32_t) t;
+      carry = (uint32_t) (t >> 32);
+   }
+   return sum + carry;
+}
+
+#define IP_CHECKSUM_ADC4(sum, w0, w1, w2, w3) \
+   ((sum) = a_RandomTest_Adc4((sum), (w0), (w1), (w2), (w3)))
+
+#endif
+
+#include "core/ip.c"
+
+#define RANDOM_TEST_RUNS    20000
+#define RANDOM_TEST_MAX     1600            // bytes, above a full frame
+#define RANDOM_TEST_GUARD   16              // bytes checked around the copy
+
+static uint32_t srcWords[(RANDOM_TEST_MAX + 64) / 4];
+static uint32_t destWords[(RANDOM_TEST_MAX + 64) / 4];
+static uint32_t copyWords[(RANDOM_TEST_MAX + 64) / 4];
+static uint_t failures;
+
+
+static void a_RandomTest_Fail(const char *what, size_t s, size_t d, size_t length)
+{
+   if(failures++ < 10)
+   {
+      printf("FAIL %s, offsets %u and %u, length %u\n", what, (unsigned int) s, (unsigned int) d,
+         (unsigned int) length);
+   }
+}
+
+// RFC 1071 over the bytes, 16-bit words in network order, folded to 16 bits
+static uint16_t a_RandomTest_Sum(const uint8_t *p, size_t length)
+{
+   uint64_t sum = 0;
+   size_t i;
+
+   for(i = 0; i + 1 < length; i += 2)
+   {
+      sum += ((uint32_t) p[i] << 8) | p[i + 1];
+   }
+   if(length & 1)
+   {
+      sum += (uint32_t) p[length - 1] << 8;
+   }
+   while(sum >> 16)
+   {
+      sum = (sum & 0xFFFF) + (sum >> 16);
+   }
+   return (uint16_t) sum;
+}
+
+// A checksum returned by ip.c, in the byte order it is stored in a header
+static uint16_t a_RandomTest_Stored(uint16_t checksum)
+{
+   uint8_t b[2];
+
+   memcpy(b, &checksum, 2);
+   return (uint16_t) ((b[0] << 8) | b[1]);
+}
+
+// 32-bit sum of the kernel folded to 16 bits
+static uint16_t a_RandomTest_Fold(uint32_t sum)
+{
+   while(sum >> 16)
+   {
+      sum = (sum & 0xFFFF) + (sum >> 16);
+   }
+   return (uint16_t) sum;
+}
+
+static void a_RandomTest_Fill(uint8_t *p, size_t length, uint_t pattern)
+{
+   size_t i;
+
+   for(i = 0; i < length; i++)
+   {
+      p[i] = (pattern == 0) ? 0xFF : (pattern == 1) ? 0x00 : (uint8_t) rand();
+   }
+}
+
+// The kernel over n words from a start sum, with and without the copy
+static void a_RandomTest_Words(uint32_t start, size_t n)
+{
+   uint16_t expected;
+   uint16_t sum;
+
+   //The byte-wise sum is in network order, the kernel adds the words as the
+   //CPU loads them
+   expected = a_RandomTest_Fold(a_RandomTest_Fold(start) +
+      a_RandomTest_Stored(a_RandomTest_Sum((const uint8_t *) srcWords, 4 * n)));
+
+   sum = a_RandomTest_Fold(ipCalcChecksumWords(start, srcWords, NULL, n));
+   if(sum != expected)
+   {
+      a_RandomTest_Fail("ipCalcChecksumWords()", 0, 0, 4 * n);
+   }
+
+   memset(destWords, 0x5A, sizeof(destWords));
+   if(a_RandomTest_Fold(ipCalcChecksumWords(start, srcWords, destWords, n)) != sum)
+   {
+      a_RandomTest_Fail("ipCalcChecksumWords() with copy", 0, 0, 4 * n);
+   }
+   if(memcmp(destWords, srcWords, 4 * n) != 0 || ((const uint8_t *) destWords)[4 * n] != 0x5A)
+   {
+      a_RandomTest_Fail("words copied", 0, 0, 4 * n);
+   }
+}
+
+// ipCalcChecksum() and ipCalcChecksumCopy() over length bytes at src offset s,
+// copied to dest offset d
+static void a_RandomTest_Bytes(size_t s, size_t d, size_t length)
+{
+   uint8_t *src = (uint8_t *) srcWords + s;
+   uint8_t *dest = (uint8_t *) copyWords + RANDOM_TEST_GUARD + d;
+   uint16_t expected;
+   size_t i;
+
+   expected = a_RandomTest_Sum(src, length) ^ 0xFFFF;
+
+   if(a_RandomTest_Stored(ipCalcChecksum(src, length)) != expected)
+   {
+      a_RandomTest_Fail("ipCalcChecksum()", s, 0, length);
+   }
+
+   memset(copyWords, 0x5A, sizeof(copyWords));
+   if(a_RandomTest_Stored(ipCalcChecksumCopy(dest, src, length)) != expected)
+   {
+      a_RandomTest_Fail("ipCalcChecksumCopy()", s, d, length);
+   }
+   if(memcmp(dest, src, length) != 0)
+   {
+      a_RandomTest_Fail("bytes copied", s, d, length);
+   }
+   for(i = 1; i <= RANDOM_TEST_GUARD; i++)
+   {
+      if(dest[-(ptrdiff_t) i] != 0x5A || dest[length + i - 1] != 0x5A)
+      {
+         a_RandomTest_Fail("bytes around the copy", s, d, length);
+         break;
+      }
+   }
+}
+
+int main(int argc, char **argv)
+{
+   uint_t runs = RANDOM_TEST_RUNS;
+   uint_t pattern;
+   uint_t i;
+   size_t length;
+   size_t s;
+   size_t d;
+
+   if(argc > 1)
+   {
+      runs = (uint_t) atoi(argv[1]);
+   }
+   srand(1071);
+
+#ifdef RANDOM_TEST_ADCS
+   printf("ADCS kernel (host model of the instructions), %u runs\n", runs);
+#else
+   printf("portable 64-bit kernel, %u runs\n", runs);
+#endif
+
+   //Every offset pair and every short length, all 0xFF and all 0x00
+   for(pattern = 0; pattern < 2; pattern++)
+   {
+      a_RandomTest_Fill((uint8_t *) srcWords, sizeof(srcWords), pattern);
+      for(s = 0; s < 8; s++)
+      {
+         for(d = 0; d < 8; d++)
+         {
+            for(length = 0; length <= 64; length++)
+            {
+               a_RandomTest_Bytes(s, d, length);
+            }
+         }
+      }
+      //A start sum below the number of 0xFFFFFFFF words carries out of the
+      //first fold of the 64-bit kernel
+      for(length = 0; length <= 64; length++)
+      {
+         a_RandomTest_Words(0, length);
+         a_RandomTest_Words(1, length);
+         a_RandomTest_Words(0xFFFFFFFF, length);
+      }
+   }
+
+   //Random data, offsets, lengths and start sums, one run in four all 0xFF
+   for(i = 0; i < runs; i++)
+   {
+      pattern = ((i & 3) == 0) ? 0 : 2;
+      length = (size_t) rand() % (RANDOM_TEST_MAX + 1);
+      s = (size_t) rand() % 8;
+      d = (size_t) rand() % 8;
+      a_RandomTest_Fill((uint8_t *) srcWords, length + s + 4, pattern);
+      a_RandomTest_Bytes(s, d, length);
+      a_RandomTest_Words(((uint32_t) rand() << 16) ^ (uint32_t) rand(), length / 4);
+   }
+
+   printf("%s\n", (failures == 0) ? "ok" : "FAIL");
+   return (failures == 0) ? 0 : 1;
+}
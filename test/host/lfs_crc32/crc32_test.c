@@ -0,0 +1,143 @@
+/*
+ * crc32_test.c
+ *
+ * Checks the slice-by-4 and slice-by-8 CRC-32 engines against the littlefs
+ * reference lfs_crc() on random buffers of random alignment and length, then
+ * prints the throughput of each in MB/s. Exits with 1 on the first mismatch.
+ */
+
+#include <stdint.h>
+#include <stddef.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+
+#define CRC32_TEST_RUNS         200000
+#define CRC32_TEST_BENCH_BYTES  (64u << 20)     // hashed per engine and buffer size
+
+typedef uint32_t (*Crc32_Fn)(uint32_t crc, const void *buffer, size_t size);
+
+uint32_t lfs_crc(uint32_t crc, const void *buffer, size_t size);               // lfs_util.c
+uint32_t Lfs_Crc32_Slice4(uint32_t crc, const void *buffer, size_t size);      // lfs_crc32.c, engine 1
+uint32_t Lfs_Crc32_Slice8(uint32_t crc, const void *buffer, size_t size);      // lfs_crc32.c, engine 2
+
+static const struct
+{
+    const char *name;
+    Crc32_Fn crc;
+} engines[] =
+{
+    { "reference", lfs_crc },
+    { "slice-by-4", Lfs_Crc32_Slice4 },
+    { "slice-by-8", Lfs_Crc32_Slice8 },
+};
+
+#define CRC32_TEST_ENGINES  (sizeof(engines) / sizeof(engines[0]))
+
+static uint8_t buffer[8192 + 8] __attribute__((aligned(8)));
+
+
+static double a_Crc32Test_Now(void)
+{
+    struct timespec t;
+
+    clock_gettime(CLOCK_MONOTONIC, &t);
+    return (double)t.tv_sec + ((double)t.tv_nsec / 1e9);
+}
+
+// All engines must agree on the buffer, each computing it in one call and the CRC must carry
+// over a split, as littlefs feeds a block in several calls
+static int a_Crc32Test_Compare(uint32_t seed, const uint8_t *p, size_t size, size_t split)
+{
+    uint32_t expected = lfs_crc(seed, p, size);
+    uint32_t crc;
+    size_t i;
+
+    for (i = 1; i < CRC32_TEST_ENGINES; i++)
+    {
+        crc = engines[i].crc(seed, p, size);
+        if (crc != expected)
+        {
+            printf("FAIL %s: seed %08x offset %u size %u: %08x, expected %08x\n", engines[i].name,
+                   (unsigned int)seed, (unsigned int)(p - buffer), (unsigned int)size, (unsigned int)crc, (unsigned int)expected);
+            return 1;
+        }
+        crc = engines[i].crc(engines[i].crc(seed, p, split), p + split, size - split);
+        if (crc != expected)
+        {
+            printf("FAIL %s: seed %08x offset %u size %u split at %u: %08x, expected %08x\n", engines[i].name,
+                   (unsigned int)seed, (unsigned int)(p - buffer), (unsigned int)size, (unsigned int)split,
+                   (unsigned int)crc, (unsigned int)expected);
+            return 1;
+        }
+    }
+    return 0;
+}
+
+int main(void)
+{
+    static const size_t sizes[] = { 16, 64, 512, 4096 };
+    volatile uint32_t sink = 0;
+    uint32_t crc;
+    size_t offset;
+    size_t size;
+    size_t i;
+    size_t j;
+    long n;
+    long runs;
+    double t;
+
+    srand(1);
+    for (i = 0; i < sizeof(buffer); i++)
+    {
+        buffer[i] = (uint8_t)rand();
+    }
+
+    // the CRC-32 check value, littlefs takes no final xor
+    for (i = 0; i < CRC32_TEST_ENGINES; i++)
+    {
+        crc = ~engines[i].crc(0xFFFFFFFF, "123456789", 9);
+        if (0xCBF43926 != crc)
+        {
+            printf("FAIL %s: check value %08x, expected cbf43926\n", engines[i].name, (unsigned int)crc);
+            return 1;
+        }
+    }
+
+    // short and block sized buffers, every alignment
+    for (n = 0; n < CRC32_TEST_RUNS; n++)
+    {
+        offset = (size_t)rand() % 8;
+        size = (size_t)rand() % ((n & 1) ? 72 : 8192);
+        if (0 != a_Crc32Test_Compare((uint32_t)rand() * 2654435761u, &buffer[offset], size,
+                                     (0 == size) ? 0 : ((size_t)rand() % size)))
+        {
+            return 1;
+        }
+    }
+    printf("%d random buffers: reference, slice-by-4 and slice-by-8 agree\n", CRC32_TEST_RUNS);
+
+    printf("%-10s", "bytes");
+    for (i = 0; i < CRC32_TEST_ENGINES; i++)
+    {
+        printf(" %14s", engines[i].name);
+    }
+    printf("   MB/s\n");
+    for (j = 0; j < (sizeof(sizes) / sizeof(sizes[0])); j++)
+    {
+        runs = (long)(CRC32_TEST_BENCH_BYTES / sizes[j]);
+        printf("%-10u", (unsigned int)sizes[j]);
+        for (i = 0; i < CRC32_TEST_ENGINES; i++)
+        {
+            t = a_Crc32Test_Now();
+            for (n = 0; n < runs; n++)
+            {
+                sink = engines[i].crc(sink, buffer, sizes[j]);
+            }
+            t = a_Crc32Test_Now() - t;
+            printf(" %14.1f", ((double)CRC32_TEST_BENCH_BYTES / 1e6) / t);
+        }
+        printf("\n");
+    }
+    return 0;
+}
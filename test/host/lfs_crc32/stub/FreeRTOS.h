@@ -0,0 +1,15 @@
+/*
+ * FreeRTOS.h
+ *
+ * Host stand-in for the heap hooks lfs_util.h takes from FreeRTOS.
+ */
+
+#ifndef FREERTOS_H_STUB_
+#define FREERTOS_H_STUB_
+
+#include <stdlib.h>
+
+#define pvPortMalloc    malloc
+#define vPortFree       free
+
+#endif /* FREERTOS_H_STUB_ */
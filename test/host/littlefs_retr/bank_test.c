@@ -0,0 +1,383 @@
+/*
+ * bank_test.c
+ *
+ * Host test of the littlefs banks of littlefs_startup.c on the W25Q128 flash
+ * model of w25q_model.c. The Makefile builds it with LITTLEFS_BANKS 2 as
+ * bank_test and with 1 as bank_test_single.
+ *
+ * Littlefs_Startup() mounts once per process, so every boot is a child
+ * process on the chip image the one before left in shared memory, and the
+ * banks are looked at between boots with a plain littlefs mount of their
+ * part of the chip. With two banks the first boot formats both and makes
+ * bank 0 active; a swap must fail while a file is open in the staging bank,
+ * then give the other bank generation 1 in its root attribute, and every
+ * later swap the next generation, the old bank keeping its own. Each reboot
+ * must mount the bank with the highest generation, its files under "/" and
+ * the other bank's under LITTLEFS_STAGING_DIR. With one bank the swap fails.
+ *
+ * A chip holding a volume of the other layout, one bank for the build with
+ * two and the other way round, must not mount, and must be left as it was:
+ * no program, no erase.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/wait.h>
+#include "w25q_model.h"
+#include "w25qxx_sched.h"
+#include "littlefs_startup.h"
+#include "lfs_w25qxx_stripe.h"
+#include "lfs_w25qxx_preerase.h"
+
+#define BANK_TEST_BLOCKS        4096                    // W25Q128, 4 KiB blocks
+#define BANK_TEST_CHIP_SIZE     (BANK_TEST_BLOCKS * 4096u)
+#define BANK_TEST_ATTR          0x42                    // LFS_BANK_ATTR
+#define BANK_TEST_NO_ATTR       0xFFFFFFFFu             // bank never made active
+#define BANK_TEST_OTHER_BANKS   ((LITTLEFS_BANKS == 1) ? 2 : 1)
+
+// Survives the child processes
+typedef struct
+{
+    uint8_t chip[BANK_TEST_CHIP_SIZE];
+    uint32_t generation[2];                             // read from the banks by a_BankTest_Generations()
+} BankTestShared_s;
+
+w25qxx_sched_t w25q128_sched;
+uint32_t nvmctrlModelSeeprom[1024];
+uint32_t nvmctrlModelSeestat;
+
+static w25qxx_sched_t *const bankTestChips[] = {&w25q128_sched};
+static BankTestShared_s *bankTestShared;
+static w25qxx_handle_t w25q128Handle;
+static Lfs_W25qxxStripe_s bankTestStripe;
+static struct lfs_config bankTestCfg;
+static lfs_t bankTestLfs;
+static uint8_t bankTestReadBuffer[512];
+static uint8_t bankTestProgBuffer[512];
+static uint32_t bankTestLookahead[512 / sizeof(uint32_t)];
+static unsigned int failures;
+
+
+static void a_BankTest_Fail(const char *what, uint32_t value)
+{
+    if (failures++ < 10)
+    {
+        printf("FAIL %s, %u\n", what, (unsigned int)value);
+    }
+}
+
+static uint32_t a_BankTest_TimestampUs(void)
+{
+    return (uint32_t)w25qModelTimeUs;
+}
+
+// Power up on the chip image in shared memory, or on an erased chip
+static int a_BankTest_PowerUp(int blank)
+{
+    if (w25qModelInit(&w25q128Handle, W25Q128) != 0)
+    {
+        return 1;
+    }
+    if (!blank)
+    {
+        memcpy(w25qModelArray(), bankTestShared->chip, BANK_TEST_CHIP_SIZE);
+        if (w25qModelRestart(&w25q128Handle) != 0)
+        {
+            return 1;
+        }
+    }
+    return (w25qxx_sched_init(&w25q128_sched, &w25q128Handle, a_BankTest_TimestampUs) != 0) ? 1 : 0;
+}
+
+// A plain littlefs of bank index of a layout of banks banks, configured as littlefs_startup.c does
+static int a_BankTest_Raw(uint32_t banks, uint32_t index, int format)
+{
+    bankTestStripe.chips = bankTestChips;
+    bankTestStripe.chipsNumber = 1;
+    bankTestStripe.chipBlockCount = BANK_TEST_BLOCKS;
+    bankTestStripe.firstBlock = index * (BANK_TEST_BLOCKS / banks);
+    memset(&bankTestCfg, 0, sizeof(bankTestCfg));
+    bankTestCfg.context = &bankTestStripe;
+    bankTestCfg.read = Lfs_W25qxxStripe_Read;
+    bankTestCfg.prog = Lfs_W25qxxStripe_Prog;
+    bankTestCfg.erase = Lfs_W25qxxStripe_Erase;
+    bankTestCfg.sync = Lfs_W25qxxStripe_Sync;
+    bankTestCfg.read_size = 16;
+    bankTestCfg.prog_size = 256;
+    bankTestCfg.block_size = LITTLEFS_BLOCK_SIZE;
+    bankTestCfg.block_count = BANK_TEST_BLOCKS / banks;
+    bankTestCfg.cache_size = LITTLEFS_CACHE_SIZE;
+    bankTestCfg.lookahead_size = sizeof(bankTestLookahead);
+    bankTestCfg.block_cycles = 500;
+    bankTestCfg.read_buffer = bankTestReadBuffer;
+    bankTestCfg.prog_buffer = bankTestProgBuffer;
+    bankTestCfg.lookahead_buffer = bankTestLookahead;
+
+    if (format && (lfs_format(&bankTestLfs, &bankTestCfg) != 0))
+    {
+        return 1;
+    }
+    return (lfs_mount(&bankTestLfs, &bankTestCfg) != 0) ? 1 : 0;
+}
+
+// Write a small file, or check it reads back, through the service
+static void a_BankTest_File(const char *path, const char *text, int write)
+{
+    char data[32];
+    lfs_file_t file;
+    size_t length = 0;
+
+    if (Littlefs_FileOpen(&file, path, write ? (LFS_O_WRONLY | LFS_O_CREAT | LFS_O_TRUNC) : LFS_O_RDONLY) != 0)
+    {
+        a_BankTest_Fail(write ? "create file" : "open file", 0);
+        printf("     %s\n", path);
+        return;
+    }
+    if (write)
+    {
+        if (Littlefs_FileWrite(&file, text, strlen(text)) != 0)
+        {
+            a_BankTest_Fail("write file", 0);
+        }
+    }
+    else if ((Littlefs_FileRead(&file, data, sizeof(data), &length) != 0) || (length != strlen(text)) ||
+             (memcmp(data, text, length) != 0))
+    {
+        a_BankTest_Fail("file read back", (uint32_t)length);
+        printf("     %s\n", path);
+    }
+    Littlefs_FileClose(&file);
+}
+
+#if (LITTLEFS_BANKS == 2)
+static void a_BankTest_Missing(const char *path)
+{
+    if (Littlefs_FileExists(path))
+    {
+        a_BankTest_Fail("file in the wrong bank", 0);
+        printf("     %s\n", path);
+    }
+}
+
+// Stop the pool, it may be erasing a free block, and leave the chip for the next boot
+static void a_BankTest_PowerDown(void)
+{
+    Lfs_W25qxxPreErase_Stop();
+    memcpy(bankTestShared->chip, w25qModelArray(), BANK_TEST_CHIP_SIZE);
+}
+
+// Generations of both banks into the shared memory
+static void a_BankTest_Generations(void)
+{
+    uint32_t i;
+
+    if (a_BankTest_PowerUp(0) != 0)
+    {
+        a_BankTest_Fail("power up", 0);
+        return;
+    }
+    for (i = 0; i < 2; i++)
+    {
+        bankTestShared->generation[i] = BANK_TEST_NO_ATTR;
+        if (a_BankTest_Raw(2, i, 0) != 0)
+        {
+            a_BankTest_Fail("raw mount of a bank", i);
+            continue;
+        }
+        if (lfs_getattr(&bankTestLfs, "/", BANK_TEST_ATTR, &bankTestShared->generation[i], sizeof(uint32_t)) !=
+            (lfs_ssize_t)sizeof(uint32_t))
+        {
+            bankTestShared->generation[i] = BANK_TEST_NO_ATTR;
+        }
+        (void)lfs_unmount(&bankTestLfs);
+    }
+}
+
+// First boot: both banks formatted, bank 0 active, a file in each, one swap
+static void a_BankTest_First(void)
+{
+    lfs_file_t file;
+
+    if ((a_BankTest_PowerUp(1) != 0) || (Littlefs_Startup() != 0))
+    {
+        a_BankTest_Fail("first boot", 0);
+        return;
+    }
+    a_BankTest_File("/a.txt", "active since the format", 1);
+    a_BankTest_File(LITTLEFS_STAGING_DIR "/b.txt", "staged", 1);
+    a_BankTest_Missing("/b.txt");
+
+    if ((Littlefs_FileOpen(&file, LITTLEFS_STAGING_DIR "/c.txt", LFS_O_WRONLY | LFS_O_CREAT) != 0) ||
+        (Littlefs_BankSwap() == 0))
+    {
+        a_BankTest_Fail("swap with a file open in the staging bank", 0);
+    }
+    Littlefs_FileClose(&file);
+    a_BankTest_File("/a.txt", "active since the format", 0);
+
+    if (Littlefs_BankSwap() != 0)
+    {
+        a_BankTest_Fail("swap", 1);
+    }
+    a_BankTest_File("/b.txt", "staged", 0);
+    a_BankTest_File(LITTLEFS_STAGING_DIR "/a.txt", "active since the format", 0);
+    a_BankTest_Missing("/a.txt");
+    a_BankTest_PowerDown();
+}
+
+// Later boots: the bank of the last swap is active, then swap back
+static void a_BankTest_Reboot(void)
+{
+    int even = (bankTestShared->generation[0] != BANK_TEST_NO_ATTR) &&
+               (bankTestShared->generation[0] > bankTestShared->generation[1]);
+
+    if ((a_BankTest_PowerUp(0) != 0) || (Littlefs_Startup() != 0))
+    {
+        a_BankTest_Fail("reboot", 0);
+        return;
+    }
+    a_BankTest_File(even ? "/a.txt" : "/b.txt", even ? "active since the format" : "staged", 0);
+    a_BankTest_File(even ? (LITTLEFS_STAGING_DIR "/b.txt") : (LITTLEFS_STAGING_DIR "/a.txt"),
+                    even ? "staged" : "active since the format", 0);
+    a_BankTest_Missing(even ? "/b.txt" : "/a.txt");
+    if (Littlefs_BankSwap() != 0)
+    {
+        a_BankTest_Fail("swap after a reboot", 0);
+    }
+    a_BankTest_File(even ? "/b.txt" : "/a.txt", even ? "staged" : "active since the format", 0);
+    a_BankTest_PowerDown();
+}
+#else
+// One bank: nothing to swap
+static void a_BankTest_Single(void)
+{
+    if ((a_BankTest_PowerUp(1) != 0) || (Littlefs_Startup() != 0))
+    {
+        a_BankTest_Fail("first boot", 0);
+        return;
+    }
+    a_BankTest_File("/a.txt", "the only bank", 1);
+    if (Littlefs_BankSwap() == 0)
+    {
+        a_BankTest_Fail("swap with one bank", 0);
+    }
+    a_BankTest_File("/a.txt", "the only bank", 0);
+}
+#endif
+
+// A blank chip with a volume of the other layout, a file in each of its banks
+static void a_BankTest_Other(void)
+{
+    lfs_file_t file;
+    uint32_t i;
+
+    if (a_BankTest_PowerUp(1) != 0)
+    {
+        a_BankTest_Fail("power up", 0);
+        return;
+    }
+    for (i = 0; i < BANK_TEST_OTHER_BANKS; i++)
+    {
+        if ((a_BankTest_Raw(BANK_TEST_OTHER_BANKS, i, 1) != 0) ||
+            (lfs_file_open(&bankTestLfs, &file, "keep.txt", LFS_O_WRONLY | LFS_O_CREAT) != 0) ||
+            (lfs_file_write(&bankTestLfs, &file, "other layout", 12) != 12) ||
+            (lfs_file_close(&bankTestLfs, &file) != 0) || (lfs_unmount(&bankTestLfs) != 0))
+        {
+            a_BankTest_Fail("volume of the other layout", i);
+        }
+    }
+    memcpy(bankTestShared->chip, w25qModelArray(), BANK_TEST_CHIP_SIZE);
+}
+
+// Boot on it: the mount fails and the chip is left alone
+static void a_BankTest_Mismatch(void)
+{
+    if (a_BankTest_PowerUp(0) != 0)
+    {
+        a_BankTest_Fail("power up", 0);
+        return;
+    }
+    w25qModelResetCounters();
+    if (Littlefs_Startup() == 0)
+    {
+        a_BankTest_Fail("volume of the other layout mounted", BANK_TEST_OTHER_BANKS);
+    }
+    if ((w25qModelPrograms != 0) || (w25qModelErases != 0) ||
+        (memcmp(w25qModelArray(), bankTestShared->chip, BANK_TEST_CHIP_SIZE) != 0))
+    {
+        a_BankTest_Fail("volume of the other layout written to, programs", w25qModelPrograms);
+    }
+    if (Littlefs_FileExists("/keep.txt"))
+    {
+        a_BankTest_Fail("file service up after a failed mount", 0);
+    }
+}
+
+// Runs one boot in a child process, its failures count here
+static void a_BankTest_Child(const char *name, void (*boot)(void))
+{
+    pid_t pid;
+    int status;
+
+    fflush(stdout);
+    pid = fork();
+    if (pid == 0)
+    {
+        failures = 0;
+        boot();
+        fflush(stdout);
+        _exit((failures == 0) ? 0 : 1);
+    }
+    if ((pid < 0) || (waitpid(pid, &status, 0) != pid) || !WIFEXITED(status) || (WEXITSTATUS(status) != 0))
+    {
+        a_BankTest_Fail(name, 0);
+    }
+}
+
+int main(void)
+{
+#if (LITTLEFS_BANKS == 2)
+    uint32_t boot;
+#endif
+
+    bankTestShared = mmap(NULL, sizeof(*bankTestShared), PROT_READ | PROT_WRITE, MAP_SHARED | MAP_ANONYMOUS, -1, 0);
+    if (bankTestShared == MAP_FAILED)
+    {
+        printf("FAIL: shared memory\n");
+        return 1;
+    }
+
+#if (LITTLEFS_BANKS == 2)
+    a_BankTest_Child("first boot", a_BankTest_First);
+    a_BankTest_Child("generations", a_BankTest_Generations);
+    if ((bankTestShared->generation[0] != BANK_TEST_NO_ATTR) || (bankTestShared->generation[1] != 1))
+    {
+        a_BankTest_Fail("generations after the first swap", bankTestShared->generation[1]);
+    }
+    for (boot = 2; boot <= 4; boot++)
+    {
+        a_BankTest_Child("reboot", a_BankTest_Reboot);
+        a_BankTest_Child("generations", a_BankTest_Generations);
+        // the bank made active has the new generation, the other keeps the one it had
+        if ((bankTestShared->generation[boot % 2] != boot) || (bankTestShared->generation[(boot + 1) % 2] != boot - 1))
+        {
+            a_BankTest_Fail("generations after a swap", boot);
+        }
+    }
+    printf("two banks: %u swaps, generations %u and %u\n", (unsigned int)(boot - 1),
+           (unsigned int)bankTestShared->generation[0], (unsigned int)bankTestShared->generation[1]);
+#else
+    a_BankTest_Child("one bank", a_BankTest_Single);
+#endif
+
+    a_BankTest_Child("other layout", a_BankTest_Other);
+    a_BankTest_Child("boot on the other layout", a_BankTest_Mismatch);
+    printf("%u bank build on a %u bank volume: not mounted, not written\n", (unsigned int)LITTLEFS_BANKS,
+           (unsigned int)BANK_TEST_OTHER_BANKS);
+
+    printf("%s\n", (failures == 0) ? "ok" : "FAIL");
+    return (failures == 0) ? 0 : 1;
+}
@@ -0,0 +1,385 @@
+/*
+ * boot_test.c
+ *
+ * Host test of the boot time the allocator snapshot of lfs_alloc_snapshot.c
+ * saves, on the W25Q128 flash model of w25q_model.c and the SmartEEPROM
+ * stand-in of stub/device.h.
+ *
+ * Littlefs_Startup() mounts once per process, so every boot is a child
+ * process that starts from the chip image and SmartEEPROM contents the
+ * first child left in shared memory: a filesystem of BOOT_TEST_DIRS
+ * directories of BOOT_TEST_FILES_PER_DIR files, written through fs_port with
+ * the SmartEEPROM on and left idle until the pre-erase pool scanned it and
+ * saved the snapshot. It is then booted without SmartEEPROM, with the
+ * snapshot, and with a snapshot whose map says every block is free and whose
+ * allocator position points at the superblock. Each boot gives the model
+ * time and chip reads of fsInit() and of the first 4 KiB STOR after it.
+ *
+ * The first STOR after a boot with the snapshot must read at least
+ * BOOT_TEST_MIN_GAIN times less than without, and the mount must read less.
+ * The damaged snapshot must fail its CRC and be ignored, the first STOR
+ * scans as without one; after every boot all files must read back.
+ *
+ *   boot_test [bus MHz]
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/wait.h>
+#include "w25q_model.h"
+#include "w25qxx_sched.h"
+#include "fs_port.h"
+#include "lfs_w25qxx_preerase.h"
+
+#define BOOT_TEST_DIRS          40
+#define BOOT_TEST_FILES_PER_DIR 12
+#define BOOT_TEST_CHIP_SIZE     (16u * 1024u * 1024u)   // W25Q128
+#define BOOT_TEST_CHUNK         1024u                   // FTP_SERVER_BUFFER_SIZE of the application
+#define BOOT_TEST_STOR_SIZE     4096u
+#define BOOT_TEST_STOR_PATH     "/first.bin"
+#define BOOT_TEST_POOL_WAIT_MS  20000
+#define BOOT_TEST_MIN_GAIN      10                      // first STOR chip reads without / with the snapshot
+#define BOOT_TEST_SEESTAT       ((1u << 8) | (1u << 16))    // SEESBLK 1, SEEPSZ 1: 1 KB of SmartEEPROM
+#define BOOT_TEST_MAGIC         0x4C465341u             // LFS_ALLOC_SNAPSHOT_MAGIC
+
+// Words of Lfs_AllocSnapshot_s in lfs_alloc_snapshot.c the damaged snapshot changes
+#define BOOT_TEST_WORD_ALLOC    6
+#define BOOT_TEST_WORD_MAP      8
+
+typedef enum
+{
+    BOOT_TEST_NO_SNAPSHOT = 0,
+    BOOT_TEST_SNAPSHOT,
+    BOOT_TEST_DAMAGED,
+    BOOT_TEST_BOOTS
+} BootTestBoot_e;
+
+typedef struct
+{
+    uint64_t startupUs;
+    uint32_t startupReads;
+    uint64_t storUs;
+    uint32_t storReads;
+} BootTestResult_s;
+
+// Survives the child processes
+typedef struct
+{
+    uint8_t chip[BOOT_TEST_CHIP_SIZE];
+    uint32_t seeprom[1024];
+    BootTestResult_s result[BOOT_TEST_BOOTS];
+} BootTestShared_s;
+
+w25qxx_sched_t w25q128_sched;
+uint32_t nvmctrlModelSeeprom[1024];
+uint32_t nvmctrlModelSeestat;
+
+static const char *const bootTestNames[BOOT_TEST_BOOTS] = {"no snapshot", "snapshot", "damaged snapshot"};
+static BootTestShared_s *bootTestShared;
+static w25qxx_handle_t w25q128Handle;
+static unsigned int failures;
+
+
+static void a_BootTest_Fail(const char *what, const char *boot, uint32_t value)
+{
+    if (failures++ < 10)
+    {
+        printf("FAIL %s, %s, %u\n", what, boot, (unsigned int)value);
+    }
+}
+
+static uint32_t a_BootTest_TimestampUs(void)
+{
+    return (uint32_t)w25qModelTimeUs;
+}
+
+// Byte o of a file
+static uint8_t a_BootTest_Byte(uint32_t file, uint32_t o)
+{
+    return (uint8_t)((o >> 8) + o * 3 + file * 29);
+}
+
+// Inlined, a block or a few
+static uint32_t a_BootTest_Size(uint32_t file)
+{
+    return 64 + (file * 997) % 9000;
+}
+
+static void a_BootTest_Path(char *path, size_t size, uint32_t file)
+{
+    snprintf(path, size, "/d%02u/f%03u.bin", (unsigned int)(file / BOOT_TEST_FILES_PER_DIR), (unsigned int)file);
+}
+
+// Wait for the pool to go idle, its scan saves the snapshot
+static void a_BootTest_WaitPool(void)
+{
+    Lfs_W25qxxPreEraseStats_s last;
+    Lfs_W25qxxPreEraseStats_s now;
+    uint32_t stable = 0;
+    uint32_t ms;
+
+    Lfs_W25qxxPreErase_GetStats(&last);
+    for (ms = 0; (ms < BOOT_TEST_POOL_WAIT_MS) && (stable < 4 * LFS_PREERASE_IDLE_MS); ms += LFS_PREERASE_POLL_MS)
+    {
+        osDelayTask(LFS_PREERASE_POLL_MS);
+        Lfs_W25qxxPreErase_GetStats(&now);
+        stable = (memcmp(&now, &last, sizeof(now)) == 0) ? (stable + LFS_PREERASE_POLL_MS) : 0;
+        last = now;
+    }
+}
+
+static int a_BootTest_Write(const char *path, uint32_t file, uint32_t size)
+{
+    static uint8_t data[BOOT_TEST_CHUNK];
+    uint32_t offset;
+    uint32_t n;
+    uint32_t i;
+    FsFile *f;
+
+    f = fsOpenFile(path, FS_FILE_MODE_WRITE | FS_FILE_MODE_CREATE | FS_FILE_MODE_TRUNC);
+    if (f == NULL)
+    {
+        return 1;
+    }
+    for (offset = 0; offset < size; offset += n)
+    {
+        n = ((size - offset) < BOOT_TEST_CHUNK) ? (size - offset) : BOOT_TEST_CHUNK;
+        for (i = 0; i < n; i++)
+        {
+            data[i] = a_BootTest_Byte(file, offset + i);
+        }
+        if (fsWriteFile(f, data, n) != NO_ERROR)
+        {
+            fsCloseFile(f);
+            return 1;
+        }
+    }
+    fsCloseFile(f);
+    return 0;
+}
+
+static int a_BootTest_ReadBack(const char *path, uint32_t file, uint32_t size)
+{
+    static uint8_t data[BOOT_TEST_CHUNK];
+    uint32_t total = 0;
+    size_t length;
+    size_t i;
+    FsFile *f;
+
+    f = fsOpenFile(path, FS_FILE_MODE_READ);
+    if (f == NULL)
+    {
+        return 1;
+    }
+    while (fsReadFile(f, data, sizeof(data), &length) == NO_ERROR)
+    {
+        for (i = 0; i < length; i++)
+        {
+            if (data[i] != a_BootTest_Byte(file, total + (uint32_t)i))
+            {
+                fsCloseFile(f);
+                return 1;
+            }
+        }
+        total += (uint32_t)length;
+    }
+    fsCloseFile(f);
+    return (total == size) ? 0 : 1;
+}
+
+static void a_BootTest_Start(void)
+{
+    if ((w25qxx_sched_init(&w25q128_sched, &w25q128Handle, a_BootTest_TimestampUs) != 0) ||
+        (fsInit() != NO_ERROR))
+    {
+        a_BootTest_Fail("startup", "", 0);
+    }
+}
+
+// First child: the filesystem, the snapshot of it, both left in the shared memory
+static void a_BootTest_Populate(void)
+{
+    char path[32];
+    uint32_t file;
+
+    nvmctrlModelSeestat = BOOT_TEST_SEESTAT;
+    if (w25qModelInit(&w25q128Handle, W25Q128) != 0)
+    {
+        a_BootTest_Fail("model init", "populate", 0);
+        return;
+    }
+    a_BootTest_Start();
+    for (file = 0; (failures == 0) && (file < BOOT_TEST_DIRS * BOOT_TEST_FILES_PER_DIR); file++)
+    {
+        if ((file % BOOT_TEST_FILES_PER_DIR) == 0)
+        {
+            snprintf(path, sizeof(path), "/d%02u", (unsigned int)(file / BOOT_TEST_FILES_PER_DIR));
+            if (fsCreateDir(path) != NO_ERROR)
+            {
+                a_BootTest_Fail("create dir", "populate", file);
+            }
+        }
+        a_BootTest_Path(path, sizeof(path), file);
+        if (a_BootTest_Write(path, file, a_BootTest_Size(file)) != 0)
+        {
+            a_BootTest_Fail("write file", "populate", file);
+        }
+    }
+    a_BootTest_WaitPool();
+    if (nvmctrlModelSeeprom[0] != BOOT_TEST_MAGIC)
+    {
+        a_BootTest_Fail("no snapshot saved after the pool went idle", "populate", nvmctrlModelSeeprom[0]);
+    }
+    memcpy(bootTestShared->chip, w25qModelArray(), BOOT_TEST_CHIP_SIZE);
+    memcpy(bootTestShared->seeprom, nvmctrlModelSeeprom, sizeof(nvmctrlModelSeeprom));
+}
+
+// A later child: power up on the saved chip and SmartEEPROM, mount, upload one file, check the rest
+static void a_BootTest_Boot(BootTestBoot_e boot)
+{
+    BootTestResult_s *result = &bootTestShared->result[boot];
+    const char *name = bootTestNames[boot];
+    char path[32];
+    uint64_t start;
+    uint32_t file;
+    uint32_t w;
+
+    memcpy(nvmctrlModelSeeprom, bootTestShared->seeprom, sizeof(nvmctrlModelSeeprom));
+    nvmctrlModelSeestat = (boot == BOOT_TEST_NO_SNAPSHOT) ? 0 : BOOT_TEST_SEESTAT;
+    if (boot == BOOT_TEST_DAMAGED)
+    {
+        // were it loaded, the first allocations would land on the superblock and the files
+        nvmctrlModelSeeprom[BOOT_TEST_WORD_ALLOC] = 2;
+        for (w = BOOT_TEST_WORD_MAP; w < 1024; w++)
+        {
+            nvmctrlModelSeeprom[w] = 0;
+        }
+    }
+    if (w25qModelInit(&w25q128Handle, W25Q128) != 0)
+    {
+        a_BootTest_Fail("model init", name, 0);
+        return;
+    }
+    memcpy(w25qModelArray(), bootTestShared->chip, BOOT_TEST_CHIP_SIZE);
+    if (w25qModelRestart(&w25q128Handle) != 0)
+    {
+        a_BootTest_Fail("model restart", name, 0);
+        return;
+    }
+
+    w25qModelResetCounters();
+    start = w25qModelTimeUs;
+    a_BootTest_Start();
+    result->startupUs = w25qModelTimeUs - start;
+    result->startupReads = w25qModelReads;
+
+    w25qModelResetCounters();
+    start = w25qModelTimeUs;
+    if (a_BootTest_Write(BOOT_TEST_STOR_PATH, 0, BOOT_TEST_STOR_SIZE) != 0)
+    {
+        a_BootTest_Fail("first STOR", name, 0);
+    }
+    result->storUs = w25qModelTimeUs - start;
+    result->storReads = w25qModelReads;
+
+    if (a_BootTest_ReadBack(BOOT_TEST_STOR_PATH, 0, BOOT_TEST_STOR_SIZE) != 0)
+    {
+        a_BootTest_Fail("first STOR read back", name, 0);
+    }
+    for (file = 0; file < BOOT_TEST_DIRS * BOOT_TEST_FILES_PER_DIR; file++)
+    {
+        a_BootTest_Path(path, sizeof(path), file);
+        if (a_BootTest_ReadBack(path, file, a_BootTest_Size(file)) != 0)
+        {
+            a_BootTest_Fail("file read back after the boot", name, file);
+            break;
+        }
+    }
+}
+
+// Runs one boot in a child process, its failures count here
+static void a_BootTest_Child(int boot)
+{
+    pid_t pid;
+    int status;
+
+    fflush(stdout);
+    pid = fork();
+    if (pid == 0)
+    {
+        if (boot < 0)
+        {
+            a_BootTest_Populate();
+        }
+        else
+        {
+            a_BootTest_Boot((BootTestBoot_e)boot);
+        }
+        fflush(stdout);
+        _exit((failures == 0) ? 0 : 1);
+    }
+    if ((pid < 0) || (waitpid(pid, &status, 0) != pid) || !WIFEXITED(status) || (WEXITSTATUS(status) != 0))
+    {
+        a_BootTest_Fail("child", (boot < 0) ? "populate" : bootTestNames[boot], (uint32_t)boot);
+    }
+}
+
+int main(int argc, char **argv)
+{
+    const BootTestResult_s *r;
+    int boot;
+
+    if (argc > 1)
+    {
+        w25qModelBusMhz = (uint32_t)atoi(argv[1]);
+    }
+    bootTestShared = mmap(NULL, sizeof(*bootTestShared), PROT_READ | PROT_WRITE, MAP_SHARED | MAP_ANONYMOUS, -1, 0);
+    if (bootTestShared == MAP_FAILED)
+    {
+        printf("FAIL: shared memory\n");
+        return 1;
+    }
+
+    a_BootTest_Child(-1);
+    if (failures != 0)
+    {
+        printf("FAIL\n");
+        return 1;
+    }
+    for (boot = 0; boot < BOOT_TEST_BOOTS; boot++)
+    {
+        a_BootTest_Child(boot);
+    }
+
+    printf("%u files in %u dirs, bus %u MHz, model time\n", (unsigned int)(BOOT_TEST_DIRS * BOOT_TEST_FILES_PER_DIR),
+           (unsigned int)BOOT_TEST_DIRS, (unsigned int)w25qModelBusMhz);
+    printf("boot               startup ms  reads  first STOR ms  reads\n");
+    for (boot = 0; boot < BOOT_TEST_BOOTS; boot++)
+    {
+        r = &bootTestShared->result[boot];
+        printf("%-18s %10.1f %6u %14.1f %6u\n", bootTestNames[boot], r->startupUs / 1000.0,
+               (unsigned int)r->startupReads, r->storUs / 1000.0, (unsigned int)r->storReads);
+    }
+
+    r = bootTestShared->result;
+    if (r[BOOT_TEST_SNAPSHOT].storReads * BOOT_TEST_MIN_GAIN > r[BOOT_TEST_NO_SNAPSHOT].storReads)
+    {
+        a_BootTest_Fail("first STOR with the snapshot scanned", bootTestNames[BOOT_TEST_SNAPSHOT],
+                        r[BOOT_TEST_SNAPSHOT].storReads);
+    }
+    if (r[BOOT_TEST_SNAPSHOT].startupReads >= r[BOOT_TEST_NO_SNAPSHOT].startupReads)
+    {
+        a_BootTest_Fail("mount with the snapshot read as much", bootTestNames[BOOT_TEST_SNAPSHOT],
+                        r[BOOT_TEST_SNAPSHOT].startupReads);
+    }
+    if (r[BOOT_TEST_DAMAGED].storReads < BOOT_TEST_MIN_GAIN * r[BOOT_TEST_SNAPSHOT].storReads)
+    {
+        a_BootTest_Fail("damaged snapshot loaded", bootTestNames[BOOT_TEST_DAMAGED], r[BOOT_TEST_DAMAGED].storReads);
+    }
+
+    printf("%s\n", (failures == 0) ? "ok" : "FAIL");
+    return (failures == 0) ? 0 : 1;
+}
@@ -0,0 +1,295 @@
+/*
+ * list_bench.c
+ *
+ * Host benchmark of the block cache of lfs_w25qxx_cache.c under the reads an
+ * FTP session makes: a LIST of a directory of small and larger files through
+ * fsOpenDir()/fsReadDir(), and a RETR-style sequential read of a 1 MiB file
+ * in FTP-sized fsReadFile() calls, on the flash model of w25q_model.c.
+ *
+ * The Makefile builds it twice: list_bench with the block cache as the
+ * application configures it, list_bench_nocache with every read of an
+ * uncached block sent past the cache (LFS_BLOCKCACHE_BYPASS_SIZE 1), as
+ * littlefs read the chip before the cache. The table gives, in model time,
+ * the time of each case, the chip read commands and the bytes the cache
+ * filled, cold after the cache was dropped and warm right after; the
+ * directory takes more metadata blocks than the cache has entries, so a
+ * second LIST fills them again. The listing must give every file with its
+ * size and the file must read back. The build without cache must not hit,
+ * the one with it must serve at least LIST_BENCH_MIN_HITS listing reads
+ * from RAM per chip read.
+ *
+ *   list_bench [bus MHz]
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "w25q_model.h"
+#include "w25qxx_sched.h"
+#include "fs_port.h"
+#include "lfs_w25qxx_cache.h"
+#include "lfs_w25qxx_preerase.h"
+
+#define LIST_BENCH_DIR          "/list"
+#define LIST_BENCH_FILES        200
+#define LIST_BENCH_BIG_PATH     "/big.bin"
+#define LIST_BENCH_BIG_SIZE     (1024u * 1024u)
+#define LIST_BENCH_CHUNK        1024u               // FTP_SERVER_BUFFER_SIZE of the application
+#define LIST_BENCH_POOL_WAIT_MS 10000
+#define LIST_BENCH_MIN_HITS     4                   // listing reads served from RAM per chip read, with the cache
+
+w25qxx_sched_t w25q128_sched;
+uint32_t nvmctrlModelSeeprom[1024];
+uint32_t nvmctrlModelSeestat;                       // no SmartEEPROM, no allocator snapshot
+
+static w25qxx_handle_t w25q128Handle;
+static uint8_t listBenchSeen[LIST_BENCH_FILES];
+static unsigned int failures;
+
+
+static void a_ListBench_Fail(const char *what, uint32_t value)
+{
+    if (failures++ < 10)
+    {
+        printf("FAIL %s, %u\n", what, (unsigned int)value);
+    }
+}
+
+static uint32_t a_ListBench_TimestampUs(void)
+{
+    return (uint32_t)w25qModelTimeUs;
+}
+
+// Byte o of a file
+static uint8_t a_ListBench_Byte(uint32_t file, uint32_t o)
+{
+    return (uint8_t)((o >> 10) + o * 7 + file * 13);
+}
+
+static uint32_t a_ListBench_Size(uint32_t file)
+{
+    return ((file % 4) == 0) ? (5000 + file) : (100 + file);        // a block and more, or inlined
+}
+
+// Wait for the pool to erase what was freed, it starts after LFS_PREERASE_IDLE_MS without a prog
+static void a_ListBench_WaitPool(void)
+{
+    Lfs_W25qxxPreEraseStats_s last;
+    Lfs_W25qxxPreEraseStats_s now;
+    uint32_t stable = 0;
+    uint32_t ms;
+
+    Lfs_W25qxxPreErase_GetStats(&last);
+    for (ms = 0; (ms < LIST_BENCH_POOL_WAIT_MS) && (stable < 4 * LFS_PREERASE_IDLE_MS); ms += LFS_PREERASE_POLL_MS)
+    {
+        osDelayTask(LFS_PREERASE_POLL_MS);
+        Lfs_W25qxxPreErase_GetStats(&now);
+        stable = (memcmp(&now, &last, sizeof(now)) == 0) ? (stable + LFS_PREERASE_POLL_MS) : 0;
+        last = now;
+    }
+}
+
+static int a_ListBench_Write(const char *path, uint32_t file, uint32_t size)
+{
+    static uint8_t data[LIST_BENCH_CHUNK];
+    uint32_t offset;
+    uint32_t n;
+    uint32_t i;
+    FsFile *f;
+
+    f = fsOpenFile(path, FS_FILE_MODE_WRITE | FS_FILE_MODE_CREATE | FS_FILE_MODE_TRUNC);
+    if (f == NULL)
+    {
+        return 1;
+    }
+    for (offset = 0; offset < size; offset += n)
+    {
+        n = ((size - offset) < LIST_BENCH_CHUNK) ? (size - offset) : LIST_BENCH_CHUNK;
+        for (i = 0; i < n; i++)
+        {
+            data[i] = a_ListBench_Byte(file, offset + i);
+        }
+        if (fsWriteFile(f, data, n) != NO_ERROR)
+        {
+            fsCloseFile(f);
+            return 1;
+        }
+    }
+    fsCloseFile(f);
+    return 0;
+}
+
+static int a_ListBench_Files(void)
+{
+    char path[32];
+    uint32_t i;
+
+    if (fsCreateDir(LIST_BENCH_DIR) != NO_ERROR)
+    {
+        return 1;
+    }
+    for (i = 0; i < LIST_BENCH_FILES; i++)
+    {
+        snprintf(path, sizeof(path), LIST_BENCH_DIR "/file%03u.txt", (unsigned int)i);
+        if (a_ListBench_Write(path, i, a_ListBench_Size(i)) != 0)
+        {
+            return 1;
+        }
+    }
+    return a_ListBench_Write(LIST_BENCH_BIG_PATH, LIST_BENCH_FILES, LIST_BENCH_BIG_SIZE);
+}
+
+// LIST: every file once with its size
+static void a_ListBench_List(void)
+{
+    FsDirEntry entry;
+    unsigned int file;
+    uint32_t count = 0;
+    FsDir *dir;
+
+    memset(listBenchSeen, 0, sizeof(listBenchSeen));
+    dir = fsOpenDir(LIST_BENCH_DIR);
+    if (dir == NULL)
+    {
+        a_ListBench_Fail("open dir", 0);
+        return;
+    }
+    while (fsReadDir(dir, &entry) == NO_ERROR)
+    {
+        if ((strcmp(entry.name, ".") == 0) || (strcmp(entry.name, "..") == 0))
+        {
+            continue;
+        }
+        if ((sscanf(entry.name, "file%u.txt", &file) != 1) || (file >= LIST_BENCH_FILES) ||
+            listBenchSeen[file] || (entry.size != a_ListBench_Size(file)))
+        {
+            a_ListBench_Fail("listed entry", count);
+            continue;
+        }
+        listBenchSeen[file] = 1;
+        count++;
+    }
+    fsCloseDir(dir);
+    if (count != LIST_BENCH_FILES)
+    {
+        a_ListBench_Fail("files listed", count);
+    }
+}
+
+// RETR: the whole file in FTP-sized reads
+static void a_ListBench_Read(void)
+{
+    static uint8_t data[LIST_BENCH_CHUNK];
+    uint32_t total = 0;
+    size_t length;
+    size_t i;
+    FsFile *f;
+
+    f = fsOpenFile(LIST_BENCH_BIG_PATH, FS_FILE_MODE_READ);
+    if (f == NULL)
+    {
+        a_ListBench_Fail("open file", 0);
+        return;
+    }
+    while (fsReadFile(f, data, sizeof(data), &length) == NO_ERROR)
+    {
+        for (i = 0; i < length; i++)
+        {
+            if (data[i] != a_ListBench_Byte(LIST_BENCH_FILES, total + (uint32_t)i))
+            {
+                a_ListBench_Fail("data read back", total + (uint32_t)i);
+                break;
+            }
+        }
+        total += (uint32_t)length;
+    }
+    fsCloseFile(f);
+    if (total != LIST_BENCH_BIG_SIZE)
+    {
+        a_ListBench_Fail("length read back", total);
+    }
+}
+
+// One case in model time, the cache statistics of the case in delta
+static void a_ListBench_Case(const char *name, void (*run)(void), int cold, Lfs_W25qxxCacheStats_s *delta)
+{
+    Lfs_W25qxxCacheStats_s before;
+    Lfs_W25qxxCacheStats_s after;
+    uint64_t start;
+
+    if (cold)
+    {
+        Lfs_W25qxxCache_Invalidate();
+    }
+    Lfs_W25qxxCache_GetStats(&before);
+    w25qModelResetCounters();
+    start = w25qModelTimeUs;
+    run();
+    Lfs_W25qxxCache_GetStats(&after);
+
+    delta->hits = after.hits - before.hits;
+    delta->misses = after.misses - before.misses;
+    delta->bypassed = after.bypassed - before.bypassed;
+    delta->bytesRead = after.bytesRead - before.bytesRead;
+    printf("%-14s %8.1f %7u %9u %7u %7u %8u\n", name, (w25qModelTimeUs - start) / 1000.0,
+           (unsigned int)w25qModelReads, (unsigned int)delta->bytesRead,
+           (unsigned int)delta->hits, (unsigned int)delta->misses, (unsigned int)delta->bypassed);
+}
+
+int main(int argc, char **argv)
+{
+    Lfs_W25qxxCacheStats_s list;
+    Lfs_W25qxxCacheStats_s stats;
+    uint32_t hits;
+
+    if (argc > 1)
+    {
+        w25qModelBusMhz = (uint32_t)atoi(argv[1]);
+    }
+
+    if ((w25qModelInit(&w25q128Handle, W25Q128) != 0) ||
+        (w25qxx_sched_init(&w25q128_sched, &w25q128Handle, a_ListBench_TimestampUs) != 0) ||
+        (fsInit() != NO_ERROR))
+    {
+        printf("FAIL: startup\n");
+        return 1;
+    }
+    if (a_ListBench_Files() != 0)
+    {
+        printf("FAIL: writing the files\n");
+        return 1;
+    }
+    a_ListBench_WaitPool();
+
+#if (LFS_BLOCKCACHE_BYPASS_SIZE > 1)
+    printf("block cache %u x %u B, ", (unsigned int)LFS_BLOCKCACHE_ENTRIES, (unsigned int)LFS_BLOCKCACHE_BLOCK_SIZE);
+#else
+    printf("no block cache, ");
+#endif
+    printf("%u files listed, %u KiB read in %u B reads, bus %u MHz, model time\n", (unsigned int)LIST_BENCH_FILES,
+           (unsigned int)(LIST_BENCH_BIG_SIZE / 1024u), (unsigned int)LIST_BENCH_CHUNK, (unsigned int)w25qModelBusMhz);
+    printf("case                 ms   reads  fill B     hits  misses bypassed\n");
+    a_ListBench_Case("list cold", a_ListBench_List, 1, &list);
+    hits = list.hits;
+    a_ListBench_Case("list warm", a_ListBench_List, 0, &stats);
+    hits += stats.hits;
+    a_ListBench_Case("read cold", a_ListBench_Read, 1, &stats);
+    hits += stats.hits;
+    a_ListBench_Case("read warm", a_ListBench_Read, 0, &stats);
+    hits += stats.hits;
+
+#if (LFS_BLOCKCACHE_BYPASS_SIZE > 1)
+    if (list.hits < LIST_BENCH_MIN_HITS * (list.misses + list.bypassed))
+    {
+        a_ListBench_Fail("listing reads served from the cache", list.hits);
+    }
+#else
+    if (hits != 0)
+    {
+        a_ListBench_Fail("reads hit without the cache", hits);
+    }
+#endif
+
+    printf("%s\n", (failures == 0) ? "ok" : "FAIL");
+    return (failures == 0) ? 0 : 1;
+}
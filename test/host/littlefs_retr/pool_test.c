@@ -0,0 +1,487 @@
+/*
+ * pool_test.c
+ *
+ * Checks the file and directory handle pools of fs_port_custom_littlefs.c on
+ * the littlefs stack over the flash model of w25q_model.c, built with pools
+ * of dozens of slots and a 4 bit handle generation (see the Makefile) so the
+ * generation wraps within a few closes.
+ *
+ * A slot is opened and closed over several generation wraps. Every handle
+ * it gave out before must be rejected by fsReadFile(), fsReadDir(),
+ * fsCloseFile() and fsCloseDir() without touching the file or directory the
+ * slot holds now, those from before the last wrap included; only the handle
+ * from exactly one wrap ago matches, which is the width of the generation.
+ * No handle may carry generation 0. Handles of no slot are rejected too.
+ *
+ * The open and peak counts of fsGetPoolStats() must follow the files, stage
+ * buffers and directories opened and closed, an upload past the stage
+ * buffers included, and stay at the pool size when an open past it fails.
+ * The arena must be one file buffer per file slot plus the stage buffers,
+ * and littlefs must not allocate from the heap after fsInit().
+ *
+ * The microbenchmark gives the wall clock cost of a handle lookup, of an
+ * fsOpenFile()/fsCloseFile() pair as RETR makes it and of an
+ * fsOpenDir()/fsCloseDir() pair as LIST makes it, with one slot in use and
+ * with all but one in use. Exits with 1 on failure.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include "w25q_model.h"
+#include "w25qxx_sched.h"
+#include "fs_port.h"
+
+#define POOL_TEST_GEN_WRAP      FS_HANDLE_GEN_MASK  // generations 1 to the mask, 0 is skipped
+#define POOL_TEST_CYCLES        (3 * POOL_TEST_GEN_WRAP + 2)
+#define POOL_TEST_LOOKUPS       1000000
+#define POOL_TEST_OPENS         2000
+
+w25qxx_sched_t w25q128_sched;
+uint32_t nvmctrlModelSeeprom[1024];
+uint32_t nvmctrlModelSeestat;                       // no SmartEEPROM, no allocator snapshot
+
+static w25qxx_handle_t w25q128Handle;
+static FsFile *poolTestFiles[FS_MAX_FILES];
+static FsDir *poolTestDirs[FS_MAX_DIRS];
+static void *poolTestOld[POOL_TEST_CYCLES];
+static uint32_t poolTestMallocs;              // littlefs heap allocations, see the Makefile
+static unsigned int failures;
+
+
+static void a_PoolTest_Fail(const char *what, uint32_t value)
+{
+    if (failures++ < 10)
+    {
+        printf("FAIL %s, %u\n", what, (unsigned int)value);
+    }
+}
+
+static uint32_t a_PoolTest_TimestampUs(void)
+{
+    return (uint32_t)w25qModelTimeUs;
+}
+
+void *poolTestMalloc(size_t size)
+{
+    poolTestMallocs++;
+    return malloc(size);
+}
+
+static double a_PoolTest_Now(void)
+{
+    struct timespec t;
+
+    clock_gettime(CLOCK_MONOTONIC, &t);
+    return t.tv_sec + t.tv_nsec / 1e9;
+}
+
+static void a_PoolTest_Path(char *path, size_t size, uint32_t i)
+{
+    snprintf(path, size, "/pool%02u.txt", (unsigned int)i);
+}
+
+static int a_PoolTest_Files(void)
+{
+    char path[32];
+    uint32_t i;
+    FsFile *file;
+
+    for (i = 0; i < FS_MAX_FILES; i++)
+    {
+        a_PoolTest_Path(path, sizeof(path), i);
+        file = fsOpenFile(path, FS_FILE_MODE_WRITE | FS_FILE_MODE_CREATE | FS_FILE_MODE_TRUNC);
+        if ((file == NULL) || (fsWriteFile(file, path, strlen(path)) != NO_ERROR))
+        {
+            return 1;
+        }
+        fsCloseFile(file);
+    }
+    return fsCreateDir("/dir") != NO_ERROR;
+}
+
+// The file behind a handle is the one opened: its first byte
+static int a_PoolTest_Reads(FsFile *file, char expected)
+{
+    char c = 0;
+    size_t length = 0;
+
+    return (fsSeekFile(file, 0, FS_SEEK_SET) == NO_ERROR) && (fsReadFile(file, &c, 1, &length) == NO_ERROR) &&
+           (length == 1) && (c == expected);
+}
+
+static uint32_t a_PoolTest_FilesOpen(void)
+{
+    FsPoolStats_s stats;
+
+    fsGetPoolStats(&stats);
+    return stats.filesOpen;
+}
+
+static uint32_t a_PoolTest_DirsOpen(void)
+{
+    FsPoolStats_s stats;
+
+    fsGetPoolStats(&stats);
+    return stats.dirsOpen;
+}
+
+static void a_PoolTest_Stats(const char *what, uint32_t files, uint32_t filesPeak, uint32_t streams,
+                             uint32_t streamsPeak, uint32_t dirs, uint32_t dirsPeak)
+{
+    FsPoolStats_s stats;
+
+    fsGetPoolStats(&stats);
+    if ((stats.filesOpen != files) || (stats.filesPeak != filesPeak) || (stats.streamsOpen != streams) ||
+        (stats.streamsPeak != streamsPeak) || (stats.dirsOpen != dirs) || (stats.dirsPeak != dirsPeak))
+    {
+        a_PoolTest_Fail(what, stats.filesPeak);
+        printf("     files %u/%u, streams %u/%u, dirs %u/%u open/peak\n", stats.filesOpen, stats.filesPeak,
+               stats.streamsOpen, stats.streamsPeak, stats.dirsOpen, stats.dirsPeak);
+    }
+}
+
+// The high-water marks since fsInit(), a_PoolTest_Files() wrote one streamed file at a time
+static void a_PoolTest_HighWater(void)
+{
+    FsPoolStats_s stats;
+    char path[32];
+    uint32_t i;
+
+    fsGetPoolStats(&stats);
+    if (stats.arenaSize != (FS_MAX_FILES * LITTLEFS_CACHE_SIZE) + (FS_STREAM_MAX_FILES * FS_STREAM_CHUNK_SIZE))
+    {
+        a_PoolTest_Fail("arena size", stats.arenaSize);
+    }
+    a_PoolTest_Stats("after the files were written", 0, 1, 0, 1, 0, 0);
+
+    for (i = 0; i < 5; i++)
+    {
+        a_PoolTest_Path(path, sizeof(path), i);
+        poolTestFiles[i] = fsOpenFile(path, FS_FILE_MODE_READ);
+    }
+    fsCloseFile(poolTestFiles[2]);
+    fsCloseFile(poolTestFiles[3]);
+    fsCloseFile(poolTestFiles[4]);
+    a_PoolTest_Stats("five opened, three closed", 2, 5, 0, 1, 0, 0);
+
+    // two uploads, the second one finds no stage buffer and is written as usual
+    poolTestFiles[2] = fsOpenFile("/up1.bin", FS_FILE_MODE_WRITE | FS_FILE_MODE_CREATE | FS_FILE_MODE_TRUNC);
+    poolTestFiles[3] = fsOpenFile("/up2.bin", FS_FILE_MODE_WRITE | FS_FILE_MODE_CREATE | FS_FILE_MODE_TRUNC);
+    a_PoolTest_Stats("two uploads", 4, 5, FS_STREAM_MAX_FILES, FS_STREAM_MAX_FILES, 0, 0);
+    for (i = 4; i < 7; i++)
+    {
+        a_PoolTest_Path(path, sizeof(path), i);
+        poolTestFiles[i] = fsOpenFile(path, FS_FILE_MODE_READ);
+    }
+    if ((fsWriteFile(poolTestFiles[2], path, 8) != NO_ERROR) || (fsWriteFile(poolTestFiles[3], path, 8) != NO_ERROR))
+    {
+        a_PoolTest_Fail("upload", 0);
+    }
+    a_PoolTest_Stats("seven open", 7, 7, FS_STREAM_MAX_FILES, FS_STREAM_MAX_FILES, 0, 0);
+    for (i = 0; i < 7; i++)
+    {
+        fsCloseFile(poolTestFiles[i]);
+    }
+    fsDeleteFile("/up1.bin");
+    fsDeleteFile("/up2.bin");
+    a_PoolTest_Stats("all closed", 0, 7, 0, FS_STREAM_MAX_FILES, 0, 0);
+
+    // every slot, then one open past the pool and one of a missing file
+    for (i = 0; i < FS_MAX_FILES; i++)
+    {
+        a_PoolTest_Path(path, sizeof(path), i);
+        poolTestFiles[i] = fsOpenFile(path, FS_FILE_MODE_READ);
+    }
+    if (fsOpenFile("/pool00.txt", FS_FILE_MODE_READ) != NULL)
+    {
+        a_PoolTest_Fail("open past the pool", FS_MAX_FILES);
+    }
+    a_PoolTest_Stats("every file slot", FS_MAX_FILES, FS_MAX_FILES, 0, FS_STREAM_MAX_FILES, 0, 0);
+    for (i = 0; i < FS_MAX_FILES; i++)
+    {
+        fsCloseFile(poolTestFiles[i]);
+    }
+    if (fsOpenFile("/missing.txt", FS_FILE_MODE_READ) != NULL)
+    {
+        a_PoolTest_Fail("open of a missing file", 0);
+    }
+    a_PoolTest_Stats("failed open", 0, FS_MAX_FILES, 0, FS_STREAM_MAX_FILES, 0, 0);
+
+    for (i = 0; i < 3; i++)
+    {
+        poolTestDirs[i] = fsOpenDir("/");
+    }
+    fsCloseDir(poolTestDirs[0]);
+    a_PoolTest_Stats("three dirs, one closed", 0, FS_MAX_FILES, 0, FS_STREAM_MAX_FILES, 2, 3);
+    fsCloseDir(poolTestDirs[1]);
+    fsCloseDir(poolTestDirs[2]);
+    for (i = 0; i < FS_MAX_DIRS; i++)
+    {
+        poolTestDirs[i] = fsOpenDir("/");
+    }
+    if ((fsOpenDir("/") != NULL) || (fsOpenDir("/missing") != NULL))
+    {
+        a_PoolTest_Fail("dir open past the pool", FS_MAX_DIRS);
+    }
+    for (i = 0; i < FS_MAX_DIRS; i++)
+    {
+        fsCloseDir(poolTestDirs[i]);
+    }
+    a_PoolTest_Stats("every dir slot", 0, FS_MAX_FILES, 0, FS_STREAM_MAX_FILES, 0, FS_MAX_DIRS);
+}
+
+// One slot closed and opened again over several wraps, every older handle but the one a wrap ago is stale
+static void a_PoolTest_FileWrap(void)
+{
+    char data[4];
+    size_t length;
+    uint32_t open;
+    uint32_t k;
+    uint32_t j;
+    FsFile *file;
+
+    open = a_PoolTest_FilesOpen();
+    for (k = 0; k < POOL_TEST_CYCLES; k++)
+    {
+        file = fsOpenFile("/pool00.txt", FS_FILE_MODE_READ);
+        if (file == NULL)
+        {
+            a_PoolTest_Fail("file open", k);
+            return;
+        }
+        poolTestOld[k] = file;
+        if (((uintptr_t)file >> 8) == 0)
+        {
+            a_PoolTest_Fail("handle of generation 0", k);
+        }
+        if ((k > 0) && (((uintptr_t)file & 0xFF) != ((uintptr_t)poolTestOld[0] & 0xFF)))
+        {
+            a_PoolTest_Fail("slot not reused", k);
+        }
+        for (j = 0; j < k; j++)
+        {
+            if (((k - j) % POOL_TEST_GEN_WRAP) == 0)
+            {
+                if (poolTestOld[j] != file)
+                {
+                    a_PoolTest_Fail("generation width", k - j);
+                }
+                continue;
+            }
+            if (poolTestOld[j] == file)
+            {
+                a_PoolTest_Fail("handle of an older generation given out again", k - j);
+            }
+            if ((fsReadFile(poolTestOld[j], data, sizeof(data), &length) == NO_ERROR) ||
+                (fsSeekFile(poolTestOld[j], 0, FS_SEEK_SET) == NO_ERROR))
+            {
+                a_PoolTest_Fail("stale file handle accepted", k - j);
+            }
+            fsCloseFile(poolTestOld[j]);
+            if ((a_PoolTest_FilesOpen() != open + 1) || !a_PoolTest_Reads(file, '/'))
+            {
+                a_PoolTest_Fail("stale file handle closed the file", k - j);
+                return;
+            }
+        }
+        fsCloseFile(file);
+        if (a_PoolTest_FilesOpen() != open)
+        {
+            a_PoolTest_Fail("file not closed", k);
+        }
+        if (fsReadFile(file, data, sizeof(data), &length) == NO_ERROR)
+        {
+            a_PoolTest_Fail("closed file handle accepted", k);
+        }
+    }
+}
+
+static void a_PoolTest_DirWrap(void)
+{
+    FsDirEntry entry;
+    uint32_t open;
+    uint32_t k;
+    uint32_t j;
+    FsDir *dir;
+
+    open = a_PoolTest_DirsOpen();
+    for (k = 0; k < POOL_TEST_CYCLES; k++)
+    {
+        dir = fsOpenDir("/");
+        if (dir == NULL)
+        {
+            a_PoolTest_Fail("dir open", k);
+            return;
+        }
+        poolTestOld[k] = dir;
+        if (((uintptr_t)dir >> 8) == 0)
+        {
+            a_PoolTest_Fail("dir handle of generation 0", k);
+        }
+        for (j = 0; j < k; j++)
+        {
+            if (((k - j) % POOL_TEST_GEN_WRAP) == 0)
+            {
+                continue;
+            }
+            if (fsReadDir(poolTestOld[j], &entry) != ERROR_INVALID_PARAMETER)
+            {
+                a_PoolTest_Fail("stale dir handle accepted", k - j);
+            }
+            fsCloseDir(poolTestOld[j]);
+            if (a_PoolTest_DirsOpen() != open + 1)
+            {
+                a_PoolTest_Fail("stale dir handle closed the dir", k - j);
+                return;
+            }
+        }
+        if (fsReadDir(dir, &entry) != NO_ERROR)
+        {
+            a_PoolTest_Fail("dir read", k);
+        }
+        fsCloseDir(dir);
+        if (fsReadDir(dir, &entry) != ERROR_INVALID_PARAMETER)
+        {
+            a_PoolTest_Fail("closed dir handle accepted", k);
+        }
+    }
+}
+
+// Handles that name no slot: none, index 0, past the pool
+static void a_PoolTest_Invalid(void)
+{
+    static const uintptr_t handles[] = {0, 1u << 8, (1u << 8) | (FS_MAX_FILES + 1), (1u << 8) | 0xFF};
+    FsDirEntry entry;
+    char data[4];
+    size_t length;
+    uint32_t i;
+
+    for (i = 0; i < sizeof(handles) / sizeof(handles[0]); i++)
+    {
+        if ((fsReadFile((FsFile *)handles[i], data, sizeof(data), &length) == NO_ERROR) ||
+            (fsReadDir((FsDir *)handles[i], &entry) == NO_ERROR))
+        {
+            a_PoolTest_Fail("handle of no slot accepted", i);
+        }
+        fsCloseFile((FsFile *)handles[i]);
+        fsCloseDir((FsDir *)handles[i]);
+    }
+}
+
+// Wall clock ns of a lookup (a stale handle, nothing else runs) and of open/close pairs
+static void a_PoolTest_Bench(const char *name)
+{
+    FsDirEntry entry;
+    volatile error_t sink = NO_ERROR;
+    FsFile *stale;
+    FsFile *file;
+    FsDir *dir;
+    double lookup;
+    double files;
+    double dirs;
+    uint32_t i;
+
+    stale = fsOpenFile("/pool00.txt", FS_FILE_MODE_READ);
+    fsCloseFile(stale);
+    lookup = a_PoolTest_Now();
+    for (i = 0; i < POOL_TEST_LOOKUPS; i++)
+    {
+        sink = fsReadDir((FsDir *)stale, &entry);
+    }
+    lookup = (a_PoolTest_Now() - lookup) * 1e9 / POOL_TEST_LOOKUPS;
+    (void)sink;
+
+    files = a_PoolTest_Now();
+    for (i = 0; i < POOL_TEST_OPENS; i++)
+    {
+        file = fsOpenFile("/pool00.txt", FS_FILE_MODE_READ);
+        if (file == NULL)
+        {
+            a_PoolTest_Fail("bench file open", i);
+            return;
+        }
+        fsCloseFile(file);
+    }
+    files = (a_PoolTest_Now() - files) * 1e9 / POOL_TEST_OPENS;
+
+    dirs = a_PoolTest_Now();
+    for (i = 0; i < POOL_TEST_OPENS; i++)
+    {
+        dir = fsOpenDir("/dir");
+        if (dir == NULL)
+        {
+            a_PoolTest_Fail("bench dir open", i);
+            return;
+        }
+        fsCloseDir(dir);
+    }
+    dirs = (a_PoolTest_Now() - dirs) * 1e9 / POOL_TEST_OPENS;
+
+    printf("%-14s %9.1f %12.0f %12.0f\n", name, lookup, files, dirs);
+}
+
+int main(void)
+{
+    char path[32];
+    uint32_t i;
+
+    if ((w25qModelInit(&w25q128Handle, W25Q128) != 0) ||
+        (w25qxx_sched_init(&w25q128_sched, &w25q128Handle, a_PoolTest_TimestampUs) != 0) ||
+        (fsInit() != NO_ERROR))
+    {
+        printf("FAIL: startup\n");
+        return 1;
+    }
+    poolTestMallocs = 0;
+    if (a_PoolTest_Files() != 0)
+    {
+        printf("FAIL: writing the files\n");
+        return 1;
+    }
+
+    a_PoolTest_HighWater();
+    a_PoolTest_FileWrap();
+    a_PoolTest_DirWrap();
+    a_PoolTest_Invalid();
+    printf("%u files, %u dirs, generation wraps after %u closes, %u open/close cycles per pool\n",
+           (unsigned int)FS_MAX_FILES, (unsigned int)FS_MAX_DIRS, (unsigned int)POOL_TEST_GEN_WRAP,
+           (unsigned int)POOL_TEST_CYCLES);
+
+    printf("in use         lookup ns  file open+close ns  dir open+close ns\n");
+    a_PoolTest_Bench("one slot");
+    for (i = 1; i < FS_MAX_FILES; i++)
+    {
+        a_PoolTest_Path(path, sizeof(path), i);
+        poolTestFiles[i] = fsOpenFile(path, FS_FILE_MODE_READ);
+    }
+    for (i = 1; i < FS_MAX_DIRS; i++)
+    {
+        poolTestDirs[i] = fsOpenDir("/");
+    }
+    a_PoolTest_Bench("all but one");
+    for (i = 1; i < FS_MAX_FILES; i++)
+    {
+        if ((poolTestFiles[i] == NULL) || !a_PoolTest_Reads(poolTestFiles[i], '/'))
+        {
+            a_PoolTest_Fail("file open next to the others", i);
+        }
+        fsCloseFile(poolTestFiles[i]);
+    }
+    for (i = 1; i < FS_MAX_DIRS; i++)
+    {
+        if (poolTestDirs[i] == NULL)
+        {
+            a_PoolTest_Fail("dir open next to the others", i);
+        }
+        fsCloseDir(poolTestDirs[i]);
+    }
+    if (poolTestMallocs != 0)
+    {
+        a_PoolTest_Fail("littlefs heap allocations after fsInit()", poolTestMallocs);
+    }
+
+    printf("%s\n", (failures == 0) ? "ok" : "FAIL");
+    return (failures == 0) ? 0 : 1;
+}
@@ -0,0 +1,214 @@
+/*
+ * retr_bench.c
+ *
+ * Host benchmark of concurrent RETR-style reads through the littlefs service
+ * layer of littlefs_startup.c on the model W25Q128 of w25q_model.c. Each
+ * client is a thread that reads its own file in FTP-sized chunks and spends
+ * a CPU-bound send phase on every chunk, as a session task pushing the data
+ * to its socket would. The read bus time is slept, so clients overlap on it
+ * only as far as the shared read path lets them. Prints the aggregate
+ * throughput for 1, 2, 4 and 8 clients.
+ *
+ *   retr_bench [bus MHz [send us per chunk]]
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <pthread.h>
+#include <time.h>
+#include "w25q_model.h"
+#include "w25qxx_sched.h"
+#include "littlefs_startup.h"
+#include "lfs_w25qxx_cache.h"
+#include "lfs_w25qxx_preerase.h"
+
+#define RETR_BENCH_FILE_SIZE    (128u * 1024u)
+#define RETR_BENCH_CHUNK        1024u               // FTP_SERVER_BUFFER_SIZE of the application
+#define RETR_BENCH_MAX_CLIENTS  8
+
+w25qxx_sched_t w25q128_sched;
+uint32_t nvmctrlModelSeeprom[1024];
+uint32_t nvmctrlModelSeestat;                       // no SmartEEPROM, no allocator snapshot
+
+static w25qxx_handle_t w25q128Handle;
+static uint32_t retrBenchSendUs = 100;
+static volatile int retrBenchFailed;
+
+
+static uint32_t a_RetrBench_TimestampUs(void)
+{
+    return (uint32_t)w25qModelTimeUs;
+}
+
+static double a_RetrBench_Now(void)
+{
+    struct timespec t;
+
+    clock_gettime(CLOCK_MONOTONIC, &t);
+    return t.tv_sec + t.tv_nsec / 1e9;
+}
+
+static void a_RetrBench_Spin(uint32_t us)
+{
+    double end = a_RetrBench_Now() + us / 1e6;
+
+    while (a_RetrBench_Now() < end)
+    {
+    }
+}
+
+static void a_RetrBench_Name(char *name, int id)
+{
+    sprintf(name, "retr%d.bin", id);
+}
+
+// Chunk k of file id is filled with (id + k)
+static int a_RetrBench_WriteFiles(void)
+{
+    static uint8_t chunk[RETR_BENCH_CHUNK];
+    lfs_file_t file;
+    char name[16];
+    uint32_t k;
+    int id;
+
+    for (id = 0; id < RETR_BENCH_MAX_CLIENTS; id++)
+    {
+        a_RetrBench_Name(name, id);
+        if (Littlefs_FileOpen(&file, name, LFS_O_WRONLY | LFS_O_CREAT | LFS_O_TRUNC) != LFS_ERR_OK)
+        {
+            return 1;
+        }
+        for (k = 0; k < (RETR_BENCH_FILE_SIZE / RETR_BENCH_CHUNK); k++)
+        {
+            memset(chunk, (uint8_t)(id + k), sizeof(chunk));
+            if (Littlefs_FileWrite(&file, chunk, sizeof(chunk)) != LFS_ERR_OK)
+            {
+                return 1;
+            }
+        }
+        Littlefs_FileClose(&file);
+    }
+
+    return 0;
+}
+
+static void *a_RetrBench_Client(void *arg)
+{
+    uint8_t chunk[RETR_BENCH_CHUNK];
+    int id = (int)(intptr_t)arg;
+    lfs_file_t file;
+    char name[16];
+    size_t length;
+    size_t total = 0;
+    size_t i;
+
+    a_RetrBench_Name(name, id);
+    if (Littlefs_FileOpen(&file, name, LFS_O_RDONLY) != LFS_ERR_OK)
+    {
+        retrBenchFailed = 1;
+        return NULL;
+    }
+    for (;;)
+    {
+        if (Littlefs_FileRead(&file, chunk, sizeof(chunk), &length) != LFS_ERR_OK)
+        {
+            retrBenchFailed = 1;
+            break;
+        }
+        if (length == 0)
+        {
+            break;
+        }
+        for (i = 0; i < length; i++)
+        {
+            if (chunk[i] != (uint8_t)(id + (total + i) / RETR_BENCH_CHUNK))
+            {
+                retrBenchFailed = 1;
+            }
+        }
+        total += length;
+        a_RetrBench_Spin(retrBenchSendUs);
+    }
+    Littlefs_FileClose(&file);
+    if (total != RETR_BENCH_FILE_SIZE)
+    {
+        retrBenchFailed = 1;
+    }
+
+    return NULL;
+}
+
+int main(int argc, char **argv)
+{
+    static const int clients[] = {1, 2, 4, 8};
+    pthread_t threads[RETR_BENCH_MAX_CLIENTS];
+    Lfs_W25qxxCacheStats_s before;
+    Lfs_W25qxxCacheStats_s after;
+    uint64_t busUs;
+    double seconds;
+    size_t k;
+    int i;
+
+    if (argc > 1)
+    {
+        w25qModelBusMhz = (uint32_t)atoi(argv[1]);
+    }
+    if (argc > 2)
+    {
+        retrBenchSendUs = (uint32_t)atoi(argv[2]);
+    }
+
+    if ((w25qModelInit(&w25q128Handle, W25Q128) != 0) ||
+        (w25qxx_sched_init(&w25q128_sched, &w25q128Handle, a_RetrBench_TimestampUs) != 0) ||
+        (Littlefs_Startup() != LFS_ERR_OK))
+    {
+        printf("FAIL: startup\n");
+        return 1;
+    }
+    if (a_RetrBench_WriteFiles() != 0)
+    {
+        printf("FAIL: writing the files\n");
+        return 1;
+    }
+
+    // read only from here on, the bus time becomes real time
+    Lfs_W25qxxPreErase_Stop();
+    w25qModelRealTime = 1;
+
+    printf("%u KiB per client in %u B chunks, bus %u MHz, send %u us per chunk\n",
+           (unsigned int)(RETR_BENCH_FILE_SIZE / 1024u), (unsigned int)RETR_BENCH_CHUNK,
+           (unsigned int)w25qModelBusMhz, (unsigned int)retrBenchSendUs);
+    printf("clients    KiB/s   reads  bus ms    hits  misses  bypassed\n");
+    for (k = 0; k < (sizeof(clients) / sizeof(clients[0])); k++)
+    {
+        w25qModelResetCounters();
+        Lfs_W25qxxCache_GetStats(&before);
+        busUs = w25qModelTimeUs;
+        seconds = a_RetrBench_Now();
+
+        for (i = 0; i < clients[k]; i++)
+        {
+            pthread_create(&threads[i], NULL, a_RetrBench_Client, (void *)(intptr_t)i);
+        }
+        for (i = 0; i < clients[k]; i++)
+        {
+            pthread_join(threads[i], NULL);
+        }
+
+        seconds = a_RetrBench_Now() - seconds;
+        Lfs_W25qxxCache_GetStats(&after);
+        if (retrBenchFailed)
+        {
+            printf("FAIL: %d clients read wrong data\n", clients[k]);
+            return 1;
+        }
+        printf("%7d %8.0f %7u %7.0f %7u %7u %9u\n", clients[k],
+               clients[k] * (RETR_BENCH_FILE_SIZE / 1024.0) / seconds, (unsigned int)w25qModelReads,
+               (w25qModelTimeUs - busUs) / 1e3, (unsigned int)(after.hits - before.hits),
+               (unsigned int)(after.misses - before.misses), (unsigned int)(after.bypassed - before.bypassed));
+    }
+
+    printf("ok\n");
+    return 0;
+}
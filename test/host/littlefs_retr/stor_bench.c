@@ -0,0 +1,378 @@
+/*
+ * stor_bench.c
+ *
+ * Host benchmark of STOR-style uploads through fs_port_custom_littlefs.c,
+ * the littlefs service layer and the W25Q128 stack under it, on the flash
+ * model of w25q_model.c. A file is written in FTP-sized fsWriteFile() calls
+ * once streamed through a stage buffer, as the FTP server opens an upload,
+ * and once opened for reading too, which takes the plain littlefs path.
+ *
+ * The first table gives the throughput in model time, the flash bus and
+ * busy times only, with the pre-erase pool filled. The second one receives
+ * the file from a thread over a loopback TCP socket and writes it as it
+ * comes, with the model sleeping its bus and busy times, and gives the wall
+ * clock throughput. Both check the file read back. fsGetFileSize() and
+ * fsGetFileStat() on a file being streamed must count the bytes written so
+ * far, those littlefs has not committed and those still staged included.
+ *
+ *   stor_bench [bus MHz]
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <pthread.h>
+#include <time.h>
+#include <unistd.h>
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <sys/socket.h>
+#include "w25q_model.h"
+#include "w25qxx_sched.h"
+#include "fs_port.h"
+#include "lfs_w25qxx_preerase.h"
+
+#define STOR_BENCH_FILE_SIZE    (1024u * 1024u)
+#define STOR_BENCH_CHUNK        1024u               // FTP_SERVER_BUFFER_SIZE of the application
+#define STOR_BENCH_SEND_CHUNK   8192u
+#define STOR_BENCH_PATH         "/stor.bin"
+#define STOR_BENCH_POOL_WAIT_MS 10000
+
+#define STOR_BENCH_STREAMED     (FS_FILE_MODE_WRITE | FS_FILE_MODE_CREATE | FS_FILE_MODE_TRUNC)
+#define STOR_BENCH_PLAIN        (FS_FILE_MODE_READ | STOR_BENCH_STREAMED)
+
+w25qxx_sched_t w25q128_sched;
+uint32_t nvmctrlModelSeeprom[1024];
+uint32_t nvmctrlModelSeestat;                       // no SmartEEPROM, no allocator snapshot
+
+static w25qxx_handle_t w25q128Handle;
+static int storBenchListen = -1;
+static unsigned int failures;
+
+
+static void a_StorBench_Fail(const char *what, const char *mode, uint32_t value)
+{
+    if (failures++ < 10)
+    {
+        printf("FAIL %s, %s, %u\n", what, mode, (unsigned int)value);
+    }
+}
+
+static uint32_t a_StorBench_TimestampUs(void)
+{
+    return (uint32_t)w25qModelTimeUs;
+}
+
+static double a_StorBench_Now(void)
+{
+    struct timespec t;
+
+    clock_gettime(CLOCK_MONOTONIC, &t);
+    return t.tv_sec + t.tv_nsec / 1e9;
+}
+
+// Byte o of the upload
+static uint8_t a_StorBench_Byte(uint32_t o)
+{
+    return (uint8_t)((o >> 10) + o * 7);
+}
+
+static void a_StorBench_Fill(uint8_t *data, uint32_t offset, uint32_t length)
+{
+    uint32_t i;
+
+    for (i = 0; i < length; i++)
+    {
+        data[i] = a_StorBench_Byte(offset + i);
+    }
+}
+
+// Wait for the pool to erase what was freed, it starts after LFS_PREERASE_IDLE_MS without a prog
+static void a_StorBench_WaitPool(void)
+{
+    Lfs_W25qxxPreEraseStats_s last;
+    Lfs_W25qxxPreEraseStats_s now;
+    uint32_t stable = 0;
+    uint32_t ms;
+
+    Lfs_W25qxxPreErase_GetStats(&last);
+    for (ms = 0; (ms < STOR_BENCH_POOL_WAIT_MS) && (stable < 4 * LFS_PREERASE_IDLE_MS); ms += LFS_PREERASE_POLL_MS)
+    {
+        osDelayTask(LFS_PREERASE_POLL_MS);
+        Lfs_W25qxxPreErase_GetStats(&now);
+        stable = (memcmp(&now, &last, sizeof(now)) == 0) ? (stable + LFS_PREERASE_POLL_MS) : 0;
+        last = now;
+    }
+}
+
+static void a_StorBench_Verify(const char *mode)
+{
+    static uint8_t data[STOR_BENCH_CHUNK];
+    uint32_t total = 0;
+    uint32_t size = 0;
+    size_t length;
+    size_t i;
+    FsFile *file;
+
+    if ((fsGetFileSize(STOR_BENCH_PATH, &size) != NO_ERROR) || (size != STOR_BENCH_FILE_SIZE))
+    {
+        a_StorBench_Fail("size after close", mode, size);
+    }
+    file = fsOpenFile(STOR_BENCH_PATH, FS_FILE_MODE_READ);
+    if (file == NULL)
+    {
+        a_StorBench_Fail("open for reading", mode, 0);
+        return;
+    }
+    while (fsReadFile(file, data, sizeof(data), &length) == NO_ERROR)
+    {
+        for (i = 0; i < length; i++)
+        {
+            if (data[i] != a_StorBench_Byte(total + (uint32_t)i))
+            {
+                a_StorBench_Fail("data read back", mode, total + (uint32_t)i);
+                break;
+            }
+        }
+        total += (uint32_t)length;
+    }
+    fsCloseFile(file);
+    if (total != STOR_BENCH_FILE_SIZE)
+    {
+        a_StorBench_Fail("length read back", mode, total);
+    }
+    if (fsDeleteFile(STOR_BENCH_PATH) != NO_ERROR)
+    {
+        a_StorBench_Fail("delete", mode, 0);
+    }
+    a_StorBench_WaitPool();
+}
+
+// Upload in model time, returns KiB/s
+static double a_StorBench_Model(const char *mode, uint_t openMode)
+{
+    static uint8_t data[STOR_BENCH_CHUNK];
+    Lfs_W25qxxPreEraseStats_s before;
+    Lfs_W25qxxPreEraseStats_s after;
+    uint64_t start;
+    double kibs;
+    uint32_t offset;
+    FsFile *file;
+
+    Lfs_W25qxxPreErase_GetStats(&before);
+    w25qModelResetCounters();
+    start = w25qModelTimeUs;
+
+    file = fsOpenFile(STOR_BENCH_PATH, openMode);
+    if (file == NULL)
+    {
+        a_StorBench_Fail("open", mode, 0);
+        return 0.0;
+    }
+    for (offset = 0; offset < STOR_BENCH_FILE_SIZE; offset += STOR_BENCH_CHUNK)
+    {
+        a_StorBench_Fill(data, offset, STOR_BENCH_CHUNK);
+        if (fsWriteFile(file, data, STOR_BENCH_CHUNK) != NO_ERROR)
+        {
+            a_StorBench_Fail("write", mode, offset);
+            break;
+        }
+    }
+    fsCloseFile(file);
+
+    kibs = (STOR_BENCH_FILE_SIZE / 1024.0) / ((w25qModelTimeUs - start) / 1e6);
+    Lfs_W25qxxPreErase_GetStats(&after);
+    printf("%-10s %8.0f %7u %8u %7u %9u %7u\n", mode, kibs, (unsigned int)w25qModelReads,
+           (unsigned int)w25qModelPrograms, (unsigned int)w25qModelErases,
+           (unsigned int)(after.hits - before.hits), (unsigned int)(after.misses - before.misses));
+
+    a_StorBench_Verify(mode);
+    return kibs;
+}
+
+static void *a_StorBench_Sender(void *arg)
+{
+    static uint8_t data[STOR_BENCH_SEND_CHUNK];
+    struct sockaddr_in addr;
+    socklen_t len = sizeof(addr);
+    uint32_t offset;
+    ssize_t n;
+    size_t done;
+    int s;
+
+    (void)arg;
+
+    s = socket(AF_INET, SOCK_STREAM, 0);
+    if ((s < 0) || (getsockname(storBenchListen, (struct sockaddr *)&addr, &len) != 0) || (connect(s, (struct sockaddr *)&addr, sizeof(addr)) != 0))
+    {
+        if (s >= 0)
+        {
+            close(s);
+        }
+        return NULL;
+    }
+    for (offset = 0; offset < STOR_BENCH_FILE_SIZE; offset += STOR_BENCH_SEND_CHUNK)
+    {
+        a_StorBench_Fill(data, offset, STOR_BENCH_SEND_CHUNK);
+        for (done = 0; done < STOR_BENCH_SEND_CHUNK; done += (size_t)n)
+        {
+            n = send(s, data + done, STOR_BENCH_SEND_CHUNK - done, 0);
+            if (n <= 0)
+            {
+                close(s);
+                return NULL;
+            }
+        }
+    }
+    close(s);
+
+    return NULL;
+}
+
+// Upload received over loopback TCP, returns wall clock KiB/s
+static double a_StorBench_Loopback(const char *mode, uint_t openMode)
+{
+    static uint8_t data[STOR_BENCH_CHUNK];
+    pthread_t sender;
+    uint32_t total = 0;
+    double seconds;
+    ssize_t n;
+    FsFile *file;
+    int s;
+
+    pthread_create(&sender, NULL, a_StorBench_Sender, NULL);
+    s = accept(storBenchListen, NULL, NULL);
+    if (s < 0)
+    {
+        a_StorBench_Fail("accept", mode, 0);
+        pthread_join(sender, NULL);
+        return 0.0;
+    }
+
+    seconds = a_StorBench_Now();
+    file = fsOpenFile(STOR_BENCH_PATH, openMode);
+    if (file == NULL)
+    {
+        a_StorBench_Fail("open", mode, 0);
+    }
+    while ((file != NULL) && ((n = recv(s, data, sizeof(data), 0)) > 0))
+    {
+        if (fsWriteFile(file, data, (size_t)n) != NO_ERROR)
+        {
+            a_StorBench_Fail("write", mode, total);
+            break;
+        }
+        total += (uint32_t)n;
+    }
+    fsCloseFile(file);
+    seconds = a_StorBench_Now() - seconds;
+    close(s);
+    pthread_join(sender, NULL);
+
+    if (total != STOR_BENCH_FILE_SIZE)
+    {
+        a_StorBench_Fail("received", mode, total);
+    }
+    printf("%-10s %8.0f\n", mode, (total / 1024.0) / seconds);
+
+    w25qModelRealTime = 0;
+    a_StorBench_Verify(mode);
+    w25qModelRealTime = 1;
+    return (total / 1024.0) / seconds;
+}
+
+// The size of a streamed file while it is written: staged bytes, a flushed chunk, a chunk boundary
+static void a_StorBench_StreamedSize(void)
+{
+    static const uint32_t writes[] = {1000, FS_STREAM_CHUNK_SIZE, FS_STREAM_CHUNK_SIZE - 1000, 1, 3 * FS_STREAM_CHUNK_SIZE};
+    static uint8_t data[3 * FS_STREAM_CHUNK_SIZE];
+    FsFileStat stat;
+    uint32_t total = 0;
+    uint32_t size;
+    uint32_t i;
+    FsFile *file;
+
+    file = fsOpenFile(STOR_BENCH_PATH, STOR_BENCH_STREAMED);
+    if (file == NULL)
+    {
+        a_StorBench_Fail("open", "size", 0);
+        return;
+    }
+    for (i = 0; i < sizeof(writes) / sizeof(writes[0]); i++)
+    {
+        a_StorBench_Fill(data, total, writes[i]);
+        if (fsWriteFile(file, data, writes[i]) != NO_ERROR)
+        {
+            a_StorBench_Fail("write", "size", total);
+        }
+        total += writes[i];
+        if ((fsGetFileSize(STOR_BENCH_PATH, &size) != NO_ERROR) || (size != total))
+        {
+            a_StorBench_Fail("fsGetFileSize while streaming", "size", size);
+        }
+        if ((fsGetFileStat(STOR_BENCH_PATH, &stat) != NO_ERROR) || (stat.size != total))
+        {
+            a_StorBench_Fail("fsGetFileStat while streaming", "size", (uint32_t)stat.size);
+        }
+    }
+    fsCloseFile(file);
+    if ((fsGetFileSize(STOR_BENCH_PATH, &size) != NO_ERROR) || (size != total))
+    {
+        a_StorBench_Fail("fsGetFileSize after close", "size", size);
+    }
+    fsDeleteFile(STOR_BENCH_PATH);
+}
+
+int main(int argc, char **argv)
+{
+    struct sockaddr_in addr;
+    double streamed;
+    double plain;
+
+    if (argc > 1)
+    {
+        w25qModelBusMhz = (uint32_t)atoi(argv[1]);
+    }
+
+    if ((w25qModelInit(&w25q128Handle, W25Q128) != 0) ||
+        (w25qxx_sched_init(&w25q128_sched, &w25q128Handle, a_StorBench_TimestampUs) != 0) ||
+        (fsInit() != NO_ERROR))
+    {
+        printf("FAIL: startup\n");
+        return 1;
+    }
+
+    a_StorBench_StreamedSize();
+    a_StorBench_WaitPool();
+
+    printf("%u KiB in %u B writes, bus %u MHz, model time\n", (unsigned int)(STOR_BENCH_FILE_SIZE / 1024u),
+           (unsigned int)STOR_BENCH_CHUNK, (unsigned int)w25qModelBusMhz);
+    printf("mode          KiB/s   reads programs  erases pool hits  misses\n");
+    streamed = a_StorBench_Model("streamed", STOR_BENCH_STREAMED);
+    plain = a_StorBench_Model("plain", STOR_BENCH_PLAIN);
+    if (streamed <= plain)
+    {
+        a_StorBench_Fail("streamed upload not faster", "model", (uint32_t)streamed);
+    }
+
+    memset(&addr, 0, sizeof(addr));
+    addr.sin_family = AF_INET;
+    addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+    storBenchListen = socket(AF_INET, SOCK_STREAM, 0);
+    if ((storBenchListen < 0) || (bind(storBenchListen, (struct sockaddr *)&addr, sizeof(addr)) != 0) ||
+        (listen(storBenchListen, 1) != 0))
+    {
+        printf("FAIL: loopback socket\n");
+        return 1;
+    }
+    printf("loopback TCP, wall clock\n");
+    printf("mode          KiB/s\n");
+    w25qModelRealTime = 1;
+    a_StorBench_Loopback("streamed", STOR_BENCH_STREAMED);
+    a_StorBench_Loopback("plain", STOR_BENCH_PLAIN);
+    w25qModelRealTime = 0;
+    close(storBenchListen);
+
+    printf("%s\n", (failures == 0) ? "ok" : "FAIL");
+    return (failures == 0) ? 0 : 1;
+}
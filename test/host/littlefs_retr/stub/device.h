@@ -0,0 +1,23 @@
+/*
+ * device.h
+ *
+ * Host stand-in for the SAME54 device header: the SmartEEPROM window that
+ * lfs_alloc_snapshot.c uses is a RAM array, see plib_nvmctrl.h.
+ */
+
+#ifndef DEVICE_H_STUB_
+#define DEVICE_H_STUB_
+
+#include <stdint.h>
+
+extern uint32_t nvmctrlModelSeeprom[1024];
+extern uint32_t nvmctrlModelSeestat;
+
+#define SEEPROM_ADDR                ((uintptr_t)nvmctrlModelSeeprom)
+
+#define NVMCTRL_SEESTAT_SBLK_Pos    8
+#define NVMCTRL_SEESTAT_SBLK_Msk    (0xFu << NVMCTRL_SEESTAT_SBLK_Pos)
+#define NVMCTRL_SEESTAT_PSZ_Pos     16
+#define NVMCTRL_SEESTAT_PSZ_Msk     (0x7u << NVMCTRL_SEESTAT_PSZ_Pos)
+
+#endif /* DEVICE_H_STUB_ */
@@ -0,0 +1,71 @@
+/*
+ * fs_port.h
+ *
+ * Host stand-in for the CycloneTCP file system abstraction header, with the
+ * types of the real one; the real header would pull in the RTOS port next
+ * to it instead of the POSIX stand-in of ../../common/stub/os_port.h.
+ */
+
+#ifndef FS_PORT_H_STUB_
+#define FS_PORT_H_STUB_
+
+#include "os_port.h"
+#include "error.h"
+
+#define FS_MAX_NAME_LEN 127
+
+typedef struct
+{
+   uint16_t year;
+   uint8_t month;
+   uint8_t day;
+   uint8_t dayOfWeek;
+   uint8_t hours;
+   uint8_t minutes;
+   uint8_t seconds;
+   uint16_t milliseconds;
+} DateTime;
+
+typedef enum
+{
+   FS_FILE_ATTR_READ_ONLY   = 0x01,
+   FS_FILE_ATTR_HIDDEN      = 0x02,
+   FS_FILE_ATTR_SYSTEM      = 0x04,
+   FS_FILE_ATTR_VOLUME_NAME = 0x08,
+   FS_FILE_ATTR_DIRECTORY   = 0x10,
+   FS_FILE_ATTR_ARCHIVE     = 0x20
+} FsFileAttributes;
+
+typedef enum
+{
+   FS_FILE_MODE_READ   = 1,
+   FS_FILE_MODE_WRITE  = 2,
+   FS_FILE_MODE_CREATE = 4,
+   FS_FILE_MODE_TRUNC  = 8
+} FsFileMode;
+
+typedef enum
+{
+   FS_SEEK_SET = 0,
+   FS_SEEK_CUR = 1,
+   FS_SEEK_END = 2
+} FsSeekOrigin;
+
+typedef struct
+{
+   uint32_t attributes;
+   uint32_t size;
+   DateTime modified;
+} FsFileStat;
+
+typedef struct
+{
+   uint32_t attributes;
+   uint32_t size;
+   DateTime modified;
+   char_t name[FS_MAX_NAME_LEN + 1];
+} FsDirEntry;
+
+#include "fs_port_custom.h"
+
+#endif /* FS_PORT_H_STUB_ */
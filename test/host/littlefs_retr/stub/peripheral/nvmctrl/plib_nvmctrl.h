@@ -0,0 +1,24 @@
+/*
+ * plib_nvmctrl.h
+ *
+ * Host stand-in for the NVMCTRL peripheral library, the SmartEEPROM never
+ * busy and its status read from nvmctrlModelSeestat.
+ */
+
+#ifndef PLIB_NVMCTRL_H_STUB_
+#define PLIB_NVMCTRL_H_STUB_
+
+#include <stdbool.h>
+#include "device.h"
+
+static inline bool NVMCTRL_SmartEEPROM_IsBusy(void)
+{
+    return false;
+}
+
+static inline uint32_t NVMCTRL_SmartEEPROMStatusGet(void)
+{
+    return nvmctrlModelSeestat;
+}
+
+#endif /* PLIB_NVMCTRL_H_STUB_ */
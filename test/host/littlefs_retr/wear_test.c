@@ -0,0 +1,668 @@
+/*
+ * wear_test.c
+ *
+ * Host test of the erase counters and the static wear leveling of
+ * lfs_w25qxx_wear.c on a littlefs of the whole W25Q128 flash model, striped
+ * over the one chip as littlefs_startup.c does. The erases of littlefs are
+ * counted as the pre-erase pool counts them, more are added through
+ * Lfs_W25qxxWear_Erased(), and the test keeps its own count per block.
+ *
+ * The counts live in RAM until the next reset, so every boot is a child
+ * process on the chip image the one before left in shared memory. The first
+ * boot saves LFS_WEAR_FILE_NAME: not before LFS_WEAR_SAVE_ERASES erases
+ * unless forced, then with every block's count between those before and
+ * after the save, the failure map and a valid CRC. The second boot loads it
+ * and must report the saved counts plus those since boot, and save their
+ * sum. The third damages one count in the file, the load must fail and only
+ * the erases since boot be reported.
+ *
+ * The leveling boot writes hot files, then cold ones: a file that can move,
+ * one larger than LFS_WEAR_LEVEL_MAX_SIZE, one deeper than
+ * LFS_WEAR_LEVEL_DEPTH, an inlined one and the counts file. Only the blocks
+ * written before the cold files are heated. Nothing may move under
+ * LFS_WEAR_LEVEL_SPREAD, before LFS_WEAR_LEVEL_INTERVAL erases or with a
+ * file open; a copy a program fails in must leave the file and no temporary
+ * one. Then exactly the movable file is copied and renamed over itself,
+ * every file reads back, and the next round finds nothing cold.
+ */
+
+#include <stddef.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/wait.h>
+#include "w25q_model.h"
+#include "w25qxx_sched.h"
+#include "lfs_w25qxx_wear.h"
+#include "lfs_util.h"
+
+#define WEAR_TEST_BLOCKS        4096                    // W25Q128, 4 KiB blocks
+#define WEAR_TEST_BLOCK_SIZE    4096
+#define WEAR_TEST_CHIP_SIZE     (WEAR_TEST_BLOCKS * WEAR_TEST_BLOCK_SIZE)
+#define WEAR_TEST_MAP_WORDS     (WEAR_TEST_BLOCKS / 32)
+#define WEAR_TEST_MAGIC         0x4C465357u             // LFS_WEAR_MAGIC
+#define WEAR_TEST_FAILED_A      17
+#define WEAR_TEST_FAILED_B      4000
+#define WEAR_TEST_TEMP_PATH     "/.wl~"                 // LFS_WEAR_TEMP_PATH
+
+// The file: magic, block count, the counts, the failure map and the crc of all before it
+typedef struct
+{
+    uint32_t magic;
+    uint32_t blockCount;
+    uint16_t counts[WEAR_TEST_BLOCKS];
+    uint32_t failed[WEAR_TEST_MAP_WORDS];
+    uint32_t crc;
+} WearTestFile_s;
+
+// Survives the child processes
+typedef struct
+{
+    uint8_t chip[WEAR_TEST_CHIP_SIZE];
+    uint16_t saved[WEAR_TEST_BLOCKS];                   // the counts of the last boot's save
+} WearTestShared_s;
+
+typedef struct
+{
+    const char *path;
+    uint32_t size;
+} WearTestFileSpec_s;
+
+w25qxx_sched_t w25q128_sched;
+uint32_t nvmctrlModelSeeprom[1024];
+uint32_t nvmctrlModelSeestat;
+
+static const char *const wearTestHot[] = {"/hot/h0.bin", "/hot/h1.bin", "/hot/h2.bin", "/hot/h3.bin"};
+static const WearTestFileSpec_s wearTestColdFiles[] =
+{
+    {"/cold/a.bin", 20000},                             // the one to move
+    {"/cold/big.bin", LFS_WEAR_LEVEL_MAX_SIZE + 4096},
+    {"/cold/tiny.txt", 40},                             // inlined, no block of its own
+    {"/deep/1/2/3/x.bin", 20000},                       // below LFS_WEAR_LEVEL_DEPTH directory levels
+};
+
+static w25qxx_sched_t *const wearTestChips[] = {&w25q128_sched};
+static WearTestShared_s *wearTestShared;
+static w25qxx_handle_t w25q128Handle;
+static Lfs_W25qxxStripe_s wearTestStripe;
+static struct lfs_config wearTestCfg;
+static lfs_t wearTestLfs;
+static uint8_t wearTestReadBuffer[512];
+static uint8_t wearTestProgBuffer[512];
+static uint32_t wearTestLookahead[512 / sizeof(uint32_t)];
+static uint32_t wearTestRef[WEAR_TEST_BLOCKS];          // erases counted since boot
+static uint32_t wearTestUsed[WEAR_TEST_MAP_WORDS];
+static uint32_t wearTestCold[WEAR_TEST_MAP_WORDS];      // blocks the cold files were written to
+static uint32_t wearTestCutProg;                        // the prog the power is cut before, counting down, 0 none
+static WearTestFile_s wearTestFile;
+static uint8_t wearTestData[1024];
+static unsigned int failures;
+
+
+static void a_WearTest_Fail(const char *what, uint32_t value)
+{
+    if (failures++ < 10)
+    {
+        printf("FAIL %s, %u\n", what, (unsigned int)value);
+    }
+}
+
+static uint32_t a_WearTest_TimestampUs(void)
+{
+    return (uint32_t)w25qModelTimeUs;
+}
+
+// Count n erases of a block, here and in the wear counters
+static void a_WearTest_Add(lfs_block_t block, uint32_t n)
+{
+    uint32_t i;
+
+    wearTestRef[block] += n;
+    for (i = 0; i < n; i++)
+    {
+        Lfs_W25qxxWear_Erased(block, 1, 1);
+    }
+}
+
+// Erases reaching the chip are counted as the pre-erase pool counts them
+static int a_WearTest_Erase(const struct lfs_config *c, lfs_block_t block)
+{
+    int err = Lfs_W25qxxStripe_Erase(c, block);
+
+    if (0 == err)
+    {
+        a_WearTest_Add(block, 1);
+    }
+    return err;
+}
+
+static int a_WearTest_Prog(const struct lfs_config *c, lfs_block_t block, lfs_off_t off, const void *buffer, lfs_size_t size)
+{
+    if ((wearTestCutProg != 0) && (--wearTestCutProg == 0))
+    {
+        memcpy(wearTestShared->chip, w25qModelArray(), WEAR_TEST_CHIP_SIZE);
+        _exit(0);
+    }
+    return Lfs_W25qxxStripe_Prog(c, block, off, buffer, size);
+}
+
+// Power up on the chip image in shared memory, or on an erased chip, and mount
+static int a_WearTest_Boot(int format)
+{
+    if (w25qModelInit(&w25q128Handle, W25Q128) != 0)
+    {
+        return 1;
+    }
+    if (!format)
+    {
+        memcpy(w25qModelArray(), wearTestShared->chip, WEAR_TEST_CHIP_SIZE);
+        if (w25qModelRestart(&w25q128Handle) != 0)
+        {
+            return 1;
+        }
+    }
+    if (w25qxx_sched_init(&w25q128_sched, &w25q128Handle, a_WearTest_TimestampUs) != 0)
+    {
+        return 1;
+    }
+
+    wearTestStripe.chips = wearTestChips;
+    wearTestStripe.chipsNumber = 1;
+    wearTestStripe.chipBlockCount = WEAR_TEST_BLOCKS;
+    wearTestStripe.firstBlock = 0;
+    wearTestCfg.context = &wearTestStripe;
+    wearTestCfg.read = Lfs_W25qxxStripe_Read;
+    wearTestCfg.prog = a_WearTest_Prog;
+    wearTestCfg.erase = a_WearTest_Erase;
+    wearTestCfg.sync = Lfs_W25qxxStripe_Sync;
+    wearTestCfg.read_size = 16;
+    wearTestCfg.prog_size = 256;
+    wearTestCfg.block_size = WEAR_TEST_BLOCK_SIZE;
+    wearTestCfg.block_count = WEAR_TEST_BLOCKS;
+    wearTestCfg.cache_size = sizeof(wearTestReadBuffer);
+    wearTestCfg.lookahead_size = sizeof(wearTestLookahead);
+    wearTestCfg.block_cycles = 500;
+    wearTestCfg.read_buffer = wearTestReadBuffer;
+    wearTestCfg.prog_buffer = wearTestProgBuffer;
+    wearTestCfg.lookahead_buffer = wearTestLookahead;
+
+    if (format && (lfs_format(&wearTestLfs, &wearTestCfg) != 0))
+    {
+        return 1;
+    }
+    return (lfs_mount(&wearTestLfs, &wearTestCfg) != 0) ? 1 : 0;
+}
+
+static void a_WearTest_Shutdown(void)
+{
+    (void)lfs_unmount(&wearTestLfs);
+    memcpy(wearTestShared->chip, w25qModelArray(), WEAR_TEST_CHIP_SIZE);
+}
+
+// Read the counts file into wearTestFile, 0 when it is whole and its crc matches
+static int a_WearTest_ReadFile(void)
+{
+    lfs_file_t file;
+    lfs_ssize_t n;
+
+    memset(&wearTestFile, 0, sizeof(wearTestFile));
+    if (lfs_file_open(&wearTestLfs, &file, LFS_WEAR_FILE_NAME, LFS_O_RDONLY) != 0)
+    {
+        return 1;
+    }
+    n = lfs_file_read(&wearTestLfs, &file, &wearTestFile, sizeof(wearTestFile));
+    (void)lfs_file_close(&wearTestLfs, &file);
+    if ((n != (lfs_ssize_t)sizeof(wearTestFile)) || (wearTestFile.magic != WEAR_TEST_MAGIC) ||
+        (wearTestFile.blockCount != WEAR_TEST_BLOCKS) ||
+        (wearTestFile.crc != lfs_crc(0xffffffff, &wearTestFile, offsetof(WearTestFile_s, crc))))
+    {
+        return 1;
+    }
+    return 0;
+}
+
+// Force a save, the file must hold base plus the erases counted here, those of the save itself
+// counted or not, and only the two failed blocks
+static void a_WearTest_Save(const char *what, const uint16_t *base)
+{
+    static uint32_t before[WEAR_TEST_BLOCKS];
+    uint32_t b;
+
+    memcpy(before, wearTestRef, sizeof(before));
+    if (!Lfs_W25qxxWear_Save(&wearTestLfs, TRUE) || (a_WearTest_ReadFile() != 0))
+    {
+        a_WearTest_Fail(what, 0);
+        return;
+    }
+    for (b = 0; b < WEAR_TEST_BLOCKS; b++)
+    {
+        if ((wearTestFile.counts[b] < base[b] + before[b]) || (wearTestFile.counts[b] > base[b] + wearTestRef[b]))
+        {
+            a_WearTest_Fail("count saved", b);
+            break;
+        }
+    }
+    for (b = 0; b < WEAR_TEST_MAP_WORDS; b++)
+    {
+        if (wearTestFile.failed[b] != (((b == WEAR_TEST_FAILED_A / 32) ? (1UL << (WEAR_TEST_FAILED_A % 32)) : 0) |
+                                       ((b == WEAR_TEST_FAILED_B / 32) ? (1UL << (WEAR_TEST_FAILED_B % 32)) : 0)))
+        {
+            a_WearTest_Fail("failure map saved", b);
+            break;
+        }
+    }
+    memcpy(wearTestShared->saved, wearTestFile.counts, sizeof(wearTestShared->saved));
+}
+
+// The reported total must be the saved counts, if any, and the erases since boot
+static void a_WearTest_Total(const char *what, const uint16_t *saved, uint32_t failed)
+{
+    Lfs_W25qxxWearStats_s stats;
+    uint32_t total = 0;
+    uint32_t b;
+
+    for (b = 0; b < WEAR_TEST_BLOCKS; b++)
+    {
+        total += wearTestRef[b] + ((saved != NULL) ? saved[b] : 0);
+    }
+    Lfs_W25qxxWear_GetStats(&stats);
+    if ((stats.blockCount != WEAR_TEST_BLOCKS) || (stats.totalErases != total) || (stats.failedBlocks != failed))
+    {
+        a_WearTest_Fail(what, stats.totalErases);
+    }
+}
+
+// First boot: no file yet, none written before LFS_WEAR_SAVE_ERASES erases, then a forced save
+static void a_WearTest_First(void)
+{
+    static const uint16_t none[WEAR_TEST_BLOCKS];
+    lfs_block_t b;
+
+    if (a_WearTest_Boot(1) != 0)
+    {
+        a_WearTest_Fail("first boot", 0);
+        return;
+    }
+    if (Lfs_W25qxxWear_Load(&wearTestLfs) != LFS_ERR_NOENT)
+    {
+        a_WearTest_Fail("load without a file", 0);
+    }
+    if (Lfs_W25qxxWear_Save(&wearTestLfs, FALSE) || (a_WearTest_ReadFile() == 0))
+    {
+        a_WearTest_Fail("saved before LFS_WEAR_SAVE_ERASES erases", 0);
+    }
+    for (b = 0; b < WEAR_TEST_BLOCKS; b++)
+    {
+        a_WearTest_Add(b, (b * 7) % 13);
+    }
+    Lfs_W25qxxWear_Failed(WEAR_TEST_FAILED_A);
+    Lfs_W25qxxWear_Failed(WEAR_TEST_FAILED_B);
+    a_WearTest_Total("counted since boot", NULL, 2);
+    a_WearTest_Save("first save", none);
+    if (Lfs_W25qxxWear_Save(&wearTestLfs, FALSE))
+    {
+        a_WearTest_Fail("saved again right after a save", 0);
+    }
+    a_WearTest_Shutdown();
+}
+
+// Second boot: the saved counts are added, and saved again with the new ones
+static void a_WearTest_Second(void)
+{
+    static uint16_t saved[WEAR_TEST_BLOCKS];
+    lfs_block_t b;
+
+    memcpy(saved, wearTestShared->saved, sizeof(saved));
+    if ((a_WearTest_Boot(0) != 0) || (Lfs_W25qxxWear_Load(&wearTestLfs) != 0))
+    {
+        a_WearTest_Fail("load after the reboot", 0);
+        return;
+    }
+    a_WearTest_Total("saved counts and those since boot", saved, 2);
+    for (b = 0; b < 100; b++)
+    {
+        a_WearTest_Add(b * 41, 3);
+    }
+    a_WearTest_Total("saved counts and those since boot", saved, 2);
+    a_WearTest_Save("second save", saved);
+    a_WearTest_Shutdown();
+}
+
+// Third boot: a count changed without the crc, nothing of the file may be added
+static void a_WearTest_Damaged(void)
+{
+    lfs_file_t file;
+    uint16_t count = 0xABCD;
+
+    if (a_WearTest_Boot(0) != 0)
+    {
+        a_WearTest_Fail("damaged boot", 0);
+        return;
+    }
+    if ((lfs_file_open(&wearTestLfs, &file, LFS_WEAR_FILE_NAME, LFS_O_RDWR) != 0) ||
+        (lfs_file_seek(&wearTestLfs, &file, offsetof(WearTestFile_s, counts[5]), LFS_SEEK_SET) < 0) ||
+        (lfs_file_write(&wearTestLfs, &file, &count, sizeof(count)) != (lfs_ssize_t)sizeof(count)) ||
+        (lfs_file_close(&wearTestLfs, &file) != 0))
+    {
+        a_WearTest_Fail("damage the file", 0);
+        return;
+    }
+    if (Lfs_W25qxxWear_Load(&wearTestLfs) != LFS_ERR_CORRUPT)
+    {
+        a_WearTest_Fail("damaged file loaded", 0);
+    }
+    a_WearTest_Total("counts after a damaged file", NULL, 0);
+}
+
+static uint8_t a_WearTest_Byte(uint32_t file, uint32_t o)
+{
+    return (uint8_t)((o >> 9) + o * 5 + file * 71);
+}
+
+static int a_WearTest_Write(const char *path, uint32_t file, uint32_t size)
+{
+    lfs_file_t f;
+    uint32_t offset;
+    uint32_t n;
+    uint32_t i;
+
+    if (lfs_file_open(&wearTestLfs, &f, path, LFS_O_WRONLY | LFS_O_CREAT | LFS_O_TRUNC) != 0)
+    {
+        return 1;
+    }
+    for (offset = 0; offset < size; offset += n)
+    {
+        n = ((size - offset) < sizeof(wearTestData)) ? (size - offset) : sizeof(wearTestData);
+        for (i = 0; i < n; i++)
+        {
+            wearTestData[i] = a_WearTest_Byte(file, offset + i);
+        }
+        if (lfs_file_write(&wearTestLfs, &f, wearTestData, n) != (lfs_ssize_t)n)
+        {
+            (void)lfs_file_close(&wearTestLfs, &f);
+            return 1;
+        }
+    }
+    return (lfs_file_close(&wearTestLfs, &f) != 0) ? 1 : 0;
+}
+
+static int a_WearTest_ReadBack(const char *path, uint32_t file, uint32_t size)
+{
+    lfs_file_t f;
+    uint32_t total = 0;
+    lfs_ssize_t n;
+    lfs_ssize_t i;
+
+    if (lfs_file_open(&wearTestLfs, &f, path, LFS_O_RDONLY) != 0)
+    {
+        return 1;
+    }
+    while ((n = lfs_file_read(&wearTestLfs, &f, wearTestData, sizeof(wearTestData))) > 0)
+    {
+        for (i = 0; i < n; i++)
+        {
+            if (wearTestData[i] != a_WearTest_Byte(file, total + (uint32_t)i))
+            {
+                (void)lfs_file_close(&wearTestLfs, &f);
+                return 1;
+            }
+        }
+        total += (uint32_t)n;
+    }
+    (void)lfs_file_close(&wearTestLfs, &f);
+    return ((n == 0) && (total == size)) ? 0 : 1;
+}
+
+static int a_WearTest_MarkUsed(void *data, lfs_block_t block)
+{
+    (void)data;
+    wearTestUsed[block / 32] |= 1UL << (block % 32);
+    return 0;
+}
+
+static void a_WearTest_Traverse(void)
+{
+    memset(wearTestUsed, 0, sizeof(wearTestUsed));
+    if (lfs_fs_traverse(&wearTestLfs, a_WearTest_MarkUsed, NULL) != 0)
+    {
+        a_WearTest_Fail("traverse", 0);
+    }
+}
+
+// Erase every block n more times, those the cold files were written to excepted
+static void a_WearTest_Heat(uint32_t n)
+{
+    lfs_block_t b;
+
+    for (b = 0; b < WEAR_TEST_BLOCKS; b++)
+    {
+        if (!((wearTestCold[b / 32] >> (b % 32)) & 1))
+        {
+            a_WearTest_Add(b, n);
+        }
+    }
+}
+
+static uint32_t a_WearTest_Moved(void)
+{
+    Lfs_W25qxxWearStats_s stats;
+
+    Lfs_W25qxxWear_GetStats(&stats);
+    return stats.filesMoved;
+}
+
+// Every file reads back and no copy is left over, after a power cut once the counts were loaded
+static void a_WearTest_Files(const char *what)
+{
+    struct lfs_info info;
+    uint32_t i;
+
+    for (i = 0; i < sizeof(wearTestHot) / sizeof(wearTestHot[0]); i++)
+    {
+        if (a_WearTest_ReadBack(wearTestHot[i], i, 8192) != 0)
+        {
+            a_WearTest_Fail(what, i);
+        }
+    }
+    for (i = 0; i < sizeof(wearTestColdFiles) / sizeof(wearTestColdFiles[0]); i++)
+    {
+        if (a_WearTest_ReadBack(wearTestColdFiles[i].path, 100 + i, wearTestColdFiles[i].size) != 0)
+        {
+            a_WearTest_Fail(what, 100 + i);
+        }
+    }
+    if (lfs_stat(&wearTestLfs, WEAR_TEST_TEMP_PATH, &info) != LFS_ERR_NOENT)
+    {
+        a_WearTest_Fail(what, 0);
+    }
+}
+
+// Move with the power cut before the cut-th program, then boot the image left: every file must
+// read back and the copy be gone once the counts were loaded. 0 while the cut hit the move.
+static int a_WearTest_Cut(uint32_t cut)
+{
+    pid_t pid;
+    int status;
+
+    fflush(stdout);
+    pid = fork();
+    if (pid == 0)
+    {
+        wearTestCutProg = cut;
+        (void)Lfs_W25qxxWear_Level(&wearTestLfs);
+        _exit(2);                                       // the move needs fewer programs
+    }
+    if ((pid < 0) || (waitpid(pid, &status, 0) != pid) || !WIFEXITED(status))
+    {
+        a_WearTest_Fail("power cut", cut);
+        return 1;
+    }
+    if (WEXITSTATUS(status) != 0)
+    {
+        return 1;
+    }
+
+    pid = fork();
+    if (pid == 0)
+    {
+        if ((a_WearTest_Boot(0) != 0) || (Lfs_W25qxxWear_Load(&wearTestLfs) != 0))
+        {
+            a_WearTest_Fail("boot after a power cut", cut);
+        }
+        else
+        {
+            a_WearTest_Files("file after a power cut");
+        }
+        fflush(stdout);
+        _exit((failures == 0) ? 0 : 1);
+    }
+    if ((pid < 0) || (waitpid(pid, &status, 0) != pid) || !WIFEXITED(status) || (WEXITSTATUS(status) != 0))
+    {
+        a_WearTest_Fail("power cut in the move", cut);
+        return 1;
+    }
+    return 0;
+}
+
+static void a_WearTest_Level(void)
+{
+    static const char *const dirs[] = {"/hot", "/cold", "/deep", "/deep/1", "/deep/1/2", "/deep/1/2/3"};
+    lfs_file_t file;
+    uint32_t coldUsed;
+    uint32_t w;
+    uint32_t i;
+
+    if ((a_WearTest_Boot(1) != 0) || (Lfs_W25qxxWear_Load(&wearTestLfs) != LFS_ERR_NOENT))
+    {
+        a_WearTest_Fail("leveling boot", 0);
+        return;
+    }
+    for (i = 0; i < sizeof(dirs) / sizeof(dirs[0]); i++)
+    {
+        if (lfs_mkdir(&wearTestLfs, dirs[i]) != 0)
+        {
+            a_WearTest_Fail("mkdir", i);
+        }
+    }
+    for (i = 0; i < sizeof(wearTestHot) / sizeof(wearTestHot[0]); i++)
+    {
+        if (a_WearTest_Write(wearTestHot[i], i, 8192) != 0)
+        {
+            a_WearTest_Fail("write hot file", i);
+        }
+    }
+    a_WearTest_Traverse();
+    memcpy(wearTestCold, wearTestUsed, sizeof(wearTestCold));
+    for (i = 0; i < sizeof(wearTestColdFiles) / sizeof(wearTestColdFiles[0]); i++)
+    {
+        if (a_WearTest_Write(wearTestColdFiles[i].path, 100 + i, wearTestColdFiles[i].size) != 0)
+        {
+            a_WearTest_Fail("write cold file", i);
+        }
+    }
+    (void)Lfs_W25qxxWear_Save(&wearTestLfs, TRUE);
+    a_WearTest_Traverse();
+    coldUsed = 0;
+    for (w = 0; w < WEAR_TEST_MAP_WORDS; w++)
+    {
+        wearTestCold[w] = wearTestUsed[w] & ~wearTestCold[w];
+        coldUsed += (uint32_t)__builtin_popcount(wearTestCold[w]);
+    }
+
+    // under the interval, then under the spread
+    if (Lfs_W25qxxWear_Level(&wearTestLfs))
+    {
+        a_WearTest_Fail("moved before LFS_WEAR_LEVEL_INTERVAL erases", 0);
+    }
+    a_WearTest_Heat(LFS_WEAR_LEVEL_SPREAD / 2 + 100);
+    if (Lfs_W25qxxWear_Level(&wearTestLfs))
+    {
+        a_WearTest_Fail("moved under LFS_WEAR_LEVEL_SPREAD", 0);
+    }
+    a_WearTest_Heat(LFS_WEAR_LEVEL_SPREAD / 2 + 100);
+
+    // not with a file open
+    if ((lfs_file_open(&wearTestLfs, &file, wearTestHot[0], LFS_O_RDONLY) != 0) ||
+        Lfs_W25qxxWear_Level(&wearTestLfs))
+    {
+        a_WearTest_Fail("moved with a file open", 0);
+    }
+    (void)lfs_file_close(&wearTestLfs, &file);
+
+    // power cuts in the move: after a reboot the file is whole, old or new
+    for (i = 1; a_WearTest_Cut(i) == 0; i++)
+    {
+    }
+    printf("leveling: power cut before each of the %u programs of the move\n", (unsigned int)(i - 1));
+
+    if (!Lfs_W25qxxWear_Level(&wearTestLfs) || (a_WearTest_Moved() != 1))
+    {
+        a_WearTest_Fail("cold file moved", a_WearTest_Moved());
+    }
+    a_WearTest_Files("file after the move");
+    a_WearTest_Traverse();
+    for (w = 0, i = 0; w < WEAR_TEST_MAP_WORDS; w++)
+    {
+        i += (uint32_t)__builtin_popcount(wearTestCold[w] & wearTestUsed[w]);
+    }
+    if (i >= coldUsed)
+    {
+        a_WearTest_Fail("cold blocks still in use after the move", i);
+    }
+
+    // the interval starts over
+    if (Lfs_W25qxxWear_Level(&wearTestLfs))
+    {
+        a_WearTest_Fail("moved again within LFS_WEAR_LEVEL_INTERVAL erases", 0);
+    }
+
+    // the others are too large, too deep, inlined or the counts
+    a_WearTest_Heat(LFS_WEAR_LEVEL_INTERVAL / (WEAR_TEST_BLOCKS - coldUsed) + 1);
+    if (Lfs_W25qxxWear_Level(&wearTestLfs) || (a_WearTest_Moved() != 1))
+    {
+        a_WearTest_Fail("moved a file that is not to be moved", a_WearTest_Moved());
+    }
+    a_WearTest_Files("file after the last round");
+    printf("leveling: %u cold blocks, %u of them in use after the move\n", (unsigned int)coldUsed, (unsigned int)i);
+}
+
+// Runs one boot in a child process, its failures count here
+static void a_WearTest_Child(const char *name, void (*boot)(void))
+{
+    pid_t pid;
+    int status;
+
+    fflush(stdout);
+    pid = fork();
+    if (pid == 0)
+    {
+        failures = 0;
+        boot();
+        fflush(stdout);
+        _exit((failures == 0) ? 0 : 1);
+    }
+    if ((pid < 0) || (waitpid(pid, &status, 0) != pid) || !WIFEXITED(status) || (WEXITSTATUS(status) != 0))
+    {
+        a_WearTest_Fail(name, 0);
+    }
+}
+
+int main(void)
+{
+    wearTestShared = mmap(NULL, sizeof(*wearTestShared), PROT_READ | PROT_WRITE, MAP_SHARED | MAP_ANONYMOUS, -1, 0);
+    if (wearTestShared == MAP_FAILED)
+    {
+        printf("FAIL: shared memory\n");
+        return 1;
+    }
+
+    a_WearTest_Child("first boot", a_WearTest_First);
+    a_WearTest_Child("second boot", a_WearTest_Second);
+    a_WearTest_Child("damaged file", a_WearTest_Damaged);
+    a_WearTest_Child("leveling", a_WearTest_Level);
+
+    printf("%s\n", (failures == 0) ? "ok" : "FAIL");
+    return (failures == 0) ? 0 : 1;
+}
@@ -0,0 +1,74 @@
+/*
+ * checksum_test.c
+ *
+ * Checks the checksum offload of the driver in the build it is compiled
+ * for: with SAME54_ETH_CHECKSUM_OFFLOAD_SUPPORT the GMAC generates and
+ * verifies the checksums (DCFGR.TXCOEN, NCFGR.RXCOEN), the driver tells the
+ * stack so through autoChecksumCalc and reports the RX checksum status; without
+ * it all is left to the stack. Exits with 1 on failure.
+ */
+
+#include <stdio.h>
+#include "gmac_model.h"
+
+#define OFFLOAD     (SAME54_ETH_CHECKSUM_OFFLOAD_SUPPORT == ENABLED)
+
+// RX status bits 23:22 and the checksums the driver must report as verified
+static const struct
+{
+   uint32_t status;
+   bool_t ipChecksumValid;
+   bool_t upperLayerChecksumValid;
+} rxStatus[] =
+{
+   { 0x00000000, FALSE, FALSE },   // not IP, or a checksum is wrong
+   { 0x00400000, TRUE,  FALSE },   // IP header checked, not TCP or UDP
+   { 0x00800000, TRUE,  TRUE  },   // IP header and TCP checked
+   { 0x00C00000, TRUE,  TRUE  },   // IP header and UDP checked
+};
+
+int main(void)
+{
+   static uint8_t frame[600];
+   bool_t ipValid;
+   bool_t l4Valid;
+   uint_t failures = 0;
+   uint_t i;
+
+   gmacModelInit();
+
+   printf("checksum offload %s: autoChecksumCalc %d, RXCOEN %d, TXCOEN %d\n",
+      OFFLOAD ? "enabled" : "disabled", same54EthDriver.autoChecksumCalc,
+      (gmacRegs.GMAC_NCFGR & GMAC_NCFGR_RXCOEN_Msk) != 0,
+      (gmacRegs.GMAC_DCFGR & GMAC_DCFGR_TXCOEN_Msk) != 0);
+   if(!same54EthDriver.autoChecksumCalc != !OFFLOAD ||
+      !(gmacRegs.GMAC_NCFGR & GMAC_NCFGR_RXCOEN_Msk) != !OFFLOAD ||
+      !(gmacRegs.GMAC_DCFGR & GMAC_DCFGR_TXCOEN_Msk) != !OFFLOAD)
+   {
+      printf("FAIL offload configuration\n");
+      failures++;
+   }
+
+   for(i = 0; i < sizeof(rxStatus) / sizeof(rxStatus[0]); i++)
+   {
+      gmacModelRxFrames = 0;
+      gmacModelReceive(frame, sizeof(frame), rxStatus[i].status);
+      same54EthEventHandler(&gmacModelInterface);
+
+      // without offload the stack verifies everything itself
+      ipValid = OFFLOAD && rxStatus[i].ipChecksumValid;
+      l4Valid = OFFLOAD && rxStatus[i].upperLayerChecksumValid;
+      printf("RX status %08x: ipChecksumValid %d, upperLayerChecksumValid %d\n",
+         (unsigned int) rxStatus[i].status, gmacModelRxAncillary.ipChecksumValid,
+         gmacModelRxAncillary.upperLayerChecksumValid);
+      if(gmacModelRxFrames != 1 || !gmacModelRxAncillary.ipChecksumValid != !ipValid ||
+         !gmacModelRxAncillary.upperLayerChecksumValid != !l4Valid)
+      {
+         printf("FAIL RX status %08x\n", (unsigned int) rxStatus[i].status);
+         failures++;
+      }
+   }
+
+   printf("%s\n", (failures == 0) ? "ok" : "FAIL");
+   return (failures == 0) ? 0 : 1;
+}
@@ -0,0 +1,321 @@
+/*
+ * gmac_model.c
+ *
+ * Host model of the SAME54 GMAC, see gmac_model.h.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+#include "gmac_model.h"
+
+gmac_registers_t gmacRegs;
+mclk_registers_t mclkRegs;
+OsEvent netEvent;
+const NetRxAncillary NET_DEFAULT_RX_ANCILLARY = {0};
+const MacAddr MAC_UNSPECIFIED_ADDR = {{0}};
+
+NetInterface gmacModelInterface;
+NetRxAncillary gmacModelRxAncillary;
+uint32_t gmacModelRxFrames;
+uint32_t gmacModelRxDropped;
+uint32_t gmacModelRxLength;
+uint32_t gmacModelTxMidFrameUsed;
+
+static uint32_t gmacModelRxIndex;           // RX descriptor the GMAC writes next
+static const uint8_t *gmacModelRxFrame;     // frame of gmacModelReceiveStart()
+static size_t gmacModelRxFrameLength;
+static uint32_t gmacModelRxFrameStatus;
+static bool_t gmacModelRxImr;               // RX interrupts masked
+static uint32_t gmacModelRxCompleted;       // frames completed unmasked since the last interrupt
+static uint32_t gmacModelTxIndex;           // TX descriptor the GMAC reads next
+static uint32_t gmacModelTxFirst;           // first descriptor of the frame being sent
+static bool_t gmacModelTxRunning;
+static bool_t gmacModelTxBusy;
+
+
+size_t netBufferGetLength(const NetBuffer *buffer)
+{
+   size_t length = 0;
+   uint_t i;
+
+   for(i = 0; i < buffer->chunkCount; i++)
+   {
+      length += buffer->chunk[i].length;
+   }
+   return length;
+}
+
+size_t netBufferRead(void *dest, const NetBuffer *src, size_t srcOffset, size_t length)
+{
+   uint8_t *p = dest;
+   size_t done = 0;
+   size_t n;
+   uint_t i;
+
+   for(i = 0; i < src->chunkCount && done < length; i++)
+   {
+      if(srcOffset >= src->chunk[i].length)
+      {
+         srcOffset -= src->chunk[i].length;
+         continue;
+      }
+      n = MIN(src->chunk[i].length - srcOffset, length - done);
+      memcpy(p + done, src->chunk[i].address + srcOffset, n);
+      done += n;
+      srcOffset = 0;
+   }
+   return done;
+}
+
+void nicProcessPacket(NetInterface *interface, uint8_t *packet, size_t length,
+   NetRxAncillary *ancillary)
+{
+   (void) interface;
+   (void) packet;
+
+   gmacModelRxAncillary = *ancillary;
+   gmacModelRxLength = length;
+   gmacModelRxFrames++;
+}
+
+
+static error_t gmacModelPhyInit(NetInterface *interface)
+{
+   (void) interface;
+   return NO_ERROR;
+}
+
+static void gmacModelPhyNop(NetInterface *interface)
+{
+   (void) interface;
+}
+
+static const PhyDriver gmacModelPhy =
+{
+   gmacModelPhyInit,
+   gmacModelPhyNop,
+   gmacModelPhyNop,
+   gmacModelPhyNop,
+   gmacModelPhyNop
+};
+
+void gmacModelInit(void)
+{
+   memset(&gmacRegs, 0, sizeof(gmacRegs));
+   gmacRegs.GMAC_DCFGR = GMAC_DCFGR_RESETVALUE;
+   gmacModelRxIndex = 0;
+   gmacModelRxFrame = NULL;
+   gmacModelRxCompleted = 0;
+   gmacModelTxIndex = 0;
+   gmacModelTxRunning = FALSE;
+   gmacModelTxBusy = FALSE;
+
+   gmacModelInterface.nicDriver = &same54EthDriver;
+   gmacModelInterface.phyDriver = &gmacModelPhy;
+   gmacModelInterface.configured = TRUE;
+   if(same54EthInit(&gmacModelInterface) != NO_ERROR)
+   {
+      printf("same54EthInit failed\n");
+      exit(1);
+   }
+
+   //The driver masks everything, then unmasks what it uses
+   gmacModelRxImr = !(gmacRegs.GMAC_IER & GMAC_IER_RCOMP_Msk);
+   gmacRegs.GMAC_IER = 0;
+   gmacRegs.GMAC_IDR = 0;
+}
+
+
+static Same54RxBufferDesc *gmacModelRxDesc(uint32_t i)
+{
+   return (Same54RxBufferDesc *) (uintptr_t) gmacRegs.GMAC_RBQB + i;
+}
+
+static uint32_t gmacModelRxDescCount(void)
+{
+   uint32_t i = 0;
+
+   while(!(gmacModelRxDesc(i)->address & GMAC_RX_WRAP))
+   {
+      i++;
+   }
+   return i + 1;
+}
+
+static uint32_t gmacModelRxBufferSize(void)
+{
+   return ((gmacRegs.GMAC_DCFGR & GMAC_DCFGR_DRBS_Msk) >> GMAC_DCFGR_DRBS_Pos) * 64;
+}
+
+//Write buffer i of the frame and give it to the driver
+static void gmacModelRxWrite(uint32_t i, uint32_t n)
+{
+   uint32_t bufferSize = gmacModelRxBufferSize();
+   Same54RxBufferDesc *desc;
+   size_t offset;
+
+   desc = gmacModelRxDesc((gmacModelRxIndex + i) % gmacModelRxDescCount());
+   offset = i * bufferSize;
+   memcpy((void *) (uintptr_t) (desc->address & GMAC_RX_ADDRESS), gmacModelRxFrame + offset,
+      MIN(bufferSize, gmacModelRxFrameLength - offset));
+   desc->status = ((i == 0) ? GMAC_RX_SOF : 0) |
+      ((i == n - 1) ? (GMAC_RX_EOF | gmacModelRxFrameLength | gmacModelRxFrameStatus) : 0);
+   desc->address |= GMAC_RX_OWNERSHIP;
+}
+
+bool_t gmacModelReceiveStart(const uint8_t *frame, size_t length, uint32_t status)
+{
+   uint32_t bufferSize = gmacModelRxBufferSize();
+   uint32_t count = gmacModelRxDescCount();
+   uint32_t n = (length + bufferSize - 1) / bufferSize;
+   uint32_t i;
+
+   for(i = 0; i < n; i++)
+   {
+      if(gmacModelRxDesc((gmacModelRxIndex + i) % count)->address & GMAC_RX_OWNERSHIP)
+      {
+         gmacModelRxDropped++;
+         gmacRegs.GMAC_RSR |= GMAC_RSR_BNA_Msk;
+         return FALSE;
+      }
+   }
+   gmacModelRxFrame = frame;
+   gmacModelRxFrameLength = length;
+   gmacModelRxFrameStatus = status;
+   for(i = 0; i + 1 < n; i++)
+   {
+      gmacModelRxWrite(i, n);
+   }
+   return TRUE;
+}
+
+void gmacModelReceiveEnd(void)
+{
+   uint32_t bufferSize = gmacModelRxBufferSize();
+   uint32_t n = (gmacModelRxFrameLength + bufferSize - 1) / bufferSize;
+
+   if(gmacModelRxFrame != NULL)
+   {
+      gmacModelRxWrite(n - 1, n);
+      gmacModelRxIndex = (gmacModelRxIndex + n) % gmacModelRxDescCount();
+      gmacModelRxFrame = NULL;
+      if(!gmacModelRxMasked())
+      {
+         gmacModelRxCompleted++;
+      }
+      gmacRegs.GMAC_RSR |= GMAC_RSR_REC_Msk;
+   }
+}
+
+bool_t gmacModelReceive(const uint8_t *frame, size_t length, uint32_t status)
+{
+   if(!gmacModelReceiveStart(frame, length, status))
+   {
+      return FALSE;
+   }
+   gmacModelReceiveEnd();
+   return TRUE;
+}
+
+bool_t gmacModelRxMasked(void)
+{
+   if(gmacRegs.GMAC_IER & GMAC_IER_RCOMP_Msk)
+   {
+      gmacModelRxImr = FALSE;
+   }
+   if(gmacRegs.GMAC_IDR & GMAC_IDR_RCOMP_Msk)
+   {
+      gmacModelRxImr = TRUE;
+   }
+   gmacRegs.GMAC_IER = 0;
+   gmacRegs.GMAC_IDR = 0;
+   return gmacModelRxImr;
+}
+
+bool_t gmacModelRxIrq(void)
+{
+   if(gmacModelRxCompleted == 0 || gmacModelRxMasked())
+   {
+      return FALSE;
+   }
+   gmacModelRxCompleted = 0;
+   GMAC_Handler();
+   //Apply the writes of the ISR before those of the next driver call
+   (void) gmacModelRxMasked();
+   return TRUE;
+}
+
+static Same54TxBufferDesc *gmacModelTxDesc(uint32_t i)
+{
+   return (Same54TxBufferDesc *) (uintptr_t) gmacRegs.GMAC_TBQB + i;
+}
+
+size_t gmacModelTxStart(uint8_t *frame)
+{
+   Same54TxBufferDesc *desc;
+   uint32_t i = gmacModelTxIndex;
+   size_t length = 0;
+   size_t n;
+
+   if(gmacRegs.GMAC_NCR & GMAC_NCR_TSTART_Msk)
+   {
+      gmacRegs.GMAC_NCR &= ~GMAC_NCR_TSTART_Msk;
+      gmacModelTxRunning = TRUE;
+   }
+   if(!gmacModelTxRunning || gmacModelTxBusy)
+   {
+      return 0;
+   }
+   if(gmacModelTxDesc(i)->status & GMAC_TX_USED)
+   {
+      gmacModelTxRunning = FALSE;
+      return 0;
+   }
+
+   //Gather the buffers of the frame up to the last one
+   for(;;)
+   {
+      desc = gmacModelTxDesc(i);
+      n = desc->status & GMAC_TX_LENGTH;
+      memcpy(frame + length, (void *) (uintptr_t) desc->address, n);
+      length += n;
+      i = (desc->status & GMAC_TX_WRAP) ? 0 : (i + 1);
+      if(desc->status & GMAC_TX_LAST)
+      {
+         break;
+      }
+      if(gmacModelTxDesc(i)->status & GMAC_TX_USED)
+      {
+         //The GMAC drops the frame and stops
+         gmacModelTxMidFrameUsed++;
+         gmacModelTxRunning = FALSE;
+         return 0;
+      }
+   }
+
+   gmacModelTxFirst = gmacModelTxIndex;
+   gmacModelTxIndex = i;
+   gmacModelTxBusy = TRUE;
+   return length;
+}
+
+void gmacModelTxDone(void)
+{
+   if(gmacModelTxBusy)
+   {
+      gmacModelTxBusy = FALSE;
+      gmacModelTxDesc(gmacModelTxFirst)->status |= GMAC_TX_USED;
+      gmacRegs.GMAC_TSR = GMAC_TSR_TXCOMP_Msk;
+      GMAC_Handler();
+      gmacRegs.GMAC_TSR = 0;
+   }
+}
+
+double gmacModelNowNs(void)
+{
+   struct timespec t;
+
+   clock_gettime(CLOCK_MONOTONIC, &t);
+   return (double) t.tv_sec * 1e9 + (double) t.tv_nsec;
+}
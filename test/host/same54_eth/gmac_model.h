@@ -0,0 +1,61 @@
+/*
+ * gmac_model.h
+ *
+ * Host model of the SAME54 GMAC around same54_eth_driver.c: the register
+ * block is a plain struct, the model GMAC fills the RX descriptor ring the
+ * driver set up and the stack entry points record what they get.
+ */
+
+#ifndef GMAC_MODEL_H_
+#define GMAC_MODEL_H_
+
+#include "sam.h"
+#include "core/net.h"
+#include "same54_eth_driver.h"
+
+extern NetInterface gmacModelInterface;
+extern NetRxAncillary gmacModelRxAncillary;    // of the last frame passed to the stack
+extern uint32_t gmacModelRxFrames;              // frames passed to the stack
+extern uint32_t gmacModelRxDropped;             // frames the model GMAC found no free buffer for
+extern uint32_t gmacModelRxLength;              // of the last frame passed to the stack
+extern uint32_t gmacModelTxMidFrameUsed;        // frames cut short by a used descriptor after the first
+
+void GMAC_Handler(void);
+
+// Reset the registers and initialize the driver on the model interface
+void gmacModelInit(void);
+
+// The GMAC writes a frame, FCS included, into the free RX buffers. status is
+// or-ed into the status of the last descriptor, e.g. the checksum bits.
+// Returns FALSE and sets RSR.BNA when the ring is short of buffers.
+bool_t gmacModelReceive(const uint8_t *frame, size_t length, uint32_t status);
+
+// gmacModelReceive() in two steps: the GMAC writes every buffer of the frame
+// but the last, then gmacModelReceiveEnd() writes the last one and completes it
+bool_t gmacModelReceiveStart(const uint8_t *frame, size_t length, uint32_t status);
+void gmacModelReceiveEnd(void);
+
+// Whether RX interrupts are masked, once the IER and IDR writes of the driver
+// since the last call are applied. They are applied IER first, the driver
+// unmasks before it takes a last look at the ring, so the call must come
+// between two calls of the driver that write them.
+bool_t gmacModelRxMasked(void);
+
+// The GMAC interrupt for the frames completed since the last call, unless RX
+// interrupts are masked. A frame completed while they were masked raises
+// none. Returns whether GMAC_Handler() ran.
+bool_t gmacModelRxIrq(void);
+
+// The GMAC fetches the frame at its TX queue pointer, once TSTART was set, and
+// copies it to frame. Returns its length, 0 when the GMAC stopped at a used
+// descriptor or is still sending the previous frame.
+size_t gmacModelTxStart(uint8_t *frame);
+
+// The frame fetched by gmacModelTxStart() is on the wire: the GMAC sets the
+// used flag of its first descriptor and raises TSR.TXCOMP
+void gmacModelTxDone(void);
+
+// Monotonic host time for the benchmarks
+double gmacModelNowNs(void);
+
+#endif /* GMAC_MODEL_H_ */
@@ -0,0 +1,323 @@
+/*
+ * rx_poll_test.c
+ *
+ * Checks the polling rounds of the RX path of the driver against the model
+ * GMAC: a burst larger than SAME54_ETH_RX_BUDGET is received over several
+ * passes of the TCP/IP task with RX interrupts masked from the first
+ * interrupt to the end of the round, the frames that arrive meanwhile
+ * raising none, also when a pass of the task finds the burst before the
+ * interrupt ran. In the copying build, a frame the GMAC is still writing when
+ * the ring looks empty must start a new round rather than wait for an
+ * interrupt that was masked. In the zero-copy build, a frame spread over
+ * several buffers is dropped and its buffers given back, also across the end
+ * of the ring. Each case checks same54EthGetStats().
+ * Exits with 1 on failure.
+ */
+
+#include <stdio.h>
+#include "gmac_model.h"
+
+#define RX_TEST_SHORT   60              // bytes of a frame that fits in one buffer
+#define RX_TEST_SPLIT   300             // bytes of a frame over 3 buffers of the copying build
+#define RX_TEST_LONG    2000            // bytes of a frame over 2 buffers of the zero-copy build
+
+static uint8_t rxFrame[RX_TEST_LONG];
+static Same54EthStats rxStats;          // at the start of the case
+static uint_t failures;
+
+
+static void a_RxTest_Fail(const char *what, uint32_t value)
+{
+   if(failures++ < 10)
+   {
+      printf("FAIL %s, %u\n", what, (unsigned int) value);
+   }
+}
+
+// The counters of the case so far
+static void a_RxTest_Stats(Same54EthStats *delta)
+{
+   Same54EthStats now;
+
+   same54EthGetStats(&now);
+   delta->irqCount = now.irqCount - rxStats.irqCount;
+   delta->rxWakeups = now.rxWakeups - rxStats.rxWakeups;
+   delta->rxPolls = now.rxPolls - rxStats.rxPolls;
+   delta->rxFrames = now.rxFrames - rxStats.rxFrames;
+   delta->rxBudgetExhausted = now.rxBudgetExhausted - rxStats.rxBudgetExhausted;
+   delta->rxMaxFramesPerWakeup = now.rxMaxFramesPerWakeup;
+}
+
+static void a_RxTest_Start(void)
+{
+   gmacModelRxFrames = 0;
+   gmacModelInterface.nicEvent = FALSE;
+   netEvent.set = FALSE;
+   same54EthGetStats(&rxStats);
+}
+
+// One pass of the TCP/IP task, if the driver asked for it
+static bool_t a_RxTest_Pass(void)
+{
+   if(!gmacModelInterface.nicEvent)
+   {
+      return FALSE;
+   }
+   gmacModelInterface.nicEvent = FALSE;
+   netEvent.set = FALSE;
+   same54EthEventHandler(&gmacModelInterface);
+   return TRUE;
+}
+
+// Burst of first + late frames: the interrupt of the first masks RX, the late
+// ones arrive during the round and raise none
+static void a_RxTest_Budget(uint_t first, uint_t late)
+{
+   Same54EthStats stats;
+   uint_t passes;
+   uint_t i;
+
+   a_RxTest_Start();
+   for(i = 0; i < first; i++)
+   {
+      gmacModelReceive(rxFrame, RX_TEST_SHORT, 0);
+   }
+   if(!gmacModelRxIrq() || !gmacModelRxMasked() || !gmacModelInterface.nicEvent)
+   {
+      a_RxTest_Fail("RX masked and the task woken by the first interrupt", first);
+   }
+
+   //First pass: up to the budget, the round goes on past it
+   a_RxTest_Pass();
+   if(first >= SAME54_ETH_RX_BUDGET &&
+      (!gmacModelRxMasked() || !gmacModelInterface.nicEvent || !netEvent.set))
+   {
+      a_RxTest_Fail("RX masked and the task woken again on budget exhaustion", first);
+   }
+   for(i = 0; i < late; i++)
+   {
+      gmacModelReceive(rxFrame, RX_TEST_SHORT, 0);
+   }
+   if(gmacModelRxIrq())
+   {
+      a_RxTest_Fail("interrupt during the round", late);
+   }
+
+   //The other passes, one budget each
+   for(passes = 1; a_RxTest_Pass(); passes++)
+   {
+      if(passes > first + late)
+      {
+         a_RxTest_Fail("round never ends", passes);
+         break;
+      }
+   }
+   if(gmacModelRxMasked())
+   {
+      a_RxTest_Fail("RX still masked after the round", passes);
+   }
+
+   a_RxTest_Stats(&stats);
+   printf("burst of %u + %u frames: %u passes, irqCount %u, rxWakeups %u, rxFrames %u, "
+      "rxBudgetExhausted %u, rxMaxFramesPerWakeup %u\n", first, late, passes,
+      (unsigned int) stats.irqCount, (unsigned int) stats.rxWakeups, (unsigned int) stats.rxFrames,
+      (unsigned int) stats.rxBudgetExhausted, (unsigned int) stats.rxMaxFramesPerWakeup);
+   if(gmacModelRxFrames != first + late || stats.rxFrames != first + late)
+   {
+      a_RxTest_Fail("frames received", stats.rxFrames);
+   }
+   if(stats.irqCount != 1 || stats.rxWakeups != 1)
+   {
+      a_RxTest_Fail("one interrupt and one wakeup for the round", stats.rxWakeups);
+   }
+   if(stats.rxPolls != passes || passes != (first + late) / SAME54_ETH_RX_BUDGET + 1)
+   {
+      a_RxTest_Fail("passes of one budget each", stats.rxPolls);
+   }
+   if(stats.rxBudgetExhausted != passes - 1)
+   {
+      a_RxTest_Fail("budget exhausted on every pass but the last", stats.rxBudgetExhausted);
+   }
+   if(stats.rxMaxFramesPerWakeup < first + late)
+   {
+      a_RxTest_Fail("frames of the round", stats.rxMaxFramesPerWakeup);
+   }
+}
+
+// A pass of the TCP/IP task, woken for another reason, finds more than a
+// budget before the RX interrupt ran: it masks RX itself
+static void a_RxTest_NoIrq(void)
+{
+   Same54EthStats stats;
+   uint_t i;
+
+   a_RxTest_Start();
+   for(i = 0; i < SAME54_ETH_RX_BUDGET + 1; i++)
+   {
+      gmacModelReceive(rxFrame, RX_TEST_SHORT, 0);
+   }
+   gmacModelInterface.nicEvent = TRUE;
+   a_RxTest_Pass();
+   if(!gmacModelRxMasked() || !gmacModelInterface.nicEvent)
+   {
+      a_RxTest_Fail("RX masked by a pass without interrupt", gmacModelRxFrames);
+   }
+   if(gmacModelRxIrq())
+   {
+      a_RxTest_Fail("interrupt after the pass masked RX", 0);
+   }
+   a_RxTest_Pass();
+   if(gmacModelRxMasked() || gmacModelInterface.nicEvent)
+   {
+      a_RxTest_Fail("RX unmasked on an empty ring", 0);
+   }
+
+   a_RxTest_Stats(&stats);
+   printf("burst before the interrupt: irqCount %u, rxWakeups %u, rxPolls %u, rxFrames %u\n",
+      (unsigned int) stats.irqCount, (unsigned int) stats.rxWakeups, (unsigned int) stats.rxPolls,
+      (unsigned int) stats.rxFrames);
+   if(stats.irqCount != 0 || stats.rxWakeups != 0 || stats.rxPolls != 2 ||
+      stats.rxFrames != SAME54_ETH_RX_BUDGET + 1 || stats.rxBudgetExhausted != 1)
+   {
+      a_RxTest_Fail("counters of the round", stats.rxFrames);
+   }
+}
+
+#if (SAME54_ETH_RX_ZERO_COPY_SUPPORT == ENABLED)
+
+// Passes of the task to the end of the round
+static void a_RxTest_Round(void)
+{
+   uint_t passes;
+
+   for(passes = 0; a_RxTest_Pass(); passes++)
+   {
+      if(passes > SAME54_ETH_RX_BUFFER_COUNT)
+      {
+         a_RxTest_Fail("round never ends", passes);
+         break;
+      }
+   }
+}
+
+// Short frames around a frame of two buffers, the long one starting at each
+// entry of the ring in turn
+static void a_RxTest_MultiBuffer(void)
+{
+   Same54EthStats stats;
+   uint_t i;
+
+   for(i = 0; i < SAME54_ETH_RX_BUFFER_COUNT; i++)
+   {
+      a_RxTest_Start();
+      gmacModelReceive(rxFrame, RX_TEST_SHORT, 0);
+      gmacModelReceive(rxFrame, RX_TEST_LONG, 0);
+      gmacModelReceive(rxFrame, RX_TEST_SHORT + 1, 0);
+      gmacModelRxIrq();
+      a_RxTest_Round();
+
+      a_RxTest_Stats(&stats);
+      if(gmacModelRxFrames != 2 || gmacModelRxLength != RX_TEST_SHORT + 1 ||
+         stats.rxFrames != 2 || stats.rxPolls != 1 || stats.rxWakeups != 1)
+      {
+         a_RxTest_Fail("frames received around a frame of two buffers", gmacModelRxFrames);
+      }
+      if(gmacModelRxMasked())
+      {
+         a_RxTest_Fail("RX still masked after the drop", i);
+      }
+   }
+
+   //Every buffer was given back
+   a_RxTest_Start();
+   for(i = 0; i < SAME54_ETH_RX_BUFFER_COUNT; i++)
+   {
+      if(!gmacModelReceive(rxFrame, RX_TEST_SHORT, 0))
+      {
+         a_RxTest_Fail("buffer left to the driver", i);
+         break;
+      }
+   }
+   gmacModelRxIrq();
+   a_RxTest_Round();
+
+   a_RxTest_Stats(&stats);
+   printf("frames of two buffers dropped: rxFrames %u of %u\n", (unsigned int) stats.rxFrames,
+      (unsigned int) SAME54_ETH_RX_BUFFER_COUNT);
+   if(stats.rxFrames != SAME54_ETH_RX_BUFFER_COUNT)
+   {
+      a_RxTest_Fail("frames received after the drops", stats.rxFrames);
+   }
+}
+
+#else
+
+// A frame whose first buffers the GMAC wrote while the round was on: the
+// ring looks empty to the pass, but the frame completes while RX is masked
+static void a_RxTest_Rearm(void)
+{
+   Same54EthStats stats;
+
+   a_RxTest_Start();
+   gmacModelReceive(rxFrame, RX_TEST_SHORT, 0);
+   gmacModelRxIrq();
+   gmacModelReceiveStart(rxFrame, RX_TEST_SPLIT, 0);
+
+   //End of the round with buffers of the ring owned by the driver
+   a_RxTest_Pass();
+   if(!gmacModelRxMasked() || !gmacModelInterface.nicEvent || !netEvent.set)
+   {
+      a_RxTest_Fail("new round on a frame in the ring when unmasking", gmacModelRxFrames);
+   }
+   gmacModelReceiveEnd();
+   if(gmacModelRxIrq())
+   {
+      a_RxTest_Fail("interrupt while masked", 0);
+   }
+
+   a_RxTest_Pass();
+   if(gmacModelRxMasked() || gmacModelInterface.nicEvent)
+   {
+      a_RxTest_Fail("RX unmasked on an empty ring", 0);
+   }
+
+   a_RxTest_Stats(&stats);
+   printf("frame completed while masked: irqCount %u, rxWakeups %u, rxPolls %u, rxFrames %u\n",
+      (unsigned int) stats.irqCount, (unsigned int) stats.rxWakeups, (unsigned int) stats.rxPolls,
+      (unsigned int) stats.rxFrames);
+   if(gmacModelRxFrames != 2 || gmacModelRxLength != RX_TEST_SPLIT || stats.rxFrames != 2)
+   {
+      a_RxTest_Fail("frames received", stats.rxFrames);
+   }
+   if(stats.irqCount != 1 || stats.rxWakeups != 2 || stats.rxPolls != 2 ||
+      stats.rxBudgetExhausted != 0)
+   {
+      a_RxTest_Fail("a wakeup without interrupt for the frame", stats.rxWakeups);
+   }
+}
+
+#endif
+
+int main(void)
+{
+   gmacModelInit();
+
+   printf("RX %s, %u buffers of %u B, budget %u\n",
+      (SAME54_ETH_RX_ZERO_COPY_SUPPORT == ENABLED) ? "zero-copy" : "copying",
+      (unsigned int) SAME54_ETH_RX_BUFFER_COUNT, (unsigned int) SAME54_ETH_RX_BUFFER_SIZE,
+      (unsigned int) SAME54_ETH_RX_BUDGET);
+
+   //Within the budget, a whole ring, a whole ring refilled during the round
+   a_RxTest_Budget(SAME54_ETH_RX_BUDGET - 1, 0);
+   a_RxTest_Budget(SAME54_ETH_RX_BUFFER_COUNT, 0);
+   a_RxTest_Budget(SAME54_ETH_RX_BUFFER_COUNT, SAME54_ETH_RX_BUDGET);
+   a_RxTest_NoIrq();
+#if (SAME54_ETH_RX_ZERO_COPY_SUPPORT == ENABLED)
+   a_RxTest_MultiBuffer();
+#else
+   a_RxTest_Rearm();
+#endif
+
+   printf("%s\n", (failures == 0) ? "ok" : "FAIL");
+   return (failures == 0) ? 0 : 1;
+}
@@ -0,0 +1,179 @@
+/*
+ * net.h
+ *
+ * Host stand-in for the CycloneTCP types and calls the SAME54 GMAC driver
+ * uses. Fields the driver does not touch are left out; the OS event is a
+ * flag the tests poll.
+ */
+
+#ifndef NET_H_STUB_
+#define NET_H_STUB_
+
+#include <stdint.h>
+#include <stddef.h>
+#include <string.h>
+#include <inttypes.h>
+
+#define ENABLED                 1
+#define DISABLED                0
+#define TRUE                    1
+#define FALSE                   0
+
+#define MIN(a, b)               ((a) < (b) ? (a) : (b))
+#define MAX(a, b)               ((a) > (b) ? (a) : (b))
+#define osMemcpy                memcpy
+#define osMemset                memset
+#define __weak_func             __attribute__((weak))
+#define sleep(delay)
+
+typedef int bool_t;
+typedef unsigned int uint_t;
+
+typedef enum
+{
+   NO_ERROR = 0,
+   ERROR_FAILURE,
+   ERROR_INVALID_LENGTH,
+   ERROR_BUFFER_EMPTY,
+   ERROR_INVALID_PACKET,
+   ERROR_OUT_OF_MEMORY
+} error_t;
+
+typedef struct
+{
+   volatile bool_t set;
+} OsEvent;
+
+typedef union
+{
+   uint8_t b[6];
+   uint16_t w[3];
+} MacAddr;
+
+typedef struct
+{
+   MacAddr addr;
+   uint_t refCount;
+   bool_t addFlag;
+   bool_t deleteFlag;
+} MacFilterEntry;
+
+#define MAC_ADDR_FILTER_SIZE    12
+#define macIsMulticastAddr(macAddr) (((macAddr)->b[0] & 0x01) != 0)
+extern const MacAddr MAC_UNSPECIFIED_ADDR;
+
+#define SMI_OPCODE_WRITE        1
+#define SMI_OPCODE_READ         2
+#define ETH_MAX_FRAME_SIZE      1518
+#define ETH_MTU                 1500
+
+typedef struct
+{
+   uint8_t *address;
+   uint16_t length;
+   uint16_t size;
+} ChunkDesc;
+
+typedef struct
+{
+   uint_t chunkCount;
+   uint_t maxChunkCount;
+   ChunkDesc chunk[];
+} NetBuffer;
+
+typedef struct
+{
+   uint8_t ttl;
+   uint8_t tos;
+   bool_t deferChecksum;
+} NetTxAncillary;
+
+typedef struct
+{
+   uint8_t ttl;
+   uint8_t tos;
+   bool_t ipChecksumValid;
+   bool_t upperLayerChecksumValid;
+} NetRxAncillary;
+
+extern const NetRxAncillary NET_DEFAULT_RX_ANCILLARY;
+
+typedef struct _NetInterface NetInterface;
+
+typedef struct
+{
+   error_t (*init)(NetInterface *interface);
+   void (*tick)(NetInterface *interface);
+   void (*enableIrq)(NetInterface *interface);
+   void (*disableIrq)(NetInterface *interface);
+   void (*eventHandler)(NetInterface *interface);
+} PhyDriver;
+
+typedef PhyDriver SwitchDriver;
+
+typedef enum
+{
+   NIC_TYPE_ETHERNET = 1
+} NicType;
+
+#define NIC_LINK_SPEED_100MBPS  100000000
+#define NIC_FULL_DUPLEX_MODE    2
+
+typedef struct
+{
+   NicType type;
+   size_t mtu;
+   error_t (*init)(NetInterface *interface);
+   void (*tick)(NetInterface *interface);
+   void (*enableIrq)(NetInterface *interface);
+   void (*disableIrq)(NetInterface *interface);
+   void (*eventHandler)(NetInterface *interface);
+   error_t (*sendPacket)(NetInterface *interface, const NetBuffer *buffer,
+      size_t offset, NetTxAncillary *ancillary);
+   error_t (*updateMacAddrFilter)(NetInterface *interface);
+   error_t (*updateMacConfig)(NetInterface *interface);
+   void (*writePhyReg)(uint8_t opcode, uint8_t phyAddr, uint8_t regAddr, uint16_t data);
+   uint16_t (*readPhyReg)(uint8_t opcode, uint8_t phyAddr, uint8_t regAddr);
+   bool_t autoPadding;
+   bool_t autoCrcCalc;
+   bool_t autoCrcVerif;
+   bool_t autoCrcStrip;
+   bool_t autoChecksumCalc;
+} NicDriver;
+
+struct _NetInterface
+{
+   const NicDriver *nicDriver;
+   const PhyDriver *phyDriver;
+   const SwitchDriver *switchDriver;
+   OsEvent nicTxEvent;
+   bool_t nicEvent;
+   MacAddr macAddr;
+   uint32_t linkSpeed;
+   int duplexMode;
+   MacFilterEntry macAddrFilter[MAC_ADDR_FILTER_SIZE];
+   bool_t configured;
+};
+
+extern OsEvent netEvent;
+
+static inline void osSetEvent(OsEvent *event)
+{
+   event->set = TRUE;
+}
+
+static inline bool_t osSetEventFromIsr(OsEvent *event)
+{
+   event->set = TRUE;
+   return FALSE;
+}
+
+#define osEnterIsr()
+#define osExitIsr(flag) (void) (flag)
+
+size_t netBufferGetLength(const NetBuffer *buffer);
+size_t netBufferRead(void *dest, const NetBuffer *src, size_t srcOffset, size_t length);
+void nicProcessPacket(NetInterface *interface, uint8_t *packet, size_t length,
+   NetRxAncillary *ancillary);
+
+#endif /* NET_H_STUB_ */
@@ -0,0 +1,15 @@
+/*
+ * debug.h
+ *
+ * Host stand-in for the CycloneTCP trace macros, all silent.
+ */
+
+#ifndef DEBUG_H_STUB_
+#define DEBUG_H_STUB_
+
+#define TRACE_INFO(...)
+#define TRACE_DEBUG(...)
+#define TRACE_WARNING(...)
+#define TRACE_ERROR(...)
+
+#endif /* DEBUG_H_STUB_ */
@@ -0,0 +1,41 @@
+/*
+ * sam.h
+ *
+ * Host stand-in for the device header: the GMAC and MCLK register blocks of
+ * the pack are plain structs of the model, the NVIC calls do nothing.
+ */
+
+#ifndef SAM_H_STUB_
+#define SAM_H_STUB_
+
+#include <stdint.h>
+
+#define _UINT32_(x)     ((uint32_t)(x))
+#define _UINT16_(x)     ((uint16_t)(x))
+#define _UINT8_(x)      ((uint8_t)(x))
+#define __I             volatile const
+#define __O             volatile
+#define __IO            volatile
+#define __IM            volatile const
+#define __OM            volatile
+#define __IOM           volatile
+
+#include "component/gmac.h"
+#include "component/mclk.h"
+
+extern gmac_registers_t gmacRegs;
+extern mclk_registers_t mclkRegs;
+
+#define GMAC_REGS       (&gmacRegs)
+#define MCLK_REGS       (&mclkRegs)
+#define GMAC_IRQn       0
+
+static inline void NVIC_SetPriorityGrouping(uint32_t group) { (void)group; }
+static inline void NVIC_SetPriority(int irq, uint32_t priority) { (void)irq; (void)priority; }
+static inline uint32_t NVIC_EncodePriority(uint32_t group, uint32_t pre, uint32_t sub) { return group + pre + sub; }
+static inline void NVIC_EnableIRQ(int irq) { (void)irq; }
+static inline void NVIC_DisableIRQ(int irq) { (void)irq; }
+
+#define __DSB()         __sync_synchronize()
+
+#endif /* SAM_H_STUB_ */
@@ -0,0 +1,465 @@
+/*
+ * tx_ring_test.c
+ *
+ * Checks the scatter-gather TX ring of the driver against the model GMAC,
+ * which sets the used flag of the first descriptor of a frame once it is
+ * sent: the ring filling up on descriptors and on bytes, frames split across
+ * the end of the ring, the reclaim of sent frames and, on random traffic,
+ * that nicTxEvent is only set while a frame of any size fits. Then a
+ * simulated 100 Mbit/s link gives the throughput, the idle time of the wire
+ * and the task wakeups per frame, bursts of B frames every G us with
+ * "tx_ring_test B G". Without scatter-gather only the benchmark runs.
+ * Exits with 1 on failure.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include "gmac_model.h"
+
+#define SCATTER_GATHER  (SAME54_ETH_TX_SCATTER_GATHER_SUPPORT == ENABLED)
+
+#define TX_TEST_HEADER  54              // bytes in the first chunk, as for TCP over IPv4
+#define TX_TEST_MAX     1514
+
+//Target costs of the benchmark, in ns
+#define TX_TEST_SEND_NS 8000.0          // stack work per frame
+#define TX_TEST_WAKE_NS 15000.0         // ISR, event and context switch back to the sending task
+
+static uint8_t txHeader[TX_TEST_HEADER];
+static uint8_t txPayload[TX_TEST_MAX];
+static uint8_t wireFrame[2048];
+static uint32_t txSeq;                  // of the next frame queued
+static uint32_t wireSeq;                // of the next frame expected on the wire
+static uint_t failures;
+
+
+static void a_TxTest_Fail(const char *what, uint32_t seq)
+{
+   if(failures++ < 10)
+   {
+      printf("FAIL %s, frame %u\n", what, (unsigned int) seq);
+   }
+}
+
+// Write the next frame of length bytes: its sequence number and a pattern that depends on it
+static void a_TxTest_Fill(size_t length)
+{
+   uint8_t *p;
+   size_t i;
+
+   for(i = 0; i < length; i++)
+   {
+      p = (i < TX_TEST_HEADER) ? &txHeader[i] : &txPayload[i - TX_TEST_HEADER];
+      *p = (i < 4) ? (uint8_t) (txSeq >> (8 * i)) : (uint8_t) (txSeq * 7 + i);
+   }
+}
+
+// Queue the frame written by a_TxTest_Fill(), in two chunks as the stack does
+static error_t a_TxTest_Queue(size_t length)
+{
+   struct
+   {
+      uint_t chunkCount;
+      uint_t maxChunkCount;
+      ChunkDesc chunk[2];
+   } buffer;
+   error_t error;
+
+   buffer.chunkCount = 2;
+   buffer.maxChunkCount = 2;
+   buffer.chunk[0].address = txHeader;
+   buffer.chunk[0].length = (uint16_t) MIN(length, TX_TEST_HEADER);
+   buffer.chunk[1].address = txPayload;
+   buffer.chunk[1].length = (uint16_t) (length - buffer.chunk[0].length);
+
+   gmacModelInterface.nicTxEvent.set = FALSE;
+   error = same54EthSendPacket(&gmacModelInterface, (NetBuffer *) &buffer, 0, NULL);
+   if(error == NO_ERROR)
+   {
+      txSeq++;
+   }
+   return error;
+}
+
+// Check a frame the GMAC fetched, in order and intact
+static void a_TxTest_Check(size_t length)
+{
+   uint32_t seq = wireFrame[0] | (wireFrame[1] << 8) | (wireFrame[2] << 16) |
+      ((uint32_t) wireFrame[3] << 24);
+   size_t i;
+
+   if(seq != wireSeq)
+   {
+      a_TxTest_Fail("out of order", wireSeq);
+   }
+   for(i = 4; i < length; i++)
+   {
+      if(wireFrame[i] != (uint8_t) (seq * 7 + i))
+      {
+         a_TxTest_Fail("corrupt", seq);
+         break;
+      }
+   }
+   wireSeq = seq + 1;
+}
+
+#if SCATTER_GATHER
+
+static error_t a_TxTest_Send(size_t length)
+{
+   a_TxTest_Fill(length);
+   return a_TxTest_Queue(length);
+}
+
+static Same54TxBufferDesc *a_TxTest_Desc(uint_t i)
+{
+   return (Same54TxBufferDesc *) (uintptr_t) gmacRegs.GMAC_TBQB + i;
+}
+
+// The GMAC sends every queued frame
+static uint_t a_TxTest_Drain(void)
+{
+   size_t length;
+   uint_t n = 0;
+
+   while((length = gmacModelTxStart(wireFrame)) != 0)
+   {
+      a_TxTest_Check(length);
+      gmacModelTxDone();
+      n++;
+   }
+   return n;
+}
+
+// Short frames until every descriptor is taken
+static void a_TxTest_FullOnDescriptors(void)
+{
+   uint_t queued = 0;
+
+   while(queued <= SAME54_ETH_TX_BUFFER_COUNT && a_TxTest_Send(60) == NO_ERROR)
+   {
+      queued++;
+      //A frame may need two descriptors
+      if(gmacModelInterface.nicTxEvent.set != ((SAME54_ETH_TX_BUFFER_COUNT - queued) >= 2))
+      {
+         a_TxTest_Fail("nicTxEvent with the descriptors filling up", txSeq - 1);
+      }
+   }
+   if(queued != SAME54_ETH_TX_BUFFER_COUNT)
+   {
+      a_TxTest_Fail("descriptors not all used", txSeq);
+   }
+
+   //Two frames sent free room for a frame that may wrap, the ISR tells the stack
+   gmacModelTxStart(wireFrame);
+   a_TxTest_Check(60);
+   gmacModelTxDone();
+   if(gmacModelInterface.nicTxEvent.set)
+   {
+      a_TxTest_Fail("nicTxEvent with one descriptor free", wireSeq - 1);
+   }
+   gmacModelTxStart(wireFrame);
+   a_TxTest_Check(60);
+   gmacModelTxDone();
+   if(!gmacModelInterface.nicTxEvent.set || a_TxTest_Send(60) != NO_ERROR)
+   {
+      a_TxTest_Fail("sent descriptors not reclaimed", txSeq);
+   }
+   if(a_TxTest_Drain() != SAME54_ETH_TX_BUFFER_COUNT - 1 || wireSeq != txSeq)
+   {
+      a_TxTest_Fail("frames lost", wireSeq);
+   }
+}
+
+// Full sized frames until the bytes run out
+static void a_TxTest_FullOnBytes(void)
+{
+   const size_t size = (TX_TEST_MAX + 3) & ~3U;
+   uint_t expected = MIN(SAME54_ETH_TX_RING_SIZE / size, SAME54_ETH_TX_BUFFER_COUNT);
+   uint_t queued = 0;
+
+   while(a_TxTest_Send(TX_TEST_MAX) == NO_ERROR)
+   {
+      queued++;
+      if(gmacModelInterface.nicTxEvent.set !=
+         ((SAME54_ETH_TX_RING_SIZE - queued * size) >= SAME54_ETH_TX_BUFFER_SIZE))
+      {
+         a_TxTest_Fail("nicTxEvent with the bytes filling up", txSeq - 1);
+      }
+   }
+   if(queued != expected)
+   {
+      a_TxTest_Fail("ring bytes not all used", txSeq);
+   }
+   if(a_TxTest_Drain() != queued || wireSeq != txSeq)
+   {
+      a_TxTest_Fail("frames lost", wireSeq);
+   }
+}
+
+// Frames across the end of the ring go out from two descriptors, the second at the ring start
+static void a_TxTest_Split(void)
+{
+   Same54TxBufferDesc *first;
+   Same54TxBufferDesc *second;
+   uint_t splits = 0;
+   uint_t i = 0;
+   uint_t n;
+
+   for(n = 0; n < 64; n++)
+   {
+      if(a_TxTest_Send(TX_TEST_MAX) != NO_ERROR)
+      {
+         a_TxTest_Fail("not queued in an empty ring", txSeq);
+         return;
+      }
+      first = a_TxTest_Desc(i);
+      if(!(first->status & GMAC_TX_LAST))
+      {
+         second = a_TxTest_Desc((i + 1) % SAME54_ETH_TX_BUFFER_COUNT);
+         if(!(second->status & GMAC_TX_LAST) ||
+            (first->status & GMAC_TX_LENGTH) + (second->status & GMAC_TX_LENGTH) != TX_TEST_MAX ||
+            first->address + (first->status & GMAC_TX_LENGTH) != second->address + SAME54_ETH_TX_RING_SIZE)
+         {
+            a_TxTest_Fail("split descriptors", txSeq - 1);
+         }
+         splits++;
+         i++;
+      }
+      i = (i + 1) % SAME54_ETH_TX_BUFFER_COUNT;
+
+      //Both descriptors are taken back after the frame is sent
+      a_TxTest_Drain();
+      same54EthReclaimTxBufferDesc(&gmacModelInterface);
+      if(!(first->status & GMAC_TX_USED) ||
+         !(a_TxTest_Desc((i + SAME54_ETH_TX_BUFFER_COUNT - 1) % SAME54_ETH_TX_BUFFER_COUNT)->status & GMAC_TX_USED))
+      {
+         a_TxTest_Fail("split frame not reclaimed", txSeq - 1);
+      }
+   }
+   if(splits == 0)
+   {
+      a_TxTest_Fail("no frame split", txSeq);
+   }
+}
+
+// Frames fetched by the GMAC but not yet sent stay queued until their used flag is set
+static void a_TxTest_Reclaim(void)
+{
+   uint_t n;
+
+   for(n = 0; n < 3; n++)
+   {
+      a_TxTest_Send(600);
+   }
+   gmacModelTxStart(wireFrame);
+   same54EthReclaimTxBufferDesc(&gmacModelInterface);
+   a_TxTest_Check(600);
+   gmacModelTxDone();
+   same54EthReclaimTxBufferDesc(&gmacModelInterface);
+   if(a_TxTest_Drain() != 2 || wireSeq != txSeq)
+   {
+      a_TxTest_Fail("queued frames reclaimed", wireSeq);
+   }
+}
+
+// Random lengths, sends and completions. The stack sends while nicTxEvent is set, a frame of
+// any size must then fit
+static void a_TxTest_Random(void)
+{
+   bool_t ready = TRUE;
+   size_t length;
+   uint_t n;
+
+   srand(1);
+   for(n = 0; n < 200000; n++)
+   {
+      switch(rand() % 3)
+      {
+      case 0:
+         if(ready)
+         {
+            length = (rand() & 1) ? TX_TEST_MAX : (size_t) (60 + rand() % (TX_TEST_MAX - 59));
+            if(a_TxTest_Send(length) != NO_ERROR)
+            {
+               a_TxTest_Fail("not queued with nicTxEvent set", txSeq);
+            }
+            ready = gmacModelInterface.nicTxEvent.set;
+         }
+         break;
+      case 1:
+         length = gmacModelTxStart(wireFrame);
+         if(length != 0)
+         {
+            a_TxTest_Check(length);
+         }
+         break;
+      default:
+         gmacModelInterface.nicTxEvent.set = FALSE;
+         gmacModelTxDone();
+         ready = ready || gmacModelInterface.nicTxEvent.set;
+         break;
+      }
+   }
+   gmacModelTxDone();
+   a_TxTest_Drain();
+   if(wireSeq != txSeq || gmacModelTxMidFrameUsed != 0)
+   {
+      a_TxTest_Fail("frames lost or cut", wireSeq);
+   }
+}
+
+#endif
+
+// Simulated 100 Mbit/s link, times in ns. The model GMAC fetches the next frame as soon as
+// one is on the wire
+static bool_t benchBusy;
+static double benchWireEnd;             // the frame on the wire ends
+static double benchWireIdle;
+static uint64_t benchFrames;
+
+static void a_TxBench_Start(double t)
+{
+   size_t length;
+
+   if(!benchBusy)
+   {
+      length = gmacModelTxStart(wireFrame);
+      if(length != 0)
+      {
+         a_TxTest_Check(length);
+         if(t > benchWireEnd)
+         {
+            benchWireIdle += t - benchWireEnd;
+            benchWireEnd = t;
+         }
+         //Preamble, FCS and inter-frame gap, 80 ns a byte
+         benchWireEnd += (MAX(length, 60) + 4 + 8 + 12) * 80.0;
+         benchBusy = TRUE;
+         benchFrames++;
+      }
+   }
+}
+
+// Run the GMAC up to t
+static void a_TxBench_Advance(double t)
+{
+   a_TxBench_Start(t);
+   while(benchBusy && benchWireEnd <= t)
+   {
+      benchBusy = FALSE;
+      gmacModelTxDone();
+      a_TxBench_Start(benchWireEnd);
+   }
+}
+
+// The task sends while nicTxEvent is set and sleeps until the ISR sets it again, in bursts of
+// burstLength frames every burstGap ns if burstLength is not 0
+static void a_TxTest_Benchmark(uint_t burstLength, double burstGap)
+{
+   static const size_t sizes[] = { 60, 590, 1514, 0 };
+   double now = 0;
+   double t0;
+   double c0;
+   double host;
+   double idle0;
+   uint64_t frames0;
+   uint64_t sends;
+   uint64_t wakeups;
+   uint64_t fails;
+   uint_t inBurst = 0;
+   size_t length;
+   uint_t s;
+
+   for(s = 0; s < sizeof(sizes) / sizeof(sizes[0]); s++)
+   {
+      sends = wakeups = fails = 0;
+      host = 0;
+      t0 = now;
+      idle0 = benchWireIdle;
+      frames0 = benchFrames;
+      gmacModelInterface.nicTxEvent.set = TRUE;
+
+      while(now - t0 < 1e9)
+      {
+         if(burstLength != 0 && inBurst == burstLength)
+         {
+            //Idle until the next burst, the GMAC goes on
+            inBurst = 0;
+            now += burstGap;
+            a_TxBench_Advance(now);
+         }
+         else if(gmacModelInterface.nicTxEvent.set)
+         {
+            length = sizes[s] ? sizes[s] : (size_t) (60 + rand() % (TX_TEST_MAX - 59));
+            a_TxTest_Fill(length);
+            c0 = gmacModelNowNs();
+            if(a_TxTest_Queue(length) != NO_ERROR)
+            {
+               fails++;
+            }
+            host += gmacModelNowNs() - c0;
+            sends++;
+            inBurst++;
+            now += TX_TEST_SEND_NS;
+            a_TxBench_Advance(now);
+         }
+         else if(benchBusy)
+         {
+            //Sleep until the ISR of the frame on the wire
+            now = benchWireEnd;
+            a_TxBench_Advance(now);
+            if(gmacModelInterface.nicTxEvent.set)
+            {
+               wakeups++;
+               now += TX_TEST_WAKE_NS;
+               a_TxBench_Advance(now);
+            }
+         }
+         else
+         {
+            printf("FAIL stalled: no nicTxEvent and the GMAC idle\n");
+            failures++;
+            return;
+         }
+      }
+
+      printf("%4u B: %7.0f frames/s, wire idle %4.1f%%, wakeups/frame %.2f, failed %u, host driver %.0f ns/frame\n",
+         (unsigned int) sizes[s], (benchFrames - frames0) / ((now - t0) / 1e9),
+         100.0 * (benchWireIdle - idle0) / (now - t0),
+         (double) wakeups / MAX(benchFrames - frames0, 1), (unsigned int) fails, host / MAX(sends, 1));
+
+      //Drain before the next size
+      while(benchBusy)
+      {
+         now = benchWireEnd;
+         a_TxBench_Advance(now);
+      }
+   }
+}
+
+int main(int argc, char **argv)
+{
+   gmacModelInit();
+
+#if SCATTER_GATHER
+   a_TxTest_FullOnDescriptors();
+   a_TxTest_FullOnBytes();
+   a_TxTest_Split();
+   a_TxTest_Reclaim();
+   a_TxTest_Random();
+   printf("scatter-gather ring, %u descriptors, %u bytes: %s\n", SAME54_ETH_TX_BUFFER_COUNT,
+      SAME54_ETH_TX_RING_SIZE, (failures == 0) ? "ok" : "FAIL");
+#else
+   printf("%u TX buffers of %u bytes\n", SAME54_ETH_TX_BUFFER_COUNT, SAME54_ETH_TX_BUFFER_SIZE);
+#endif
+
+   a_TxTest_Benchmark((argc > 2) ? (uint_t) atoi(argv[1]) : 0, (argc > 2) ? atof(argv[2]) * 1000 : 0);
+   if(wireSeq != txSeq || gmacModelTxMidFrameUsed != 0)
+   {
+      a_TxTest_Fail("frames lost in the benchmark", wireSeq);
+   }
+
+   printf("%s\n", (failures == 0) ? "ok" : "FAIL");
+   return (failures == 0) ? 0 : 1;
+}
@@ -0,0 +1,231 @@
+/*
+ * sched_test.c
+ *
+ * Checks the read latency of w25qxx_sched.c under a long erase on the W25Q128
+ * model. A 64k block erase runs through the scheduler while reads arrive on
+ * a fixed period from the wait_ready of the writer, i.e. while it sleeps
+ * with bus_mutex released, as a reader task would on the target. Every read
+ * issued while the chip is busy must suspend the erase, so the worst case
+ * is bounded by the resume to suspend spacing plus tSUS and the transfer,
+ * not by the erase time; a read owing that spacing must sleep with bus_mutex
+ * released rather than spin in delay_us. The erase must still complete with the array erased, and the
+ * latency statistics of the scheduler must agree with the measured ones.
+ * The table gives the reads, suspends and latencies per read period. Exits
+ * with 1 on failure.
+ */
+
+#include <stdio.h>
+#include <string.h>
+#include "w25q_model.h"
+#include "w25qxx_sched.h"
+
+#define SCHED_TEST_ERASE        0x10000     // 64k block under erase
+#define SCHED_TEST_DATA         0x80000     // read while it is erased
+#define SCHED_TEST_READ_LEN     256
+#define SCHED_TEST_READ_US      (((SCHED_TEST_READ_LEN + 5) * 8) / 50 + 5)  // fast read on the 50 MHz model
+#define SCHED_TEST_SLACK_US     40          // status polls, suspend and resume commands
+
+static w25qxx_handle_t schedTestHandle;
+static w25qxx_sched_t schedTest;
+static uint8_t schedTestBuf[SCHED_TEST_READ_LEN];
+static uint32_t schedTestPeriodUs;
+static uint64_t schedTestNextRead;
+static uint32_t schedTestReads;
+static uint32_t schedTestBusyReads;        // reads issued while the erase ran
+static uint32_t schedTestMaxUs;
+static uint32_t schedTestSleeps;            // waits of a reader owing the resume to suspend spacing
+static int schedTestInRead;
+static unsigned int failures;
+
+
+static void a_SchedTest_Fail(const char *what, uint32_t period, uint64_t value)
+{
+    if (failures++ < 10)
+    {
+        printf("FAIL %s, period %u us, %llu\n", what, (unsigned int)period, (unsigned long long)value);
+    }
+}
+
+static uint32_t a_SchedTest_Timestamp(void)
+{
+    return (uint32_t)w25qModelTimeUs;
+}
+
+static void a_SchedTest_Read(void)
+{
+    uint64_t start = w25qModelTimeUs;
+    uint32_t us;
+
+    if (w25qModelBusy())
+    {
+        schedTestBusyReads++;
+    }
+    schedTestInRead = 1;
+    if (w25qxx_sched_read(&schedTest, SCHED_TEST_DATA, schedTestBuf, SCHED_TEST_READ_LEN) != 0)
+    {
+        a_SchedTest_Fail("read", schedTestPeriodUs, schedTestReads);
+    }
+    else if (memcmp(schedTestBuf, &w25qModelArray()[SCHED_TEST_DATA], SCHED_TEST_READ_LEN) != 0)
+    {
+        a_SchedTest_Fail("read data", schedTestPeriodUs, schedTestReads);
+    }
+    schedTestInRead = 0;
+
+    us = (uint32_t)(w25qModelTimeUs - start);
+    if (us > schedTestMaxUs)
+    {
+        schedTestMaxUs = us;
+    }
+    schedTestReads++;
+}
+
+// wait_ready of the handle: the writer sleeping with bus_mutex released, the reads due meanwhile
+// come in; or a reader sleeping off the resume to suspend spacing
+static void a_SchedTest_WaitReady(void *descr, uint32_t us)
+{
+    uint64_t end = w25qModelTimeUs + us;
+
+    (void)descr;
+
+    if (schedTestInRead != 0)
+    {
+        if (pthread_mutex_trylock(&schedTest.bus_mutex) != 0)
+        {
+            a_SchedTest_Fail("reader sleeps holding bus_mutex", schedTestPeriodUs, us);
+        }
+        else
+        {
+            pthread_mutex_unlock(&schedTest.bus_mutex);
+        }
+        schedTestSleeps++;
+        w25qModelTimeUs = end;
+        return;
+    }
+
+    while ((schedTestPeriodUs != 0) && (schedTestNextRead < end))
+    {
+        if (w25qModelTimeUs < schedTestNextRead)
+        {
+            w25qModelTimeUs = schedTestNextRead;
+        }
+        a_SchedTest_Read();
+        schedTestNextRead += schedTestPeriodUs;
+    }
+    if (w25qModelTimeUs < end)
+    {
+        w25qModelTimeUs = end;
+    }
+}
+
+static void a_SchedTest_Erase(uint32_t period)
+{
+    w25qxx_sched_stats_t stats;
+    uint64_t start;
+    uint32_t p99;
+    uint32_t bound;
+    uint32_t i;
+    int spaced;
+
+    memset(&w25qModelArray()[SCHED_TEST_ERASE], 0x00, 0x10000);
+    w25qxx_sched_clear_stats(&schedTest);
+    w25qModelResetCounters();
+    schedTestPeriodUs = period;
+    schedTestNextRead = w25qModelTimeUs + period;
+    schedTestReads = 0;
+    schedTestBusyReads = 0;
+    schedTestMaxUs = 0;
+    schedTestSleeps = 0;
+
+    start = w25qModelTimeUs;
+    if (w25qxx_sched_block_erase_64k(&schedTest, SCHED_TEST_ERASE) != 0)
+    {
+        a_SchedTest_Fail("erase", period, 0);
+    }
+    for (i = 0; i < 0x10000; i++)
+    {
+        if (w25qModelArray()[SCHED_TEST_ERASE + i] != 0xFF)
+        {
+            a_SchedTest_Fail("block not erased", period, SCHED_TEST_ERASE + i);
+            break;
+        }
+    }
+    if (w25qModelBusy())
+    {
+        a_SchedTest_Fail("erase returned with the chip busy", period, 0);
+    }
+
+    w25qxx_sched_get_stats(&schedTest, &stats, &p99);
+    printf("%9u %6u %9u %8u %7u %7u %9llu\n", (unsigned int)period, (unsigned int)schedTestReads,
+           (unsigned int)w25qModelSuspends, (unsigned int)schedTestSleeps, (unsigned int)p99,
+           (unsigned int)schedTestMaxUs, (unsigned long long)(w25qModelTimeUs - start));
+
+    if (period == 0)
+    {
+        return;
+    }
+    bound = SCHED_TEST_READ_US + W25QXX_SCHED_SUSPEND_US + SCHED_TEST_SLACK_US;
+    spaced = (period < (W25QXX_SCHED_RESUME_TO_SUSPEND_US + bound)) ? 1 : 0;      // next read may come before the spacing ran
+    if (spaced != 0)
+    {
+        bound += W25QXX_SCHED_RESUME_TO_SUSPEND_US;
+    }
+    if ((schedTestReads < w25qModelErase64kUs / (period + W25QXX_SCHED_RESUME_TO_SUSPEND_US)) || (stats.reads != schedTestReads))
+    {
+        a_SchedTest_Fail("reads not served during the erase", period, schedTestReads);
+    }
+    if (schedTestMaxUs > bound)
+    {
+        a_SchedTest_Fail("worst case read latency", period, schedTestMaxUs);
+    }
+    if ((stats.read_max_us != schedTestMaxUs) || (p99 > stats.read_max_us))
+    {
+        a_SchedTest_Fail("scheduler statistics disagree", period, stats.read_max_us);
+    }
+    if ((stats.suspends != w25qModelSuspends) || (w25qModelSuspends + 1 < schedTestBusyReads))
+    {
+        a_SchedTest_Fail("a read did not suspend the erase", period, w25qModelSuspends);
+    }
+    if (w25qModelResumeToSuspendMinUs < W25QXX_SCHED_RESUME_TO_SUSPEND_US)
+    {
+        a_SchedTest_Fail("erase suspended sooner than the spacing after a resume", period, w25qModelResumeToSuspendMinUs);
+    }
+    if (w25qModelDelayUs != (uint64_t)w25qModelSuspends * W25QXX_SCHED_SUSPEND_US)
+    {
+        a_SchedTest_Fail("delay_us beyond tSUS, a reader spun", period, w25qModelDelayUs);
+    }
+    if (spaced != (schedTestSleeps != 0))
+    {
+        a_SchedTest_Fail("resume to suspend spacing not slept off", period, schedTestSleeps);
+    }
+}
+
+int main(void)
+{
+    static const uint32_t periods[] = {0, 2000, 500, 200, 100};
+    uint32_t i;
+
+    if (w25qModelInit(&schedTestHandle, W25Q128) != 0)
+    {
+        printf("FAIL model init\n");
+        return 1;
+    }
+    for (i = 0; i < SCHED_TEST_READ_LEN; i++)
+    {
+        w25qModelArray()[SCHED_TEST_DATA + i] = (uint8_t)(i * 7 + 1);
+    }
+    DRIVER_W25QXX_LINK_WAIT_READY(&schedTestHandle, a_SchedTest_WaitReady);
+    if (w25qxx_sched_init(&schedTest, &schedTestHandle, a_SchedTest_Timestamp) != 0)
+    {
+        printf("FAIL scheduler init\n");
+        return 1;
+    }
+
+    printf("period us  reads  suspends  sleeps  p99 us  max us  erase us\n");
+    for (i = 0; i < sizeof(periods) / sizeof(periods[0]); i++)
+    {
+        a_SchedTest_Erase(periods[i]);
+    }
+
+    printf("%s\n", (failures == 0) ? "ok" : "FAIL");
+    return (failures == 0) ? 0 : 1;
+}
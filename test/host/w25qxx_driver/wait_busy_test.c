@@ -0,0 +1,206 @@
+/*
+ * wait_busy_test.c
+ *
+ * Checks the busy wait of driver_w25qxx.c on the W25Q128 model. Every
+ * program, erase and status register write runs once with the chip busy
+ * for the typical datasheet time, the first poll after the command must come
+ * at typ / 2 and the next ones every typ / 8, within the 10 us to 100 ms
+ * clamp; and once with a chip that stays busy past the maximum time, which
+ * must still time out at the maximum the driver used before the typical
+ * times were added. The table gives the status polls and the time slept in
+ * wait_ready per operation. Exits with 1 on failure.
+ */
+
+#include <stdio.h>
+#include <string.h>
+#include "w25q_model.h"
+
+#define WAIT_TEST_MAX_WAITS     8192
+#define WAIT_TEST_POLL_MIN_US   10
+#define WAIT_TEST_POLL_MAX_US   100000
+
+typedef struct
+{
+    const char *name;
+    uint32_t typUs;
+    uint32_t maxUs;             // timeout of the driver before the typical times
+    uint32_t *busyUs;           // busy time of the model
+    uint8_t (*run)(void);
+} WaitTest_s;
+
+static w25qxx_handle_t waitTestHandle;
+static uint32_t waitTestWaits[WAIT_TEST_MAX_WAITS];
+static uint32_t waitTestCount;
+static uint64_t waitTestSleepUs;
+static uint32_t waitTestAddr;
+static uint8_t waitTestPage[256];
+static unsigned int failures;
+
+
+static void a_WaitTest_Fail(const char *what, const char *op, uint64_t value)
+{
+    if (failures++ < 10)
+    {
+        printf("FAIL %s, %s, %llu\n", what, op, (unsigned long long)value);
+    }
+}
+
+// wait_ready of the handle: a task sleeping while the chip is busy
+static void a_WaitTest_WaitReady(void *descr, uint32_t us)
+{
+    (void)descr;
+
+    if (waitTestCount < WAIT_TEST_MAX_WAITS)
+    {
+        waitTestWaits[waitTestCount] = us;
+    }
+    waitTestCount++;
+    waitTestSleepUs += us;
+    w25qModelTimeUs += us;
+}
+
+// The timeouts are expected, their messages are not printed
+static void a_WaitTest_DebugPrint(void *descr, const char *const fmt, ...)
+{
+    (void)descr; (void)fmt;
+}
+
+static uint8_t a_WaitTest_Program(void)
+{
+    waitTestAddr += 0x1000;
+    return w25qxx_page_program(&waitTestHandle, waitTestAddr, waitTestPage, 256);
+}
+
+static uint8_t a_WaitTest_Erase4k(void)
+{
+    return w25qxx_sector_erase_4k(&waitTestHandle, 0x10000);
+}
+
+static uint8_t a_WaitTest_Erase32k(void)
+{
+    return w25qxx_block_erase_32k(&waitTestHandle, 0x20000);
+}
+
+static uint8_t a_WaitTest_Erase64k(void)
+{
+    return w25qxx_block_erase_64k(&waitTestHandle, 0x30000);
+}
+
+static uint8_t a_WaitTest_EraseChip(void)
+{
+    return w25qxx_chip_erase(&waitTestHandle);
+}
+
+static uint8_t a_WaitTest_WriteStatus(void)
+{
+    return w25qxx_set_status1(&waitTestHandle, 0x00);
+}
+
+static uint8_t a_WaitTest_EraseSecurity(void)
+{
+    return w25qxx_erase_security_register(&waitTestHandle, W25QXX_SECURITY_REGISTER_1);
+}
+
+static uint32_t a_WaitTest_Clamp(uint32_t us)
+{
+    return (us < WAIT_TEST_POLL_MIN_US) ? WAIT_TEST_POLL_MIN_US : ((us > WAIT_TEST_POLL_MAX_US) ? WAIT_TEST_POLL_MAX_US : us);
+}
+
+static void a_WaitTest_Run(const WaitTest_s *t, uint32_t busyUs)
+{
+    *t->busyUs = busyUs;
+    w25qModelResetCounters();
+    waitTestCount = 0;
+    waitTestSleepUs = 0;
+}
+
+static void a_WaitTest_Typical(const WaitTest_s *t)
+{
+    uint32_t first = a_WaitTest_Clamp(t->typUs / 2);
+    uint32_t interval = a_WaitTest_Clamp(t->typUs / 8);
+    uint32_t i;
+
+    a_WaitTest_Run(t, t->typUs);
+    if (t->run() != 0)
+    {
+        a_WaitTest_Fail("failed on a chip busy for the typical time", t->name, t->typUs);
+        return;
+    }
+    if ((waitTestCount == 0) || (waitTestWaits[0] != first))
+    {
+        a_WaitTest_Fail("first poll not at typ / 2", t->name, (waitTestCount != 0) ? waitTestWaits[0] : 0);
+    }
+    for (i = 1; (i < waitTestCount) && (i < WAIT_TEST_MAX_WAITS); i++)
+    {
+        if (waitTestWaits[i] != interval)
+        {
+            a_WaitTest_Fail("poll interval not typ / 8", t->name, waitTestWaits[i]);
+            break;
+        }
+    }
+    if (w25qModelStatusPolls != (waitTestCount + 1))
+    {
+        a_WaitTest_Fail("status polls and waits do not alternate", t->name, w25qModelStatusPolls);
+    }
+    if (waitTestSleepUs > ((uint64_t)t->typUs + interval))
+    {
+        a_WaitTest_Fail("slept more than one interval past the typical time", t->name, waitTestSleepUs);
+    }
+    if (w25qModelBusy() || (w25qModelDelayUs != 0))
+    {
+        a_WaitTest_Fail("returned busy or spun in a delay", t->name, w25qModelDelayUs);
+    }
+    printf("%-16s %10u %6u %9u %10u %12llu", t->name, (unsigned int)t->typUs, (unsigned int)w25qModelStatusPolls,
+           (unsigned int)first, (unsigned int)interval, (unsigned long long)waitTestSleepUs);
+}
+
+static void a_WaitTest_Hung(const WaitTest_s *t)
+{
+    uint32_t busyUs = t->maxUs + (t->maxUs / 2);
+
+    a_WaitTest_Run(t, busyUs);
+    if (t->run() == 0)
+    {
+        a_WaitTest_Fail("no timeout on a chip busy past the maximum", t->name, t->maxUs);
+    }
+    if (waitTestSleepUs != t->maxUs)
+    {
+        a_WaitTest_Fail("timeout not at the maximum", t->name, waitTestSleepUs);
+    }
+    printf(" %6u %12llu\n", (unsigned int)w25qModelStatusPolls, (unsigned long long)waitTestSleepUs);
+    w25qModelTimeUs += busyUs;                  // let the chip finish
+}
+
+int main(void)
+{
+    static const WaitTest_s tests[] =
+    {
+        {"page program",       400,        3000,      &w25qModelProgramUs,        a_WaitTest_Program},
+        {"sector erase 4k",    45000,      400000,    &w25qModelErase4kUs,        a_WaitTest_Erase4k},
+        {"block erase 32k",    120000,     1600000,   &w25qModelErase32kUs,       a_WaitTest_Erase32k},
+        {"block erase 64k",    150000,     2000000,   &w25qModelErase64kUs,       a_WaitTest_Erase64k},
+        {"chip erase",         40000000,   400000000, &w25qModelEraseChipUs,      a_WaitTest_EraseChip},
+        {"write status",       10000,      1000000,   &w25qModelVolatileStatusUs, a_WaitTest_WriteStatus},
+        {"security erase",     45000,      100000,    &w25qModelErase4kUs,        a_WaitTest_EraseSecurity},
+    };
+    uint32_t i;
+
+    if (w25qModelInit(&waitTestHandle, W25Q128) != 0)
+    {
+        printf("FAIL model init\n");
+        return 1;
+    }
+    DRIVER_W25QXX_LINK_WAIT_READY(&waitTestHandle, a_WaitTest_WaitReady);
+    DRIVER_W25QXX_LINK_DEBUG_PRINT(&waitTestHandle, a_WaitTest_DebugPrint);
+    memset(waitTestPage, 0x00, sizeof(waitTestPage));
+
+    printf("                   typ us  polls  first us  interval us  slept us | timeout polls  slept us\n");
+    for (i = 0; i < sizeof(tests) / sizeof(tests[0]); i++)
+    {
+        a_WaitTest_Typical(&tests[i]);
+        a_WaitTest_Hung(&tests[i]);
+    }
+
+    printf("%s\n", (failures == 0) ? "ok" : "FAIL");
+    return (failures == 0) ? 0 : 1;
+}
@@ -0,0 +1,204 @@
+/*
+ * drv_spi_mock.c
+ *
+ * Mock of the Harmony 3 DRV_SPI synchronous API, see drv_spi_mock.h.
+ */
+
+#include <stdio.h>
+#include <string.h>
+#include "drv_spi_mock.h"
+#include "w25q_model.h"
+
+#define DRV_SPI_MOCK_HANDLE     ((DRV_HANDLE)0x5A)
+#define DRV_SPI_MOCK_FRAME_MAX  (4 + 8192)
+
+uint32_t drvSpiMockOpens;
+uint32_t drvSpiMockCloses;
+uint32_t drvSpiMockSetups;
+uint32_t drvSpiMockTransfers;
+uint32_t drvSpiMockFrames;
+uint32_t drvSpiMockOpened;
+uint32_t drvSpiMockErrors;
+
+static SYS_PORT_PIN drvSpiMockSelected = SYS_PORT_PIN_NONE;
+static uint8_t drvSpiMockFrame[DRV_SPI_MOCK_FRAME_MAX];     // bytes clocked out since the chip was selected
+static uint32_t drvSpiMockFrameLen;
+static int drvSpiMockFrameDone;                             // the model has run the command
+
+
+static void a_DrvSpiMock_Error(const char *what)
+{
+    printf("drv_spi mock: %s\n", what);
+    drvSpiMockErrors++;
+}
+
+static bool a_DrvSpiMock_Check(DRV_HANDLE handle)
+{
+    drvSpiMockTransfers++;
+    w25qModelTimeUs += DRV_SPI_MOCK_TRANSFER_US;
+    if ((handle != DRV_SPI_MOCK_HANDLE) || (drvSpiMockOpened == 0))
+    {
+        a_DrvSpiMock_Error("transfer on a handle that is not open");
+        return false;
+    }
+    if (drvSpiMockSelected == SYS_PORT_PIN_NONE)
+    {
+        a_DrvSpiMock_Error("transfer with no chip selected");
+        return false;
+    }
+    if (drvSpiMockFrameDone)
+    {
+        a_DrvSpiMock_Error("more bytes after the data phase of a command");
+        return false;
+    }
+    return true;
+}
+
+static void a_DrvSpiMock_Append(const void *data, size_t size)
+{
+    if ((drvSpiMockFrameLen + size) > sizeof(drvSpiMockFrame))
+    {
+        a_DrvSpiMock_Error("command longer than the mock frame");
+        return;
+    }
+    memcpy(&drvSpiMockFrame[drvSpiMockFrameLen], data, size);
+    drvSpiMockFrameLen += (uint32_t)size;
+}
+
+DRV_HANDLE DRV_SPI_Open(const SYS_MODULE_INDEX drvIndex, const DRV_IO_INTENT ioIntent)
+{
+    w25qModelTimeUs += DRV_SPI_MOCK_OPEN_US;
+    if (drvIndex != 0)
+    {
+        return DRV_HANDLE_INVALID;
+    }
+    if ((drvSpiMockOpened != 0) && ((ioIntent & DRV_IO_INTENT_EXCLUSIVE) != 0))
+    {
+        a_DrvSpiMock_Error("exclusive open of a driver that is open");
+        return DRV_HANDLE_INVALID;
+    }
+    drvSpiMockOpens++;
+    drvSpiMockOpened++;
+
+    return DRV_SPI_MOCK_HANDLE;
+}
+
+void DRV_SPI_Close(const DRV_HANDLE handle)
+{
+    w25qModelTimeUs += DRV_SPI_MOCK_CLOSE_US;
+    if ((handle != DRV_SPI_MOCK_HANDLE) || (drvSpiMockOpened == 0))
+    {
+        a_DrvSpiMock_Error("close of a handle that is not open");
+        return;
+    }
+    drvSpiMockCloses++;
+    drvSpiMockOpened--;
+}
+
+SYS_STATUS DRV_SPI_Status(SYS_MODULE_OBJ object)
+{
+    (void)object;
+
+    return SYS_STATUS_READY;
+}
+
+bool DRV_SPI_TransferSetup(const DRV_HANDLE handle, DRV_SPI_TRANSFER_SETUP *setup)
+{
+    w25qModelTimeUs += DRV_SPI_MOCK_SETUP_US;
+    if ((handle != DRV_SPI_MOCK_HANDLE) || (setup->dataBits != DRV_SPI_DATA_BITS_8))
+    {
+        return false;
+    }
+    drvSpiMockSetups++;
+    w25qModelBusMhz = (setup->baudRateInHz >= 1000000) ? (setup->baudRateInHz / 1000000) : 1;
+
+    return true;
+}
+
+bool DRV_SPI_WriteTransfer(const DRV_HANDLE handle, void *pTransmitData, size_t txSize)
+{
+    if (!a_DrvSpiMock_Check(handle))
+    {
+        return false;
+    }
+    a_DrvSpiMock_Append(pTransmitData, txSize);
+
+    return true;
+}
+
+bool DRV_SPI_ReadTransfer(const DRV_HANDLE handle, void *pReceiveData, size_t rxSize)
+{
+    if (!a_DrvSpiMock_Check(handle))
+    {
+        return false;
+    }
+    w25qModelSpiTransfer(drvSpiMockFrame, drvSpiMockFrameLen, (uint8_t *)pReceiveData, (uint32_t)rxSize);
+    drvSpiMockFrameDone = 1;
+
+    return true;
+}
+
+// Full duplex: rxSize bytes are clocked, the first txSize of them carry the command,
+// the receive buffer may be the transmit buffer
+bool DRV_SPI_WriteReadTransfer(const DRV_HANDLE handle, void *pTransmitData, size_t txSize,
+                               void *pReceiveData, size_t rxSize)
+{
+    if (!a_DrvSpiMock_Check(handle))
+    {
+        return false;
+    }
+    a_DrvSpiMock_Append(pTransmitData, txSize);
+    memset(pReceiveData, 0xFF, (rxSize < txSize) ? rxSize : txSize);
+    if (rxSize > txSize)
+    {
+        w25qModelSpiTransfer(drvSpiMockFrame, drvSpiMockFrameLen, (uint8_t *)pReceiveData + txSize,
+                             (uint32_t)(rxSize - txSize));
+        drvSpiMockFrameDone = 1;
+    }
+
+    return true;
+}
+
+void SYS_PORT_PinClear(SYS_PORT_PIN pin)
+{
+    if (drvSpiMockSelected != SYS_PORT_PIN_NONE)
+    {
+        a_DrvSpiMock_Error("two chips selected");
+    }
+    drvSpiMockSelected = pin;
+    drvSpiMockFrameLen = 0;
+    drvSpiMockFrameDone = 0;
+}
+
+void SYS_PORT_PinSet(SYS_PORT_PIN pin)
+{
+    if (drvSpiMockSelected != pin)
+    {
+        return;                                 // deselected already, e.g. the pin init
+    }
+    if (!drvSpiMockFrameDone && (drvSpiMockFrameLen > 0))
+    {
+        w25qModelSpiTransfer(drvSpiMockFrame, drvSpiMockFrameLen, NULL, 0);
+        drvSpiMockFrameDone = 1;
+    }
+    if (drvSpiMockFrameDone)
+    {
+        drvSpiMockFrames++;
+    }
+    drvSpiMockSelected = SYS_PORT_PIN_NONE;
+}
+
+void SYS_PORT_PinOutputEnable(SYS_PORT_PIN pin)
+{
+    (void)pin;
+}
+
+void drvSpiMockResetCounters(void)
+{
+    drvSpiMockOpens = 0;
+    drvSpiMockCloses = 0;
+    drvSpiMockSetups = 0;
+    drvSpiMockTransfers = 0;
+    drvSpiMockFrames = 0;
+    drvSpiMockErrors = 0;
+}
@@ -0,0 +1,32 @@
+/*
+ * drv_spi_mock.h
+ *
+ * Mock of the Harmony 3 DRV_SPI synchronous API and of the chip select pins
+ * in front of the W25Q model. Bytes clocked while a chip select is low form
+ * one command of the model. Every call costs its typical time on the SAME54
+ * at 120 MHz, added to w25qModelTimeUs; the bytes on the wire are timed by
+ * the model at the baud rate of the transfer setup.
+ */
+
+#ifndef DRV_SPI_MOCK_H_
+#define DRV_SPI_MOCK_H_
+
+#include <stdint.h>
+#include "drv_spi.h"
+
+#define DRV_SPI_MOCK_OPEN_US        12      // client object, mutex and PLIB setup
+#define DRV_SPI_MOCK_CLOSE_US       4
+#define DRV_SPI_MOCK_SETUP_US       3       // baud and mode registers
+#define DRV_SPI_MOCK_TRANSFER_US    6       // DMA setup, end of transfer interrupt and semaphore
+
+extern uint32_t drvSpiMockOpens;
+extern uint32_t drvSpiMockCloses;
+extern uint32_t drvSpiMockSetups;
+extern uint32_t drvSpiMockTransfers;        // WriteTransfer, ReadTransfer and WriteReadTransfer calls
+extern uint32_t drvSpiMockFrames;           // chip select low to high with bytes on the wire
+extern uint32_t drvSpiMockOpened;           // clients opened now
+extern uint32_t drvSpiMockErrors;           // misuse: a transfer with no chip selected, a second exclusive open
+
+void drvSpiMockResetCounters(void);
+
+#endif /* DRV_SPI_MOCK_H_ */
@@ -0,0 +1,220 @@
+/*
+ * qspi_model.c
+ *
+ * Model of the SAME54 QSPI in serial memory mode, see qspi_model.h.
+ */
+
+#define _GNU_SOURCE
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <signal.h>
+#include <ucontext.h>
+#include <sys/mman.h>
+#include "qspi_model.h"
+#include "w25q_model.h"
+
+#define QSPI_MODEL_PAGE         4096u
+#define QSPI_MODEL_TRAP_FLAG    0x100       // EFLAGS.TF
+#define QSPI_MODEL_PF_WRITE     0x2         // page fault error code, write access
+
+qspi_registers_t *qspiModelRegs;
+uint8_t *qspiModelWindow;
+port_registers_t qspiModelPort;
+mclk_registers_t qspiModelMclk;
+uint32_t qspiModelCpuHz = 120000000;
+
+uint32_t qspiModelFrames;
+uint32_t qspiModelResets;
+QspiModelFrame_s qspiModelLast;
+
+static QspiModelFrame_s qspiModelFrame;     // of INSTRFRAME, filled while the driver runs it
+static int qspiModelFetched;                // the read frame went to the chip
+static uint32_t qspiModelAccessOffset;      // of the access being single stepped
+static int qspiModelAccessWrite;
+static int qspiModelAccessWindow;
+
+
+static void a_QspiModel_Fail(const char *what)
+{
+    printf("qspi model: %s\n", what);
+    exit(1);
+}
+
+static void a_QspiModel_Protect(int prot)
+{
+    if ((mprotect((void *)qspiModelRegs, QSPI_MODEL_PAGE, prot) != 0) ||
+        (mprotect(qspiModelWindow, QSPI_MODEL_WINDOW_SIZE, prot) != 0))
+    {
+        a_QspiModel_Fail("mprotect");
+    }
+}
+
+// The frame INSTRFRAME describes, as the arguments of spi_qspi_write_read()
+static void a_QspiModel_Decode(void)
+{
+    static const uint8_t lines[7][3] =
+    {
+        {1, 1, 1}, {1, 1, 2}, {1, 1, 4}, {1, 2, 2}, {1, 4, 4}, {2, 2, 2}, {4, 4, 4},
+    };
+    uint32_t frame = qspiModelRegs->QSPI_INSTRFRAME;
+    uint32_t width = (frame & QSPI_INSTRFRAME_WIDTH_Msk) >> QSPI_INSTRFRAME_WIDTH_Pos;
+    uint32_t type = (frame & QSPI_INSTRFRAME_TFRTYPE_Msk) >> QSPI_INSTRFRAME_TFRTYPE_Pos;
+
+    if ((width > 6) || ((frame & QSPI_INSTRFRAME_INSTREN_Msk) == 0))
+    {
+        a_QspiModel_Fail("frame without an instruction or with a reserved width");
+    }
+    if (((frame & QSPI_INSTRFRAME_OPTCODEEN_Msk) != 0) &&
+        ((frame & QSPI_INSTRFRAME_OPTCODELEN_Msk) != QSPI_INSTRFRAME_OPTCODELEN_8BITS))
+    {
+        a_QspiModel_Fail("option code shorter than a byte");
+    }
+    memset(&qspiModelFrame, 0, sizeof(qspiModelFrame));
+    qspiModelFrame.instruction = (uint8_t)(qspiModelRegs->QSPI_INSTRCTRL & QSPI_INSTRCTRL_INSTR_Msk);
+    qspiModelFrame.instructionLine = lines[width][0];
+    qspiModelFrame.addressLine = lines[width][1];
+    qspiModelFrame.dataLine = ((frame & QSPI_INSTRFRAME_DATAEN_Msk) != 0) ? lines[width][2] : 0;
+    if ((frame & QSPI_INSTRFRAME_ADDREN_Msk) != 0)
+    {
+        qspiModelFrame.addressLen = ((frame & QSPI_INSTRFRAME_ADDRLEN_Msk) == QSPI_INSTRFRAME_ADDRLEN_32BITS) ? 4 : 3;
+    }
+    qspiModelFrame.alternateLen = ((frame & QSPI_INSTRFRAME_OPTCODEEN_Msk) != 0) ? 1 : 0;
+    qspiModelFrame.dummy = (uint8_t)((frame & QSPI_INSTRFRAME_DUMMYLEN_Msk) >> QSPI_INSTRFRAME_DUMMYLEN_Pos);
+    qspiModelFrame.read = (((frame & QSPI_INSTRFRAME_DATAEN_Msk) != 0) &&
+                           ((type == QSPI_INSTRFRAME_TFRTYPE_READ_Val) ||
+                            (type == QSPI_INSTRFRAME_TFRTYPE_READMEMORY_Val))) ? 1 : 0;
+    qspiModelFetched = 0;
+}
+
+static void a_QspiModel_Run(uint8_t *in_buf, uint32_t in_len, uint8_t *out_buf, uint32_t out_len)
+{
+    uint32_t alternate = (qspiModelRegs->QSPI_INSTRCTRL & QSPI_INSTRCTRL_OPTCODE_Msk) >> QSPI_INSTRCTRL_OPTCODE_Pos;
+
+    w25qModelFrame(qspiModelFrame.instruction, qspiModelFrame.instructionLine,
+                   qspiModelRegs->QSPI_INSTRADDR, (qspiModelFrame.addressLen != 0) ? qspiModelFrame.addressLine : 0,
+                   qspiModelFrame.addressLen, alternate,
+                   (qspiModelFrame.alternateLen != 0) ? qspiModelFrame.addressLine : 0, qspiModelFrame.alternateLen,
+                   qspiModelFrame.dummy, in_buf, in_len, out_buf, out_len, qspiModelFrame.dataLine);
+}
+
+// A register write has completed
+static void a_QspiModel_Register(uint32_t offset)
+{
+    switch (offset)
+    {
+        case QSPI_CTRLA_REG_OFST:
+            if ((qspiModelRegs->QSPI_CTRLA & QSPI_CTRLA_SWRST_Msk) != 0)
+            {
+                qspiModelResets++;
+                memset((void *)qspiModelRegs, 0, sizeof(*qspiModelRegs));
+            }
+            else if ((qspiModelRegs->QSPI_CTRLA & QSPI_CTRLA_LASTXFER_Msk) != 0)
+            {
+                if ((qspiModelRegs->QSPI_CTRLA & QSPI_CTRLA_ENABLE_Msk) == 0)
+                {
+                    a_QspiModel_Fail("frame on a disabled peripheral");
+                }
+                if (!qspiModelFrame.read)
+                {
+                    a_QspiModel_Run(qspiModelWindow, qspiModelFrame.len, NULL, 0);
+                }
+                else if (!qspiModelFetched)
+                {
+                    a_QspiModel_Fail("read frame ended without reading the window");
+                }
+                qspiModelLast = qspiModelFrame;
+                qspiModelFrames++;
+                qspiModelRegs->QSPI_CTRLA &= ~QSPI_CTRLA_LASTXFER_Msk;
+                qspiModelRegs->QSPI_INTFLAG |= QSPI_INTFLAG_INSTREND_Msk;
+            }
+            break;
+        case QSPI_INSTRFRAME_REG_OFST:
+            a_QspiModel_Decode();
+            break;
+        case QSPI_INTFLAG_REG_OFST:                 // write one to clear
+            qspiModelRegs->QSPI_INTFLAG = 0;
+            break;
+        default:
+            break;
+    }
+}
+
+static void a_QspiModel_Segv(int sig, siginfo_t *info, void *context)
+{
+    ucontext_t *uc = (ucontext_t *)context;
+    uint8_t *addr = (uint8_t *)info->si_addr;
+
+    (void)sig;
+
+    qspiModelAccessWrite = (uc->uc_mcontext.gregs[REG_ERR] & QSPI_MODEL_PF_WRITE) != 0;
+    if ((addr >= (uint8_t *)qspiModelRegs) && (addr < ((uint8_t *)qspiModelRegs + QSPI_MODEL_PAGE)))
+    {
+        qspiModelAccessWindow = 0;
+        qspiModelAccessOffset = (uint32_t)(addr - (uint8_t *)qspiModelRegs);
+    }
+    else if ((addr >= qspiModelWindow) && (addr < (qspiModelWindow + QSPI_MODEL_WINDOW_SIZE)))
+    {
+        qspiModelAccessWindow = 1;
+        qspiModelAccessOffset = (uint32_t)(addr - qspiModelWindow);
+    }
+    else
+    {
+        signal(SIGSEGV, SIG_DFL);                   // a fault of the test itself
+        return;
+    }
+
+    a_QspiModel_Protect(PROT_READ | PROT_WRITE);
+    if (qspiModelAccessWindow && !qspiModelAccessWrite && qspiModelFrame.read && !qspiModelFetched)
+    {
+        a_QspiModel_Run(NULL, 0, qspiModelWindow, QSPI_MODEL_WINDOW_SIZE);
+        qspiModelFetched = 1;
+    }
+    uc->uc_mcontext.gregs[REG_EFL] |= QSPI_MODEL_TRAP_FLAG;
+}
+
+static void a_QspiModel_Trap(int sig, siginfo_t *info, void *context)
+{
+    ucontext_t *uc = (ucontext_t *)context;
+
+    (void)sig; (void)info;
+
+    uc->uc_mcontext.gregs[REG_EFL] &= ~QSPI_MODEL_TRAP_FLAG;
+    if (qspiModelAccessWindow)
+    {
+        if (qspiModelAccessWrite && qspiModelFrame.read)
+        {
+            a_QspiModel_Fail("write to the window in a read frame");
+        }
+        if (qspiModelAccessWrite && ((qspiModelAccessOffset + 1) > qspiModelFrame.len))
+        {
+            qspiModelFrame.len = qspiModelAccessOffset + 1;
+        }
+    }
+    else if (qspiModelAccessWrite)
+    {
+        a_QspiModel_Register(qspiModelAccessOffset & ~3u);
+    }
+    a_QspiModel_Protect(PROT_NONE);
+}
+
+void qspiModelInit(void)
+{
+    struct sigaction sa;
+
+    qspiModelRegs = mmap(NULL, QSPI_MODEL_PAGE, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    qspiModelWindow = mmap(NULL, QSPI_MODEL_WINDOW_SIZE, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    if ((qspiModelRegs == MAP_FAILED) || (qspiModelWindow == MAP_FAILED))
+    {
+        a_QspiModel_Fail("mmap");
+    }
+
+    memset(&sa, 0, sizeof(sa));
+    sa.sa_flags = SA_SIGINFO;
+    sa.sa_sigaction = a_QspiModel_Segv;
+    sigaction(SIGSEGV, &sa, NULL);
+    sa.sa_sigaction = a_QspiModel_Trap;
+    sigaction(SIGTRAP, &sa, NULL);
+
+    a_QspiModel_Protect(PROT_NONE);
+}
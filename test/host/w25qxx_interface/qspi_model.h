@@ -0,0 +1,42 @@
+/*
+ * qspi_model.h
+ *
+ * Model of the SAME54 QSPI peripheral in serial memory mode for
+ * drv_qspi_same54.c. The register block and the memory window are pages the
+ * model keeps inaccessible: every access of the driver faults, is let through
+ * for one instruction and then handled, so the model sees the frame the
+ * driver set up in INSTRADDR, INSTRCTRL and INSTRFRAME as the hardware does.
+ * The frame goes to the W25Q model on the first read of the window, or with
+ * the bytes written to the window when LASTXFER ends it; INSTREND is then set.
+ * x86-64 Linux only, the single step uses the trap flag.
+ */
+
+#ifndef QSPI_MODEL_H_
+#define QSPI_MODEL_H_
+
+#include <stdint.h>
+#include "sam.h"
+
+#define QSPI_MODEL_WINDOW_SIZE  (64u * 1024u)
+
+typedef struct
+{
+    uint8_t instruction;
+    uint8_t instructionLine;
+    uint8_t addressLine;        // lines of the address and option code phases
+    uint8_t dataLine;
+    uint8_t addressLen;         // bytes, 0 without an address phase
+    uint8_t alternateLen;       // bytes, 0 without an option code phase
+    uint8_t dummy;              // clocks
+    uint8_t read;               // data phase from the chip
+    uint32_t len;               // bytes written to the window, 0 for a read
+} QspiModelFrame_s;
+
+extern uint32_t qspiModelFrames;            // ended by LASTXFER
+extern uint32_t qspiModelResets;            // CTRLA.SWRST
+extern QspiModelFrame_s qspiModelLast;      // the last frame
+
+// Map the trapped pages and install the fault handlers
+void qspiModelInit(void);
+
+#endif /* QSPI_MODEL_H_ */
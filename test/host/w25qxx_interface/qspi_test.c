@@ -0,0 +1,175 @@
+/*
+ * qspi_test.c
+ *
+ * Checks drv_qspi_same54.c on the QSPI register model in front of the W25Q128
+ * model. qspi_init() must pick the smallest divider that keeps SCK at or
+ * under QSPI_BAUD_RATE_HZ for any CPU clock. With the dual/quad reads of the
+ * driver enabled, reads must go out as fast read dual I/O (0xBB) while the
+ * QE bit is clear and as fast read quad I/O (0xEB) once it is set, the frame
+ * the driver writes to INSTRFRAME decoded as the chip would see it, and read
+ * back what the model holds; a page program goes through the window. Exits
+ * with 1 on failure.
+ */
+
+#include <stdio.h>
+#include <string.h>
+#include "qspi_model.h"
+#include "w25q_model.h"
+#include "drv_qspi_same54.h"
+
+static w25qxx_handle_t qspiTestHandle;
+static uint8_t qspiTestBuf[4096 + 1];
+static unsigned int failures;
+
+
+static void a_QspiTest_Fail(const char *what, uint32_t value)
+{
+    if (failures++ < 10)
+    {
+        printf("FAIL %s, %u\n", what, (unsigned int)value);
+    }
+}
+
+static void a_QspiTest_Divider(void)
+{
+    static const uint32_t clocks[] = {120000000, 119999488, 100000000, 90000001, 60000000, 48000000,
+                                      30000001, 30000000, 29000000, 12000000};
+    uint32_t baud;
+    uint32_t sck;
+    uint32_t i;
+
+    printf("CPU Hz       BAUD  SCK Hz\n");
+    for (i = 0; i < sizeof(clocks) / sizeof(clocks[0]); i++)
+    {
+        qspiModelCpuHz = clocks[i];
+        qspiModelResets = 0;
+        qspi_init(NULL);
+        baud = (qspiModelRegs->QSPI_BAUD & QSPI_BAUD_BAUD_Msk) >> QSPI_BAUD_BAUD_Pos;
+        sck = clocks[i] / (baud + 1);
+        printf("%-12u %4u  %u\n", (unsigned int)clocks[i], (unsigned int)baud, (unsigned int)sck);
+        if (clocks[i] > (uint64_t)QSPI_BAUD_RATE_HZ * (baud + 1))
+        {
+            a_QspiTest_Fail("SCK above QSPI_BAUD_RATE_HZ", clocks[i]);
+        }
+        if ((baud != 0) && (clocks[i] <= (uint64_t)QSPI_BAUD_RATE_HZ * baud))
+        {
+            a_QspiTest_Fail("divider not the smallest", clocks[i]);
+        }
+        if ((qspiModelResets != 1) || ((qspiModelRegs->QSPI_CTRLA & QSPI_CTRLA_ENABLE_Msk) == 0) ||
+            ((qspiModelRegs->QSPI_CTRLB & QSPI_CTRLB_MODE_Msk) != QSPI_CTRLB_MODE_MEMORY))
+        {
+            a_QspiTest_Fail("peripheral not reset and enabled in memory mode", clocks[i]);
+        }
+    }
+    qspiModelCpuHz = 120000000;
+}
+
+// Reads through the driver with the QE bit as given, checked against the model and the frame
+static void a_QspiTest_Read(uint8_t qe)
+{
+    static const uint32_t lengths[] = {1, 5, 256, 4096};
+    const uint8_t command = qe ? 0xEB : 0xBB;
+    const uint8_t lines = qe ? 4 : 2;
+    uint8_t selected;
+    uint32_t addr;
+    uint32_t i;
+
+    if (w25qxx_set_status2(&qspiTestHandle, qe ? W25Q_MODEL_SR2_QE : 0x00) != 0)
+    {
+        a_QspiTest_Fail("set status 2", qe);
+        return;
+    }
+    for (i = 0; i < sizeof(lengths) / sizeof(lengths[0]); i++)
+    {
+        addr = 0x1000 * (i + 1) + 3;
+        memset(qspiTestBuf, 0, sizeof(qspiTestBuf));
+        if ((w25qxx_read(&qspiTestHandle, addr, &qspiTestBuf[i & 1], lengths[i]) != 0) ||
+            (memcmp(&qspiTestBuf[i & 1], &w25qModelArray()[addr], lengths[i]) != 0))
+        {
+            a_QspiTest_Fail(qe ? "quad read" : "dual read", lengths[i]);
+        }
+        if ((qspiModelLast.instruction != command) || !qspiModelLast.read ||
+            (qspiModelLast.instructionLine != 1) || (qspiModelLast.addressLine != lines) ||
+            (qspiModelLast.dataLine != lines) || (qspiModelLast.addressLen != 3) ||
+            (qspiModelLast.alternateLen != 1) || (qspiModelLast.dummy != (qe ? 4 : 0)))
+        {
+            a_QspiTest_Fail(qe ? "quad read frame" : "dual read frame", qspiModelLast.instruction);
+        }
+        if ((w25qModelLastRead != command) || (w25qModelLastReadLines != lines))
+        {
+            a_QspiTest_Fail("command seen by the chip", w25qModelLastRead);
+        }
+    }
+    if ((w25qxx_get_read_command(&qspiTestHandle, &selected) != 0) || (selected != command))
+    {
+        a_QspiTest_Fail("w25qxx_get_read_command", selected);
+    }
+    printf("QE %s: 0x%02X, address and data on %u lines, %u dummy clocks\n", qe ? "set" : "clear",
+           (unsigned int)qspiModelLast.instruction, (unsigned int)qspiModelLast.dataLine,
+           (unsigned int)qspiModelLast.dummy);
+}
+
+static void a_QspiTest_Program(void)
+{
+    uint32_t i;
+
+    for (i = 0; i < 256; i++)
+    {
+        qspiTestBuf[i] = (uint8_t)(i ^ 0x3C);
+    }
+    if ((w25qxx_page_program(&qspiTestHandle, 0x20000, qspiTestBuf, 256) != 0) ||
+        (memcmp(&w25qModelArray()[0x20000], qspiTestBuf, 256) != 0))
+    {
+        a_QspiTest_Fail("page program", 256);
+    }
+    if (w25qModelCommands[0x02] != 1)
+    {
+        a_QspiTest_Fail("page program frames", w25qModelCommands[0x02]);
+    }
+}
+
+int main(void)
+{
+    uint32_t i;
+
+    qspiModelInit();
+    a_QspiTest_Divider();
+
+    if ((w25qModelInit(&qspiTestHandle, W25Q128) != 0) || (w25qxx_deinit(&qspiTestHandle) != 0))
+    {
+        printf("FAIL model init\n");
+        return 1;
+    }
+    for (i = 0; i < 0x10000; i++)
+    {
+        w25qModelArray()[i] = (uint8_t)(i * 31 + (i >> 8));
+    }
+
+    w25qModelLink(&qspiTestHandle);
+    DRIVER_W25QXX_LINK_SPI_QSPI_INIT(&qspiTestHandle, qspi_init);
+    DRIVER_W25QXX_LINK_SPI_QSPI_DEINIT(&qspiTestHandle, qspi_deinit);
+    DRIVER_W25QXX_LINK_SPI_QSPI_WRITE_READ(&qspiTestHandle, qspi_write_read);
+    w25qxx_set_type(&qspiTestHandle, W25Q128);
+    w25qxx_set_interface(&qspiTestHandle, W25QXX_INTERFACE_SPI);
+    w25qxx_set_dual_quad_spi(&qspiTestHandle, W25QXX_BOOL_TRUE);
+    qspiModelFrames = 0;
+    if (w25qxx_init(&qspiTestHandle) != 0)
+    {
+        printf("FAIL init through the QSPI\n");
+        return 1;
+    }
+
+    a_QspiTest_Read(0);
+    a_QspiTest_Read(1);
+    a_QspiTest_Read(0);
+    w25qModelResetCounters();
+    a_QspiTest_Program();
+    if (w25qxx_deinit(&qspiTestHandle) != 0)
+    {
+        a_QspiTest_Fail("deinit", 0);
+    }
+    printf("%u frames through the QSPI\n", (unsigned int)qspiModelFrames);
+
+    printf("%s\n", (failures == 0) ? "ok" : "FAIL");
+    return (failures == 0) ? 0 : 1;
+}
@@ -0,0 +1,289 @@
+/*
+ * spi_transport_test.c
+ *
+ * Checks the SERCOM SPI transport of drv_spi_harmony3.c on the DRV_SPI mock
+ * in front of the W25Q128 model. Both transfer modes run the same reads and
+ * page programs; the table gives the driver opens, DRV_SPI transfers and
+ * chip select frames per command and the latency of a command without the
+ * busy wait. The persistent mode must open the driver once for the life of
+ * the handle and clock every command as one transfer, two for reads past
+ * the bounce buffer; the open/close mode opens the driver per command. Two
+ * chips on one bus share the persistent handle. Exits with 1 on failure.
+ */
+
+#include <stdio.h>
+#include <string.h>
+#include "drv_spi_mock.h"
+#include "w25q_model.h"
+#include "configuration.h"
+#include "drv_spi_harmony3.h"
+
+#define SPI_TEST_ROUNDS     32
+#define SPI_TEST_PROGRAM    0x100000    // page programs go here, erased by w25qModelInit()
+#define SPI_TEST_CS         7
+#define SPI_TEST_CS2        8
+#define SPI_TEST_READ_HDR   5           // fast read: command, 3 address bytes and a dummy byte
+
+typedef struct
+{
+    double opens;
+    double transfers;
+    double frames;
+    double us;
+} SpiTestCost_s;
+
+static w25qxx_handle_t spiTestHandle;
+static w25qxx_handle_t spiTestHandle2;
+static W25qxx_ASF_CustomDescriptor_s spiTestDescr;
+static W25qxx_ASF_CustomDescriptor_s spiTestDescr2;
+static uint8_t spiTestBuf[4096];
+static uint32_t spiTestProgramAddr = SPI_TEST_PROGRAM;
+static unsigned int failures;
+
+
+static void a_SpiTest_Fail(const char *what, const char *mode, uint32_t len)
+{
+    if (failures++ < 10)
+    {
+        printf("FAIL %s, %s, %u bytes\n", what, mode, (unsigned int)len);
+    }
+}
+
+// The SERCOM half of w25qxx_interface_spi_qspi_write_read()
+static uint8_t a_SpiTest_WriteRead(void *descr, uint8_t instruction, uint8_t instruction_line,
+                                   uint32_t address, uint8_t address_line, uint8_t address_len,
+                                   uint32_t alternate, uint8_t alternate_line, uint8_t alternate_len,
+                                   uint8_t dummy, uint8_t *in_buf, uint32_t in_len,
+                                   uint8_t *out_buf, uint32_t out_len, uint8_t data_line)
+{
+    (void)instruction; (void)address; (void)address_len; (void)alternate; (void)alternate_len;
+
+    if ((instruction_line != 0) || (address_line != 0) || (alternate_line != 0) || (dummy != 0) || (data_line != 1))
+    {
+        return 1;
+    }
+
+    return spi_write_read(descr, in_buf, in_len, out_buf, out_len);
+}
+
+static uint8_t a_SpiTest_Init(w25qxx_handle_t *handle, W25qxx_ASF_CustomDescriptor_s *descr,
+                              uint8_t cs, uint8_t mode)
+{
+    memset(descr, 0, sizeof(*descr));
+    descr->spiIndex = DRV_SPI_INDEX_0;
+    descr->chipSelectPin = cs;
+    descr->phy = W25QXX_PHY_SERCOM_SPI;
+    descr->spiTransferMode = mode;
+
+    w25qModelLink(handle);
+    DRIVER_W25QXX_LINK_SPI_QSPI_INIT(handle, spi_init);
+    DRIVER_W25QXX_LINK_SPI_QSPI_DEINIT(handle, spi_deinit);
+    DRIVER_W25QXX_LINK_SPI_QSPI_WRITE_READ(handle, a_SpiTest_WriteRead);
+    DRIVER_W25QXX_LINK_EXTRA_VOID_PTR(handle, (void *)descr);
+    w25qxx_set_type(handle, W25Q128);
+    w25qxx_set_interface(handle, W25QXX_INTERFACE_SPI);
+    w25qxx_set_dual_quad_spi(handle, W25QXX_BOOL_FALSE);
+
+    return w25qxx_init(handle);
+}
+
+static void a_SpiTest_Begin(uint64_t *start, uint64_t *delay)
+{
+    drvSpiMockResetCounters();
+    *start = w25qModelTimeUs;
+    *delay = w25qModelDelayUs;
+}
+
+// Cost per command since a_SpiTest_Begin(), the driver delays taken out
+static SpiTestCost_s a_SpiTest_End(uint32_t commands, uint64_t start, uint64_t delay)
+{
+    SpiTestCost_s cost;
+
+    cost.opens = (double)drvSpiMockOpens / commands;
+    cost.transfers = (double)drvSpiMockTransfers / commands;
+    cost.frames = (double)drvSpiMockFrames / commands;
+    cost.us = (double)((w25qModelTimeUs - start) - (w25qModelDelayUs - delay)) / commands;
+
+    return cost;
+}
+
+static SpiTestCost_s a_SpiTest_Read(uint32_t len)
+{
+    uint64_t start;
+    uint64_t delay;
+    uint32_t i;
+
+    a_SpiTest_Begin(&start, &delay);
+    for (i = 0; i < SPI_TEST_ROUNDS; i++)
+    {
+        if (w25qxx_read(&spiTestHandle, i * 4096, spiTestBuf, len) != 0)
+        {
+            a_SpiTest_Fail("read", "", len);
+        }
+    }
+
+    return a_SpiTest_End(SPI_TEST_ROUNDS, start, delay);
+}
+
+// Page programs, each with its write enable and status polls
+static SpiTestCost_s a_SpiTest_Program(void)
+{
+    uint64_t start;
+    uint64_t delay;
+    uint32_t i;
+
+    memset(spiTestBuf, 0x5A, 256);
+    a_SpiTest_Begin(&start, &delay);
+    for (i = 0; i < SPI_TEST_ROUNDS; i++)
+    {
+        if (w25qxx_page_program(&spiTestHandle, spiTestProgramAddr, spiTestBuf, 256) != 0)
+        {
+            a_SpiTest_Fail("page program", "", 256);
+        }
+        spiTestProgramAddr += 256;
+    }
+
+    return a_SpiTest_End(SPI_TEST_ROUNDS, start, delay);
+}
+
+static void a_SpiTest_Print(const char *what, const SpiTestCost_s *cost)
+{
+    printf("  %-14s %6.2f %9.2f %7.2f %8.1f\n", what, cost->opens, cost->transfers, cost->frames, cost->us);
+}
+
+static void a_SpiTest_Mode(uint8_t mode, SpiTestCost_s cost[5])
+{
+    static const uint32_t sizes[4] = {4, 64, W25QXX_SPI_XFER_BUF_SIZE - SPI_TEST_READ_HDR, 4096};
+    const char *name = (mode == W25QXX_SPI_TRANSFER_MODE_PERSISTENT) ? "persistent" : "open/close";
+    char label[32];
+    uint32_t opens;
+    int i;
+
+    drvSpiMockResetCounters();
+    if (a_SpiTest_Init(&spiTestHandle, &spiTestDescr, SPI_TEST_CS, mode) != 0)
+    {
+        a_SpiTest_Fail("init", name, 0);
+        return;
+    }
+    opens = drvSpiMockOpens;
+
+    printf("%s          opens transfers  frames  us/cmd\n", name);
+    for (i = 0; i < 4; i++)
+    {
+        cost[i] = a_SpiTest_Read(sizes[i]);
+        snprintf(label, sizeof(label), "read %u", (unsigned int)sizes[i]);
+        a_SpiTest_Print(label, &cost[i]);
+        if (cost[i].frames != 1.0)
+        {
+            a_SpiTest_Fail("read is not one command", name, sizes[i]);
+        }
+        if (cost[i].transfers != ((sizes[i] + SPI_TEST_READ_HDR <= W25QXX_SPI_XFER_BUF_SIZE) ? 1.0 : 2.0))
+        {
+            a_SpiTest_Fail("read transfers", name, sizes[i]);
+        }
+        if (memcmp(spiTestBuf, &w25qModelArray()[(SPI_TEST_ROUNDS - 1) * 4096], sizes[i]) != 0)
+        {
+            a_SpiTest_Fail("read data", name, sizes[i]);
+        }
+    }
+    cost[4] = a_SpiTest_Program();
+    a_SpiTest_Print("page program", &cost[4]);
+    if (cost[4].transfers != cost[4].frames)
+    {
+        a_SpiTest_Fail("program is not one transfer per command", name, 256);
+    }
+    if (memcmp(&w25qModelArray()[spiTestProgramAddr - 256], spiTestBuf, 256) != 0)
+    {
+        a_SpiTest_Fail("program data", name, 256);
+    }
+
+    for (i = 0; i < 5; i++)
+    {
+        if ((mode == W25QXX_SPI_TRANSFER_MODE_PERSISTENT) ? (cost[i].opens != 0.0) : (cost[i].opens != cost[i].frames))
+        {
+            a_SpiTest_Fail("driver opens per command", name, (i < 4) ? sizes[i] : 256);
+        }
+    }
+
+    drvSpiMockResetCounters();
+    w25qxx_deinit(&spiTestHandle);
+    if ((mode == W25QXX_SPI_TRANSFER_MODE_PERSISTENT) && ((opens != 1) || (drvSpiMockCloses != 1)))
+    {
+        a_SpiTest_Fail("persistent handle not opened once and closed at deinit", name, 0);
+    }
+    if ((drvSpiMockOpened != 0) || (drvSpiMockErrors != 0))
+    {
+        a_SpiTest_Fail("driver misuse or left open", name, 0);
+    }
+}
+
+// Two chips on one SERCOM: the persistent handle is shared and closed with the last one,
+// a chip in the open/close mode borrows it instead of a second exclusive open
+static void a_SpiTest_SharedBus(void)
+{
+    uint8_t status;
+
+    drvSpiMockResetCounters();
+    if ((a_SpiTest_Init(&spiTestHandle, &spiTestDescr, SPI_TEST_CS, W25QXX_SPI_TRANSFER_MODE_PERSISTENT) != 0) ||
+        (a_SpiTest_Init(&spiTestHandle2, &spiTestDescr2, SPI_TEST_CS2, W25QXX_SPI_TRANSFER_MODE_PERSISTENT) != 0))
+    {
+        a_SpiTest_Fail("init of two chips", "shared bus", 0);
+        return;
+    }
+    if ((drvSpiMockOpens != 1) || (spiTestDescr.spiHandle != spiTestDescr2.spiHandle))
+    {
+        a_SpiTest_Fail("two chips do not share the handle", "shared bus", 0);
+    }
+    w25qxx_deinit(&spiTestHandle);                                  // powers the one model chip down
+    if ((drvSpiMockCloses != 0) || (w25qxx_release_power_down(&spiTestHandle2) != 0))
+    {
+        a_SpiTest_Fail("handle closed under the second chip", "shared bus", 0);
+    }
+
+    if (a_SpiTest_Init(&spiTestHandle, &spiTestDescr, SPI_TEST_CS, W25QXX_SPI_TRANSFER_MODE_OPEN_CLOSE) != 0)
+    {
+        a_SpiTest_Fail("init of an open/close chip", "shared bus", 0);
+    }
+    drvSpiMockResetCounters();
+    if ((w25qxx_get_status1(&spiTestHandle, &status) != 0) || (drvSpiMockOpens != 0))
+    {
+        a_SpiTest_Fail("open/close chip does not borrow the handle", "shared bus", 0);
+    }
+    w25qxx_deinit(&spiTestHandle);
+    w25qxx_deinit(&spiTestHandle2);
+    if ((drvSpiMockOpened != 0) || (drvSpiMockErrors != 0))
+    {
+        a_SpiTest_Fail("driver misuse or left open", "shared bus", 0);
+    }
+}
+
+int main(void)
+{
+    SpiTestCost_s openClose[5];
+    SpiTestCost_s persistent[5];
+    int i;
+
+    if ((w25qModelInit(&spiTestHandle, W25Q128) != 0) || (w25qxx_deinit(&spiTestHandle) != 0))
+    {
+        printf("FAIL model init\n");
+        return 1;
+    }
+    for (i = 0; i < 4096; i++)
+    {
+        w25qModelArray()[i * 4096 + (i % 251)] = (uint8_t)i;        // reads do not all see 0xFF
+    }
+
+    a_SpiTest_Mode(W25QXX_SPI_TRANSFER_MODE_OPEN_CLOSE, openClose);
+    a_SpiTest_Mode(W25QXX_SPI_TRANSFER_MODE_PERSISTENT, persistent);
+    for (i = 0; i < 5; i++)
+    {
+        if (persistent[i].us >= openClose[i].us)
+        {
+            a_SpiTest_Fail("persistent mode not faster", "persistent", (uint32_t)i);
+        }
+    }
+    a_SpiTest_SharedBus();
+
+    printf("%s\n", (failures == 0) ? "ok" : "FAIL");
+    return (failures == 0) ? 0 : 1;
+}
@@ -0,0 +1,13 @@
+/*
+ * configuration.h
+ *
+ * Host stand-in for the MCC configuration, the DRV_SPI instances of the board.
+ */
+
+#ifndef CONFIGURATION_H_STUB_
+#define CONFIGURATION_H_STUB_
+
+#define DRV_SPI_INDEX_0             0
+#define DRV_SPI_INSTANCES_NUMBER    (1U)
+
+#endif /* CONFIGURATION_H_STUB_ */
@@ -0,0 +1,16 @@
+/*
+ * definitions.h
+ *
+ * Host stand-in for the MCC definitions the flash interface layer takes: the
+ * DRV_SPI driver and the port pins, both served by drv_spi_mock.c, and the
+ * QSPI registers of qspi_model.c.
+ */
+
+#ifndef DEFINITIONS_H_STUB_
+#define DEFINITIONS_H_STUB_
+
+#include "configuration.h"
+#include "drv_spi.h"
+#include "sam.h"
+
+#endif /* DEFINITIONS_H_STUB_ */
@@ -0,0 +1,88 @@
+/*
+ * drv_spi.h
+ *
+ * Host stand-in for the Harmony 3 DRV_SPI synchronous API and the port pins,
+ * implemented by drv_spi_mock.c.
+ */
+
+#ifndef DRV_SPI_H_STUB_
+#define DRV_SPI_H_STUB_
+
+#include <stdint.h>
+#include <stddef.h>
+#include <stdbool.h>
+
+typedef uintptr_t DRV_HANDLE;
+typedef uintptr_t SYS_MODULE_OBJ;
+typedef uint16_t SYS_MODULE_INDEX;
+typedef uint32_t SYS_PORT_PIN;
+
+#define DRV_HANDLE_INVALID          (((DRV_HANDLE) -1))
+#define SYS_PORT_PIN_NONE           ((SYS_PORT_PIN) -1)
+
+typedef enum
+{
+    DRV_IO_INTENT_READ = 1 << 0,
+    DRV_IO_INTENT_WRITE = 1 << 1,
+    DRV_IO_INTENT_READWRITE = DRV_IO_INTENT_READ | DRV_IO_INTENT_WRITE,
+    DRV_IO_INTENT_BLOCKING = 0 << 2,
+    DRV_IO_INTENT_NONBLOCKING = 1 << 2,
+    DRV_IO_INTENT_EXCLUSIVE = 1 << 3,
+    DRV_IO_INTENT_SHARED = 0 << 3,
+} DRV_IO_INTENT;
+
+typedef enum
+{
+    SYS_STATUS_ERROR = -1,
+    SYS_STATUS_UNINITIALIZED = 0,
+    SYS_STATUS_BUSY = 1,
+    SYS_STATUS_READY = 2,
+} SYS_STATUS;
+
+typedef enum
+{
+    DRV_SPI_CLOCK_PHASE_VALID_TRAILING_EDGE = 0,
+    DRV_SPI_CLOCK_PHASE_VALID_LEADING_EDGE = 1,
+} DRV_SPI_CLOCK_PHASE;
+
+typedef enum
+{
+    DRV_SPI_CLOCK_POLARITY_IDLE_LOW = 0,
+    DRV_SPI_CLOCK_POLARITY_IDLE_HIGH = 1,
+} DRV_SPI_CLOCK_POLARITY;
+
+typedef enum
+{
+    DRV_SPI_DATA_BITS_8 = 0,
+} DRV_SPI_DATA_BITS;
+
+typedef enum
+{
+    DRV_SPI_CS_POLARITY_ACTIVE_LOW = 0,
+    DRV_SPI_CS_POLARITY_ACTIVE_HIGH = 1
+} DRV_SPI_CS_POLARITY;
+
+typedef struct
+{
+    uint32_t baudRateInHz;
+    DRV_SPI_CLOCK_PHASE clockPhase;
+    DRV_SPI_CLOCK_POLARITY clockPolarity;
+    DRV_SPI_DATA_BITS dataBits;
+    SYS_PORT_PIN chipSelect;
+    DRV_SPI_CS_POLARITY csPolarity;
+} DRV_SPI_TRANSFER_SETUP;
+
+DRV_HANDLE DRV_SPI_Open(const SYS_MODULE_INDEX drvIndex, const DRV_IO_INTENT ioIntent);
+void DRV_SPI_Close(const DRV_HANDLE handle);
+SYS_STATUS DRV_SPI_Status(SYS_MODULE_OBJ object);
+bool DRV_SPI_TransferSetup(const DRV_HANDLE handle, DRV_SPI_TRANSFER_SETUP *setup);
+bool DRV_SPI_WriteTransfer(const DRV_HANDLE handle, void *pTransmitData, size_t txSize);
+bool DRV_SPI_ReadTransfer(const DRV_HANDLE handle, void *pReceiveData, size_t rxSize);
+bool DRV_SPI_WriteReadTransfer(const DRV_HANDLE handle, void *pTransmitData, size_t txSize,
+                               void *pReceiveData, size_t rxSize);
+
+void SYS_PORT_PinSet(SYS_PORT_PIN pin);
+void SYS_PORT_PinClear(SYS_PORT_PIN pin);
+void SYS_PORT_PinOutputEnable(SYS_PORT_PIN pin);
+
+#endif /* DRV_SPI_H_STUB_ */
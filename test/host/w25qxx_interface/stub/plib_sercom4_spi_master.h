@@ -0,0 +1,10 @@
+/*
+ * plib_sercom4_spi_master.h
+ *
+ * Host stand-in, the SERCOM is behind the DRV_SPI mock.
+ */
+
+#ifndef PLIB_SERCOM4_SPI_MASTER_H_STUB_
+#define PLIB_SERCOM4_SPI_MASTER_H_STUB_
+
+#endif /* PLIB_SERCOM4_SPI_MASTER_H_STUB_ */
@@ -0,0 +1,43 @@
+/*
+ * sam.h
+ *
+ * Host stand-in for the device header: the QSPI register block and memory
+ * window are the trapped pages of qspi_model.c, PORT and MCLK plain structs,
+ * the CPU clock a variable.
+ */
+
+#ifndef SAM_H_STUB_
+#define SAM_H_STUB_
+
+#include <stdint.h>
+
+#define _UINT32_(x)     ((uint32_t)(x))
+#define _UINT16_(x)     ((uint16_t)(x))
+#define _UINT8_(x)      ((uint8_t)(x))
+#define __I             volatile const
+#define __O             volatile
+#define __IO            volatile
+#define __IM            volatile const
+#define __OM            volatile
+#define __IOM           volatile
+
+#include "component/qspi.h"
+#include "component/port.h"
+#include "component/mclk.h"
+
+extern qspi_registers_t *qspiModelRegs;
+extern uint8_t *qspiModelWindow;
+extern port_registers_t qspiModelPort;
+extern mclk_registers_t qspiModelMclk;
+extern uint32_t qspiModelCpuHz;
+
+#define QSPI_REGS               qspiModelRegs
+#define QSPI_ADDR               ((uintptr_t)qspiModelWindow)
+#define PORT_REGS               (&qspiModelPort)
+#define MCLK_REGS               (&qspiModelMclk)
+#define CPU_CLOCK_FREQUENCY     qspiModelCpuHz
+
+#define __DSB()                 __sync_synchronize()
+#define __ISB()                 __sync_synchronize()
+
+#endif /* SAM_H_STUB_ */
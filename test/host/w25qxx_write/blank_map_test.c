@@ -0,0 +1,318 @@
+/*
+ * blank_map_test.c
+ *
+ * Checks the blank sector map of driver_w25qxx.c and the erase decision of
+ * w25qxx_write() on the RAM NOR model of a W25Q128.
+ *
+ * The erase decision runs without a map on random sector contents: writes
+ * at every offset modulo 8 and of odd lengths that only clear bits, and the
+ * same with one bit going from 0 to 1 in the body or in the unaligned tail.
+ * The sector must be erased exactly when a byte-wise reference says so, and
+ * read back as written.
+ *
+ * The map is rebuilt after a boot the way the pre-erase pool does it, one
+ * w25qxx_blank_check() per sector, over a chip holding data from before:
+ * the map must match the contents, a sector with a single programmed byte
+ * at either end included, and a second pass must not read the known blank
+ * sectors. Then erases of known blank sectors are skipped and counted,
+ * other erases reach the chip and mark their sectors, programs and raw
+ * commands clear the bits, and a write into a known blank sector skips the
+ * read-back. A reboot starts over with an empty map. Exits with 1 on
+ * failure.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "w25q_model.h"
+
+#define BLANK_TEST_SECTORS      4096                // W25Q128
+#define BLANK_TEST_WORDS        (BLANK_TEST_SECTORS / 32)
+#define BLANK_TEST_RUNS         4000
+#define BLANK_TEST_BASE         0x200000            // sector of the erase decision runs
+
+static w25qxx_handle_t blankTestHandle;
+static uint32_t blankTestMap[BLANK_TEST_WORDS];
+static uint8_t blankTestBlank[BLANK_TEST_SECTORS];  // reference: sector is all 0xFF
+static uint8_t blankTestShadow[4096];
+static uint8_t blankTestData[4096];
+static unsigned int failures;
+
+
+static void a_BlankTest_Fail(const char *what, uint32_t value)
+{
+    if (failures++ < 10)
+    {
+        printf("FAIL %s, %u\n", what, (unsigned int)value);
+    }
+}
+
+// The map must equal the reference for every sector, a known blank sector must really be blank
+static void a_BlankTest_CheckMap(const char *what, int exact)
+{
+    uint32_t s;
+    int bit;
+
+    for (s = 0; s < BLANK_TEST_SECTORS; s++)
+    {
+        bit = (blankTestMap[s / 32] >> (s % 32)) & 1;
+        if ((bit && !blankTestBlank[s]) || (exact && (bit != blankTestBlank[s])))
+        {
+            a_BlankTest_Fail(what, s);
+            return;
+        }
+    }
+}
+
+static int a_BlankTest_Known(uint32_t sector)
+{
+    return (blankTestMap[sector / 32] >> (sector % 32)) & 1;
+}
+
+// Byte-wise reference of the erase decision
+static int a_BlankTest_NeedErase(const uint8_t *old, const uint8_t *data, uint32_t len)
+{
+    uint32_t i;
+
+    for (i = 0; i < len; i++)
+    {
+        if ((old[i] & data[i]) != data[i])
+        {
+            return 1;
+        }
+    }
+    return 0;
+}
+
+static void a_BlankTest_EraseDecision(void)
+{
+    uint8_t *chip = &w25qModelArray()[BLANK_TEST_BASE];
+    uint32_t run;
+    uint32_t offset;
+    uint32_t len;
+    uint32_t i;
+    uint32_t bit;
+    uint32_t erases = 0;
+    int expected;
+
+    srand(8);
+    w25qxx_set_blank_map(&blankTestHandle, NULL, 0);
+    for (run = 0; run < BLANK_TEST_RUNS; run++)
+    {
+        for (i = 0; i < 4096; i++)
+        {
+            blankTestShadow[i] = (uint8_t)rand();
+        }
+        memcpy(chip, blankTestShadow, 4096);                    // programmed before the test
+
+        offset = ((uint32_t)rand() % 512) * 8 + (run % 8);
+        len = 1 + (uint32_t)rand() % ((run % 3 == 0) ? 15 : 700);
+        if (offset + len > 4096)
+        {
+            len = 4096 - offset;
+        }
+        for (i = 0; i < len; i++)
+        {
+            blankTestData[i] = blankTestShadow[offset + i] & (uint8_t)rand();      // 1 -> 0 only
+        }
+        if ((run % 2) != 0)
+        {
+            // one bit from 0 to 1, every other time in the bytes past the last whole word
+            i = ((run % 4) == 1) ? ((uint32_t)rand() % len) :
+                (((len % 4) != 0) ? (len - 1 - ((uint32_t)rand() % (len % 4))) : (len - 1));
+            bit = 1u << (rand() % 8);
+            blankTestShadow[offset + i] &= (uint8_t)~bit;
+            chip[offset + i] &= (uint8_t)~bit;
+            blankTestData[i] |= (uint8_t)bit;
+        }
+        expected = a_BlankTest_NeedErase(&blankTestShadow[offset], blankTestData, len);
+
+        w25qModelResetCounters();
+        if (w25qxx_write(&blankTestHandle, BLANK_TEST_BASE + offset, blankTestData, len) != 0)
+        {
+            a_BlankTest_Fail("write", run);
+            continue;
+        }
+        memcpy(&blankTestShadow[offset], blankTestData, len);
+        if (w25qModelErases != (uint32_t)expected)
+        {
+            a_BlankTest_Fail("erase decision differs from the byte-wise reference", run);
+        }
+        if (memcmp(chip, blankTestShadow, 4096) != 0)
+        {
+            a_BlankTest_Fail("read back", run);
+        }
+        erases += (uint32_t)expected;
+    }
+    printf("erase decision: %u writes, %u erases, offsets 0-7 mod 8, lengths 1-700\n",
+           (unsigned int)BLANK_TEST_RUNS, (unsigned int)erases);
+}
+
+// What the pre-erase pool does after mount: a blank check of every sector
+static void a_BlankTest_Rebuild(const char *what, uint32_t *reads)
+{
+    w25qxx_bool_t blank;
+    uint32_t s;
+
+    w25qModelResetCounters();
+    for (s = 0; s < BLANK_TEST_SECTORS; s++)
+    {
+        if ((w25qxx_blank_check(&blankTestHandle, s * 4096, &blank) != 0) ||
+            ((blank == W25QXX_BOOL_TRUE) != (blankTestBlank[s] != 0)))
+        {
+            a_BlankTest_Fail(what, s);
+            break;
+        }
+    }
+    *reads = w25qModelReads;
+    a_BlankTest_CheckMap(what, 1);
+}
+
+// Chip contents from before the boot: every third sector has data, two hold one programmed byte
+static void a_BlankTest_Contents(void)
+{
+    uint8_t *chip = w25qModelArray();
+    uint32_t s;
+
+    memset(chip, 0xFF, BLANK_TEST_SECTORS * 4096);
+    for (s = 0; s < BLANK_TEST_SECTORS; s++)
+    {
+        blankTestBlank[s] = ((s % 3) != 0);
+        if (!blankTestBlank[s])
+        {
+            memset(&chip[s * 4096], (uint8_t)(s & 0x7F), 4096);
+        }
+    }
+    chip[1 * 4096] = 0xFE;                                  // first byte only
+    blankTestBlank[1] = 0;
+    chip[2 * 4096 + 4095] = 0x7F;                           // last byte only
+    blankTestBlank[2] = 0;
+}
+
+static void a_BlankTest_Map(void)
+{
+    uint32_t hits;
+    uint32_t misses;
+    uint32_t reads;
+    uint32_t programmed = 0;
+    uint32_t s;
+    uint8_t status;
+
+    a_BlankTest_Contents();
+    for (s = 0; s < BLANK_TEST_SECTORS; s++)
+    {
+        programmed += !blankTestBlank[s];
+    }
+    memset(blankTestMap, 0xA5, sizeof(blankTestMap));       // whatever was in RAM
+    if ((w25qModelRestart(&blankTestHandle) != 0) ||
+        (w25qxx_set_blank_map(&blankTestHandle, blankTestMap, BLANK_TEST_SECTORS) != 0))
+    {
+        a_BlankTest_Fail("boot", 0);
+        return;
+    }
+    for (s = 0; s < BLANK_TEST_WORDS; s++)
+    {
+        if (blankTestMap[s] != 0)
+        {
+            a_BlankTest_Fail("map not empty after attaching it", s);
+            break;
+        }
+    }
+
+    a_BlankTest_Rebuild("rebuilt map differs from the chip", &reads);
+    printf("rebuild: %u sectors, %u programmed, %u reads\n", (unsigned int)BLANK_TEST_SECTORS,
+           (unsigned int)programmed, (unsigned int)reads);
+    a_BlankTest_Rebuild("second pass differs from the chip", &reads);
+    if (reads != programmed + 15)                           // one 256 B read each, 16 for sector 2
+    {
+        a_BlankTest_Fail("second pass read known blank sectors", reads);
+    }
+
+    // erases: a known blank sector or block is skipped, others reach the chip and are then known
+    w25qModelResetCounters();
+    if ((w25qxx_sector_erase_4k(&blankTestHandle, 4 * 4096) != 0) ||
+        (w25qxx_block_erase_64k(&blankTestHandle, 0) != 0) ||
+        (w25qxx_sector_erase_4k(&blankTestHandle, 33 * 4096) != 0))
+    {
+        a_BlankTest_Fail("erase", 0);
+    }
+    for (s = 0; s < 16; s++)
+    {
+        blankTestBlank[s] = 1;
+    }
+    blankTestBlank[33] = 1;
+    w25qxx_get_blank_statistics(&blankTestHandle, &hits, &misses);
+    if ((w25qModelErases != 2) || (hits != 1) || (misses != 2))
+    {
+        a_BlankTest_Fail("erases sent to the chip", w25qModelErases);
+    }
+    a_BlankTest_CheckMap("map after erases", 1);
+    w25qModelResetCounters();
+    if ((w25qxx_block_erase_64k(&blankTestHandle, 0) != 0) || (w25qModelErases != 0))
+    {
+        a_BlankTest_Fail("erase of a known blank block reached the chip", w25qModelErases);
+    }
+
+    // a write into a known blank sector needs no read-back and clears the bit
+    memset(blankTestData, 0x3C, 600);
+    w25qModelResetCounters();
+    if ((w25qxx_write(&blankTestHandle, 5 * 4096 + 100, blankTestData, 600) != 0) ||
+        (w25qModelReads != 0) || (w25qModelErases != 0) || a_BlankTest_Known(5))
+    {
+        a_BlankTest_Fail("write into a known blank sector", w25qModelReads);
+    }
+    blankTestBlank[5] = 0;
+    if (memcmp(&w25qModelArray()[5 * 4096 + 100], blankTestData, 600) != 0)
+    {
+        a_BlankTest_Fail("write into a known blank sector read back", 5);
+    }
+
+    // a page program clears the bit, a raw command forgets the whole map
+    if ((w25qxx_page_program(&blankTestHandle, 7 * 4096, blankTestData, 16) != 0) || a_BlankTest_Known(7))
+    {
+        a_BlankTest_Fail("page program left the sector known blank", 7);
+    }
+    blankTestBlank[7] = 0;
+    a_BlankTest_CheckMap("map after programs", 1);
+    if ((w25qxx_write_read_reg(&blankTestHandle, 0x05, 1, 0, 0, 0, 0, 0, 0, 0, NULL, 0, &status, 1, 1) != 0))
+    {
+        a_BlankTest_Fail("raw command", 0);
+    }
+    for (s = 0; s < BLANK_TEST_WORDS; s++)
+    {
+        if (blankTestMap[s] != 0)
+        {
+            a_BlankTest_Fail("raw command left sectors known blank", s);
+            break;
+        }
+    }
+
+    // reboot: the map starts empty and is rebuilt from the chip
+    if ((w25qModelRestart(&blankTestHandle) != 0) ||
+        (w25qxx_set_blank_map(&blankTestHandle, blankTestMap, BLANK_TEST_SECTORS) != 0))
+    {
+        a_BlankTest_Fail("reboot", 0);
+        return;
+    }
+    w25qxx_get_blank_statistics(&blankTestHandle, &hits, &misses);
+    if ((hits != 0) || (misses != 0))
+    {
+        a_BlankTest_Fail("statistics kept over a reboot", hits);
+    }
+    a_BlankTest_Rebuild("map rebuilt after the reboot differs from the chip", &reads);
+}
+
+int main(void)
+{
+    if (w25qModelInit(&blankTestHandle, W25Q128) != 0)
+    {
+        printf("FAIL model init\n");
+        return 1;
+    }
+
+    a_BlankTest_EraseDecision();
+    a_BlankTest_Map();
+
+    printf("%s\n", (failures == 0) ? "ok" : "FAIL");
+    return (failures == 0) ? 0 : 1;
+}
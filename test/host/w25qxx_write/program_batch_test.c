@@ -0,0 +1,286 @@
+/*
+ * program_batch_test.c
+ *
+ * Checks the page program batch of driver_w25qxx.c, w25qxx_program_segments()
+ * and the batches of w25qxx_write(), across the 16 MB bank boundary of the
+ * RAM NOR model of a W25Q256.
+ *
+ * In 3 byte address mode the chip adds its extended address register (0xC5)
+ * as the high address byte, so a batch must write it before the first page
+ * and again whenever a page lies in the other bank, including when a single
+ * segment runs over 0x1000000 and when the list goes back and forth; the
+ * register the chip holds from earlier commands must not be trusted. In 4
+ * byte address mode no 0xC5 may be sent. Random batches of up to eight
+ * segments around the boundary are compared with a reference that counts the
+ * bank changes page by page, and the whole array is compared with a shadow
+ * image after every batch, so a page programmed into the wrong bank is found
+ * wherever it lands. Exits with 1 on failure.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "w25q_model.h"
+
+#define BATCH_TEST_SIZE         (32u * 1024u * 1024u)   // W25Q256
+#define BATCH_TEST_BANK         0x1000000u              // first byte of the second 16 MB bank
+#define BATCH_TEST_WINDOW       0x10000u                // random segments within this much of a boundary
+#define BATCH_TEST_SEGMENTS     8
+#define BATCH_TEST_RUNS         400
+
+static w25qxx_handle_t batchTestHandle;
+static uint8_t batchTestShadow[BATCH_TEST_SIZE];
+static uint8_t batchTestData[BATCH_TEST_SEGMENTS][1024];
+static uint8_t batchTestRead[8192];
+static unsigned int failures;
+
+
+static void a_BatchTest_Fail(const char *what, const char *name, uint32_t value)
+{
+    if (failures++ < 10)
+    {
+        printf("FAIL %s, %s, 0x%X\n", what, name, (unsigned int)value);
+    }
+}
+
+// Erase the array and the shadow between cases
+static void a_BatchTest_Erase(void)
+{
+    memset(w25qModelArray(), 0xFF, BATCH_TEST_SIZE);
+    memset(batchTestShadow, 0xFF, BATCH_TEST_SIZE);
+}
+
+// 0xC5 writes a 3 byte address batch needs: one per bank change page by page, the first included
+static uint32_t a_BatchTest_ExtWrites(const w25qxx_program_segment_t *seg, uint32_t count)
+{
+    uint32_t writes = 0;
+    uint32_t bank = 0xFFFFFFFFu;
+    uint32_t i;
+    uint32_t addr;
+
+    for (i = 0; i < count; i++)
+    {
+        for (addr = seg[i].addr; addr < seg[i].addr + seg[i].len; addr = (addr | 0xFF) + 1)
+        {
+            if ((addr >> 24) != bank)
+            {
+                bank = addr >> 24;
+                writes++;
+            }
+        }
+    }
+    return writes;
+}
+
+// The whole array must equal the shadow, a misaddressed page shows up wherever it landed
+static void a_BatchTest_Compare(const char *name)
+{
+    const uint8_t *chip = w25qModelArray();
+    uint32_t i;
+
+    if (memcmp(chip, batchTestShadow, BATCH_TEST_SIZE) == 0)
+    {
+        return;
+    }
+    for (i = 0; (i < BATCH_TEST_SIZE) && (chip[i] == batchTestShadow[i]); i++)
+    {
+    }
+    a_BatchTest_Fail("array differs at", name, i);
+}
+
+static void a_BatchTest_Program(const char *name, const w25qxx_program_segment_t *seg, uint32_t count,
+                                w25qxx_address_mode_t mode)
+{
+    uint32_t pages = 0;
+    uint32_t i;
+    uint32_t j;
+    uint32_t ext;
+
+    for (i = 0; i < count; i++)
+    {
+        for (j = 0; j < seg[i].len; j++)
+        {
+            batchTestShadow[seg[i].addr + j] &= seg[i].data[j];
+        }
+        if (seg[i].len != 0)
+        {
+            pages += ((seg[i].addr + seg[i].len - 1) / 256) - (seg[i].addr / 256) + 1;
+        }
+    }
+    ext = (mode == W25QXX_ADDRESS_MODE_3_BYTE) ? a_BatchTest_ExtWrites(seg, count) : 0;
+
+    w25qModelResetCounters();
+    if (w25qxx_program_segments(&batchTestHandle, seg, count) != 0)
+    {
+        a_BatchTest_Fail("program segments", name, count);
+        return;
+    }
+    if (w25qModelPrograms != pages)
+    {
+        a_BatchTest_Fail("page programs", name, w25qModelPrograms);
+    }
+    if (w25qModelCommands[0xC5] != ext)
+    {
+        a_BatchTest_Fail("extended address register writes", name, w25qModelCommands[0xC5]);
+    }
+    a_BatchTest_Compare(name);
+}
+
+static int a_BatchTest_Mode(w25qxx_address_mode_t mode)
+{
+    if (w25qxx_set_address_mode(&batchTestHandle, mode) != 0)
+    {
+        a_BatchTest_Fail("set address mode", (mode == W25QXX_ADDRESS_MODE_3_BYTE) ? "3 byte" : "4 byte", mode);
+        return 1;
+    }
+    return 0;
+}
+
+// Fixed lists: over the boundary inside one segment, back and forth, and with a stale register
+static void a_BatchTest_Fixed(w25qxx_address_mode_t mode)
+{
+    w25qxx_program_segment_t seg[BATCH_TEST_SEGMENTS];
+    uint32_t i;
+    uint32_t j;
+
+    for (i = 0; i < BATCH_TEST_SEGMENTS; i++)
+    {
+        for (j = 0; j < sizeof(batchTestData[i]); j++)
+        {
+            batchTestData[i][j] = (uint8_t)(i * 37 + j * 11 + 1);
+        }
+    }
+
+    a_BatchTest_Erase();
+    seg[0].addr = BATCH_TEST_BANK - 0x80;                   // half a page each side
+    seg[0].data = batchTestData[0];
+    seg[0].len = 0x180;
+    a_BatchTest_Program("one segment over the boundary", seg, 1, mode);
+
+    a_BatchTest_Erase();
+    seg[0].addr = BATCH_TEST_BANK - 0x100;                  // last page of bank 0
+    seg[0].data = batchTestData[0];
+    seg[0].len = 0x100;
+    seg[1].addr = BATCH_TEST_BANK + 0x200;
+    seg[1].data = batchTestData[1];
+    seg[1].len = 100;
+    seg[2].addr = 0x200;                                    // same low bytes, other bank
+    seg[2].data = batchTestData[2];
+    seg[2].len = 100;
+    seg[3].addr = BATCH_TEST_SIZE - 0x100;                  // last page of the chip
+    seg[3].data = batchTestData[3];
+    seg[3].len = 0x100;
+    seg[4].addr = 0;
+    seg[4].data = batchTestData[4];
+    seg[4].len = 1;
+    seg[5].addr = 1;                                        // same bank, no register write
+    seg[5].data = batchTestData[5];
+    seg[5].len = 0;
+    a_BatchTest_Program("back and forth", seg, 6, mode);
+
+    // a 3 byte read of the second bank leaves the register at 1 on the chip
+    a_BatchTest_Erase();
+    if (w25qxx_read(&batchTestHandle, BATCH_TEST_BANK + 0x1000, batchTestRead, 16) != 0)
+    {
+        a_BatchTest_Fail("read", "stale register", 0);
+    }
+    seg[0].addr = 0x1000;
+    seg[0].data = batchTestData[6];
+    seg[0].len = 0x100;
+    a_BatchTest_Program("stale register", seg, 1, mode);
+}
+
+// Random batches of up to eight segments within a window of either side of a bank boundary
+static void a_BatchTest_Random(w25qxx_address_mode_t mode)
+{
+    w25qxx_program_segment_t seg[BATCH_TEST_SEGMENTS];
+    uint32_t run;
+    uint32_t count;
+    uint32_t i;
+    uint32_t j;
+    uint32_t base;
+
+    srand(9 + (unsigned int)mode);
+    for (run = 0; run < BATCH_TEST_RUNS; run++)
+    {
+        a_BatchTest_Erase();
+        count = 1 + (uint32_t)rand() % BATCH_TEST_SEGMENTS;
+        for (i = 0; i < count; i++)
+        {
+            base = ((rand() % 4) == 0) ? (((rand() % 2) == 0) ? 0 : (BATCH_TEST_SIZE - BATCH_TEST_WINDOW)) :
+                   (BATCH_TEST_BANK - BATCH_TEST_WINDOW);                              // chip start, chip end, boundary
+            seg[i].addr = base + (uint32_t)rand() % ((base == BATCH_TEST_BANK - BATCH_TEST_WINDOW) ?
+                                                     (2 * BATCH_TEST_WINDOW) : BATCH_TEST_WINDOW);
+            seg[i].len = (uint32_t)rand() % sizeof(batchTestData[i]);
+            if (seg[i].addr + seg[i].len > BATCH_TEST_SIZE)
+            {
+                seg[i].len = BATCH_TEST_SIZE - seg[i].addr;
+            }
+            seg[i].data = batchTestData[i];
+            for (j = 0; j < seg[i].len; j++)
+            {
+                batchTestData[i][j] = (uint8_t)rand();
+            }
+        }
+        a_BatchTest_Program("random", seg, count, mode);
+    }
+}
+
+// w25qxx_write() over the boundary, its batches come from the sector loop
+static void a_BatchTest_Write(w25qxx_address_mode_t mode)
+{
+    uint32_t addr = BATCH_TEST_BANK - 0x1000 - 0x80;
+    uint32_t i;
+
+    a_BatchTest_Erase();
+    for (i = 0; i < sizeof(batchTestRead); i++)
+    {
+        batchTestRead[i] = (uint8_t)(i * 13 + 5);
+    }
+    memcpy(&batchTestShadow[addr], batchTestRead, sizeof(batchTestRead));
+    w25qModelResetCounters();
+    if (w25qxx_write(&batchTestHandle, addr, batchTestRead, sizeof(batchTestRead)) != 0)
+    {
+        a_BatchTest_Fail("write", "over the boundary", addr);
+        return;
+    }
+    if ((mode == W25QXX_ADDRESS_MODE_4_BYTE) && (w25qModelCommands[0xC5] != 0))
+    {
+        a_BatchTest_Fail("extended address register written in 4 byte mode", "write", w25qModelCommands[0xC5]);
+    }
+    a_BatchTest_Compare("write over the boundary");
+    memset(batchTestRead, 0, sizeof(batchTestRead));
+    if ((w25qxx_read(&batchTestHandle, addr, batchTestRead, sizeof(batchTestRead)) != 0) ||
+        (memcmp(batchTestRead, &batchTestShadow[addr], sizeof(batchTestRead)) != 0))
+    {
+        a_BatchTest_Fail("read back", "write over the boundary", addr);
+    }
+}
+
+int main(void)
+{
+    static const w25qxx_address_mode_t modes[] = {W25QXX_ADDRESS_MODE_3_BYTE, W25QXX_ADDRESS_MODE_4_BYTE};
+    uint32_t i;
+
+    if (w25qModelInit(&batchTestHandle, W25Q256) != 0)
+    {
+        printf("FAIL model init\n");
+        return 1;
+    }
+
+    for (i = 0; i < sizeof(modes) / sizeof(modes[0]); i++)
+    {
+        if (a_BatchTest_Mode(modes[i]) != 0)
+        {
+            continue;
+        }
+        a_BatchTest_Fixed(modes[i]);
+        a_BatchTest_Random(modes[i]);
+        a_BatchTest_Write(modes[i]);
+        printf("%s byte address mode: %u random batches around the 16 MB boundary\n",
+               (modes[i] == W25QXX_ADDRESS_MODE_3_BYTE) ? "3" : "4", (unsigned int)BATCH_TEST_RUNS);
+    }
+
+    printf("%s\n", (failures == 0) ? "ok" : "FAIL");
+    return (failures == 0) ? 0 : 1;
+}
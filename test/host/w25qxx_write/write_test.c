@@ -0,0 +1,149 @@
+/*
+ * write_test.c
+ *
+ * Checks w25qxx_write() of driver_w25qxx.c on the RAM NOR model of a
+ * W25Q128: a write onto erased flash, a rewrite of the same data, partial
+ * overwrites that only clear bits (1 -> 0), overwrites that set a bit
+ * (0 -> 1) and need an erase, and writes across page and sector boundaries.
+ * Each case asserts the page programs and sector erases reported by
+ * w25qxx_get_write_statistics(), the commands the model saw, and that the
+ * chip reads back the data written and keeps the bytes around it. Exits with
+ * 1 on failure.
+ */
+
+#include <stdio.h>
+#include <string.h>
+#include "w25q_model.h"
+
+#define WRITE_TEST_BASE     0x40000     // sector aligned
+#define WRITE_TEST_SPAN     (4 * 4096)  // sectors compared with the shadow image
+
+static w25qxx_handle_t writeTestHandle;
+static uint8_t writeTestShadow[WRITE_TEST_SPAN];   // what the chip must hold from WRITE_TEST_BASE
+static uint8_t writeTestData[2 * 4096];
+static uint8_t writeTestRead[WRITE_TEST_SPAN];
+static unsigned int failures;
+
+
+static void a_WriteTest_Fail(const char *what, const char *name, uint32_t value)
+{
+    if (failures++ < 10)
+    {
+        printf("FAIL %s, %s, %u\n", what, name, (unsigned int)value);
+    }
+}
+
+// Write len bytes of writeTestData at offset, then check the statistics, the model and the read back
+static void a_WriteTest_Write(const char *name, uint32_t offset, uint32_t len, uint32_t pages, uint32_t erases)
+{
+    uint32_t statPages;
+    uint32_t statErases;
+
+    w25qModelResetCounters();
+    if (w25qxx_write(&writeTestHandle, WRITE_TEST_BASE + offset, writeTestData, len) != 0)
+    {
+        a_WriteTest_Fail("write", name, len);
+        return;
+    }
+    memcpy(&writeTestShadow[offset], writeTestData, len);
+
+    if ((w25qxx_get_write_statistics(&writeTestHandle, &statPages, &statErases) != 0) ||
+        (statPages != pages) || (statErases != erases))
+    {
+        a_WriteTest_Fail("page programs", name, statPages);
+        a_WriteTest_Fail("sector erases", name, statErases);
+    }
+    if ((w25qModelPrograms != pages) || (w25qModelErases != erases))
+    {
+        a_WriteTest_Fail("statistics differ from the chip", name, w25qModelPrograms);
+    }
+    if ((w25qxx_read(&writeTestHandle, WRITE_TEST_BASE, writeTestRead, WRITE_TEST_SPAN) != 0) ||
+        (memcmp(writeTestRead, writeTestShadow, WRITE_TEST_SPAN) != 0))
+    {
+        a_WriteTest_Fail("read back", name, offset);
+    }
+    printf("%-42s %5u B  %3u pages  %u erases\n", name, (unsigned int)len, (unsigned int)statPages,
+           (unsigned int)statErases);
+}
+
+// Fill writeTestData from the shadow at offset, so a write only changes what the case changes
+static void a_WriteTest_FromShadow(uint32_t offset, uint32_t len)
+{
+    memcpy(writeTestData, &writeTestShadow[offset], len);
+}
+
+int main(void)
+{
+    uint32_t i;
+
+    if (w25qModelInit(&writeTestHandle, W25Q128) != 0)
+    {
+        printf("FAIL model init\n");
+        return 1;
+    }
+    memset(writeTestShadow, 0xFF, sizeof(writeTestShadow));
+
+    // Sector 0: a full sector onto erased flash
+    for (i = 0; i < 4096; i++)
+    {
+        writeTestData[i] = (uint8_t)(i * 13 + 7) & 0x7F;
+    }
+    a_WriteTest_Write("full sector onto erased", 0, 4096, 16, 0);
+    a_WriteTest_Write("rewrite of the same data", 0, 4096, 0, 0);
+
+    // 1 -> 0 only: programmed in place, the unchanged pages are skipped
+    a_WriteTest_FromShadow(0, 4096);
+    for (i = 300; i < 310; i++)
+    {
+        writeTestData[i] &= 0x0F;
+    }
+    a_WriteTest_Write("partial overwrite, 1 -> 0", 0, 4096, 1, 0);
+
+    a_WriteTest_FromShadow(250, 20);
+    for (i = 0; i < 20; i++)
+    {
+        writeTestData[i] = 0x00;
+    }
+    a_WriteTest_Write("partial overwrite across a page, 1 -> 0", 250, 20, 2, 0);
+
+    // 0 -> 1 in one byte: the sector is erased, its 16 programmed pages written back
+    a_WriteTest_FromShadow(2000, 1);
+    writeTestData[0] |= 0x80;
+    a_WriteTest_Write("one byte, 0 -> 1", 2000, 1, 16, 1);
+
+    // Sector 1: three pages programmed, the rest left erased
+    for (i = 0; i < 3 * 256; i++)
+    {
+        writeTestData[i] = (uint8_t)i & 0xFE;
+    }
+    a_WriteTest_Write("three pages onto erased", 4096 + 1024, 3 * 256, 3, 0);
+    a_WriteTest_FromShadow(4096 + 1024 + 10, 1);
+    writeTestData[0] |= 0x01;
+    a_WriteTest_Write("0 -> 1, the erased pages not rewritten", 4096 + 1024 + 10, 1, 3, 1);
+
+    // Erased bytes onto erased flash: nothing to program
+    memset(writeTestData, 0xFF, 512);
+    a_WriteTest_Write("0xFF onto erased", 2 * 4096, 512, 0, 0);
+
+    // Across the boundary of sectors 2 and 3, both erased
+    for (i = 0; i < 200; i++)
+    {
+        writeTestData[i] = (uint8_t)(0xA5 ^ i);
+    }
+    a_WriteTest_Write("across a sector, onto erased", 3 * 4096 - 100, 200, 2, 0);
+
+    // Across the same boundary, 0 -> 1 on both sides: both sectors erased and rewritten
+    a_WriteTest_FromShadow(3 * 4096 - 100, 200);
+    writeTestData[0] = 0xFF;
+    writeTestData[199] = 0xFF;
+    a_WriteTest_Write("across a sector, 0 -> 1", 3 * 4096 - 100, 200, 2, 2);
+
+    // A mixed write over sectors 0 and 1: 0 -> 1 in sector 0 only
+    a_WriteTest_FromShadow(4000, 200);
+    writeTestData[0] = 0xFF;
+    writeTestData[150] &= 0x10;
+    a_WriteTest_Write("0 -> 1 in one sector, 1 -> 0 in the next", 4000, 200, 16 + 1, 1);
+
+    printf("%s\n", (failures == 0) ? "ok" : "FAIL");
+    return (failures == 0) ? 0 : 1;
+}